@@ -0,0 +1,526 @@
+/******************************************************************************
+* File Name:   ecdsa_comb.c
+*
+* Description: This file implements a fast ECDSA P-256 verification path for
+* the image-signing key. Every signature is verified against the same fixed
+* public key, so the comb tables of the generator and of that key are
+* precomputed at build time by scripts/ecdsa_comb_gen.py and kept in flash.
+* Mbed TLS uses a table attached to a group (grp->T) for multiplications of the
+* group generator, so each multiplication is done in a P-256 group whose
+* generator is the fixed point and whose table is the precomputed one. No
+* table is computed at run time.
+*
+* mbedtls_ecdsa_read_signature() is interposed with the -Wl,--wrap linker
+* option. Other curves and keys, and any unexpected error, fall back to the
+* generic Mbed TLS path. So does a signature the comb path rejects: the tables
+* only match an Mbed TLS built with the same window size.
+*
+* This file is shared by the bootloader and the OTA app.
+*
+* Related Document: See README.md
+*
+*******************************************************************************
+* (c) 2020, Cypress Semiconductor Corporation. All rights reserved.
+*******************************************************************************
+* This software, including source code, documentation and related materials
+* ("Software"), is owned by Cypress Semiconductor Corporation or one of its
+* subsidiaries ("Cypress") and is protected by and subject to worldwide patent
+* protection (United States and foreign), United States copyright laws and
+* international treaty provisions. Therefore, you may use this Software only
+* as provided in the license agreement accompanying the software package from
+* which you obtained this Software ("EULA").
+*
+* If no EULA applies, Cypress hereby grants you a personal, non-exclusive,
+* non-transferable license to copy, modify, and compile the Software source
+* code solely for use in connection with Cypress's integrated circuit products.
+* Any reproduction, modification, translation, compilation, or representation
+* of this Software except as specified above is prohibited without the express
+* written permission of Cypress.
+*
+* Disclaimer: THIS SOFTWARE IS PROVIDED AS-IS, WITH NO WARRANTY OF ANY KIND,
+* EXPRESS OR IMPLIED, INCLUDING, BUT NOT LIMITED TO, NONINFRINGEMENT, IMPLIED
+* WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE. Cypress
+* reserves the right to make changes to the Software without notice. Cypress
+* does not assume any liability arising out of the application or use of the
+* Software or any product or circuit described in the Software. Cypress does
+* not authorize its products for use in any products where a malfunction or
+* failure of the Cypress product may reasonably be expected to result in
+* significant property damage, injury or death ("High Risk Product"). By
+* including Cypress's product in a High Risk Product, the manufacturer of such
+* system or application assumes all risk of such use and in doing so agrees to
+* indemnify Cypress against all liability.
+*******************************************************************************/
+
+#include <string.h>
+#include <stdbool.h>
+#include "cy_pdl.h"
+#include "mbedtls/ecdsa.h"
+#include "mbedtls/asn1.h"
+#include "bootutil/bootutil_log.h"
+
+#if defined(CY_ECDSA_COMB)
+
+#include "ecdsa_comb.h"
+
+#if !defined(MBEDTLS_ECP_ALT)
+#include "ecdsa_comb_tables.h"
+#endif
+
+
+/*******************************************************************************
+* Macros
+*******************************************************************************/
+/* SysTick clock on CM0+, which has no cycle counter */
+#define ECDSA_COMB_LF_CLOCK_HZ              (32768UL)
+
+#if !defined(MBEDTLS_ECP_ALT)
+#if !defined(MBEDTLS_ECP_FIXED_POINT_OPTIM) || (MBEDTLS_ECP_FIXED_POINT_OPTIM != 1)
+#error "CY_ECDSA_COMB requires MBEDTLS_ECP_FIXED_POINT_OPTIM"
+#endif
+
+CY_STATIC_ASSERT(sizeof(mbedtls_mpi_uint) == sizeof(uint32_t),
+                 "Comb tables are generated for 32-bit limbs");
+#endif /* !MBEDTLS_ECP_ALT */
+
+
+/*******************************************************************************
+* Function prototypes
+*******************************************************************************/
+int __real_mbedtls_ecdsa_read_signature(mbedtls_ecdsa_context *ctx,
+                                        const unsigned char *hash, size_t hlen,
+                                        const unsigned char *sig, size_t slen);
+int __wrap_mbedtls_ecdsa_read_signature(mbedtls_ecdsa_context *ctx,
+                                        const unsigned char *hash, size_t hlen,
+                                        const unsigned char *sig, size_t slen);
+
+
+#if !defined(MBEDTLS_ECP_ALT)
+/*******************************************************************************
+* Global variables
+*******************************************************************************/
+/* Points of the tables. The coordinates point to the limbs in flash. */
+static mbedtls_ecp_point g_points[CY_ECDSA_COMB_POINTS];
+#if ECDSA_COMB_HAVE_KEY
+static mbedtls_ecp_point q_points[CY_ECDSA_COMB_POINTS];
+#endif
+static const mbedtls_mpi_uint comb_one = 1U;
+static bool points_ready = false;
+
+/* Set when the tables cannot be trusted with this Mbed TLS build: every
+ * signature then goes through the generic path.
+ */
+static bool comb_disabled = false;
+
+
+/*******************************************************************************
+* Function Name: ecdsa_comb_const_mpi
+********************************************************************************
+* Summary:
+*  Makes an MPI refer to constant limbs, the way Mbed TLS loads the curve
+*  constants. Such an MPI must never be freed or written.
+*
+* Parameters:
+*  X - MPI to set
+*  limbs - little-endian limbs
+*  count - number of limbs
+*
+*******************************************************************************/
+static void ecdsa_comb_const_mpi(mbedtls_mpi *X, const uint32_t *limbs, size_t count)
+{
+    X->s = 1;
+    X->n = count;
+    X->p = (mbedtls_mpi_uint *)limbs;
+}
+
+
+/*******************************************************************************
+* Function Name: ecdsa_comb_load_points
+********************************************************************************
+* Summary:
+*  Sets up the points of the comb tables on first use, and checks once that
+*  the first point of the generator table is the generator of P-256. The comb
+*  path is disabled when it is not.
+*
+*******************************************************************************/
+static void ecdsa_comb_load_points(void)
+{
+    mbedtls_ecp_group grp;
+
+    if (points_ready)
+    {
+        return;
+    }
+
+    for (uint32_t i = 0; i < CY_ECDSA_COMB_POINTS; i++)
+    {
+        ecdsa_comb_const_mpi(&g_points[i].X, ecdsa_comb_g_table[i][0], CY_ECDSA_COMB_LIMBS);
+        ecdsa_comb_const_mpi(&g_points[i].Y, ecdsa_comb_g_table[i][1], CY_ECDSA_COMB_LIMBS);
+        ecdsa_comb_const_mpi(&g_points[i].Z, (const uint32_t *)&comb_one, 1U);
+#if ECDSA_COMB_HAVE_KEY
+        ecdsa_comb_const_mpi(&q_points[i].X, ecdsa_comb_q_table[i][0], CY_ECDSA_COMB_LIMBS);
+        ecdsa_comb_const_mpi(&q_points[i].Y, ecdsa_comb_q_table[i][1], CY_ECDSA_COMB_LIMBS);
+        ecdsa_comb_const_mpi(&q_points[i].Z, (const uint32_t *)&comb_one, 1U);
+#endif
+    }
+
+    mbedtls_ecp_group_init(&grp);
+
+    if ((0 != mbedtls_ecp_group_load(&grp, MBEDTLS_ECP_DP_SECP256R1)) ||
+        (0 != mbedtls_mpi_cmp_mpi(&grp.G.X, &g_points[0].X)) ||
+        (0 != mbedtls_mpi_cmp_mpi(&grp.G.Y, &g_points[0].Y)))
+    {
+        BOOT_LOG_WRN("ECDSA comb: generator table does not match, generic path used");
+        comb_disabled = true;
+    }
+
+    mbedtls_ecp_group_free(&grp);
+
+    points_ready = true;
+}
+
+
+/*******************************************************************************
+* Function Name: ecdsa_comb_mul
+********************************************************************************
+* Summary:
+*  Computes R = m * T[0] with a precomputed comb table T. Mbed TLS reuses the
+*  table of a group for multiplications of its generator, so the generator of
+*  a temporary P-256 group is set to T[0] and the table is attached to it.
+*
+* Parameters:
+*  R - result
+*  m - scalar
+*  table - comb table of the fixed point
+*
+* Return:
+*  int - 0 on success, Mbed TLS error code otherwise
+*
+*******************************************************************************/
+static int ecdsa_comb_mul(mbedtls_ecp_point *R, const mbedtls_mpi *m,
+                          mbedtls_ecp_point *table)
+{
+    mbedtls_ecp_group grp;
+    int ret;
+
+    mbedtls_ecp_group_init(&grp);
+
+    ret = mbedtls_ecp_group_load(&grp, MBEDTLS_ECP_DP_SECP256R1);
+
+    if (0 == ret)
+    {
+        /* The curve constants are static (grp.h == 1), so G is not freed. */
+        grp.G = table[0];
+        grp.T = table;
+        grp.T_size = CY_ECDSA_COMB_POINTS;
+
+        ret = mbedtls_ecp_mul(&grp, R, m, &grp.G, NULL, NULL);
+
+        grp.T = NULL;
+        grp.T_size = 0U;
+    }
+
+    mbedtls_ecp_group_free(&grp);
+
+    return ret;
+}
+
+
+/*******************************************************************************
+* Function Name: ecdsa_comb_key_matches
+********************************************************************************
+* Summary:
+*  Checks whether a public key is the one the key table was generated for.
+*
+* Parameters:
+*  Q - public key
+*
+* Return:
+*  bool - true if the key table can be used for Q
+*
+*******************************************************************************/
+static bool ecdsa_comb_key_matches(const mbedtls_ecp_point *Q)
+{
+#if ECDSA_COMB_HAVE_KEY
+    return (0 == mbedtls_mpi_cmp_mpi(&Q->X, &q_points[0].X)) &&
+           (0 == mbedtls_mpi_cmp_mpi(&Q->Y, &q_points[0].Y)) &&
+           (0 == mbedtls_mpi_cmp_int(&Q->Z, 1));
+#else
+    (void)Q;
+    return false;
+#endif
+}
+
+
+/*******************************************************************************
+* Function Name: ecdsa_comb_verify
+********************************************************************************
+* Summary:
+*  Verifies an ECDSA P-256 signature (SEC1 4.1.4). u1 * G always uses the
+*  generator table; u2 * Q uses the key table when Q is the image-signing key.
+*
+* Parameters:
+*  Q - public key
+*  buf - message hash
+*  blen - length of the hash
+*  r - first part of the signature
+*  s - second part of the signature
+*
+* Return:
+*  int - 0 if valid, MBEDTLS_ERR_ECP_VERIFY_FAILED if not, other Mbed TLS
+*        error codes on failure
+*
+*******************************************************************************/
+static int ecdsa_comb_verify(const mbedtls_ecp_point *Q, const unsigned char *buf,
+                             size_t blen, const mbedtls_mpi *r, const mbedtls_mpi *s)
+{
+    mbedtls_ecp_group grp;
+    mbedtls_ecp_point R, R1, R2;
+    mbedtls_mpi e, s_inv, u1, u2, one;
+    size_t n_size;
+    int ret;
+
+    mbedtls_ecp_group_init(&grp);
+    mbedtls_ecp_point_init(&R);
+    mbedtls_ecp_point_init(&R1);
+    mbedtls_ecp_point_init(&R2);
+    mbedtls_mpi_init(&e);
+    mbedtls_mpi_init(&s_inv);
+    mbedtls_mpi_init(&u1);
+    mbedtls_mpi_init(&u2);
+    mbedtls_mpi_init(&one);
+
+    MBEDTLS_MPI_CHK(mbedtls_ecp_group_load(&grp, MBEDTLS_ECP_DP_SECP256R1));
+
+    /* Step 1: r and s must be in [1, n-1] */
+    if ((mbedtls_mpi_cmp_int(r, 1) < 0) || (mbedtls_mpi_cmp_mpi(r, &grp.N) >= 0) ||
+        (mbedtls_mpi_cmp_int(s, 1) < 0) || (mbedtls_mpi_cmp_mpi(s, &grp.N) >= 0))
+    {
+        ret = MBEDTLS_ERR_ECP_VERIFY_FAILED;
+        goto cleanup;
+    }
+
+    /* Step 3: derive the integer e from the hash (no shift for 256 bits) */
+    n_size = (grp.nbits + 7U) / 8U;
+    MBEDTLS_MPI_CHK(mbedtls_mpi_read_binary(&e, buf, (blen > n_size) ? n_size : blen));
+    if (mbedtls_mpi_cmp_mpi(&e, &grp.N) >= 0)
+    {
+        MBEDTLS_MPI_CHK(mbedtls_mpi_sub_mpi(&e, &e, &grp.N));
+    }
+
+    /* Step 4: u1 = e / s mod n, u2 = r / s mod n */
+    MBEDTLS_MPI_CHK(mbedtls_mpi_inv_mod(&s_inv, s, &grp.N));
+    MBEDTLS_MPI_CHK(mbedtls_mpi_mul_mpi(&u1, &e, &s_inv));
+    MBEDTLS_MPI_CHK(mbedtls_mpi_mod_mpi(&u1, &u1, &grp.N));
+    MBEDTLS_MPI_CHK(mbedtls_mpi_mul_mpi(&u2, r, &s_inv));
+    MBEDTLS_MPI_CHK(mbedtls_mpi_mod_mpi(&u2, &u2, &grp.N));
+
+    /* Step 5: R = u1 G + u2 Q */
+    MBEDTLS_MPI_CHK(ecdsa_comb_mul(&R1, &u1, g_points));
+
+    if (ecdsa_comb_key_matches(Q))
+    {
+#if ECDSA_COMB_HAVE_KEY
+        MBEDTLS_MPI_CHK(ecdsa_comb_mul(&R2, &u2, q_points));
+#endif
+    }
+    else
+    {
+        MBEDTLS_MPI_CHK(mbedtls_ecp_mul(&grp, &R2, &u2, Q, NULL, NULL));
+    }
+
+    MBEDTLS_MPI_CHK(mbedtls_mpi_lset(&one, 1));
+    MBEDTLS_MPI_CHK(mbedtls_ecp_muladd(&grp, &R, &one, &R1, &one, &R2));
+
+    if (mbedtls_ecp_is_zero(&R))
+    {
+        ret = MBEDTLS_ERR_ECP_VERIFY_FAILED;
+        goto cleanup;
+    }
+
+    /* Steps 6 and 7: v = R.x mod n, valid if v == r */
+    MBEDTLS_MPI_CHK(mbedtls_mpi_mod_mpi(&R.X, &R.X, &grp.N));
+
+    if (0 != mbedtls_mpi_cmp_mpi(&R.X, r))
+    {
+        ret = MBEDTLS_ERR_ECP_VERIFY_FAILED;
+    }
+
+cleanup:
+    mbedtls_ecp_group_free(&grp);
+    mbedtls_ecp_point_free(&R);
+    mbedtls_ecp_point_free(&R1);
+    mbedtls_ecp_point_free(&R2);
+    mbedtls_mpi_free(&e);
+    mbedtls_mpi_free(&s_inv);
+    mbedtls_mpi_free(&u1);
+    mbedtls_mpi_free(&u2);
+    mbedtls_mpi_free(&one);
+
+    return ret;
+}
+
+
+#if defined(CY_ECDSA_COMB_BENCHMARK)
+/*******************************************************************************
+* Function Name: ecdsa_comb_timer_start
+********************************************************************************
+* Summary:
+*  Starts the cycle measurement. CM4 uses the DWT cycle counter. CM0+ has no
+*  cycle counter, so SysTick is run from the 32 kHz LF clock and the cycles
+*  are estimated from SystemCoreClock.
+*
+*******************************************************************************/
+static void ecdsa_comb_timer_start(void)
+{
+#if (__CORTEX_M >= 3U)
+    CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk;
+    DWT->CYCCNT = 0U;
+    DWT->CTRL |= DWT_CTRL_CYCCNTENA_Msk;
+#else
+    Cy_SysTick_SetClockSource(CY_SYSTICK_CLOCK_SOURCE_CLK_LF);
+    SysTick->LOAD = SysTick_LOAD_RELOAD_Msk;
+    SysTick->VAL = 0U;
+    SysTick->CTRL |= SysTick_CTRL_ENABLE_Msk;
+#endif
+}
+
+
+/*******************************************************************************
+* Function Name: ecdsa_comb_timer_cycles
+********************************************************************************
+* Summary:
+*  Returns the CPU cycles since ecdsa_comb_timer_start().
+*
+* Return:
+*  uint32_t - elapsed cycles
+*
+*******************************************************************************/
+static uint32_t ecdsa_comb_timer_cycles(void)
+{
+#if (__CORTEX_M >= 3U)
+    return DWT->CYCCNT;
+#else
+    uint32_t ticks = SysTick_LOAD_RELOAD_Msk - SysTick->VAL;
+
+    SysTick->CTRL &= ~SysTick_CTRL_ENABLE_Msk;
+
+    return (uint32_t)(((uint64_t)ticks * SystemCoreClock) / ECDSA_COMB_LF_CLOCK_HZ);
+#endif
+}
+#endif /* CY_ECDSA_COMB_BENCHMARK */
+#endif /* !MBEDTLS_ECP_ALT */
+
+
+/*******************************************************************************
+* Function Name: __wrap_mbedtls_ecdsa_read_signature
+********************************************************************************
+* Summary:
+*  Verifies a DER-encoded ECDSA signature. P-256 signatures are verified with
+*  the precomputed comb tables; everything else, and any failure, goes
+*  through the generic Mbed TLS path. A signature the comb path rejects is
+*  checked again by the generic path: tables that do not match the Mbed TLS
+*  build (window size, key) give wrong products, and must not reject a valid
+*  image. When the generic path accepts it, the comb path is disabled.
+*
+* Parameters:
+*  ctx - ECDSA context holding the group and the public key
+*  hash - message hash
+*  hlen - length of the hash
+*  sig - DER-encoded signature
+*  slen - length of the signature
+*
+* Return:
+*  int - 0 if valid, Mbed TLS error code otherwise
+*
+*******************************************************************************/
+int __wrap_mbedtls_ecdsa_read_signature(mbedtls_ecdsa_context *ctx,
+                                        const unsigned char *hash, size_t hlen,
+                                        const unsigned char *sig, size_t slen)
+{
+#if !defined(MBEDTLS_ECP_ALT)
+    unsigned char *p = (unsigned char *)sig;
+    const unsigned char *end = sig + slen;
+    mbedtls_mpi r, s;
+    size_t len;
+    int ret;
+
+    ecdsa_comb_load_points();
+
+    if ((MBEDTLS_ECP_DP_SECP256R1 != ctx->grp.id) || comb_disabled)
+    {
+        return __real_mbedtls_ecdsa_read_signature(ctx, hash, hlen, sig, slen);
+    }
+
+    mbedtls_mpi_init(&r);
+    mbedtls_mpi_init(&s);
+
+    /* Malformed signatures are reported by the generic path. */
+    ret = mbedtls_asn1_get_tag(&p, end, &len,
+                               MBEDTLS_ASN1_CONSTRUCTED | MBEDTLS_ASN1_SEQUENCE);
+
+    if ((0 == ret) && ((p + len) == end) &&
+        (0 == mbedtls_asn1_get_mpi(&p, end, &r)) &&
+        (0 == mbedtls_asn1_get_mpi(&p, end, &s)) &&
+        (p == end))
+    {
+#if defined(CY_ECDSA_COMB_BENCHMARK)
+        uint32_t comb_cycles;
+        uint32_t generic_cycles;
+        int generic_ret;
+
+        ecdsa_comb_timer_start();
+#endif
+        ret = ecdsa_comb_verify(&ctx->Q, hash, hlen, &r, &s);
+
+#if defined(CY_ECDSA_COMB_BENCHMARK)
+        comb_cycles = ecdsa_comb_timer_cycles();
+
+        ecdsa_comb_timer_start();
+        generic_ret = __real_mbedtls_ecdsa_read_signature(ctx, hash, hlen, sig, slen);
+        generic_cycles = ecdsa_comb_timer_cycles();
+
+        BOOT_LOG_INF("ECDSA verify: comb %u cycles, generic %u cycles%s",
+                     (unsigned int)comb_cycles, (unsigned int)generic_cycles,
+                     (ecdsa_comb_key_matches(&ctx->Q)) ? "" : " (no key table)");
+
+        if (generic_ret != ret)
+        {
+            BOOT_LOG_ERR("ECDSA verify: comb result %d, generic result %d",
+                         ret, generic_ret);
+        }
+#endif /* CY_ECDSA_COMB_BENCHMARK */
+    }
+    else
+    {
+        ret = -1;
+    }
+
+    mbedtls_mpi_free(&r);
+    mbedtls_mpi_free(&s);
+
+    if (0 == ret)
+    {
+        return ret;
+    }
+
+    if (MBEDTLS_ERR_ECP_VERIFY_FAILED == ret)
+    {
+        ret = __real_mbedtls_ecdsa_read_signature(ctx, hash, hlen, sig, slen);
+
+        if (0 == ret)
+        {
+            BOOT_LOG_WRN("ECDSA comb: tables do not match Mbed TLS, generic path used");
+            comb_disabled = true;
+        }
+
+        return ret;
+    }
+#endif /* !MBEDTLS_ECP_ALT */
+
+    return __real_mbedtls_ecdsa_read_signature(ctx, hash, hlen, sig, slen);
+}
+
+#endif /* CY_ECDSA_COMB */
+
+
+/* [] END OF FILE */
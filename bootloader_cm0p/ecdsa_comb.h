@@ -0,0 +1,73 @@
+/******************************************************************************
+* File Name:   ecdsa_comb.h
+*
+* Description: This file contains the macros of the ECDSA P-256 verification
+* path that uses fixed-base comb tables precomputed at build time.
+*
+* Related Document: See README.md
+*
+*******************************************************************************
+* (c) 2020, Cypress Semiconductor Corporation. All rights reserved.
+*******************************************************************************
+* This software, including source code, documentation and related materials
+* ("Software"), is owned by Cypress Semiconductor Corporation or one of its
+* subsidiaries ("Cypress") and is protected by and subject to worldwide patent
+* protection (United States and foreign), United States copyright laws and
+* international treaty provisions. Therefore, you may use this Software only
+* as provided in the license agreement accompanying the software package from
+* which you obtained this Software ("EULA").
+*
+* If no EULA applies, Cypress hereby grants you a personal, non-exclusive,
+* non-transferable license to copy, modify, and compile the Software source
+* code solely for use in connection with Cypress's integrated circuit products.
+* Any reproduction, modification, translation, compilation, or representation
+* of this Software except as specified above is prohibited without the express
+* written permission of Cypress.
+*
+* Disclaimer: THIS SOFTWARE IS PROVIDED AS-IS, WITH NO WARRANTY OF ANY KIND,
+* EXPRESS OR IMPLIED, INCLUDING, BUT NOT LIMITED TO, NONINFRINGEMENT, IMPLIED
+* WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE. Cypress
+* reserves the right to make changes to the Software without notice. Cypress
+* does not assume any liability arising out of the application or use of the
+* Software or any product or circuit described in the Software. Cypress does
+* not authorize its products for use in any products where a malfunction or
+* failure of the Cypress product may reasonably be expected to result in
+* significant property damage, injury or death ("High Risk Product"). By
+* including Cypress's product in a High Risk Product, the manufacturer of such
+* system or application assumes all risk of such use and in doing so agrees to
+* indemnify Cypress against all liability.
+*******************************************************************************/
+#ifndef ECDSA_COMB_H
+#define ECDSA_COMB_H
+
+#include "mbedtls/ecp.h"
+
+
+/*******************************************************************************
+* Macros
+*******************************************************************************/
+/* Comb window used by ecp_mul_comb() of Mbed TLS for a fixed P-256 point. The
+ * precomputed tables are only picked up by Mbed TLS when they have this size.
+ */
+#if (MBEDTLS_ECP_WINDOW_SIZE >= 5)
+#define CY_ECDSA_COMB_WINDOW                (5)
+#elif (MBEDTLS_ECP_WINDOW_SIZE == 4)
+#define CY_ECDSA_COMB_WINDOW                (4)
+#else
+#error "CY_ECDSA_COMB requires MBEDTLS_ECP_WINDOW_SIZE of 4 or more"
+#endif
+
+/* Number of points in one comb table */
+#define CY_ECDSA_COMB_POINTS                (1U << (CY_ECDSA_COMB_WINDOW - 1))
+
+/* Number of 32-bit limbs of a P-256 coordinate */
+#define CY_ECDSA_COMB_LIMBS                 (8U)
+
+/* Define CY_ECDSA_COMB_BENCHMARK to also run the generic Mbed TLS verification
+ * for every signature and print the cycles taken by both paths.
+ */
+
+#endif /* ECDSA_COMB_H */
+
+
+/* [] END OF FILE */
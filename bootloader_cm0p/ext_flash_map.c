@@ -194,5 +194,23 @@ struct flash_area *boot_area_descs[] =
     NULL
 };
 
+#if defined(CY_BOOT_USE_EXTERNAL_FLASH) && defined(CY_BOOT_USE_SLOT_RING)
+/*******************************************************************************
+* Function Name: flash_map_set_secondary_off
+********************************************************************************
+* Summary:
+*  Moves the secondary slot to another slot of the ring in the external flash.
+*  See slot_ring.c.
+*
+* Parameters:
+*  off - memory-mapped address of the new secondary slot
+*
+*******************************************************************************/
+void flash_map_set_secondary_off(uint32_t off)
+{
+    secondary_1.fa_off = off;
+}
+#endif /* CY_BOOT_USE_EXTERNAL_FLASH && CY_BOOT_USE_SLOT_RING */
+
 #endif /* CY_FLASH_MAP_EXT_DESC */
 
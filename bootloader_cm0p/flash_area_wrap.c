@@ -0,0 +1,350 @@
+/******************************************************************************
+* File Name:   flash_area_wrap.c
+*
+* Description: This file interposes the flash map backend used by MCUboot
+* (bootutil) and by the OTA PAL. The functions below are reached through the
+* linker option -Wl,--wrap=<function> (see FLASH_AREA_WRAP_LDFLAGS in
+* shared_config.mk) and forward to the original implementation in
+* cy_flash_map.c through the __real_ symbols. In the OTA app, the wrapped
+* read, write, and erase are defined by ota_cm4/sources/ota_flash_wrap.c,
+* which calls the flash_area_wrap_ functions below after its own
+* interpositions.
+*
+* Related Document: See README.md
+*
+*******************************************************************************
+* (c) 2020, Cypress Semiconductor Corporation. All rights reserved.
+*******************************************************************************
+* This software, including source code, documentation and related materials
+* ("Software"), is owned by Cypress Semiconductor Corporation or one of its
+* subsidiaries ("Cypress") and is protected by and subject to worldwide patent
+* protection (United States and foreign), United States copyright laws and
+* international treaty provisions. Therefore, you may use this Software only
+* as provided in the license agreement accompanying the software package from
+* which you obtained this Software ("EULA").
+*
+* If no EULA applies, Cypress hereby grants you a personal, non-exclusive,
+* non-transferable license to copy, modify, and compile the Software source
+* code solely for use in connection with Cypress's integrated circuit products.
+* Any reproduction, modification, translation, compilation, or representation
+* of this Software except as specified above is prohibited without the express
+* written permission of Cypress.
+*
+* Disclaimer: THIS SOFTWARE IS PROVIDED AS-IS, WITH NO WARRANTY OF ANY KIND,
+* EXPRESS OR IMPLIED, INCLUDING, BUT NOT LIMITED TO, NONINFRINGEMENT, IMPLIED
+* WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE. Cypress
+* reserves the right to make changes to the Software without notice. Cypress
+* does not assume any liability arising out of the application or use of the
+* Software or any product or circuit described in the Software. Cypress does
+* not authorize its products for use in any products where a malfunction or
+* failure of the Cypress product may reasonably be expected to result in
+* significant property damage, injury or death ("High Risk Product"). By
+* including Cypress's product in a High Risk Product, the manufacturer of such
+* system or application assumes all risk of such use and in doing so agrees to
+* indemnify Cypress against all liability.
+*******************************************************************************/
+
+#include <string.h>
+#include "cy_pdl.h"
+#include "flash_map_backend/flash_map_backend.h"
+#include "trailer_log.h"
+#include "flash_read_cache.h"
+#include "slot_ring.h"
+#include "flash_area_wrap.h"
+
+
+/*******************************************************************************
+* Function prototypes
+*******************************************************************************/
+int __real_flash_area_read(const struct flash_area *fa, uint32_t off,
+                           void *dst, uint32_t len);
+int __real_flash_area_write(const struct flash_area *fa, uint32_t off,
+                            const void *src, uint32_t len);
+int __real_flash_area_erase(const struct flash_area *fa, uint32_t off,
+                            uint32_t len);
+
+int __wrap_flash_area_read(const struct flash_area *fa, uint32_t off,
+                           void *dst, uint32_t len);
+int __wrap_flash_area_write(const struct flash_area *fa, uint32_t off,
+                            const void *src, uint32_t len);
+int __wrap_flash_area_erase(const struct flash_area *fa, uint32_t off,
+                            uint32_t len);
+int __wrap_flash_area_read_is_empty(const struct flash_area *fa, uint32_t off,
+                                    void *dst, uint32_t len);
+
+
+/*******************************************************************************
+* Function Name: flash_area_read_uncached
+********************************************************************************
+* Summary:
+*  Reads from a flash area. The part of the range that falls into the emulated
+*  trailer is served from the trailer log, and the part of the logical
+*  trailer sector whose erase is deferred reads as erased.
+*
+* Parameters:
+*  fa - flash area
+*  off - offset within the flash area
+*  dst - destination buffer
+*  len - number of bytes to read
+*
+* Return:
+*  int - 0 on success, non-zero otherwise
+*
+*******************************************************************************/
+static int flash_area_read_uncached(const struct flash_area *fa, uint32_t off,
+                                    void *dst, uint32_t len)
+{
+#if defined(CY_BOOT_USE_TRAILER_LOG)
+    if (trailer_log_covers(fa, off, len))
+    {
+        uint32_t region_off = trailer_log_region_off(fa);
+        uint32_t erased_off = trailer_log_erased_off(fa);
+        uint32_t head = (off < erased_off) ? (erased_off - off) : 0U;
+        uint32_t start = off + head;
+        uint32_t end = ((off + len) < region_off) ? (off + len) : region_off;
+        uint32_t erased = (start < end) ? (end - start) : 0U;
+        int rc = 0;
+
+        if (head > 0U)
+        {
+            rc = __real_flash_area_read(fa, off, dst, head);
+        }
+
+        memset((uint8_t *)dst + head, flash_area_erased_val(fa), erased);
+
+        if ((0 == rc) && ((head + erased) < len))
+        {
+            rc = trailer_log_read(start + erased - region_off,
+                                  (uint8_t *)dst + head + erased, len - head - erased);
+        }
+
+        return rc;
+    }
+#endif /* CY_BOOT_USE_TRAILER_LOG */
+
+    return __real_flash_area_read(fa, off, dst, len);
+}
+
+
+/*******************************************************************************
+* Function Name: flash_area_wrap_read
+********************************************************************************
+* Summary:
+*  Reads from a flash area, through the read cache when it is enabled.
+*
+* Parameters:
+*  fa - flash area
+*  off - offset within the flash area
+*  dst - destination buffer
+*  len - number of bytes to read
+*
+* Return:
+*  int - 0 on success, non-zero otherwise
+*
+*******************************************************************************/
+int flash_area_wrap_read(const struct flash_area *fa, uint32_t off,
+                         void *dst, uint32_t len)
+{
+#if defined(CY_BOOT_USE_READ_CACHE)
+    return flash_read_cache_read(fa, off, dst, len, flash_area_read_uncached);
+#else
+    return flash_area_read_uncached(fa, off, dst, len);
+#endif /* CY_BOOT_USE_READ_CACHE */
+}
+
+
+/*******************************************************************************
+* Function Name: flash_area_wrap_write
+********************************************************************************
+* Summary:
+*  Writes to a flash area. The part of the range that falls into the emulated
+*  trailer is written to the trailer log. A deferred erase of the logical
+*  trailer sector is done before the sector is written. Cached lines
+*  overlapping the range are dropped first.
+*
+* Parameters:
+*  fa - flash area
+*  off - offset within the flash area
+*  src - source buffer
+*  len - number of bytes to write
+*
+* Return:
+*  int - 0 on success, non-zero otherwise
+*
+*******************************************************************************/
+int flash_area_wrap_write(const struct flash_area *fa, uint32_t off,
+                          const void *src, uint32_t len)
+{
+#if defined(CY_BOOT_USE_READ_CACHE)
+    flash_read_cache_invalidate(fa, off, len);
+#endif /* CY_BOOT_USE_READ_CACHE */
+
+#if defined(CY_BOOT_USE_TRAILER_LOG)
+    if (0 != trailer_log_flush(fa, off, len, __real_flash_area_erase))
+    {
+        return -1;
+    }
+
+    if (trailer_log_covers(fa, off, len))
+    {
+        uint32_t region_off = trailer_log_region_off(fa);
+        uint32_t head = (off < region_off) ? (region_off - off) : 0U;
+        int rc = 0;
+
+        if (head > 0U)
+        {
+            rc = __real_flash_area_write(fa, off, src, head);
+        }
+
+        if (0 == rc)
+        {
+            rc = trailer_log_write(off + head - region_off,
+                                   (const uint8_t *)src + head, len - head);
+        }
+
+        return rc;
+    }
+#endif /* CY_BOOT_USE_TRAILER_LOG */
+
+    return __real_flash_area_write(fa, off, src, len);
+}
+
+
+/*******************************************************************************
+* Function Name: flash_area_wrap_erase
+********************************************************************************
+* Summary:
+*  Erases a range of a flash area. Erases of the logical sector holding the
+*  trailer are handled by the trailer log without a uniform sector erase, or
+*  deferred to the next write of the sector.
+*  The header of an image retained in the slot ring is not erased, nor the
+*  end of its last sector but for the trailer. Cached lines overlapping the
+*  range are dropped first.
+*
+* Parameters:
+*  fa - flash area
+*  off - offset within the flash area
+*  len - length of the range
+*
+* Return:
+*  int - 0 on success, non-zero otherwise
+*
+*******************************************************************************/
+int flash_area_wrap_erase(const struct flash_area *fa, uint32_t off,
+                          uint32_t len)
+{
+#if defined(CY_BOOT_USE_READ_CACHE)
+    flash_read_cache_invalidate(fa, off, len);
+#endif /* CY_BOOT_USE_READ_CACHE */
+
+#if defined(CY_BOOT_USE_SLOT_RING)
+    if (slot_ring_keeps(fa, off, len))
+    {
+        bool kept = false;
+
+        /* Only the trailer in the range, if any, is cleared */
+        return trailer_log_erase(fa, off, len, false, &kept);
+    }
+#endif /* CY_BOOT_USE_SLOT_RING */
+
+#if defined(CY_BOOT_USE_TRAILER_LOG)
+    bool handled = false;
+    int rc = trailer_log_erase(fa, off, len, true, &handled);
+
+    if ((0 != rc) || handled)
+    {
+        return rc;
+    }
+#endif /* CY_BOOT_USE_TRAILER_LOG */
+
+    return __real_flash_area_erase(fa, off, len);
+}
+
+
+#if !defined(CY_OTA_FLASH_WRAP)
+/*******************************************************************************
+* Function Name: __wrap_flash_area_read
+********************************************************************************
+* Summary:
+*  Reads from a flash area, see flash_area_wrap_read().
+*
+*******************************************************************************/
+int __wrap_flash_area_read(const struct flash_area *fa, uint32_t off,
+                           void *dst, uint32_t len)
+{
+    return flash_area_wrap_read(fa, off, dst, len);
+}
+
+
+/*******************************************************************************
+* Function Name: __wrap_flash_area_write
+********************************************************************************
+* Summary:
+*  Writes to a flash area, see flash_area_wrap_write().
+*
+*******************************************************************************/
+int __wrap_flash_area_write(const struct flash_area *fa, uint32_t off,
+                            const void *src, uint32_t len)
+{
+    return flash_area_wrap_write(fa, off, src, len);
+}
+
+
+/*******************************************************************************
+* Function Name: __wrap_flash_area_erase
+********************************************************************************
+* Summary:
+*  Erases a range of a flash area, see flash_area_wrap_erase().
+*
+*******************************************************************************/
+int __wrap_flash_area_erase(const struct flash_area *fa, uint32_t off,
+                            uint32_t len)
+{
+    return flash_area_wrap_erase(fa, off, len);
+}
+#endif /* !CY_OTA_FLASH_WRAP */
+
+
+/*******************************************************************************
+* Function Name: __wrap_flash_area_read_is_empty
+********************************************************************************
+* Summary:
+*  Reads from a flash area and checks whether the range is erased. The
+*  original implementation calls flash_area_read() from within cy_flash_map.c,
+*  which the linker does not redirect, so it is re-implemented here on top of
+*  the wrapped read, which in the OTA app is the one of ota_flash_wrap.c.
+*
+* Parameters:
+*  fa - flash area
+*  off - offset within the flash area
+*  dst - destination buffer
+*  len - number of bytes to read
+*
+* Return:
+*  int - 1 if the range is erased, 0 if not, negative on error
+*
+*******************************************************************************/
+int __wrap_flash_area_read_is_empty(const struct flash_area *fa, uint32_t off,
+                                    void *dst, uint32_t len)
+{
+    uint8_t erased_val = flash_area_erased_val(fa);
+    const uint8_t *bytes = (const uint8_t *)dst;
+
+    if (0 != __wrap_flash_area_read(fa, off, dst, len))
+    {
+        return -1;
+    }
+
+    for (uint32_t i = 0; i < len; i++)
+    {
+        if (bytes[i] != erased_val)
+        {
+            return 0;
+        }
+    }
+
+    return 1;
+}
+
+
+/* [] END OF FILE */
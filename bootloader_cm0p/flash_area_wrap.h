@@ -0,0 +1,60 @@
+/******************************************************************************
+* File Name:   flash_area_wrap.h
+*
+* Description: This file contains the function declarations of the flash map
+* backend interposed by the trailer log, the read cache, and the slot ring.
+*
+* Related Document: See README.md
+*
+*******************************************************************************
+* (c) 2020, Cypress Semiconductor Corporation. All rights reserved.
+*******************************************************************************
+* This software, including source code, documentation and related materials
+* ("Software"), is owned by Cypress Semiconductor Corporation or one of its
+* subsidiaries ("Cypress") and is protected by and subject to worldwide patent
+* protection (United States and foreign), United States copyright laws and
+* international treaty provisions. Therefore, you may use this Software only
+* as provided in the license agreement accompanying the software package from
+* which you obtained this Software ("EULA").
+*
+* If no EULA applies, Cypress hereby grants you a personal, non-exclusive,
+* non-transferable license to copy, modify, and compile the Software source
+* code solely for use in connection with Cypress's integrated circuit products.
+* Any reproduction, modification, translation, compilation, or representation
+* of this Software except as specified above is prohibited without the express
+* written permission of Cypress.
+*
+* Disclaimer: THIS SOFTWARE IS PROVIDED AS-IS, WITH NO WARRANTY OF ANY KIND,
+* EXPRESS OR IMPLIED, INCLUDING, BUT NOT LIMITED TO, NONINFRINGEMENT, IMPLIED
+* WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE. Cypress
+* reserves the right to make changes to the Software without notice. Cypress
+* does not assume any liability arising out of the application or use of the
+* Software or any product or circuit described in the Software. Cypress does
+* not authorize its products for use in any products where a malfunction or
+* failure of the Cypress product may reasonably be expected to result in
+* significant property damage, injury or death ("High Risk Product"). By
+* including Cypress's product in a High Risk Product, the manufacturer of such
+* system or application assumes all risk of such use and in doing so agrees to
+* indemnify Cypress against all liability.
+*******************************************************************************/
+#ifndef FLASH_AREA_WRAP_H
+#define FLASH_AREA_WRAP_H
+
+#include <stdint.h>
+#include "flash_map_backend/flash_map_backend.h"
+
+
+/*******************************************************************************
+* Function prototypes
+*******************************************************************************/
+int flash_area_wrap_read(const struct flash_area *fa, uint32_t off,
+                         void *dst, uint32_t len);
+int flash_area_wrap_write(const struct flash_area *fa, uint32_t off,
+                          const void *src, uint32_t len);
+int flash_area_wrap_erase(const struct flash_area *fa, uint32_t off,
+                          uint32_t len);
+
+#endif /* FLASH_AREA_WRAP_H */
+
+
+/* [] END OF FILE */
@@ -0,0 +1,326 @@
+/******************************************************************************
+* File Name:   flash_read_cache.c
+*
+* Description: This file implements a small block read cache for the
+* bootloader. MCUboot reads the image header, the TLV area and the trailer of
+* the same slot several times during one boot_go() call. On the external flash
+* every read is a separate SMIF transaction. The cache keeps a few
+* CY_READ_CACHE_LINE_SIZE lines of the external flash and is invalidated by
+* every write and erase that goes through the flash map backend.
+*
+* Related Document: See README.md
+*
+*******************************************************************************
+* (c) 2020, Cypress Semiconductor Corporation. All rights reserved.
+*******************************************************************************
+* This software, including source code, documentation and related materials
+* ("Software"), is owned by Cypress Semiconductor Corporation or one of its
+* subsidiaries ("Cypress") and is protected by and subject to worldwide patent
+* protection (United States and foreign), United States copyright laws and
+* international treaty provisions. Therefore, you may use this Software only
+* as provided in the license agreement accompanying the software package from
+* which you obtained this Software ("EULA").
+*
+* If no EULA applies, Cypress hereby grants you a personal, non-exclusive,
+* non-transferable license to copy, modify, and compile the Software source
+* code solely for use in connection with Cypress's integrated circuit products.
+* Any reproduction, modification, translation, compilation, or representation
+* of this Software except as specified above is prohibited without the express
+* written permission of Cypress.
+*
+* Disclaimer: THIS SOFTWARE IS PROVIDED AS-IS, WITH NO WARRANTY OF ANY KIND,
+* EXPRESS OR IMPLIED, INCLUDING, BUT NOT LIMITED TO, NONINFRINGEMENT, IMPLIED
+* WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE. Cypress
+* reserves the right to make changes to the Software without notice. Cypress
+* does not assume any liability arising out of the application or use of the
+* Software or any product or circuit described in the Software. Cypress does
+* not authorize its products for use in any products where a malfunction or
+* failure of the Cypress product may reasonably be expected to result in
+* significant property damage, injury or death ("High Risk Product"). By
+* including Cypress's product in a High Risk Product, the manufacturer of such
+* system or application assumes all risk of such use and in doing so agrees to
+* indemnify Cypress against all liability.
+*******************************************************************************/
+
+#include <string.h>
+#include <stdbool.h>
+#include "cy_pdl.h"
+#include "bootutil/bootutil_log.h"
+#include "flash_read_cache.h"
+
+#if defined(CY_BOOT_USE_READ_CACHE)
+
+/*******************************************************************************
+* Macros
+*******************************************************************************/
+#define READ_CACHE_LINE_MASK                (CY_READ_CACHE_LINE_SIZE - 1UL)
+
+CY_STATIC_ASSERT((CY_READ_CACHE_LINE_SIZE & READ_CACHE_LINE_MASK) == 0UL,
+                 "CY_READ_CACHE_LINE_SIZE must be a power of two");
+
+
+/*******************************************************************************
+* Data structure and enumeration
+*******************************************************************************/
+typedef struct
+{
+    bool     valid;
+    uint8_t  device_id;
+    uint32_t addr;          /* Absolute address of the first byte */
+    uint32_t len;           /* Number of valid bytes */
+    uint32_t last_use;      /* Used for LRU replacement */
+    uint8_t  data[CY_READ_CACHE_LINE_SIZE];
+} read_cache_line_t;
+
+
+/*******************************************************************************
+* Global variables
+*******************************************************************************/
+static read_cache_line_t cache_lines[CY_READ_CACHE_LINES];
+static uint32_t use_counter;
+static flash_read_cache_stats_t cache_stats;
+
+
+/*******************************************************************************
+* Function Name: read_cache_lookup
+********************************************************************************
+* Summary:
+*  Finds the line that holds the given absolute address.
+*
+* Parameters:
+*  device_id - flash device of the address
+*  addr - absolute address
+*
+* Return:
+*  read_cache_line_t* - the line, or NULL if not cached
+*
+*******************************************************************************/
+static read_cache_line_t *read_cache_lookup(uint8_t device_id, uint32_t addr)
+{
+    for (uint32_t i = 0; i < CY_READ_CACHE_LINES; i++)
+    {
+        read_cache_line_t *line = &cache_lines[i];
+
+        if (line->valid && (line->device_id == device_id) &&
+            (addr >= line->addr) && (addr < (line->addr + line->len)))
+        {
+            return line;
+        }
+    }
+
+    return NULL;
+}
+
+
+/*******************************************************************************
+* Function Name: read_cache_fill
+********************************************************************************
+* Summary:
+*  Loads the line containing the given offset of a flash area, replacing the
+*  least recently used line.
+*
+* Parameters:
+*  fa - flash area
+*  off - offset within the flash area
+*  fill - function used to read the uncached content
+*
+* Return:
+*  read_cache_line_t* - the filled line, or NULL on read error
+*
+*******************************************************************************/
+static read_cache_line_t *read_cache_fill(const struct flash_area *fa, uint32_t off,
+                                          flash_read_cache_fill_t fill)
+{
+    read_cache_line_t *victim = &cache_lines[0];
+    uint32_t line_off = off & ~READ_CACHE_LINE_MASK;
+    uint32_t len = CY_READ_CACHE_LINE_SIZE;
+
+    for (uint32_t i = 0; i < CY_READ_CACHE_LINES; i++)
+    {
+        if (!cache_lines[i].valid)
+        {
+            victim = &cache_lines[i];
+            break;
+        }
+
+        if (cache_lines[i].last_use < victim->last_use)
+        {
+            victim = &cache_lines[i];
+        }
+    }
+
+    if ((line_off + len) > fa->fa_size)
+    {
+        len = fa->fa_size - line_off;
+    }
+
+    victim->valid = false;
+    cache_stats.fills++;
+
+    if (0 != fill(fa, line_off, victim->data, len))
+    {
+        return NULL;
+    }
+
+    victim->valid = true;
+    victim->device_id = fa->fa_device_id;
+    victim->addr = fa->fa_off + line_off;
+    victim->len = len;
+
+    return victim;
+}
+
+
+/*******************************************************************************
+* Function Name: flash_read_cache_read
+********************************************************************************
+* Summary:
+*  Reads from a flash area through the cache. Only the external flash is
+*  cached; the internal flash is memory mapped and reading it is cheap.
+*
+* Parameters:
+*  fa - flash area
+*  off - offset within the flash area
+*  dst - destination buffer
+*  len - number of bytes to read
+*  fill - function used to read the uncached content
+*
+* Return:
+*  int - 0 on success, non-zero otherwise
+*
+*******************************************************************************/
+int flash_read_cache_read(const struct flash_area *fa, uint32_t off, void *dst,
+                          uint32_t len, flash_read_cache_fill_t fill)
+{
+    uint8_t *out = (uint8_t *)dst;
+    bool hit = true;
+
+    if ((fa->fa_device_id & FLASH_DEVICE_EXTERNAL_FLAG) == 0U)
+    {
+        return fill(fa, off, dst, len);
+    }
+
+    cache_stats.reads++;
+
+    if (len >= CY_READ_CACHE_LINE_SIZE)
+    {
+        cache_stats.bypassed++;
+        return fill(fa, off, dst, len);
+    }
+
+    while (len > 0U)
+    {
+        uint32_t addr = fa->fa_off + off;
+        read_cache_line_t *line = read_cache_lookup(fa->fa_device_id, addr);
+        uint32_t chunk;
+
+        if (NULL == line)
+        {
+            hit = false;
+            line = read_cache_fill(fa, off, fill);
+
+            if (NULL == line)
+            {
+                return -1;
+            }
+        }
+
+        chunk = line->addr + line->len - addr;
+        if (chunk > len)
+        {
+            chunk = len;
+        }
+
+        memcpy(out, &line->data[addr - line->addr], chunk);
+        line->last_use = ++use_counter;
+
+        out += chunk;
+        off += chunk;
+        len -= chunk;
+    }
+
+    if (hit)
+    {
+        cache_stats.hits++;
+    }
+
+    return 0;
+}
+
+
+/*******************************************************************************
+* Function Name: flash_read_cache_invalidate
+********************************************************************************
+* Summary:
+*  Drops every line that overlaps the given range of a flash area. Must be
+*  called for every write and erase.
+*
+* Parameters:
+*  fa - flash area
+*  off - offset within the flash area
+*  len - length of the range
+*
+*******************************************************************************/
+void flash_read_cache_invalidate(const struct flash_area *fa, uint32_t off,
+                                 uint32_t len)
+{
+    uint32_t start = fa->fa_off + off;
+    uint32_t end = start + len;
+
+    for (uint32_t i = 0; i < CY_READ_CACHE_LINES; i++)
+    {
+        read_cache_line_t *line = &cache_lines[i];
+
+        if (line->valid && (line->device_id == fa->fa_device_id) &&
+            (start < (line->addr + line->len)) && (end > line->addr))
+        {
+            line->valid = false;
+            cache_stats.invalidations++;
+        }
+    }
+}
+
+
+/*******************************************************************************
+* Function Name: flash_read_cache_get_stats
+********************************************************************************
+* Summary:
+*  Returns the read cache statistics since reset.
+*
+* Parameters:
+*  stats - destination of the statistics
+*
+*******************************************************************************/
+void flash_read_cache_get_stats(flash_read_cache_stats_t *stats)
+{
+    *stats = cache_stats;
+}
+
+
+/*******************************************************************************
+* Function Name: flash_read_cache_print_stats
+********************************************************************************
+* Summary:
+*  Prints the hit rate and the number of SMIF transactions saved.
+*
+* Parameters:
+*  boot_path - name of the boot path the statistics belong to
+*
+*******************************************************************************/
+void flash_read_cache_print_stats(const char *boot_path)
+{
+    uint32_t transactions = cache_stats.fills + cache_stats.bypassed;
+    uint32_t saved = (cache_stats.reads > transactions) ?
+                     (cache_stats.reads - transactions) : 0U;
+    uint32_t hit_rate = (cache_stats.reads > 0U) ?
+                        ((cache_stats.hits * 100U) / cache_stats.reads) : 0U;
+
+    BOOT_LOG_INF("Read cache (%s): %u reads, %u%% hits, %u SMIF transactions saved",
+                 boot_path, (unsigned int)cache_stats.reads,
+                 (unsigned int)hit_rate, (unsigned int)saved);
+}
+
+#endif /* CY_BOOT_USE_READ_CACHE */
+
+
+/* [] END OF FILE */
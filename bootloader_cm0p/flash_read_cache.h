@@ -0,0 +1,97 @@
+/******************************************************************************
+* File Name:   flash_read_cache.h
+*
+* Description: This file contains the macros and function declarations of the
+* block read cache placed between bootutil and the flash map backend.
+*
+* Related Document: See README.md
+*
+*******************************************************************************
+* (c) 2020, Cypress Semiconductor Corporation. All rights reserved.
+*******************************************************************************
+* This software, including source code, documentation and related materials
+* ("Software"), is owned by Cypress Semiconductor Corporation or one of its
+* subsidiaries ("Cypress") and is protected by and subject to worldwide patent
+* protection (United States and foreign), United States copyright laws and
+* international treaty provisions. Therefore, you may use this Software only
+* as provided in the license agreement accompanying the software package from
+* which you obtained this Software ("EULA").
+*
+* If no EULA applies, Cypress hereby grants you a personal, non-exclusive,
+* non-transferable license to copy, modify, and compile the Software source
+* code solely for use in connection with Cypress's integrated circuit products.
+* Any reproduction, modification, translation, compilation, or representation
+* of this Software except as specified above is prohibited without the express
+* written permission of Cypress.
+*
+* Disclaimer: THIS SOFTWARE IS PROVIDED AS-IS, WITH NO WARRANTY OF ANY KIND,
+* EXPRESS OR IMPLIED, INCLUDING, BUT NOT LIMITED TO, NONINFRINGEMENT, IMPLIED
+* WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE. Cypress
+* reserves the right to make changes to the Software without notice. Cypress
+* does not assume any liability arising out of the application or use of the
+* Software or any product or circuit described in the Software. Cypress does
+* not authorize its products for use in any products where a malfunction or
+* failure of the Cypress product may reasonably be expected to result in
+* significant property damage, injury or death ("High Risk Product"). By
+* including Cypress's product in a High Risk Product, the manufacturer of such
+* system or application assumes all risk of such use and in doing so agrees to
+* indemnify Cypress against all liability.
+*******************************************************************************/
+#ifndef FLASH_READ_CACHE_H
+#define FLASH_READ_CACHE_H
+
+#include <stdint.h>
+#include "flash_map_backend/flash_map_backend.h"
+
+
+/*******************************************************************************
+* Macros
+*******************************************************************************/
+/* Number of cache lines. */
+#ifndef CY_READ_CACHE_LINES
+#define CY_READ_CACHE_LINES                 (4UL)
+#endif
+
+/* Size of one cache line in bytes. Must be a power of two. Reads of this size
+ * or larger bypass the cache.
+ */
+#ifndef CY_READ_CACHE_LINE_SIZE
+#define CY_READ_CACHE_LINE_SIZE             (1024UL)
+#endif
+
+
+/*******************************************************************************
+* Data structure and enumeration
+*******************************************************************************/
+/* Reads the uncached content of a flash area. */
+typedef int (*flash_read_cache_fill_t)(const struct flash_area *fa, uint32_t off,
+                                       void *dst, uint32_t len);
+
+/* Read cache statistics. Every uncached flash_area_read() of the external
+ * flash is one SMIF transaction, so the transactions saved are the reads
+ * minus the line fills and the bypassed reads.
+ */
+typedef struct
+{
+    uint32_t reads;             /* flash_area_read() calls seen by the cache */
+    uint32_t hits;              /* Reads served without a line fill */
+    uint32_t fills;             /* Line fills (one SMIF transaction each) */
+    uint32_t bypassed;          /* Large reads passed through to the backend */
+    uint32_t invalidations;     /* Lines dropped because of writes or erases */
+} flash_read_cache_stats_t;
+
+
+/*******************************************************************************
+* Function prototypes
+*******************************************************************************/
+int flash_read_cache_read(const struct flash_area *fa, uint32_t off, void *dst,
+                          uint32_t len, flash_read_cache_fill_t fill);
+void flash_read_cache_invalidate(const struct flash_area *fa, uint32_t off,
+                                 uint32_t len);
+void flash_read_cache_get_stats(flash_read_cache_stats_t *stats);
+void flash_read_cache_print_stats(const char *boot_path);
+
+#endif /* FLASH_READ_CACHE_H */
+
+
+/* [] END OF FILE */
@@ -58,6 +58,14 @@
 #include "bootutil/sign_key.h"
 #include "bootutil/bootutil_log.h"
 
+#ifdef CY_BOOT_USE_READ_CACHE
+#include "flash_read_cache.h"
+#endif
+
+#ifdef CY_BOOT_USE_SLOT_RING
+#include "slot_ring.h"
+#endif
+
 
 /*******************************************************************************
 * Macros
@@ -165,8 +173,24 @@ int main(void)
     }
 #endif /* CY_BOOT_USE_EXTERNAL_FLASH */
 
+#ifdef CY_BOOT_USE_SLOT_RING
+    /* Select the ring slot to install, if any, before MCUboot runs. */
+    slot_ring_boot_prepare();
+#endif /* CY_BOOT_USE_SLOT_RING */
+
     result = boot_go(&rsp);
 
+#ifdef CY_BOOT_USE_SLOT_RING
+    if (CY_RSLT_SUCCESS == result)
+    {
+        slot_ring_boot_complete(rsp.br_hdr);
+    }
+#endif /* CY_BOOT_USE_SLOT_RING */
+
+#ifdef CY_BOOT_USE_READ_CACHE
+    flash_read_cache_print_stats((CY_RSLT_SUCCESS == result) ? "boot" : "no image");
+#endif /* CY_BOOT_USE_READ_CACHE */
+
     if (CY_RSLT_SUCCESS == result)
     {
         BOOT_LOG_INF("User Application validated successfully");
@@ -0,0 +1,188 @@
+# (c) 2020, Cypress Semiconductor Corporation. All rights reserved.
+# Licensed under the Apache License, Version 2.0 (the "License").
+# You may not use this file except in compliance with the License.
+# A copy of the License is located at
+#     http://www.apache.org/licenses/LICENSE-2.0
+# or in the "license" file accompanying this file. This file is distributed 
+# on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either 
+# express or implied. See the License for the specific language governing 
+# permissions and limitations under the License.
+#
+# Generates the fixed-base comb tables used by bootloader_cm0p/ecdsa_comb.c
+# for the P-256 generator and for the image-signing public key.
+#
+# The key is read from either
+#   - the C array written by "imgtool getpub" (keys/<SIGN_KEY_FILE>.pub), or
+#   - a C header holding the PEM code signer certificate
+#     (aws_ota_codesigner_certificate.h).
+# When no P-256 key is found, only the generator table is emitted.
+#
+# The tables follow the layout of ecp_precompute_comb() in Mbed TLS:
+#   T[i] = (1 + sum over the set bits k of i of 2^((k+1)*d)) * P
+# with d = ceil(256 / w), in affine coordinates.
+#
+# Usage: ecdsa_comb_gen.py <key file> <output header>
+
+import base64
+import os
+import re
+import sys
+
+P = 0xffffffff00000001000000000000000000000000ffffffffffffffffffffffff
+A = P - 3
+B = 0x5ac635d8aa3a93e7b3ebbd55769886bc651d06b0cc53b0f63bce3c3e27d2604b
+N = 0xffffffff00000000ffffffffffffffffbce6faada7179e84f3b9cac2fc632551
+GX = 0x6b17d1f2e12c4247f8bce6e563a440f277037d812deb33a0f4a13945d898c296
+GY = 0x4fe342e2fe1a7f9b8ee7eb4a7c0f9e162bce33576b315ececbb6406837bf51f5
+
+NBITS = 256
+WINDOWS = (4, 5)
+
+# id-ecPublicKey, prime256v1 and the BIT STRING of an uncompressed point
+EC_KEY_OIDS = bytes.fromhex("06072a8648ce3d0201" "06082a8648ce3d030107")
+EC_POINT_PREFIX = bytes.fromhex("03420004")
+
+
+def inv(x):
+    return pow(x, P - 2, P)
+
+
+def add(p1, p2):
+    if p1 is None:
+        return p2
+    if p2 is None:
+        return p1
+    x1, y1 = p1
+    x2, y2 = p2
+    if x1 == x2:
+        if (y1 + y2) % P == 0:
+            return None
+        lam = (3 * x1 * x1 + A) * inv(2 * y1) % P
+    else:
+        lam = (y2 - y1) * inv(x2 - x1) % P
+    x3 = (lam * lam - x1 - x2) % P
+    return (x3, (lam * (x1 - x3) - y1) % P)
+
+
+def mul(k, pt):
+    result = None
+    while k:
+        if k & 1:
+            result = add(result, pt)
+        pt = add(pt, pt)
+        k >>= 1
+    return result
+
+
+def on_curve(pt):
+    x, y = pt
+    return (y * y - (x * x * x + A * x + B)) % P == 0
+
+
+def comb_table(pt, w):
+    d = (NBITS + w - 1) // w
+    table = []
+    for i in range(1 << (w - 1)):
+        k = 1
+        for bit in range(w - 1):
+            if i & (1 << bit):
+                k += 1 << ((bit + 1) * d)
+        table.append(mul(k % N, pt))
+    return table
+
+
+def der_from_key_file(text):
+    if "BEGIN CERTIFICATE" in text:
+        body = "".join(re.findall(r'"([^"]*)"', text))
+        body = body.replace("\\n", "\n")
+        match = re.search(r"-----BEGIN CERTIFICATE-----(.*?)-----END CERTIFICATE-----",
+                          body, re.S)
+        if match is None:
+            return b""
+        return base64.b64decode("".join(match.group(1).split()))
+
+    array = re.search(r"\{(.*?)\}", text, re.S)
+    if array is None:
+        return b""
+    return bytes(int(b, 16) for b in re.findall(r"0x([0-9a-fA-F]{2})", array.group(1)))
+
+
+def find_p256_key(der):
+    start = der.find(EC_KEY_OIDS)
+    if start < 0:
+        return None
+    start = der.find(EC_POINT_PREFIX, start)
+    if start < 0 or len(der) < start + 4 + 64:
+        return None
+    raw = der[start + 4:start + 4 + 64]
+    pt = (int.from_bytes(raw[:32], "big"), int.from_bytes(raw[32:], "big"))
+    return pt if on_curve(pt) else None
+
+
+def limbs(value):
+    return ", ".join("0x%08xU" % ((value >> (32 * i)) & 0xffffffff) for i in range(8))
+
+
+def emit_table(out, name, table):
+    out.append("static const uint32_t %s[%d][2][8] =" % (name, len(table)))
+    out.append("{")
+    for x, y in table:
+        out.append("    {")
+        out.append("        { %s }," % limbs(x))
+        out.append("        { %s }" % limbs(y))
+        out.append("    },")
+    out.append("};")
+    out.append("")
+
+
+def main(argv):
+    if len(argv) != 3:
+        sys.stderr.write("Usage: %s <key file> <output header>\n" % argv[0])
+        return 1
+
+    try:
+        with open(argv[1], "r") as f:
+            key = find_p256_key(der_from_key_file(f.read()))
+    except (IOError, ValueError):
+        key = None
+
+    if key is None:
+        sys.stderr.write("ecdsa_comb_gen: no P-256 key in %s, "
+                         "generating the generator table only\n" % argv[1])
+
+    out = []
+    out.append("/* Generated by ecdsa_comb_gen.py from %s. Do not edit. */"
+               % os.path.basename(argv[1]))
+    out.append("#ifndef ECDSA_COMB_TABLES_H")
+    out.append("#define ECDSA_COMB_TABLES_H")
+    out.append("")
+    out.append("#include <stdint.h>")
+    out.append("")
+    out.append("#define ECDSA_COMB_HAVE_KEY                 (%d)" % (key is not None))
+    out.append("")
+
+    for i, w in enumerate(WINDOWS):
+        out.append("#%s (CY_ECDSA_COMB_WINDOW == %d)" % ("if" if i == 0 else "elif", w))
+        out.append("")
+        emit_table(out, "ecdsa_comb_g_table", comb_table((GX, GY), w))
+        if key is not None:
+            emit_table(out, "ecdsa_comb_q_table", comb_table(key, w))
+
+    out.append("#else")
+    out.append('#error "No comb table for this CY_ECDSA_COMB_WINDOW"')
+    out.append("#endif")
+    out.append("")
+    out.append("#endif /* ECDSA_COMB_TABLES_H */")
+
+    out_dir = os.path.dirname(argv[2])
+    if out_dir and not os.path.isdir(out_dir):
+        os.makedirs(out_dir)
+
+    with open(argv[2], "w") as f:
+        f.write("\n".join(out) + "\n")
+
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main(sys.argv))
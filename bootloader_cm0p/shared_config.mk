@@ -81,3 +81,46 @@ MCUBOOT_HEADER_SIZE=0x400
 # Add define to pick the custom flash map defined in
 # bootloader_cm0p/ext_flash_map.c.
 DEFINES+=CY_FLASH_MAP_EXT_DESC
+
+# Set to 1 to keep the trailer of the secondary slot (pending/confirmed state)
+# out of the external flash. The S25FL512S only erases 256 KB sectors, so the
+# trailer is either erased with the small parameter-sector erase of the device
+# (when available) or kept in a small log in internal flash.
+# See bootloader_cm0p/trailer_log.c.
+USE_TRAILER_LOG ?= 0
+
+# Flash map backend functions interposed by bootloader_cm0p/flash_area_wrap.c,
+# and in the OTA app by ota_cm4/sources/ota_flash_wrap.c on top of it.
+FLASH_AREA_WRAP_LDFLAGS=-Wl,--wrap=flash_area_read,--wrap=flash_area_write,--wrap=flash_area_erase,--wrap=flash_area_read_is_empty
+
+ifeq ($(USE_EXT_FLASH)$(USE_TRAILER_LOG), 11)
+DEFINES+=CY_BOOT_USE_TRAILER_LOG
+endif
+
+# Set to 1 to verify image signatures with fixed-base comb tables precomputed
+# at build time for the P-256 generator and the signing key, instead of the
+# generic Mbed TLS path. The bootloader reads the key from
+# keys/$(SIGN_KEY_FILE).pub and the OTA app from the code signer certificate.
+# Used by the bootloader only with software crypto (USE_CRYPTO_HW=0).
+# See bootloader_cm0p/ecdsa_comb.c.
+USE_ECDSA_COMB ?= 0
+
+# Build-time generation of the comb tables
+ECDSA_COMB_GEN_DIR=./build/generated
+ECDSA_COMB_PYTHON=$(if $(CY_PYTHON_PATH),$(CY_PYTHON_PATH),python)
+ECDSA_COMB_GEN=$(ECDSA_COMB_PYTHON) ../bootloader_cm0p/scripts/ecdsa_comb_gen.py
+ECDSA_COMB_LDFLAGS=-Wl,--wrap=mbedtls_ecdsa_read_signature
+
+# Number of image slots kept in the external flash. With more than one slot,
+# every OTA download goes to the next free slot of a ring and earlier releases
+# are retained, so that a rejected image is replaced by the last known-good one
+# with a local copy instead of a new download. Each slot takes MCUBOOT_SLOT_SIZE
+# of the external flash, followed by two 256 KB sectors for the slot index.
+# Needs USE_TRAILER_LOG=1. See bootloader_cm0p/slot_ring.c.
+SLOT_RING_COUNT ?= 1
+
+ifeq ($(USE_EXT_FLASH), 1)
+ifneq ($(SLOT_RING_COUNT), 1)
+DEFINES+=CY_BOOT_USE_SLOT_RING CY_SLOT_RING_COUNT=$(SLOT_RING_COUNT)U
+endif
+endif
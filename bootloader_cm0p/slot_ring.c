@@ -0,0 +1,805 @@
+/******************************************************************************
+* File Name:   slot_ring.c
+*
+* Description: This file implements a ring of CY_SLOT_RING_COUNT signed image
+* slots in the external flash. Each OTA download lands in the next free slot of
+* the ring instead of a single secondary slot, and earlier releases stay in
+* their slots. A compact append-only index placed after the last slot records
+* the state and version of each slot, the slot currently installed in the
+* primary slot, the slot that receives the next download, and a pending
+* install request. Rolling back to a retained release then only needs a local
+* copy by the bootloader and no network traffic.
+*
+* This file is shared by the bootloader and the OTA app.
+*
+* Related Document: See README.md
+*
+*******************************************************************************
+* (c) 2020, Cypress Semiconductor Corporation. All rights reserved.
+*******************************************************************************
+* This software, including source code, documentation and related materials
+* ("Software"), is owned by Cypress Semiconductor Corporation or one of its
+* subsidiaries ("Cypress") and is protected by and subject to worldwide patent
+* protection (United States and foreign), United States copyright laws and
+* international treaty provisions. Therefore, you may use this Software only
+* as provided in the license agreement accompanying the software package from
+* which you obtained this Software ("EULA").
+*
+* If no EULA applies, Cypress hereby grants you a personal, non-exclusive,
+* non-transferable license to copy, modify, and compile the Software source
+* code solely for use in connection with Cypress's integrated circuit products.
+* Any reproduction, modification, translation, compilation, or representation
+* of this Software except as specified above is prohibited without the express
+* written permission of Cypress.
+*
+* Disclaimer: THIS SOFTWARE IS PROVIDED AS-IS, WITH NO WARRANTY OF ANY KIND,
+* EXPRESS OR IMPLIED, INCLUDING, BUT NOT LIMITED TO, NONINFRINGEMENT, IMPLIED
+* WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE. Cypress
+* reserves the right to make changes to the Software without notice. Cypress
+* does not assume any liability arising out of the application or use of the
+* Software or any product or circuit described in the Software. Cypress does
+* not authorize its products for use in any products where a malfunction or
+* failure of the Cypress product may reasonably be expected to result in
+* significant property damage, injury or death ("High Risk Product"). By
+* including Cypress's product in a High Risk Product, the manufacturer of such
+* system or application assumes all risk of such use and in doing so agrees to
+* indemnify Cypress against all liability.
+*******************************************************************************/
+
+#include <string.h>
+#include "cy_pdl.h"
+#include "sysflash/sysflash.h"
+#include "bootutil/bootutil_log.h"
+#include "slot_ring.h"
+
+#if defined(CY_BOOT_USE_SLOT_RING)
+
+/*******************************************************************************
+* Macros
+*******************************************************************************/
+#define SLOT_RING_MAGIC                     (0x474E4952UL) /* "RING" */
+#define SLOT_RING_RECORD_SIZE               (32UL)
+#define SLOT_RING_RECORDS_PER_SECTOR        (CY_SLOT_RING_INDEX_SECTOR_SIZE /\
+                                             SLOT_RING_RECORD_SIZE)
+
+/* FNV-1a parameters used for the record checksum */
+#define SLOT_RING_FNV_OFFSET                (0x811C9DC5UL)
+#define SLOT_RING_FNV_PRIME                 (0x01000193UL)
+
+#define SLOT_RING_INDEX_OFF                 (CY_SLOT_RING_COUNT *\
+                                             CY_BOOT_SECONDARY_1_SIZE)
+
+CY_STATIC_ASSERT((SLOT_RING_INDEX_OFF + (2UL * CY_SLOT_RING_INDEX_SECTOR_SIZE)) <=
+                 CY_SLOT_RING_EXT_FLASH_SIZE,
+                 "Slot ring does not fit in the external flash");
+CY_STATIC_ASSERT(CY_SLOT_RING_COUNT < SLOT_RING_NONE,
+                 "Too many slots in the ring");
+
+
+/*******************************************************************************
+* Data structure and enumeration
+*******************************************************************************/
+typedef enum
+{
+    RING_REC_SLOT = 1,          /* State and version of one slot */
+    RING_REC_ACTIVE,            /* Slot installed in the primary slot */
+    RING_REC_RX,                /* Slot receiving the next download */
+    RING_REC_INSTALL            /* Slot to install on the next boot */
+} slot_ring_rec_type_t;
+
+typedef struct
+{
+    uint32_t magic;
+    uint32_t seq;
+    uint8_t  type;
+    uint8_t  slot;
+    uint8_t  state;
+    uint8_t  trial_boots;
+    struct image_version version;
+    uint32_t checksum;
+    uint8_t  reserved[SLOT_RING_RECORD_SIZE - 28U];
+} slot_ring_record_t;
+
+CY_STATIC_ASSERT(sizeof(slot_ring_record_t) == SLOT_RING_RECORD_SIZE,
+                 "Unexpected slot ring record size");
+
+
+/*******************************************************************************
+* Global variables
+*******************************************************************************/
+static struct flash_area index_area =
+{
+    .fa_id = CY_SLOT_RING_INDEX_AREA_ID,
+    .fa_device_id = FLASH_DEVICE_EXTERNAL_FLASH(CY_BOOT_EXTERNAL_DEVICE_INDEX),
+    .fa_off = CY_SMIF_BASE_MEM_OFFSET + SLOT_RING_INDEX_OFF,
+    .fa_size = 2UL * CY_SLOT_RING_INDEX_SECTOR_SIZE
+};
+
+static struct flash_area slot_area =
+{
+    .fa_id = CY_SLOT_RING_INDEX_AREA_ID + 1U,
+    .fa_device_id = FLASH_DEVICE_EXTERNAL_FLASH(CY_BOOT_EXTERNAL_DEVICE_INDEX),
+    .fa_off = CY_SMIF_BASE_MEM_OFFSET,
+    .fa_size = CY_BOOT_SECONDARY_1_SIZE
+};
+
+static slot_ring_slot_t ring_slots[CY_SLOT_RING_COUNT];
+static uint8_t ring_active = SLOT_RING_NONE;
+static uint8_t ring_rx = 0U;
+static uint8_t ring_install = SLOT_RING_NONE;
+static uint32_t ring_seq;
+static uint32_t ring_sector;        /* Index sector being appended to */
+static uint32_t ring_next;          /* Next free record in ring_sector */
+static bool ring_loaded = false;
+
+
+/*******************************************************************************
+* Function Name: slot_ring_checksum
+********************************************************************************
+* Summary:
+*  Computes the checksum of an index record.
+*
+* Parameters:
+*  rec - record to compute the checksum of
+*
+* Return:
+*  uint32_t - FNV-1a hash of the record up to the checksum field
+*
+*******************************************************************************/
+static uint32_t slot_ring_checksum(const slot_ring_record_t *rec)
+{
+    const uint8_t *p = (const uint8_t *)rec;
+    uint32_t len = offsetof(slot_ring_record_t, checksum);
+    uint32_t hash = SLOT_RING_FNV_OFFSET;
+
+    while (len-- > 0U)
+    {
+        hash = (hash ^ *p++) * SLOT_RING_FNV_PRIME;
+    }
+
+    return hash;
+}
+
+
+/*******************************************************************************
+* Function Name: slot_ring_apply
+********************************************************************************
+* Summary:
+*  Applies one index record to the in-RAM state.
+*
+* Parameters:
+*  rec - valid index record
+*
+*******************************************************************************/
+static void slot_ring_apply(const slot_ring_record_t *rec)
+{
+    bool slot_valid = (rec->slot < CY_SLOT_RING_COUNT);
+
+    switch (rec->type)
+    {
+        case RING_REC_SLOT:
+            if (slot_valid)
+            {
+                ring_slots[rec->slot].state = rec->state;
+                ring_slots[rec->slot].trial_boots = rec->trial_boots;
+                ring_slots[rec->slot].version = rec->version;
+                ring_slots[rec->slot].seq = rec->seq;
+            }
+            break;
+
+        case RING_REC_ACTIVE:
+            ring_active = slot_valid ? rec->slot : SLOT_RING_NONE;
+            break;
+
+        case RING_REC_RX:
+            ring_rx = slot_valid ? rec->slot : 0U;
+            break;
+
+        case RING_REC_INSTALL:
+            ring_install = slot_valid ? rec->slot : SLOT_RING_NONE;
+            break;
+
+        default:
+            break;
+    }
+
+    ring_seq = rec->seq;
+}
+
+
+/*******************************************************************************
+* Function Name: slot_ring_scan_sector
+********************************************************************************
+* Summary:
+*  Replays the records of one index sector.
+*
+* Parameters:
+*  sector - index sector (0 or 1)
+*  apply - true to apply the records, false to only count them
+*  first_seq - sequence number of the first record, if any
+*
+* Return:
+*  uint32_t - number of records in the sector
+*
+*******************************************************************************/
+static uint32_t slot_ring_scan_sector(uint32_t sector, bool apply, uint32_t *first_seq)
+{
+    slot_ring_record_t rec;
+    uint32_t count = 0U;
+
+    for (; count < SLOT_RING_RECORDS_PER_SECTOR; count++)
+    {
+        uint32_t off = (sector * CY_SLOT_RING_INDEX_SECTOR_SIZE) +
+                       (count * SLOT_RING_RECORD_SIZE);
+
+        if ((0 != flash_area_read(&index_area, off, &rec, sizeof(rec))) ||
+            (SLOT_RING_MAGIC != rec.magic))
+        {
+            break;
+        }
+
+        if (slot_ring_checksum(&rec) != rec.checksum)
+        {
+            /* Torn record: skip it, the space is not reused. */
+            continue;
+        }
+
+        if ((0U == count) && (NULL != first_seq))
+        {
+            *first_seq = rec.seq;
+        }
+
+        if (apply)
+        {
+            slot_ring_apply(&rec);
+        }
+    }
+
+    return count;
+}
+
+
+/*******************************************************************************
+* Function Name: slot_ring_append
+********************************************************************************
+* Summary:
+*  Appends one record to the current index sector. The caller handles a full
+*  sector.
+*
+* Parameters:
+*  type - record type
+*  slot - slot the record applies to
+*
+* Return:
+*  int - 0 on success, -1 otherwise
+*
+*******************************************************************************/
+static int slot_ring_append(slot_ring_rec_type_t type, uint8_t slot)
+{
+    slot_ring_record_t rec;
+    uint32_t off = (ring_sector * CY_SLOT_RING_INDEX_SECTOR_SIZE) +
+                   (ring_next * SLOT_RING_RECORD_SIZE);
+
+    memset(&rec, 0xff, sizeof(rec));
+    rec.magic = SLOT_RING_MAGIC;
+    rec.seq = ring_seq + 1U;
+    rec.type = (uint8_t)type;
+    rec.slot = slot;
+    rec.state = 0U;
+    rec.trial_boots = 0U;
+    memset(&rec.version, 0, sizeof(rec.version));
+
+    if ((RING_REC_SLOT == type) && (slot < CY_SLOT_RING_COUNT))
+    {
+        rec.state = ring_slots[slot].state;
+        rec.trial_boots = ring_slots[slot].trial_boots;
+        rec.version = ring_slots[slot].version;
+        ring_slots[slot].seq = rec.seq;
+    }
+
+    rec.checksum = slot_ring_checksum(&rec);
+
+    ring_next++;
+
+    if (0 != flash_area_write(&index_area, off, &rec, sizeof(rec)))
+    {
+        BOOT_LOG_ERR("Slot ring: index write failed");
+        return -1;
+    }
+
+    ring_seq = rec.seq;
+
+    return 0;
+}
+
+
+/*******************************************************************************
+* Function Name: slot_ring_compact
+********************************************************************************
+* Summary:
+*  Writes a snapshot of the current state to the other index sector and then
+*  erases the full one. Until the erase completes, replaying both sectors in
+*  sequence order gives the same state.
+*
+* Return:
+*  int - 0 on success, -1 otherwise
+*
+*******************************************************************************/
+static int slot_ring_compact(void)
+{
+    uint32_t old_sector = ring_sector;
+    int rc;
+
+    ring_sector ^= 1U;
+    ring_next = 0U;
+
+    rc = flash_area_erase(&index_area, ring_sector * CY_SLOT_RING_INDEX_SECTOR_SIZE,
+                          CY_SLOT_RING_INDEX_SECTOR_SIZE);
+
+    for (uint8_t slot = 0U; (0 == rc) && (slot < CY_SLOT_RING_COUNT); slot++)
+    {
+        rc = slot_ring_append(RING_REC_SLOT, slot);
+    }
+
+    if (0 == rc)
+    {
+        rc = slot_ring_append(RING_REC_ACTIVE, ring_active);
+    }
+
+    if (0 == rc)
+    {
+        rc = slot_ring_append(RING_REC_RX, ring_rx);
+    }
+
+    if (0 == rc)
+    {
+        rc = slot_ring_append(RING_REC_INSTALL, ring_install);
+    }
+
+    if (0 == rc)
+    {
+        rc = flash_area_erase(&index_area, old_sector * CY_SLOT_RING_INDEX_SECTOR_SIZE,
+                              CY_SLOT_RING_INDEX_SECTOR_SIZE);
+    }
+
+    return rc;
+}
+
+
+/*******************************************************************************
+* Function Name: slot_ring_record
+********************************************************************************
+* Summary:
+*  Appends a record, compacting the index first when the sector is full.
+*
+* Parameters:
+*  type - record type
+*  slot - slot the record applies to
+*
+* Return:
+*  int - 0 on success, -1 otherwise
+*
+*******************************************************************************/
+static int slot_ring_record(slot_ring_rec_type_t type, uint8_t slot)
+{
+    if (ring_next >= SLOT_RING_RECORDS_PER_SECTOR)
+    {
+        /* The snapshot already holds the new state. */
+        return slot_ring_compact();
+    }
+
+    return slot_ring_append(type, slot);
+}
+
+
+/*******************************************************************************
+* Function Name: slot_ring_load
+********************************************************************************
+* Summary:
+*  Loads the index from the external flash. The external memory must be
+*  initialized.
+*
+* Return:
+*  int - 0 on success
+*
+*******************************************************************************/
+int slot_ring_load(void)
+{
+    uint32_t first_seq[2] = { 0U, 0U };
+    uint32_t count[2];
+    uint32_t older;
+
+    if (ring_loaded)
+    {
+        return 0;
+    }
+
+    memset(ring_slots, 0, sizeof(ring_slots));
+
+    count[0] = slot_ring_scan_sector(0U, false, &first_seq[0]);
+    count[1] = slot_ring_scan_sector(1U, false, &first_seq[1]);
+
+    /* Replay the older sector first; the newer one is appended to. */
+    older = ((count[1] > 0U) && ((count[0] == 0U) ||
+             ((int32_t)(first_seq[1] - first_seq[0]) < 0))) ? 1U : 0U;
+
+    (void)slot_ring_scan_sector(older, true, NULL);
+    (void)slot_ring_scan_sector(older ^ 1U, true, NULL);
+
+    ring_sector = (count[older ^ 1U] > 0U) ? (older ^ 1U) : older;
+    ring_next = count[ring_sector];
+    ring_loaded = true;
+
+    BOOT_LOG_INF("Slot ring: %u slots, active %d, next download to slot %u",
+                 (unsigned int)CY_SLOT_RING_COUNT,
+                 (SLOT_RING_NONE == ring_active) ? -1 : (int)ring_active,
+                 (unsigned int)ring_rx);
+
+    return 0;
+}
+
+
+/*******************************************************************************
+* Function Name: slot_ring_get
+********************************************************************************
+* Summary:
+*  Returns the index entry of a slot.
+*
+* Parameters:
+*  slot - slot number
+*
+* Return:
+*  const slot_ring_slot_t* - index entry, or NULL for an invalid slot
+*
+*******************************************************************************/
+const slot_ring_slot_t *slot_ring_get(uint8_t slot)
+{
+    return (slot < CY_SLOT_RING_COUNT) ? &ring_slots[slot] : NULL;
+}
+
+
+/*******************************************************************************
+* Function Name: slot_ring_active
+********************************************************************************
+* Summary:
+*  Returns the slot whose image is installed in the primary slot.
+*
+* Return:
+*  uint8_t - slot number, or SLOT_RING_NONE (factory image)
+*
+*******************************************************************************/
+uint8_t slot_ring_active(void)
+{
+    return ring_active;
+}
+
+
+/*******************************************************************************
+* Function Name: slot_ring_rx
+********************************************************************************
+* Summary:
+*  Returns the slot that receives the next download.
+*
+* Return:
+*  uint8_t - slot number
+*
+*******************************************************************************/
+uint8_t slot_ring_rx(void)
+{
+    return ring_rx;
+}
+
+
+/*******************************************************************************
+* Function Name: slot_ring_install_request
+********************************************************************************
+* Summary:
+*  Returns the slot requested to be installed on the next boot.
+*
+* Return:
+*  uint8_t - slot number, or SLOT_RING_NONE
+*
+*******************************************************************************/
+uint8_t slot_ring_install_request(void)
+{
+    return ring_install;
+}
+
+
+/*******************************************************************************
+* Function Name: slot_ring_last_good
+********************************************************************************
+* Summary:
+*  Returns the most recently accepted slot other than the active one. This is
+*  the rollback target.
+*
+* Return:
+*  uint8_t - slot number, or SLOT_RING_NONE
+*
+*******************************************************************************/
+uint8_t slot_ring_last_good(void)
+{
+    uint8_t best = SLOT_RING_NONE;
+
+    for (uint8_t slot = 0U; slot < CY_SLOT_RING_COUNT; slot++)
+    {
+        if ((slot != ring_active) && (SLOT_RING_GOOD == ring_slots[slot].state) &&
+            ((SLOT_RING_NONE == best) ||
+             ((int32_t)(ring_slots[slot].seq - ring_slots[best].seq) > 0)))
+        {
+            best = slot;
+        }
+    }
+
+    return best;
+}
+
+
+/*******************************************************************************
+* Function Name: slot_ring_slot_off
+********************************************************************************
+* Summary:
+*  Returns the memory-mapped address of a slot.
+*
+* Parameters:
+*  slot - slot number
+*
+* Return:
+*  uint32_t - address of the first byte of the slot
+*
+*******************************************************************************/
+uint32_t slot_ring_slot_off(uint8_t slot)
+{
+    return CY_SMIF_BASE_MEM_OFFSET + ((uint32_t)slot * CY_BOOT_SECONDARY_1_SIZE);
+}
+
+
+/*******************************************************************************
+* Function Name: slot_ring_read_header
+********************************************************************************
+* Summary:
+*  Reads the MCUboot image header stored in a slot.
+*
+* Parameters:
+*  slot - slot number
+*  hdr - destination of the header
+*
+* Return:
+*  int - 0 if a header with a valid magic was read, -1 otherwise
+*
+*******************************************************************************/
+int slot_ring_read_header(uint8_t slot, struct image_header *hdr)
+{
+    if (slot >= CY_SLOT_RING_COUNT)
+    {
+        return -1;
+    }
+
+    slot_area.fa_off = slot_ring_slot_off(slot);
+
+    if ((0 != flash_area_read(&slot_area, 0U, hdr, sizeof(*hdr))) ||
+        (IMAGE_MAGIC != hdr->ih_magic))
+    {
+        return -1;
+    }
+
+    return 0;
+}
+
+
+/*******************************************************************************
+* Function Name: slot_ring_set_state
+********************************************************************************
+* Summary:
+*  Records the state of a slot.
+*
+* Parameters:
+*  slot - slot number
+*  state - new state
+*  version - image version, or NULL to keep the recorded one
+*  trial_boots - number of boots in the trial state
+*
+* Return:
+*  int - 0 on success, -1 otherwise
+*
+*******************************************************************************/
+int slot_ring_set_state(uint8_t slot, slot_ring_state_t state,
+                        const struct image_version *version, uint8_t trial_boots)
+{
+    if (slot >= CY_SLOT_RING_COUNT)
+    {
+        return -1;
+    }
+
+    ring_slots[slot].state = (uint8_t)state;
+    ring_slots[slot].trial_boots = trial_boots;
+
+    if (NULL != version)
+    {
+        ring_slots[slot].version = *version;
+    }
+
+    return slot_ring_record(RING_REC_SLOT, slot);
+}
+
+
+/*******************************************************************************
+* Function Name: slot_ring_set_active
+********************************************************************************
+* Summary:
+*  Records the slot whose image is installed in the primary slot.
+*
+* Parameters:
+*  slot - slot number, or SLOT_RING_NONE
+*
+* Return:
+*  int - 0 on success, -1 otherwise
+*
+*******************************************************************************/
+int slot_ring_set_active(uint8_t slot)
+{
+    ring_active = slot;
+    return slot_ring_record(RING_REC_ACTIVE, slot);
+}
+
+
+/*******************************************************************************
+* Function Name: slot_ring_set_rx
+********************************************************************************
+* Summary:
+*  Records the slot that receives the next download and points the secondary
+*  slot of the flash map at it.
+*
+* Parameters:
+*  slot - slot number
+*
+* Return:
+*  int - 0 on success, -1 otherwise
+*
+*******************************************************************************/
+int slot_ring_set_rx(uint8_t slot)
+{
+    if (slot >= CY_SLOT_RING_COUNT)
+    {
+        return -1;
+    }
+
+    flash_map_set_secondary_off(slot_ring_slot_off(slot));
+
+    if (slot == ring_rx)
+    {
+        return 0;
+    }
+
+    ring_rx = slot;
+    return slot_ring_record(RING_REC_RX, slot);
+}
+
+
+/*******************************************************************************
+* Function Name: slot_ring_request_install
+********************************************************************************
+* Summary:
+*  Requests the bootloader to install the image of a slot on the next boot.
+*  The image is verified by MCUboot as usual before it is installed.
+*
+* Parameters:
+*  slot - slot number, or SLOT_RING_NONE to cancel a request
+*
+* Return:
+*  int - 0 on success, -1 otherwise
+*
+*******************************************************************************/
+int slot_ring_request_install(uint8_t slot)
+{
+    if ((SLOT_RING_NONE != slot) &&
+        ((slot >= CY_SLOT_RING_COUNT) ||
+         (SLOT_RING_EMPTY == ring_slots[slot].state) ||
+         (SLOT_RING_BAD == ring_slots[slot].state)))
+    {
+        return -1;
+    }
+
+    ring_install = slot;
+    return slot_ring_record(RING_REC_INSTALL, slot);
+}
+
+
+/*******************************************************************************
+* Function Name: slot_ring_select_rx
+********************************************************************************
+* Summary:
+*  Selects the slot for the next download: an empty slot, then a rejected
+*  one, then the least recently changed one. The active slot is never
+*  selected and the rollback target is kept if another slot is available.
+*
+* Return:
+*  int - 0 on success, -1 otherwise
+*
+*******************************************************************************/
+int slot_ring_select_rx(void)
+{
+    uint8_t keep = slot_ring_last_good();
+    uint8_t best = SLOT_RING_NONE;
+    uint8_t best_rank = 0U;
+
+    for (uint8_t slot = 0U; slot < CY_SLOT_RING_COUNT; slot++)
+    {
+        uint8_t rank;
+
+        if (slot == ring_active)
+        {
+            continue;
+        }
+
+        if (SLOT_RING_EMPTY == ring_slots[slot].state)
+        {
+            rank = 4U;
+        }
+        else if (SLOT_RING_BAD == ring_slots[slot].state)
+        {
+            rank = 3U;
+        }
+        else if (slot != keep)
+        {
+            rank = 2U;
+        }
+        else
+        {
+            rank = 1U;
+        }
+
+        if ((rank > best_rank) ||
+            ((rank == best_rank) &&
+             ((int32_t)(ring_slots[slot].seq - ring_slots[best].seq) < 0)))
+        {
+            best = slot;
+            best_rank = rank;
+        }
+    }
+
+    if (SLOT_RING_NONE == best)
+    {
+        return -1;
+    }
+
+    return slot_ring_set_rx(best);
+}
+
+
+/*******************************************************************************
+* Function Name: slot_ring_keeps
+********************************************************************************
+* Summary:
+*  Checks whether an erase must be skipped to retain the image in the ring.
+*  After an overwrite upgrade MCUboot erases the first and the last logical
+*  sectors of the secondary slot so that the image is not installed again.
+*  With the ring, the image header is kept, and of the last sector only the
+*  trailer is cleared, by the caller through the trailer log. When the trailer
+*  log uses the small erase of the device, the sub-sector that holds the
+*  trailer is erased: retained images must end before it.
+*
+* Parameters:
+*  fa - flash area
+*  off - offset within the flash area
+*  len - length of the range
+*
+* Return:
+*  bool - true if the erase must be skipped
+*
+*******************************************************************************/
+bool slot_ring_keeps(const struct flash_area *fa, uint32_t off, uint32_t len)
+{
+    if ((FLASH_AREA_IMAGE_SECONDARY(0) != fa->fa_id) || (len >= fa->fa_size))
+    {
+        return false;
+    }
+
+    return ((off + len) <= CY_BOOT_SCRATCH_SIZE) ||
+           ((off >= (fa->fa_size - CY_BOOT_SCRATCH_SIZE)) && ((off + len) <= fa->fa_size));
+}
+
+#endif /* CY_BOOT_USE_SLOT_RING */
+
+
+/* [] END OF FILE */
@@ -0,0 +1,143 @@
+/******************************************************************************
+* File Name:   slot_ring.h
+*
+* Description: This file contains the macros, data structures and function
+* declarations of the ring of retained image slots in the external flash.
+*
+* Related Document: See README.md
+*
+*******************************************************************************
+* (c) 2020, Cypress Semiconductor Corporation. All rights reserved.
+*******************************************************************************
+* This software, including source code, documentation and related materials
+* ("Software"), is owned by Cypress Semiconductor Corporation or one of its
+* subsidiaries ("Cypress") and is protected by and subject to worldwide patent
+* protection (United States and foreign), United States copyright laws and
+* international treaty provisions. Therefore, you may use this Software only
+* as provided in the license agreement accompanying the software package from
+* which you obtained this Software ("EULA").
+*
+* If no EULA applies, Cypress hereby grants you a personal, non-exclusive,
+* non-transferable license to copy, modify, and compile the Software source
+* code solely for use in connection with Cypress's integrated circuit products.
+* Any reproduction, modification, translation, compilation, or representation
+* of this Software except as specified above is prohibited without the express
+* written permission of Cypress.
+*
+* Disclaimer: THIS SOFTWARE IS PROVIDED AS-IS, WITH NO WARRANTY OF ANY KIND,
+* EXPRESS OR IMPLIED, INCLUDING, BUT NOT LIMITED TO, NONINFRINGEMENT, IMPLIED
+* WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE. Cypress
+* reserves the right to make changes to the Software without notice. Cypress
+* does not assume any liability arising out of the application or use of the
+* Software or any product or circuit described in the Software. Cypress does
+* not authorize its products for use in any products where a malfunction or
+* failure of the Cypress product may reasonably be expected to result in
+* significant property damage, injury or death ("High Risk Product"). By
+* including Cypress's product in a High Risk Product, the manufacturer of such
+* system or application assumes all risk of such use and in doing so agrees to
+* indemnify Cypress against all liability.
+*******************************************************************************/
+#ifndef SLOT_RING_H
+#define SLOT_RING_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "flash_map_backend/flash_map_backend.h"
+#include "bootutil/image.h"
+
+
+/*******************************************************************************
+* Macros
+*******************************************************************************/
+/* Number of image slots in the ring. Slot k starts at k * CY_BOOT_SECONDARY_1_SIZE
+ * from the beginning of the external flash.
+ */
+#ifndef CY_SLOT_RING_COUNT
+#define CY_SLOT_RING_COUNT                  (4U)
+#endif
+
+/* Size of one index sector. The index uses two of them after the last slot. */
+#ifndef CY_SLOT_RING_INDEX_SECTOR_SIZE
+#define CY_SLOT_RING_INDEX_SECTOR_SIZE      (0x40000UL)
+#endif
+
+/* Size of the external flash (S25FL512S). */
+#ifndef CY_SLOT_RING_EXT_FLASH_SIZE
+#define CY_SLOT_RING_EXT_FLASH_SIZE         (0x4000000UL)
+#endif
+
+/* Number of boots of a newly installed image without it being accepted
+ * before the bootloader rolls back to the last known-good image.
+ */
+#ifndef CY_SLOT_RING_MAX_TRIAL_BOOTS
+#define CY_SLOT_RING_MAX_TRIAL_BOOTS        (3U)
+#endif
+
+/* Flash area ID used for the index. It is not registered in boot_area_descs. */
+#define CY_SLOT_RING_INDEX_AREA_ID          (0x10U)
+
+/* Value used for "no slot" */
+#define SLOT_RING_NONE                      (0xffU)
+
+/* MCUboot clears the trailer of the secondary slot after an upgrade with an
+ * erase of the logical sector that holds it. The external flash only erases
+ * 256 KB sectors, so without the trailer log that erase would also take the
+ * end of the image retained in the slot.
+ */
+#if defined(CY_BOOT_USE_SLOT_RING) && !defined(CY_BOOT_USE_TRAILER_LOG)
+#error "The slot ring needs the trailer log: set USE_TRAILER_LOG=1"
+#endif
+
+
+/*******************************************************************************
+* Data structure and enumeration
+*******************************************************************************/
+typedef enum
+{
+    SLOT_RING_EMPTY = 0,        /* Nothing retained */
+    SLOT_RING_RECEIVED,         /* Downloaded, not installed yet */
+    SLOT_RING_TRIAL,            /* Installed, waiting for the self-test */
+    SLOT_RING_GOOD,             /* Installed and accepted */
+    SLOT_RING_BAD               /* Rejected or failed the self-test */
+} slot_ring_state_t;
+
+typedef struct
+{
+    uint8_t state;              /* slot_ring_state_t */
+    uint8_t trial_boots;        /* Boots in the SLOT_RING_TRIAL state */
+    struct image_version version;
+    uint32_t seq;               /* Sequence number of the last change */
+} slot_ring_slot_t;
+
+
+/*******************************************************************************
+* Function prototypes
+*******************************************************************************/
+int slot_ring_load(void);
+const slot_ring_slot_t *slot_ring_get(uint8_t slot);
+uint8_t slot_ring_active(void);
+uint8_t slot_ring_rx(void);
+uint8_t slot_ring_install_request(void);
+uint8_t slot_ring_last_good(void);
+uint32_t slot_ring_slot_off(uint8_t slot);
+int slot_ring_read_header(uint8_t slot, struct image_header *hdr);
+
+int slot_ring_set_state(uint8_t slot, slot_ring_state_t state,
+                        const struct image_version *version, uint8_t trial_boots);
+int slot_ring_set_active(uint8_t slot);
+int slot_ring_set_rx(uint8_t slot);
+int slot_ring_request_install(uint8_t slot);
+int slot_ring_select_rx(void);
+bool slot_ring_keeps(const struct flash_area *fa, uint32_t off, uint32_t len);
+
+/* Bootloader only, see slot_ring_boot.c */
+void slot_ring_boot_prepare(void);
+void slot_ring_boot_complete(const struct image_header *hdr);
+
+/* Defined in ext_flash_map.c */
+void flash_map_set_secondary_off(uint32_t off);
+
+#endif /* SLOT_RING_H */
+
+
+/* [] END OF FILE */
@@ -0,0 +1,232 @@
+/******************************************************************************
+* File Name:   slot_ring_boot.c
+*
+* Description: This file implements the bootloader side of the slot ring.
+* Before boot_go() it points the secondary slot at the ring slot to install:
+* a freshly downloaded image, the slot requested by the OTA app, or the last
+* known-good slot when the installed image failed its self-test. After
+* boot_go() it records which slot was installed.
+*
+* Related Document: See README.md
+*
+*******************************************************************************
+* (c) 2020, Cypress Semiconductor Corporation. All rights reserved.
+*******************************************************************************
+* This software, including source code, documentation and related materials
+* ("Software"), is owned by Cypress Semiconductor Corporation or one of its
+* subsidiaries ("Cypress") and is protected by and subject to worldwide patent
+* protection (United States and foreign), United States copyright laws and
+* international treaty provisions. Therefore, you may use this Software only
+* as provided in the license agreement accompanying the software package from
+* which you obtained this Software ("EULA").
+*
+* If no EULA applies, Cypress hereby grants you a personal, non-exclusive,
+* non-transferable license to copy, modify, and compile the Software source
+* code solely for use in connection with Cypress's integrated circuit products.
+* Any reproduction, modification, translation, compilation, or representation
+* of this Software except as specified above is prohibited without the express
+* written permission of Cypress.
+*
+* Disclaimer: THIS SOFTWARE IS PROVIDED AS-IS, WITH NO WARRANTY OF ANY KIND,
+* EXPRESS OR IMPLIED, INCLUDING, BUT NOT LIMITED TO, NONINFRINGEMENT, IMPLIED
+* WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE. Cypress
+* reserves the right to make changes to the Software without notice. Cypress
+* does not assume any liability arising out of the application or use of the
+* Software or any product or circuit described in the Software. Cypress does
+* not authorize its products for use in any products where a malfunction or
+* failure of the Cypress product may reasonably be expected to result in
+* significant property damage, injury or death ("High Risk Product"). By
+* including Cypress's product in a High Risk Product, the manufacturer of such
+* system or application assumes all risk of such use and in doing so agrees to
+* indemnify Cypress against all liability.
+*******************************************************************************/
+
+#include <string.h>
+#include "cy_pdl.h"
+#include "sysflash/sysflash.h"
+#include "bootutil/bootutil.h"
+#include "bootutil/bootutil_log.h"
+#include "bootutil_priv.h"
+#include "slot_ring.h"
+
+#if defined(CY_BOOT_USE_SLOT_RING)
+
+/*******************************************************************************
+* Data structure and enumeration
+*******************************************************************************/
+typedef enum
+{
+    RING_INSTALL_NONE,          /* Boot the image already in the primary slot */
+    RING_INSTALL_UPGRADE,       /* New download, installed for a trial */
+    RING_INSTALL_RETAINED       /* Retained known-good image (rollback) */
+} slot_ring_install_t;
+
+
+/*******************************************************************************
+* Global variables
+*******************************************************************************/
+static slot_ring_install_t install_kind = RING_INSTALL_NONE;
+static uint8_t install_slot = SLOT_RING_NONE;
+
+
+/*******************************************************************************
+* Function Name: slot_ring_upgrade_pending
+********************************************************************************
+* Summary:
+*  Checks whether the OTA app marked the secondary slot as pending.
+*
+* Return:
+*  bool - true if the trailer magic of the secondary slot is set
+*
+*******************************************************************************/
+static bool slot_ring_upgrade_pending(void)
+{
+    struct boot_swap_state state;
+
+    return (0 == boot_read_swap_state_by_id(FLASH_AREA_IMAGE_SECONDARY(0), &state)) &&
+           (BOOT_MAGIC_GOOD == state.magic);
+}
+
+
+/*******************************************************************************
+* Function Name: slot_ring_install_retained
+********************************************************************************
+* Summary:
+*  Points the secondary slot at a retained slot and marks it pending so that
+*  boot_go() verifies and installs it.
+*
+* Parameters:
+*  slot - slot to install
+*
+*******************************************************************************/
+static void slot_ring_install_retained(uint8_t slot)
+{
+    struct image_header hdr;
+
+    if (0 != slot_ring_read_header(slot, &hdr))
+    {
+        BOOT_LOG_ERR("Slot ring: slot %u holds no image", (unsigned int)slot);
+        (void)slot_ring_set_state(slot, SLOT_RING_EMPTY, NULL, 0U);
+        return;
+    }
+
+    flash_map_set_secondary_off(slot_ring_slot_off(slot));
+
+    if (0 == boot_set_pending(1))
+    {
+        BOOT_LOG_INF("Slot ring: installing retained slot %u (v%u.%u.%u)",
+                     (unsigned int)slot, hdr.ih_ver.iv_major,
+                     hdr.ih_ver.iv_minor, hdr.ih_ver.iv_revision);
+        install_kind = RING_INSTALL_RETAINED;
+        install_slot = slot;
+    }
+}
+
+
+/*******************************************************************************
+* Function Name: slot_ring_boot_prepare
+********************************************************************************
+* Summary:
+*  Decides which ring slot, if any, boot_go() installs. The external memory
+*  must be initialized.
+*
+*******************************************************************************/
+void slot_ring_boot_prepare(void)
+{
+    uint8_t active;
+    uint8_t request;
+
+    (void)slot_ring_load();
+
+    active = slot_ring_active();
+    request = slot_ring_install_request();
+
+    /* A new download has priority over anything else. */
+    flash_map_set_secondary_off(slot_ring_slot_off(slot_ring_rx()));
+
+    if (slot_ring_upgrade_pending())
+    {
+        install_kind = RING_INSTALL_UPGRADE;
+        install_slot = slot_ring_rx();
+        return;
+    }
+
+    if (SLOT_RING_NONE != request)
+    {
+        (void)slot_ring_request_install(SLOT_RING_NONE);
+        slot_ring_install_retained(request);
+        return;
+    }
+
+    if (SLOT_RING_NONE != active)
+    {
+        const slot_ring_slot_t *entry = slot_ring_get(active);
+        bool failed = (SLOT_RING_BAD == entry->state);
+
+        if (SLOT_RING_TRIAL == entry->state)
+        {
+            uint8_t boots = entry->trial_boots + 1U;
+
+            failed = (boots > CY_SLOT_RING_MAX_TRIAL_BOOTS);
+            (void)slot_ring_set_state(active, failed ? SLOT_RING_BAD : SLOT_RING_TRIAL,
+                                      NULL, boots);
+        }
+
+        if (failed)
+        {
+            uint8_t target = slot_ring_last_good();
+
+            BOOT_LOG_WRN("Slot ring: image in slot %u failed its self-test",
+                         (unsigned int)active);
+
+            if (SLOT_RING_NONE != target)
+            {
+                slot_ring_install_retained(target);
+            }
+        }
+    }
+}
+
+
+/*******************************************************************************
+* Function Name: slot_ring_boot_complete
+********************************************************************************
+* Summary:
+*  Records the result of boot_go(). The install is accepted only if the image
+*  now in the primary slot is the one of the installed ring slot.
+*
+* Parameters:
+*  hdr - header of the image in the primary slot
+*
+*******************************************************************************/
+void slot_ring_boot_complete(const struct image_header *hdr)
+{
+    struct image_header slot_hdr;
+
+    if (RING_INSTALL_NONE == install_kind)
+    {
+        return;
+    }
+
+    if ((0 != slot_ring_read_header(install_slot, &slot_hdr)) ||
+        (slot_hdr.ih_img_size != hdr->ih_img_size) ||
+        (0 != memcmp(&slot_hdr.ih_ver, &hdr->ih_ver, sizeof(hdr->ih_ver))))
+    {
+        /* MCUboot rejected the image and erased the slot. */
+        BOOT_LOG_WRN("Slot ring: slot %u was not installed", (unsigned int)install_slot);
+        (void)slot_ring_set_state(install_slot, SLOT_RING_EMPTY, NULL, 0U);
+        return;
+    }
+
+    if (RING_INSTALL_UPGRADE == install_kind)
+    {
+        (void)slot_ring_set_state(install_slot, SLOT_RING_TRIAL, &hdr->ih_ver, 0U);
+    }
+
+    (void)slot_ring_set_active(install_slot);
+}
+
+#endif /* CY_BOOT_USE_SLOT_RING */
+
+
+/* [] END OF FILE */
@@ -0,0 +1,709 @@
+/******************************************************************************
+* File Name:   trailer_log.c
+*
+* Description: This file implements the trailer log. On the S25FL512S the
+* smallest erase unit is a 256 KB sector, so changing a few bytes of the
+* secondary slot trailer (pending, confirmed, copy done) would cost a full
+* sector erase. When the external flash does not offer small parameter sectors
+* at the trailer address, the last CY_TRAILER_LOG_DATA_SIZE bytes of the
+* secondary slot are kept in a small log-structured area in internal flash
+* instead. Each state transition writes one internal flash row and rotates
+* over CY_TRAILER_LOG_ROWS rows.
+*
+* MCUboot also erases the whole logical sector that holds the trailer after an
+* upgrade. In the log mode that erase is deferred: the log records it, the rest
+* of the sector reads as erased, and the sector is erased in the external
+* flash only before it is next written, by the next download.
+*
+* Related Document: See README.md
+*
+*******************************************************************************
+* (c) 2020, Cypress Semiconductor Corporation. All rights reserved.
+*******************************************************************************
+* This software, including source code, documentation and related materials
+* ("Software"), is owned by Cypress Semiconductor Corporation or one of its
+* subsidiaries ("Cypress") and is protected by and subject to worldwide patent
+* protection (United States and foreign), United States copyright laws and
+* international treaty provisions. Therefore, you may use this Software only
+* as provided in the license agreement accompanying the software package from
+* which you obtained this Software ("EULA").
+*
+* If no EULA applies, Cypress hereby grants you a personal, non-exclusive,
+* non-transferable license to copy, modify, and compile the Software source
+* code solely for use in connection with Cypress's integrated circuit products.
+* Any reproduction, modification, translation, compilation, or representation
+* of this Software except as specified above is prohibited without the express
+* written permission of Cypress.
+*
+* Disclaimer: THIS SOFTWARE IS PROVIDED AS-IS, WITH NO WARRANTY OF ANY KIND,
+* EXPRESS OR IMPLIED, INCLUDING, BUT NOT LIMITED TO, NONINFRINGEMENT, IMPLIED
+* WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE. Cypress
+* reserves the right to make changes to the Software without notice. Cypress
+* does not assume any liability arising out of the application or use of the
+* Software or any product or circuit described in the Software. Cypress does
+* not authorize its products for use in any products where a malfunction or
+* failure of the Cypress product may reasonably be expected to result in
+* significant property damage, injury or death ("High Risk Product"). By
+* including Cypress's product in a High Risk Product, the manufacturer of such
+* system or application assumes all risk of such use and in doing so agrees to
+* indemnify Cypress against all liability.
+*******************************************************************************/
+
+#include <string.h>
+#include "cy_pdl.h"
+
+#ifdef CY_BOOT_USE_EXTERNAL_FLASH
+#include "flash_qspi.h"
+#include "cy_smif_psoc6.h"
+#endif
+
+#include "sysflash/sysflash.h"
+#include "bootutil/bootutil_log.h"
+#include "trailer_log.h"
+
+#if defined(CY_BOOT_USE_TRAILER_LOG)
+
+/*******************************************************************************
+* Macros
+*******************************************************************************/
+#define TRAILER_LOG_MAGIC                   (0x544C4F47UL) /* "TLOG" */
+#define TRAILER_LOG_ERASE_VALUE             (0xffU)
+
+/* Record flags */
+#define TRAILER_LOG_FLAG_ERASE_PENDING      (1UL << 0U)
+
+/* FNV-1a parameters used for the record checksum */
+#define TRAILER_LOG_FNV_OFFSET              (0x811C9DC5UL)
+#define TRAILER_LOG_FNV_PRIME               (0x01000193UL)
+
+#define TRAILER_LOG_ROW_ADDR(row)           (CY_TRAILER_LOG_START +\
+                                             ((row) * CY_FLASH_SIZEOF_ROW))
+
+/* Hybrid sector information is available in the SMIF driver from v1.50. */
+#if defined(CY_SMIF_DRV_VERSION_MAJOR) && \
+    ((CY_SMIF_DRV_VERSION_MAJOR > 1) || (CY_SMIF_DRV_VERSION_MINOR >= 50))
+#define TRAILER_LOG_HYBRID_SECTORS          (1)
+#else
+#define TRAILER_LOG_HYBRID_SECTORS          (0)
+#endif
+
+
+/*******************************************************************************
+* Data structure and enumeration
+*******************************************************************************/
+typedef struct
+{
+    uint32_t magic;
+    uint32_t seq;
+    uint32_t flags;
+    uint8_t  data[CY_TRAILER_LOG_DATA_SIZE];
+    uint32_t checksum;
+} trailer_log_record_t;
+
+typedef enum
+{
+    TRAILER_MODE_UNKNOWN,
+    TRAILER_MODE_LOG,           /* Trailer kept in the internal flash log */
+    TRAILER_MODE_SUBSECTOR      /* Trailer kept in place, small erase used */
+} trailer_log_mode_t;
+
+
+/*******************************************************************************
+* Global variables
+*******************************************************************************/
+static trailer_log_mode_t trailer_mode = TRAILER_MODE_UNKNOWN;
+static bool log_loaded = false;
+static uint32_t log_seq;
+static uint32_t log_row;
+static uint8_t log_data[CY_TRAILER_LOG_DATA_SIZE];
+static bool log_erase_pending;  /* Trailer sector erase deferred */
+static uint32_t row_buf[CY_FLASH_SIZEOF_ROW / sizeof(uint32_t)];
+static trailer_log_stats_t log_stats;
+
+CY_STATIC_ASSERT(sizeof(trailer_log_record_t) <= CY_FLASH_SIZEOF_ROW,
+                 "Trailer log record must fit in one flash row");
+
+
+/*******************************************************************************
+* Function Name: trailer_log_checksum
+********************************************************************************
+* Summary:
+*  Computes the checksum of a trailer log record.
+*
+* Parameters:
+*  record - record to compute the checksum of
+*
+* Return:
+*  uint32_t - FNV-1a hash of the sequence number, the flags and the data
+*
+*******************************************************************************/
+static uint32_t trailer_log_checksum(const trailer_log_record_t *record)
+{
+    const uint8_t *p = (const uint8_t *)&record->seq;
+    uint32_t len = sizeof(record->seq) + sizeof(record->flags) + sizeof(record->data);
+    uint32_t hash = TRAILER_LOG_FNV_OFFSET;
+
+    while (len-- > 0U)
+    {
+        hash = (hash ^ *p++) * TRAILER_LOG_FNV_PRIME;
+    }
+
+    return hash;
+}
+
+
+#ifdef CY_BOOT_USE_EXTERNAL_FLASH
+/*******************************************************************************
+* Function Name: trailer_log_erase_size_at
+********************************************************************************
+* Summary:
+*  Returns the erase granularity of the external flash at the given address.
+*  Hybrid (parameter) sectors reported through SFDP are taken into account.
+*
+* Parameters:
+*  addr - address in the external memory (not memory mapped)
+*
+* Return:
+*  uint32_t - erase size in bytes
+*
+*******************************************************************************/
+static uint32_t trailer_log_erase_size_at(uint32_t addr)
+{
+#if TRAILER_LOG_HYBRID_SECTORS
+    cy_stc_smif_mem_device_cfg_t const *dev_cfg =
+        qspi_get_memory_config(0)->deviceCfg;
+
+    for (uint32_t i = 0; i < dev_cfg->hybridRegionCount; i++)
+    {
+        cy_stc_smif_hybrid_region_info_t const *region = dev_cfg->hybridRegions[i];
+        uint32_t end = region->regionAddress +
+                       (region->sectorsCount * region->eraseSize);
+
+        if ((addr >= region->regionAddress) && (addr < end))
+        {
+            return region->eraseSize;
+        }
+    }
+#else
+    (void)addr;
+#endif /* TRAILER_LOG_HYBRID_SECTORS */
+
+    return qspi_get_erase_size();
+}
+#endif /* CY_BOOT_USE_EXTERNAL_FLASH */
+
+
+/*******************************************************************************
+* Function Name: trailer_log_mode
+********************************************************************************
+* Summary:
+*  Returns how the trailer of the given flash area is handled. Only the
+*  secondary slot placed in the external flash is handled. The decision is
+*  made once, after the external memory has been initialized.
+*
+* Parameters:
+*  fa - flash area
+*
+* Return:
+*  trailer_log_mode_t - mode used for the trailer of this area
+*
+*******************************************************************************/
+static trailer_log_mode_t trailer_log_mode(const struct flash_area *fa)
+{
+#ifdef CY_BOOT_USE_EXTERNAL_FLASH
+    if ((fa->fa_id != FLASH_AREA_IMAGE_SECONDARY(0)) ||
+        ((fa->fa_device_id & FLASH_DEVICE_EXTERNAL_FLAG) == 0U))
+    {
+        return TRAILER_MODE_UNKNOWN;
+    }
+
+    if (TRAILER_MODE_UNKNOWN == trailer_mode)
+    {
+        uint32_t addr = fa->fa_off - CY_SMIF_BASE_MEM_OFFSET +
+                        fa->fa_size - CY_TRAILER_LOG_DATA_SIZE;
+        uint32_t erase_size = trailer_log_erase_size_at(addr);
+
+        if (erase_size <= CY_TRAILER_LOG_SUBSECTOR_MAX_SIZE)
+        {
+            trailer_mode = TRAILER_MODE_SUBSECTOR;
+            BOOT_LOG_INF("Trailer: using %u byte sub-sector erase",
+                         (unsigned int)erase_size);
+        }
+        else
+        {
+            trailer_mode = TRAILER_MODE_LOG;
+            BOOT_LOG_INF("Trailer: %u KB erase unit, using internal flash log",
+                         (unsigned int)(erase_size / 1024U));
+        }
+    }
+
+    return trailer_mode;
+#else
+    (void)fa;
+    return TRAILER_MODE_UNKNOWN;
+#endif /* CY_BOOT_USE_EXTERNAL_FLASH */
+}
+
+
+/*******************************************************************************
+* Function Name: trailer_log_load
+********************************************************************************
+* Summary:
+*  Scans the log rows and loads the record with the highest sequence number.
+*  When no valid record is found, the trailer reads as erased and no sector
+*  erase is pending.
+*
+*******************************************************************************/
+static void trailer_log_load(void)
+{
+    bool found = false;
+
+    if (log_loaded)
+    {
+        return;
+    }
+
+    log_seq = 0;
+    log_row = CY_TRAILER_LOG_ROWS - 1U;
+    log_erase_pending = false;
+    memset(log_data, TRAILER_LOG_ERASE_VALUE, sizeof(log_data));
+
+    for (uint32_t row = 0; row < CY_TRAILER_LOG_ROWS; row++)
+    {
+        const trailer_log_record_t *record =
+            (const trailer_log_record_t *)TRAILER_LOG_ROW_ADDR(row);
+
+        if ((TRAILER_LOG_MAGIC == record->magic) &&
+            (trailer_log_checksum(record) == record->checksum) &&
+            (!found || ((int32_t)(record->seq - log_seq) > 0)))
+        {
+            found = true;
+            log_seq = record->seq;
+            log_row = row;
+            log_erase_pending = ((record->flags & TRAILER_LOG_FLAG_ERASE_PENDING) != 0U);
+            memcpy(log_data, record->data, sizeof(log_data));
+        }
+    }
+
+    log_loaded = true;
+}
+
+
+/*******************************************************************************
+* Function Name: trailer_log_commit
+********************************************************************************
+* Summary:
+*  Writes the current trailer content and the pending sector erase to the
+*  next row of the log.
+*
+* Return:
+*  int - 0 on success, -1 otherwise
+*
+*******************************************************************************/
+static int trailer_log_commit(void)
+{
+    trailer_log_record_t *record = (trailer_log_record_t *)row_buf;
+    uint32_t row = (log_row + 1U) % CY_TRAILER_LOG_ROWS;
+
+    memset(row_buf, 0, sizeof(row_buf));
+    record->magic = TRAILER_LOG_MAGIC;
+    record->seq = log_seq + 1U;
+    record->flags = log_erase_pending ? TRAILER_LOG_FLAG_ERASE_PENDING : 0U;
+    memcpy(record->data, log_data, sizeof(record->data));
+    record->checksum = trailer_log_checksum(record);
+
+    if (CY_FLASH_DRV_SUCCESS != Cy_Flash_WriteRow(TRAILER_LOG_ROW_ADDR(row), row_buf))
+    {
+        BOOT_LOG_ERR("Trailer: log row %u write failed", (unsigned int)row);
+        return -1;
+    }
+
+    log_seq = record->seq;
+    log_row = row;
+    log_stats.transitions++;
+
+    return 0;
+}
+
+
+/*******************************************************************************
+* Function Name: trailer_log_note_saved
+********************************************************************************
+* Summary:
+*  Accounts for one uniform sector erase that the current transition did not
+*  need and reports the latency saved by it. The time is an estimate from the
+*  typical times of the datasheets, not a measurement.
+*
+* Parameters:
+*  saved_ms - estimated time saved by this transition
+*
+*******************************************************************************/
+static void trailer_log_note_saved(uint32_t saved_ms)
+{
+    log_stats.erases_avoided++;
+    log_stats.saved_ms += saved_ms;
+
+    BOOT_LOG_INF("Trailer: state transition saved ~%u ms (estimate, total %u ms)",
+                 (unsigned int)saved_ms, (unsigned int)log_stats.saved_ms);
+}
+
+
+/*******************************************************************************
+* Function Name: trailer_log_covers
+********************************************************************************
+* Summary:
+*  Checks whether any part of the given range of a flash area is kept in the
+*  trailer log instead of the flash area itself: the emulated trailer, and
+*  the rest of its logical sector while its erase is deferred.
+*
+* Parameters:
+*  fa - flash area
+*  off - offset within the flash area
+*  len - length of the range
+*
+* Return:
+*  bool - true if the range overlaps the emulated trailer or the deferred
+*  erase
+*
+*******************************************************************************/
+bool trailer_log_covers(const struct flash_area *fa, uint32_t off, uint32_t len)
+{
+    if (TRAILER_MODE_LOG != trailer_log_mode(fa))
+    {
+        return false;
+    }
+
+    return ((off + len) > trailer_log_erased_off(fa)) && (off < fa->fa_size);
+}
+
+
+/*******************************************************************************
+* Function Name: trailer_log_region_off
+********************************************************************************
+* Summary:
+*  Returns the offset of the emulated trailer region within the flash area.
+*
+* Parameters:
+*  fa - flash area
+*
+* Return:
+*  uint32_t - offset of the first emulated byte
+*
+*******************************************************************************/
+uint32_t trailer_log_region_off(const struct flash_area *fa)
+{
+    return fa->fa_size - CY_TRAILER_LOG_DATA_SIZE;
+}
+
+
+/*******************************************************************************
+* Function Name: trailer_log_erased_off
+********************************************************************************
+* Summary:
+*  Returns the offset within the flash area from which the bytes are kept in
+*  the trailer log. While the erase of the logical sector holding the trailer
+*  is deferred, the bytes of that sector before the emulated trailer read as
+*  erased.
+*
+* Parameters:
+*  fa - flash area
+*
+* Return:
+*  uint32_t - start of the logical trailer sector if its erase is deferred,
+*  otherwise the offset of the first emulated byte
+*
+*******************************************************************************/
+uint32_t trailer_log_erased_off(const struct flash_area *fa)
+{
+    if (TRAILER_MODE_LOG == trailer_log_mode(fa))
+    {
+        trailer_log_load();
+
+        if (log_erase_pending)
+        {
+            return fa->fa_size - CY_TRAILER_LOG_SECTOR_SIZE;
+        }
+    }
+
+    return trailer_log_region_off(fa);
+}
+
+
+/*******************************************************************************
+* Function Name: trailer_log_read
+********************************************************************************
+* Summary:
+*  Reads from the emulated trailer.
+*
+* Parameters:
+*  off - offset relative to the start of the emulated trailer
+*  dst - destination buffer
+*  len - number of bytes to read
+*
+* Return:
+*  int - 0 on success, -1 if the range is outside the trailer
+*
+*******************************************************************************/
+int trailer_log_read(uint32_t off, void *dst, uint32_t len)
+{
+    if ((off + len) > CY_TRAILER_LOG_DATA_SIZE)
+    {
+        return -1;
+    }
+
+    trailer_log_load();
+    memcpy(dst, &log_data[off], len);
+
+    return 0;
+}
+
+
+/*******************************************************************************
+* Function Name: trailer_log_write
+********************************************************************************
+* Summary:
+*  Writes to the emulated trailer. If the new bytes could not have been
+*  programmed over the current content of a NOR cell (a 0 -> 1 transition),
+*  the write would have needed a sector erase, which is accounted as saved.
+*
+* Parameters:
+*  off - offset relative to the start of the emulated trailer
+*  src - source buffer
+*  len - number of bytes to write
+*
+* Return:
+*  int - 0 on success, -1 otherwise
+*
+*******************************************************************************/
+int trailer_log_write(uint32_t off, const void *src, uint32_t len)
+{
+    const uint8_t *bytes = (const uint8_t *)src;
+    bool needs_erase = false;
+
+    if ((off + len) > CY_TRAILER_LOG_DATA_SIZE)
+    {
+        return -1;
+    }
+
+    trailer_log_load();
+
+    for (uint32_t i = 0; i < len; i++)
+    {
+        if ((log_data[off + i] & bytes[i]) != bytes[i])
+        {
+            needs_erase = true;
+        }
+    }
+
+    memcpy(&log_data[off], bytes, len);
+
+    if (0 != trailer_log_commit())
+    {
+        return -1;
+    }
+
+    if (needs_erase)
+    {
+        trailer_log_note_saved(CY_TRAILER_LOG_EXT_SECTOR_ERASE_MS -
+                               CY_TRAILER_LOG_ROW_WRITE_MS);
+    }
+
+    return 0;
+}
+
+
+/*******************************************************************************
+* Function Name: trailer_log_erase
+********************************************************************************
+* Summary:
+*  Handles an erase request of a flash area with respect to its trailer.
+*
+*  In the log mode, an erase that overlaps the emulated trailer resets the
+*  log. An erase of the whole logical sector holding the trailer, as MCUboot
+*  does after an upgrade, is deferred: the log records it, the bytes of the
+*  sector before the trailer read as erased, and trailer_log_flush() erases
+*  the sector before it is next written. An erase within the emulated
+*  trailer bytes, or within the sector while its erase is deferred, is
+*  handled too. Any other erase is left to the caller.
+*
+*  In the sub-sector mode, an erase within the logical trailer sector is done
+*  with the small erase command of the device instead of a uniform sector
+*  erase.
+*
+* Parameters:
+*  fa - flash area
+*  off - offset within the flash area
+*  len - length of the range
+*  erase_sector - false when the caller keeps the bytes of the range that are
+*  not in the trailer; the erase is then not deferred
+*  handled - set to true when no further physical erase is needed
+*
+* Return:
+*  int - 0 on success, -1 otherwise
+*
+*******************************************************************************/
+int trailer_log_erase(const struct flash_area *fa, uint32_t off, uint32_t len,
+                      bool erase_sector, bool *handled)
+{
+    trailer_log_mode_t mode = trailer_log_mode(fa);
+    uint32_t region_off = trailer_log_region_off(fa);
+    uint32_t sector_off = fa->fa_size - CY_TRAILER_LOG_SECTOR_SIZE;
+    bool in_trailer_sector = (off >= sector_off) && ((off + len) <= fa->fa_size);
+
+    *handled = false;
+
+    if (TRAILER_MODE_LOG == mode)
+    {
+        bool in_trailer_log = (off >= region_off) && ((off + len) <= fa->fa_size);
+        bool overlaps_log = ((off + len) > region_off) && (off < fa->fa_size);
+        bool overlaps_sector = ((off + len) > sector_off) && (off < region_off);
+        bool changed = false;
+        bool deferred = false;
+
+        trailer_log_load();
+
+        if (overlaps_log)
+        {
+            memset(log_data, TRAILER_LOG_ERASE_VALUE, sizeof(log_data));
+            changed = true;
+        }
+
+        if (erase_sector && overlaps_sector && in_trailer_sector &&
+            (log_erase_pending || (off == sector_off)))
+        {
+            if (!log_erase_pending)
+            {
+                log_erase_pending = true;
+                changed = true;
+                deferred = true;
+            }
+
+            *handled = true;
+        }
+        else if (erase_sector && log_erase_pending &&
+                 (off <= sector_off) && ((off + len) >= region_off))
+        {
+            /* The caller erases the whole sector. */
+            log_erase_pending = false;
+            changed = true;
+        }
+        else
+        {
+            *handled = in_trailer_log;
+        }
+
+        if (changed && (0 != trailer_log_commit()))
+        {
+            *handled = false;
+            return -1;
+        }
+
+        if (deferred)
+        {
+            log_stats.erases_deferred++;
+        }
+
+        if (*handled)
+        {
+            trailer_log_note_saved(CY_TRAILER_LOG_EXT_SECTOR_ERASE_MS -
+                                   CY_TRAILER_LOG_ROW_WRITE_MS);
+        }
+    }
+#ifdef CY_BOOT_USE_EXTERNAL_FLASH
+    else if ((TRAILER_MODE_SUBSECTOR == mode) && in_trailer_sector)
+    {
+        uint32_t addr = fa->fa_off - CY_SMIF_BASE_MEM_OFFSET + off;
+        uint32_t erase_size = trailer_log_erase_size_at(addr);
+        uint32_t start = addr & ~(erase_size - 1U);
+        uint32_t end = (addr + len + erase_size - 1U) & ~(erase_size - 1U);
+
+        if (CY_SMIF_SUCCESS != Cy_SMIF_MemEraseSector(qspi_get_device(),
+                                                      qspi_get_memory_config(0),
+                                                      start, end - start,
+                                                      qspi_get_context()))
+        {
+            return -1;
+        }
+
+        *handled = true;
+        log_stats.transitions++;
+        trailer_log_note_saved(CY_TRAILER_LOG_EXT_SECTOR_ERASE_MS -
+                               CY_TRAILER_LOG_EXT_SUBSECTOR_ERASE_MS);
+    }
+#endif /* CY_BOOT_USE_EXTERNAL_FLASH */
+    else
+    {
+        /* Not handled by the trailer log */
+    }
+
+    return 0;
+}
+
+
+/*******************************************************************************
+* Function Name: trailer_log_flush
+********************************************************************************
+* Summary:
+*  Erases the logical sector holding the trailer in the flash before a write
+*  to it, when its erase was deferred. The emulated trailer bytes of the
+*  sector are kept in the log and are not affected.
+*
+* Parameters:
+*  fa - flash area
+*  off - offset within the flash area of the write
+*  len - length of the write
+*  erase - erases a range of the flash area in the flash
+*
+* Return:
+*  int - 0 on success, -1 otherwise
+*
+*******************************************************************************/
+int trailer_log_flush(const struct flash_area *fa, uint32_t off, uint32_t len,
+                      trailer_log_erase_fn_t erase)
+{
+    uint32_t sector_off = fa->fa_size - CY_TRAILER_LOG_SECTOR_SIZE;
+
+    if ((TRAILER_MODE_LOG != trailer_log_mode(fa)) ||
+        ((off + len) <= sector_off) || (off >= trailer_log_region_off(fa)))
+    {
+        return 0;
+    }
+
+    trailer_log_load();
+
+    if (!log_erase_pending)
+    {
+        return 0;
+    }
+
+    if (0 != erase(fa, sector_off, CY_TRAILER_LOG_SECTOR_SIZE))
+    {
+        BOOT_LOG_ERR("Trailer: deferred sector erase failed");
+        return -1;
+    }
+
+    log_erase_pending = false;
+
+    return trailer_log_commit();
+}
+
+
+/*******************************************************************************
+* Function Name: trailer_log_get_stats
+********************************************************************************
+* Summary:
+*  Returns the statistics of the trailer state transitions since reset.
+*
+* Parameters:
+*  stats - destination of the statistics
+*
+*******************************************************************************/
+void trailer_log_get_stats(trailer_log_stats_t *stats)
+{
+    *stats = log_stats;
+}
+
+#endif /* CY_BOOT_USE_TRAILER_LOG */
+
+
+/* [] END OF FILE */
@@ -0,0 +1,147 @@
+/******************************************************************************
+* File Name:   trailer_log.h
+*
+* Description: This file contains the macros and function declarations of the
+* trailer log used to keep the image trailer of the secondary slot out of the
+* external flash.
+*
+* Related Document: See README.md
+*
+*******************************************************************************
+* (c) 2020, Cypress Semiconductor Corporation. All rights reserved.
+*******************************************************************************
+* This software, including source code, documentation and related materials
+* ("Software"), is owned by Cypress Semiconductor Corporation or one of its
+* subsidiaries ("Cypress") and is protected by and subject to worldwide patent
+* protection (United States and foreign), United States copyright laws and
+* international treaty provisions. Therefore, you may use this Software only
+* as provided in the license agreement accompanying the software package from
+* which you obtained this Software ("EULA").
+*
+* If no EULA applies, Cypress hereby grants you a personal, non-exclusive,
+* non-transferable license to copy, modify, and compile the Software source
+* code solely for use in connection with Cypress's integrated circuit products.
+* Any reproduction, modification, translation, compilation, or representation
+* of this Software except as specified above is prohibited without the express
+* written permission of Cypress.
+*
+* Disclaimer: THIS SOFTWARE IS PROVIDED AS-IS, WITH NO WARRANTY OF ANY KIND,
+* EXPRESS OR IMPLIED, INCLUDING, BUT NOT LIMITED TO, NONINFRINGEMENT, IMPLIED
+* WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE. Cypress
+* reserves the right to make changes to the Software without notice. Cypress
+* does not assume any liability arising out of the application or use of the
+* Software or any product or circuit described in the Software. Cypress does
+* not authorize its products for use in any products where a malfunction or
+* failure of the Cypress product may reasonably be expected to result in
+* significant property damage, injury or death ("High Risk Product"). By
+* including Cypress's product in a High Risk Product, the manufacturer of such
+* system or application assumes all risk of such use and in doing so agrees to
+* indemnify Cypress against all liability.
+*******************************************************************************/
+#ifndef TRAILER_LOG_H
+#define TRAILER_LOG_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "flash_map_backend/flash_map_backend.h"
+
+
+/*******************************************************************************
+* Macros
+*******************************************************************************/
+/* Number of bytes at the end of the secondary slot that are emulated by the
+ * trailer log. This covers the MCUboot magic and the image_ok, copy_done,
+ * swap_info and swap_size fields (4 x BOOT_MAX_ALIGN + 16 bytes).
+ */
+#ifndef CY_TRAILER_LOG_DATA_SIZE
+#define CY_TRAILER_LOG_DATA_SIZE                (64UL)
+#endif
+
+/* Number of internal flash rows used by the trailer log. Every state
+ * transition writes the next row, so the wear is spread over all of them.
+ */
+#ifndef CY_TRAILER_LOG_ROWS
+#define CY_TRAILER_LOG_ROWS                     (8UL)
+#endif
+
+/* Start address of the trailer log in internal flash. By default it is placed
+ * right after the scratch area, which is not used in the overwrite-only mode.
+ */
+#ifndef CY_TRAILER_LOG_START
+#define CY_TRAILER_LOG_START                    (CY_FLASH_BASE +\
+                                                 CY_BOOT_BOOTLOADER_SIZE +\
+                                                 CY_BOOT_PRIMARY_1_SIZE +\
+                                                 CY_BOOT_SCRATCH_SIZE)
+#endif
+
+/* Size of the logical sector that holds the trailer. It is the same sector
+ * size that the flash map reports to MCUboot for the external flash.
+ */
+#ifndef CY_TRAILER_LOG_SECTOR_SIZE
+#define CY_TRAILER_LOG_SECTOR_SIZE              (CY_BOOT_SCRATCH_SIZE)
+#endif
+
+/* Largest erase granularity that is still treated as a sub-sector erase.
+ * Devices that expose hybrid (parameter) sectors of this size or smaller at
+ * the trailer address keep the trailer in place.
+ */
+#ifndef CY_TRAILER_LOG_SUBSECTOR_MAX_SIZE
+#define CY_TRAILER_LOG_SUBSECTOR_MAX_SIZE       (0x1000UL)
+#endif
+
+/* Typical time to erase one uniform sector of the external flash. The
+ * default is the S25FL512S 256 KB sector erase time from the datasheet. These
+ * typical times only serve to estimate the time saved; nothing is measured.
+ */
+#ifndef CY_TRAILER_LOG_EXT_SECTOR_ERASE_MS
+#define CY_TRAILER_LOG_EXT_SECTOR_ERASE_MS      (520UL)
+#endif
+
+/* Typical time to erase one 4 KB parameter sector of the external flash. */
+#ifndef CY_TRAILER_LOG_EXT_SUBSECTOR_ERASE_MS
+#define CY_TRAILER_LOG_EXT_SUBSECTOR_ERASE_MS   (130UL)
+#endif
+
+/* Typical time to write one row of the internal flash. */
+#ifndef CY_TRAILER_LOG_ROW_WRITE_MS
+#define CY_TRAILER_LOG_ROW_WRITE_MS             (16UL)
+#endif
+
+
+/*******************************************************************************
+* Data structure and enumeration
+*******************************************************************************/
+/* Erases a range of a flash area in the flash itself. */
+typedef int (*trailer_log_erase_fn_t)(const struct flash_area *fa, uint32_t off,
+                                      uint32_t len);
+
+/* Statistics of the trailer state transitions handled by the trailer log. */
+typedef struct
+{
+    uint32_t transitions;       /* Trailer writes and erases handled */
+    uint32_t erases_avoided;    /* Uniform sector erases that were not needed */
+    uint32_t erases_deferred;   /* Trailer sector erases left to the next
+                                 * write of the sector */
+    uint32_t saved_ms;          /* Erase time saved in total, estimated from
+                                 * the typical times below, not measured */
+} trailer_log_stats_t;
+
+
+/*******************************************************************************
+* Function prototypes
+*******************************************************************************/
+bool trailer_log_covers(const struct flash_area *fa, uint32_t off, uint32_t len);
+uint32_t trailer_log_region_off(const struct flash_area *fa);
+uint32_t trailer_log_erased_off(const struct flash_area *fa);
+int trailer_log_read(uint32_t off, void *dst, uint32_t len);
+int trailer_log_write(uint32_t off, const void *src, uint32_t len);
+int trailer_log_erase(const struct flash_area *fa, uint32_t off, uint32_t len,
+                      bool defer, bool *handled);
+int trailer_log_flush(const struct flash_area *fa, uint32_t off, uint32_t len,
+                      trailer_log_erase_fn_t erase);
+void trailer_log_get_stats(trailer_log_stats_t *stats);
+
+#endif /* TRAILER_LOG_H */
+
+
+/* [] END OF FILE */
@@ -39,10 +39,25 @@
 /**
  * @brief Log base 2 of the size of the file data block message (excluding the header).
  *
- * 10 bits yields a data block size of 1KB.
+ * 10 bits yields a data block size of 1KB. It is also the block size of the
+ * downloads over HTTP, so it is kept with CY_OTA_ADAPTIVE_BLOCK_SIZE.
  */
 #define otaconfigLOG2_FILE_BLOCK_SIZE           10UL    /* 2^10 = 1024 block size */
 
+/**
+ * @brief Maximum number of 2^otaconfigLOG2_FILE_BLOCK_SIZE blocks carried by one streamed block.
+ *
+ * Used when CY_OTA_ADAPTIVE_BLOCK_SIZE is defined: the size of the streamed blocks is picked at
+ * runtime from 1 to this number of blocks (see ota_block_size.c). A streamed block and its CBOR
+ * header must fit in the data buffers of the agent, 2^otaconfigLOG2_FILE_BLOCK_SIZE + 1530 bytes,
+ * so 2 x 1024 = 2048 bytes is the largest size.
+ */
+#if defined(CY_OTA_ADAPTIVE_BLOCK_SIZE)
+#define otaconfigMAX_FILE_BLOCK_UNITS           2U
+#else
+#define otaconfigMAX_FILE_BLOCK_UNITS           1U
+#endif
+
 /**
  * @brief Milliseconds to wait for the self test phase to succeed before we force reset.
  */
@@ -144,9 +159,14 @@
  * one protocol is selected while creating OTA job. Default primary data protocol is MQTT
  * and following update here to switch to HTTP as primary.
  *
- * Note - use OTA_DATA_OVER_HTTP for HTTP as primary data protocol.
+ * Note - use OTA_DATA_OVER_HTTP for HTTP as primary data protocol. Set with
+ * OTA_DATA_PROTOCOL in the Makefile.
  */
 
+#if defined(CY_OTA_HTTP_PRIMARY)
+#define configOTA_PRIMARY_DATA_PROTOCOL     ( OTA_DATA_OVER_HTTP )
+#else
 #define configOTA_PRIMARY_DATA_PROTOCOL     ( OTA_DATA_OVER_MQTT )
+#endif
 
 #endif /* _AWS_OTA_AGENT_CONFIG_H_ */
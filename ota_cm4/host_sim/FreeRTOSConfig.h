@@ -0,0 +1,133 @@
+/******************************************************************************
+* File Name: FreeRTOSConfig.h
+*
+* Description: FreeRTOS configuration of the host OTA simulation. It takes the
+* place of config_files/FreeRTOSConfig.h for the FreeRTOS POSIX port, which
+* runs every task as a thread of the simulation process.
+*
+* Related Document: See README.md
+*
+*******************************************************************************
+* (c) 2020, Cypress Semiconductor Corporation. All rights reserved.
+*******************************************************************************
+* This software, including source code, documentation and related materials
+* ("Software"), is owned by Cypress Semiconductor Corporation or one of its
+* subsidiaries ("Cypress") and is protected by and subject to worldwide patent
+* protection (United States and foreign), United States copyright laws and
+* international treaty provisions. Therefore, you may use this Software only
+* as provided in the license agreement accompanying the software package from
+* which you obtained this Software ("EULA").
+*
+* If no EULA applies, Cypress hereby grants you a personal, non-exclusive,
+* non-transferable license to copy, modify, and compile the Software source
+* code solely for use in connection with Cypress's integrated circuit products.
+* Any reproduction, modification, translation, compilation, or representation
+* of this Software except as specified above is prohibited without the express
+* written permission of Cypress.
+*
+* Disclaimer: THIS SOFTWARE IS PROVIDED AS-IS, WITH NO WARRANTY OF ANY KIND,
+* EXPRESS OR IMPLIED, INCLUDING, BUT NOT LIMITED TO, NONINFRINGEMENT, IMPLIED
+* WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE. Cypress
+* reserves the right to make changes to the Software without notice. Cypress
+* does not assume any liability arising out of the application or use of the
+* Software or any product or circuit described in the Software. Cypress does
+* not authorize its products for use in any products where a malfunction or
+* failure of the Cypress product may reasonably be expected to result in
+* significant property damage, injury or death ("High Risk Product"). By
+* including Cypress's product in a High Risk Product, the manufacturer of such
+* system or application assumes all risk of such use and in doing so agrees to
+* indemnify Cypress against all liability.
+*******************************************************************************/
+#ifndef FREERTOS_CONFIG_H
+#define FREERTOS_CONFIG_H
+
+#if defined(__STDC__) || defined(__cplusplus__)
+
+#include <stdio.h>
+#include <string.h>
+#include <stdint.h>
+#include <assert.h>
+
+/* The log of the agent and of the simulation, printed with --verbose */
+extern void vLoggingPrintf(const char * pcFormat, ...);
+#define configPRINTF(X)    vLoggingPrintf X
+
+extern void vLoggingPrint(const char * pcMessage);
+#define configPRINT(X)     vLoggingPrint(X)
+
+#define configASSERT(x)    assert(x)
+
+#endif /* __STDC__ || __cplusplus__ */
+
+#define configENABLE_BACKWARD_COMPATIBILITY         1
+#define configUSE_PORT_OPTIMISED_TASK_SELECTION     0
+#define configUSE_PREEMPTION                        1
+#define configMAX_PRIORITIES                        7
+#define configTICK_RATE_HZ                          ((TickType_t)1000)
+#define configUSE_16_BIT_TICKS                      0
+#define configMINIMAL_STACK_SIZE                    ((unsigned short)4096)
+#define configMAX_TASK_NAME_LEN                     10
+#define configIDLE_SHOULD_YIELD                     1
+#define configUSE_MUTEXES                           1
+#define configUSE_RECURSIVE_MUTEXES                 1
+#define configQUEUE_REGISTRY_SIZE                   8
+#define configUSE_COUNTING_SEMAPHORES               1
+#define configUSE_TASK_NOTIFICATIONS                1
+#define configNUM_THREAD_LOCAL_STORAGE_POINTERS     16
+#define configUSE_TRACE_FACILITY                    1
+#define configGENERATE_RUN_TIME_STATS               0
+
+/* Hook function related definitions. The idle hook sleeps, so that the idle
+ * task does not spin a host CPU and inflate the CPU time of the process.
+ */
+#define configUSE_IDLE_HOOK                         1
+#define configUSE_TICK_HOOK                         0
+#define configUSE_MALLOC_FAILED_HOOK                0
+#define configCHECK_FOR_STACK_OVERFLOW              0
+
+/* Memory allocation configuration. The simulation links heap_4.c, so that
+ * xPortGetFreeHeapSize() works; the heap is sized for the 64-bit stacks of
+ * the host, not to model the heap of the device.
+ */
+#define configSUPPORT_DYNAMIC_ALLOCATION            1
+#define configSUPPORT_STATIC_ALLOCATION             1
+#define configTOTAL_HEAP_SIZE                       ((size_t)(4 * 1024 * 1024))
+
+/* Software timer definitions. */
+#define configUSE_TIMERS                            1
+#define configTIMER_TASK_PRIORITY                   2
+#define configTIMER_QUEUE_LENGTH                    10
+#define configTIMER_TASK_STACK_DEPTH                (configMINIMAL_STACK_SIZE * 4)
+
+/* Co-routine definitions. */
+#define configUSE_CO_ROUTINES                       0
+#define configMAX_CO_ROUTINE_PRIORITIES             2
+
+/* Set the following definitions to 1 to include the API function, or zero
+to exclude the API function. */
+#define INCLUDE_vTaskPrioritySet                    1
+#define INCLUDE_uxTaskPriorityGet                   1
+#define INCLUDE_vTaskDelete                         1
+#define INCLUDE_vTaskCleanUpResources               1
+#define INCLUDE_vTaskSuspend                        1
+#define INCLUDE_vTaskDelayUntil                     1
+#define INCLUDE_vTaskDelay                          1
+#define INCLUDE_xTaskGetSchedulerState              1
+#define INCLUDE_xTaskGetCurrentTaskHandle           1
+#define INCLUDE_uxTaskGetStackHighWaterMark         0
+#define INCLUDE_xTaskGetIdleTaskHandle              0
+#define INCLUDE_eTaskGetState                       0
+#define INCLUDE_xTimerPendFunctionCall              1
+#define INCLUDE_xTaskAbortDelay                     1
+#define INCLUDE_xTaskGetHandle                      0
+
+/* Sets the length of the buffers into which logging messages are written - so
+ * also defines the maximum length of each log message. */
+#define configLOGGING_MAX_MESSAGE_LENGTH            255
+#define configLOGGING_INCLUDE_TIME_AND_TASK_NAME    0
+#define configPRINT_STRING(X)                       fputs((X), stdout)
+
+#endif /* FREERTOS_CONFIG_H */
+
+
+/* [] END OF FILE */
@@ -0,0 +1,295 @@
+/******************************************************************************
+* File Name: bench_cbor_block.c
+*
+* Description: This file contains a host microbenchmark of the decoding of OTA
+* stream blocks. It encodes block responses as the stream service does, then
+* decodes each of them many times with the decoder of the agent
+* (OTA_CBOR_Decode_GetStreamResponseMessage) and with the in-place decoder of
+* sources/ota_cbor_block.c. For each block size it prints the time and the
+* heap allocations per block of both as key=value lines.
+*
+* Related Document: See README.md
+*
+*******************************************************************************
+* (c) 2020, Cypress Semiconductor Corporation. All rights reserved.
+*******************************************************************************
+* This software, including source code, documentation and related materials
+* ("Software"), is owned by Cypress Semiconductor Corporation or one of its
+* subsidiaries ("Cypress") and is protected by and subject to worldwide patent
+* protection (United States and foreign), United States copyright laws and
+* international treaty provisions. Therefore, you may use this Software only
+* as provided in the license agreement accompanying the software package from
+* which you obtained this Software ("EULA").
+*
+* If no EULA applies, Cypress hereby grants you a personal, non-exclusive,
+* non-transferable license to copy, modify, and compile the Software source
+* code solely for use in connection with Cypress's integrated circuit products.
+* Any reproduction, modification, translation, compilation, or representation
+* of this Software except as specified above is prohibited without the express
+* written permission of Cypress.
+*
+* Disclaimer: THIS SOFTWARE IS PROVIDED AS-IS, WITH NO WARRANTY OF ANY KIND,
+* EXPRESS OR IMPLIED, INCLUDING, BUT NOT LIMITED TO, NONINFRINGEMENT, IMPLIED
+* WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE. Cypress
+* reserves the right to make changes to the Software without notice. Cypress
+* does not assume any liability arising out of the application or use of the
+* Software or any product or circuit described in the Software. Cypress does
+* not authorize its products for use in any products where a malfunction or
+* failure of the Cypress product may reasonably be expected to result in
+* significant property damage, injury or death ("High Risk Product"). By
+* including Cypress's product in a High Risk Product, the manufacturer of such
+* system or application assumes all risk of such use and in doing so agrees to
+* indemnify Cypress against all liability.
+*******************************************************************************/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "FreeRTOS.h"
+#include "cbor.h"
+#include "aws_iot_ota_cbor.h"
+#include "ota_cbor_block.h"
+
+
+/*******************************************************************************
+ * Macros
+ ******************************************************************************/
+#define BENCH_DEFAULT_ITERATIONS        (100000UL)
+#define BENCH_BLOCK_SIZE_MIN            (256U)
+#define BENCH_BLOCK_SIZE_MAX            (4096U)
+#define BENCH_FILE_ID                   (0)
+#define BENCH_BLOCK_ID                  (123)
+
+/* Map head, keys and integer values around the payload */
+#define BENCH_MESSAGE_OVERHEAD          (64U)
+
+#define NS_PER_S                        (1000000000ULL)
+
+#define EXIT_USAGE                      (2)
+
+
+/*******************************************************************************
+ * Global variables
+ ******************************************************************************/
+static unsigned long allocations;
+
+
+/*******************************************************************************
+ * Function Name: pvPortMalloc
+ *******************************************************************************
+ * Summary:
+ *  Heap of the agent decoder, counting the allocations.
+ *
+ ******************************************************************************/
+void *pvPortMalloc(size_t xSize)
+{
+    allocations++;
+    return malloc(xSize);
+}
+
+
+/*******************************************************************************
+ * Function Name: vPortFree
+ ******************************************************************************/
+void vPortFree(void *pv)
+{
+    free(pv);
+}
+
+
+/*******************************************************************************
+ * Function Name: vLoggingPrintf
+ *******************************************************************************
+ * Summary:
+ *  Drops the logs of the agent decoder.
+ *
+ ******************************************************************************/
+void vLoggingPrintf(const char *pcFormat, ...)
+{
+    (void)pcFormat;
+}
+
+
+/*******************************************************************************
+ * Function Name: now_ns
+ ******************************************************************************/
+static uint64_t now_ns(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    return ((uint64_t)ts.tv_sec * NS_PER_S) + (uint64_t)ts.tv_nsec;
+}
+
+
+/*******************************************************************************
+ * Function Name: encode_block
+ *******************************************************************************
+ * Summary:
+ *  Encodes a block response as the stream service sends it.
+ *
+ * Parameters:
+ *  buf, buf_size - message buffer
+ *  payload, payload_size - block data
+ *
+ * Return:
+ *  size_t - size of the message, 0 if it does not fit
+ *
+ ******************************************************************************/
+static size_t encode_block(uint8_t *buf, size_t buf_size,
+                           const uint8_t *payload, size_t payload_size)
+{
+    CborEncoder encoder;
+    CborEncoder map;
+    CborError err;
+
+    cbor_encoder_init(&encoder, buf, buf_size, 0);
+    err = cbor_encoder_create_map(&encoder, &map, 4);
+    err |= cbor_encode_text_stringz(&map, "f");
+    err |= cbor_encode_int(&map, BENCH_FILE_ID);
+    err |= cbor_encode_text_stringz(&map, "i");
+    err |= cbor_encode_int(&map, BENCH_BLOCK_ID);
+    err |= cbor_encode_text_stringz(&map, "l");
+    err |= cbor_encode_int(&map, (int64_t)payload_size);
+    err |= cbor_encode_text_stringz(&map, "p");
+    err |= cbor_encode_byte_string(&map, payload, payload_size);
+    err |= cbor_encoder_close_container_checked(&encoder, &map);
+
+    return (CborNoError == err) ? cbor_encoder_get_buffer_size(&encoder, buf) : 0U;
+}
+
+
+/*******************************************************************************
+ * Function Name: bench_block_size
+ *******************************************************************************
+ * Summary:
+ *  Decodes a block of the given size with both decoders, checks that they
+ *  agree, and prints their time and allocations per block.
+ *
+ * Return:
+ *  bool - false if a decoder failed or the decoders disagree
+ *
+ ******************************************************************************/
+static bool bench_block_size(size_t block_size, unsigned long iterations)
+{
+    static uint8_t payload[BENCH_BLOCK_SIZE_MAX];
+    static uint8_t msg[BENCH_BLOCK_SIZE_MAX + BENCH_MESSAGE_OVERHEAD];
+    size_t msg_size;
+    ota_cbor_block_t block;
+    int32_t file_id;
+    int32_t block_id;
+    int32_t size;
+    uint8_t *data;
+    size_t data_size;
+    unsigned long generic_allocations;
+    uint64_t generic_ns;
+    uint64_t inplace_ns;
+    uint64_t start;
+
+    for (size_t i = 0U; i < block_size; i++)
+    {
+        payload[i] = (uint8_t)(i * 31U);
+    }
+
+    msg_size = encode_block(msg, sizeof(msg), payload, block_size);
+    if (0U == msg_size)
+    {
+        return false;
+    }
+
+    allocations = 0U;
+    start = now_ns();
+    for (unsigned long n = 0U; n < iterations; n++)
+    {
+        data = NULL;
+        data_size = block_size;
+        if (!OTA_CBOR_Decode_GetStreamResponseMessage(msg, msg_size, &file_id,
+                &block_id, &size, &data, &data_size))
+        {
+            return false;
+        }
+        vPortFree(data);
+    }
+    generic_ns = now_ns() - start;
+    generic_allocations = allocations;
+
+    allocations = 0U;
+    start = now_ns();
+    for (unsigned long n = 0U; n < iterations; n++)
+    {
+        if (!ota_cbor_block_decode(msg, msg_size, &block))
+        {
+            return false;
+        }
+    }
+    inplace_ns = now_ns() - start;
+
+    /* Both decoders must return the same block */
+    data = NULL;
+    data_size = block_size;
+    if (!OTA_CBOR_Decode_GetStreamResponseMessage(msg, msg_size, &file_id,
+            &block_id, &size, &data, &data_size) ||
+        (block.file_id != file_id) || (block.block_id != block_id) ||
+        (block.block_size != size) || (block.payload_size != data_size) ||
+        (0 != memcmp(block.payload, data, data_size)))
+    {
+        vPortFree(data);
+        return false;
+    }
+    vPortFree(data);
+
+    printf("block_size=%lu\n", (unsigned long)block_size);
+    printf("message_bytes=%lu\n", (unsigned long)msg_size);
+    printf("generic_ns_per_block=%.1f\n", (double)generic_ns / iterations);
+    printf("generic_allocs_per_block=%.2f\n", (double)generic_allocations / iterations);
+    printf("inplace_ns_per_block=%.1f\n", (double)inplace_ns / iterations);
+    printf("inplace_allocs_per_block=%.2f\n", (double)allocations / iterations);
+
+    return true;
+}
+
+
+/*******************************************************************************
+ * Function Name: main
+ *******************************************************************************
+ * Summary:
+ *  Runs the benchmark for block sizes from 256 B to 4 KB. The only argument
+ *  is the number of decodes per block size and decoder.
+ *
+ ******************************************************************************/
+int main(int argc, char *argv[])
+{
+    unsigned long iterations = BENCH_DEFAULT_ITERATIONS;
+
+    if (argc > 2)
+    {
+        fprintf(stderr, "usage: %s [iterations]\n", argv[0]);
+        return EXIT_USAGE;
+    }
+    if (argc == 2)
+    {
+        iterations = strtoul(argv[1], NULL, 0);
+        if (0U == iterations)
+        {
+            fprintf(stderr, "usage: %s [iterations]\n", argv[0]);
+            return EXIT_USAGE;
+        }
+    }
+
+    printf("iterations=%lu\n", iterations);
+    for (size_t size = BENCH_BLOCK_SIZE_MIN; size <= BENCH_BLOCK_SIZE_MAX; size *= 2U)
+    {
+        if (!bench_block_size(size, iterations))
+        {
+            printf("result=fail\n");
+            return EXIT_FAILURE;
+        }
+    }
+    printf("result=pass\n");
+
+    return EXIT_SUCCESS;
+}
+
+
+/* [] END OF FILE */
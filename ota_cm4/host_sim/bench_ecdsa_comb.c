@@ -0,0 +1,379 @@
+/******************************************************************************
+* File Name: bench_ecdsa_comb.c
+*
+* Description: This file contains a host benchmark of the verification of the
+* image signatures with the comb tables of bootloader_cm0p/ecdsa_comb.c. It
+* signs random SHA-256 digests with the test key of bench_ecdsa_comb_key.h,
+* then verifies each signature the way MCUboot does (a new context, the group
+* and the key loaded, mbedtls_ecdsa_read_signature()) with two paths:
+*   - generic: the verification of Mbed TLS, which computes the comb table of
+*     the generator on the first multiplication of each context, and a table
+*     of the key on every multiplication by the key
+*   - comb: __wrap_mbedtls_ecdsa_read_signature(), with the tables made at
+*     build time by scripts/ecdsa_comb_gen.py
+* Mbed TLS is built with 32-bit limbs, as on the device. The benchmark prints
+* the time and cycles per verification of each path as key=value lines, and
+* checks that both paths accept every signature and reject every signature
+* of a modified digest.
+*
+* Related Document: See README.md
+*
+*******************************************************************************
+* (c) 2020, Cypress Semiconductor Corporation. All rights reserved.
+*******************************************************************************
+* This software, including source code, documentation and related materials
+* ("Software"), is owned by Cypress Semiconductor Corporation or one of its
+* subsidiaries ("Cypress") and is protected by and subject to worldwide patent
+* protection (United States and foreign), United States copyright laws and
+* international treaty provisions. Therefore, you may use this Software only
+* as provided in the license agreement accompanying the software package from
+* which you obtained this Software ("EULA").
+*
+* If no EULA applies, Cypress hereby grants you a personal, non-exclusive,
+* non-transferable license to copy, modify, and compile the Software source
+* code solely for use in connection with Cypress's integrated circuit products.
+* Any reproduction, modification, translation, compilation, or representation
+* of this Software except as specified above is prohibited without the express
+* written permission of Cypress.
+*
+* Disclaimer: THIS SOFTWARE IS PROVIDED AS-IS, WITH NO WARRANTY OF ANY KIND,
+* EXPRESS OR IMPLIED, INCLUDING, BUT NOT LIMITED TO, NONINFRINGEMENT, IMPLIED
+* WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE. Cypress
+* reserves the right to make changes to the Software without notice. Cypress
+* does not assume any liability arising out of the application or use of the
+* Software or any product or circuit described in the Software. Cypress does
+* not authorize its products for use in any products where a malfunction or
+* failure of the Cypress product may reasonably be expected to result in
+* significant property damage, injury or death ("High Risk Product"). By
+* including Cypress's product in a High Risk Product, the manufacturer of such
+* system or application assumes all risk of such use and in doing so agrees to
+* indemnify Cypress against all liability.
+*******************************************************************************/
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <time.h>
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+#include "mbedtls/ecdsa.h"
+#include "bench_ecdsa_comb_key.h"
+
+
+/*******************************************************************************
+ * Macros
+ ******************************************************************************/
+#define BENCH_DEFAULT_ITERATIONS        (200UL)
+
+#define BENCH_HASH_SIZE                 (32U)
+
+/* Uncompressed point at the end of the SubjectPublicKeyInfo of the key */
+#define BENCH_POINT_SIZE                (65U)
+
+#define NS_PER_S                        (1000000000ULL)
+#define NS_PER_US                       (1000ULL)
+
+#define EXIT_USAGE                      (2)
+
+
+/*******************************************************************************
+ * Data structure and enumeration
+ ******************************************************************************/
+typedef int (*bench_verify_t)(mbedtls_ecdsa_context *ctx,
+                              const unsigned char *hash, size_t hlen,
+                              const unsigned char *sig, size_t slen);
+
+typedef struct
+{
+    uint8_t hash[BENCH_HASH_SIZE];
+    uint8_t sig[MBEDTLS_ECDSA_MAX_LEN];
+    size_t sig_len;
+} bench_sig_t;
+
+typedef struct
+{
+    const char *name;
+    bench_verify_t verify;
+} bench_path_t;
+
+
+/*******************************************************************************
+ * Function prototypes
+ ******************************************************************************/
+int __real_mbedtls_ecdsa_read_signature(mbedtls_ecdsa_context *ctx,
+                                        const unsigned char *hash, size_t hlen,
+                                        const unsigned char *sig, size_t slen);
+int __wrap_mbedtls_ecdsa_read_signature(mbedtls_ecdsa_context *ctx,
+                                        const unsigned char *hash, size_t hlen,
+                                        const unsigned char *sig, size_t slen);
+
+
+/*******************************************************************************
+ * Global variables
+ ******************************************************************************/
+static const bench_path_t paths[] =
+{
+    { "generic", __real_mbedtls_ecdsa_read_signature },
+    { "comb", __wrap_mbedtls_ecdsa_read_signature },
+};
+
+static bench_sig_t *sigs;
+
+static uint64_t rng_state = 0x9e3779b97f4a7c15ULL;
+
+
+/*******************************************************************************
+ * Function definitions
+ ******************************************************************************/
+
+/*******************************************************************************
+ * Function Name: now_ns
+ ******************************************************************************/
+static uint64_t now_ns(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    return ((uint64_t)ts.tv_sec * NS_PER_S) + (uint64_t)ts.tv_nsec;
+}
+
+
+/*******************************************************************************
+ * Function Name: now_cycles
+ *******************************************************************************
+ * Summary:
+ *  Time stamp counter of the CPU, 0 where there is none.
+ *
+ ******************************************************************************/
+static uint64_t now_cycles(void)
+{
+#if defined(__x86_64__) || defined(__i386__)
+    return __rdtsc();
+#else
+    return 0U;
+#endif
+}
+
+
+/*******************************************************************************
+ * Function Name: bench_rng
+ *******************************************************************************
+ * Summary:
+ *  Random generator of the digests and of the signing nonces. A fixed
+ *  xorshift sequence, so that every run signs the same digests.
+ *
+ ******************************************************************************/
+static int bench_rng(void *ctx, unsigned char *buf, size_t len)
+{
+    (void)ctx;
+
+    for (size_t i = 0U; i < len; i++)
+    {
+        rng_state ^= rng_state << 13;
+        rng_state ^= rng_state >> 7;
+        rng_state ^= rng_state << 17;
+        buf[i] = (unsigned char)rng_state;
+    }
+
+    return 0;
+}
+
+
+/*******************************************************************************
+ * Function Name: load_key
+ *******************************************************************************
+ * Summary:
+ *  Loads the group and the public key of bench_ecdsa_comb_key.h in a context,
+ *  as MCUboot does before each verification.
+ *
+ ******************************************************************************/
+static int load_key(mbedtls_ecdsa_context *ctx)
+{
+    int ret = mbedtls_ecp_group_load(&ctx->grp, MBEDTLS_ECP_DP_SECP256R1);
+
+    if (0 == ret)
+    {
+        ret = mbedtls_ecp_point_read_binary(&ctx->grp, &ctx->Q,
+                                            &ecdsa_pub_key[ecdsa_pub_key_len - BENCH_POINT_SIZE],
+                                            BENCH_POINT_SIZE);
+    }
+
+    return ret;
+}
+
+
+/*******************************************************************************
+ * Function Name: sign_all
+ *******************************************************************************
+ * Summary:
+ *  Signs random digests with the private key of the test key, after checking
+ *  that it matches the public key the tables are made from.
+ *
+ * Return:
+ *  bool - every digest is signed
+ *
+ ******************************************************************************/
+static bool sign_all(unsigned long count)
+{
+    mbedtls_ecdsa_context signer;
+    mbedtls_ecp_point pub;
+    bool pass = false;
+
+    mbedtls_ecdsa_init(&signer);
+    mbedtls_ecp_point_init(&pub);
+
+    if ((0 == load_key(&signer)) &&
+        (0 == mbedtls_mpi_read_binary(&signer.d, bench_ecdsa_priv_key, sizeof(bench_ecdsa_priv_key))) &&
+        (0 == mbedtls_ecp_mul(&signer.grp, &pub, &signer.d, &signer.grp.G, bench_rng, NULL)) &&
+        (0 == mbedtls_ecp_point_cmp(&pub, &signer.Q)))
+    {
+        pass = true;
+        for (unsigned long i = 0UL; pass && (i < count); i++)
+        {
+            (void)bench_rng(NULL, sigs[i].hash, BENCH_HASH_SIZE);
+            pass = (0 == mbedtls_ecdsa_write_signature(&signer, MBEDTLS_MD_SHA256,
+                                                       sigs[i].hash, BENCH_HASH_SIZE,
+                                                       sigs[i].sig, &sigs[i].sig_len,
+                                                       bench_rng, NULL));
+        }
+    }
+
+    mbedtls_ecp_point_free(&pub);
+    mbedtls_ecdsa_free(&signer);
+
+    return pass;
+}
+
+
+/*******************************************************************************
+ * Function Name: verify_one
+ *******************************************************************************
+ * Summary:
+ *  Verifies a signature in a new context.
+ *
+ ******************************************************************************/
+static int verify_one(const bench_path_t *path, const uint8_t *hash, const bench_sig_t *sig)
+{
+    mbedtls_ecdsa_context ctx;
+    int ret;
+
+    mbedtls_ecdsa_init(&ctx);
+    ret = load_key(&ctx);
+    if (0 == ret)
+    {
+        ret = path->verify(&ctx, hash, BENCH_HASH_SIZE, sig->sig, sig->sig_len);
+    }
+    mbedtls_ecdsa_free(&ctx);
+
+    return ret;
+}
+
+
+/*******************************************************************************
+ * Function Name: check_path
+ *******************************************************************************
+ * Summary:
+ *  Checks that a path accepts the signatures, and rejects them for a digest
+ *  with one bit changed.
+ *
+ ******************************************************************************/
+static bool check_path(const bench_path_t *path, unsigned long count)
+{
+    bool pass = true;
+
+    for (unsigned long i = 0UL; i < count; i++)
+    {
+        uint8_t hash[BENCH_HASH_SIZE];
+
+        memcpy(hash, sigs[i].hash, BENCH_HASH_SIZE);
+        hash[i % BENCH_HASH_SIZE] ^= (uint8_t)(1U << (i % 8U));
+
+        if ((0 != verify_one(path, sigs[i].hash, &sigs[i])) ||
+            (MBEDTLS_ERR_ECP_VERIFY_FAILED != verify_one(path, hash, &sigs[i])))
+        {
+            pass = false;
+        }
+    }
+
+    return pass;
+}
+
+
+/*******************************************************************************
+ * Function Name: main
+ *******************************************************************************
+ * Summary:
+ *  Runs the benchmark. The only argument is the number of signatures
+ *  verified per path.
+ *
+ ******************************************************************************/
+int main(int argc, char *argv[])
+{
+    unsigned long iterations = BENCH_DEFAULT_ITERATIONS;
+    bool pass = true;
+
+    if (argc > 2)
+    {
+        fprintf(stderr, "usage: %s [iterations]\n", argv[0]);
+        return EXIT_USAGE;
+    }
+    if (argc == 2)
+    {
+        iterations = strtoul(argv[1], NULL, 0);
+        if (0U == iterations)
+        {
+            fprintf(stderr, "usage: %s [iterations]\n", argv[0]);
+            return EXIT_USAGE;
+        }
+    }
+
+    sigs = calloc(iterations, sizeof(*sigs));
+    if ((NULL == sigs) || !sign_all(iterations))
+    {
+        printf("result=fail\n");
+        return EXIT_FAILURE;
+    }
+
+    printf("iterations=%lu\n", iterations);
+    for (size_t i = 0U; i < (sizeof(paths) / sizeof(paths[0])); i++)
+    {
+        const bench_path_t *path = &paths[i];
+        uint64_t start_ns;
+        uint64_t start_cycles;
+        uint64_t ns;
+        uint64_t cycles;
+
+        if (!check_path(path, iterations))
+        {
+            printf("%s_check=fail\n", path->name);
+            pass = false;
+        }
+
+        start_ns = now_ns();
+        start_cycles = now_cycles();
+        for (unsigned long n = 0UL; n < iterations; n++)
+        {
+            (void)verify_one(path, sigs[n].hash, &sigs[n]);
+        }
+        cycles = now_cycles() - start_cycles;
+        ns = now_ns() - start_ns;
+
+        printf("%s_us_per_verify=%.1f\n", path->name,
+               (double)ns / (double)NS_PER_US / (double)iterations);
+        if (0U != cycles)
+        {
+            printf("%s_cycles_per_verify=%.0f\n", path->name, (double)cycles / (double)iterations);
+        }
+    }
+
+    free(sigs);
+    printf("result=%s\n", pass ? "pass" : "fail");
+
+    return pass ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+
+/* [] END OF FILE */
@@ -0,0 +1,64 @@
+/******************************************************************************
+* File Name: bench_ecdsa_comb_key.h
+*
+* Description: This file contains the test key of bench_ecdsa_comb.c. The
+* first array is the public key in the format of the keys of
+* bootloader_cm0p/keys, from which the Makefile generates the comb tables. It
+* is not an image signing key.
+*
+* Related Document: See README.md
+*
+*******************************************************************************
+* (c) 2020, Cypress Semiconductor Corporation. All rights reserved.
+*******************************************************************************
+* This software, including source code, documentation and related materials
+* ("Software"), is owned by Cypress Semiconductor Corporation or one of its
+* subsidiaries ("Cypress") and is protected by and subject to worldwide patent
+* protection (United States and foreign), United States copyright laws and
+* international treaty provisions. Therefore, you may use this Software only
+* as provided in the license agreement accompanying the software package from
+* which you obtained this Software ("EULA").
+*
+* If no EULA applies, Cypress hereby grants you a personal, non-exclusive,
+* non-transferable license to copy, modify, and compile the Software source
+* code solely for use in connection with Cypress's integrated circuit products.
+* Any reproduction, modification, translation, compilation, or representation
+* of this Software except as specified above is prohibited without the express
+* written permission of Cypress.
+*
+* Disclaimer: THIS SOFTWARE IS PROVIDED AS-IS, WITH NO WARRANTY OF ANY KIND,
+* EXPRESS OR IMPLIED, INCLUDING, BUT NOT LIMITED TO, NONINFRINGEMENT, IMPLIED
+* WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE. Cypress
+* reserves the right to make changes to the Software without notice. Cypress
+* does not assume any liability arising out of the application or use of the
+* Software or any product or circuit described in the Software. Cypress does
+* not authorize its products for use in any products where a malfunction or
+* failure of the Cypress product may reasonably be expected to result in
+* significant property damage, injury or death ("High Risk Product"). By
+* including Cypress's product in a High Risk Product, the manufacturer of such
+* system or application assumes all risk of such use and in doing so agrees to
+* indemnify Cypress against all liability.
+*******************************************************************************/
+#ifndef BENCH_ECDSA_COMB_KEY_H
+#define BENCH_ECDSA_COMB_KEY_H
+
+static const unsigned char ecdsa_pub_key[] = {
+    0x30, 0x59, 0x30, 0x13, 0x06, 0x07, 0x2a, 0x86, 0x48, 0xce, 0x3d, 0x02, 0x01, 0x06, 0x08, 0x2a,
+    0x86, 0x48, 0xce, 0x3d, 0x03, 0x01, 0x07, 0x03, 0x42, 0x00, 0x04, 0x0a, 0x5e, 0x3f, 0xc6, 0x9f,
+    0x8c, 0xe4, 0x92, 0x61, 0xfc, 0x03, 0xa7, 0x5b, 0x6f, 0x09, 0x61, 0x65, 0x26, 0xf6, 0x25, 0xa4,
+    0x18, 0x59, 0xdc, 0x20, 0x78, 0x12, 0x7a, 0xfb, 0x88, 0xff, 0x46, 0x1e, 0x6c, 0x18, 0x3d, 0x0a,
+    0xae, 0x49, 0xb6, 0x6c, 0x53, 0x39, 0x77, 0x09, 0xfb, 0x0e, 0x39, 0x88, 0x9e, 0x2d, 0x26, 0x22,
+    0xa0, 0xd0, 0xe1, 0xd2, 0x9d, 0xa6, 0xe5, 0x32, 0x6b, 0xcc, 0xe1
+};
+static const unsigned int ecdsa_pub_key_len = 91;
+
+static const unsigned char bench_ecdsa_priv_key[] = {
+    0x3f, 0x22, 0xe2, 0xb2, 0x80, 0xd6, 0x9d, 0x85, 0x3c, 0x63, 0xb3, 0x54, 0x4e, 0x0e, 0x8f, 0x16,
+    0xb0, 0x52, 0x2c, 0xaa, 0x16, 0x35, 0x74, 0xb3, 0x54, 0x15, 0xcd, 0x85, 0x9c, 0x29, 0x68, 0xdd
+};
+
+
+#endif /* BENCH_ECDSA_COMB_KEY_H */
+
+
+/* [] END OF FILE */
@@ -0,0 +1,663 @@
+/******************************************************************************
+* File Name: bench_mqtt_rx.c
+*
+* Description: This file contains a host microbenchmark of the receive path of
+* MQTT packets. It builds a stream of packets shaped as the ones an OTA device
+* receives (stream blocks of about 1 KB, job documents of about 2 KB, PUBACK
+* and PINGRESP), then reads it from a network stand-in that delivers it in
+* segments, as TCP segments or TLS records, with three receive paths:
+*   - rx128: every byte goes through a 128-byte receive buffer and is copied
+*     from it to the buffer of the packet
+*   - iotmqtt: as the MQTT library does, one read per byte of the fixed
+*     header, then one read of the rest into the buffer of the packet
+*   - chained: the packets are framed over the network buffers and handed as
+*     views, with no copy but of the headers that straddle two buffers
+* For each segment size it prints the time and cycles per received byte, the
+* network reads per packet and the bytes copied per byte of each path as
+* key=value lines, and checks that every path returns the same packets.
+*
+* Related Document: See README.md
+*
+*******************************************************************************
+* (c) 2020, Cypress Semiconductor Corporation. All rights reserved.
+*******************************************************************************
+* This software, including source code, documentation and related materials
+* ("Software"), is owned by Cypress Semiconductor Corporation or one of its
+* subsidiaries ("Cypress") and is protected by and subject to worldwide patent
+* protection (United States and foreign), United States copyright laws and
+* international treaty provisions. Therefore, you may use this Software only
+* as provided in the license agreement accompanying the software package from
+* which you obtained this Software ("EULA").
+*
+* If no EULA applies, Cypress hereby grants you a personal, non-exclusive,
+* non-transferable license to copy, modify, and compile the Software source
+* code solely for use in connection with Cypress's integrated circuit products.
+* Any reproduction, modification, translation, compilation, or representation
+* of this Software except as specified above is prohibited without the express
+* written permission of Cypress.
+*
+* Disclaimer: THIS SOFTWARE IS PROVIDED AS-IS, WITH NO WARRANTY OF ANY KIND,
+* EXPRESS OR IMPLIED, INCLUDING, BUT NOT LIMITED TO, NONINFRINGEMENT, IMPLIED
+* WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE. Cypress
+* reserves the right to make changes to the Software without notice. Cypress
+* does not assume any liability arising out of the application or use of the
+* Software or any product or circuit described in the Software. Cypress does
+* not authorize its products for use in any products where a malfunction or
+* failure of the Cypress product may reasonably be expected to result in
+* significant property damage, injury or death ("High Risk Product"). By
+* including Cypress's product in a High Risk Product, the manufacturer of such
+* system or application assumes all risk of such use and in doing so agrees to
+* indemnify Cypress against all liability.
+*******************************************************************************/
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <time.h>
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+#include "ota_mqtt_frame.h"
+
+
+/*******************************************************************************
+ * Macros
+ ******************************************************************************/
+#define BENCH_DEFAULT_ITERATIONS        (100000UL)
+
+/* Packets of the stream, read again until the iterations are done */
+#define BENCH_STREAM_PACKETS            (1024U)
+
+/* Mix of the stream, in percent */
+#define BENCH_BLOCK_PCT                 (80U)
+#define BENCH_JOB_PCT                   (5U)
+#define BENCH_PUBACK_PCT                (10U)
+
+#define BENCH_BLOCK_TOPIC               "$aws/things/ota-device/streams/AFR_OTA-5f2b1c4e/data/cbor"
+#define BENCH_JOB_TOPIC                 "$aws/things/ota-device/jobs/$next/get/accepted"
+#define BENCH_BLOCK_PAYLOAD             (1024U + 24U)
+#define BENCH_JOB_PAYLOAD               (2048U)
+#define BENCH_PACKET_MAX                (4U + 2U + 128U + BENCH_JOB_PAYLOAD)
+
+/* Receive buffer of the rx128 path */
+#define BENCH_RX_BUFFER_SIZE            (128U)
+
+/* Network buffers of the chained path, spaced so that they never follow each
+ * other in memory
+ */
+#define BENCH_NET_BUFFERS               (OTA_MQTT_FRAME_MAX_VIEWS)
+#define BENCH_NET_BUFFER_SIZE           (2048U)
+#define BENCH_NET_BUFFER_GAP            (64U)
+
+#define MQTT_PUBLISH                    (0x30U)
+#define MQTT_PUBACK                     (0x40U)
+#define MQTT_PINGRESP                   (0xD0U)
+
+#define FNV_OFFSET                      (2166136261UL)
+#define FNV_PRIME                       (16777619UL)
+
+#define NS_PER_S                        (1000000000ULL)
+
+#define EXIT_USAGE                      (2)
+
+
+/*******************************************************************************
+ * Data structure and enumeration
+ ******************************************************************************/
+/* Network stand-in: the stream, delivered in segments */
+typedef struct
+{
+    const uint8_t *data;
+    size_t size;
+    size_t off;
+    size_t segment;
+    unsigned long reads;
+} bench_net_t;
+
+typedef struct
+{
+    const char *name;
+    unsigned long (*run)(bench_net_t *net, unsigned long packets, uint32_t *sum);
+} bench_path_t;
+
+
+/*******************************************************************************
+ * Function prototypes
+ ******************************************************************************/
+static unsigned long run_rx128(bench_net_t *net, unsigned long packets, uint32_t *sum);
+static unsigned long run_iotmqtt(bench_net_t *net, unsigned long packets, uint32_t *sum);
+static unsigned long run_chained(bench_net_t *net, unsigned long packets, uint32_t *sum);
+
+
+/*******************************************************************************
+ * Global variables
+ ******************************************************************************/
+static uint8_t *stream;
+static size_t stream_size;
+static uint32_t stream_sum;
+
+static const size_t segments[] = { 1460U, 16384U };
+
+static const bench_path_t paths[] =
+{
+    { "rx128", run_rx128 },
+    { "iotmqtt", run_iotmqtt },
+    { "chained", run_chained },
+};
+
+static uint8_t net_buffers[BENCH_NET_BUFFERS][BENCH_NET_BUFFER_SIZE + BENCH_NET_BUFFER_GAP];
+
+/* Set on the verification pass: the paths fold every packet in the checksum.
+ * On the timed passes they only touch the first byte of each packet.
+ */
+static bool verify;
+
+
+/*******************************************************************************
+ * Function definitions
+ ******************************************************************************/
+
+/*******************************************************************************
+ * Function Name: now_ns
+ ******************************************************************************/
+static uint64_t now_ns(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    return ((uint64_t)ts.tv_sec * NS_PER_S) + (uint64_t)ts.tv_nsec;
+}
+
+
+/*******************************************************************************
+ * Function Name: now_cycles
+ *******************************************************************************
+ * Summary:
+ *  Time stamp counter of the CPU, 0 where there is none.
+ *
+ ******************************************************************************/
+static uint64_t now_cycles(void)
+{
+#if defined(__x86_64__) || defined(__i386__)
+    return __rdtsc();
+#else
+    return 0U;
+#endif
+}
+
+
+/*******************************************************************************
+ * Function Name: fnv
+ ******************************************************************************/
+static uint32_t fnv(uint32_t h, const uint8_t *data, size_t len)
+{
+    for (size_t i = 0U; i < len; i++)
+    {
+        h = (h ^ data[i]) * FNV_PRIME;
+    }
+
+    return h;
+}
+
+
+/*******************************************************************************
+ * Function Name: consume
+ *******************************************************************************
+ * Summary:
+ *  Consumer of a packet, or of a part of it.
+ *
+ ******************************************************************************/
+static uint32_t consume(uint32_t sum, const uint8_t *data, size_t len)
+{
+    if (verify)
+    {
+        return fnv(sum, data, len);
+    }
+
+    return (len > 0U) ? (sum + data[0] + (uint32_t)len) : sum;
+}
+
+
+/*******************************************************************************
+ * Function Name: net_read
+ *******************************************************************************
+ * Summary:
+ *  Exact read of the network stand-in, over segments. The stream is read
+ *  again from its start at its end.
+ *
+ ******************************************************************************/
+static size_t net_read(void *conn, uint8_t *buffer, size_t len)
+{
+    bench_net_t *net = (bench_net_t *)conn;
+    size_t done = 0U;
+
+    net->reads++;
+    while (done < len)
+    {
+        size_t n = net->size - net->off;
+
+        if (n > (len - done))
+        {
+            n = len - done;
+        }
+        memcpy(&buffer[done], &net->data[net->off], n);
+        done += n;
+        net->off += n;
+        if (net->off == net->size)
+        {
+            net->off = 0U;
+        }
+    }
+
+    return done;
+}
+
+
+/*******************************************************************************
+ * Function Name: net_read_upto
+ *******************************************************************************
+ * Summary:
+ *  Read of the bytes left in the current segment of the network stand-in.
+ *
+ ******************************************************************************/
+static size_t net_read_upto(void *conn, uint8_t *buffer, size_t len)
+{
+    bench_net_t *net = (bench_net_t *)conn;
+    size_t n = net->segment - (net->off % net->segment);
+
+    if (n > (net->size - net->off))
+    {
+        n = net->size - net->off;
+    }
+    if (n > len)
+    {
+        n = len;
+    }
+
+    net->reads++;
+    memcpy(buffer, &net->data[net->off], n);
+    net->off += n;
+    if (net->off == net->size)
+    {
+        net->off = 0U;
+    }
+
+    return n;
+}
+
+
+/*******************************************************************************
+ * Function Name: decode_header
+ *******************************************************************************
+ * Summary:
+ *  Decodes a fixed header from contiguous bytes.
+ *
+ * Return:
+ *  size_t - length of the header, 0 if more bytes are needed
+ *
+ ******************************************************************************/
+static size_t decode_header(const uint8_t *hdr, size_t len, uint32_t *remaining)
+{
+    uint32_t value = 0U;
+
+    for (size_t i = 1U; (i < len) && (i < OTA_MQTT_FRAME_HEADER_MAX); i++)
+    {
+        value |= (uint32_t)(hdr[i] & 0x7FU) << (7U * (i - 1U));
+        if (0U == (hdr[i] & 0x80U))
+        {
+            *remaining = value;
+            return i + 1U;
+        }
+    }
+
+    return 0U;
+}
+
+
+/*******************************************************************************
+ * Function Name: run_rx128
+ *******************************************************************************
+ * Summary:
+ *  Reads packets through a 128-byte receive buffer. The bytes read past the
+ *  end of a packet are kept for the next one.
+ *
+ * Return:
+ *  unsigned long - bytes copied from the receive buffer
+ *
+ ******************************************************************************/
+static unsigned long run_rx128(bench_net_t *net, unsigned long packets, uint32_t *sum)
+{
+    static uint8_t rx[BENCH_RX_BUFFER_SIZE];
+    size_t held = 0U;
+    unsigned long copied = 0UL;
+
+    for (unsigned long p = 0UL; p < packets; p++)
+    {
+        size_t header_len;
+        uint32_t remaining = 0U;
+        uint32_t done;
+        uint8_t *packet;
+
+        while (0U == (header_len = decode_header(rx, held, &remaining)))
+        {
+            held += net_read_upto(net, &rx[held], sizeof(rx) - held);
+        }
+
+        packet = malloc(remaining + 1U);
+        done = (uint32_t)(held - header_len);
+        if (done > remaining)
+        {
+            done = remaining;
+        }
+        memcpy(packet, &rx[header_len], done);
+        held -= header_len + done;
+        memmove(rx, &rx[header_len + done], held);
+
+        while (done < remaining)
+        {
+            size_t want = remaining - done;
+            size_t n = net_read_upto(net, rx, (want < sizeof(rx)) ? want : sizeof(rx));
+
+            memcpy(&packet[done], rx, n);
+            done += (uint32_t)n;
+        }
+        copied += remaining;
+
+        *sum = consume(*sum, packet, remaining);
+        free(packet);
+    }
+
+    return copied;
+}
+
+
+/*******************************************************************************
+ * Function Name: run_iotmqtt
+ *******************************************************************************
+ * Summary:
+ *  Reads packets as the MQTT library does.
+ *
+ ******************************************************************************/
+static unsigned long run_iotmqtt(bench_net_t *net, unsigned long packets, uint32_t *sum)
+{
+    for (unsigned long p = 0UL; p < packets; p++)
+    {
+        uint8_t hdr[OTA_MQTT_FRAME_HEADER_MAX];
+        size_t len = 1U;
+        uint32_t remaining = 0U;
+        uint8_t *packet;
+
+        (void)net_read(net, &hdr[0], 1U);
+        do
+        {
+            (void)net_read(net, &hdr[len], 1U);
+            len++;
+        } while ((0U == decode_header(hdr, len, &remaining)) && (len < sizeof(hdr)));
+
+        packet = malloc(remaining + 1U);
+        if (remaining > 0U)
+        {
+            (void)net_read(net, packet, remaining);
+        }
+
+        *sum = consume(*sum, packet, remaining);
+        free(packet);
+    }
+
+    return 0UL;
+}
+
+
+/*******************************************************************************
+ * Function Name: run_chained
+ *******************************************************************************
+ * Summary:
+ *  Frames packets over the network buffers and hands their views to the
+ *  consumer. The buffers are filled in turn: those in the chain are the last
+ *  ones filled, and fewer than all of them.
+ *
+ * Return:
+ *  unsigned long - bytes of the headers gathered across two buffers
+ *
+ ******************************************************************************/
+static unsigned long run_chained(bench_net_t *net, unsigned long packets, uint32_t *sum)
+{
+    ota_mqtt_chain_t chain;
+    ota_mqtt_packet_t packet;
+    uint32_t next = 0U;
+    unsigned long copied = 0UL;
+
+    ota_mqtt_chain_init(&chain);
+    for (unsigned long p = 0UL; p < packets; p++)
+    {
+        ota_mqtt_frame_result_t result;
+
+        while (OTA_MQTT_FRAME_MORE == (result = ota_mqtt_frame_next(&chain, &packet)))
+        {
+            uint8_t *buffer = net_buffers[next];
+            size_t n = net_read_upto(net, buffer, BENCH_NET_BUFFER_SIZE);
+
+            (void)ota_mqtt_chain_append(&chain, buffer, (uint32_t)n);
+            next = (next + 1U) % BENCH_NET_BUFFERS;
+        }
+        if (OTA_MQTT_FRAME_PACKET != result)
+        {
+            break;
+        }
+
+        if (packet.header_copied)
+        {
+            copied += packet.header_len;
+        }
+        for (uint32_t v = 0U; v < packet.view_count; v++)
+        {
+            *sum = consume(*sum, packet.views[v].data, packet.views[v].len);
+        }
+    }
+
+    return copied;
+}
+
+
+/*******************************************************************************
+ * Function Name: put_publish
+ *******************************************************************************
+ * Summary:
+ *  Writes a QoS 0 PUBLISH with a pseudo-random payload.
+ *
+ * Return:
+ *  size_t - bytes written
+ *
+ ******************************************************************************/
+static size_t put_publish(uint8_t *out, const char *topic, size_t payload, uint32_t *seed)
+{
+    size_t topic_len = strlen(topic);
+    uint32_t remaining = (uint32_t)(2U + topic_len + payload);
+    size_t n = 0U;
+
+    out[n++] = MQTT_PUBLISH;
+    do
+    {
+        out[n] = (uint8_t)(remaining & 0x7FU);
+        remaining >>= 7;
+        out[n++] |= (remaining > 0U) ? 0x80U : 0U;
+    } while (remaining > 0U);
+    out[n++] = (uint8_t)(topic_len >> 8);
+    out[n++] = (uint8_t)topic_len;
+    memcpy(&out[n], topic, topic_len);
+    n += topic_len;
+    for (size_t i = 0U; i < payload; i++)
+    {
+        *seed = (*seed * 1103515245UL) + 12345UL;
+        out[n++] = (uint8_t)(*seed >> 16);
+    }
+
+    return n;
+}
+
+
+/*******************************************************************************
+ * Function Name: build_stream
+ *******************************************************************************
+ * Summary:
+ *  Builds the stream of packets and the checksum of their remaining bytes.
+ *
+ ******************************************************************************/
+static void build_stream(void)
+{
+    uint32_t seed = 7U;
+
+    stream = malloc((size_t)BENCH_STREAM_PACKETS * BENCH_PACKET_MAX);
+    stream_size = 0U;
+    stream_sum = FNV_OFFSET;
+    for (uint32_t p = 0U; p < BENCH_STREAM_PACKETS; p++)
+    {
+        uint8_t *out = &stream[stream_size];
+        uint32_t pick = (p * 37U) % 100U;
+        size_t n;
+        size_t header_len;
+        uint32_t remaining = 0U;
+
+        if (pick < BENCH_BLOCK_PCT)
+        {
+            n = put_publish(out, BENCH_BLOCK_TOPIC, BENCH_BLOCK_PAYLOAD, &seed);
+        }
+        else if (pick < (BENCH_BLOCK_PCT + BENCH_JOB_PCT))
+        {
+            n = put_publish(out, BENCH_JOB_TOPIC, BENCH_JOB_PAYLOAD, &seed);
+        }
+        else if (pick < (BENCH_BLOCK_PCT + BENCH_JOB_PCT + BENCH_PUBACK_PCT))
+        {
+            out[0] = MQTT_PUBACK;
+            out[1] = 2U;
+            out[2] = (uint8_t)(p >> 8);
+            out[3] = (uint8_t)p;
+            n = 4U;
+        }
+        else
+        {
+            out[0] = MQTT_PINGRESP;
+            out[1] = 0U;
+            n = 2U;
+        }
+
+        header_len = decode_header(out, n, &remaining);
+        stream_sum = fnv(stream_sum, &out[header_len], remaining);
+        stream_size += n;
+    }
+}
+
+
+/*******************************************************************************
+ * Function Name: bench_segment
+ *******************************************************************************
+ * Summary:
+ *  Runs every path over the stream delivered in segments of the size given:
+ *  once to check the packets returned, then timed.
+ *
+ * Return:
+ *  bool - every path returned the packets of the stream
+ *
+ ******************************************************************************/
+static bool bench_segment(size_t segment, unsigned long iterations)
+{
+    unsigned long passes = (iterations + BENCH_STREAM_PACKETS - 1UL) / BENCH_STREAM_PACKETS;
+    unsigned long packets = passes * BENCH_STREAM_PACKETS;
+    double bytes = (double)stream_size * (double)passes;
+    bool pass = true;
+
+    printf("segment_bytes=%lu\n", (unsigned long)segment);
+    for (size_t i = 0U; i < (sizeof(paths) / sizeof(paths[0])); i++)
+    {
+        const bench_path_t *path = &paths[i];
+        bench_net_t net = { stream, stream_size, 0U, segment, 0UL };
+        uint32_t sum = FNV_OFFSET;
+        unsigned long copied;
+        uint64_t start_ns;
+        uint64_t start_cycles;
+        uint64_t ns;
+        uint64_t cycles;
+
+        verify = true;
+        (void)path->run(&net, BENCH_STREAM_PACKETS, &sum);
+        if ((sum != stream_sum) || (0U != net.off))
+        {
+            printf("%s_check=fail\n", path->name);
+            pass = false;
+        }
+
+        verify = false;
+        net.off = 0U;
+        net.reads = 0UL;
+        sum = 0U;
+        start_ns = now_ns();
+        start_cycles = now_cycles();
+        copied = path->run(&net, packets, &sum);
+        cycles = now_cycles() - start_cycles;
+        ns = now_ns() - start_ns;
+
+        printf("%s_ns_per_byte=%.3f\n", path->name, (double)ns / bytes);
+        if (0U != cycles)
+        {
+            printf("%s_cycles_per_byte=%.3f\n", path->name, (double)cycles / bytes);
+        }
+        printf("%s_reads_per_packet=%.2f\n", path->name, (double)net.reads / (double)packets);
+        printf("%s_copied_per_byte=%.4f\n", path->name, (double)copied / bytes);
+        if (0U == sum)
+        {
+            printf("%s_sum=0\n", path->name);
+        }
+    }
+
+    return pass;
+}
+
+
+/*******************************************************************************
+ * Function Name: main
+ *******************************************************************************
+ * Summary:
+ *  Runs the benchmark for TCP segments and TLS records. The only argument is
+ *  the number of packets received per segment size and path.
+ *
+ ******************************************************************************/
+int main(int argc, char *argv[])
+{
+    unsigned long iterations = BENCH_DEFAULT_ITERATIONS;
+
+    if (argc > 2)
+    {
+        fprintf(stderr, "usage: %s [iterations]\n", argv[0]);
+        return EXIT_USAGE;
+    }
+    if (argc == 2)
+    {
+        iterations = strtoul(argv[1], NULL, 0);
+        if (0U == iterations)
+        {
+            fprintf(stderr, "usage: %s [iterations]\n", argv[0]);
+            return EXIT_USAGE;
+        }
+    }
+
+    build_stream();
+    printf("iterations=%lu\n", iterations);
+    printf("stream_packets=%u\n", BENCH_STREAM_PACKETS);
+    printf("stream_bytes=%lu\n", (unsigned long)stream_size);
+    for (size_t i = 0U; i < (sizeof(segments) / sizeof(segments[0])); i++)
+    {
+        if (!bench_segment(segments[i], iterations))
+        {
+            printf("result=fail\n");
+            return EXIT_FAILURE;
+        }
+    }
+    printf("result=pass\n");
+
+    return EXIT_SUCCESS;
+}
+
+
+/* [] END OF FILE */
@@ -0,0 +1,573 @@
+/******************************************************************************
+* File Name: ota_json_extract.c
+*
+* Description: This file implements a single-pass extractor of the fields of a
+* JSON document, for job documents and the other JSON messages of the OTA app.
+* The caller declares the fields it needs by their path from the root; the
+* document is scanned once, and each field is filled in when the scan reaches
+* its value. Strings are returned as pointers into the document. There is no
+* token array to size and nothing is allocated: for each nesting level, the
+* extractor keeps the set of fields whose path the scan is still on, so every
+* key is compared once with the fields it can lead to, and a value ends a
+* field when the path of the field ends with the key of the value.
+*
+* The whole document is checked for its structure; numbers are only checked
+* for the characters they use, and strings for their closing quote: escapes
+* are not decoded.
+*
+* It is used by the broker stand-in of the host simulation and by
+* bench_json_extract.c; the firmware keeps the job parser of the OTA Agent.
+*
+* Related Document: See README.md
+*
+*******************************************************************************
+* (c) 2020, Cypress Semiconductor Corporation. All rights reserved.
+*******************************************************************************
+* This software, including source code, documentation and related materials
+* ("Software"), is owned by Cypress Semiconductor Corporation or one of its
+* subsidiaries ("Cypress") and is protected by and subject to worldwide patent
+* protection (United States and foreign), United States copyright laws and
+* international treaty provisions. Therefore, you may use this Software only
+* as provided in the license agreement accompanying the software package from
+* which you obtained this Software ("EULA").
+*
+* If no EULA applies, Cypress hereby grants you a personal, non-exclusive,
+* non-transferable license to copy, modify, and compile the Software source
+* code solely for use in connection with Cypress's integrated circuit products.
+* Any reproduction, modification, translation, compilation, or representation
+* of this Software except as specified above is prohibited without the express
+* written permission of Cypress.
+*
+* Disclaimer: THIS SOFTWARE IS PROVIDED AS-IS, WITH NO WARRANTY OF ANY KIND,
+* EXPRESS OR IMPLIED, INCLUDING, BUT NOT LIMITED TO, NONINFRINGEMENT, IMPLIED
+* WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE. Cypress
+* reserves the right to make changes to the Software without notice. Cypress
+* does not assume any liability arising out of the application or use of the
+* Software or any product or circuit described in the Software. Cypress does
+* not authorize its products for use in any products where a malfunction or
+* failure of the Cypress product may reasonably be expected to result in
+* significant property damage, injury or death ("High Risk Product"). By
+* including Cypress's product in a High Risk Product, the manufacturer of such
+* system or application assumes all risk of such use and in doing so agrees to
+* indemnify Cypress against all liability.
+*******************************************************************************/
+#include <string.h>
+#include "ota_json_extract.h"
+
+
+/*******************************************************************************
+ * Macros
+ ******************************************************************************/
+#define JSON_LITERAL_TRUE               "true"
+#define JSON_LITERAL_FALSE              "false"
+#define JSON_LITERAL_NULL               "null"
+
+#define DECIMAL_BASE                    (10U)
+
+/* "[4294967295]" */
+#define INDEX_TEXT_SIZE                 (12U)
+
+
+/*******************************************************************************
+ * Data structure and enumeration
+ ******************************************************************************/
+typedef struct
+{
+    const char *pos;
+    const char *end;
+    ota_json_field_t *fields;
+    size_t count;
+    int found;
+    uint32_t pending;                       /* Fields not found yet */
+    uint32_t depth;
+    /* Fields whose path starts with the keys from the root to each level */
+    uint32_t on_path[OTA_JSON_DEPTH_MAX + 1U];
+    /* Offset in the path of each field on the path, past the current key */
+    uint16_t offset[OTA_JSON_FIELDS_MAX];
+} extract_t;
+
+
+/*******************************************************************************
+ * Function prototypes
+ ******************************************************************************/
+static bool parse_value(extract_t *x);
+
+
+/*******************************************************************************
+ * Function Name: skip_ws
+ ******************************************************************************/
+static void skip_ws(extract_t *x)
+{
+    while ((x->pos < x->end) &&
+           ((' ' == *x->pos) || ('\t' == *x->pos) || ('\n' == *x->pos) || ('\r' == *x->pos)))
+    {
+        x->pos++;
+    }
+}
+
+
+/*******************************************************************************
+ * Function Name: enter_key
+ *******************************************************************************
+ * Summary:
+ *  Moves one level down the path, to a member key or an array index, and
+ *  keeps the fields whose path goes on with it.
+ *
+ * Parameters:
+ *  x - extractor
+ *  key, len - text of the key in the path: the member name, or the index with
+ *             its brackets
+ *  is_index - true for an array index
+ *
+ * Return:
+ *  size_t - length of the key in the paths kept, for leave_key()
+ *
+ ******************************************************************************/
+static size_t enter_key(extract_t *x, const char *key, size_t len, bool is_index)
+{
+    uint32_t candidates = x->on_path[x->depth] & x->pending;
+    uint32_t kept = 0U;
+    size_t skip = ((x->depth > 0U) && !is_index) ? 1U : 0U;
+
+    for (uint32_t f = 0U; 0U != candidates; f++, candidates >>= 1)
+    {
+        const char *p;
+
+        if (0U == (candidates & 1U))
+        {
+            continue;
+        }
+
+        /* The first character rules out most keys */
+        p = x->fields[f].path + x->offset[f];
+        if (((0U != skip) && ('.' != *p)) || (p[skip] != key[0]) ||
+            (0 != strncmp(p + skip, key, len)))
+        {
+            continue;
+        }
+        p += skip + len;
+        if (('\0' == *p) || ('.' == *p) || ('[' == *p))
+        {
+            x->offset[f] += (uint16_t)(skip + len);
+            kept |= 1UL << f;
+        }
+    }
+
+    x->depth++;
+    x->on_path[x->depth] = kept;
+
+    return skip + len;
+}
+
+
+/*******************************************************************************
+ * Function Name: leave_key
+ *******************************************************************************
+ * Summary:
+ *  Moves one level up the path, back to the key of enter_key().
+ *
+ ******************************************************************************/
+static void leave_key(extract_t *x, size_t len)
+{
+    uint32_t kept = x->on_path[x->depth];
+
+    for (uint32_t f = 0U; 0U != kept; f++, kept >>= 1)
+    {
+        if (0U != (kept & 1U))
+        {
+            x->offset[f] -= (uint16_t)len;
+        }
+    }
+    x->depth--;
+}
+
+
+/*******************************************************************************
+ * Function Name: store_field
+ *******************************************************************************
+ * Summary:
+ *  Fills a field in with the value scanned. A value of another type leaves
+ *  the field not found.
+ *
+ * Parameters:
+ *  x - extractor
+ *  f - index of the field of the value
+ *  start, end - text of the value
+ *
+ ******************************************************************************/
+static void store_field(extract_t *x, uint32_t f, const char *start, const char *end)
+{
+    ota_json_field_t *field = &x->fields[f];
+    size_t len = (size_t)(end - start);
+    uint64_t u = 0U;
+
+    switch (field->type)
+    {
+        case OTA_JSON_STRING:
+            if ('"' != *start)
+            {
+                return;
+            }
+            field->value.text.text = start + 1;
+            field->value.text.len = len - 2U;
+            break;
+
+        case OTA_JSON_UINT32:
+            for (const char *p = start; p < end; p++)
+            {
+                if ((*p < '0') || (*p > '9'))
+                {
+                    return;
+                }
+                u = (u * DECIMAL_BASE) + (uint64_t)(*p - '0');
+                if (u > UINT32_MAX)
+                {
+                    return;
+                }
+            }
+            field->value.u32 = (uint32_t)u;
+            break;
+
+        case OTA_JSON_BOOL:
+            if ('t' == *start)
+            {
+                field->value.b = true;
+            }
+            else if ('f' == *start)
+            {
+                field->value.b = false;
+            }
+            else
+            {
+                return;
+            }
+            break;
+
+        default:
+            field->value.text.text = start;
+            field->value.text.len = len;
+            break;
+    }
+
+    field->found = true;
+    x->pending &= ~(1UL << f);
+    x->found++;
+}
+
+
+/*******************************************************************************
+ * Function Name: scan_string
+ *******************************************************************************
+ * Summary:
+ *  Skips a string, from its opening quote to past its closing quote: the
+ *  first quote not escaped by an odd number of backslashes. The search for
+ *  quotes uses memchr(), as fast as the C library gets on long values such as
+ *  signatures and URLs.
+ *
+ ******************************************************************************/
+static bool scan_string(extract_t *x)
+{
+    const char *text = x->pos + 1;
+    const char *p = text;
+
+    for (;;)
+    {
+        const char *quote = memchr(p, '"', (size_t)(x->end - p));
+        size_t backslashes = 0U;
+
+        if (NULL == quote)
+        {
+            return false;
+        }
+
+        while (((quote - backslashes) > text) && ('\\' == quote[-1 - (ptrdiff_t)backslashes]))
+        {
+            backslashes++;
+        }
+
+        p = quote + 1;
+        if (0U == (backslashes & 1U))
+        {
+            x->pos = p;
+            return true;
+        }
+    }
+}
+
+
+/*******************************************************************************
+ * Function Name: scan_literal
+ ******************************************************************************/
+static bool scan_literal(extract_t *x, const char *literal)
+{
+    size_t len = strlen(literal);
+
+    if (((size_t)(x->end - x->pos) < len) || (0 != memcmp(x->pos, literal, len)))
+    {
+        return false;
+    }
+    x->pos += len;
+
+    return true;
+}
+
+
+/*******************************************************************************
+ * Function Name: scan_number
+ ******************************************************************************/
+static bool scan_number(extract_t *x)
+{
+    const char *start = x->pos;
+
+    while ((x->pos < x->end) &&
+           (((*x->pos >= '0') && (*x->pos <= '9')) || ('-' == *x->pos) ||
+            ('+' == *x->pos) || ('.' == *x->pos) || ('e' == *x->pos) || ('E' == *x->pos)))
+    {
+        x->pos++;
+    }
+
+    return (x->pos > start);
+}
+
+
+/*******************************************************************************
+ * Function Name: index_text
+ *******************************************************************************
+ * Summary:
+ *  Writes an array index as it is in a path, "[n]".
+ *
+ * Return:
+ *  size_t - length of the text
+ *
+ ******************************************************************************/
+static size_t index_text(uint32_t index, char *text)
+{
+    char digits[INDEX_TEXT_SIZE];
+    size_t n = 0U;
+    size_t len = 0U;
+
+    do
+    {
+        digits[n++] = (char)('0' + (index % DECIMAL_BASE));
+        index /= DECIMAL_BASE;
+    } while (0U != index);
+
+    text[len++] = '[';
+    while (n > 0U)
+    {
+        text[len++] = digits[--n];
+    }
+    text[len++] = ']';
+
+    return len;
+}
+
+
+/*******************************************************************************
+ * Function Name: parse_members
+ *******************************************************************************
+ * Summary:
+ *  Scans the members of an object or the elements of an array, from past its
+ *  opening bracket to past its closing one, each value one level down the
+ *  path, under its key or index.
+ *
+ * Parameters:
+ *  x - extractor
+ *  is_object - true for an object, false for an array
+ *
+ * Return:
+ *  bool - false if the document is malformed or nested too deep
+ *
+ ******************************************************************************/
+static bool parse_members(extract_t *x, bool is_object)
+{
+    char close = is_object ? '}' : ']';
+    char index[INDEX_TEXT_SIZE];
+    uint32_t n = 0U;
+    size_t key_len;
+
+    skip_ws(x);
+    if ((x->pos < x->end) && (close == *x->pos))
+    {
+        x->pos++;
+        return true;
+    }
+    if (x->depth >= OTA_JSON_DEPTH_MAX)
+    {
+        return false;
+    }
+
+    for (;;)
+    {
+        if (is_object)
+        {
+            const char *key;
+
+            skip_ws(x);
+            if ((x->pos >= x->end) || ('"' != *x->pos))
+            {
+                return false;
+            }
+            key = x->pos + 1;
+            if (!scan_string(x))
+            {
+                return false;
+            }
+            key_len = enter_key(x, key, (size_t)(x->pos - key) - 1U, false);
+
+            skip_ws(x);
+            if ((x->pos >= x->end) || (':' != *x->pos))
+            {
+                return false;
+            }
+            x->pos++;
+        }
+        else
+        {
+            key_len = enter_key(x, index, index_text(n, index), true);
+        }
+
+        if (!parse_value(x))
+        {
+            return false;
+        }
+        leave_key(x, key_len);
+
+        skip_ws(x);
+        if (x->pos >= x->end)
+        {
+            return false;
+        }
+        if (close == *x->pos)
+        {
+            x->pos++;
+            return true;
+        }
+        if (',' != *x->pos)
+        {
+            return false;
+        }
+        x->pos++;
+        n++;
+    }
+}
+
+
+/*******************************************************************************
+ * Function Name: parse_value
+ *******************************************************************************
+ * Summary:
+ *  Scans a value, and fills in the first field not found yet whose path ends
+ *  with the key of the value.
+ *
+ ******************************************************************************/
+static bool parse_value(extract_t *x)
+{
+    uint32_t candidates = x->on_path[x->depth] & x->pending;
+    uint32_t field = OTA_JSON_FIELDS_MAX;
+    const char *start;
+    bool ok;
+
+    skip_ws(x);
+    if (x->pos >= x->end)
+    {
+        return false;
+    }
+
+    for (uint32_t f = 0U; 0U != candidates; f++, candidates >>= 1)
+    {
+        if ((0U != (candidates & 1U)) && ('\0' == x->fields[f].path[x->offset[f]]))
+        {
+            field = f;
+            break;
+        }
+    }
+
+    start = x->pos;
+    switch (*x->pos)
+    {
+        case '{':
+            x->pos++;
+            ok = parse_members(x, true);
+            break;
+        case '[':
+            x->pos++;
+            ok = parse_members(x, false);
+            break;
+        case '"':
+            ok = scan_string(x);
+            break;
+        case 't':
+            ok = scan_literal(x, JSON_LITERAL_TRUE);
+            break;
+        case 'f':
+            ok = scan_literal(x, JSON_LITERAL_FALSE);
+            break;
+        case 'n':
+            ok = scan_literal(x, JSON_LITERAL_NULL);
+            break;
+        default:
+            ok = scan_number(x);
+            break;
+    }
+
+    if (ok && (OTA_JSON_FIELDS_MAX != field))
+    {
+        store_field(x, field, start, x->pos);
+    }
+
+    return ok;
+}
+
+
+/*******************************************************************************
+ * Function Name: ota_json_extract
+ *******************************************************************************
+ * Summary:
+ *  Scans a JSON document once and fills in the fields declared. A field is
+ *  filled in from the first value at its path; a value of another type than
+ *  the field leaves it not found.
+ *
+ * Parameters:
+ *  doc, len - JSON document, not NUL terminated
+ *  fields, count - fields to extract, at most OTA_JSON_FIELDS_MAX
+ *
+ * Return:
+ *  int - number of fields found, -1 if the document is malformed
+ *
+ ******************************************************************************/
+int ota_json_extract(const char *doc, size_t len, ota_json_field_t *fields, size_t count)
+{
+    extract_t x;
+
+    if ((NULL == doc) || ((NULL == fields) && (0U != count)) || (count > OTA_JSON_FIELDS_MAX))
+    {
+        return -1;
+    }
+
+    for (size_t i = 0U; i < count; i++)
+    {
+        fields[i].found = false;
+        x.offset[i] = 0U;
+    }
+
+    x.pos = doc;
+    x.end = doc + len;
+    x.fields = fields;
+    x.count = count;
+    x.found = 0;
+    x.pending = (count < OTA_JSON_FIELDS_MAX) ? ((1UL << count) - 1U) : UINT32_MAX;
+    x.depth = 0U;
+    x.on_path[0] = x.pending;
+
+    if (!parse_value(&x))
+    {
+        return -1;
+    }
+    skip_ws(&x);
+
+    return (x.pos == x.end) ? x.found : -1;
+}
+
+
+/* [] END OF FILE */
@@ -0,0 +1,104 @@
+/******************************************************************************
+* File Name: ota_json_extract.h
+*
+* Description: This file contains the macros, structures and function
+* declaration of the single-pass JSON field extractor.
+*
+* Related Document: See README.md
+*
+*******************************************************************************
+* (c) 2020, Cypress Semiconductor Corporation. All rights reserved.
+*******************************************************************************
+* This software, including source code, documentation and related materials
+* ("Software"), is owned by Cypress Semiconductor Corporation or one of its
+* subsidiaries ("Cypress") and is protected by and subject to worldwide patent
+* protection (United States and foreign), United States copyright laws and
+* international treaty provisions. Therefore, you may use this Software only
+* as provided in the license agreement accompanying the software package from
+* which you obtained this Software ("EULA").
+*
+* If no EULA applies, Cypress hereby grants you a personal, non-exclusive,
+* non-transferable license to copy, modify, and compile the Software source
+* code solely for use in connection with Cypress's integrated circuit products.
+* Any reproduction, modification, translation, compilation, or representation
+* of this Software except as specified above is prohibited without the express
+* written permission of Cypress.
+*
+* Disclaimer: THIS SOFTWARE IS PROVIDED AS-IS, WITH NO WARRANTY OF ANY KIND,
+* EXPRESS OR IMPLIED, INCLUDING, BUT NOT LIMITED TO, NONINFRINGEMENT, IMPLIED
+* WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE. Cypress
+* reserves the right to make changes to the Software without notice. Cypress
+* does not assume any liability arising out of the application or use of the
+* Software or any product or circuit described in the Software. Cypress does
+* not authorize its products for use in any products where a malfunction or
+* failure of the Cypress product may reasonably be expected to result in
+* significant property damage, injury or death ("High Risk Product"). By
+* including Cypress's product in a High Risk Product, the manufacturer of such
+* system or application assumes all risk of such use and in doing so agrees to
+* indemnify Cypress against all liability.
+*******************************************************************************/
+#ifndef OTA_JSON_EXTRACT_H
+#define OTA_JSON_EXTRACT_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+
+/*******************************************************************************
+ * Macros
+ ******************************************************************************/
+/* Deepest nesting of objects and arrays accepted; job documents use 6 */
+#ifndef OTA_JSON_DEPTH_MAX
+#define OTA_JSON_DEPTH_MAX              (10U)
+#endif
+
+/* Most fields extracted in one call */
+#define OTA_JSON_FIELDS_MAX             (32U)
+
+
+/*******************************************************************************
+ * Data structure and enumeration
+ ******************************************************************************/
+typedef enum
+{
+    OTA_JSON_STRING,                /* String, without its quotes */
+    OTA_JSON_UINT32,                /* Unsigned integer that fits 32 bits */
+    OTA_JSON_BOOL,                  /* true or false */
+    OTA_JSON_RAW                    /* Any value, as it is in the document */
+} ota_json_type_t;
+
+/* Text of a value: points into the document, escapes are left as they are */
+typedef struct
+{
+    const char *text;
+    size_t len;
+} ota_json_text_t;
+
+typedef struct
+{
+    /* Keys from the root, separated by dots, with [n] for array elements:
+     * "execution.jobDocument.afr_ota.files[0].filesize"
+     */
+    const char *path;
+    ota_json_type_t type;
+    union
+    {
+        ota_json_text_t text;       /* OTA_JSON_STRING and OTA_JSON_RAW */
+        uint32_t u32;
+        bool b;
+    } value;
+    bool found;                     /* Set by ota_json_extract() */
+} ota_json_field_t;
+
+
+/*******************************************************************************
+ * Function prototypes
+ ******************************************************************************/
+int ota_json_extract(const char *doc, size_t len, ota_json_field_t *fields, size_t count);
+
+
+#endif /* OTA_JSON_EXTRACT_H */
+
+
+/* [] END OF FILE */
@@ -0,0 +1,329 @@
+/******************************************************************************
+* File Name: ota_mqtt_frame.c
+*
+* Description: This file implements the framing of MQTT packets over a chain
+* of network buffers. The fixed header of a packet (packet type, remaining
+* length) is parsed where it lies in the buffer; it is gathered into 5 bytes
+* only when it straddles two buffers. The remaining bytes of a packet are
+* returned as views over the buffers that hold them, without a copy.
+* Nothing is allocated.
+*
+* It is used by the host benchmark of bench_mqtt_rx.c only: the MQTT library
+* of the firmware reads each payload into a buffer it allocates, so there is
+* no consumer of the views on the device.
+*
+* Related Document: See README.md
+*
+*******************************************************************************
+* (c) 2020, Cypress Semiconductor Corporation. All rights reserved.
+*******************************************************************************
+* This software, including source code, documentation and related materials
+* ("Software"), is owned by Cypress Semiconductor Corporation or one of its
+* subsidiaries ("Cypress") and is protected by and subject to worldwide patent
+* protection (United States and foreign), United States copyright laws and
+* international treaty provisions. Therefore, you may use this Software only
+* as provided in the license agreement accompanying the software package from
+* which you obtained this Software ("EULA").
+*
+* If no EULA applies, Cypress hereby grants you a personal, non-exclusive,
+* non-transferable license to copy, modify, and compile the Software source
+* code solely for use in connection with Cypress's integrated circuit products.
+* Any reproduction, modification, translation, compilation, or representation
+* of this Software except as specified above is prohibited without the express
+* written permission of Cypress.
+*
+* Disclaimer: THIS SOFTWARE IS PROVIDED AS-IS, WITH NO WARRANTY OF ANY KIND,
+* EXPRESS OR IMPLIED, INCLUDING, BUT NOT LIMITED TO, NONINFRINGEMENT, IMPLIED
+* WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE. Cypress
+* reserves the right to make changes to the Software without notice. Cypress
+* does not assume any liability arising out of the application or use of the
+* Software or any product or circuit described in the Software. Cypress does
+* not authorize its products for use in any products where a malfunction or
+* failure of the Cypress product may reasonably be expected to result in
+* significant property damage, injury or death ("High Risk Product"). By
+* including Cypress's product in a High Risk Product, the manufacturer of such
+* system or application assumes all risk of such use and in doing so agrees to
+* indemnify Cypress against all liability.
+*******************************************************************************/
+#include <string.h>
+#include "ota_mqtt_frame.h"
+
+/*******************************************************************************
+ * Macros
+ ******************************************************************************/
+/* Remaining length: 7 bits per byte, the top bit set when another follows */
+#define FRAME_LENGTH_BITS               (7U)
+#define FRAME_LENGTH_MASK               (0x7FU)
+#define FRAME_LENGTH_MORE               (0x80U)
+
+
+/*******************************************************************************
+ * Function definitions
+ ******************************************************************************/
+
+/*******************************************************************************
+ * Function Name: frame_decode
+ *******************************************************************************
+ * Summary:
+ *  Decodes a fixed header from contiguous bytes.
+ *
+ * Parameters:
+ *  hdr - first bytes of the packet
+ *  len - number of bytes, up to OTA_MQTT_FRAME_HEADER_MAX
+ *  packet - set to the type, header length and remaining length
+ *
+ * Return:
+ *  ota_mqtt_frame_result_t - OTA_MQTT_FRAME_PACKET once decoded
+ *
+ ******************************************************************************/
+static ota_mqtt_frame_result_t frame_decode(const uint8_t *hdr, uint32_t len,
+                                            ota_mqtt_packet_t *packet)
+{
+    uint32_t remaining = 0U;
+
+    for (uint32_t i = 1U; i < len; i++)
+    {
+        remaining |= (uint32_t)(hdr[i] & FRAME_LENGTH_MASK) << (FRAME_LENGTH_BITS * (i - 1U));
+
+        if (0U == (hdr[i] & FRAME_LENGTH_MORE))
+        {
+            packet->type = hdr[0];
+            packet->header_len = i + 1U;
+            packet->remaining = remaining;
+            return OTA_MQTT_FRAME_PACKET;
+        }
+    }
+
+    return (OTA_MQTT_FRAME_HEADER_MAX == len) ? OTA_MQTT_FRAME_ERROR : OTA_MQTT_FRAME_MORE;
+}
+
+
+/*******************************************************************************
+ * Function Name: ota_mqtt_chain_init
+ *******************************************************************************
+ * Summary:
+ *  Empties a chain.
+ *
+ * Parameters:
+ *  chain - chain of network buffers
+ *
+ ******************************************************************************/
+void ota_mqtt_chain_init(ota_mqtt_chain_t *chain)
+{
+    memset(chain, 0, sizeof(*chain));
+}
+
+
+/*******************************************************************************
+ * Function Name: ota_mqtt_chain_append
+ *******************************************************************************
+ * Summary:
+ *  Appends received bytes to a chain. Bytes that follow the last buffer in
+ *  memory extend it.
+ *
+ * Parameters:
+ *  chain - chain of network buffers
+ *  data - bytes received
+ *  len - number of bytes
+ *
+ * Return:
+ *  bool - false if the chain holds OTA_MQTT_FRAME_MAX_VIEWS buffers already
+ *
+ ******************************************************************************/
+bool ota_mqtt_chain_append(ota_mqtt_chain_t *chain, const uint8_t *data, uint32_t len)
+{
+    ota_mqtt_view_t *last = (chain->count > 0U) ? &chain->bufs[chain->count - 1U] : NULL;
+
+    if (0U == len)
+    {
+        return true;
+    }
+
+    if ((NULL != last) && ((last->data + last->len) == data))
+    {
+        last->len += len;
+    }
+    else if (chain->count < OTA_MQTT_FRAME_MAX_VIEWS)
+    {
+        chain->bufs[chain->count].data = data;
+        chain->bufs[chain->count].len = len;
+        chain->count++;
+    }
+    else
+    {
+        return false;
+    }
+
+    chain->bytes += len;
+
+    return true;
+}
+
+
+/*******************************************************************************
+ * Function Name: ota_mqtt_chain_copy
+ *******************************************************************************
+ * Summary:
+ *  Copies the first bytes of a chain, without consuming them.
+ *
+ * Parameters:
+ *  chain - chain of network buffers
+ *  dst - destination
+ *  len - number of bytes wanted
+ *
+ * Return:
+ *  uint32_t - number of bytes copied, up to the bytes of the chain
+ *
+ ******************************************************************************/
+uint32_t ota_mqtt_chain_copy(const ota_mqtt_chain_t *chain, uint8_t *dst, uint32_t len)
+{
+    uint32_t copied = 0U;
+
+    for (uint32_t i = 0U; (i < chain->count) && (copied < len); i++)
+    {
+        uint32_t part = ((len - copied) < chain->bufs[i].len) ? (len - copied) : chain->bufs[i].len;
+
+        memcpy(&dst[copied], chain->bufs[i].data, part);
+        copied += part;
+    }
+
+    return copied;
+}
+
+
+/*******************************************************************************
+ * Function Name: ota_mqtt_chain_consume
+ *******************************************************************************
+ * Summary:
+ *  Drops the first bytes of a chain, and the buffers left empty.
+ *
+ * Parameters:
+ *  chain - chain of network buffers
+ *  len - number of bytes, up to the bytes of the chain
+ *
+ ******************************************************************************/
+void ota_mqtt_chain_consume(ota_mqtt_chain_t *chain, uint32_t len)
+{
+    uint32_t dropped = 0U;
+
+    len = (len < chain->bytes) ? len : chain->bytes;
+    chain->bytes -= len;
+
+    while ((len > 0U) && (len >= chain->bufs[dropped].len))
+    {
+        len -= chain->bufs[dropped].len;
+        dropped++;
+    }
+
+    if (dropped > 0U)
+    {
+        chain->count -= dropped;
+        memmove(&chain->bufs[0], &chain->bufs[dropped], chain->count * sizeof(chain->bufs[0]));
+    }
+
+    if (len > 0U)
+    {
+        chain->bufs[0].data += len;
+        chain->bufs[0].len -= len;
+    }
+}
+
+
+/*******************************************************************************
+ * Function Name: ota_mqtt_frame_header
+ *******************************************************************************
+ * Summary:
+ *  Parses the fixed header of the first packet of a chain, in place when it
+ *  lies in the first buffer. Consumes nothing.
+ *
+ * Parameters:
+ *  chain - chain of network buffers
+ *  packet - set to the type, header length and remaining length; the views
+ *           are not set
+ *
+ * Return:
+ *  ota_mqtt_frame_result_t - OTA_MQTT_FRAME_PACKET once the header is
+ *                            parsed, OTA_MQTT_FRAME_MORE while it is
+ *                            incomplete, OTA_MQTT_FRAME_ERROR if invalid
+ *
+ ******************************************************************************/
+ota_mqtt_frame_result_t ota_mqtt_frame_header(ota_mqtt_chain_t *chain, ota_mqtt_packet_t *packet)
+{
+    ota_mqtt_frame_result_t result;
+    uint8_t gathered[OTA_MQTT_FRAME_HEADER_MAX];
+    uint32_t len;
+
+    if (0U == chain->count)
+    {
+        return OTA_MQTT_FRAME_MORE;
+    }
+
+    len = (chain->bufs[0].len < OTA_MQTT_FRAME_HEADER_MAX) ? chain->bufs[0].len : OTA_MQTT_FRAME_HEADER_MAX;
+    result = frame_decode(chain->bufs[0].data, len, packet);
+    packet->header_copied = false;
+
+    if ((OTA_MQTT_FRAME_MORE == result) && (chain->bytes > chain->bufs[0].len))
+    {
+        len = ota_mqtt_chain_copy(chain, gathered, OTA_MQTT_FRAME_HEADER_MAX);
+        result = frame_decode(gathered, len, packet);
+        packet->header_copied = true;
+    }
+
+    return result;
+}
+
+
+/*******************************************************************************
+ * Function Name: ota_mqtt_frame_next
+ *******************************************************************************
+ * Summary:
+ *  Takes the first packet of a chain once all of its bytes are in it. The
+ *  remaining bytes are returned as views over the buffers.
+ *
+ * Parameters:
+ *  chain - chain of network buffers
+ *  packet - set to the packet
+ *
+ * Return:
+ *  ota_mqtt_frame_result_t - OTA_MQTT_FRAME_PACKET if a packet was taken,
+ *                            OTA_MQTT_FRAME_MORE while it is incomplete,
+ *                            OTA_MQTT_FRAME_ERROR if its header is invalid
+ *
+ ******************************************************************************/
+ota_mqtt_frame_result_t ota_mqtt_frame_next(ota_mqtt_chain_t *chain, ota_mqtt_packet_t *packet)
+{
+    ota_mqtt_frame_result_t result = ota_mqtt_frame_header(chain, packet);
+    uint32_t left;
+
+    if (OTA_MQTT_FRAME_PACKET != result)
+    {
+        return result;
+    }
+
+    if ((chain->bytes - packet->header_len) < packet->remaining)
+    {
+        return OTA_MQTT_FRAME_MORE;
+    }
+
+    ota_mqtt_chain_consume(chain, packet->header_len);
+
+    packet->view_count = 0U;
+    left = packet->remaining;
+
+    for (uint32_t i = 0U; left > 0U; i++)
+    {
+        uint32_t len = (chain->bufs[i].len < left) ? chain->bufs[i].len : left;
+
+        packet->views[i].data = chain->bufs[i].data;
+        packet->views[i].len = len;
+        packet->view_count++;
+        left -= len;
+    }
+
+    ota_mqtt_chain_consume(chain, packet->remaining);
+
+    return OTA_MQTT_FRAME_PACKET;
+}
+
+
+/* [] END OF FILE */
@@ -0,0 +1,111 @@
+/******************************************************************************
+* File Name: ota_mqtt_frame.h
+*
+* Description: This file contains the structures and function declarations of
+* the framing of MQTT packets over a chain of network buffers.
+*
+* Related Document: See README.md
+*
+*******************************************************************************
+* (c) 2020, Cypress Semiconductor Corporation. All rights reserved.
+*******************************************************************************
+* This software, including source code, documentation and related materials
+* ("Software"), is owned by Cypress Semiconductor Corporation or one of its
+* subsidiaries ("Cypress") and is protected by and subject to worldwide patent
+* protection (United States and foreign), United States copyright laws and
+* international treaty provisions. Therefore, you may use this Software only
+* as provided in the license agreement accompanying the software package from
+* which you obtained this Software ("EULA").
+*
+* If no EULA applies, Cypress hereby grants you a personal, non-exclusive,
+* non-transferable license to copy, modify, and compile the Software source
+* code solely for use in connection with Cypress's integrated circuit products.
+* Any reproduction, modification, translation, compilation, or representation
+* of this Software except as specified above is prohibited without the express
+* written permission of Cypress.
+*
+* Disclaimer: THIS SOFTWARE IS PROVIDED AS-IS, WITH NO WARRANTY OF ANY KIND,
+* EXPRESS OR IMPLIED, INCLUDING, BUT NOT LIMITED TO, NONINFRINGEMENT, IMPLIED
+* WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE. Cypress
+* reserves the right to make changes to the Software without notice. Cypress
+* does not assume any liability arising out of the application or use of the
+* Software or any product or circuit described in the Software. Cypress does
+* not authorize its products for use in any products where a malfunction or
+* failure of the Cypress product may reasonably be expected to result in
+* significant property damage, injury or death ("High Risk Product"). By
+* including Cypress's product in a High Risk Product, the manufacturer of such
+* system or application assumes all risk of such use and in doing so agrees to
+* indemnify Cypress against all liability.
+*******************************************************************************/
+#ifndef OTA_MQTT_FRAME_H
+#define OTA_MQTT_FRAME_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+
+/*******************************************************************************
+ * Macros
+ ******************************************************************************/
+/* Network buffers held by a chain, and views of a packet */
+#ifndef OTA_MQTT_FRAME_MAX_VIEWS
+#define OTA_MQTT_FRAME_MAX_VIEWS            (8U)
+#endif
+
+/* Fixed header: packet type and flags, then 1 to 4 bytes of remaining length */
+#define OTA_MQTT_FRAME_HEADER_MAX           (5U)
+
+
+/*******************************************************************************
+ * Data structure and enumeration
+ ******************************************************************************/
+typedef struct
+{
+    const uint8_t *data;
+    uint32_t len;
+} ota_mqtt_view_t;
+
+/* Bytes received and not consumed yet, oldest first. The buffers belong to
+ * the caller, who keeps them until their bytes are consumed and the views of
+ * the packets in them are no longer used.
+ */
+typedef struct
+{
+    ota_mqtt_view_t bufs[OTA_MQTT_FRAME_MAX_VIEWS];
+    uint32_t count;
+    uint32_t bytes;
+} ota_mqtt_chain_t;
+
+typedef struct
+{
+    uint8_t type;                   /* First byte: packet type and flags */
+    uint32_t header_len;            /* Bytes of the fixed header */
+    uint32_t remaining;             /* Remaining length of the packet */
+    bool header_copied;             /* The header straddled two buffers */
+    uint32_t view_count;            /* Views of the remaining bytes */
+    ota_mqtt_view_t views[OTA_MQTT_FRAME_MAX_VIEWS];
+} ota_mqtt_packet_t;
+
+typedef enum
+{
+    OTA_MQTT_FRAME_MORE,            /* More bytes are needed */
+    OTA_MQTT_FRAME_PACKET,          /* Packet or header available */
+    OTA_MQTT_FRAME_ERROR            /* Invalid remaining length */
+} ota_mqtt_frame_result_t;
+
+
+/*******************************************************************************
+ * Function prototypes
+ ******************************************************************************/
+void ota_mqtt_chain_init(ota_mqtt_chain_t *chain);
+bool ota_mqtt_chain_append(ota_mqtt_chain_t *chain, const uint8_t *data, uint32_t len);
+uint32_t ota_mqtt_chain_copy(const ota_mqtt_chain_t *chain, uint8_t *dst, uint32_t len);
+void ota_mqtt_chain_consume(ota_mqtt_chain_t *chain, uint32_t len);
+ota_mqtt_frame_result_t ota_mqtt_frame_header(ota_mqtt_chain_t *chain, ota_mqtt_packet_t *packet);
+ota_mqtt_frame_result_t ota_mqtt_frame_next(ota_mqtt_chain_t *chain, ota_mqtt_packet_t *packet);
+
+
+#endif /* OTA_MQTT_FRAME_H */
+
+
+/* [] END OF FILE */
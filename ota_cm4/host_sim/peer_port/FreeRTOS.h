@@ -0,0 +1,89 @@
+/******************************************************************************
+* File Name: FreeRTOS.h
+*
+* Description: This file stands in for the FreeRTOS kernel in the host peer
+* simulations. The tasks of sources/ota_peer.c and sources/ota_multicast.c
+* run as threads of the simulated device process; see sim_peer_port.c.
+*
+* Related Document: See README.md
+*
+*******************************************************************************
+* (c) 2020, Cypress Semiconductor Corporation. All rights reserved.
+*******************************************************************************
+* This software, including source code, documentation and related materials
+* ("Software"), is owned by Cypress Semiconductor Corporation or one of its
+* subsidiaries ("Cypress") and is protected by and subject to worldwide patent
+* protection (United States and foreign), United States copyright laws and
+* international treaty provisions. Therefore, you may use this Software only
+* as provided in the license agreement accompanying the software package from
+* which you obtained this Software ("EULA").
+*
+* If no EULA applies, Cypress hereby grants you a personal, non-exclusive,
+* non-transferable license to copy, modify, and compile the Software source
+* code solely for use in connection with Cypress's integrated circuit products.
+* Any reproduction, modification, translation, compilation, or representation
+* of this Software except as specified above is prohibited without the express
+* written permission of Cypress.
+*
+* Disclaimer: THIS SOFTWARE IS PROVIDED AS-IS, WITH NO WARRANTY OF ANY KIND,
+* EXPRESS OR IMPLIED, INCLUDING, BUT NOT LIMITED TO, NONINFRINGEMENT, IMPLIED
+* WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE. Cypress
+* reserves the right to make changes to the Software without notice. Cypress
+* does not assume any liability arising out of the application or use of the
+* Software or any product or circuit described in the Software. Cypress does
+* not authorize its products for use in any products where a malfunction or
+* failure of the Cypress product may reasonably be expected to result in
+* significant property damage, injury or death ("High Risk Product"). By
+* including Cypress's product in a High Risk Product, the manufacturer of such
+* system or application assumes all risk of such use and in doing so agrees to
+* indemnify Cypress against all liability.
+*******************************************************************************/
+#ifndef SIM_PEER_FREERTOS_H
+#define SIM_PEER_FREERTOS_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdio.h>
+
+
+/*******************************************************************************
+ * Macros
+ ******************************************************************************/
+#define configTICK_RATE_HZ              (1000U)
+#define configMINIMAL_STACK_SIZE        (1024U)
+#define portTICK_PERIOD_MS              (1000U / configTICK_RATE_HZ)
+#define portMAX_DELAY                   (0xffffffffUL)
+#define pdMS_TO_TICKS(ms)               ((TickType_t)(ms))
+#define pdPASS                          (1)
+#define pdFAIL                          (0)
+#define pdTRUE                          (1)
+#define pdFALSE                         (0)
+#define tskIDLE_PRIORITY                (0U)
+
+/* The log of the device, printed with --verbose */
+#define configPRINTF(x)                 sim_peer_log x
+
+
+/*******************************************************************************
+ * Data structure and enumeration
+ ******************************************************************************/
+typedef uint32_t TickType_t;
+typedef long BaseType_t;
+typedef unsigned long UBaseType_t;
+typedef void *TaskHandle_t;
+
+
+/*******************************************************************************
+ * Function prototypes
+ ******************************************************************************/
+void sim_peer_log(const char *format, ...);
+void *pvPortMalloc(size_t size);
+void vPortFree(void *p);
+size_t xPortGetFreeHeapSize(void);
+
+
+#endif /* SIM_PEER_FREERTOS_H */
+
+
+/* [] END OF FILE */
@@ -0,0 +1,99 @@
+/******************************************************************************
+* File Name: aws_iot_ota_agent.h
+*
+* Description: This file stands in for the OTA agent in the host simulations:
+* the fields of the OTA file context used by sources/ota_multicast.c and
+* sources/ota_http_stream.c, and of the agent context, as in the agent.
+*
+* Related Document: See README.md
+*
+*******************************************************************************
+* (c) 2020, Cypress Semiconductor Corporation. All rights reserved.
+*******************************************************************************
+* This software, including source code, documentation and related materials
+* ("Software"), is owned by Cypress Semiconductor Corporation or one of its
+* subsidiaries ("Cypress") and is protected by and subject to worldwide patent
+* protection (United States and foreign), United States copyright laws and
+* international treaty provisions. Therefore, you may use this Software only
+* as provided in the license agreement accompanying the software package from
+* which you obtained this Software ("EULA").
+*
+* If no EULA applies, Cypress hereby grants you a personal, non-exclusive,
+* non-transferable license to copy, modify, and compile the Software source
+* code solely for use in connection with Cypress's integrated circuit products.
+* Any reproduction, modification, translation, compilation, or representation
+* of this Software except as specified above is prohibited without the express
+* written permission of Cypress.
+*
+* Disclaimer: THIS SOFTWARE IS PROVIDED AS-IS, WITH NO WARRANTY OF ANY KIND,
+* EXPRESS OR IMPLIED, INCLUDING, BUT NOT LIMITED TO, NONINFRINGEMENT, IMPLIED
+* WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE. Cypress
+* reserves the right to make changes to the Software without notice. Cypress
+* does not assume any liability arising out of the application or use of the
+* Software or any product or circuit described in the Software. Cypress does
+* not authorize its products for use in any products where a malfunction or
+* failure of the Cypress product may reasonably be expected to result in
+* significant property damage, injury or death ("High Risk Product"). By
+* including Cypress's product in a High Risk Product, the manufacturer of such
+* system or application assumes all risk of such use and in doing so agrees to
+* indemnify Cypress against all liability.
+*******************************************************************************/
+#ifndef SIM_PEER_AWS_IOT_OTA_AGENT_H
+#define SIM_PEER_AWS_IOT_OTA_AGENT_H
+
+#include <stdint.h>
+#include "aws_ota_agent_config.h"
+
+
+/*******************************************************************************
+ * Macros
+ ******************************************************************************/
+#define kOTA_MaxSignatureSize           (256U)
+
+#define kOTA_Err_None                   (0UL)
+#define kOTA_Err_Panic                  (0xfe000000UL)
+
+
+/*******************************************************************************
+ * Data structure and enumeration
+ ******************************************************************************/
+typedef struct
+{
+    uint16_t usSize;
+    uint8_t ucData[kOTA_MaxSignatureSize];
+} Sig256_t;
+
+typedef struct
+{
+    uint8_t *pucJobName;
+    uint8_t *pucStreamName;
+    uint8_t *pucUpdateUrlPath;
+    uint32_t ulFileSize;
+    uint8_t *pucRxBlockBitmap;  /* Bit set: block not received */
+    uint32_t ulBlocksRemaining;
+    uint32_t ulServerFileID;
+    Sig256_t *pxSignature;
+} OTA_FileContext_t;
+
+typedef struct
+{
+    void *pvNetworkCredentials;
+    void *pvNetworkInterface;
+    void *pvControlClient;
+} OTA_ConnectionContext_t;
+
+typedef struct
+{
+    uint8_t pcThingName[otaconfigMAX_THINGNAME_LEN + 1U];
+    OTA_FileContext_t *pxOTA_Files;
+    uint32_t ulFileIndex;
+    void *pvConnectionContext;
+} OTA_AgentContext_t;
+
+typedef uint32_t OTA_Err_t;
+
+
+#endif /* SIM_PEER_AWS_IOT_OTA_AGENT_H */
+
+
+/* [] END OF FILE */
@@ -0,0 +1,98 @@
+/******************************************************************************
+* File Name: aws_iot_ota_agent_internal.h
+*
+* Description: This file stands in for the internal header of the OTA agent
+* in the host simulations: the event that asks the agent for a block request,
+* used by sources/ota_block_size.c, and the event that hands it a received
+* block, used by sources/ota_http_stream.c, as in the agent.
+*
+* Related Document: See README.md
+*
+*******************************************************************************
+* (c) 2020, Cypress Semiconductor Corporation. All rights reserved.
+*******************************************************************************
+* This software, including source code, documentation and related materials
+* ("Software"), is owned by Cypress Semiconductor Corporation or one of its
+* subsidiaries ("Cypress") and is protected by and subject to worldwide patent
+* protection (United States and foreign), United States copyright laws and
+* international treaty provisions. Therefore, you may use this Software only
+* as provided in the license agreement accompanying the software package from
+* which you obtained this Software ("EULA").
+*
+* If no EULA applies, Cypress hereby grants you a personal, non-exclusive,
+* non-transferable license to copy, modify, and compile the Software source
+* code solely for use in connection with Cypress's integrated circuit products.
+* Any reproduction, modification, translation, compilation, or representation
+* of this Software except as specified above is prohibited without the express
+* written permission of Cypress.
+*
+* Disclaimer: THIS SOFTWARE IS PROVIDED AS-IS, WITH NO WARRANTY OF ANY KIND,
+* EXPRESS OR IMPLIED, INCLUDING, BUT NOT LIMITED TO, NONINFRINGEMENT, IMPLIED
+* WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE. Cypress
+* reserves the right to make changes to the Software without notice. Cypress
+* does not assume any liability arising out of the application or use of the
+* Software or any product or circuit described in the Software. Cypress does
+* not authorize its products for use in any products where a malfunction or
+* failure of the Cypress product may reasonably be expected to result in
+* significant property damage, injury or death ("High Risk Product"). By
+* including Cypress's product in a High Risk Product, the manufacturer of such
+* system or application assumes all risk of such use and in doing so agrees to
+* indemnify Cypress against all liability.
+*******************************************************************************/
+#ifndef SIM_PEER_AWS_IOT_OTA_AGENT_INTERNAL_H
+#define SIM_PEER_AWS_IOT_OTA_AGENT_INTERNAL_H
+
+#include <stdbool.h>
+#include "aws_ota_agent_config.h"
+#include "aws_iot_ota_agent.h"
+
+
+/*******************************************************************************
+ * Macros
+ ******************************************************************************/
+/* Data buffer of an event: one block and the URL of a block request */
+#define OTA_DATA_BLOCK_SIZE             ((1U << otaconfigLOG2_FILE_BLOCK_SIZE) + 1024U + 30U)
+
+
+/*******************************************************************************
+ * Data structure and enumeration
+ ******************************************************************************/
+typedef enum
+{
+    eJobStatus_InProgress = 0,
+    eJobStatus_Failed,
+    eJobStatus_Succeeded,
+    eJobStatus_Rejected,
+    eJobStatus_FailedWithVal
+} OTA_JobStatus_t;
+
+typedef enum
+{
+    eOTA_AgentEvent_RequestFileBlock,
+    eOTA_AgentEvent_ReceivedFileBlock
+} OTA_Event_t;
+
+typedef struct
+{
+    uint8_t data[OTA_DATA_BLOCK_SIZE];
+    uint32_t ulDataLength;
+    bool bBufferUsed;
+} OTA_EventData_t;
+
+typedef struct
+{
+    OTA_Event_t xEventId;
+    OTA_EventData_t *pxEventData;
+} OTA_EventMsg_t;
+
+
+/*******************************************************************************
+ * Function prototypes
+ ******************************************************************************/
+bool OTA_SignalEvent(const OTA_EventMsg_t * const pxEventMsg);
+
+
+#endif /* SIM_PEER_AWS_IOT_OTA_AGENT_INTERNAL_H */
+
+
+/* [] END OF FILE */
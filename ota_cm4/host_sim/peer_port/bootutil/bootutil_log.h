@@ -0,0 +1,58 @@
+/******************************************************************************
+* File Name: bootutil_log.h
+*
+* Description: This file contains the MCUboot log macros of the host
+* simulations, printed on stdout.
+*
+* Related Document: See README.md
+*
+*******************************************************************************
+* (c) 2020, Cypress Semiconductor Corporation. All rights reserved.
+*******************************************************************************
+* This software, including source code, documentation and related materials
+* ("Software"), is owned by Cypress Semiconductor Corporation or one of its
+* subsidiaries ("Cypress") and is protected by and subject to worldwide patent
+* protection (United States and foreign), United States copyright laws and
+* international treaty provisions. Therefore, you may use this Software only
+* as provided in the license agreement accompanying the software package from
+* which you obtained this Software ("EULA").
+*
+* If no EULA applies, Cypress hereby grants you a personal, non-exclusive,
+* non-transferable license to copy, modify, and compile the Software source
+* code solely for use in connection with Cypress's integrated circuit products.
+* Any reproduction, modification, translation, compilation, or representation
+* of this Software except as specified above is prohibited without the express
+* written permission of Cypress.
+*
+* Disclaimer: THIS SOFTWARE IS PROVIDED AS-IS, WITH NO WARRANTY OF ANY KIND,
+* EXPRESS OR IMPLIED, INCLUDING, BUT NOT LIMITED TO, NONINFRINGEMENT, IMPLIED
+* WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE. Cypress
+* reserves the right to make changes to the Software without notice. Cypress
+* does not assume any liability arising out of the application or use of the
+* Software or any product or circuit described in the Software. Cypress does
+* not authorize its products for use in any products where a malfunction or
+* failure of the Cypress product may reasonably be expected to result in
+* significant property damage, injury or death ("High Risk Product"). By
+* including Cypress's product in a High Risk Product, the manufacturer of such
+* system or application assumes all risk of such use and in doing so agrees to
+* indemnify Cypress against all liability.
+*******************************************************************************/
+#ifndef SIM_PEER_BOOTUTIL_LOG_H
+#define SIM_PEER_BOOTUTIL_LOG_H
+
+#include <stdio.h>
+
+
+/*******************************************************************************
+ * Macros
+ ******************************************************************************/
+#define BOOT_LOG_ERR(_fmt, ...)         printf("[ERR] " _fmt "\n", ##__VA_ARGS__)
+#define BOOT_LOG_WRN(_fmt, ...)         printf("[WRN] " _fmt "\n", ##__VA_ARGS__)
+#define BOOT_LOG_INF(_fmt, ...)         printf("[INF] " _fmt "\n", ##__VA_ARGS__)
+#define BOOT_LOG_DBG(_fmt, ...)
+
+
+#endif /* SIM_PEER_BOOTUTIL_LOG_H */
+
+
+/* [] END OF FILE */
@@ -0,0 +1,94 @@
+/******************************************************************************
+* File Name: image.h
+*
+* Description: This file contains the MCUboot image header and TLV area
+* layout used by the host dedup simulation, in place of the MCUboot one.
+*
+* Related Document: See README.md
+*
+*******************************************************************************
+* (c) 2020, Cypress Semiconductor Corporation. All rights reserved.
+*******************************************************************************
+* This software, including source code, documentation and related materials
+* ("Software"), is owned by Cypress Semiconductor Corporation or one of its
+* subsidiaries ("Cypress") and is protected by and subject to worldwide patent
+* protection (United States and foreign), United States copyright laws and
+* international treaty provisions. Therefore, you may use this Software only
+* as provided in the license agreement accompanying the software package from
+* which you obtained this Software ("EULA").
+*
+* If no EULA applies, Cypress hereby grants you a personal, non-exclusive,
+* non-transferable license to copy, modify, and compile the Software source
+* code solely for use in connection with Cypress's integrated circuit products.
+* Any reproduction, modification, translation, compilation, or representation
+* of this Software except as specified above is prohibited without the express
+* written permission of Cypress.
+*
+* Disclaimer: THIS SOFTWARE IS PROVIDED AS-IS, WITH NO WARRANTY OF ANY KIND,
+* EXPRESS OR IMPLIED, INCLUDING, BUT NOT LIMITED TO, NONINFRINGEMENT, IMPLIED
+* WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE. Cypress
+* reserves the right to make changes to the Software without notice. Cypress
+* does not assume any liability arising out of the application or use of the
+* Software or any product or circuit described in the Software. Cypress does
+* not authorize its products for use in any products where a malfunction or
+* failure of the Cypress product may reasonably be expected to result in
+* significant property damage, injury or death ("High Risk Product"). By
+* including Cypress's product in a High Risk Product, the manufacturer of such
+* system or application assumes all risk of such use and in doing so agrees to
+* indemnify Cypress against all liability.
+*******************************************************************************/
+#ifndef SIM_PEER_IMAGE_H
+#define SIM_PEER_IMAGE_H
+
+#include <stdint.h>
+
+
+/*******************************************************************************
+ * Macros
+ ******************************************************************************/
+#define IMAGE_MAGIC                     (0x96f3b83dUL)
+#define IMAGE_TLV_INFO_MAGIC            (0x6907U)
+#define IMAGE_TLV_PROT_INFO_MAGIC       (0x6908U)
+#define IMAGE_TLV_SHA256                (0x10U)
+
+
+/*******************************************************************************
+ * Data structure and enumeration
+ ******************************************************************************/
+struct image_version
+{
+    uint8_t iv_major;
+    uint8_t iv_minor;
+    uint16_t iv_revision;
+    uint32_t iv_build_num;
+};
+
+struct image_header
+{
+    uint32_t ih_magic;
+    uint32_t ih_load_addr;
+    uint16_t ih_hdr_size;
+    uint16_t ih_protect_tlv_size;
+    uint32_t ih_img_size;
+    uint32_t ih_flags;
+    struct image_version ih_ver;
+    uint32_t _pad1;
+};
+
+struct image_tlv_info
+{
+    uint16_t it_magic;
+    uint16_t it_tlv_tot;        /* Size of the TLV area, this header included */
+};
+
+struct image_tlv
+{
+    uint16_t it_type;
+    uint16_t it_len;
+};
+
+
+#endif /* SIM_PEER_IMAGE_H */
+
+
+/* [] END OF FILE */
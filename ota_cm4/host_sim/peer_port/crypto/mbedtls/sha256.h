@@ -0,0 +1,78 @@
+/******************************************************************************
+* File Name: sha256.h
+*
+* Description: This file contains the SHA-256 functions of the host
+* simulations, in place of the mbedtls ones; see sim_crypto.c. The time the
+* kit would take to hash is counted at a configurable rate.
+*
+* Related Document: See README.md
+*
+*******************************************************************************
+* (c) 2020, Cypress Semiconductor Corporation. All rights reserved.
+*******************************************************************************
+* This software, including source code, documentation and related materials
+* ("Software"), is owned by Cypress Semiconductor Corporation or one of its
+* subsidiaries ("Cypress") and is protected by and subject to worldwide patent
+* protection (United States and foreign), United States copyright laws and
+* international treaty provisions. Therefore, you may use this Software only
+* as provided in the license agreement accompanying the software package from
+* which you obtained this Software ("EULA").
+*
+* If no EULA applies, Cypress hereby grants you a personal, non-exclusive,
+* non-transferable license to copy, modify, and compile the Software source
+* code solely for use in connection with Cypress's integrated circuit products.
+* Any reproduction, modification, translation, compilation, or representation
+* of this Software except as specified above is prohibited without the express
+* written permission of Cypress.
+*
+* Disclaimer: THIS SOFTWARE IS PROVIDED AS-IS, WITH NO WARRANTY OF ANY KIND,
+* EXPRESS OR IMPLIED, INCLUDING, BUT NOT LIMITED TO, NONINFRINGEMENT, IMPLIED
+* WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE. Cypress
+* reserves the right to make changes to the Software without notice. Cypress
+* does not assume any liability arising out of the application or use of the
+* Software or any product or circuit described in the Software. Cypress does
+* not authorize its products for use in any products where a malfunction or
+* failure of the Cypress product may reasonably be expected to result in
+* significant property damage, injury or death ("High Risk Product"). By
+* including Cypress's product in a High Risk Product, the manufacturer of such
+* system or application assumes all risk of such use and in doing so agrees to
+* indemnify Cypress against all liability.
+*******************************************************************************/
+#ifndef SIM_PEER_MBEDTLS_SHA256_H
+#define SIM_PEER_MBEDTLS_SHA256_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+
+/*******************************************************************************
+ * Data structure and enumeration
+ ******************************************************************************/
+typedef struct
+{
+    uint32_t state[8];
+    uint64_t total;                 /* Bytes hashed */
+    uint8_t buffer[64];             /* Partial block */
+} mbedtls_sha256_context;
+
+
+/*******************************************************************************
+ * Function prototypes
+ ******************************************************************************/
+void mbedtls_sha256_init(mbedtls_sha256_context *ctx);
+void mbedtls_sha256_free(mbedtls_sha256_context *ctx);
+int mbedtls_sha256_starts_ret(mbedtls_sha256_context *ctx, int is224);
+int mbedtls_sha256_update_ret(mbedtls_sha256_context *ctx, const unsigned char *input,
+                              size_t ilen);
+int mbedtls_sha256_finish_ret(mbedtls_sha256_context *ctx, unsigned char output[32]);
+int mbedtls_sha256_ret(const unsigned char *input, size_t ilen, unsigned char output[32],
+                       int is224);
+
+void sim_crypto_hash_rate(uint32_t kbps);
+uint64_t sim_crypto_hash_us(void);
+
+
+#endif /* SIM_PEER_MBEDTLS_SHA256_H */
+
+
+/* [] END OF FILE */
@@ -0,0 +1,350 @@
+/******************************************************************************
+* File Name: sim_crypto.c
+*
+* Description: This file contains the crypto stand-ins of the host
+* simulations, in place of mbedtls: a SHA-256 that counts the time the kit
+* would take at the rate set by sim_crypto_hash_rate(), and a certificate
+* and signature check where the signature of a hash is the hash itself.
+*
+* Related Document: See README.md
+*
+*******************************************************************************
+* (c) 2020, Cypress Semiconductor Corporation. All rights reserved.
+*******************************************************************************
+* This software, including source code, documentation and related materials
+* ("Software"), is owned by Cypress Semiconductor Corporation or one of its
+* subsidiaries ("Cypress") and is protected by and subject to worldwide patent
+* protection (United States and foreign), United States copyright laws and
+* international treaty provisions. Therefore, you may use this Software only
+* as provided in the license agreement accompanying the software package from
+* which you obtained this Software ("EULA").
+*
+* If no EULA applies, Cypress hereby grants you a personal, non-exclusive,
+* non-transferable license to copy, modify, and compile the Software source
+* code solely for use in connection with Cypress's integrated circuit products.
+* Any reproduction, modification, translation, compilation, or representation
+* of this Software except as specified above is prohibited without the express
+* written permission of Cypress.
+*
+* Disclaimer: THIS SOFTWARE IS PROVIDED AS-IS, WITH NO WARRANTY OF ANY KIND,
+* EXPRESS OR IMPLIED, INCLUDING, BUT NOT LIMITED TO, NONINFRINGEMENT, IMPLIED
+* WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE. Cypress
+* reserves the right to make changes to the Software without notice. Cypress
+* does not assume any liability arising out of the application or use of the
+* Software or any product or circuit described in the Software. Cypress does
+* not authorize its products for use in any products where a malfunction or
+* failure of the Cypress product may reasonably be expected to result in
+* significant property damage, injury or death ("High Risk Product"). By
+* including Cypress's product in a High Risk Product, the manufacturer of such
+* system or application assumes all risk of such use and in doing so agrees to
+* indemnify Cypress against all liability.
+*******************************************************************************/
+#include <string.h>
+#include "mbedtls/sha256.h"
+#include "mbedtls/x509_crt.h"
+#include "mbedtls/pk.h"
+
+
+/*******************************************************************************
+ * Macros
+ ******************************************************************************/
+#define SHA256_BLOCK_SIZE               (64U)
+#define SHA256_DIGEST_SIZE              (32U)
+#define US_PER_S                        (1000000ULL)
+#define BYTES_PER_S_PER_KBPS            (1000U / 8U)
+#define ROTR(x, n)                      (((x) >> (n)) | ((x) << (32U - (n))))
+
+
+/*******************************************************************************
+ * Global variables
+ ******************************************************************************/
+static const uint32_t sha256_k[64] =
+{
+    0x428a2f98UL, 0x71374491UL, 0xb5c0fbcfUL, 0xe9b5dba5UL, 0x3956c25bUL, 0x59f111f1UL,
+    0x923f82a4UL, 0xab1c5ed5UL, 0xd807aa98UL, 0x12835b01UL, 0x243185beUL, 0x550c7dc3UL,
+    0x72be5d74UL, 0x80deb1feUL, 0x9bdc06a7UL, 0xc19bf174UL, 0xe49b69c1UL, 0xefbe4786UL,
+    0x0fc19dc6UL, 0x240ca1ccUL, 0x2de92c6fUL, 0x4a7484aaUL, 0x5cb0a9dcUL, 0x76f988daUL,
+    0x983e5152UL, 0xa831c66dUL, 0xb00327c8UL, 0xbf597fc7UL, 0xc6e00bf3UL, 0xd5a79147UL,
+    0x06ca6351UL, 0x14292967UL, 0x27b70a85UL, 0x2e1b2138UL, 0x4d2c6dfcUL, 0x53380d13UL,
+    0x650a7354UL, 0x766a0abbUL, 0x81c2c92eUL, 0x92722c85UL, 0xa2bfe8a1UL, 0xa81a664bUL,
+    0xc24b8b70UL, 0xc76c51a3UL, 0xd192e819UL, 0xd6990624UL, 0xf40e3585UL, 0x106aa070UL,
+    0x19a4c116UL, 0x1e376c08UL, 0x2748774cUL, 0x34b0bcb5UL, 0x391c0cb3UL, 0x4ed8aa4aUL,
+    0x5b9cca4fUL, 0x682e6ff3UL, 0x748f82eeUL, 0x78a5636fUL, 0x84c87814UL, 0x8cc70208UL,
+    0x90befffaUL, 0xa4506cebUL, 0xbef9a3f7UL, 0xc67178f2UL
+};
+
+static uint32_t hash_kbps;
+static uint64_t hash_us;
+
+
+/*******************************************************************************
+ * Function Name: sha256_block
+ ******************************************************************************/
+static void sha256_block(uint32_t state[8], const uint8_t *block)
+{
+    uint32_t w[64];
+    uint32_t v[8];
+
+    for (uint32_t i = 0U; i < 16U; i++)
+    {
+        w[i] = ((uint32_t)block[4U * i] << 24) | ((uint32_t)block[(4U * i) + 1U] << 16) |
+               ((uint32_t)block[(4U * i) + 2U] << 8) | (uint32_t)block[(4U * i) + 3U];
+    }
+
+    for (uint32_t i = 16U; i < 64U; i++)
+    {
+        uint32_t s0 = ROTR(w[i - 15U], 7U) ^ ROTR(w[i - 15U], 18U) ^ (w[i - 15U] >> 3);
+        uint32_t s1 = ROTR(w[i - 2U], 17U) ^ ROTR(w[i - 2U], 19U) ^ (w[i - 2U] >> 10);
+
+        w[i] = w[i - 16U] + s0 + w[i - 7U] + s1;
+    }
+
+    memcpy(v, state, sizeof(v));
+
+    for (uint32_t i = 0U; i < 64U; i++)
+    {
+        uint32_t t1 = v[7] + (ROTR(v[4], 6U) ^ ROTR(v[4], 11U) ^ ROTR(v[4], 25U)) +
+                      ((v[4] & v[5]) ^ (~v[4] & v[6])) + sha256_k[i] + w[i];
+        uint32_t t2 = (ROTR(v[0], 2U) ^ ROTR(v[0], 13U) ^ ROTR(v[0], 22U)) +
+                      ((v[0] & v[1]) ^ (v[0] & v[2]) ^ (v[1] & v[2]));
+
+        memmove(&v[1], &v[0], 7U * sizeof(v[0]));
+        v[4] += t1;
+        v[0] = t1 + t2;
+    }
+
+    for (uint32_t i = 0U; i < 8U; i++)
+    {
+        state[i] += v[i];
+    }
+}
+
+
+/*******************************************************************************
+ * Function Name: sim_crypto_hash_rate
+ *******************************************************************************
+ * Summary:
+ *  Sets the hash rate of the kit and clears the hash time counted.
+ *
+ * Parameters:
+ *  kbps - hash rate, 0 for no time
+ *
+ ******************************************************************************/
+void sim_crypto_hash_rate(uint32_t kbps)
+{
+    hash_kbps = kbps;
+    hash_us = 0U;
+}
+
+
+/*******************************************************************************
+ * Function Name: sim_crypto_hash_us
+ ******************************************************************************/
+uint64_t sim_crypto_hash_us(void)
+{
+    return hash_us;
+}
+
+
+/*******************************************************************************
+ * Function Name: mbedtls_sha256_init
+ ******************************************************************************/
+void mbedtls_sha256_init(mbedtls_sha256_context *ctx)
+{
+    memset(ctx, 0, sizeof(*ctx));
+}
+
+
+/*******************************************************************************
+ * Function Name: mbedtls_sha256_free
+ ******************************************************************************/
+void mbedtls_sha256_free(mbedtls_sha256_context *ctx)
+{
+    memset(ctx, 0, sizeof(*ctx));
+}
+
+
+/*******************************************************************************
+ * Function Name: mbedtls_sha256_starts_ret
+ ******************************************************************************/
+int mbedtls_sha256_starts_ret(mbedtls_sha256_context *ctx, int is224)
+{
+    static const uint32_t init[8] =
+    {
+        0x6a09e667UL, 0xbb67ae85UL, 0x3c6ef372UL, 0xa54ff53aUL,
+        0x510e527fUL, 0x9b05688cUL, 0x1f83d9abUL, 0x5be0cd19UL
+    };
+
+    if (0 != is224)
+    {
+        return -1;
+    }
+
+    memcpy(ctx->state, init, sizeof(init));
+    ctx->total = 0U;
+
+    return 0;
+}
+
+
+/*******************************************************************************
+ * Function Name: mbedtls_sha256_update_ret
+ ******************************************************************************/
+int mbedtls_sha256_update_ret(mbedtls_sha256_context *ctx, const unsigned char *input,
+                              size_t ilen)
+{
+    uint32_t used = (uint32_t)(ctx->total % SHA256_BLOCK_SIZE);
+
+    if (0U != hash_kbps)
+    {
+        hash_us += ((uint64_t)ilen * US_PER_S) / ((uint64_t)hash_kbps * BYTES_PER_S_PER_KBPS);
+    }
+
+    ctx->total += ilen;
+
+    while (ilen > 0U)
+    {
+        uint32_t n = SHA256_BLOCK_SIZE - used;
+
+        if (n > ilen)
+        {
+            n = (uint32_t)ilen;
+        }
+
+        memcpy(&ctx->buffer[used], input, n);
+        used += n;
+        input += n;
+        ilen -= n;
+
+        if (SHA256_BLOCK_SIZE == used)
+        {
+            sha256_block(ctx->state, ctx->buffer);
+            used = 0U;
+        }
+    }
+
+    return 0;
+}
+
+
+/*******************************************************************************
+ * Function Name: mbedtls_sha256_finish_ret
+ ******************************************************************************/
+int mbedtls_sha256_finish_ret(mbedtls_sha256_context *ctx, unsigned char output[32])
+{
+    uint64_t bits = ctx->total * 8U;
+    uint32_t used = (uint32_t)(ctx->total % SHA256_BLOCK_SIZE);
+
+    ctx->buffer[used++] = 0x80U;
+    if (used > (SHA256_BLOCK_SIZE - 8U))
+    {
+        memset(&ctx->buffer[used], 0, SHA256_BLOCK_SIZE - used);
+        sha256_block(ctx->state, ctx->buffer);
+        used = 0U;
+    }
+
+    memset(&ctx->buffer[used], 0, SHA256_BLOCK_SIZE - 8U - used);
+    for (uint32_t i = 0U; i < 8U; i++)
+    {
+        ctx->buffer[SHA256_BLOCK_SIZE - 1U - i] = (uint8_t)(bits >> (8U * i));
+    }
+    sha256_block(ctx->state, ctx->buffer);
+
+    for (uint32_t i = 0U; i < 8U; i++)
+    {
+        output[4U * i] = (uint8_t)(ctx->state[i] >> 24);
+        output[(4U * i) + 1U] = (uint8_t)(ctx->state[i] >> 16);
+        output[(4U * i) + 2U] = (uint8_t)(ctx->state[i] >> 8);
+        output[(4U * i) + 3U] = (uint8_t)ctx->state[i];
+    }
+
+    return 0;
+}
+
+
+/*******************************************************************************
+ * Function Name: mbedtls_sha256_ret
+ ******************************************************************************/
+int mbedtls_sha256_ret(const unsigned char *input, size_t ilen, unsigned char output[32],
+                       int is224)
+{
+    mbedtls_sha256_context ctx;
+    int rc;
+
+    mbedtls_sha256_init(&ctx);
+    rc = mbedtls_sha256_starts_ret(&ctx, is224);
+    if (0 == rc)
+    {
+        rc = mbedtls_sha256_update_ret(&ctx, input, ilen);
+    }
+    if (0 == rc)
+    {
+        rc = mbedtls_sha256_finish_ret(&ctx, output);
+    }
+    mbedtls_sha256_free(&ctx);
+
+    return rc;
+}
+
+
+/*******************************************************************************
+ * Function Name: mbedtls_x509_crt_init
+ ******************************************************************************/
+void mbedtls_x509_crt_init(mbedtls_x509_crt *crt)
+{
+    memset(crt, 0, sizeof(*crt));
+}
+
+
+/*******************************************************************************
+ * Function Name: mbedtls_x509_crt_parse
+ *******************************************************************************
+ * Summary:
+ *  Accepts any certificate that is not empty.
+ *
+ ******************************************************************************/
+int mbedtls_x509_crt_parse(mbedtls_x509_crt *chain, const unsigned char *buf, size_t buflen)
+{
+    if ((NULL == buf) || (0U == buflen))
+    {
+        return -1;
+    }
+
+    chain->pk.key = buf;
+    chain->pk.key_len = buflen;
+
+    return 0;
+}
+
+
+/*******************************************************************************
+ * Function Name: mbedtls_x509_crt_free
+ ******************************************************************************/
+void mbedtls_x509_crt_free(mbedtls_x509_crt *crt)
+{
+    memset(crt, 0, sizeof(*crt));
+}
+
+
+/*******************************************************************************
+ * Function Name: mbedtls_pk_verify
+ *******************************************************************************
+ * Summary:
+ *  Verifies a signature of a SHA-256 hash: here, the hash itself.
+ *
+ ******************************************************************************/
+int mbedtls_pk_verify(mbedtls_pk_context *ctx, mbedtls_md_type_t md_alg,
+                      const unsigned char *hash, size_t hash_len,
+                      const unsigned char *sig, size_t sig_len)
+{
+    if ((NULL == ctx->key) || (MBEDTLS_MD_SHA256 != md_alg) ||
+        (SHA256_DIGEST_SIZE != hash_len) || (hash_len != sig_len))
+    {
+        return -1;
+    }
+
+    return (0 == memcmp(hash, sig, hash_len)) ? 0 : -1;
+}
+
+
+/* [] END OF FILE */
@@ -0,0 +1,100 @@
+/******************************************************************************
+* File Name: cy_pdl.h
+*
+* Description: This file contains the part of the PDL used by ecdsa_comb.c
+* in the host ECDSA benchmark.
+*
+* Related Document: See README.md
+*
+*******************************************************************************
+* (c) 2020, Cypress Semiconductor Corporation. All rights reserved.
+*******************************************************************************
+* This software, including source code, documentation and related materials
+* ("Software"), is owned by Cypress Semiconductor Corporation or one of its
+* subsidiaries ("Cypress") and is protected by and subject to worldwide patent
+* protection (United States and foreign), United States copyright laws and
+* international treaty provisions. Therefore, you may use this Software only
+* as provided in the license agreement accompanying the software package from
+* which you obtained this Software ("EULA").
+*
+* If no EULA applies, Cypress hereby grants you a personal, non-exclusive,
+* non-transferable license to copy, modify, and compile the Software source
+* code solely for use in connection with Cypress's integrated circuit products.
+* Any reproduction, modification, translation, compilation, or representation
+* of this Software except as specified above is prohibited without the express
+* written permission of Cypress.
+*
+* Disclaimer: THIS SOFTWARE IS PROVIDED AS-IS, WITH NO WARRANTY OF ANY KIND,
+* EXPRESS OR IMPLIED, INCLUDING, BUT NOT LIMITED TO, NONINFRINGEMENT, IMPLIED
+* WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE. Cypress
+* reserves the right to make changes to the Software without notice. Cypress
+* does not assume any liability arising out of the application or use of the
+* Software or any product or circuit described in the Software. Cypress does
+* not authorize its products for use in any products where a malfunction or
+* failure of the Cypress product may reasonably be expected to result in
+* significant property damage, injury or death ("High Risk Product"). By
+* including Cypress's product in a High Risk Product, the manufacturer of such
+* system or application assumes all risk of such use and in doing so agrees to
+* indemnify Cypress against all liability.
+*******************************************************************************/
+#ifndef SIM_PEER_CY_PDL_H
+#define SIM_PEER_CY_PDL_H
+
+#include <stdint.h>
+
+
+/*******************************************************************************
+ * Macros
+ ******************************************************************************/
+#define CY_STATIC_ASSERT(condition, message)    _Static_assert(condition, message)
+#define CY_FLASH_SIZEOF_ROW                     (512UL)
+#define CY_SMIF_BASE_MEM_OFFSET                 (0x18000000UL)
+
+
+/* Cycle counter of the debug unit: the simulations that use it define the
+ * registers and advance CYCCNT.
+ */
+#define DWT                                     (&sim_dwt)
+#define CoreDebug                               (&sim_core_debug)
+#define DWT_CTRL_CYCCNTENA_Msk                  (1UL)
+#define CoreDebug_DEMCR_TRCENA_Msk              (1UL << 24)
+
+
+/*******************************************************************************
+ * Data structure and enumeration
+ ******************************************************************************/
+typedef struct
+{
+    volatile uint32_t CTRL;
+    volatile uint32_t CYCCNT;
+} DWT_Type;
+
+typedef struct
+{
+    volatile uint32_t DEMCR;
+} CoreDebug_Type;
+
+/* Only the fields the OTA app reads */
+typedef struct
+{
+    uint32_t programSize;
+} cy_stc_smif_mem_device_cfg_t;
+
+typedef struct
+{
+    cy_stc_smif_mem_device_cfg_t *deviceCfg;
+} cy_stc_smif_mem_config_t;
+
+
+/*******************************************************************************
+ * Global variables
+ ******************************************************************************/
+extern DWT_Type sim_dwt;
+extern CoreDebug_Type sim_core_debug;
+extern uint32_t SystemCoreClock;
+
+
+#endif /* SIM_PEER_CY_PDL_H */
+
+
+/* [] END OF FILE */
@@ -0,0 +1,127 @@
+/******************************************************************************
+* File Name: iot_mqtt.h
+*
+* Description: This file contains the MQTT publish functions of the host
+* simulations, in place of the ones of amazon-freertos. The simulations that
+* use them provide them.
+*
+* Related Document: See README.md
+*
+*******************************************************************************
+* (c) 2020, Cypress Semiconductor Corporation. All rights reserved.
+*******************************************************************************
+* This software, including source code, documentation and related materials
+* ("Software"), is owned by Cypress Semiconductor Corporation or one of its
+* subsidiaries ("Cypress") and is protected by and subject to worldwide patent
+* protection (United States and foreign), United States copyright laws and
+* international treaty provisions. Therefore, you may use this Software only
+* as provided in the license agreement accompanying the software package from
+* which you obtained this Software ("EULA").
+*
+* If no EULA applies, Cypress hereby grants you a personal, non-exclusive,
+* non-transferable license to copy, modify, and compile the Software source
+* code solely for use in connection with Cypress's integrated circuit products.
+* Any reproduction, modification, translation, compilation, or representation
+* of this Software except as specified above is prohibited without the express
+* written permission of Cypress.
+*
+* Disclaimer: THIS SOFTWARE IS PROVIDED AS-IS, WITH NO WARRANTY OF ANY KIND,
+* EXPRESS OR IMPLIED, INCLUDING, BUT NOT LIMITED TO, NONINFRINGEMENT, IMPLIED
+* WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE. Cypress
+* reserves the right to make changes to the Software without notice. Cypress
+* does not assume any liability arising out of the application or use of the
+* Software or any product or circuit described in the Software. Cypress does
+* not authorize its products for use in any products where a malfunction or
+* failure of the Cypress product may reasonably be expected to result in
+* significant property damage, injury or death ("High Risk Product"). By
+* including Cypress's product in a High Risk Product, the manufacturer of such
+* system or application assumes all risk of such use and in doing so agrees to
+* indemnify Cypress against all liability.
+*******************************************************************************/
+#ifndef SIM_PEER_IOT_MQTT_H
+#define SIM_PEER_IOT_MQTT_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+
+/*******************************************************************************
+ * Macros
+ ******************************************************************************/
+#define IOT_MQTT_PUBLISH_INFO_INITIALIZER   { .qos = IOT_MQTT_QOS_0 }
+
+
+/*******************************************************************************
+ * Data structure and enumeration
+ ******************************************************************************/
+typedef enum
+{
+    IOT_MQTT_SUCCESS = 0,
+    IOT_MQTT_STATUS_PENDING = 1,
+    IOT_MQTT_NO_MEMORY = 4,
+    IOT_MQTT_TIMEOUT = 8
+} IotMqttError_t;
+
+typedef enum
+{
+    IOT_MQTT_QOS_0 = 0,
+    IOT_MQTT_QOS_1 = 1
+} IotMqttQos_t;
+
+typedef struct
+{
+    IotMqttQos_t qos;
+    bool retain;
+    const char *pTopicName;
+    uint16_t topicNameLength;
+    const void *pPayload;
+    size_t payloadLength;
+    uint32_t retryMs;
+    uint32_t retryLimit;
+} IotMqttPublishInfo_t;
+
+typedef struct _mqttConnection *IotMqttConnection_t;
+typedef struct _mqttOperation *IotMqttOperation_t;
+
+typedef struct
+{
+    IotMqttConnection_t mqttConnection;
+    union
+    {
+        struct
+        {
+            uint32_t type;
+            IotMqttOperation_t reference;
+            IotMqttError_t result;
+        } operation;
+    } u;
+} IotMqttCallbackParam_t;
+
+typedef struct
+{
+    void *pCallbackContext;
+    void (*function)(void *pCallbackContext, IotMqttCallbackParam_t *pCallbackParam);
+} IotMqttCallbackInfo_t;
+
+
+/*******************************************************************************
+ * Function prototypes
+ ******************************************************************************/
+IotMqttError_t IotMqtt_TimedPublish(IotMqttConnection_t mqttConnection,
+                                    const IotMqttPublishInfo_t *pPublishInfo,
+                                    uint32_t flags, uint32_t timeoutMs);
+IotMqttError_t IotMqtt_PublishSync(IotMqttConnection_t mqttConnection,
+                                   const IotMqttPublishInfo_t *pPublishInfo,
+                                   uint32_t flags, uint32_t timeoutMs);
+IotMqttError_t IotMqtt_PublishAsync(IotMqttConnection_t mqttConnection,
+                                    const IotMqttPublishInfo_t *pPublishInfo,
+                                    uint32_t flags,
+                                    const IotMqttCallbackInfo_t *pCallbackInfo,
+                                    IotMqttOperation_t *const pPublishOperation);
+
+
+#endif /* SIM_PEER_IOT_MQTT_H */
+
+
+/* [] END OF FILE */
@@ -0,0 +1,101 @@
+/******************************************************************************
+* File Name: iot_secure_sockets.h
+*
+* Description: This file contains the secure sockets functions of the host
+* simulations, in place of the ones of amazon-freertos. The simulations that
+* use them provide them.
+*
+*
+* Related Document: See README.md
+*
+*******************************************************************************
+* (c) 2020, Cypress Semiconductor Corporation. All rights reserved.
+*******************************************************************************
+* This software, including source code, documentation and related materials
+* ("Software"), is owned by Cypress Semiconductor Corporation or one of its
+* subsidiaries ("Cypress") and is protected by and subject to worldwide patent
+* protection (United States and foreign), United States copyright laws and
+* international treaty provisions. Therefore, you may use this Software only
+* as provided in the license agreement accompanying the software package from
+* which you obtained this Software ("EULA").
+*
+* If no EULA applies, Cypress hereby grants you a personal, non-exclusive,
+* non-transferable license to copy, modify, and compile the Software source
+* code solely for use in connection with Cypress's integrated circuit products.
+* Any reproduction, modification, translation, compilation, or representation
+* of this Software except as specified above is prohibited without the express
+* written permission of Cypress.
+*
+* Disclaimer: THIS SOFTWARE IS PROVIDED AS-IS, WITH NO WARRANTY OF ANY KIND,
+* EXPRESS OR IMPLIED, INCLUDING, BUT NOT LIMITED TO, NONINFRINGEMENT, IMPLIED
+* WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE. Cypress
+* reserves the right to make changes to the Software without notice. Cypress
+* does not assume any liability arising out of the application or use of the
+* Software or any product or circuit described in the Software. Cypress does
+* not authorize its products for use in any products where a malfunction or
+* failure of the Cypress product may reasonably be expected to result in
+* significant property damage, injury or death ("High Risk Product"). By
+* including Cypress's product in a High Risk Product, the manufacturer of such
+* system or application assumes all risk of such use and in doing so agrees to
+* indemnify Cypress against all liability.
+*******************************************************************************/
+#ifndef SIM_PEER_IOT_SECURE_SOCKETS_H
+#define SIM_PEER_IOT_SECURE_SOCKETS_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include "FreeRTOS.h"
+
+
+/*******************************************************************************
+ * Macros
+ ******************************************************************************/
+#define SOCKETS_INVALID_SOCKET              ((Socket_t)~0U)
+#define SOCKETS_ERROR_NONE                  (0)
+#define SOCKETS_SOCKET_ERROR                (-1)
+
+#define SOCKETS_AF_INET                     (2)
+#define SOCKETS_SOCK_STREAM                 (1)
+#define SOCKETS_IPPROTO_TCP                 (6)
+#define SOCKETS_SHUT_RDWR                   (2)
+
+#define SOCKETS_SO_RCVTIMEO                 (0)
+#define SOCKETS_SO_SNDTIMEO                 (1)
+#define SOCKETS_SO_SERVER_NAME_INDICATION   (4)
+#define SOCKETS_SO_REQUIRE_TLS              (10)
+
+#define SOCKETS_htons(x)                    ((uint16_t)((((x) & 0xFFU) << 8) | (((x) >> 8) & 0xFFU)))
+
+
+/*******************************************************************************
+ * Data structure and enumeration
+ ******************************************************************************/
+typedef void *Socket_t;
+
+typedef struct
+{
+    uint8_t ucLength;
+    uint8_t ucSocketDomain;
+    uint16_t usPort;            /* Network byte order */
+    uint32_t ulAddress;         /* Network byte order */
+} SocketsSockaddr_t;
+
+
+/*******************************************************************************
+ * Function prototypes
+ ******************************************************************************/
+Socket_t SOCKETS_Socket(int32_t lDomain, int32_t lType, int32_t lProtocol);
+int32_t SOCKETS_Connect(Socket_t xSocket, SocketsSockaddr_t *pxAddress, uint32_t xAddressLength);
+int32_t SOCKETS_Send(Socket_t xSocket, const void *pvBuffer, size_t xDataLength, uint32_t ulFlags);
+int32_t SOCKETS_Recv(Socket_t xSocket, void *pvBuffer, size_t xBufferLength, uint32_t ulFlags);
+int32_t SOCKETS_Shutdown(Socket_t xSocket, uint32_t ulHow);
+int32_t SOCKETS_Close(Socket_t xSocket);
+int32_t SOCKETS_SetSockOpt(Socket_t xSocket, int32_t lLevel, int32_t lOptionName,
+                           const void *pvOptionValue, size_t xOptionLength);
+uint32_t SOCKETS_GetHostByName(const char *pcHostName);
+
+
+#endif /* SIM_PEER_IOT_SECURE_SOCKETS_H */
+
+
+/* [] END OF FILE */
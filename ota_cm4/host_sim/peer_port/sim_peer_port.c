@@ -0,0 +1,674 @@
+/******************************************************************************
+* File Name: sim_peer_port.c
+*
+* Description: This file implements the kernel and flash stand-ins of the host
+* LAN simulations: tasks are threads, mutexes are pthread mutexes, the heap is
+* the C heap, the tick is the monotonic clock in milliseconds and the
+* primary and secondary slots are in RAM. The datagrams received may be
+* dropped to model a lossy LAN.
+*
+* Related Document: See README.md
+*
+*******************************************************************************
+* (c) 2020, Cypress Semiconductor Corporation. All rights reserved.
+*******************************************************************************
+* This software, including source code, documentation and related materials
+* ("Software"), is owned by Cypress Semiconductor Corporation or one of its
+* subsidiaries ("Cypress") and is protected by and subject to worldwide patent
+* protection (United States and foreign), United States copyright laws and
+* international treaty provisions. Therefore, you may use this Software only
+* as provided in the license agreement accompanying the software package from
+* which you obtained this Software ("EULA").
+*
+* If no EULA applies, Cypress hereby grants you a personal, non-exclusive,
+* non-transferable license to copy, modify, and compile the Software source
+* code solely for use in connection with Cypress's integrated circuit products.
+* Any reproduction, modification, translation, compilation, or representation
+* of this Software except as specified above is prohibited without the express
+* written permission of Cypress.
+*
+* Disclaimer: THIS SOFTWARE IS PROVIDED AS-IS, WITH NO WARRANTY OF ANY KIND,
+* EXPRESS OR IMPLIED, INCLUDING, BUT NOT LIMITED TO, NONINFRINGEMENT, IMPLIED
+* WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE. Cypress
+* reserves the right to make changes to the Software without notice. Cypress
+* does not assume any liability arising out of the application or use of the
+* Software or any product or circuit described in the Software. Cypress does
+* not authorize its products for use in any products where a malfunction or
+* failure of the Cypress product may reasonably be expected to result in
+* significant property damage, injury or death ("High Risk Product"). By
+* including Cypress's product in a High Risk Product, the manufacturer of such
+* system or application assumes all risk of such use and in doing so agrees to
+* indemnify Cypress against all liability.
+*******************************************************************************/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdarg.h>
+#include <time.h>
+#include <pthread.h>
+#include <sys/types.h>
+#include <sys/socket.h>
+#include "FreeRTOS.h"
+#include "task.h"
+#include "semphr.h"
+#include "queue.h"
+#include "platform/iot_threads.h"
+#include "flash_map_backend/flash_map_backend.h"
+#include "sysflash/sysflash.h"
+#include "sim_peer_port.h"
+
+
+/*******************************************************************************
+ * Macros
+ ******************************************************************************/
+#define MS_PER_S                        (1000UL)
+#define NS_PER_MS                       (1000000UL)
+#define PERCENT                         (100U)
+
+
+/*******************************************************************************
+ * Data structure and enumeration
+ ******************************************************************************/
+typedef struct
+{
+    void (*task)(void *);
+    void *arg;
+} port_task_t;
+
+
+/*******************************************************************************
+ * Global variables
+ ******************************************************************************/
+static uint8_t *port_slot;
+static struct flash_area port_slot_area;
+static uint8_t *port_primary;
+static struct flash_area port_primary_area;
+static const struct flash_area *port_flash_area;
+static int (*port_flash_read)(const struct flash_area *fa, uint32_t off, void *dst, uint32_t len);
+static const char *port_name = "";
+static bool port_verbose;
+static pthread_mutex_t port_log_lock = PTHREAD_MUTEX_INITIALIZER;
+static uint32_t port_loss_pct;
+static uint32_t port_random = 1U;
+static pthread_mutex_t port_loss_lock = PTHREAD_MUTEX_INITIALIZER;
+static __thread char port_task_tag;     /* Its address identifies a thread */
+static pthread_mutex_t port_critical_lock = PTHREAD_MUTEX_INITIALIZER;
+
+
+/*******************************************************************************
+ * Function Name: sim_peer_port_init
+ *******************************************************************************
+ * Summary:
+ *  Sets the secondary slot of the device and the prefix of its log.
+ *
+ * Parameters:
+ *  slot - RAM secondary slot
+ *  slot_size - size of the slot
+ *  name - name of the device, printed before each log line
+ *  verbose - true to print the log
+ *
+ ******************************************************************************/
+void sim_peer_port_init(uint8_t *slot, uint32_t slot_size, const char *name, bool verbose)
+{
+    port_slot = slot;
+    port_slot_area.fa_id = FLASH_AREA_IMAGE_SECONDARY(0);
+    port_slot_area.fa_size = slot_size;
+    port_name = name;
+    port_verbose = verbose;
+}
+
+
+/*******************************************************************************
+ * Function Name: sim_peer_port_primary
+ *******************************************************************************
+ * Summary:
+ *  Sets the primary slot of the device, which holds the running image.
+ *
+ * Parameters:
+ *  slot - RAM primary slot
+ *  slot_size - size of the slot
+ *
+ ******************************************************************************/
+void sim_peer_port_primary(uint8_t *slot, uint32_t slot_size)
+{
+    port_primary = slot;
+    port_primary_area.fa_id = FLASH_AREA_IMAGE_PRIMARY(0);
+    port_primary_area.fa_size = slot_size;
+}
+
+
+/*******************************************************************************
+ * Function Name: sim_peer_port_flash
+ *******************************************************************************
+ * Summary:
+ *  Sets a flash area held by a flash model, such as the timed one of
+ *  sim_flash.c. It is opened in place of the RAM slot of the same ID. The
+ *  areas other than the RAM slots, such as the ones the OTA app opens itself,
+ *  are read through the model.
+ *
+ * Parameters:
+ *  fa - flash area of the model
+ *  read - read function of the model
+ *
+ ******************************************************************************/
+void sim_peer_port_flash(const struct flash_area *fa,
+                         int (*read)(const struct flash_area *fa, uint32_t off, void *dst,
+                                     uint32_t len))
+{
+    port_flash_area = fa;
+    port_flash_read = read;
+}
+
+
+/*******************************************************************************
+ * Function Name: sim_peer_log
+ ******************************************************************************/
+void sim_peer_log(const char *format, ...)
+{
+    va_list args;
+
+    if (!port_verbose)
+    {
+        return;
+    }
+
+    (void)pthread_mutex_lock(&port_log_lock);
+    (void)printf("[%s] ", port_name);
+    va_start(args, format);
+    (void)vprintf(format, args);
+    va_end(args);
+    (void)fflush(stdout);
+    (void)pthread_mutex_unlock(&port_log_lock);
+}
+
+
+/*******************************************************************************
+ * Function Name: sim_peer_port_loss
+ *******************************************************************************
+ * Summary:
+ *  Sets the loss of the datagrams received by the device.
+ *
+ * Parameters:
+ *  loss_pct - datagrams dropped, in percent
+ *  seed - seed of the drops, different for each device
+ *
+ ******************************************************************************/
+void sim_peer_port_loss(uint32_t loss_pct, uint32_t seed)
+{
+    port_loss_pct = loss_pct;
+    port_random = (0U == seed) ? 1U : seed;
+}
+
+
+/*******************************************************************************
+ * Function Name: sim_peer_port_recvfrom
+ *******************************************************************************
+ * Summary:
+ *  Receives a datagram, dropping --loss-pct of them. A datagram dropped is
+ *  replaced by the next one already queued, if any, so that the caller that
+ *  selected the socket does not block.
+ *
+ ******************************************************************************/
+ssize_t sim_peer_port_recvfrom(int sock, void *buffer, size_t len, int flags,
+                               struct sockaddr *from, socklen_t *from_len)
+{
+    while (true)
+    {
+        ssize_t got = recvfrom(sock, buffer, len, flags, from, from_len);
+        bool drop;
+
+        if (got < 0)
+        {
+            return got;
+        }
+
+        (void)pthread_mutex_lock(&port_loss_lock);
+        port_random ^= port_random << 13;
+        port_random ^= port_random >> 17;
+        port_random ^= port_random << 5;
+        drop = (port_random % PERCENT) < port_loss_pct;
+        (void)pthread_mutex_unlock(&port_loss_lock);
+
+        if (!drop)
+        {
+            return got;
+        }
+
+        flags |= MSG_DONTWAIT;
+    }
+}
+
+
+/*******************************************************************************
+ * Function Name: pvPortMalloc
+ ******************************************************************************/
+void *pvPortMalloc(size_t size)
+{
+    return malloc(size);
+}
+
+
+/*******************************************************************************
+ * Function Name: vPortFree
+ ******************************************************************************/
+void vPortFree(void *p)
+{
+    free(p);
+}
+
+
+/*******************************************************************************
+ * Function Name: port_task_main
+ ******************************************************************************/
+static void *port_task_main(void *arg)
+{
+    port_task_t task = *(port_task_t *)arg;
+
+    free(arg);
+    task.task(task.arg);
+
+    return NULL;
+}
+
+
+/*******************************************************************************
+ * Function Name: xTaskCreate
+ ******************************************************************************/
+BaseType_t xTaskCreate(void (*task)(void *), const char *name, uint32_t stack_depth,
+                       void *arg, UBaseType_t priority, TaskHandle_t *handle)
+{
+    port_task_t *start = malloc(sizeof(*start));
+    pthread_t thread;
+
+    (void)name;
+    (void)stack_depth;
+    (void)priority;
+
+    if (NULL == start)
+    {
+        return pdFAIL;
+    }
+
+    start->task = task;
+    start->arg = arg;
+
+    if (0 != pthread_create(&thread, NULL, port_task_main, start))
+    {
+        free(start);
+        return pdFAIL;
+    }
+
+    (void)pthread_detach(thread);
+
+    if (NULL != handle)
+    {
+        *handle = NULL;
+    }
+
+    return pdPASS;
+}
+
+
+/*******************************************************************************
+ * Function Name: vTaskDelete
+ *******************************************************************************
+ * Summary:
+ *  Ends the calling task. Only a task can delete itself here.
+ *
+ ******************************************************************************/
+void vTaskDelete(TaskHandle_t task)
+{
+    (void)task;
+    pthread_exit(NULL);
+}
+
+
+/*******************************************************************************
+ * Function Name: vTaskDelay
+ ******************************************************************************/
+void vTaskDelay(TickType_t ticks)
+{
+    struct timespec ts;
+
+    ts.tv_sec = (time_t)(ticks / MS_PER_S);
+    ts.tv_nsec = (long)((ticks % MS_PER_S) * NS_PER_MS);
+    (void)nanosleep(&ts, NULL);
+}
+
+
+/*******************************************************************************
+ * Function Name: xTaskGetTickCount
+ ******************************************************************************/
+TickType_t xTaskGetTickCount(void)
+{
+    struct timespec ts;
+
+    (void)clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    return (TickType_t)(((uint64_t)ts.tv_sec * MS_PER_S) + ((uint64_t)ts.tv_nsec / NS_PER_MS));
+}
+
+
+/*******************************************************************************
+ * Function Name: xTaskGetCurrentTaskHandle
+ *******************************************************************************
+ * Summary:
+ *  Returns a handle that identifies the calling thread. It is not the handle
+ *  returned by xTaskCreate(), which is always NULL here.
+ *
+ ******************************************************************************/
+TaskHandle_t xTaskGetCurrentTaskHandle(void)
+{
+    return &port_task_tag;
+}
+
+
+/*******************************************************************************
+ * Function Name: Iot_CreateDetachedThread
+ ******************************************************************************/
+bool Iot_CreateDetachedThread(IotThreadRoutine_t threadRoutine, void *pArgument,
+                              int32_t priority, size_t stackSize)
+{
+    return pdPASS == xTaskCreate(threadRoutine, "iot", (uint32_t)stackSize, pArgument,
+                                 (UBaseType_t)priority, NULL);
+}
+
+
+/*******************************************************************************
+ * Function Name: xSemaphoreCreateMutexStatic
+ ******************************************************************************/
+SemaphoreHandle_t xSemaphoreCreateMutexStatic(StaticSemaphore_t *buffer)
+{
+    (void)pthread_mutex_init(&buffer->mutex, NULL);
+    buffer->binary = false;
+
+    return buffer;
+}
+
+
+/*******************************************************************************
+ * Function Name: xSemaphoreCreateBinaryStatic
+ *******************************************************************************
+ * Summary:
+ *  Creates a binary semaphore, empty as in FreeRTOS.
+ *
+ ******************************************************************************/
+SemaphoreHandle_t xSemaphoreCreateBinaryStatic(StaticSemaphore_t *buffer)
+{
+    (void)pthread_mutex_init(&buffer->mutex, NULL);
+    (void)pthread_cond_init(&buffer->cond, NULL);
+    buffer->binary = true;
+    buffer->given = false;
+
+    return buffer;
+}
+
+
+/*******************************************************************************
+ * Function Name: xSemaphoreTake
+ *******************************************************************************
+ * Summary:
+ *  Takes a mutex, or waits for a binary semaphore to be given. Only
+ *  portMAX_DELAY is used by the simulated code.
+ *
+ ******************************************************************************/
+BaseType_t xSemaphoreTake(SemaphoreHandle_t semaphore, TickType_t ticks)
+{
+    (void)ticks;
+
+    if (!semaphore->binary)
+    {
+        return (0 == pthread_mutex_lock(&semaphore->mutex)) ? pdPASS : pdFAIL;
+    }
+
+    (void)pthread_mutex_lock(&semaphore->mutex);
+    while (!semaphore->given)
+    {
+        (void)pthread_cond_wait(&semaphore->cond, &semaphore->mutex);
+    }
+    semaphore->given = false;
+    (void)pthread_mutex_unlock(&semaphore->mutex);
+
+    return pdPASS;
+}
+
+
+/*******************************************************************************
+ * Function Name: xSemaphoreGive
+ ******************************************************************************/
+BaseType_t xSemaphoreGive(SemaphoreHandle_t semaphore)
+{
+    if (!semaphore->binary)
+    {
+        return (0 == pthread_mutex_unlock(&semaphore->mutex)) ? pdPASS : pdFAIL;
+    }
+
+    (void)pthread_mutex_lock(&semaphore->mutex);
+    semaphore->given = true;
+    (void)pthread_cond_signal(&semaphore->cond);
+    (void)pthread_mutex_unlock(&semaphore->mutex);
+
+    return pdPASS;
+}
+
+
+/*******************************************************************************
+ * Function Name: vPortEnterCritical
+ *******************************************************************************
+ * Summary:
+ *  Enters a critical section. It only excludes the other critical sections,
+ *  which is all the simulated code relies on.
+ *
+ ******************************************************************************/
+void vPortEnterCritical(void)
+{
+    (void)pthread_mutex_lock(&port_critical_lock);
+}
+
+
+/*******************************************************************************
+ * Function Name: vPortExitCritical
+ ******************************************************************************/
+void vPortExitCritical(void)
+{
+    (void)pthread_mutex_unlock(&port_critical_lock);
+}
+
+
+/*******************************************************************************
+ * Function Name: port_queue_wait
+ *******************************************************************************
+ * Summary:
+ *  Waits for a change of a queue, locked by the caller.
+ *
+ * Parameters:
+ *  queue - queue
+ *  ticks - 0 to poll, portMAX_DELAY to wait forever, else the longest wait
+ *  deadline - end of the wait, set on the first call
+ *  first - true on the first call
+ *
+ * Return:
+ *  bool - false when the wait times out
+ *
+ ******************************************************************************/
+static bool port_queue_wait(QueueHandle_t queue, TickType_t ticks, struct timespec *deadline,
+                            bool first)
+{
+    if (0U == ticks)
+    {
+        return false;
+    }
+
+    if (portMAX_DELAY == ticks)
+    {
+        (void)pthread_cond_wait(&queue->cond, &queue->mutex);
+        return true;
+    }
+
+    if (first)
+    {
+        (void)clock_gettime(CLOCK_REALTIME, deadline);
+        deadline->tv_sec += (time_t)(ticks / MS_PER_S);
+        deadline->tv_nsec += (long)((ticks % MS_PER_S) * NS_PER_MS);
+        if (deadline->tv_nsec >= (long)(MS_PER_S * NS_PER_MS))
+        {
+            deadline->tv_sec++;
+            deadline->tv_nsec -= (long)(MS_PER_S * NS_PER_MS);
+        }
+    }
+
+    return 0 == pthread_cond_timedwait(&queue->cond, &queue->mutex, deadline);
+}
+
+
+/*******************************************************************************
+ * Function Name: xQueueCreateStatic
+ ******************************************************************************/
+QueueHandle_t xQueueCreateStatic(UBaseType_t length, UBaseType_t item_size, uint8_t *storage,
+                                 StaticQueue_t *buffer)
+{
+    (void)pthread_mutex_init(&buffer->mutex, NULL);
+    (void)pthread_cond_init(&buffer->cond, NULL);
+    buffer->storage = storage;
+    buffer->length = length;
+    buffer->item_size = item_size;
+    buffer->head = 0U;
+    buffer->count = 0U;
+
+    return buffer;
+}
+
+
+/*******************************************************************************
+ * Function Name: xQueueSend
+ ******************************************************************************/
+BaseType_t xQueueSend(QueueHandle_t queue, const void *item, TickType_t ticks)
+{
+    struct timespec deadline;
+    bool first = true;
+
+    (void)pthread_mutex_lock(&queue->mutex);
+    while (queue->count == queue->length)
+    {
+        if (!port_queue_wait(queue, ticks, &deadline, first))
+        {
+            (void)pthread_mutex_unlock(&queue->mutex);
+            return pdFAIL;
+        }
+        first = false;
+    }
+
+    memcpy(&queue->storage[((queue->head + queue->count) % queue->length) * queue->item_size],
+           item, queue->item_size);
+    queue->count++;
+    (void)pthread_cond_broadcast(&queue->cond);
+    (void)pthread_mutex_unlock(&queue->mutex);
+
+    return pdPASS;
+}
+
+
+/*******************************************************************************
+ * Function Name: xQueueReceive
+ ******************************************************************************/
+BaseType_t xQueueReceive(QueueHandle_t queue, void *item, TickType_t ticks)
+{
+    struct timespec deadline;
+    bool first = true;
+
+    (void)pthread_mutex_lock(&queue->mutex);
+    while (0U == queue->count)
+    {
+        if (!port_queue_wait(queue, ticks, &deadline, first))
+        {
+            (void)pthread_mutex_unlock(&queue->mutex);
+            return pdFAIL;
+        }
+        first = false;
+    }
+
+    memcpy(item, &queue->storage[queue->head * queue->item_size], queue->item_size);
+    queue->head = (queue->head + 1U) % queue->length;
+    queue->count--;
+    (void)pthread_cond_broadcast(&queue->cond);
+    (void)pthread_mutex_unlock(&queue->mutex);
+
+    return pdPASS;
+}
+
+
+/*******************************************************************************
+ * Function Name: uxQueueMessagesWaiting
+ ******************************************************************************/
+UBaseType_t uxQueueMessagesWaiting(QueueHandle_t queue)
+{
+    UBaseType_t count;
+
+    (void)pthread_mutex_lock(&queue->mutex);
+    count = queue->count;
+    (void)pthread_mutex_unlock(&queue->mutex);
+
+    return count;
+}
+
+
+/*******************************************************************************
+ * Function Name: flash_area_open
+ ******************************************************************************/
+int flash_area_open(uint8_t id, const struct flash_area **fa)
+{
+    if ((NULL != port_flash_area) && (port_flash_area->fa_id == id))
+    {
+        *fa = port_flash_area;
+        return 0;
+    }
+
+    if ((FLASH_AREA_IMAGE_PRIMARY(0) == id) && (NULL != port_primary))
+    {
+        *fa = &port_primary_area;
+        return 0;
+    }
+
+    if ((FLASH_AREA_IMAGE_SECONDARY(0) != id) || (NULL == port_slot))
+    {
+        return -1;
+    }
+
+    *fa = &port_slot_area;
+
+    return 0;
+}
+
+
+/*******************************************************************************
+ * Function Name: flash_area_close
+ ******************************************************************************/
+void flash_area_close(const struct flash_area *fa)
+{
+    (void)fa;
+}
+
+
+/*******************************************************************************
+ * Function Name: flash_area_read
+ ******************************************************************************/
+int flash_area_read(const struct flash_area *fa, uint32_t off, void *dst, uint32_t len)
+{
+    if ((NULL != port_flash_read) && (fa != &port_slot_area) && (fa != &port_primary_area))
+    {
+        return port_flash_read(fa, off, dst, len);
+    }
+
+    if (((fa != &port_slot_area) && (fa != &port_primary_area)) ||
+        (off > fa->fa_size) || (len > (fa->fa_size - off)))
+    {
+        return -1;
+    }
+
+    memcpy(dst, (fa == &port_primary_area) ? &port_primary[off] : &port_slot[off], len);
+
+    return 0;
+}
+
+
+/* [] END OF FILE */
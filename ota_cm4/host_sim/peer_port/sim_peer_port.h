@@ -0,0 +1,62 @@
+/******************************************************************************
+* File Name: sim_peer_port.h
+*
+* Description: This file contains the function declarations of the kernel and
+* flash stand-ins of the host LAN simulations.
+*
+* Related Document: See README.md
+*
+*******************************************************************************
+* (c) 2020, Cypress Semiconductor Corporation. All rights reserved.
+*******************************************************************************
+* This software, including source code, documentation and related materials
+* ("Software"), is owned by Cypress Semiconductor Corporation or one of its
+* subsidiaries ("Cypress") and is protected by and subject to worldwide patent
+* protection (United States and foreign), United States copyright laws and
+* international treaty provisions. Therefore, you may use this Software only
+* as provided in the license agreement accompanying the software package from
+* which you obtained this Software ("EULA").
+*
+* If no EULA applies, Cypress hereby grants you a personal, non-exclusive,
+* non-transferable license to copy, modify, and compile the Software source
+* code solely for use in connection with Cypress's integrated circuit products.
+* Any reproduction, modification, translation, compilation, or representation
+* of this Software except as specified above is prohibited without the express
+* written permission of Cypress.
+*
+* Disclaimer: THIS SOFTWARE IS PROVIDED AS-IS, WITH NO WARRANTY OF ANY KIND,
+* EXPRESS OR IMPLIED, INCLUDING, BUT NOT LIMITED TO, NONINFRINGEMENT, IMPLIED
+* WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE. Cypress
+* reserves the right to make changes to the Software without notice. Cypress
+* does not assume any liability arising out of the application or use of the
+* Software or any product or circuit described in the Software. Cypress does
+* not authorize its products for use in any products where a malfunction or
+* failure of the Cypress product may reasonably be expected to result in
+* significant property damage, injury or death ("High Risk Product"). By
+* including Cypress's product in a High Risk Product, the manufacturer of such
+* system or application assumes all risk of such use and in doing so agrees to
+* indemnify Cypress against all liability.
+*******************************************************************************/
+#ifndef SIM_PEER_PORT_H
+#define SIM_PEER_PORT_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "flash_map_backend/flash_map_backend.h"
+
+
+/*******************************************************************************
+ * Function prototypes
+ ******************************************************************************/
+void sim_peer_port_init(uint8_t *slot, uint32_t slot_size, const char *name, bool verbose);
+void sim_peer_port_primary(uint8_t *slot, uint32_t slot_size);
+void sim_peer_port_loss(uint32_t loss_pct, uint32_t seed);
+void sim_peer_port_flash(const struct flash_area *fa,
+                         int (*read)(const struct flash_area *fa, uint32_t off, void *dst,
+                                     uint32_t len));
+
+
+#endif /* SIM_PEER_PORT_H */
+
+
+/* [] END OF FILE */
@@ -0,0 +1,1377 @@
+/******************************************************************************
+* File Name: sim_block_size.c
+*
+* Description: Host simulation of the block stream of the OTA app
+* (sources/ota_block_size.c) in virtual time. The stream requests and
+* responses of the OTA agent go through the wrappers of ota_block_size.c, as
+* on the device, against a stream server that answers each request with the
+* blocks of its bitmap, in the block size of the request, over a link of
+* --down-kbps and --rtt-ms that drops --loss-pct of the blocks. The agent
+* model requests otaconfigMAX_NUM_BLOCKS_REQUEST blocks at a time, asks again
+* after otaconfigFILE_REQUEST_WAIT_MS without a request, and checks each block
+* it ingests as the agent does. With --fixed, the agent runs without the
+* wrappers, in blocks of 2^otaconfigLOG2_FILE_BLOCK_SIZE bytes. Built with
+* CY_OTA_BLOCK_WINDOW, the requests follow the window of ota_block_window.c,
+* whose retransmit timer runs in the same virtual time. --stall-every-ms and
+* --stall-ms hold the link for a while at regular intervals, as a congested
+* access point does: the blocks sent meanwhile arrive once the stall ends.
+* --tcp-wnd limits the stream to one TCP window of the device per round trip,
+* as the one MQTT connection is.
+*
+* Built with CY_OTA_METRICS, the metrics of ota_metrics.c record the transfer
+* as on the device, with the tick count in the same virtual time and a cycle
+* counter that advances by the program time of each block written. The
+* summary published with the next job status update is printed with the
+* counts of the simulation to check it against, and with the host time of
+* the metrics calls of one block.
+*
+* Built with CY_OTA_MQTT_COEXIST, an application task publishes at QoS 1
+* every --publish-ms through the wrappers of ota_mqtt_coexist.c, which pace
+* the requests. The PUBACK of each publish comes back after half the round
+* trip, behind the blocks already on the link. The latency of the
+* application publishes is printed with the pacing of the coexistence;
+* --no-pacing publishes around the wrappers, as without the option.
+*
+* The simulation prints the time to receive the file, the requests, the blocks
+* and bytes received, and the blocks of each size as key=value lines, and
+* fails if the received file differs from the image.
+*
+* Related Document: See README.md
+*
+*******************************************************************************
+* (c) 2020, Cypress Semiconductor Corporation. All rights reserved.
+*******************************************************************************
+* This software, including source code, documentation and related materials
+* ("Software"), is owned by Cypress Semiconductor Corporation or one of its
+* subsidiaries ("Cypress") and is protected by and subject to worldwide patent
+* protection (United States and foreign), United States copyright laws and
+* international treaty provisions. Therefore, you may use this Software only
+* as provided in the license agreement accompanying the software package from
+* which you obtained this Software ("EULA").
+*
+* If no EULA applies, Cypress hereby grants you a personal, non-exclusive,
+* non-transferable license to copy, modify, and compile the Software source
+* code solely for use in connection with Cypress's integrated circuit products.
+* Any reproduction, modification, translation, compilation, or representation
+* of this Software except as specified above is prohibited without the express
+* written permission of Cypress.
+*
+* Disclaimer: THIS SOFTWARE IS PROVIDED AS-IS, WITH NO WARRANTY OF ANY KIND,
+* EXPRESS OR IMPLIED, INCLUDING, BUT NOT LIMITED TO, NONINFRINGEMENT, IMPLIED
+* WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE. Cypress
+* reserves the right to make changes to the Software without notice. Cypress
+* does not assume any liability arising out of the application or use of the
+* Software or any product or circuit described in the Software. Cypress does
+* not authorize its products for use in any products where a malfunction or
+* failure of the Cypress product may reasonably be expected to result in
+* significant property damage, injury or death ("High Risk Product"). By
+* including Cypress's product in a High Risk Product, the manufacturer of such
+* system or application assumes all risk of such use and in doing so agrees to
+* indemnify Cypress against all liability.
+*******************************************************************************/
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdarg.h>
+#include <string.h>
+#include <getopt.h>
+#include "FreeRTOS.h"
+#include "task.h"
+#include "aws_iot_ota_agent.h"
+#include "aws_iot_ota_pal.h"
+#include "aws_iot_ota_agent_internal.h"
+#include "timers.h"
+#include "ota_block_size.h"
+
+#if defined(CY_OTA_METRICS)
+#include <time.h>
+#include "cy_pdl.h"
+#include "iot_mqtt.h"
+#include "ota_metrics.h"
+#endif
+
+#if defined(CY_OTA_MQTT_COEXIST)
+#include "iot_mqtt.h"
+#include "ota_mqtt_coexist.h"
+#endif
+
+
+/*******************************************************************************
+ * Macros
+ ******************************************************************************/
+/* 1 MB and one unit: the last block of two units is one unit long */
+#define SIM_DEFAULT_SIZE                ((1024U * 1024U) + OTA_BLOCK_UNIT_SIZE)
+#define SIM_DEFAULT_SEED                (1U)
+#define SIM_DEFAULT_DOWN_KBPS           (4000U)
+#define SIM_DEFAULT_RTT_MS              (80U)
+#define SIM_DEFAULT_LOSS_PCT            (1U)
+#define SIM_DEFAULT_HEAP                (60000U)
+#define SIM_DEFAULT_TIMEOUT_S           (3600U)
+
+/* Software timers of the OTA app run in the virtual time */
+#define SIM_TIMERS                      (4U)
+
+/* Bytes of MQTT, TLS and TCP/IP around the payload of a streamed block */
+#define SIM_BLOCK_OVERHEAD              (160U)
+
+#define SIM_MESSAGE_SIZE                (512U)
+#define SIM_CLIENT_TOKEN                "rdy"
+
+#if defined(CY_OTA_METRICS)
+#define SIM_THING_NAME                  "sim-thing"
+#define SIM_JOB_NAME                    "sim-job"
+#define SIM_CORE_CLOCK_HZ               (100000000UL)   /* CM4 of the kits */
+#define SIM_CYCLES_PER_US               (SIM_CORE_CLOCK_HZ / 1000000UL)
+#define SIM_PAGE_SIZE                   (512U)          /* S25FL512S page, typical time */
+#define SIM_PAGE_US                     (340U)
+#define SIM_SUMMARY_SIZE                (1024U)
+#define SIM_BENCH_BLOCKS                (1000000U)
+#define NS_PER_S                        (1000000000ULL)
+#endif
+
+#if defined(CY_OTA_MQTT_COEXIST)
+#define SIM_DEFAULT_PUBLISH_MS          (200U)
+#define SIM_PUBLISHES                   (16U)           /* Waiting for their PUBACK */
+#define SIM_PUBACK_SIZE                 (4U)
+#define SIM_PUBLISH_TOPIC               "sim/telemetry"
+#define SIM_PUBLISH_PAYLOAD             "{\"temperature\":25}"
+#endif
+
+#define PERCENT                         (100U)
+#define US_PER_MS                       (1000ULL)
+#define BITS_PER_BYTE                   (8U)
+
+#define EXIT_USAGE                      (2)
+
+
+/*******************************************************************************
+ * Data structure and enumeration
+ ******************************************************************************/
+/* A streamed block on its way to the device */
+typedef struct
+{
+    TickType_t arrival;
+    uint32_t block_id;
+    uint32_t block_size;
+    uint32_t offset;
+    uint32_t size;
+} sim_packet_t;
+
+#if defined(CY_OTA_MQTT_COEXIST)
+/* A publish of the device waiting for its PUBACK */
+typedef struct
+{
+    bool used;
+    TickType_t arrival;
+    IotMqttCallbackInfo_t callback;
+} sim_publish_t;
+#endif
+
+
+/*******************************************************************************
+ * Function prototypes
+ ******************************************************************************/
+bool __wrap_OTA_CBOR_Encode_GetStreamRequestMessage(uint8_t *pucMessageBuffer,
+        size_t xMessageBufferSize, size_t *pxEncodedMessageSize,
+        const char *pcClientToken, int32_t lFileId, int32_t lBlockSize,
+        int32_t lBlockOffset, uint8_t *pucBlockBitmap, size_t xBlockBitmapSize,
+        int32_t lNumOfBlocksRequested);
+bool __wrap_OTA_CBOR_Decode_GetStreamResponseMessage(const uint8_t *pucMessageBuffer,
+        size_t xMessageSize, int32_t *plFileId, int32_t *plBlockId,
+        int32_t *plBlockSize, uint8_t **ppucPayload, size_t *pxPayloadSize);
+#if defined(CY_OTA_METRICS)
+OTA_Err_t __wrap__AwsIotOTA_UpdateJobStatus_Mqtt(OTA_AgentContext_t *pxAgentCtx,
+        OTA_JobStatus_t eStatus, int32_t lReason, int32_t lSubReason);
+#endif
+#if defined(CY_OTA_MQTT_COEXIST)
+IotMqttError_t __wrap_IotMqtt_PublishAsync(IotMqttConnection_t mqttConnection,
+                                           const IotMqttPublishInfo_t *pPublishInfo,
+                                           uint32_t flags,
+                                           const IotMqttCallbackInfo_t *pCallbackInfo,
+                                           IotMqttOperation_t *const pPublishOperation);
+#endif
+
+
+/*******************************************************************************
+ * Global variables
+ ******************************************************************************/
+static const struct option sim_options[] =
+{
+    { "size",                   required_argument, NULL, 's' },
+    { "seed",                   required_argument, NULL, 'S' },
+    { "down-kbps",              required_argument, NULL, 'd' },
+    { "rtt-ms",                 required_argument, NULL, 'r' },
+    { "loss-pct",               required_argument, NULL, 'l' },
+    { "heap",                   required_argument, NULL, 'H' },
+    { "timeout-s",              required_argument, NULL, 'T' },
+    { "stall-every-ms",         required_argument, NULL, 'P' },
+    { "stall-ms",               required_argument, NULL, 'D' },
+    { "tcp-wnd",                required_argument, NULL, 'w' },
+    { "fixed",                  no_argument,       NULL, 'f' },
+#if defined(CY_OTA_MQTT_COEXIST)
+    { "publish-ms",             required_argument, NULL, 'p' },
+    { "no-pacing",              no_argument,       NULL, 'n' },
+#endif
+    { "verbose",                no_argument,       NULL, 'v' },
+    { "help",                   no_argument,       NULL, 'h' },
+    { NULL,                     0,                 NULL, 0 }
+};
+
+static uint32_t image_size = SIM_DEFAULT_SIZE;
+static uint64_t seed = SIM_DEFAULT_SEED;
+static uint32_t down_kbps = SIM_DEFAULT_DOWN_KBPS;
+static uint32_t rtt_ms = SIM_DEFAULT_RTT_MS;
+static uint32_t loss_pct = SIM_DEFAULT_LOSS_PCT;
+static uint32_t free_heap = SIM_DEFAULT_HEAP;
+static uint32_t timeout_s = SIM_DEFAULT_TIMEOUT_S;
+static uint32_t stall_every_ms;
+static uint32_t stall_ms;
+static uint32_t tcp_wnd;
+static bool fixed;
+static bool verbose;
+
+static uint8_t *image;
+static uint8_t *received;
+static OTA_FileContext_t file_ctx;
+static TickType_t now;
+static uint64_t rng_state;
+
+/* Stream server and link. The blocks reach the device in the order they
+ * are queued: delivered blocks are before packets_head.
+ */
+static sim_packet_t *packets;
+static size_t packets_head;
+static size_t packets_count;
+static size_t packets_max;
+static uint64_t link_free_us;           /* End of the last block on the link */
+static const sim_packet_t *current;     /* Block being decoded */
+static uint64_t last_stall;             /* Stall that held the last block */
+static uint32_t stalls;
+
+static TimerHandle_t timers[SIM_TIMERS];
+static uint32_t timers_count;
+
+/* Agent */
+static uint32_t blocks_to_receive;
+static TickType_t request_deadline;
+static uint32_t momentum;
+static bool request_pending;
+static bool aborted;
+
+/* Results */
+static uint32_t requests;
+static uint32_t blocks;
+static uint32_t duplicates;
+static uint32_t lost;                   /* Blocks dropped on the link */
+static uint32_t timeouts;               /* Requests sent by the request timer */
+static uint64_t down_bytes;
+static uint32_t blocks_of_size[otaconfigMAX_FILE_BLOCK_UNITS + 1U];
+
+#if defined(CY_OTA_METRICS)
+DWT_Type sim_dwt;
+CoreDebug_Type sim_core_debug;
+uint32_t SystemCoreClock = SIM_CORE_CLOCK_HZ;
+
+static uint64_t write_us;               /* Program time of the blocks written */
+static uint32_t summaries;
+static char summary[SIM_SUMMARY_SIZE];
+static size_t summary_len;
+#endif
+
+#if defined(CY_OTA_MQTT_COEXIST)
+static uint32_t publish_ms = SIM_DEFAULT_PUBLISH_MS;
+static bool no_pacing;
+
+/* Tasks of the device: the agent runs the transfer, the application
+ * publishes.
+ */
+static uint8_t ota_task;
+static uint8_t app_task;
+static TaskHandle_t current_task = &ota_task;
+
+static sim_publish_t publishes[SIM_PUBLISHES];
+static uint32_t app_publishes;
+static uint32_t app_refused;            /* No PUBACK slot left */
+static uint32_t *app_latency;           /* Milliseconds, per PUBACK received */
+static size_t app_latency_count;
+static size_t app_latency_max;
+#endif
+
+
+/*******************************************************************************
+ * Function Name: sim_random
+ *******************************************************************************
+ * Summary:
+ *  xorshift64 generator of the image and of the drops.
+ *
+ ******************************************************************************/
+static uint32_t sim_random(void)
+{
+    rng_state ^= rng_state << 13;
+    rng_state ^= rng_state >> 7;
+    rng_state ^= rng_state << 17;
+
+    return (uint32_t)(rng_state >> 32);
+}
+
+
+/*******************************************************************************
+ * Function Name: xTaskGetTickCount
+ ******************************************************************************/
+TickType_t xTaskGetTickCount(void)
+{
+    return now;
+}
+
+
+/*******************************************************************************
+ * Function Name: xPortGetFreeHeapSize
+ ******************************************************************************/
+size_t xPortGetFreeHeapSize(void)
+{
+    return free_heap;
+}
+
+
+/*******************************************************************************
+ * Function Name: pvPortMalloc
+ ******************************************************************************/
+void *pvPortMalloc(size_t size)
+{
+    return malloc(size);
+}
+
+
+/*******************************************************************************
+ * Function Name: vPortFree
+ ******************************************************************************/
+void vPortFree(void *p)
+{
+    free(p);
+}
+
+
+/*******************************************************************************
+ * Function Name: sim_peer_log
+ *******************************************************************************
+ * Summary:
+ *  Log of the OTA app, printed with --verbose.
+ *
+ ******************************************************************************/
+void sim_peer_log(const char *format, ...)
+{
+    va_list args;
+
+    if (!verbose)
+    {
+        return;
+    }
+
+    va_start(args, format);
+    printf("[%8u] ", (unsigned int)now);
+    vprintf(format, args);
+    va_end(args);
+}
+
+
+#if defined(CY_OTA_METRICS) || defined(CY_OTA_MQTT_COEXIST)
+/*******************************************************************************
+ * Function Name: vPortEnterCritical
+ *******************************************************************************
+ * Summary:
+ *  The simulation runs in one thread: nothing to exclude.
+ *
+ ******************************************************************************/
+void vPortEnterCritical(void)
+{
+}
+
+
+/*******************************************************************************
+ * Function Name: vPortExitCritical
+ ******************************************************************************/
+void vPortExitCritical(void)
+{
+}
+#endif /* CY_OTA_METRICS || CY_OTA_MQTT_COEXIST */
+
+
+#if defined(CY_OTA_METRICS)
+/*******************************************************************************
+ * Function Name: IotMqtt_TimedPublish
+ *******************************************************************************
+ * Summary:
+ *  Keeps the summary published by the metrics.
+ *
+ ******************************************************************************/
+IotMqttError_t IotMqtt_TimedPublish(IotMqttConnection_t mqttConnection,
+                                    const IotMqttPublishInfo_t *pPublishInfo,
+                                    uint32_t flags, uint32_t timeoutMs)
+{
+    (void)mqttConnection;
+    (void)flags;
+    (void)timeoutMs;
+
+    summaries++;
+    summary_len = (pPublishInfo->payloadLength < sizeof(summary)) ?
+                  pPublishInfo->payloadLength : (sizeof(summary) - 1U);
+    memcpy(summary, pPublishInfo->pPayload, summary_len);
+    summary[summary_len] = '\0';
+
+    return IOT_MQTT_SUCCESS;
+}
+
+
+/*******************************************************************************
+ * Function Name: __real__AwsIotOTA_UpdateJobStatus_Mqtt
+ ******************************************************************************/
+OTA_Err_t __real__AwsIotOTA_UpdateJobStatus_Mqtt(OTA_AgentContext_t *pxAgentCtx,
+        OTA_JobStatus_t eStatus, int32_t lReason, int32_t lSubReason)
+{
+    (void)pxAgentCtx;
+    (void)eStatus;
+    (void)lReason;
+    (void)lSubReason;
+
+    return kOTA_Err_None;
+}
+#endif /* CY_OTA_METRICS */
+
+
+/*******************************************************************************
+ * Function Name: xTimerCreateStatic
+ ******************************************************************************/
+TimerHandle_t xTimerCreateStatic(const char *name, TickType_t period, UBaseType_t auto_reload,
+                                 void *id, TimerCallbackFunction_t callback,
+                                 StaticTimer_t *buffer)
+{
+    (void)name;
+    (void)auto_reload;
+    (void)id;
+
+    if (timers_count == SIM_TIMERS)
+    {
+        return NULL;
+    }
+
+    buffer->callback = callback;
+    buffer->period = period;
+    buffer->active = false;
+    timers[timers_count++] = buffer;
+
+    return buffer;
+}
+
+
+/*******************************************************************************
+ * Function Name: xTimerChangePeriod
+ *******************************************************************************
+ * Summary:
+ *  Sets the period of a timer and starts it, as FreeRTOS does.
+ *
+ ******************************************************************************/
+BaseType_t xTimerChangePeriod(TimerHandle_t timer, TickType_t period, TickType_t wait)
+{
+    (void)wait;
+
+    timer->period = period;
+    timer->deadline = now + period;
+    timer->active = true;
+
+    return pdPASS;
+}
+
+
+/*******************************************************************************
+ * Function Name: xTimerStop
+ ******************************************************************************/
+BaseType_t xTimerStop(TimerHandle_t timer, TickType_t wait)
+{
+    (void)wait;
+
+    timer->active = false;
+
+    return pdPASS;
+}
+
+
+/*******************************************************************************
+ * Function Name: timers_run
+ *******************************************************************************
+ * Summary:
+ *  Runs the callbacks of the one-shot timers that expire now.
+ *
+ ******************************************************************************/
+static void timers_run(void)
+{
+    for (uint32_t i = 0U; i < timers_count; i++)
+    {
+        if (timers[i]->active && (now >= timers[i]->deadline))
+        {
+            timers[i]->active = false;
+            timers[i]->callback(timers[i]);
+        }
+    }
+}
+
+
+/*******************************************************************************
+ * Function Name: link_time_us
+ *******************************************************************************
+ * Summary:
+ *  Returns the time a block takes on the link: at --down-kbps, and at most
+ *  one --tcp-wnd per round trip.
+ *
+ ******************************************************************************/
+static uint64_t link_time_us(uint32_t size)
+{
+    uint64_t time_us = ((uint64_t)size * BITS_PER_BYTE * US_PER_MS) / down_kbps;
+    uint64_t window_us = (0U != tcp_wnd) ? (((uint64_t)size * rtt_ms * US_PER_MS) / tcp_wnd) : 0U;
+
+    return (window_us > time_us) ? window_us : time_us;
+}
+
+
+/*******************************************************************************
+ * Function Name: link_stall_end
+ *******************************************************************************
+ * Summary:
+ *  Returns the time from which the link sends again, for a block that would
+ *  start at the given time.
+ *
+ ******************************************************************************/
+static uint64_t link_stall_end(uint64_t start_us)
+{
+    uint64_t period_us = (uint64_t)stall_every_ms * US_PER_MS;
+    uint64_t phase_us;
+
+    if ((0U == stall_every_ms) || (0U == stall_ms))
+    {
+        return start_us;
+    }
+
+    phase_us = start_us % period_us;
+    if ((start_us < period_us) || (phase_us >= ((uint64_t)stall_ms * US_PER_MS)))
+    {
+        return start_us;
+    }
+
+    if ((start_us / period_us) != last_stall)
+    {
+        last_stall = start_us / period_us;
+        stalls++;
+    }
+
+    return start_us - phase_us + ((uint64_t)stall_ms * US_PER_MS);
+}
+
+
+#if defined(CY_OTA_MQTT_COEXIST)
+/*******************************************************************************
+ * Function Name: xTaskGetCurrentTaskHandle
+ ******************************************************************************/
+TaskHandle_t xTaskGetCurrentTaskHandle(void)
+{
+    return current_task;
+}
+
+
+/*******************************************************************************
+ * Function Name: __real_IotMqtt_PublishAsync
+ *******************************************************************************
+ * Summary:
+ *  MQTT library and broker: the publish reaches the broker after half the
+ *  round trip, and its PUBACK is queued on the link behind the blocks
+ *  already sent, reaching the device after the other half.
+ *
+ ******************************************************************************/
+IotMqttError_t __real_IotMqtt_PublishAsync(IotMqttConnection_t mqttConnection,
+                                           const IotMqttPublishInfo_t *pPublishInfo,
+                                           uint32_t flags,
+                                           const IotMqttCallbackInfo_t *pCallbackInfo,
+                                           IotMqttOperation_t *const pPublishOperation)
+{
+    uint64_t start_us = ((uint64_t)now * US_PER_MS) + (((uint64_t)rtt_ms * US_PER_MS) / 2U);
+    sim_publish_t *publish = NULL;
+
+    (void)mqttConnection;
+    (void)pPublishInfo;
+    (void)flags;
+    (void)pPublishOperation;
+
+    for (uint32_t i = 0U; (i < SIM_PUBLISHES) && (NULL == publish); i++)
+    {
+        if (!publishes[i].used)
+        {
+            publish = &publishes[i];
+        }
+    }
+    if (NULL == publish)
+    {
+        return IOT_MQTT_NO_MEMORY;
+    }
+
+    if (link_free_us < start_us)
+    {
+        link_free_us = start_us;
+    }
+    link_free_us = link_stall_end(link_free_us);
+    link_free_us += link_time_us(SIM_PUBACK_SIZE + SIM_BLOCK_OVERHEAD);
+    down_bytes += SIM_PUBACK_SIZE + SIM_BLOCK_OVERHEAD;
+
+    publish->used = true;
+    publish->arrival = (TickType_t)((link_free_us + (((uint64_t)rtt_ms * US_PER_MS) / 2U) +
+                                     US_PER_MS - 1U) / US_PER_MS);
+    publish->callback = *pCallbackInfo;
+
+    return IOT_MQTT_STATUS_PENDING;
+}
+
+
+/*******************************************************************************
+ * Function Name: __real_IotMqtt_PublishSync
+ *******************************************************************************
+ * Summary:
+ *  Not used by the simulation: the application publishes asynchronously.
+ *
+ ******************************************************************************/
+IotMqttError_t __real_IotMqtt_PublishSync(IotMqttConnection_t mqttConnection,
+                                          const IotMqttPublishInfo_t *pPublishInfo,
+                                          uint32_t flags, uint32_t timeoutMs)
+{
+    (void)mqttConnection;
+    (void)pPublishInfo;
+    (void)flags;
+    (void)timeoutMs;
+
+    return IOT_MQTT_SUCCESS;
+}
+
+
+/*******************************************************************************
+ * Function Name: app_published
+ *******************************************************************************
+ * Summary:
+ *  Completion callback of an application publish: keeps its latency.
+ *
+ * Parameters:
+ *  context - tick count of the publish
+ *  param - completion parameters
+ *
+ ******************************************************************************/
+static void app_published(void *context, IotMqttCallbackParam_t *param)
+{
+    (void)param;
+
+    if (app_latency_count == app_latency_max)
+    {
+        app_latency_max = (0U == app_latency_max) ? 1024U : (app_latency_max * 2U);
+        app_latency = realloc(app_latency, app_latency_max * sizeof(*app_latency));
+        if (NULL == app_latency)
+        {
+            aborted = true;
+            return;
+        }
+    }
+
+    app_latency[app_latency_count++] = (uint32_t)(now - (TickType_t)(uintptr_t)context);
+}
+
+
+/*******************************************************************************
+ * Function Name: app_publish
+ *******************************************************************************
+ * Summary:
+ *  Publishes from the application task, through the wrapper of the
+ *  coexistence, or around it with --no-pacing.
+ *
+ ******************************************************************************/
+static void app_publish(void)
+{
+    IotMqttPublishInfo_t info = IOT_MQTT_PUBLISH_INFO_INITIALIZER;
+    IotMqttCallbackInfo_t callback;
+    IotMqttError_t result;
+
+    info.qos = IOT_MQTT_QOS_1;
+    info.pTopicName = SIM_PUBLISH_TOPIC;
+    info.topicNameLength = (uint16_t)(sizeof(SIM_PUBLISH_TOPIC) - 1U);
+    info.pPayload = SIM_PUBLISH_PAYLOAD;
+    info.payloadLength = sizeof(SIM_PUBLISH_PAYLOAD) - 1U;
+    callback.pCallbackContext = (void *)(uintptr_t)now;
+    callback.function = app_published;
+
+    app_publishes++;
+    current_task = &app_task;
+    result = no_pacing ?
+             __real_IotMqtt_PublishAsync(NULL, &info, 0U, &callback, NULL) :
+             __wrap_IotMqtt_PublishAsync(NULL, &info, 0U, &callback, NULL);
+    current_task = &ota_task;
+
+    if (IOT_MQTT_STATUS_PENDING != result)
+    {
+        app_refused++;
+    }
+}
+
+
+/*******************************************************************************
+ * Function Name: publishes_run
+ *******************************************************************************
+ * Summary:
+ *  Completes the publishes whose PUBACK arrives now, in the MQTT task.
+ *
+ ******************************************************************************/
+static void publishes_run(void)
+{
+    IotMqttCallbackParam_t param = { 0 };
+
+    param.u.operation.result = IOT_MQTT_SUCCESS;
+
+    for (uint32_t i = 0U; i < SIM_PUBLISHES; i++)
+    {
+        if (publishes[i].used && (now >= publishes[i].arrival))
+        {
+            publishes[i].used = false;
+            current_task = NULL;
+            publishes[i].callback.function(publishes[i].callback.pCallbackContext, &param);
+            current_task = &ota_task;
+        }
+    }
+}
+
+
+/*******************************************************************************
+ * Function Name: latency_compare
+ ******************************************************************************/
+static int latency_compare(const void *a, const void *b)
+{
+    uint32_t x = *(const uint32_t *)a;
+    uint32_t y = *(const uint32_t *)b;
+
+    return (x > y) - (x < y);
+}
+
+
+/*******************************************************************************
+ * Function Name: latency_percentile
+ *******************************************************************************
+ * Summary:
+ *  Returns a percentile of the latencies kept, sorted by the caller.
+ *
+ ******************************************************************************/
+static uint32_t latency_percentile(uint32_t pct)
+{
+    if (0U == app_latency_count)
+    {
+        return 0U;
+    }
+
+    return app_latency[((app_latency_count - 1U) * pct) / PERCENT];
+}
+#endif /* CY_OTA_MQTT_COEXIST */
+
+
+/*******************************************************************************
+ * Function Name: prvPAL_WriteBlock
+ ******************************************************************************/
+int16_t prvPAL_WriteBlock(OTA_FileContext_t * const C, uint32_t ulOffset, uint8_t * const pcData,
+                          uint32_t ulBlockSize)
+{
+    if ((C != &file_ctx) || ((ulOffset + ulBlockSize) > image_size))
+    {
+        return -1;
+    }
+
+#if defined(CY_OTA_METRICS)
+    {
+        uint64_t us = (uint64_t)((ulBlockSize + SIM_PAGE_SIZE - 1U) / SIM_PAGE_SIZE) * SIM_PAGE_US;
+
+        ota_metrics_flash_start(OTA_METRICS_FLASH_WRITE);
+        sim_dwt.CYCCNT += (uint32_t)(us * SIM_CYCLES_PER_US);
+        write_us += us;
+        ota_metrics_flash_end();
+    }
+#endif
+
+    memcpy(&received[ulOffset], pcData, ulBlockSize);
+
+#if defined(CY_OTA_METRICS)
+    ota_metrics_written(ulOffset, ulBlockSize);
+#endif
+
+    return (int16_t)ulBlockSize;
+}
+
+
+/*******************************************************************************
+ * Function Name: OTA_SignalEvent
+ *******************************************************************************
+ * Summary:
+ *  Asks the agent model for a block request, handled after the blocks that
+ *  arrived in the same millisecond.
+ *
+ ******************************************************************************/
+bool OTA_SignalEvent(const OTA_EventMsg_t * const pxEventMsg)
+{
+    if (eOTA_AgentEvent_RequestFileBlock == pxEventMsg->xEventId)
+    {
+        request_pending = true;
+    }
+
+    return true;
+}
+
+
+/*******************************************************************************
+ * Function Name: __real_OTA_CBOR_Encode_GetStreamRequestMessage
+ *******************************************************************************
+ * Summary:
+ *  Stream server: queues the blocks of the request bitmap, up to the number
+ *  of blocks requested, in the block size of the request. The request
+ *  reaches the server after half the round trip; the blocks then follow each
+ *  other on the link, and reach the device after the other half.
+ *
+ ******************************************************************************/
+bool __real_OTA_CBOR_Encode_GetStreamRequestMessage(uint8_t *pucMessageBuffer,
+        size_t xMessageBufferSize, size_t *pxEncodedMessageSize,
+        const char *pcClientToken, int32_t lFileId, int32_t lBlockSize,
+        int32_t lBlockOffset, uint8_t *pucBlockBitmap, size_t xBlockBitmapSize,
+        int32_t lNumOfBlocksRequested)
+{
+    uint64_t start_us = ((uint64_t)now * US_PER_MS) + (((uint64_t)rtt_ms * US_PER_MS) / 2U);
+    uint32_t sent = 0U;
+
+    (void)pucMessageBuffer;
+    (void)xMessageBufferSize;
+    (void)pcClientToken;
+    (void)lFileId;
+
+    requests++;
+    *pxEncodedMessageSize = 0U;
+
+    if (link_free_us < start_us)
+    {
+        link_free_us = start_us;
+    }
+
+    for (uint32_t i = 0U; (i < (xBlockBitmapSize * BITS_PER_BYTE)) &&
+                          (sent < (uint32_t)lNumOfBlocksRequested); i++)
+    {
+        uint32_t block_id = (uint32_t)lBlockOffset + i;
+        uint32_t offset = block_id * (uint32_t)lBlockSize;
+        sim_packet_t *packet;
+
+        if ((pucBlockBitmap[i / BITS_PER_BYTE] & (1U << (i % BITS_PER_BYTE))) == 0U)
+        {
+            continue;
+        }
+        if (offset >= image_size)
+        {
+            break;
+        }
+
+        sent++;
+        if (packets_count == packets_max)
+        {
+            packets_max = (0U == packets_max) ? 1024U : (packets_max * 2U);
+            packets = realloc(packets, packets_max * sizeof(*packets));
+            if (NULL == packets)
+            {
+                return false;
+            }
+        }
+
+        packet = &packets[packets_count];
+        packet->block_id = block_id;
+        packet->block_size = (uint32_t)lBlockSize;
+        packet->offset = offset;
+        packet->size = ((image_size - offset) < (uint32_t)lBlockSize) ?
+                       (image_size - offset) : (uint32_t)lBlockSize;
+
+        link_free_us = link_stall_end(link_free_us);
+        link_free_us += link_time_us(packet->size + SIM_BLOCK_OVERHEAD);
+        down_bytes += packet->size + SIM_BLOCK_OVERHEAD;
+        packet->arrival = (TickType_t)((link_free_us + (((uint64_t)rtt_ms * US_PER_MS) / 2U) +
+                                        US_PER_MS - 1U) / US_PER_MS);
+
+        if ((sim_random() % PERCENT) >= loss_pct)
+        {
+            packets_count++;
+        }
+        else
+        {
+            lost++;
+        }
+    }
+
+    return true;
+}
+
+
+/*******************************************************************************
+ * Function Name: __real_OTA_CBOR_Decode_GetStreamResponseMessage
+ *******************************************************************************
+ * Summary:
+ *  Decodes the block being delivered into a buffer of its size, as the
+ *  decoder of the agent does.
+ *
+ ******************************************************************************/
+bool __real_OTA_CBOR_Decode_GetStreamResponseMessage(const uint8_t *pucMessageBuffer,
+        size_t xMessageSize, int32_t *plFileId, int32_t *plBlockId,
+        int32_t *plBlockSize, uint8_t **ppucPayload, size_t *pxPayloadSize)
+{
+    uint8_t *payload = malloc(current->size);
+
+    (void)pucMessageBuffer;
+    (void)xMessageSize;
+
+    if (NULL == payload)
+    {
+        return false;
+    }
+
+    memcpy(payload, &image[current->offset], current->size);
+    *plFileId = 0;
+    *plBlockId = (int32_t)current->block_id;
+    *plBlockSize = (int32_t)current->size;
+    *ppucPayload = payload;
+    *pxPayloadSize = current->size;
+
+    return true;
+}
+
+
+/*******************************************************************************
+ * Function Name: agent_request
+ *******************************************************************************
+ * Summary:
+ *  Requests the missing blocks, as the agent does, and restarts its request
+ *  timer. The transfer is aborted after otaconfigMAX_NUM_REQUEST_MOMENTUM
+ *  requests without a new block.
+ *
+ ******************************************************************************/
+static void agent_request(void)
+{
+    uint8_t message[SIM_MESSAGE_SIZE];
+    size_t message_size;
+    uint32_t units = (image_size + OTA_BLOCK_UNIT_SIZE - 1U) / OTA_BLOCK_UNIT_SIZE;
+    size_t bitmap_size = (units + BITS_PER_BYTE - 1U) / BITS_PER_BYTE;
+    bool (*encode)(uint8_t *, size_t, size_t *, const char *, int32_t, int32_t, int32_t,
+                   uint8_t *, size_t, int32_t) =
+        fixed ? __real_OTA_CBOR_Encode_GetStreamRequestMessage :
+                __wrap_OTA_CBOR_Encode_GetStreamRequestMessage;
+
+    request_pending = false;
+    if (++momentum > otaconfigMAX_NUM_REQUEST_MOMENTUM)
+    {
+        aborted = true;
+        return;
+    }
+
+    (void)encode(message, sizeof(message), &message_size, SIM_CLIENT_TOKEN, 0,
+                 (int32_t)OTA_BLOCK_UNIT_SIZE, 0, file_ctx.pucRxBlockBitmap, bitmap_size,
+                 (int32_t)otaconfigMAX_NUM_BLOCKS_REQUEST);
+
+    blocks_to_receive = otaconfigMAX_NUM_BLOCKS_REQUEST;
+    request_deadline = now + pdMS_TO_TICKS(otaconfigFILE_REQUEST_WAIT_MS);
+}
+
+
+/*******************************************************************************
+ * Function Name: agent_ingest
+ *******************************************************************************
+ * Summary:
+ *  Decodes and ingests a block as the agent does: a block out of the range of
+ *  the file aborts the transfer, a block already received is a duplicate,
+ *  and every otaconfigMAX_NUM_BLOCKS_REQUEST new blocks the next ones are
+ *  requested.
+ *
+ ******************************************************************************/
+static void agent_ingest(const sim_packet_t *packet)
+{
+    uint32_t last = (image_size - 1U) / OTA_BLOCK_UNIT_SIZE;
+    int32_t file_id;
+    int32_t block_id;
+    int32_t block_size;
+    uint8_t *payload;
+    size_t payload_size;
+    uint32_t id;
+    bool (*decode)(const uint8_t *, size_t, int32_t *, int32_t *, int32_t *, uint8_t **, size_t *) =
+        fixed ? __real_OTA_CBOR_Decode_GetStreamResponseMessage :
+                __wrap_OTA_CBOR_Decode_GetStreamResponseMessage;
+
+    blocks++;
+    blocks_of_size[(packet->block_size / OTA_BLOCK_UNIT_SIZE) % (otaconfigMAX_FILE_BLOCK_UNITS + 1U)]++;
+
+    current = packet;
+    if (!decode(NULL, 0U, &file_id, &block_id, &block_size, &payload, &payload_size))
+    {
+        return;
+    }
+
+    id = (uint32_t)block_id;
+    if (!(((id < last) && ((uint32_t)block_size == OTA_BLOCK_UNIT_SIZE)) ||
+          ((id == last) && ((uint32_t)block_size == (image_size - (last * OTA_BLOCK_UNIT_SIZE))))))
+    {
+        sim_peer_log("Block %u out of range, size %u\r\n", (unsigned int)id, (unsigned int)block_size);
+        aborted = true;
+    }
+    else if ((file_ctx.pucRxBlockBitmap[id / BITS_PER_BYTE] & (1U << (id % BITS_PER_BYTE))) == 0U)
+    {
+        duplicates++;
+    }
+    else if (prvPAL_WriteBlock(&file_ctx, id * OTA_BLOCK_UNIT_SIZE, payload,
+                               (uint32_t)block_size) == (int16_t)block_size)
+    {
+        file_ctx.pucRxBlockBitmap[id / BITS_PER_BYTE] &= (uint8_t)~(1U << (id % BITS_PER_BYTE));
+        file_ctx.ulBlocksRemaining--;
+        momentum = 0U;
+
+        if (blocks_to_receive > 1U)
+        {
+            blocks_to_receive--;
+        }
+        else
+        {
+            request_pending = true;
+        }
+    }
+
+    vPortFree(payload);
+}
+
+
+#if defined(CY_OTA_METRICS)
+/*******************************************************************************
+ * Function Name: metrics_publish
+ *******************************************************************************
+ * Summary:
+ *  Sends the next job status update of the agent, which the metrics publish
+ *  their summary with.
+ *
+ ******************************************************************************/
+static void metrics_publish(void)
+{
+    static OTA_AgentContext_t agent = { .pcThingName = SIM_THING_NAME };
+    static OTA_ConnectionContext_t connection;
+
+    /* Any non-NULL handle: the publish is answered by IotMqtt_TimedPublish() */
+    connection.pvControlClient = &connection;
+    agent.pvConnectionContext = &connection;
+
+    (void)__wrap__AwsIotOTA_UpdateJobStatus_Mqtt(&agent, eJobStatus_InProgress, 0, 0);
+}
+
+
+/*******************************************************************************
+ * Function Name: metrics_bench_ns
+ *******************************************************************************
+ * Summary:
+ *  Measures the host time of the metrics calls of one block written: the
+ *  flash write and the write itself, in a transfer of its own.
+ *
+ * Return:
+ *  uint32_t - nanoseconds per block
+ *
+ ******************************************************************************/
+static uint32_t metrics_bench_ns(void)
+{
+    uint32_t units = (image_size + OTA_BLOCK_UNIT_SIZE - 1U) / OTA_BLOCK_UNIT_SIZE;
+    struct timespec start;
+    struct timespec end;
+    uint64_t ns;
+
+    sim_dwt.CTRL = 0U;
+    ota_metrics_begin(&file_ctx);
+    ota_metrics_request(0U, units);
+
+    (void)clock_gettime(CLOCK_MONOTONIC, &start);
+    for (uint32_t i = 0U; i < SIM_BENCH_BLOCKS; i++)
+    {
+        ota_metrics_flash_start(OTA_METRICS_FLASH_WRITE);
+        ota_metrics_flash_end();
+        ota_metrics_written((i % units) * OTA_BLOCK_UNIT_SIZE, OTA_BLOCK_UNIT_SIZE);
+    }
+    (void)clock_gettime(CLOCK_MONOTONIC, &end);
+
+    ota_metrics_end(OTA_METRICS_ABORTED);
+
+    ns = (((uint64_t)end.tv_sec * NS_PER_S) + (uint64_t)end.tv_nsec) -
+         (((uint64_t)start.tv_sec * NS_PER_S) + (uint64_t)start.tv_nsec);
+
+    return (uint32_t)(ns / SIM_BENCH_BLOCKS);
+}
+#endif /* CY_OTA_METRICS */
+
+
+/*******************************************************************************
+ * Function Name: run
+ *******************************************************************************
+ * Summary:
+ *  Runs the transfer, one millisecond at a time.
+ *
+ * Return:
+ *  bool - the whole file was received
+ *
+ ******************************************************************************/
+static bool run(void)
+{
+    uint32_t units = (image_size + OTA_BLOCK_UNIT_SIZE - 1U) / OTA_BLOCK_UNIT_SIZE;
+    size_t bitmap_size = (units + BITS_PER_BYTE - 1U) / BITS_PER_BYTE;
+
+    file_ctx.ulFileSize = image_size;
+    file_ctx.ulBlocksRemaining = units;
+    file_ctx.pucRxBlockBitmap = malloc(bitmap_size);
+    if (NULL == file_ctx.pucRxBlockBitmap)
+    {
+        return false;
+    }
+    memset(file_ctx.pucRxBlockBitmap, 0, bitmap_size);
+    for (uint32_t unit = 0U; unit < units; unit++)
+    {
+        file_ctx.pucRxBlockBitmap[unit / BITS_PER_BYTE] |= (uint8_t)(1U << (unit % BITS_PER_BYTE));
+    }
+
+#if defined(CY_OTA_METRICS)
+    file_ctx.pucJobName = (uint8_t *)SIM_JOB_NAME;
+    ota_metrics_begin(&file_ctx);
+#endif
+
+    if (!fixed)
+    {
+        ota_block_size_start(&file_ctx);
+    }
+
+    agent_request();
+    while ((file_ctx.ulBlocksRemaining > 0U) && !aborted &&
+           (now < pdMS_TO_TICKS(timeout_s * 1000U)))
+    {
+        now++;
+
+        while ((packets_head < packets_count) && (packets[packets_head].arrival <= now) &&
+               !aborted)
+        {
+            sim_packet_t packet = packets[packets_head++];
+
+            agent_ingest(&packet);
+        }
+
+#if defined(CY_OTA_MQTT_COEXIST)
+        publishes_run();
+        if (0U == (now % publish_ms))
+        {
+            app_publish();
+        }
+#endif
+
+        timers_run();
+
+        if (now >= request_deadline)
+        {
+            timeouts++;
+            request_pending = true;
+        }
+
+        if (request_pending && (file_ctx.ulBlocksRemaining > 0U) && !aborted)
+        {
+            agent_request();
+        }
+    }
+
+    if (!fixed)
+    {
+        ota_block_size_stop(&file_ctx);
+    }
+
+#if defined(CY_OTA_METRICS)
+    ota_metrics_end((0U == file_ctx.ulBlocksRemaining) ? OTA_METRICS_VERIFIED : OTA_METRICS_ABORTED);
+    metrics_publish();
+#endif
+
+    free(file_ctx.pucRxBlockBitmap);
+
+    return (0U == file_ctx.ulBlocksRemaining) && (0 == memcmp(image, received, image_size));
+}
+
+
+/*******************************************************************************
+ * Function Name: usage
+ ******************************************************************************/
+static void usage(const char *name)
+{
+    fprintf(stderr,
+        "usage: %s [options]\n"
+        "  --size BYTES               size of the file (default %u)\n"
+        "  --seed N                   seed of the file and of the drops (default %u)\n"
+        "  --down-kbps KBPS           link to the device (default %u)\n"
+        "  --rtt-ms MS                round trip to the stream server (default %u)\n"
+        "  --loss-pct PCT             streamed blocks dropped (default %u)\n"
+        "  --heap BYTES               free heap of the device (default %u)\n"
+        "  --timeout-s S              give up after S simulated seconds (default %u)\n"
+        "  --stall-every-ms MS        hold the link at every multiple of MS (default none)\n"
+        "  --stall-ms MS              length of each hold of the link (default 0)\n"
+        "  --tcp-wnd BYTES            TCP window of the device (default unlimited)\n"
+        "  --fixed                    run the agent without the block stream wrappers\n"
+        "  --verbose                  print the log of the OTA app\n",
+        name, (unsigned int)SIM_DEFAULT_SIZE, SIM_DEFAULT_SEED, SIM_DEFAULT_DOWN_KBPS, SIM_DEFAULT_RTT_MS,
+        SIM_DEFAULT_LOSS_PCT, SIM_DEFAULT_HEAP, SIM_DEFAULT_TIMEOUT_S);
+#if defined(CY_OTA_MQTT_COEXIST)
+    fprintf(stderr,
+        "  --publish-ms MS            period of the application publishes (default %u)\n"
+        "  --no-pacing                publish around the coexistence wrappers\n",
+        SIM_DEFAULT_PUBLISH_MS);
+#endif
+}
+
+
+/*******************************************************************************
+ * Function Name: main
+ ******************************************************************************/
+int main(int argc, char *argv[])
+{
+    bool pass;
+    int opt;
+
+    while (-1 != (opt = getopt_long(argc, argv, "", sim_options, NULL)))
+    {
+        switch (opt)
+        {
+            case 's':
+                image_size = (uint32_t)strtoul(optarg, NULL, 0);
+                break;
+            case 'S':
+                seed = strtoull(optarg, NULL, 0);
+                break;
+            case 'd':
+                down_kbps = (uint32_t)strtoul(optarg, NULL, 0);
+                break;
+            case 'r':
+                rtt_ms = (uint32_t)strtoul(optarg, NULL, 0);
+                break;
+            case 'l':
+                loss_pct = (uint32_t)strtoul(optarg, NULL, 0);
+                break;
+            case 'H':
+                free_heap = (uint32_t)strtoul(optarg, NULL, 0);
+                break;
+            case 'T':
+                timeout_s = (uint32_t)strtoul(optarg, NULL, 0);
+                break;
+            case 'P':
+                stall_every_ms = (uint32_t)strtoul(optarg, NULL, 0);
+                break;
+            case 'D':
+                stall_ms = (uint32_t)strtoul(optarg, NULL, 0);
+                break;
+            case 'w':
+                tcp_wnd = (uint32_t)strtoul(optarg, NULL, 0);
+                break;
+            case 'f':
+                fixed = true;
+                break;
+            case 'v':
+                verbose = true;
+                break;
+#if defined(CY_OTA_MQTT_COEXIST)
+            case 'p':
+                publish_ms = (uint32_t)strtoul(optarg, NULL, 0);
+                break;
+            case 'n':
+                no_pacing = true;
+                break;
+#endif
+            default:
+                usage(argv[0]);
+                return EXIT_USAGE;
+        }
+    }
+    if ((optind != argc) || (0U == image_size) || (0U == down_kbps) || (loss_pct >= PERCENT) ||
+        ((0U != stall_every_ms) && (stall_ms >= stall_every_ms)))
+    {
+        usage(argv[0]);
+        return EXIT_USAGE;
+    }
+#if defined(CY_OTA_MQTT_COEXIST)
+    if (0U == publish_ms)
+    {
+        usage(argv[0]);
+        return EXIT_USAGE;
+    }
+#endif
+
+    rng_state = (seed * 2654435761ULL) | 1U;
+    image = malloc(image_size);
+    received = calloc(1U, image_size);
+    if ((NULL == image) || (NULL == received))
+    {
+        return EXIT_FAILURE;
+    }
+    for (uint32_t i = 0U; i < image_size; i++)
+    {
+        image[i] = (uint8_t)sim_random();
+    }
+
+    pass = run();
+#if defined(CY_OTA_METRICS)
+    pass = pass && (1U == summaries);
+#endif
+
+    printf("result=%s\n", pass ? "pass" : (aborted ? "aborted" : "fail"));
+    printf("time_ms=%u\n", (unsigned int)now);
+    printf("requests=%u\n", (unsigned int)requests);
+    printf("blocks=%u\n", (unsigned int)blocks);
+    printf("duplicates=%u\n", (unsigned int)duplicates);
+    printf("lost=%u\n", (unsigned int)lost);
+    printf("timeouts=%u\n", (unsigned int)timeouts);
+    printf("stalls=%u\n", (unsigned int)stalls);
+    printf("down_bytes=%llu\n", (unsigned long long)down_bytes);
+    printf("goodput_kbps=%u\n", (unsigned int)((now > 0U) ?
+           (((uint64_t)image_size * BITS_PER_BYTE) / now) : 0U));
+    for (uint32_t units = 1U; units <= otaconfigMAX_FILE_BLOCK_UNITS; units++)
+    {
+        printf("blocks_%u=%u\n", (unsigned int)(units * OTA_BLOCK_UNIT_SIZE),
+               (unsigned int)blocks_of_size[units]);
+    }
+
+#if defined(CY_OTA_METRICS)
+    printf("write_ms=%llu\n", (unsigned long long)(write_us / US_PER_MS));
+    printf("metrics_summaries=%u\n", (unsigned int)summaries);
+    printf("metrics_summary_bytes=%u\n", (unsigned int)summary_len);
+    printf("metrics_summary=%s\n", summary);
+    printf("metrics_ns_per_block=%u\n", (unsigned int)metrics_bench_ns());
+#endif
+
+#if defined(CY_OTA_MQTT_COEXIST)
+    {
+        ota_mqtt_coexist_stats_t stats;
+        uint32_t over_budget = 0U;
+
+        ota_mqtt_coexist_get(&stats);
+        qsort(app_latency, app_latency_count, sizeof(*app_latency), latency_compare);
+        for (size_t i = 0U; i < app_latency_count; i++)
+        {
+            over_budget += (app_latency[i] > CY_OTA_COEXIST_BUDGET_MS) ? 1U : 0U;
+        }
+
+        printf("app_publishes=%u\n", (unsigned int)app_publishes);
+        printf("app_refused=%u\n", (unsigned int)app_refused);
+        printf("app_acked=%u\n", (unsigned int)app_latency_count);
+        printf("app_p50_ms=%u\n", (unsigned int)latency_percentile(50U));
+        printf("app_p99_ms=%u\n", (unsigned int)latency_percentile(99U));
+        printf("app_max_ms=%u\n", (unsigned int)latency_percentile(PERCENT));
+        printf("app_over_budget=%u\n", (unsigned int)over_budget);
+        printf("coexist_backoffs=%u\n", (unsigned int)stats.backoffs);
+        printf("coexist_rate=%u\n", (OTA_COEXIST_RATE_UNLIMITED == stats.ota_rate) ?
+               0U : (unsigned int)stats.ota_rate);
+        free(app_latency);
+    }
+#endif
+
+    free(packets);
+    free(received);
+    free(image);
+
+    return pass ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+
+/* [] END OF FILE */
@@ -0,0 +1,865 @@
+/******************************************************************************
+* File Name: sim_broker.c
+*
+* Description: This file implements the MQTT broker stand-in of the host OTA
+* simulation. It provides the IotMqtt functions the OTA agent calls, over the
+* network model of sim_net.c, and on the other end of the link it serves:
+* - the next job of the thing, an AFR OTA job for the image under test, on
+*   $aws/things/<thing>/jobs/$next/get;
+* - the blocks of the image with the CBOR stream protocol, on
+*   $aws/things/<thing>/streams/<stream>/get/cbor, answered one QoS 0 message
+*   per block on .../data/cbor;
+* - the job status updates, which are only recorded.
+*
+* Data over HTTP is not simulated: the HTTP data interface of the agent fails,
+* so a job that offers only HTTP fails as it would without a connection.
+*
+* Related Document: See README.md
+*
+*******************************************************************************
+* (c) 2020, Cypress Semiconductor Corporation. All rights reserved.
+*******************************************************************************
+* This software, including source code, documentation and related materials
+* ("Software"), is owned by Cypress Semiconductor Corporation or one of its
+* subsidiaries ("Cypress") and is protected by and subject to worldwide patent
+* protection (United States and foreign), United States copyright laws and
+* international treaty provisions. Therefore, you may use this Software only
+* as provided in the license agreement accompanying the software package from
+* which you obtained this Software ("EULA").
+*
+* If no EULA applies, Cypress hereby grants you a personal, non-exclusive,
+* non-transferable license to copy, modify, and compile the Software source
+* code solely for use in connection with Cypress's integrated circuit products.
+* Any reproduction, modification, translation, compilation, or representation
+* of this Software except as specified above is prohibited without the express
+* written permission of Cypress.
+*
+* Disclaimer: THIS SOFTWARE IS PROVIDED AS-IS, WITH NO WARRANTY OF ANY KIND,
+* EXPRESS OR IMPLIED, INCLUDING, BUT NOT LIMITED TO, NONINFRINGEMENT, IMPLIED
+* WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE. Cypress
+* reserves the right to make changes to the Software without notice. Cypress
+* does not assume any liability arising out of the application or use of the
+* Software or any product or circuit described in the Software. Cypress does
+* not authorize its products for use in any products where a malfunction or
+* failure of the Cypress product may reasonably be expected to result in
+* significant property damage, injury or death ("High Risk Product"). By
+* including Cypress's product in a High Risk Product, the manufacturer of such
+* system or application assumes all risk of such use and in doing so agrees to
+* indemnify Cypress against all liability.
+*******************************************************************************/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "FreeRTOS.h"
+#include "task.h"
+#include "semphr.h"
+#include "iot_mqtt.h"
+#include "aws_iot_ota_agent_internal.h"
+#include "cbor.h"
+#include "ota_json_extract.h"
+#include "sim_net.h"
+#include "sim_broker.h"
+
+
+/*******************************************************************************
+ * Macros
+ ******************************************************************************/
+#define BITS_PER_BYTE                   (8U)
+
+#define JOB_GET_SUFFIX                  "/jobs/$next/get"
+#define JOB_ACCEPTED_SUFFIX             "/accepted"
+#define JOB_UPDATE_SUFFIX               "/update"
+#define STREAM_GET_SUFFIX               "/get/cbor"
+#define STREAM_DATA_SUFFIX              "/data/cbor"
+
+#define CLIENT_TOKEN_SIZE               (64U)
+#define SIGNATURE_SIZE                  (72U)   /* DER ECDSA P-256 */
+#define SIGNATURE_B64_SIZE              (((SIGNATURE_SIZE + 2U) / 3U) * 4U + 1U)
+#define JOB_DOC_SIZE                    (1024U)
+#define TOPIC_SIZE                      (256U)
+
+/* Keys of the stream request and response maps */
+#define STREAM_KEY_CLIENT_TOKEN         "c"
+#define STREAM_KEY_FILE_ID              "f"
+#define STREAM_KEY_BLOCK_SIZE           "l"
+#define STREAM_KEY_BLOCK_OFFSET         "o"
+#define STREAM_KEY_BLOCK_BITMAP         "b"
+#define STREAM_KEY_NUM_BLOCKS           "n"
+#define STREAM_KEY_BLOCK_ID             "i"
+#define STREAM_KEY_PAYLOAD              "p"
+
+/* Map entries and framing of a block response, besides the payload */
+#define BLOCK_RESPONSE_ENTRIES          (4U)
+#define BLOCK_RESPONSE_OVERHEAD         (48U)
+
+
+/*******************************************************************************
+ * Data structure and enumeration
+ ******************************************************************************/
+typedef struct
+{
+    bool used;
+    char filter[TOPIC_SIZE];
+    IotMqttCallbackInfo_t callback;
+} subscription_t;
+
+
+/*******************************************************************************
+ * Global variables
+ ******************************************************************************/
+static SemaphoreHandle_t broker_lock;
+static subscription_t subscriptions[SIM_BROKER_SUBSCRIPTIONS];
+static sim_broker_stats_t broker_stats;
+
+/* Handle given to the agent as its MQTT connection */
+static int connection_token;
+
+static const uint8_t *file_image;
+static size_t file_size;
+static char signature_b64[SIGNATURE_B64_SIZE];
+static bool job_served;
+
+
+/*******************************************************************************
+ * Function Name: base64_encode
+ *******************************************************************************
+ * Summary:
+ *  Encodes bytes in base64, with padding.
+ *
+ * Parameters:
+ *  src, len - bytes to encode
+ *  dst - at least ((len + 2) / 3) * 4 + 1 bytes, NUL terminated on return
+ *
+ ******************************************************************************/
+static void base64_encode(const uint8_t *src, size_t len, char *dst)
+{
+    static const char alphabet[] =
+        "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+    size_t i;
+
+    for (i = 0U; (i + 2U) < len; i += 3U)
+    {
+        uint32_t v = ((uint32_t)src[i] << 16) | ((uint32_t)src[i + 1U] << 8) | src[i + 2U];
+
+        *dst++ = alphabet[(v >> 18) & 0x3FU];
+        *dst++ = alphabet[(v >> 12) & 0x3FU];
+        *dst++ = alphabet[(v >> 6) & 0x3FU];
+        *dst++ = alphabet[v & 0x3FU];
+    }
+    if (i < len)
+    {
+        uint32_t v = (uint32_t)src[i] << 16;
+
+        if ((i + 1U) < len)
+        {
+            v |= (uint32_t)src[i + 1U] << 8;
+        }
+        *dst++ = alphabet[(v >> 18) & 0x3FU];
+        *dst++ = alphabet[(v >> 12) & 0x3FU];
+        *dst++ = ((i + 1U) < len) ? alphabet[(v >> 6) & 0x3FU] : '=';
+        *dst++ = '=';
+    }
+    *dst = '\0';
+}
+
+
+/*******************************************************************************
+ * Function Name: ends_with
+ *******************************************************************************
+ * Summary:
+ *  Tells if a topic ends with a suffix.
+ *
+ ******************************************************************************/
+static bool ends_with(const char *topic, size_t topic_len, const char *suffix)
+{
+    size_t len = strlen(suffix);
+
+    return (topic_len >= len) && (0 == memcmp(topic + topic_len - len, suffix, len));
+}
+
+
+/*******************************************************************************
+ * Function Name: json_string
+ *******************************************************************************
+ * Summary:
+ *  Copies the string value of a top-level key of a JSON payload.
+ *
+ * Parameters:
+ *  payload, len - JSON text
+ *  key - key to look for
+ *  out, size - receives the value, NUL terminated, empty if not found
+ *
+ ******************************************************************************/
+static void json_string(const uint8_t *payload, size_t len, const char *key,
+                        char *out, size_t size)
+{
+    ota_json_field_t field = { .path = key, .type = OTA_JSON_STRING };
+    size_t n = 0U;
+
+    if ((ota_json_extract((const char *)payload, len, &field, 1U) > 0) && field.found)
+    {
+        n = (field.value.text.len < size) ? field.value.text.len : (size - 1U);
+        memcpy(out, field.value.text.text, n);
+    }
+    out[n] = '\0';
+}
+
+
+/*******************************************************************************
+ * Function Name: publish_to_device
+ *******************************************************************************
+ * Summary:
+ *  Sends a message from the broker to the device.
+ *
+ ******************************************************************************/
+static void publish_to_device(const char *topic, const uint8_t *payload, size_t len,
+                              int qos, bool lossy)
+{
+    if (!sim_net_send(SIM_NET_DOWNLINK, topic, strlen(topic), payload, len, qos, lossy, NULL))
+    {
+        configPRINTF(("sim_broker: out of memory, message to %s lost\r\n", topic));
+    }
+}
+
+
+/*******************************************************************************
+ * Function Name: serve_job
+ *******************************************************************************
+ * Summary:
+ *  Answers a request for the next job: the OTA job of the image the first
+ *  time, no job afterwards.
+ *
+ * Parameters:
+ *  topic, topic_len - request topic, $aws/things/<thing>/jobs/$next/get
+ *  payload, len - request, with the client token to echo
+ *
+ ******************************************************************************/
+static void serve_job(const char *topic, size_t topic_len, const uint8_t *payload, size_t len)
+{
+    char token[CLIENT_TOKEN_SIZE];
+    char reply_topic[TOPIC_SIZE];
+    char doc[JOB_DOC_SIZE];
+    uint32_t now = (uint32_t)(xTaskGetTickCount() / configTICK_RATE_HZ);
+    bool serve;
+    int n;
+
+    json_string(payload, len, "clientToken", token, sizeof(token));
+    (void)snprintf(reply_topic, sizeof(reply_topic), "%.*s" JOB_ACCEPTED_SUFFIX,
+                   (int)topic_len, topic);
+
+    xSemaphoreTake(broker_lock, portMAX_DELAY);
+    broker_stats.job_requests++;
+    serve = !job_served;
+    job_served = true;
+    xSemaphoreGive(broker_lock);
+
+    if (serve)
+    {
+        n = snprintf(doc, sizeof(doc),
+                "{\"clientToken\":\"%s\",\"timestamp\":%lu,\"execution\":{"
+                "\"jobId\":\"" SIM_BROKER_JOB_ID "\",\"status\":\"QUEUED\","
+                "\"queuedAt\":%lu,\"lastUpdatedAt\":%lu,\"versionNumber\":1,\"executionNumber\":1,"
+                "\"jobDocument\":{\"afr_ota\":{\"protocols\":[\"MQTT\"],"
+                "\"streamname\":\"" SIM_BROKER_STREAM_NAME "\",\"files\":[{"
+                "\"filepath\":\"" SIM_BROKER_FILE_PATH "\",\"filesize\":%lu,"
+                "\"fileid\":%d,\"certfile\":\"" SIM_BROKER_CERT_FILE "\","
+                "\"sig-sha256-ecdsa\":\"%s\"}]}}}}",
+                token, (unsigned long)now, (unsigned long)now, (unsigned long)now,
+                (unsigned long)file_size, SIM_BROKER_FILE_ID, signature_b64);
+    }
+    else
+    {
+        n = snprintf(doc, sizeof(doc), "{\"clientToken\":\"%s\",\"timestamp\":%lu}",
+                     token, (unsigned long)now);
+    }
+
+    publish_to_device(reply_topic, (const uint8_t *)doc, (size_t)n, 0, false);
+}
+
+
+/*******************************************************************************
+ * Function Name: get_int
+ *******************************************************************************
+ * Summary:
+ *  Reads an integer entry of a CBOR map.
+ *
+ ******************************************************************************/
+static bool get_int(const CborValue *map, const char *key, int *out)
+{
+    CborValue value;
+
+    return (CborNoError == cbor_value_map_find_value(map, key, &value)) &&
+           cbor_value_is_integer(&value) &&
+           (CborNoError == cbor_value_get_int(&value, out));
+}
+
+
+/*******************************************************************************
+ * Function Name: serve_blocks
+ *******************************************************************************
+ * Summary:
+ *  Answers a stream request: sends the blocks of the bitmap, starting at the
+ *  block offset, up to the number of blocks requested, one message each.
+ *
+ * Parameters:
+ *  topic, topic_len - request topic, .../streams/<stream>/get/cbor
+ *  payload, len - CBOR request
+ *
+ ******************************************************************************/
+static void serve_blocks(const char *topic, size_t topic_len, const uint8_t *payload, size_t len)
+{
+    CborParser parser;
+    CborValue map;
+    CborValue value;
+    char data_topic[TOPIC_SIZE];
+    uint8_t *bitmap = NULL;
+    uint8_t *msg = NULL;
+    size_t bitmap_size = 0U;
+    int file_id;
+    int block_size;
+    int offset;
+    int count;
+    uint32_t blocks;
+    uint32_t sent = 0U;
+    uint64_t bytes = 0U;
+
+    if ((CborNoError != cbor_parser_init(payload, len, 0, &parser, &map)) ||
+        !cbor_value_is_map(&map) ||
+        !get_int(&map, STREAM_KEY_FILE_ID, &file_id) ||
+        !get_int(&map, STREAM_KEY_BLOCK_SIZE, &block_size) ||
+        !get_int(&map, STREAM_KEY_BLOCK_OFFSET, &offset) ||
+        !get_int(&map, STREAM_KEY_NUM_BLOCKS, &count) ||
+        (SIM_BROKER_FILE_ID != file_id) || (block_size <= 0) ||
+        ((uint32_t)block_size > SIM_BROKER_BLOCK_SIZE_MAX) || (offset < 0) ||
+        (CborNoError != cbor_value_map_find_value(&map, STREAM_KEY_BLOCK_BITMAP, &value)) ||
+        !cbor_value_is_byte_string(&value) ||
+        (CborNoError != cbor_value_get_string_length(&value, &bitmap_size)) ||
+        (NULL == (bitmap = malloc(bitmap_size + 1U))) ||
+        (CborNoError != cbor_value_copy_byte_string(&value, bitmap, &bitmap_size, NULL)) ||
+        (NULL == (msg = malloc((size_t)block_size + BLOCK_RESPONSE_OVERHEAD))))
+    {
+        xSemaphoreTake(broker_lock, portMAX_DELAY);
+        broker_stats.bad_requests++;
+        xSemaphoreGive(broker_lock);
+        free(bitmap);
+        return;
+    }
+
+    (void)snprintf(data_topic, sizeof(data_topic), "%.*s" STREAM_DATA_SUFFIX,
+                   (int)(topic_len - strlen(STREAM_GET_SUFFIX)), topic);
+
+    blocks = (uint32_t)((file_size + (size_t)block_size - 1U) / (size_t)block_size);
+
+    for (uint32_t bit = 0U; bit < (bitmap_size * BITS_PER_BYTE); bit++)
+    {
+        uint32_t block = (uint32_t)offset + bit;
+        size_t block_off;
+        size_t block_len;
+        CborEncoder encoder;
+        CborEncoder block_map;
+
+        if ((count > 0) && (sent >= (uint32_t)count))
+        {
+            break;
+        }
+        if (block >= blocks)
+        {
+            break;
+        }
+        if (0U == (bitmap[bit / BITS_PER_BYTE] & (1U << (bit % BITS_PER_BYTE))))
+        {
+            continue;
+        }
+
+        block_off = (size_t)block * (size_t)block_size;
+        block_len = file_size - block_off;
+        if (block_len > (size_t)block_size)
+        {
+            block_len = (size_t)block_size;
+        }
+
+        cbor_encoder_init(&encoder, msg, (size_t)block_size + BLOCK_RESPONSE_OVERHEAD, 0);
+        if ((CborNoError != cbor_encoder_create_map(&encoder, &block_map, BLOCK_RESPONSE_ENTRIES)) ||
+            (CborNoError != cbor_encode_text_stringz(&block_map, STREAM_KEY_FILE_ID)) ||
+            (CborNoError != cbor_encode_int(&block_map, file_id)) ||
+            (CborNoError != cbor_encode_text_stringz(&block_map, STREAM_KEY_BLOCK_ID)) ||
+            (CborNoError != cbor_encode_int(&block_map, block)) ||
+            (CborNoError != cbor_encode_text_stringz(&block_map, STREAM_KEY_BLOCK_SIZE)) ||
+            (CborNoError != cbor_encode_int(&block_map, (int64_t)block_len)) ||
+            (CborNoError != cbor_encode_text_stringz(&block_map, STREAM_KEY_PAYLOAD)) ||
+            (CborNoError != cbor_encode_byte_string(&block_map, file_image + block_off, block_len)) ||
+            (CborNoError != cbor_encoder_close_container_checked(&encoder, &block_map)))
+        {
+            break;
+        }
+
+        publish_to_device(data_topic, msg, cbor_encoder_get_buffer_size(&encoder, msg), 0, true);
+        sent++;
+        bytes += block_len;
+    }
+
+    xSemaphoreTake(broker_lock, portMAX_DELAY);
+    broker_stats.stream_requests++;
+    broker_stats.blocks_served += sent;
+    broker_stats.bytes_served += bytes;
+    xSemaphoreGive(broker_lock);
+
+    free(msg);
+    free(bitmap);
+}
+
+
+/*******************************************************************************
+ * Function Name: record_status
+ *******************************************************************************
+ * Summary:
+ *  Records a job status update of the device.
+ *
+ ******************************************************************************/
+static void record_status(const uint8_t *payload, size_t len)
+{
+    char status[SIM_BROKER_STATUS_SIZE];
+
+    json_string(payload, len, "status", status, sizeof(status));
+
+    xSemaphoreTake(broker_lock, portMAX_DELAY);
+    broker_stats.status_updates++;
+    memcpy(broker_stats.last_status, status, sizeof(status));
+    xSemaphoreGive(broker_lock);
+
+    configPRINTF(("sim_broker: job status %s\r\n", status));
+}
+
+
+/*******************************************************************************
+ * Function Name: sim_broker_receive
+ *******************************************************************************
+ * Summary:
+ *  Handles a message of the device arriving at the broker. Called in the
+ *  network task.
+ *
+ ******************************************************************************/
+void sim_broker_receive(const char *topic, size_t topic_len,
+                        const uint8_t *payload, size_t len, int qos)
+{
+    (void)qos;
+
+    if (ends_with(topic, topic_len, JOB_GET_SUFFIX))
+    {
+        serve_job(topic, topic_len, payload, len);
+    }
+    else if (ends_with(topic, topic_len, STREAM_GET_SUFFIX) && (NULL != strstr(topic, "/streams/")))
+    {
+        serve_blocks(topic, topic_len, payload, len);
+    }
+    else if (ends_with(topic, topic_len, JOB_UPDATE_SUFFIX) && (NULL != strstr(topic, "/jobs/")))
+    {
+        record_status(payload, len);
+    }
+    else
+    {
+        configPRINTF(("sim_broker: no service on %s\r\n", topic));
+    }
+}
+
+
+/*******************************************************************************
+ * Function Name: topic_matches
+ *******************************************************************************
+ * Summary:
+ *  Matches a topic against an MQTT topic filter, with the + and # wildcards.
+ *
+ ******************************************************************************/
+static bool topic_matches(const char *filter, const char *topic, size_t topic_len)
+{
+    size_t t = 0U;
+
+    for (; '\0' != *filter; filter++)
+    {
+        if ('#' == *filter)
+        {
+            return true;
+        }
+        if ('+' == *filter)
+        {
+            while ((t < topic_len) && ('/' != topic[t]))
+            {
+                t++;
+            }
+            continue;
+        }
+        if ((t >= topic_len) || (*filter != topic[t]))
+        {
+            return false;
+        }
+        t++;
+    }
+
+    return (t == topic_len);
+}
+
+
+/*******************************************************************************
+ * Function Name: sim_broker_deliver
+ *******************************************************************************
+ * Summary:
+ *  Delivers a message arriving at the device to the callbacks of the matching
+ *  subscriptions, as the receive task of the MQTT library. Called in the
+ *  network task.
+ *
+ ******************************************************************************/
+void sim_broker_deliver(const char *topic, size_t topic_len,
+                        const uint8_t *payload, size_t len, int qos)
+{
+    subscription_t matched[SIM_BROKER_SUBSCRIPTIONS];
+    uint32_t count = 0U;
+
+    xSemaphoreTake(broker_lock, portMAX_DELAY);
+    for (uint32_t i = 0U; i < SIM_BROKER_SUBSCRIPTIONS; i++)
+    {
+        if (subscriptions[i].used && topic_matches(subscriptions[i].filter, topic, topic_len))
+        {
+            matched[count++] = subscriptions[i];
+        }
+    }
+    xSemaphoreGive(broker_lock);
+
+    for (uint32_t i = 0U; i < count; i++)
+    {
+        IotMqttCallbackParam_t param;
+
+        memset(&param, 0, sizeof(param));
+        param.mqttConnection = (IotMqttConnection_t)&connection_token;
+        param.u.message.pTopicFilter = matched[i].filter;
+        param.u.message.topicFilterLength = (uint16_t)strlen(matched[i].filter);
+        param.u.message.info.qos = (IotMqttQos_t)qos;
+        param.u.message.info.pTopicName = topic;
+        param.u.message.info.topicNameLength = (uint16_t)topic_len;
+        param.u.message.info.pPayload = payload;
+        param.u.message.info.payloadLength = len;
+
+        if (NULL != matched[i].callback.function)
+        {
+            matched[i].callback.function(matched[i].callback.pCallbackContext, &param);
+        }
+    }
+}
+
+
+/*******************************************************************************
+ * Function Name: sim_broker_init
+ *******************************************************************************
+ * Summary:
+ *  Sets up the broker stand-in to serve an image. The signature in the job
+ *  document is random: the simulated PAL compares the received file with the
+ *  image instead of verifying it.
+ *
+ * Parameters:
+ *  image, size - file of the job; must stay valid for the whole run
+ *
+ * Return:
+ *  bool - true if set up
+ *
+ ******************************************************************************/
+bool sim_broker_init(const uint8_t *image, size_t size)
+{
+    uint8_t signature[SIGNATURE_SIZE];
+
+    for (uint32_t i = 0U; i < SIGNATURE_SIZE; i++)
+    {
+        signature[i] = (uint8_t)sim_net_random();
+    }
+    base64_encode(signature, sizeof(signature), signature_b64);
+
+    file_image = image;
+    file_size = size;
+    job_served = false;
+    memset(subscriptions, 0, sizeof(subscriptions));
+    memset(&broker_stats, 0, sizeof(broker_stats));
+
+    broker_lock = xSemaphoreCreateMutex();
+
+    return (NULL != broker_lock);
+}
+
+
+/*******************************************************************************
+ * Function Name: sim_broker_connection
+ *******************************************************************************
+ * Summary:
+ *  Returns the MQTT connection to give to the agent.
+ *
+ ******************************************************************************/
+void *sim_broker_connection(void)
+{
+    return &connection_token;
+}
+
+
+/*******************************************************************************
+ * Function Name: sim_broker_get_stats
+ *******************************************************************************
+ * Summary:
+ *  Returns the counters of the broker stand-in.
+ *
+ ******************************************************************************/
+void sim_broker_get_stats(sim_broker_stats_t *stats)
+{
+    xSemaphoreTake(broker_lock, portMAX_DELAY);
+    *stats = broker_stats;
+    xSemaphoreGive(broker_lock);
+}
+
+
+/*******************************************************************************
+ * Function Name: subscribe
+ *******************************************************************************
+ * Summary:
+ *  Adds or removes subscriptions. A subscription to a filter already held
+ *  replaces its callback.
+ *
+ ******************************************************************************/
+static IotMqttError_t subscribe(const IotMqttSubscription_t *list, size_t count, bool add)
+{
+    IotMqttError_t result = IOT_MQTT_SUCCESS;
+
+    if ((NULL == list) || (0U == count))
+    {
+        return IOT_MQTT_BAD_PARAMETER;
+    }
+
+    xSemaphoreTake(broker_lock, portMAX_DELAY);
+    for (size_t s = 0U; s < count; s++)
+    {
+        subscription_t *slot = NULL;
+
+        if (list[s].topicFilterLength >= TOPIC_SIZE)
+        {
+            result = IOT_MQTT_BAD_PARAMETER;
+            continue;
+        }
+        for (uint32_t i = 0U; i < SIM_BROKER_SUBSCRIPTIONS; i++)
+        {
+            if (subscriptions[i].used &&
+                (strlen(subscriptions[i].filter) == list[s].topicFilterLength) &&
+                (0 == memcmp(subscriptions[i].filter, list[s].pTopicFilter, list[s].topicFilterLength)))
+            {
+                slot = &subscriptions[i];
+                break;
+            }
+        }
+        if (!add)
+        {
+            if (NULL != slot)
+            {
+                slot->used = false;
+            }
+            continue;
+        }
+        for (uint32_t i = 0U; (NULL == slot) && (i < SIM_BROKER_SUBSCRIPTIONS); i++)
+        {
+            if (!subscriptions[i].used)
+            {
+                slot = &subscriptions[i];
+            }
+        }
+        if (NULL == slot)
+        {
+            result = IOT_MQTT_NO_MEMORY;
+            continue;
+        }
+        memcpy(slot->filter, list[s].pTopicFilter, list[s].topicFilterLength);
+        slot->filter[list[s].topicFilterLength] = '\0';
+        slot->callback = list[s].callback;
+        slot->used = true;
+    }
+    xSemaphoreGive(broker_lock);
+
+    return result;
+}
+
+
+/*******************************************************************************
+ * Function Name: complete
+ *******************************************************************************
+ * Summary:
+ *  Reports the completion of an asynchronous operation, which the stand-in
+ *  always completes at once.
+ *
+ ******************************************************************************/
+static IotMqttError_t complete(IotMqttOperationType_t type, IotMqttError_t result,
+                               const IotMqttCallbackInfo_t *pCallbackInfo,
+                               IotMqttOperation_t * const pOperation)
+{
+    if (NULL != pOperation)
+    {
+        *pOperation = NULL;
+    }
+    if ((NULL != pCallbackInfo) && (NULL != pCallbackInfo->function))
+    {
+        IotMqttCallbackParam_t param;
+
+        memset(&param, 0, sizeof(param));
+        param.mqttConnection = (IotMqttConnection_t)&connection_token;
+        param.u.operation.type = type;
+        param.u.operation.result = result;
+        pCallbackInfo->function(pCallbackInfo->pCallbackContext, &param);
+    }
+
+    return result;
+}
+
+
+/*******************************************************************************
+ * Function Name: publish
+ *******************************************************************************
+ * Summary:
+ *  Sends a message of the device to the broker. A QoS 1 message returns once
+ *  its PUBACK is back.
+ *
+ ******************************************************************************/
+static IotMqttError_t publish(const IotMqttPublishInfo_t *pPublishInfo)
+{
+    uint32_t ack_ms = 0U;
+
+    if ((NULL == pPublishInfo) || (NULL == pPublishInfo->pTopicName))
+    {
+        return IOT_MQTT_BAD_PARAMETER;
+    }
+    if (!sim_net_send(SIM_NET_UPLINK, pPublishInfo->pTopicName, pPublishInfo->topicNameLength,
+                      pPublishInfo->pPayload, pPublishInfo->payloadLength,
+                      (int)pPublishInfo->qos, false, &ack_ms))
+    {
+        return IOT_MQTT_NO_MEMORY;
+    }
+    if (0U != ack_ms)
+    {
+        vTaskDelay(pdMS_TO_TICKS(ack_ms));
+    }
+
+    return IOT_MQTT_SUCCESS;
+}
+
+
+/*******************************************************************************
+ * MQTT API of the stand-in
+ ******************************************************************************/
+IotMqttError_t IotMqtt_SubscribeSync(IotMqttConnection_t mqttConnection,
+                                     const IotMqttSubscription_t *pSubscriptionList,
+                                     size_t subscriptionCount, uint32_t flags,
+                                     uint32_t timeoutMs)
+{
+    (void)mqttConnection;
+    (void)flags;
+    (void)timeoutMs;
+
+    return subscribe(pSubscriptionList, subscriptionCount, true);
+}
+
+IotMqttError_t IotMqtt_SubscribeAsync(IotMqttConnection_t mqttConnection,
+                                      const IotMqttSubscription_t *pSubscriptionList,
+                                      size_t subscriptionCount, uint32_t flags,
+                                      const IotMqttCallbackInfo_t *pCallbackInfo,
+                                      IotMqttOperation_t * const pSubscriptionOperation)
+{
+    (void)mqttConnection;
+    (void)flags;
+
+    return complete(IOT_MQTT_SUBSCRIBE,
+                    subscribe(pSubscriptionList, subscriptionCount, true),
+                    pCallbackInfo, pSubscriptionOperation);
+}
+
+IotMqttError_t IotMqtt_UnsubscribeSync(IotMqttConnection_t mqttConnection,
+                                       const IotMqttSubscription_t *pSubscriptionList,
+                                       size_t subscriptionCount, uint32_t flags,
+                                       uint32_t timeoutMs)
+{
+    (void)mqttConnection;
+    (void)flags;
+    (void)timeoutMs;
+
+    return subscribe(pSubscriptionList, subscriptionCount, false);
+}
+
+IotMqttError_t IotMqtt_UnsubscribeAsync(IotMqttConnection_t mqttConnection,
+                                        const IotMqttSubscription_t *pSubscriptionList,
+                                        size_t subscriptionCount, uint32_t flags,
+                                        const IotMqttCallbackInfo_t *pCallbackInfo,
+                                        IotMqttOperation_t * const pUnsubscribeOperation)
+{
+    (void)mqttConnection;
+    (void)flags;
+
+    return complete(IOT_MQTT_UNSUBSCRIBE,
+                    subscribe(pSubscriptionList, subscriptionCount, false),
+                    pCallbackInfo, pUnsubscribeOperation);
+}
+
+IotMqttError_t IotMqtt_PublishSync(IotMqttConnection_t mqttConnection,
+                                   const IotMqttPublishInfo_t *pPublishInfo,
+                                   uint32_t flags, uint32_t timeoutMs)
+{
+    (void)mqttConnection;
+    (void)flags;
+    (void)timeoutMs;
+
+    return publish(pPublishInfo);
+}
+
+IotMqttError_t IotMqtt_PublishAsync(IotMqttConnection_t mqttConnection,
+                                    const IotMqttPublishInfo_t *pPublishInfo,
+                                    uint32_t flags,
+                                    const IotMqttCallbackInfo_t *pCallbackInfo,
+                                    IotMqttOperation_t * const pPublishOperation)
+{
+    (void)mqttConnection;
+    (void)flags;
+
+    return complete(IOT_MQTT_PUBLISH_TO_SERVER, publish(pPublishInfo),
+                    pCallbackInfo, pPublishOperation);
+}
+
+
+/*******************************************************************************
+ * HTTP data interface of the agent, not simulated
+ ******************************************************************************/
+OTA_Err_t _AwsIotOTA_InitFileTransfer_HTTP(OTA_AgentContext_t *pAgentCtx)
+{
+    (void)pAgentCtx;
+
+    return kOTA_Err_HTTPInitFailed;
+}
+
+OTA_Err_t _AwsIotOTA_RequestDataBlock_HTTP(OTA_AgentContext_t *pAgentCtx)
+{
+    (void)pAgentCtx;
+
+    return kOTA_Err_HTTPRequestFailed;
+}
+
+OTA_Err_t _AwsIotOTA_DecodeFileBlock_HTTP(uint8_t *pMessageBuffer, size_t messageSize,
+                                          int32_t *pFileId, int32_t *pBlockId,
+                                          int32_t *pBlockSize, uint8_t **pPayload,
+                                          size_t *pPayloadSize)
+{
+    (void)pMessageBuffer;
+    (void)messageSize;
+    (void)pFileId;
+    (void)pBlockId;
+    (void)pBlockSize;
+    (void)pPayload;
+    (void)pPayloadSize;
+
+    return kOTA_Err_HTTPRequestFailed;
+}
+
+OTA_Err_t _AwsIotOTA_Cleanup_HTTP(OTA_AgentContext_t *pAgentCtx)
+{
+    (void)pAgentCtx;
+
+    return kOTA_Err_None;
+}
+
+
+/* [] END OF FILE */
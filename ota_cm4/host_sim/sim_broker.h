@@ -0,0 +1,98 @@
+/******************************************************************************
+* File Name: sim_broker.h
+*
+* Description: This file contains the macros, structures and function
+* declarations of the MQTT broker stand-in of the host OTA simulation.
+*
+* Related Document: See README.md
+*
+*******************************************************************************
+* (c) 2020, Cypress Semiconductor Corporation. All rights reserved.
+*******************************************************************************
+* This software, including source code, documentation and related materials
+* ("Software"), is owned by Cypress Semiconductor Corporation or one of its
+* subsidiaries ("Cypress") and is protected by and subject to worldwide patent
+* protection (United States and foreign), United States copyright laws and
+* international treaty provisions. Therefore, you may use this Software only
+* as provided in the license agreement accompanying the software package from
+* which you obtained this Software ("EULA").
+*
+* If no EULA applies, Cypress hereby grants you a personal, non-exclusive,
+* non-transferable license to copy, modify, and compile the Software source
+* code solely for use in connection with Cypress's integrated circuit products.
+* Any reproduction, modification, translation, compilation, or representation
+* of this Software except as specified above is prohibited without the express
+* written permission of Cypress.
+*
+* Disclaimer: THIS SOFTWARE IS PROVIDED AS-IS, WITH NO WARRANTY OF ANY KIND,
+* EXPRESS OR IMPLIED, INCLUDING, BUT NOT LIMITED TO, NONINFRINGEMENT, IMPLIED
+* WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE. Cypress
+* reserves the right to make changes to the Software without notice. Cypress
+* does not assume any liability arising out of the application or use of the
+* Software or any product or circuit described in the Software. Cypress does
+* not authorize its products for use in any products where a malfunction or
+* failure of the Cypress product may reasonably be expected to result in
+* significant property damage, injury or death ("High Risk Product"). By
+* including Cypress's product in a High Risk Product, the manufacturer of such
+* system or application assumes all risk of such use and in doing so agrees to
+* indemnify Cypress against all liability.
+*******************************************************************************/
+#ifndef SIM_BROKER_H
+#define SIM_BROKER_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+
+/*******************************************************************************
+ * Macros
+ ******************************************************************************/
+#define SIM_BROKER_JOB_ID               "AFR_OTA-sim"
+#define SIM_BROKER_STREAM_NAME          "sim-stream"
+#define SIM_BROKER_FILE_PATH            "afr-example-ota.bin"
+#define SIM_BROKER_CERT_FILE            "codesigner_cert"
+#define SIM_BROKER_FILE_ID              (0)
+
+/* Subscriptions held at once by the device */
+#define SIM_BROKER_SUBSCRIPTIONS        (16U)
+
+/* Largest block served, as the stream service */
+#define SIM_BROKER_BLOCK_SIZE_MAX       (128U * 1024U)
+
+#define SIM_BROKER_STATUS_SIZE          (32U)
+
+
+/*******************************************************************************
+ * Data structure and enumeration
+ ******************************************************************************/
+typedef struct
+{
+    uint32_t job_requests;          /* Job documents requested */
+    uint32_t stream_requests;       /* Block requests received */
+    uint32_t bad_requests;          /* Block requests not understood */
+    uint32_t blocks_served;         /* Blocks sent, dropped ones included */
+    uint64_t bytes_served;          /* Payload bytes of those blocks */
+    uint32_t status_updates;        /* Job status updates received */
+    char last_status[SIM_BROKER_STATUS_SIZE];
+} sim_broker_stats_t;
+
+
+/*******************************************************************************
+ * Function prototypes
+ ******************************************************************************/
+bool sim_broker_init(const uint8_t *image, size_t size);
+void *sim_broker_connection(void);
+
+void sim_broker_deliver(const char *topic, size_t topic_len,
+                        const uint8_t *payload, size_t len, int qos);
+void sim_broker_receive(const char *topic, size_t topic_len,
+                        const uint8_t *payload, size_t len, int qos);
+
+void sim_broker_get_stats(sim_broker_stats_t *stats);
+
+
+#endif /* SIM_BROKER_H */
+
+
+/* [] END OF FILE */
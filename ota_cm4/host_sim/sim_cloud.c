@@ -0,0 +1,576 @@
+/******************************************************************************
+* File Name: sim_cloud.c
+*
+* Description: This file implements the cloud stand-in of the host LAN
+* simulations: an HTTP range server on a rate-limited link shared by all
+* devices, and the ranged GET client of the devices, with the checks of
+* ota_http_stream.c. Optionally, each response waits for a round trip, and
+* each connection is limited to one TCP window per round trip.
+*
+* Related Document: See README.md
+*
+*******************************************************************************
+* (c) 2020, Cypress Semiconductor Corporation. All rights reserved.
+*******************************************************************************
+* This software, including source code, documentation and related materials
+* ("Software"), is owned by Cypress Semiconductor Corporation or one of its
+* subsidiaries ("Cypress") and is protected by and subject to worldwide patent
+* protection (United States and foreign), United States copyright laws and
+* international treaty provisions. Therefore, you may use this Software only
+* as provided in the license agreement accompanying the software package from
+* which you obtained this Software ("EULA").
+*
+* If no EULA applies, Cypress hereby grants you a personal, non-exclusive,
+* non-transferable license to copy, modify, and compile the Software source
+* code solely for use in connection with Cypress's integrated circuit products.
+* Any reproduction, modification, translation, compilation, or representation
+* of this Software except as specified above is prohibited without the express
+* written permission of Cypress.
+*
+* Disclaimer: THIS SOFTWARE IS PROVIDED AS-IS, WITH NO WARRANTY OF ANY KIND,
+* EXPRESS OR IMPLIED, INCLUDING, BUT NOT LIMITED TO, NONINFRINGEMENT, IMPLIED
+* WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE. Cypress
+* reserves the right to make changes to the Software without notice. Cypress
+* does not assume any liability arising out of the application or use of the
+* Software or any product or circuit described in the Software. Cypress does
+* not authorize its products for use in any products where a malfunction or
+* failure of the Cypress product may reasonably be expected to result in
+* significant property damage, injury or death ("High Risk Product"). By
+* including Cypress's product in a High Risk Product, the manufacturer of such
+* system or application assumes all risk of such use and in doing so agrees to
+* indemnify Cypress against all liability.
+*******************************************************************************/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <pthread.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include "sim_cloud.h"
+
+
+/*******************************************************************************
+ * Macros
+ ******************************************************************************/
+#define SIM_CHUNK_SIZE                  (1024U)
+#define SIM_HEADER_SIZE                 (1024U)
+#define SIM_RECV_TIMEOUT_S              (5)
+#define SIM_CLOUD_BACKLOG               (64)
+
+
+/*******************************************************************************
+ * Global variables
+ ******************************************************************************/
+static const uint8_t *cloud_image;
+static uint32_t cloud_image_size;
+static uint32_t cloud_kbps;
+static uint32_t cloud_rtt_ms;
+static uint32_t cloud_window;
+
+/* Cloud link shared by the connections of all devices */
+static pthread_mutex_t cloud_lock = PTHREAD_MUTEX_INITIALIZER;
+static uint64_t cloud_free_ns;
+static uint64_t cloud_bytes;
+
+
+/*******************************************************************************
+ * Function Name: sim_make_image
+ *******************************************************************************
+ * Summary:
+ *  Generates the image and the signature of the job from the seed, the same
+ *  in every process.
+ *
+ * Parameters:
+ *  seed - seed of the image
+ *  size - size of the image
+ *  signature - set to the signature of the job
+ *
+ * Return:
+ *  uint8_t* - image, allocated with malloc(), or NULL
+ *
+ ******************************************************************************/
+uint8_t *sim_make_image(uint64_t seed, uint32_t size, uint8_t signature[SIM_SIGNATURE_SIZE])
+{
+    uint64_t x = (seed * 0x9e3779b97f4a7c15ULL) | 1U;
+    uint8_t *image = malloc(size);
+
+    if (NULL == image)
+    {
+        return NULL;
+    }
+
+    for (uint32_t i = 0U; i < (size + SIM_SIGNATURE_SIZE); i++)
+    {
+        x ^= x << 13;
+        x ^= x >> 7;
+        x ^= x << 17;
+
+        if (i < size)
+        {
+            image[i] = (uint8_t)(x >> 56);
+        }
+        else
+        {
+            signature[i - size] = (uint8_t)(x >> 56);
+        }
+    }
+
+    return image;
+}
+
+
+/*******************************************************************************
+ * Function Name: sim_now_ns
+ ******************************************************************************/
+uint64_t sim_now_ns(void)
+{
+    struct timespec ts;
+
+    (void)clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    return ((uint64_t)ts.tv_sec * NS_PER_S) + (uint64_t)ts.tv_nsec;
+}
+
+
+/*******************************************************************************
+ * Function Name: sleep_ns
+ ******************************************************************************/
+static void sleep_ns(uint64_t wait)
+{
+    struct timespec ts;
+
+    ts.tv_sec = (time_t)(wait / NS_PER_S);
+    ts.tv_nsec = (long)(wait % NS_PER_S);
+    (void)nanosleep(&ts, NULL);
+}
+
+
+/*******************************************************************************
+ * Function Name: send_all
+ ******************************************************************************/
+static bool send_all(int sock, const void *data, size_t len)
+{
+    const uint8_t *p = (const uint8_t *)data;
+
+    while (len > 0U)
+    {
+        ssize_t sent = send(sock, p, len, MSG_NOSIGNAL);
+
+        if (sent <= 0)
+        {
+            return false;
+        }
+
+        p += sent;
+        len -= (size_t)sent;
+    }
+
+    return true;
+}
+
+
+/*******************************************************************************
+ * Function Name: recv_header
+ *******************************************************************************
+ * Summary:
+ *  Receives an HTTP header.
+ *
+ * Parameters:
+ *  sock - socket
+ *  buffer - SIM_HEADER_SIZE + 1 bytes, NUL terminated on return
+ *  len - set to the number of bytes received, header and start of the body
+ *
+ * Return:
+ *  char* - first byte after the header, or NULL on error
+ *
+ ******************************************************************************/
+static char *recv_header(int sock, char *buffer, size_t *len)
+{
+    *len = 0U;
+
+    while (*len < SIM_HEADER_SIZE)
+    {
+        ssize_t got = recv(sock, &buffer[*len], SIM_HEADER_SIZE - *len, 0);
+        char *end;
+
+        if (got <= 0)
+        {
+            return NULL;
+        }
+
+        *len += (size_t)got;
+        buffer[*len] = '\0';
+
+        end = strstr(buffer, "\r\n\r\n");
+        if (NULL != end)
+        {
+            return end + 4;
+        }
+    }
+
+    return NULL;
+}
+
+
+/*******************************************************************************
+ * Function Name: cloud_send
+ *******************************************************************************
+ * Summary:
+ *  Sends bytes of the image at the rate of the cloud link, shared by all
+ *  connections, and at most one TCP window per round trip on the connection.
+ *
+ * Parameters:
+ *  sock - socket of the connection
+ *  first - first byte
+ *  last - last byte
+ *  conn_free_ns - time at which the window of the connection lets the next
+ *                 byte go
+ *
+ ******************************************************************************/
+static bool cloud_send(int sock, uint32_t first, uint32_t last, uint64_t *conn_free_ns)
+{
+    for (uint32_t off = first; off <= last; off += SIM_CHUNK_SIZE)
+    {
+        uint32_t chunk = ((last - off + 1U) < SIM_CHUNK_SIZE) ? (last - off + 1U) : SIM_CHUNK_SIZE;
+
+        if ((0U != cloud_window) && (0U != cloud_rtt_ms))
+        {
+            uint64_t now = sim_now_ns();
+
+            if (*conn_free_ns > now)
+            {
+                sleep_ns(*conn_free_ns - now);
+            }
+            else
+            {
+                *conn_free_ns = now;
+            }
+            *conn_free_ns += ((uint64_t)chunk * cloud_rtt_ms * (NS_PER_S / MS_PER_S)) / cloud_window;
+        }
+
+        if (0U != cloud_kbps)
+        {
+            uint64_t now = sim_now_ns();
+            uint64_t start;
+
+            (void)pthread_mutex_lock(&cloud_lock);
+            start = (cloud_free_ns > now) ? cloud_free_ns : now;
+            cloud_free_ns = start + ((chunk * BITS_PER_BYTE * NS_PER_S) / (cloud_kbps * BITS_PER_KBIT));
+            (void)pthread_mutex_unlock(&cloud_lock);
+
+            if (cloud_free_ns > now)
+            {
+                sleep_ns(cloud_free_ns - now);
+            }
+        }
+
+        if (!send_all(sock, &cloud_image[off], chunk))
+        {
+            return false;
+        }
+
+        (void)pthread_mutex_lock(&cloud_lock);
+        cloud_bytes += chunk;
+        (void)pthread_mutex_unlock(&cloud_lock);
+    }
+
+    return true;
+}
+
+
+/*******************************************************************************
+ * Function Name: cloud_conn_thread
+ *******************************************************************************
+ * Summary:
+ *  Serves the ranged GETs of one connection to the cloud.
+ *
+ ******************************************************************************/
+static void *cloud_conn_thread(void *arg)
+{
+    int sock = (int)(intptr_t)arg;
+    char buffer[SIM_HEADER_SIZE + 1U];
+    char response[SIM_HEADER_SIZE];
+    uint64_t conn_free_ns = 0U;
+    size_t len;
+
+    while (NULL != recv_header(sock, buffer, &len))
+    {
+        const char *range = strcasestr(buffer, "\r\nRange: bytes=");
+        unsigned long first = 0UL;
+        unsigned long last = cloud_image_size - 1U;
+        int header_len;
+
+        if ((0 != strncmp(buffer, "GET " SIM_CLOUD_PATH " ", strlen("GET " SIM_CLOUD_PATH " "))) ||
+            (NULL == range) ||
+            (2 != sscanf(&range[strlen("\r\nRange: bytes=")], "%lu-%lu", &first, &last)) ||
+            (first > last) || (last >= cloud_image_size))
+        {
+            static const char refused[] = "HTTP/1.1 416 Range Not Satisfiable\r\n"
+                                          "Content-Length: 0\r\nConnection: close\r\n\r\n";
+
+            (void)send_all(sock, refused, sizeof(refused) - 1U);
+            break;
+        }
+
+        if (0U != cloud_rtt_ms)
+        {
+            /* The request reaches the server, and the response the device,
+             * after half a round trip each.
+             */
+            sleep_ns((uint64_t)cloud_rtt_ms * (NS_PER_S / MS_PER_S));
+        }
+
+        header_len = snprintf(response, sizeof(response),
+                              "HTTP/1.1 206 Partial Content\r\n"
+                              "Content-Range: bytes %lu-%lu/%lu\r\n"
+                              "Content-Length: %lu\r\n\r\n",
+                              first, last, (unsigned long)cloud_image_size, last - first + 1UL);
+
+        if (!send_all(sock, response, (size_t)header_len) ||
+            !cloud_send(sock, (uint32_t)first, (uint32_t)last, &conn_free_ns))
+        {
+            break;
+        }
+    }
+
+    (void)close(sock);
+
+    return NULL;
+}
+
+
+/*******************************************************************************
+ * Function Name: cloud_accept_thread
+ *******************************************************************************
+ * Summary:
+ *  Accepts the connections to the cloud.
+ *
+ ******************************************************************************/
+static void *cloud_accept_thread(void *arg)
+{
+    int listen_sock = (int)(intptr_t)arg;
+
+    while (true)
+    {
+        int sock = accept(listen_sock, NULL, NULL);
+        pthread_t thread;
+
+        if (sock < 0)
+        {
+            if (EINTR == errno)
+            {
+                continue;
+            }
+            return NULL;
+        }
+
+        if (0 != pthread_create(&thread, NULL, cloud_conn_thread, (void *)(intptr_t)sock))
+        {
+            (void)close(sock);
+            continue;
+        }
+        (void)pthread_detach(thread);
+    }
+}
+
+
+/*******************************************************************************
+ * Function Name: sim_cloud_start
+ *******************************************************************************
+ * Summary:
+ *  Serves the image on a loopback port, over a link of the given rate shared
+ *  by all connections.
+ *
+ * Parameters:
+ *  image - image served
+ *  size - size of the image
+ *  kbps - rate of the link, 0 unlimited
+ *  port - set to the port of the server
+ *
+ * Return:
+ *  bool - true on success
+ *
+ ******************************************************************************/
+bool sim_cloud_start(const uint8_t *image, uint32_t size, uint32_t kbps, uint16_t *port)
+{
+    struct sockaddr_in addr;
+    socklen_t addr_len = sizeof(addr);
+    pthread_t thread;
+    int listen_sock = socket(AF_INET, SOCK_STREAM, 0);
+
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+
+    if ((listen_sock < 0) || (0 != bind(listen_sock, (struct sockaddr *)&addr, sizeof(addr))) ||
+        (0 != listen(listen_sock, SIM_CLOUD_BACKLOG)) ||
+        (0 != getsockname(listen_sock, (struct sockaddr *)&addr, &addr_len)))
+    {
+        return false;
+    }
+
+    cloud_image = image;
+    cloud_image_size = size;
+    cloud_kbps = kbps;
+    *port = ntohs(addr.sin_port);
+
+    return 0 == pthread_create(&thread, NULL, cloud_accept_thread, (void *)(intptr_t)listen_sock);
+}
+
+
+/*******************************************************************************
+ * Function Name: sim_cloud_path
+ *******************************************************************************
+ * Summary:
+ *  Sets the path between the devices and the cloud: the round trip waited
+ *  before each response, and the TCP window of the devices, which limits each
+ *  connection to one window per round trip. Call before sim_cloud_start().
+ *
+ * Parameters:
+ *  rtt_ms - round trip, 0 none
+ *  window - TCP window in bytes, 0 unlimited
+ *
+ ******************************************************************************/
+void sim_cloud_path(uint32_t rtt_ms, uint32_t window)
+{
+    cloud_rtt_ms = rtt_ms;
+    cloud_window = window;
+}
+
+
+/*******************************************************************************
+ * Function Name: sim_cloud_bytes
+ *******************************************************************************
+ * Summary:
+ *  Counts the bytes of the image sent by the cloud so far.
+ *
+ ******************************************************************************/
+uint64_t sim_cloud_bytes(void)
+{
+    uint64_t bytes;
+
+    (void)pthread_mutex_lock(&cloud_lock);
+    bytes = cloud_bytes;
+    (void)pthread_mutex_unlock(&cloud_lock);
+
+    return bytes;
+}
+
+
+/*******************************************************************************
+ * Function Name: sim_link_close
+ ******************************************************************************/
+void sim_link_close(sim_link_t *link)
+{
+    if (link->socket >= 0)
+    {
+        (void)close(link->socket);
+        link->socket = -1;
+    }
+}
+
+
+/*******************************************************************************
+ * Function Name: sim_link_get_range
+ *******************************************************************************
+ * Summary:
+ *  Fetches a range of the image with a ranged GET on a persistent
+ *  connection, opened if needed, with the checks of ota_http_stream.c.
+ *
+ * Parameters:
+ *  link - connection to the cloud or to a peer
+ *  file_size - size of the image
+ *  off - offset of the range
+ *  len - size of the range
+ *  dst - set to the bytes of the range
+ *
+ * Return:
+ *  bool - true if the whole range was received
+ *
+ ******************************************************************************/
+bool sim_link_get_range(sim_link_t *link, uint32_t file_size, uint32_t off, uint32_t len, uint8_t *dst)
+{
+    char buffer[SIM_HEADER_SIZE + 1U];
+    const char *value;
+    size_t header_len;
+    uint32_t received;
+    char *body;
+    int request_len;
+
+    if (link->socket < 0)
+    {
+        struct sockaddr_in addr;
+        struct timeval timeout = { SIM_RECV_TIMEOUT_S, 0 };
+
+        memset(&addr, 0, sizeof(addr));
+        addr.sin_family = AF_INET;
+        addr.sin_addr.s_addr = link->address;
+        addr.sin_port = htons(link->port);
+
+        link->socket = socket(AF_INET, SOCK_STREAM, 0);
+        if ((link->socket < 0) ||
+            (0 != setsockopt(link->socket, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout))) ||
+            (0 != connect(link->socket, (struct sockaddr *)&addr, sizeof(addr))))
+        {
+            sim_link_close(link);
+            return false;
+        }
+    }
+
+    request_len = snprintf(buffer, sizeof(buffer),
+                           "GET %s HTTP/1.1\r\n"
+                           "Host: 127.0.0.1\r\n"
+                           "Range: bytes=%u-%u\r\n"
+                           "Connection: keep-alive\r\n\r\n",
+                           link->path, (unsigned int)off, (unsigned int)(off + len - 1U));
+
+    if (!send_all(link->socket, buffer, (size_t)request_len) ||
+        (NULL == (body = recv_header(link->socket, buffer, &header_len))) ||
+        (0 != strncmp(buffer, "HTTP/1.1 206", 12U)) ||
+        (NULL == (value = strcasestr(buffer, "\r\nContent-Range: bytes "))) ||
+        (strtoul(&value[strlen("\r\nContent-Range: bytes ")], NULL, 10) != off) ||
+        (NULL == (value = strchr(value, '/'))) || (strtoul(&value[1], NULL, 10) != file_size) ||
+        (NULL == (value = strcasestr(buffer, "\r\nContent-Length: "))) ||
+        (strtoul(&value[strlen("\r\nContent-Length: ")], NULL, 10) != len))
+    {
+        sim_link_close(link);
+        return false;
+    }
+
+    received = (uint32_t)(header_len - (size_t)(body - buffer));
+    if (received > len)
+    {
+        sim_link_close(link);
+        return false;
+    }
+    memcpy(dst, body, received);
+
+    while (received < len)
+    {
+        ssize_t got = recv(link->socket, &dst[received], len - received, 0);
+
+        if (got <= 0)
+        {
+            sim_link_close(link);
+            return false;
+        }
+
+        received += (uint32_t)got;
+    }
+
+    if (NULL != strcasestr(buffer, "\r\nConnection: close"))
+    {
+        sim_link_close(link);
+    }
+
+    return true;
+}
+
+
+/* [] END OF FILE */
@@ -0,0 +1,88 @@
+/******************************************************************************
+* File Name: sim_cloud.h
+*
+* Description: This file contains the macros, structures and function
+* declarations of the cloud stand-in of the host LAN simulations: an HTTP
+* range server on a rate-limited link shared by all devices, and the ranged
+* GET client of the devices.
+*
+* Related Document: See README.md
+*
+*******************************************************************************
+* (c) 2020, Cypress Semiconductor Corporation. All rights reserved.
+*******************************************************************************
+* This software, including source code, documentation and related materials
+* ("Software"), is owned by Cypress Semiconductor Corporation or one of its
+* subsidiaries ("Cypress") and is protected by and subject to worldwide patent
+* protection (United States and foreign), United States copyright laws and
+* international treaty provisions. Therefore, you may use this Software only
+* as provided in the license agreement accompanying the software package from
+* which you obtained this Software ("EULA").
+*
+* If no EULA applies, Cypress hereby grants you a personal, non-exclusive,
+* non-transferable license to copy, modify, and compile the Software source
+* code solely for use in connection with Cypress's integrated circuit products.
+* Any reproduction, modification, translation, compilation, or representation
+* of this Software except as specified above is prohibited without the express
+* written permission of Cypress.
+*
+* Disclaimer: THIS SOFTWARE IS PROVIDED AS-IS, WITH NO WARRANTY OF ANY KIND,
+* EXPRESS OR IMPLIED, INCLUDING, BUT NOT LIMITED TO, NONINFRINGEMENT, IMPLIED
+* WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE. Cypress
+* reserves the right to make changes to the Software without notice. Cypress
+* does not assume any liability arising out of the application or use of the
+* Software or any product or circuit described in the Software. Cypress does
+* not authorize its products for use in any products where a malfunction or
+* failure of the Cypress product may reasonably be expected to result in
+* significant property damage, injury or death ("High Risk Product"). By
+* including Cypress's product in a High Risk Product, the manufacturer of such
+* system or application assumes all risk of such use and in doing so agrees to
+* indemnify Cypress against all liability.
+*******************************************************************************/
+#ifndef SIM_CLOUD_H
+#define SIM_CLOUD_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+
+/*******************************************************************************
+ * Macros
+ ******************************************************************************/
+#define SIM_CLOUD_PATH                  "/image"
+#define SIM_SIGNATURE_SIZE              (64U)
+
+#define MS_PER_S                        (1000ULL)
+#define NS_PER_S                        (1000000000ULL)
+#define BITS_PER_BYTE                   (8ULL)
+#define BITS_PER_KBIT                   (1000ULL)
+
+
+/*******************************************************************************
+ * Data structure and enumeration
+ ******************************************************************************/
+typedef struct
+{
+    int socket;
+    uint32_t address;           /* Network byte order */
+    uint16_t port;
+    const char *path;
+} sim_link_t;
+
+
+/*******************************************************************************
+ * Function prototypes
+ ******************************************************************************/
+uint8_t *sim_make_image(uint64_t seed, uint32_t size, uint8_t signature[SIM_SIGNATURE_SIZE]);
+uint64_t sim_now_ns(void);
+bool sim_cloud_start(const uint8_t *image, uint32_t size, uint32_t kbps, uint16_t *port);
+void sim_cloud_path(uint32_t rtt_ms, uint32_t window);
+uint64_t sim_cloud_bytes(void);
+void sim_link_close(sim_link_t *link);
+bool sim_link_get_range(sim_link_t *link, uint32_t file_size, uint32_t off, uint32_t len, uint8_t *dst);
+
+
+#endif /* SIM_CLOUD_H */
+
+
+/* [] END OF FILE */
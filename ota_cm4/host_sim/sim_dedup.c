@@ -0,0 +1,523 @@
+/******************************************************************************
+* File Name: sim_dedup.c
+*
+* Description: Host simulation of the reuse of the chunks of the primary
+* image (sources/ota_dedup.c) by an OTA download.
+*
+* The simulation makes an MCUboot image for the primary slot and a new image
+* from it with --edits changes (bytes replaced, inserted or deleted) and a
+* new version. It appends the manifest to the new image with the script of
+* the release (scripts/ota_dedup_manifest.py), so that the chunking of the
+* script is checked against the one of the device. ota_dedup_apply() then
+* prepares the file against the RAM primary slot, fetching the footer and
+* the manifest from the file in memory. The blocks copied are checked
+* against the file, and the bytes left to download are reported against the
+* size of the file.
+*
+* Related Document: See README.md
+*
+*******************************************************************************
+* (c) 2020, Cypress Semiconductor Corporation. All rights reserved.
+*******************************************************************************
+* This software, including source code, documentation and related materials
+* ("Software"), is owned by Cypress Semiconductor Corporation or one of its
+* subsidiaries ("Cypress") and is protected by and subject to worldwide patent
+* protection (United States and foreign), United States copyright laws and
+* international treaty provisions. Therefore, you may use this Software only
+* as provided in the license agreement accompanying the software package from
+* which you obtained this Software ("EULA").
+*
+* If no EULA applies, Cypress hereby grants you a personal, non-exclusive,
+* non-transferable license to copy, modify, and compile the Software source
+* code solely for use in connection with Cypress's integrated circuit products.
+* Any reproduction, modification, translation, compilation, or representation
+* of this Software except as specified above is prohibited without the express
+* written permission of Cypress.
+*
+* Disclaimer: THIS SOFTWARE IS PROVIDED AS-IS, WITH NO WARRANTY OF ANY KIND,
+* EXPRESS OR IMPLIED, INCLUDING, BUT NOT LIMITED TO, NONINFRINGEMENT, IMPLIED
+* WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE. Cypress
+* reserves the right to make changes to the Software without notice. Cypress
+* does not assume any liability arising out of the application or use of the
+* Software or any product or circuit described in the Software. Cypress does
+* not authorize its products for use in any products where a malfunction or
+* failure of the Cypress product may reasonably be expected to result in
+* significant property damage, injury or death ("High Risk Product"). By
+* including Cypress's product in a High Risk Product, the manufacturer of such
+* system or application assumes all risk of such use and in doing so agrees to
+* indemnify Cypress against all liability.
+*******************************************************************************/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <getopt.h>
+#include <unistd.h>
+#include <time.h>
+#include "FreeRTOS.h"
+#include "aws_iot_ota_pal.h"
+#include "bootutil/image.h"
+#include "sim_peer_port.h"
+#include "ota_block_size.h"
+#include "ota_dedup.h"
+
+
+/*******************************************************************************
+ * Macros
+ ******************************************************************************/
+#define SIM_DEFAULT_SIZE                (512U * 1024U)
+#define SIM_DEFAULT_SEED                (1U)
+#define SIM_DEFAULT_EDITS               (8U)
+#define SIM_DEFAULT_EDIT_BYTES          (256U)
+#define SIM_DEFAULT_SCRIPT              "../scripts/ota_dedup_manifest.py"
+
+/* Image layout, as made by the signing script of the OTA app */
+#define SIM_HEADER_SIZE                 (0x400U)
+#define SIM_SHA256_SIZE                 (32U)
+#define SIM_TLV_SIZE                    (sizeof(struct image_tlv_info) + sizeof(struct image_tlv) + \
+                                         SIM_SHA256_SIZE)
+
+#define SIM_COMMAND_SIZE                (1024U)
+#define SIM_EDIT_KINDS                  (3U)
+#define PERCENT                         (100U)
+#define MS_PER_S                        (1000.0)
+#define NS_PER_MS                       (1000000.0)
+
+#define EXIT_USAGE                      (2)
+
+
+/*******************************************************************************
+ * Global variables
+ ******************************************************************************/
+static const struct option sim_options[] =
+{
+    { "size",                   required_argument, NULL, 's' },
+    { "seed",                   required_argument, NULL, 'S' },
+    { "edits",                  required_argument, NULL, 'e' },
+    { "edit-bytes",             required_argument, NULL, 'b' },
+    { "script",                 required_argument, NULL, 'p' },
+    { "verbose",                no_argument,       NULL, 'v' },
+    { "help",                   no_argument,       NULL, 'h' },
+    { NULL,                     0,                 NULL, 0 }
+};
+
+static uint32_t image_size = SIM_DEFAULT_SIZE;
+static uint64_t seed = SIM_DEFAULT_SEED;
+static uint32_t edits = SIM_DEFAULT_EDITS;
+static uint32_t edit_bytes = SIM_DEFAULT_EDIT_BYTES;
+static const char *script = SIM_DEFAULT_SCRIPT;
+static bool verbose;
+
+static uint64_t random_state;
+
+/* File of the job: the new image, its manifest and the footer */
+static uint8_t *file;
+static uint32_t file_size;
+static uint32_t fetched;
+static uint32_t fetches;
+
+static uint8_t *slot;
+
+
+/*******************************************************************************
+ * Function Name: sim_random
+ *******************************************************************************
+ * Summary:
+ *  Returns the next number of the xorshift sequence of --seed.
+ *
+ ******************************************************************************/
+static uint32_t sim_random(void)
+{
+    random_state ^= random_state << 13;
+    random_state ^= random_state >> 7;
+    random_state ^= random_state << 17;
+
+    return (uint32_t)(random_state >> 32);
+}
+
+
+/*******************************************************************************
+ * Function Name: sim_fill
+ ******************************************************************************/
+static void sim_fill(uint8_t *data, uint32_t len)
+{
+    for (uint32_t i = 0U; i < len; i++)
+    {
+        data[i] = (uint8_t)sim_random();
+    }
+}
+
+
+/*******************************************************************************
+ * Function Name: sim_make_image
+ *******************************************************************************
+ * Summary:
+ *  Wraps a body in an MCUboot image: header, body and a TLV area with a
+ *  SHA-256 entry.
+ *
+ * Parameters:
+ *  body - body of the image
+ *  body_len - size of the body
+ *  minor - minor version of the image
+ *  len - set to the size of the image
+ *
+ * Return:
+ *  uint8_t* - image, to free, or NULL
+ *
+ ******************************************************************************/
+static uint8_t *sim_make_image(const uint8_t *body, uint32_t body_len, uint8_t minor, uint32_t *len)
+{
+    struct image_header hdr = { 0 };
+    struct image_tlv_info info = { IMAGE_TLV_INFO_MAGIC, SIM_TLV_SIZE };
+    struct image_tlv tlv = { IMAGE_TLV_SHA256, SIM_SHA256_SIZE };
+    uint8_t *image;
+    uint32_t off = SIM_HEADER_SIZE + body_len;
+
+    *len = off + SIM_TLV_SIZE;
+    image = calloc(1U, *len);
+    if (NULL == image)
+    {
+        return NULL;
+    }
+
+    hdr.ih_magic = IMAGE_MAGIC;
+    hdr.ih_hdr_size = SIM_HEADER_SIZE;
+    hdr.ih_img_size = body_len;
+    hdr.ih_ver.iv_major = 1U;
+    hdr.ih_ver.iv_minor = minor;
+
+    memcpy(image, &hdr, sizeof(hdr));
+    memcpy(&image[SIM_HEADER_SIZE], body, body_len);
+    memcpy(&image[off], &info, sizeof(info));
+    memcpy(&image[off + sizeof(info)], &tlv, sizeof(tlv));
+    sim_fill(&image[off + sizeof(info) + sizeof(tlv)], SIM_SHA256_SIZE);
+
+    return image;
+}
+
+
+/*******************************************************************************
+ * Function Name: sim_edit
+ *******************************************************************************
+ * Summary:
+ *  Makes the body of the new image: the old body with --edits changes of 1
+ *  to --edit-bytes bytes each, replaced, inserted or deleted at random
+ *  places.
+ *
+ * Parameters:
+ *  body - old body
+ *  body_len - size of the old body
+ *  new_len - set to the size of the new body
+ *
+ * Return:
+ *  uint8_t* - new body, to free, or NULL
+ *
+ ******************************************************************************/
+static uint8_t *sim_edit(const uint8_t *body, uint32_t body_len, uint32_t *new_len)
+{
+    uint8_t *out = malloc(body_len + (edits * edit_bytes));
+    uint32_t len = body_len;
+
+    if (NULL == out)
+    {
+        return NULL;
+    }
+
+    memcpy(out, body, body_len);
+
+    for (uint32_t i = 0U; i < edits; i++)
+    {
+        uint32_t count = 1U + (sim_random() % edit_bytes);
+        uint32_t at = sim_random() % len;
+
+        switch (sim_random() % SIM_EDIT_KINDS)
+        {
+            case 0U:
+                count = ((len - at) < count) ? (len - at) : count;
+                sim_fill(&out[at], count);
+                break;
+            case 1U:
+                memmove(&out[at + count], &out[at], len - at);
+                sim_fill(&out[at], count);
+                len += count;
+                break;
+            default:
+                count = ((len - at - 1U) < count) ? (len - at - 1U) : count;
+                memmove(&out[at], &out[at + count], len - at - count);
+                len -= count;
+                break;
+        }
+    }
+
+    *new_len = len;
+
+    return out;
+}
+
+
+/*******************************************************************************
+ * Function Name: sim_append_manifest
+ *******************************************************************************
+ * Summary:
+ *  Runs the release script on the new image and loads the file it makes.
+ *
+ * Parameters:
+ *  image - new image
+ *  len - size of the image
+ *
+ * Return:
+ *  bool - true if the file was made
+ *
+ ******************************************************************************/
+static bool sim_append_manifest(const uint8_t *image, uint32_t len)
+{
+    char in_path[] = "/tmp/ota_dedup_simXXXXXX";
+    char out_path[sizeof(in_path) + 4U];
+    char command[SIM_COMMAND_SIZE];
+    FILE *f;
+    bool ok;
+    int fd = mkstemp(in_path);
+
+    if (fd < 0)
+    {
+        return false;
+    }
+
+    (void)snprintf(out_path, sizeof(out_path), "%s.out", in_path);
+    (void)snprintf(command, sizeof(command), "python3 %s %s %s%s", script, in_path, out_path,
+                   verbose ? "" : " > /dev/null");
+
+    ok = (write(fd, image, len) == (ssize_t)len);
+    (void)close(fd);
+    ok = ok && (0 == system(command));
+
+    f = ok ? fopen(out_path, "rb") : NULL;
+    if (NULL != f)
+    {
+        (void)fseek(f, 0L, SEEK_END);
+        file_size = (uint32_t)ftell(f);
+        (void)fseek(f, 0L, SEEK_SET);
+        file = malloc(file_size);
+        ok = (NULL != file) && (fread(file, 1U, file_size, f) == file_size);
+        (void)fclose(f);
+    }
+    else
+    {
+        ok = false;
+    }
+
+    (void)unlink(in_path);
+    (void)unlink(out_path);
+
+    return ok;
+}
+
+
+/*******************************************************************************
+ * Function Name: sim_fetch
+ *******************************************************************************
+ * Summary:
+ *  Reads bytes of the file for ota_dedup_apply(), as a ranged GET would.
+ *
+ ******************************************************************************/
+static bool sim_fetch(uint32_t off, uint8_t *buffer, uint32_t len)
+{
+    if ((off > file_size) || (len > (file_size - off)))
+    {
+        return false;
+    }
+
+    memcpy(buffer, &file[off], len);
+    fetched += len;
+    fetches++;
+
+    return true;
+}
+
+
+/*******************************************************************************
+ * Function Name: prvPAL_WriteBlock
+ *******************************************************************************
+ * Summary:
+ *  Writes a block copied from the primary slot to the secondary slot.
+ *
+ * Return:
+ *  int16_t - bytes written, -1 on error
+ *
+ ******************************************************************************/
+int16_t prvPAL_WriteBlock(OTA_FileContext_t * const C, uint32_t ulOffset, uint8_t * const pcData,
+                          uint32_t ulBlockSize)
+{
+    if ((ulOffset > C->ulFileSize) || (ulBlockSize > (C->ulFileSize - ulOffset)))
+    {
+        return -1;
+    }
+
+    memcpy(&slot[ulOffset], pcData, ulBlockSize);
+
+    return (int16_t)ulBlockSize;
+}
+
+
+/*******************************************************************************
+ * Function Name: usage
+ ******************************************************************************/
+static void usage(const char *name)
+{
+    fprintf(stderr,
+        "usage: %s [options]\n"
+        "  --size BYTES               size of the body of the image (default %u)\n"
+        "  --seed N                   seed of the images and edits (default %u)\n"
+        "  --edits N                  changes made to the new image (default %u)\n"
+        "  --edit-bytes BYTES         largest change (default %u)\n"
+        "  --script PATH              manifest script (default %s)\n"
+        "  --verbose                  print the log of the device\n",
+        name, SIM_DEFAULT_SIZE, SIM_DEFAULT_SEED, SIM_DEFAULT_EDITS, SIM_DEFAULT_EDIT_BYTES,
+        SIM_DEFAULT_SCRIPT);
+}
+
+
+/*******************************************************************************
+ * Function Name: main
+ ******************************************************************************/
+int main(int argc, char *argv[])
+{
+    OTA_FileContext_t C = { 0 };
+    ota_dedup_stats_t stats;
+    struct timespec start;
+    struct timespec end;
+    uint8_t *body;
+    uint8_t *new_body;
+    uint8_t *primary;
+    uint8_t *image;
+    uint32_t new_body_len;
+    uint32_t primary_len;
+    uint32_t image_len;
+    uint32_t units;
+    uint32_t missing = 0U;
+    uint32_t mismatched = 0U;
+    uint32_t download;
+    int opt;
+
+    while (-1 != (opt = getopt_long(argc, argv, "", sim_options, NULL)))
+    {
+        switch (opt)
+        {
+            case 's':
+                image_size = (uint32_t)strtoul(optarg, NULL, 0);
+                break;
+            case 'S':
+                seed = strtoull(optarg, NULL, 0);
+                break;
+            case 'e':
+                edits = (uint32_t)strtoul(optarg, NULL, 0);
+                break;
+            case 'b':
+                edit_bytes = (uint32_t)strtoul(optarg, NULL, 0);
+                break;
+            case 'p':
+                script = optarg;
+                break;
+            case 'v':
+                verbose = true;
+                break;
+            default:
+                usage(argv[0]);
+                return EXIT_USAGE;
+        }
+    }
+
+    if ((optind != argc) || (image_size < (2U * OTA_BLOCK_UNIT_SIZE)) || (0U == edit_bytes))
+    {
+        usage(argv[0]);
+        return EXIT_USAGE;
+    }
+
+    random_state = (seed * 0x9e3779b97f4a7c15ULL) | 1U;
+
+    body = malloc(image_size);
+    if (NULL == body)
+    {
+        return EXIT_FAILURE;
+    }
+
+    sim_fill(body, image_size);
+    new_body = sim_edit(body, image_size, &new_body_len);
+    primary = sim_make_image(body, image_size, 0U, &primary_len);
+    image = (NULL != new_body) ? sim_make_image(new_body, new_body_len, 1U, &image_len) : NULL;
+
+    if ((NULL == primary) || (NULL == image) || !sim_append_manifest(image, image_len))
+    {
+        fprintf(stderr, "cannot make the images\n");
+        return EXIT_FAILURE;
+    }
+
+    /* The device: primary image, empty secondary slot, nothing received */
+    units = (file_size + OTA_BLOCK_UNIT_SIZE - 1U) / OTA_BLOCK_UNIT_SIZE;
+    slot = calloc(1U, file_size);
+    C.ulFileSize = file_size;
+    C.ulBlocksRemaining = units;
+    C.pucRxBlockBitmap = malloc((units + 7U) / 8U);
+
+    if ((NULL == slot) || (NULL == C.pucRxBlockBitmap))
+    {
+        return EXIT_FAILURE;
+    }
+
+    memset(C.pucRxBlockBitmap, 0xFF, (units + 7U) / 8U);
+    sim_peer_port_init(slot, file_size, "device", verbose);
+    sim_peer_port_primary(primary, primary_len);
+
+    (void)clock_gettime(CLOCK_MONOTONIC, &start);
+    ota_dedup_apply(&C, sim_fetch, &stats);
+    (void)clock_gettime(CLOCK_MONOTONIC, &end);
+
+    /* The blocks copied must hold the bytes of the file */
+    download = fetched;
+    for (uint32_t unit = 0U; unit < units; unit++)
+    {
+        uint32_t off = unit * OTA_BLOCK_UNIT_SIZE;
+        uint32_t len = ((file_size - off) < OTA_BLOCK_UNIT_SIZE) ? (file_size - off) : OTA_BLOCK_UNIT_SIZE;
+
+        if (0U != (C.pucRxBlockBitmap[unit / 8U] & (1U << (unit % 8U))))
+        {
+            missing++;
+            download += len;
+        }
+        else if (0 != memcmp(&slot[off], &file[off], len))
+        {
+            mismatched++;
+        }
+    }
+
+    printf("file_bytes=%u manifest_bytes=%u chunks=%u matched_chunks=%u\n",
+           (unsigned int)file_size, (unsigned int)(file_size - image_len),
+           (unsigned int)stats.chunks, (unsigned int)stats.matched);
+    printf("blocks=%u copied_blocks=%u mismatched_blocks=%u blocks_remaining=%u\n",
+           (unsigned int)units, (unsigned int)stats.units, (unsigned int)mismatched,
+           (unsigned int)C.ulBlocksRemaining);
+    printf("download_bytes=%u (%u%% of the file, %u bytes of footer and manifest in %u fetches) "
+           "prepare_ms=%.1f\n",
+           (unsigned int)download, (unsigned int)(((uint64_t)download * PERCENT) / file_size),
+           (unsigned int)fetched, (unsigned int)fetches,
+           ((double)(end.tv_sec - start.tv_sec) * MS_PER_S) +
+           ((double)(end.tv_nsec - start.tv_nsec) / NS_PER_MS));
+
+    if ((0U != mismatched) || (C.ulBlocksRemaining != missing))
+    {
+        printf("FAILED\n");
+        return EXIT_FAILURE;
+    }
+
+    free(body);
+    free(new_body);
+    free(primary);
+    free(image);
+    free(file);
+    free(slot);
+    free(C.pucRxBlockBitmap);
+
+    return EXIT_SUCCESS;
+}
+
+
+/* [] END OF FILE */
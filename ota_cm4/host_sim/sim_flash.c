@@ -0,0 +1,426 @@
+/******************************************************************************
+* File Name: sim_flash.c
+*
+* Description: Timed model of the external NOR flash of the host simulations.
+* The secondary slot is in RAM; each erase, program and read sleeps for the
+* time the S25FL512S of the kits takes, with the device busy meanwhile. A
+* program only clears bits, as in NOR flash: a byte programmed without an
+* erase is counted, and reads back wrong. The slot starts programmed to 0x00,
+* as with an earlier image. A second area of the device that the OTA app
+* opens itself, such as the checkpoint log of the resume, can be added by its
+* ID; it starts erased. With the untimed option, the times are only counted.
+*
+* Related Document: See README.md
+*
+*******************************************************************************
+* (c) 2020, Cypress Semiconductor Corporation. All rights reserved.
+*******************************************************************************
+* This software, including source code, documentation and related materials
+* ("Software"), is owned by Cypress Semiconductor Corporation or one of its
+* subsidiaries ("Cypress") and is protected by and subject to worldwide patent
+* protection (United States and foreign), United States copyright laws and
+* international treaty provisions. Therefore, you may use this Software only
+* as provided in the license agreement accompanying the software package from
+* which you obtained this Software ("EULA").
+*
+* If no EULA applies, Cypress hereby grants you a personal, non-exclusive,
+* non-transferable license to copy, modify, and compile the Software source
+* code solely for use in connection with Cypress's integrated circuit products.
+* Any reproduction, modification, translation, compilation, or representation
+* of this Software except as specified above is prohibited without the express
+* written permission of Cypress.
+*
+* Disclaimer: THIS SOFTWARE IS PROVIDED AS-IS, WITH NO WARRANTY OF ANY KIND,
+* EXPRESS OR IMPLIED, INCLUDING, BUT NOT LIMITED TO, NONINFRINGEMENT, IMPLIED
+* WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE. Cypress
+* reserves the right to make changes to the Software without notice. Cypress
+* does not assume any liability arising out of the application or use of the
+* Software or any product or circuit described in the Software. Cypress does
+* not authorize its products for use in any products where a malfunction or
+* failure of the Cypress product may reasonably be expected to result in
+* significant property damage, injury or death ("High Risk Product"). By
+* including Cypress's product in a High Risk Product, the manufacturer of such
+* system or application assumes all risk of such use and in doing so agrees to
+* indemnify Cypress against all liability.
+*******************************************************************************/
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <pthread.h>
+#include "flash_qspi.h"
+#include "sysflash/sysflash.h"
+#include "sim_peer_port.h"
+#include "sim_flash.h"
+
+
+/*******************************************************************************
+ * Macros
+ ******************************************************************************/
+#define US_PER_MS                       (1000U)
+#define US_PER_S                        (1000000ULL)
+#define NS_PER_US                       (1000U)
+#define BYTES_PER_S_PER_KBPS            (1000U / 8U)
+#define SIM_FLASH_EXTERNAL_INDEX        (1U)
+
+
+/*******************************************************************************
+ * Global variables
+ ******************************************************************************/
+static sim_flash_config_t flash_config;
+static uint8_t *flash_data;
+static struct flash_area flash_area;
+static uint8_t *extra_data;             /* Area added by sim_flash_add_area() */
+static uint8_t extra_id;
+static uint32_t extra_size;
+static sim_flash_stats_t flash_stats;
+static pthread_mutex_t flash_lock = PTHREAD_MUTEX_INITIALIZER;   /* Device busy */
+static cy_stc_smif_mem_device_cfg_t flash_device_cfg;
+static cy_stc_smif_mem_config_t flash_mem_config = { .deviceCfg = &flash_device_cfg };
+
+
+/*******************************************************************************
+ * Function Name: busy_us
+ *******************************************************************************
+ * Summary:
+ *  Keeps the device busy for an operation. Called with the device locked.
+ *
+ ******************************************************************************/
+static void busy_us(uint64_t us)
+{
+    struct timespec ts;
+
+    flash_stats.busy_us += us;
+    if (flash_config.untimed)
+    {
+        return;
+    }
+
+    ts.tv_sec = (time_t)(us / US_PER_S);
+    ts.tv_nsec = (long)((us % US_PER_S) * NS_PER_US);
+    (void)nanosleep(&ts, NULL);
+}
+
+
+/*******************************************************************************
+ * Function Name: area_data
+ *******************************************************************************
+ * Summary:
+ *  Finds the bytes of a range of the slot or of the added area.
+ *
+ * Return:
+ *  uint8_t * - first byte of the range, NULL if it is not in the device
+ *
+ ******************************************************************************/
+static uint8_t *area_data(const struct flash_area *fa, uint32_t off, uint32_t len)
+{
+    if ((fa == &flash_area) && (off <= flash_config.size) && (len <= (flash_config.size - off)))
+    {
+        return &flash_data[off];
+    }
+
+    if ((NULL != extra_data) && (fa->fa_id == extra_id) && (off <= extra_size) &&
+        (len <= (extra_size - off)))
+    {
+        return &extra_data[off];
+    }
+
+    return NULL;
+}
+
+
+/*******************************************************************************
+ * Function Name: area_read
+ *******************************************************************************
+ * Summary:
+ *  Reads the slot or the added area in the time of the data rate of the
+ *  reads.
+ *
+ ******************************************************************************/
+static int area_read(const struct flash_area *fa, uint32_t off, void *dst, uint32_t len)
+{
+    const uint8_t *data = area_data(fa, off, len);
+
+    if (NULL == data)
+    {
+        return -1;
+    }
+
+    (void)pthread_mutex_lock(&flash_lock);
+    flash_stats.reads++;
+    flash_stats.bytes_read += len;
+    if (0U != flash_config.read_kbps)
+    {
+        busy_us(((uint64_t)len * US_PER_S) /
+                ((uint64_t)flash_config.read_kbps * BYTES_PER_S_PER_KBPS));
+    }
+    memcpy(dst, data, len);
+    (void)pthread_mutex_unlock(&flash_lock);
+
+    return 0;
+}
+
+
+/*******************************************************************************
+ * Function Name: sim_flash_init
+ *******************************************************************************
+ * Summary:
+ *  Allocates the secondary slot, programmed to 0x00, sets it as the
+ *  secondary slot of peer_port, and clears the statistics. The added area
+ *  is dropped.
+ *
+ * Parameters:
+ *  config - geometry and times of the device
+ *
+ * Return:
+ *  bool - true on success
+ *
+ ******************************************************************************/
+bool sim_flash_init(const sim_flash_config_t *config)
+{
+    if ((0U == config->sector_size) || (0U == config->page_size) ||
+        ((config->size % config->sector_size) != 0U))
+    {
+        return false;
+    }
+
+    free(extra_data);
+    extra_data = NULL;
+    free(flash_data);
+    flash_data = malloc(config->size);
+    if (NULL == flash_data)
+    {
+        return false;
+    }
+
+    memset(flash_data, 0, config->size);
+    flash_config = *config;
+    flash_device_cfg.programSize = config->page_size;
+    flash_area.fa_id = FLASH_AREA_IMAGE_SECONDARY(0);
+    flash_area.fa_device_id = FLASH_DEVICE_EXTERNAL_FLASH(SIM_FLASH_EXTERNAL_INDEX);
+    flash_area.fa_off = 0U;
+    flash_area.fa_size = config->size;
+    sim_peer_port_flash(&flash_area, area_read);
+    sim_flash_reset_stats();
+
+    return true;
+}
+
+
+/*******************************************************************************
+ * Function Name: sim_flash_add_area
+ *******************************************************************************
+ * Summary:
+ *  Adds an area of the device, erased, that the flash areas with its ID are
+ *  read, erased and written in. Must be called after sim_flash_init(). The
+ *  area keeps its content until the next sim_flash_init().
+ *
+ * Parameters:
+ *  fa_id - flash area ID
+ *  size - size of the area, a multiple of the sector size
+ *
+ * Return:
+ *  bool - true on success
+ *
+ ******************************************************************************/
+bool sim_flash_add_area(uint8_t fa_id, uint32_t size)
+{
+    if ((NULL == flash_data) || (NULL != extra_data) || (0U == size) ||
+        ((size % flash_config.sector_size) != 0U))
+    {
+        return false;
+    }
+
+    extra_data = malloc(size);
+    if (NULL == extra_data)
+    {
+        return false;
+    }
+
+    memset(extra_data, SIM_FLASH_ERASED_VAL, size);
+    extra_id = fa_id;
+    extra_size = size;
+
+    return true;
+}
+
+
+/*******************************************************************************
+ * Function Name: sim_flash_area
+ ******************************************************************************/
+const struct flash_area *sim_flash_area(void)
+{
+    return &flash_area;
+}
+
+
+/*******************************************************************************
+ * Function Name: sim_flash_data
+ ******************************************************************************/
+const uint8_t *sim_flash_data(void)
+{
+    return flash_data;
+}
+
+
+/*******************************************************************************
+ * Function Name: sim_flash_fill
+ *******************************************************************************
+ * Summary:
+ *  Sets a range of the slot, without time, as left by earlier downloads.
+ *
+ ******************************************************************************/
+void sim_flash_fill(uint32_t off, uint32_t len, uint8_t val)
+{
+    uint8_t *data = area_data(&flash_area, off, len);
+
+    if (NULL != data)
+    {
+        (void)pthread_mutex_lock(&flash_lock);
+        memset(data, val, len);
+        (void)pthread_mutex_unlock(&flash_lock);
+    }
+}
+
+
+/*******************************************************************************
+ * Function Name: sim_flash_read
+ *******************************************************************************
+ * Summary:
+ *  Reads the slot in the time of the data rate of the reads.
+ *
+ ******************************************************************************/
+int sim_flash_read(uint32_t off, void *dst, uint32_t len)
+{
+    return area_read(&flash_area, off, dst, len);
+}
+
+
+/*******************************************************************************
+ * Function Name: sim_flash_get_stats
+ ******************************************************************************/
+void sim_flash_get_stats(sim_flash_stats_t *stats)
+{
+    (void)pthread_mutex_lock(&flash_lock);
+    *stats = flash_stats;
+    (void)pthread_mutex_unlock(&flash_lock);
+}
+
+
+/*******************************************************************************
+ * Function Name: sim_flash_reset_stats
+ ******************************************************************************/
+void sim_flash_reset_stats(void)
+{
+    (void)pthread_mutex_lock(&flash_lock);
+    memset(&flash_stats, 0, sizeof(flash_stats));
+    (void)pthread_mutex_unlock(&flash_lock);
+}
+
+
+/*******************************************************************************
+ * Function Name: flash_area_erase
+ *******************************************************************************
+ * Summary:
+ *  Erases whole sectors of the slot or of the added area, one erase time
+ *  each.
+ *
+ ******************************************************************************/
+int flash_area_erase(const struct flash_area *fa, uint32_t off, uint32_t len)
+{
+    uint8_t *data = area_data(fa, off, len);
+    uint32_t sectors;
+
+    if ((NULL == data) || ((off % flash_config.sector_size) != 0U) ||
+        ((len % flash_config.sector_size) != 0U))
+    {
+        return -1;
+    }
+
+    sectors = len / flash_config.sector_size;
+
+    (void)pthread_mutex_lock(&flash_lock);
+    flash_stats.erases += sectors;
+    busy_us((uint64_t)sectors * flash_config.erase_ms * US_PER_MS);
+    memset(data, SIM_FLASH_ERASED_VAL, len);
+    (void)pthread_mutex_unlock(&flash_lock);
+
+    return 0;
+}
+
+
+/*******************************************************************************
+ * Function Name: flash_area_write
+ *******************************************************************************
+ * Summary:
+ *  Programs a range of the slot or of the added area, one program time per
+ *  page it spans.
+ *
+ ******************************************************************************/
+int flash_area_write(const struct flash_area *fa, uint32_t off, const void *src, uint32_t len)
+{
+    const uint8_t *bytes = src;
+    uint8_t *data = area_data(fa, off, len);
+    uint32_t pages;
+
+    if (NULL == data)
+    {
+        return -1;
+    }
+
+    if (0U == len)
+    {
+        return 0;
+    }
+
+    pages = ((off + len - 1U) / flash_config.page_size) - (off / flash_config.page_size) + 1U;
+
+    (void)pthread_mutex_lock(&flash_lock);
+    flash_stats.pages += pages;
+    busy_us((uint64_t)pages * flash_config.page_us);
+    for (uint32_t i = 0U; i < len; i++)
+    {
+        if ((data[i] & bytes[i]) != bytes[i])
+        {
+            flash_stats.dirty++;
+        }
+        data[i] &= bytes[i];
+    }
+    (void)pthread_mutex_unlock(&flash_lock);
+
+    return 0;
+}
+
+
+/*******************************************************************************
+ * Function Name: flash_area_erased_val
+ ******************************************************************************/
+uint8_t flash_area_erased_val(const struct flash_area *fa)
+{
+    (void)fa;
+
+    return SIM_FLASH_ERASED_VAL;
+}
+
+
+/*******************************************************************************
+ * Function Name: qspi_get_erase_size
+ ******************************************************************************/
+uint32_t qspi_get_erase_size(void)
+{
+    return flash_config.sector_size;
+}
+
+
+
+/*******************************************************************************
+ * Function Name: qspi_get_memory_config
+ ******************************************************************************/
+cy_stc_smif_mem_config_t *qspi_get_memory_config(uint8_t index)
+{
+    (void)index;
+
+    return &flash_mem_config;
+}
+
+
+/* [] END OF FILE */
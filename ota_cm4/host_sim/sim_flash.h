@@ -0,0 +1,103 @@
+/******************************************************************************
+* File Name: sim_flash.h
+*
+* Description: This file contains the structures and function declarations of
+* the timed model of the external NOR flash of the host simulations. It holds
+* the secondary slot, and provides the erase and write of the flash map; the
+* flash map of peer_port opens and reads it.
+*
+* Related Document: See README.md
+*
+*******************************************************************************
+* (c) 2020, Cypress Semiconductor Corporation. All rights reserved.
+*******************************************************************************
+* This software, including source code, documentation and related materials
+* ("Software"), is owned by Cypress Semiconductor Corporation or one of its
+* subsidiaries ("Cypress") and is protected by and subject to worldwide patent
+* protection (United States and foreign), United States copyright laws and
+* international treaty provisions. Therefore, you may use this Software only
+* as provided in the license agreement accompanying the software package from
+* which you obtained this Software ("EULA").
+*
+* If no EULA applies, Cypress hereby grants you a personal, non-exclusive,
+* non-transferable license to copy, modify, and compile the Software source
+* code solely for use in connection with Cypress's integrated circuit products.
+* Any reproduction, modification, translation, compilation, or representation
+* of this Software except as specified above is prohibited without the express
+* written permission of Cypress.
+*
+* Disclaimer: THIS SOFTWARE IS PROVIDED AS-IS, WITH NO WARRANTY OF ANY KIND,
+* EXPRESS OR IMPLIED, INCLUDING, BUT NOT LIMITED TO, NONINFRINGEMENT, IMPLIED
+* WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE. Cypress
+* reserves the right to make changes to the Software without notice. Cypress
+* does not assume any liability arising out of the application or use of the
+* Software or any product or circuit described in the Software. Cypress does
+* not authorize its products for use in any products where a malfunction or
+* failure of the Cypress product may reasonably be expected to result in
+* significant property damage, injury or death ("High Risk Product"). By
+* including Cypress's product in a High Risk Product, the manufacturer of such
+* system or application assumes all risk of such use and in doing so agrees to
+* indemnify Cypress against all liability.
+*******************************************************************************/
+#ifndef SIM_FLASH_H
+#define SIM_FLASH_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "flash_map_backend/flash_map_backend.h"
+
+
+/*******************************************************************************
+ * Macros
+ ******************************************************************************/
+/* S25FL512S of the kits, typical times */
+#define SIM_FLASH_SECTOR_SIZE           (0x40000UL)
+#define SIM_FLASH_PAGE_SIZE             (512U)
+#define SIM_FLASH_ERASE_MS              (520U)
+#define SIM_FLASH_PAGE_US               (340U)
+#define SIM_FLASH_READ_KBPS             (100000U)
+#define SIM_FLASH_ERASED_VAL            (0xFFU)
+
+
+/*******************************************************************************
+ * Data structure and enumeration
+ ******************************************************************************/
+typedef struct
+{
+    uint32_t size;                  /* Secondary slot */
+    uint32_t sector_size;           /* Erase sector, in bytes */
+    uint32_t page_size;             /* Program page, in bytes */
+    uint32_t erase_ms;              /* Erase time of one sector */
+    uint32_t page_us;               /* Program time of one page */
+    uint32_t read_kbps;             /* Data rate of the reads, 0 for no time */
+    bool untimed;                   /* Count the times without sleeping */
+} sim_flash_config_t;
+
+typedef struct
+{
+    uint32_t erases;                /* Sectors erased */
+    uint32_t pages;                 /* Pages programmed */
+    uint32_t reads;
+    uint64_t bytes_read;
+    uint64_t busy_us;               /* Modeled time of all the operations */
+    uint32_t dirty;                 /* Bytes programmed without an erase */
+} sim_flash_stats_t;
+
+
+/*******************************************************************************
+ * Function prototypes
+ ******************************************************************************/
+bool sim_flash_init(const sim_flash_config_t *config);
+bool sim_flash_add_area(uint8_t fa_id, uint32_t size);
+const struct flash_area *sim_flash_area(void);
+const uint8_t *sim_flash_data(void);
+void sim_flash_fill(uint32_t off, uint32_t len, uint8_t val);
+int sim_flash_read(uint32_t off, void *dst, uint32_t len);
+void sim_flash_get_stats(sim_flash_stats_t *stats);
+void sim_flash_reset_stats(void);
+
+
+#endif /* SIM_FLASH_H */
+
+
+/* [] END OF FILE */
@@ -0,0 +1,402 @@
+/******************************************************************************
+* File Name: sim_flash_writer.c
+*
+* Description: Host simulation of the flash writer of the OTA app
+* (sources/ota_flash_writer.c). A file is received at the rate of the link,
+* one block of the agent at a time, and written to the secondary slot in the
+* timed model of the external flash (sim_flash.c), twice:
+*
+*  - inline: the whole slot is erased when the file is opened, then each block
+*    is written by the agent before it takes the next one, as the PAL does.
+*  - writer: the erase is deferred to the writer task, which erases ahead of
+*    the writes, and each block is queued for it. The sectors left are erased
+*    at the close.
+*
+* The times of the open, of the transfer and of the close are printed for
+* both, and the slot is checked against the file.
+*
+* Related Document: See README.md
+*
+*******************************************************************************
+* (c) 2020, Cypress Semiconductor Corporation. All rights reserved.
+*******************************************************************************
+* This software, including source code, documentation and related materials
+* ("Software"), is owned by Cypress Semiconductor Corporation or one of its
+* subsidiaries ("Cypress") and is protected by and subject to worldwide patent
+* protection (United States and foreign), United States copyright laws and
+* international treaty provisions. Therefore, you may use this Software only
+* as provided in the license agreement accompanying the software package from
+* which you obtained this Software ("EULA").
+*
+* If no EULA applies, Cypress hereby grants you a personal, non-exclusive,
+* non-transferable license to copy, modify, and compile the Software source
+* code solely for use in connection with Cypress's integrated circuit products.
+* Any reproduction, modification, translation, compilation, or representation
+* of this Software except as specified above is prohibited without the express
+* written permission of Cypress.
+*
+* Disclaimer: THIS SOFTWARE IS PROVIDED AS-IS, WITH NO WARRANTY OF ANY KIND,
+* EXPRESS OR IMPLIED, INCLUDING, BUT NOT LIMITED TO, NONINFRINGEMENT, IMPLIED
+* WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE. Cypress
+* reserves the right to make changes to the Software without notice. Cypress
+* does not assume any liability arising out of the application or use of the
+* Software or any product or circuit described in the Software. Cypress does
+* not authorize its products for use in any products where a malfunction or
+* failure of the Cypress product may reasonably be expected to result in
+* significant property damage, injury or death ("High Risk Product"). By
+* including Cypress's product in a High Risk Product, the manufacturer of such
+* system or application assumes all risk of such use and in doing so agrees to
+* indemnify Cypress against all liability.
+*******************************************************************************/
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <string.h>
+#include <time.h>
+#include <getopt.h>
+#include "FreeRTOS.h"
+#include "aws_ota_agent_config.h"
+#include "aws_iot_ota_agent.h"
+#include "ota_flash_writer.h"
+#include "sim_peer_port.h"
+#include "sim_flash.h"
+
+
+/*******************************************************************************
+ * Macros
+ ******************************************************************************/
+#define SIM_DEFAULT_SIZE                (1536U * 1024U)
+#define SIM_DEFAULT_SEED                (1U)
+#define SIM_DEFAULT_DOWN_KBPS           (4000U)
+#define SIM_SLOT_SIZE                   (0x1C0000UL)
+#define SIM_BLOCK_SIZE                  (1UL << otaconfigLOG2_FILE_BLOCK_SIZE)
+
+#define BYTES_PER_S_PER_KBPS            (1000U / 8U)
+#define NS_PER_S                        (1000000000ULL)
+#define NS_PER_MS                       (1000000ULL)
+
+#define EXIT_USAGE                      (2)
+
+
+/*******************************************************************************
+ * Data structure and enumeration
+ ******************************************************************************/
+/* Times of one run, in ms */
+typedef struct
+{
+    uint64_t open_ms;               /* Open of the file, with its erase */
+    uint64_t transfer_ms;           /* First block to the last one written */
+    uint64_t close_ms;              /* Flush of the writer, with the erases left */
+    uint64_t max_late_ms;           /* Longest wait of a block for the agent */
+    bool verified;
+} sim_run_t;
+
+
+/*******************************************************************************
+ * Function prototypes
+ ******************************************************************************/
+int16_t __real_prvPAL_WriteBlock(OTA_FileContext_t * const C, uint32_t ulOffset,
+                                 uint8_t * const pacData, uint32_t ulBlockSize);
+
+
+/*******************************************************************************
+ * Global variables
+ ******************************************************************************/
+static const struct option sim_options[] =
+{
+    { "size",                   required_argument, NULL, 's' },
+    { "seed",                   required_argument, NULL, 'S' },
+    { "down-kbps",              required_argument, NULL, 'd' },
+    { "erase-ms",               required_argument, NULL, 'e' },
+    { "page-us",                required_argument, NULL, 'p' },
+    { "verbose",                no_argument,       NULL, 'v' },
+    { "help",                   no_argument,       NULL, 'h' },
+    { NULL,                     0,                 NULL, 0 }
+};
+
+static uint32_t image_size = SIM_DEFAULT_SIZE;
+static uint64_t seed = SIM_DEFAULT_SEED;
+static uint32_t down_kbps = SIM_DEFAULT_DOWN_KBPS;
+static sim_flash_config_t flash_config =
+{
+    .size = SIM_SLOT_SIZE,
+    .sector_size = SIM_FLASH_SECTOR_SIZE,
+    .page_size = SIM_FLASH_PAGE_SIZE,
+    .erase_ms = SIM_FLASH_ERASE_MS,
+    .page_us = SIM_FLASH_PAGE_US,
+    .read_kbps = SIM_FLASH_READ_KBPS
+};
+static bool verbose;
+static uint8_t *image;
+
+
+/*******************************************************************************
+ * Function Name: __real_prvPAL_WriteBlock
+ *******************************************************************************
+ * Summary:
+ *  Stand-in of the write of the PAL: programs the block to the slot.
+ *
+ ******************************************************************************/
+int16_t __real_prvPAL_WriteBlock(OTA_FileContext_t * const C, uint32_t ulOffset,
+                                 uint8_t * const pacData, uint32_t ulBlockSize)
+{
+    (void)C;
+
+    if (0 != flash_area_write(sim_flash_area(), ulOffset, pacData, ulBlockSize))
+    {
+        return -1;
+    }
+
+    return (int16_t)ulBlockSize;
+}
+
+
+/*******************************************************************************
+ * Function Name: now_ns
+ ******************************************************************************/
+static uint64_t now_ns(void)
+{
+    struct timespec ts;
+
+    (void)clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    return ((uint64_t)ts.tv_sec * NS_PER_S) + (uint64_t)ts.tv_nsec;
+}
+
+
+/*******************************************************************************
+ * Function Name: sleep_until_ns
+ ******************************************************************************/
+static void sleep_until_ns(uint64_t deadline)
+{
+    struct timespec ts;
+
+    ts.tv_sec = (time_t)(deadline / NS_PER_S);
+    ts.tv_nsec = (long)(deadline % NS_PER_S);
+    (void)clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL);
+}
+
+
+/*******************************************************************************
+ * Function Name: verify_slot
+ *******************************************************************************
+ * Summary:
+ *  Checks that the slot holds the file, and is erased past it.
+ *
+ ******************************************************************************/
+static bool verify_slot(void)
+{
+    const uint8_t *slot = sim_flash_data();
+
+    if (0 != memcmp(slot, image, image_size))
+    {
+        return false;
+    }
+
+    for (uint32_t off = image_size; off < flash_config.size; off++)
+    {
+        if (SIM_FLASH_ERASED_VAL != slot[off])
+        {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+
+/*******************************************************************************
+ * Function Name: run
+ *******************************************************************************
+ * Summary:
+ *  Opens the file, receives it at the rate of the link and closes it, with
+ *  the flash writer or with the writes of the agent. A block that arrives
+ *  while the agent is still writing waits for it, as in the buffers of the
+ *  network stack.
+ *
+ ******************************************************************************/
+static sim_run_t run(bool use_writer)
+{
+    OTA_FileContext_t file = { 0 };
+    uint64_t block_ns = (SIM_BLOCK_SIZE * NS_PER_S) /
+                        ((uint64_t)down_kbps * BYTES_PER_S_PER_KBPS);
+    uint64_t start;
+    uint64_t opened;
+    uint64_t last;
+    sim_run_t result = { 0 };
+    bool ok = true;
+
+    file.ulFileSize = image_size;
+    (void)sim_flash_init(&flash_config);
+
+    start = now_ns();
+    if (use_writer)
+    {
+        ota_flash_writer_begin();
+    }
+
+    /* The PAL erases the slot when the file is opened */
+    if (!ota_flash_writer_defer_erase(sim_flash_area(), 0U, flash_config.size))
+    {
+        ok = (0 == flash_area_erase(sim_flash_area(), 0U, flash_config.size));
+    }
+
+    if (use_writer)
+    {
+        ota_flash_writer_end_open();
+    }
+    opened = now_ns();
+
+    for (uint32_t off = 0U; ok && (off < image_size); off += SIM_BLOCK_SIZE)
+    {
+        uint32_t len = ((image_size - off) > SIM_BLOCK_SIZE) ? SIM_BLOCK_SIZE : (image_size - off);
+        uint64_t arrival = opened + ((((uint64_t)off / SIM_BLOCK_SIZE) + 1U) * block_ns);
+        uint64_t taken;
+
+        sleep_until_ns(arrival);
+        taken = now_ns();
+        if (((taken - arrival) / NS_PER_MS) > result.max_late_ms)
+        {
+            result.max_late_ms = (taken - arrival) / NS_PER_MS;
+        }
+
+        ok = (ota_flash_writer_write(&file, off, &image[off], len) == (int16_t)len);
+    }
+    last = now_ns();
+
+    ok = ota_flash_writer_flush(true) && ok;
+
+    result.open_ms = (opened - start) / NS_PER_MS;
+    result.transfer_ms = (last - opened) / NS_PER_MS;
+    result.close_ms = (now_ns() - last) / NS_PER_MS;
+    result.verified = ok && verify_slot();
+
+    return result;
+}
+
+
+/*******************************************************************************
+ * Function Name: print_run
+ ******************************************************************************/
+static void print_run(const char *name, const sim_run_t *r)
+{
+    sim_flash_stats_t stats;
+
+    sim_flash_get_stats(&stats);
+
+    printf("%s_open_ms=%llu\n", name, (unsigned long long)r->open_ms);
+    printf("%s_transfer_ms=%llu\n", name, (unsigned long long)r->transfer_ms);
+    printf("%s_close_ms=%llu\n", name, (unsigned long long)r->close_ms);
+    printf("%s_total_ms=%llu\n", name,
+           (unsigned long long)(r->open_ms + r->transfer_ms + r->close_ms));
+    printf("%s_max_block_wait_ms=%llu\n", name, (unsigned long long)r->max_late_ms);
+    printf("%s_sectors_erased=%u\n", name, (unsigned int)stats.erases);
+    printf("%s_pages_programmed=%u\n", name, (unsigned int)stats.pages);
+    printf("%s_flash_busy_ms=%llu\n", name, (unsigned long long)(stats.busy_us / 1000U));
+    printf("%s_dirty_bytes=%u\n", name, (unsigned int)stats.dirty);
+    printf("%s_verified=%s\n", name, r->verified ? "yes" : "no");
+}
+
+
+/*******************************************************************************
+ * Function Name: usage
+ ******************************************************************************/
+static void usage(const char *name)
+{
+    fprintf(stderr,
+        "usage: %s [options]\n"
+        "  --size BYTES               size of the file (default %u)\n"
+        "  --seed N                   seed of the file (default %u)\n"
+        "  --down-kbps KBPS           rate of the link (default %u)\n"
+        "  --erase-ms MS              erase time of a sector (default %u)\n"
+        "  --page-us US               program time of a page (default %u)\n"
+        "  --verbose                  print the statistics of the writer\n",
+        name, SIM_DEFAULT_SIZE, SIM_DEFAULT_SEED, SIM_DEFAULT_DOWN_KBPS,
+        SIM_FLASH_ERASE_MS, SIM_FLASH_PAGE_US);
+}
+
+
+/*******************************************************************************
+ * Function Name: main
+ ******************************************************************************/
+int main(int argc, char *argv[])
+{
+    sim_run_t inline_run;
+    sim_run_t writer_run;
+    uint64_t rng;
+    int opt;
+
+    while (-1 != (opt = getopt_long(argc, argv, "", sim_options, NULL)))
+    {
+        switch (opt)
+        {
+            case 's':
+                image_size = (uint32_t)strtoul(optarg, NULL, 0);
+                break;
+            case 'S':
+                seed = strtoull(optarg, NULL, 0);
+                break;
+            case 'd':
+                down_kbps = (uint32_t)strtoul(optarg, NULL, 0);
+                break;
+            case 'e':
+                flash_config.erase_ms = (uint32_t)strtoul(optarg, NULL, 0);
+                break;
+            case 'p':
+                flash_config.page_us = (uint32_t)strtoul(optarg, NULL, 0);
+                break;
+            case 'v':
+                verbose = true;
+                break;
+            default:
+                usage(argv[0]);
+                return EXIT_USAGE;
+        }
+    }
+    if ((optind != argc) || (0U == image_size) || (image_size > flash_config.size) ||
+        (0U == down_kbps))
+    {
+        usage(argv[0]);
+        return EXIT_USAGE;
+    }
+
+    image = malloc(image_size);
+    if (NULL == image)
+    {
+        return EXIT_FAILURE;
+    }
+
+    rng = (seed * 2654435761ULL) | 1U;
+    for (uint32_t i = 0U; i < image_size; i++)
+    {
+        rng ^= rng << 13;
+        rng ^= rng >> 7;
+        rng ^= rng << 17;
+        image[i] = (uint8_t)(rng >> 24);
+    }
+
+    sim_peer_port_init(NULL, 0U, "writer", verbose);
+
+    printf("size=%u\n", (unsigned int)image_size);
+    printf("block_size=%u\n", (unsigned int)SIM_BLOCK_SIZE);
+    printf("link_ms=%llu\n", (unsigned long long)(((uint64_t)image_size * 1000U) /
+                                                  ((uint64_t)down_kbps * BYTES_PER_S_PER_KBPS)));
+
+    /* The writer falls back to the writes of the agent until it is started */
+    inline_run = run(false);
+    print_run("inline", &inline_run);
+    writer_run = run(true);
+    print_run("writer", &writer_run);
+
+    printf("saved_ms=%lld\n",
+           (long long)(inline_run.open_ms + inline_run.transfer_ms + inline_run.close_ms) -
+           (long long)(writer_run.open_ms + writer_run.transfer_ms + writer_run.close_ms));
+    printf("result=%s\n", (inline_run.verified && writer_run.verified) ? "pass" : "fail");
+
+    free(image);
+
+    return (inline_run.verified && writer_run.verified) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+
+/* [] END OF FILE */
@@ -0,0 +1,756 @@
+/******************************************************************************
+* File Name: sim_http_stream.c
+*
+* Description: Host simulation of the HTTP download of the OTA app
+* (sources/ota_http_stream.c). The wrappers of ota_http_stream.c run as on the
+* device, with their connection tasks on host threads, against the cloud
+* stand-in of sim_cloud.c, which serves the image in ranges over a link of
+* --down-kbps shared by the connections. Each response waits for --rtt-ms,
+* and each connection carries at most one --tcp-wnd per round trip, as lwIP
+* does with its TCP window. The secure sockets stand-ins below run on plain
+* TCP: the TLS records are not simulated, and opening a connection waits for
+* the round trips of the TCP and TLS handshakes. The agent model ingests the
+* blocks handed to it as the agent does, requests again after
+* otaconfigMAX_NUM_BLOCKS_REQUEST of them, and after
+* otaconfigFILE_REQUEST_WAIT_MS without a request.
+*
+* The simulation prints the time to receive the file, the connections opened,
+* the ranged GETs, and the blocks and requests of the agent as key=value
+* lines, and fails if the received file differs from the image. Compare the
+* time with the MQTT stream of sim_block_size.c (--fixed) for the same link.
+*
+* Related Document: See README.md
+*
+*******************************************************************************
+* (c) 2020, Cypress Semiconductor Corporation. All rights reserved.
+*******************************************************************************
+* This software, including source code, documentation and related materials
+* ("Software"), is owned by Cypress Semiconductor Corporation or one of its
+* subsidiaries ("Cypress") and is protected by and subject to worldwide patent
+* protection (United States and foreign), United States copyright laws and
+* international treaty provisions. Therefore, you may use this Software only
+* as provided in the license agreement accompanying the software package from
+* which you obtained this Software ("EULA").
+*
+* If no EULA applies, Cypress hereby grants you a personal, non-exclusive,
+* non-transferable license to copy, modify, and compile the Software source
+* code solely for use in connection with Cypress's integrated circuit products.
+* Any reproduction, modification, translation, compilation, or representation
+* of this Software except as specified above is prohibited without the express
+* written permission of Cypress.
+*
+* Disclaimer: THIS SOFTWARE IS PROVIDED AS-IS, WITH NO WARRANTY OF ANY KIND,
+* EXPRESS OR IMPLIED, INCLUDING, BUT NOT LIMITED TO, NONINFRINGEMENT, IMPLIED
+* WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE. Cypress
+* reserves the right to make changes to the Software without notice. Cypress
+* does not assume any liability arising out of the application or use of the
+* Software or any product or circuit described in the Software. Cypress does
+* not authorize its products for use in any products where a malfunction or
+* failure of the Cypress product may reasonably be expected to result in
+* significant property damage, injury or death ("High Risk Product"). By
+* including Cypress's product in a High Risk Product, the manufacturer of such
+* system or application assumes all risk of such use and in doing so agrees to
+* indemnify Cypress against all liability.
+*******************************************************************************/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <getopt.h>
+#include <pthread.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include "FreeRTOS.h"
+#include "task.h"
+#include "iot_secure_sockets.h"
+#include "aws_iot_ota_agent.h"
+#include "aws_iot_ota_pal.h"
+#include "aws_iot_ota_agent_internal.h"
+#include "sim_peer_port.h"
+#include "sim_cloud.h"
+#include "ota_block_size.h"
+#include "ota_http_stream.h"
+
+
+/*******************************************************************************
+ * Macros
+ ******************************************************************************/
+/* 1.75 MB, the size of a typical update image of the kits */
+#define SIM_DEFAULT_SIZE                (1792U * 1024U)
+#define SIM_DEFAULT_SEED                (1U)
+#define SIM_DEFAULT_DOWN_KBPS           (4000U)
+#define SIM_DEFAULT_RTT_MS              (80U)
+#define SIM_DEFAULT_HEAP                (160000U)
+#define SIM_DEFAULT_TIMEOUT_S           (300U)
+
+/* Round trips to open a connection: TCP, then a full TLS 1.2 handshake */
+#define SIM_TCP_HANDSHAKE_RTTS          (1U)
+#define SIM_TLS_HANDSHAKE_RTTS          (2U)
+
+#define SIM_URL                         "https://127.0.0.1" SIM_CLOUD_PATH
+#define SIM_EVENTS                      (64U)
+
+#define NS_PER_MS                       (1000000ULL)
+
+#define EXIT_USAGE                      (2)
+
+
+/*******************************************************************************
+ * Data structure and enumeration
+ ******************************************************************************/
+/* Secure socket on a host TCP socket */
+typedef struct
+{
+    int fd;
+    bool tls;
+} sim_socket_t;
+
+
+/*******************************************************************************
+ * Function prototypes
+ ******************************************************************************/
+OTA_Err_t __real__AwsIotOTA_InitFileTransfer_HTTP(OTA_AgentContext_t *pAgentCtx);
+OTA_Err_t __real__AwsIotOTA_RequestDataBlock_HTTP(OTA_AgentContext_t *pAgentCtx);
+OTA_Err_t __real__AwsIotOTA_DecodeFileBlock_HTTP(uint8_t *pMessageBuffer,
+        size_t messageSize, int32_t *pFileId, int32_t *pBlockId,
+        int32_t *pBlockSize, uint8_t **pPayload, size_t *pPayloadSize);
+OTA_Err_t __real__AwsIotOTA_Cleanup_HTTP(OTA_AgentContext_t *pAgentCtx);
+
+OTA_Err_t __wrap__AwsIotOTA_InitFileTransfer_HTTP(OTA_AgentContext_t *pAgentCtx);
+OTA_Err_t __wrap__AwsIotOTA_RequestDataBlock_HTTP(OTA_AgentContext_t *pAgentCtx);
+OTA_Err_t __wrap__AwsIotOTA_DecodeFileBlock_HTTP(uint8_t *pMessageBuffer,
+        size_t messageSize, int32_t *pFileId, int32_t *pBlockId,
+        int32_t *pBlockSize, uint8_t **pPayload, size_t *pPayloadSize);
+OTA_Err_t __wrap__AwsIotOTA_Cleanup_HTTP(OTA_AgentContext_t *pAgentCtx);
+
+
+/*******************************************************************************
+ * Global variables
+ ******************************************************************************/
+static const struct option sim_options[] =
+{
+    { "size",                   required_argument, NULL, 's' },
+    { "seed",                   required_argument, NULL, 'S' },
+    { "down-kbps",              required_argument, NULL, 'd' },
+    { "rtt-ms",                 required_argument, NULL, 'r' },
+    { "tcp-wnd",                required_argument, NULL, 'w' },
+    { "heap",                   required_argument, NULL, 'H' },
+    { "timeout-s",              required_argument, NULL, 'T' },
+    { "verbose",                no_argument,       NULL, 'v' },
+    { "help",                   no_argument,       NULL, 'h' },
+    { NULL,                     0,                 NULL, 0 }
+};
+
+static uint32_t image_size = SIM_DEFAULT_SIZE;
+static uint64_t seed = SIM_DEFAULT_SEED;
+static uint32_t down_kbps = SIM_DEFAULT_DOWN_KBPS;
+static uint32_t rtt_ms = SIM_DEFAULT_RTT_MS;
+static uint32_t tcp_wnd;
+static uint32_t free_heap = SIM_DEFAULT_HEAP;
+static uint32_t timeout_s = SIM_DEFAULT_TIMEOUT_S;
+static bool verbose;
+
+static uint8_t *image;
+static uint8_t signature[SIM_SIGNATURE_SIZE];
+static uint8_t *slot;
+static uint16_t cloud_port;
+
+/* Event queue of the agent */
+static pthread_mutex_t events_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t events_cond;
+static OTA_EventMsg_t events[SIM_EVENTS];
+static uint32_t events_head;
+static uint32_t events_count;
+
+/* Results */
+static pthread_mutex_t stats_lock = PTHREAD_MUTEX_INITIALIZER;
+static uint32_t connections;
+static uint32_t gets;
+static uint32_t agent_blocks;
+static uint32_t agent_requests;
+static uint32_t timer_requests;
+static bool fallback;
+
+
+/*******************************************************************************
+ * Function Name: xPortGetFreeHeapSize
+ ******************************************************************************/
+size_t xPortGetFreeHeapSize(void)
+{
+    return free_heap;
+}
+
+
+/*******************************************************************************
+ * Function Name: prvPAL_WriteBlock
+ *******************************************************************************
+ * Summary:
+ *  Writes a block or a piece of an HTTP body to the slot.
+ *
+ * Return:
+ *  int16_t - bytes written, -1 on error
+ *
+ ******************************************************************************/
+int16_t prvPAL_WriteBlock(OTA_FileContext_t * const C, uint32_t ulOffset, uint8_t * const pcData,
+                          uint32_t ulBlockSize)
+{
+    if ((ulOffset > C->ulFileSize) || (ulBlockSize > (C->ulFileSize - ulOffset)))
+    {
+        return -1;
+    }
+
+    memcpy(&slot[ulOffset], pcData, ulBlockSize);
+
+    return (int16_t)ulBlockSize;
+}
+
+
+/*******************************************************************************
+ * Function Name: OTA_SignalEvent
+ *******************************************************************************
+ * Summary:
+ *  Queues an event for the agent, which is the main thread.
+ *
+ * Return:
+ *  bool - false if the queue is full
+ *
+ ******************************************************************************/
+bool OTA_SignalEvent(const OTA_EventMsg_t * const pxEventMsg)
+{
+    bool queued = false;
+
+    (void)pthread_mutex_lock(&events_lock);
+    if (events_count < SIM_EVENTS)
+    {
+        events[(events_head + events_count) % SIM_EVENTS] = *pxEventMsg;
+        events_count++;
+        queued = true;
+        (void)pthread_cond_signal(&events_cond);
+    }
+    (void)pthread_mutex_unlock(&events_lock);
+
+    return queued;
+}
+
+
+/*******************************************************************************
+ * Function Name: agent_wait_event
+ *******************************************************************************
+ * Summary:
+ *  Waits for an event of the agent until a deadline.
+ *
+ * Parameters:
+ *  event - set to the event
+ *  deadline_ns - deadline, on the clock of sim_now_ns()
+ *
+ * Return:
+ *  bool - false if the deadline passed without an event
+ *
+ ******************************************************************************/
+static bool agent_wait_event(OTA_EventMsg_t *event, uint64_t deadline_ns)
+{
+    struct timespec ts;
+    bool got = false;
+
+    ts.tv_sec = (time_t)(deadline_ns / NS_PER_S);
+    ts.tv_nsec = (long)(deadline_ns % NS_PER_S);
+
+    (void)pthread_mutex_lock(&events_lock);
+    while ((0U == events_count) &&
+           (ETIMEDOUT != pthread_cond_timedwait(&events_cond, &events_lock, &ts)))
+    {
+    }
+    if (events_count > 0U)
+    {
+        *event = events[events_head];
+        events_head = (events_head + 1U) % SIM_EVENTS;
+        events_count--;
+        got = true;
+    }
+    (void)pthread_mutex_unlock(&events_lock);
+
+    return got;
+}
+
+
+/*******************************************************************************
+ * Function Name: agent_ingest
+ *******************************************************************************
+ * Summary:
+ *  Ingests a block handed to the agent, as the agent does: decodes it, checks
+ *  its ID and size, writes it, marks it received and frees the buffer.
+ *
+ * Parameters:
+ *  C - file context
+ *  data - event data of the block
+ *
+ * Return:
+ *  bool - true if another block request is due
+ *
+ ******************************************************************************/
+static bool agent_ingest(OTA_FileContext_t *C, OTA_EventData_t *data)
+{
+    uint32_t last = (C->ulFileSize - 1U) / OTA_BLOCK_UNIT_SIZE;
+    int32_t file_id;
+    int32_t block_id;
+    int32_t block_size;
+    uint8_t *payload;
+    size_t payload_size;
+    bool ingested = false;
+
+    if ((kOTA_Err_None == __wrap__AwsIotOTA_DecodeFileBlock_HTTP(data->data, data->ulDataLength,
+            &file_id, &block_id, &block_size, &payload, &payload_size)) &&
+        ((uint32_t)file_id == C->ulServerFileID) && (block_id >= 0) &&
+        ((uint32_t)block_id <= last) &&
+        ((uint32_t)block_size == ((((uint32_t)block_id) < last) ? OTA_BLOCK_UNIT_SIZE :
+                                  (C->ulFileSize - (last * OTA_BLOCK_UNIT_SIZE)))) &&
+        ((C->pucRxBlockBitmap[block_id / BITS_PER_BYTE] & (1U << (block_id % BITS_PER_BYTE))) != 0U) &&
+        (prvPAL_WriteBlock(C, (uint32_t)block_id * OTA_BLOCK_UNIT_SIZE, payload,
+                           (uint32_t)payload_size) == (int16_t)payload_size))
+    {
+        C->pucRxBlockBitmap[block_id / BITS_PER_BYTE] &= (uint8_t)~(1U << (block_id % BITS_PER_BYTE));
+        C->ulBlocksRemaining--;
+        ingested = true;
+    }
+
+    data->bBufferUsed = false;
+    agent_blocks += ingested ? 1U : 0U;
+
+    return ingested && ((agent_blocks % otaconfigMAX_NUM_BLOCKS_REQUEST) == 0U);
+}
+
+
+/*******************************************************************************
+ * Function Name: run
+ *******************************************************************************
+ * Summary:
+ *  Runs the agent model on the main thread until the file is received.
+ *
+ * Parameters:
+ *  elapsed_ms - set to the time to receive the file
+ *
+ * Return:
+ *  bool - the whole file was received
+ *
+ ******************************************************************************/
+static bool run(uint32_t *elapsed_ms)
+{
+    uint32_t units = (image_size + OTA_BLOCK_UNIT_SIZE - 1U) / OTA_BLOCK_UNIT_SIZE;
+    size_t bitmap_size = (units + BITS_PER_BYTE - 1U) / BITS_PER_BYTE;
+    OTA_FileContext_t C = { 0 };
+    OTA_AgentContext_t agent = { 0 };
+    OTA_EventMsg_t event = { 0 };
+    uint64_t start = sim_now_ns();
+    uint64_t end = start + ((uint64_t)timeout_s * NS_PER_S);
+    uint64_t request_deadline;
+
+    C.pucUpdateUrlPath = (uint8_t *)SIM_URL;
+    C.ulFileSize = image_size;
+    C.ulBlocksRemaining = units;
+    C.pucRxBlockBitmap = malloc(bitmap_size);
+    if (NULL == C.pucRxBlockBitmap)
+    {
+        return false;
+    }
+    memset(C.pucRxBlockBitmap, 0, bitmap_size);
+    for (uint32_t unit = 0U; unit < units; unit++)
+    {
+        C.pucRxBlockBitmap[unit / BITS_PER_BYTE] |= (uint8_t)(1U << (unit % BITS_PER_BYTE));
+    }
+    agent.pxOTA_Files = &C;
+    agent.ulFileIndex = 0U;
+
+    /* The agent requests the first blocks once the file transfer is set up */
+    event.xEventId = eOTA_AgentEvent_RequestFileBlock;
+    (void)__wrap__AwsIotOTA_InitFileTransfer_HTTP(&agent);
+    (void)OTA_SignalEvent(&event);
+    request_deadline = sim_now_ns();
+
+    while ((C.ulBlocksRemaining > 0U) && !fallback && (sim_now_ns() < end))
+    {
+        if (!agent_wait_event(&event, (request_deadline < end) ? request_deadline : end))
+        {
+            if (sim_now_ns() >= end)
+            {
+                break;
+            }
+            timer_requests++;
+            event.xEventId = eOTA_AgentEvent_RequestFileBlock;
+        }
+
+        if (eOTA_AgentEvent_RequestFileBlock == event.xEventId)
+        {
+            agent_requests++;
+            request_deadline = sim_now_ns() + ((uint64_t)otaconfigFILE_REQUEST_WAIT_MS * NS_PER_MS);
+            (void)__wrap__AwsIotOTA_RequestDataBlock_HTTP(&agent);
+        }
+        else if (agent_ingest(&C, event.pxEventData))
+        {
+            event.xEventId = eOTA_AgentEvent_RequestFileBlock;
+            (void)OTA_SignalEvent(&event);
+        }
+    }
+
+    *elapsed_ms = (uint32_t)((sim_now_ns() - start) / NS_PER_MS);
+    (void)__wrap__AwsIotOTA_Cleanup_HTTP(&agent);
+    free(C.pucRxBlockBitmap);
+
+    return (0U == C.ulBlocksRemaining) && !fallback && (0 == memcmp(image, slot, image_size));
+}
+
+
+/*******************************************************************************
+ * Function Name: __real__AwsIotOTA_InitFileTransfer_HTTP
+ *******************************************************************************
+ * Summary:
+ *  Stands in for the HTTP interface of the agent, which the simulation does
+ *  not run: a call fails the simulation. So do the three below.
+ *
+ ******************************************************************************/
+OTA_Err_t __real__AwsIotOTA_InitFileTransfer_HTTP(OTA_AgentContext_t *pAgentCtx)
+{
+    (void)pAgentCtx;
+    fallback = true;
+
+    return kOTA_Err_Panic;
+}
+
+
+/*******************************************************************************
+ * Function Name: __real__AwsIotOTA_RequestDataBlock_HTTP
+ ******************************************************************************/
+OTA_Err_t __real__AwsIotOTA_RequestDataBlock_HTTP(OTA_AgentContext_t *pAgentCtx)
+{
+    (void)pAgentCtx;
+    fallback = true;
+
+    return kOTA_Err_Panic;
+}
+
+
+/*******************************************************************************
+ * Function Name: __real__AwsIotOTA_DecodeFileBlock_HTTP
+ ******************************************************************************/
+OTA_Err_t __real__AwsIotOTA_DecodeFileBlock_HTTP(uint8_t *pMessageBuffer,
+        size_t messageSize, int32_t *pFileId, int32_t *pBlockId,
+        int32_t *pBlockSize, uint8_t **pPayload, size_t *pPayloadSize)
+{
+    (void)pMessageBuffer;
+    (void)messageSize;
+    (void)pFileId;
+    (void)pBlockId;
+    (void)pBlockSize;
+    (void)pPayload;
+    (void)pPayloadSize;
+    fallback = true;
+
+    return kOTA_Err_Panic;
+}
+
+
+/*******************************************************************************
+ * Function Name: __real__AwsIotOTA_Cleanup_HTTP
+ ******************************************************************************/
+OTA_Err_t __real__AwsIotOTA_Cleanup_HTTP(OTA_AgentContext_t *pAgentCtx)
+{
+    (void)pAgentCtx;
+
+    return kOTA_Err_None;
+}
+
+
+/*******************************************************************************
+ * Function Name: SOCKETS_Socket
+ ******************************************************************************/
+Socket_t SOCKETS_Socket(int32_t lDomain, int32_t lType, int32_t lProtocol)
+{
+    sim_socket_t *sock = malloc(sizeof(*sock));
+
+    (void)lDomain;
+    (void)lType;
+    (void)lProtocol;
+
+    if (NULL == sock)
+    {
+        return SOCKETS_INVALID_SOCKET;
+    }
+
+    sock->fd = socket(AF_INET, SOCK_STREAM, 0);
+    sock->tls = false;
+
+    if (sock->fd < 0)
+    {
+        free(sock);
+        return SOCKETS_INVALID_SOCKET;
+    }
+
+    return sock;
+}
+
+
+/*******************************************************************************
+ * Function Name: SOCKETS_SetSockOpt
+ *******************************************************************************
+ * Summary:
+ *  Sets the receive timeout, or marks the socket for TLS. The server name is
+ *  ignored.
+ *
+ ******************************************************************************/
+int32_t SOCKETS_SetSockOpt(Socket_t xSocket, int32_t lLevel, int32_t lOptionName,
+                           const void *pvOptionValue, size_t xOptionLength)
+{
+    sim_socket_t *sock = (sim_socket_t *)xSocket;
+
+    (void)lLevel;
+    (void)xOptionLength;
+
+    if (SOCKETS_SO_RCVTIMEO == lOptionName)
+    {
+        TickType_t ticks = *(const TickType_t *)pvOptionValue;
+        struct timeval timeout;
+
+        timeout.tv_sec = (time_t)(ticks / MS_PER_S);
+        timeout.tv_usec = (suseconds_t)((ticks % MS_PER_S) * MS_PER_S);
+
+        return (0 == setsockopt(sock->fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout))) ?
+               SOCKETS_ERROR_NONE : SOCKETS_SOCKET_ERROR;
+    }
+
+    if (SOCKETS_SO_REQUIRE_TLS == lOptionName)
+    {
+        sock->tls = true;
+    }
+
+    return SOCKETS_ERROR_NONE;
+}
+
+
+/*******************************************************************************
+ * Function Name: SOCKETS_Connect
+ *******************************************************************************
+ * Summary:
+ *  Connects to the cloud stand-in, in place of the HTTPS port, and waits for
+ *  the round trips of the TCP handshake and, for TLS, of the TLS handshake.
+ *
+ ******************************************************************************/
+int32_t SOCKETS_Connect(Socket_t xSocket, SocketsSockaddr_t *pxAddress, uint32_t xAddressLength)
+{
+    sim_socket_t *sock = (sim_socket_t *)xSocket;
+    struct sockaddr_in addr;
+    uint32_t rtts = SIM_TCP_HANDSHAKE_RTTS + (sock->tls ? SIM_TLS_HANDSHAKE_RTTS : 0U);
+
+    (void)xAddressLength;
+
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = pxAddress->ulAddress;
+    addr.sin_port = (SOCKETS_htons(OTA_HTTP_PORT) == pxAddress->usPort) ? htons(cloud_port) :
+                    pxAddress->usPort;
+
+    if (0 != connect(sock->fd, (struct sockaddr *)&addr, sizeof(addr)))
+    {
+        return SOCKETS_SOCKET_ERROR;
+    }
+
+    vTaskDelay(pdMS_TO_TICKS(rtts * rtt_ms));
+
+    (void)pthread_mutex_lock(&stats_lock);
+    connections++;
+    (void)pthread_mutex_unlock(&stats_lock);
+
+    return SOCKETS_ERROR_NONE;
+}
+
+
+/*******************************************************************************
+ * Function Name: SOCKETS_Send
+ ******************************************************************************/
+int32_t SOCKETS_Send(Socket_t xSocket, const void *pvBuffer, size_t xDataLength, uint32_t ulFlags)
+{
+    sim_socket_t *sock = (sim_socket_t *)xSocket;
+    ssize_t sent = send(sock->fd, pvBuffer, xDataLength, MSG_NOSIGNAL);
+
+    (void)ulFlags;
+
+    if ((sent > 0) && (0 == strncmp((const char *)pvBuffer, "GET ", 4U)))
+    {
+        (void)pthread_mutex_lock(&stats_lock);
+        gets++;
+        (void)pthread_mutex_unlock(&stats_lock);
+    }
+
+    return (sent >= 0) ? (int32_t)sent : SOCKETS_SOCKET_ERROR;
+}
+
+
+/*******************************************************************************
+ * Function Name: SOCKETS_Recv
+ ******************************************************************************/
+int32_t SOCKETS_Recv(Socket_t xSocket, void *pvBuffer, size_t xBufferLength, uint32_t ulFlags)
+{
+    sim_socket_t *sock = (sim_socket_t *)xSocket;
+    ssize_t got = recv(sock->fd, pvBuffer, xBufferLength, 0);
+
+    (void)ulFlags;
+
+    return (got >= 0) ? (int32_t)got : SOCKETS_SOCKET_ERROR;
+}
+
+
+/*******************************************************************************
+ * Function Name: SOCKETS_Shutdown
+ ******************************************************************************/
+int32_t SOCKETS_Shutdown(Socket_t xSocket, uint32_t ulHow)
+{
+    sim_socket_t *sock = (sim_socket_t *)xSocket;
+
+    (void)ulHow;
+
+    return (0 == shutdown(sock->fd, SHUT_RDWR)) ? SOCKETS_ERROR_NONE : SOCKETS_SOCKET_ERROR;
+}
+
+
+/*******************************************************************************
+ * Function Name: SOCKETS_Close
+ ******************************************************************************/
+int32_t SOCKETS_Close(Socket_t xSocket)
+{
+    sim_socket_t *sock = (sim_socket_t *)xSocket;
+
+    (void)close(sock->fd);
+    free(sock);
+
+    return SOCKETS_ERROR_NONE;
+}
+
+
+/*******************************************************************************
+ * Function Name: SOCKETS_GetHostByName
+ *******************************************************************************
+ * Summary:
+ *  Resolves any host name to the loopback address of the cloud stand-in.
+ *
+ ******************************************************************************/
+uint32_t SOCKETS_GetHostByName(const char *pcHostName)
+{
+    (void)pcHostName;
+
+    return htonl(INADDR_LOOPBACK);
+}
+
+
+/*******************************************************************************
+ * Function Name: usage
+ ******************************************************************************/
+static void usage(const char *name)
+{
+    fprintf(stderr,
+        "usage: %s [options]\n"
+        "  --size BYTES               size of the file (default %u)\n"
+        "  --seed N                   seed of the file (default %u)\n"
+        "  --down-kbps KBPS           link to the device (default %u)\n"
+        "  --rtt-ms MS                round trip to the server (default %u)\n"
+        "  --tcp-wnd BYTES            TCP window of the device (default unlimited)\n"
+        "  --heap BYTES               free heap of the device (default %u)\n"
+        "  --timeout-s S              give up after S seconds (default %u)\n"
+        "  --verbose                  print the log of the OTA app\n",
+        name, SIM_DEFAULT_SIZE, SIM_DEFAULT_SEED, SIM_DEFAULT_DOWN_KBPS, SIM_DEFAULT_RTT_MS,
+        SIM_DEFAULT_HEAP, SIM_DEFAULT_TIMEOUT_S);
+}
+
+
+/*******************************************************************************
+ * Function Name: main
+ ******************************************************************************/
+int main(int argc, char *argv[])
+{
+    pthread_condattr_t attr;
+    uint32_t elapsed_ms = 0U;
+    bool pass;
+    int opt;
+
+    while (-1 != (opt = getopt_long(argc, argv, "", sim_options, NULL)))
+    {
+        switch (opt)
+        {
+            case 's':
+                image_size = (uint32_t)strtoul(optarg, NULL, 0);
+                break;
+            case 'S':
+                seed = strtoull(optarg, NULL, 0);
+                break;
+            case 'd':
+                down_kbps = (uint32_t)strtoul(optarg, NULL, 0);
+                break;
+            case 'r':
+                rtt_ms = (uint32_t)strtoul(optarg, NULL, 0);
+                break;
+            case 'w':
+                tcp_wnd = (uint32_t)strtoul(optarg, NULL, 0);
+                break;
+            case 'H':
+                free_heap = (uint32_t)strtoul(optarg, NULL, 0);
+                break;
+            case 'T':
+                timeout_s = (uint32_t)strtoul(optarg, NULL, 0);
+                break;
+            case 'v':
+                verbose = true;
+                break;
+            default:
+                usage(argv[0]);
+                return EXIT_USAGE;
+        }
+    }
+    if ((optind != argc) || (0U == image_size) || (0U == down_kbps))
+    {
+        usage(argv[0]);
+        return EXIT_USAGE;
+    }
+
+    /* The deadlines of the agent are on the clock of sim_now_ns() */
+    (void)pthread_condattr_init(&attr);
+    (void)pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+    (void)pthread_cond_init(&events_cond, &attr);
+
+    image = sim_make_image(seed, image_size, signature);
+    slot = calloc(1U, image_size);
+    if ((NULL == image) || (NULL == slot))
+    {
+        return EXIT_FAILURE;
+    }
+    sim_peer_port_init(slot, image_size, "device", verbose);
+
+    sim_cloud_path(rtt_ms, tcp_wnd);
+    if (!sim_cloud_start(image, image_size, down_kbps, &cloud_port))
+    {
+        return EXIT_FAILURE;
+    }
+
+    pass = run(&elapsed_ms);
+
+    printf("result=%s\n", pass ? "pass" : (fallback ? "fallback" : "fail"));
+    printf("time_ms=%u\n", (unsigned int)elapsed_ms);
+    printf("connections=%u\n", (unsigned int)connections);
+    printf("ranges=%u\n", (unsigned int)gets);
+    printf("range_size=%u\n", (unsigned int)CY_OTA_HTTP_RANGE_SIZE);
+    printf("agent_blocks=%u\n", (unsigned int)agent_blocks);
+    printf("agent_requests=%u\n", (unsigned int)agent_requests);
+    printf("timer_requests=%u\n", (unsigned int)timer_requests);
+    printf("cloud_bytes=%llu\n", (unsigned long long)sim_cloud_bytes());
+    printf("goodput_kbps=%u\n", (unsigned int)((elapsed_ms > 0U) ?
+           (((uint64_t)image_size * BITS_PER_BYTE) / elapsed_ms) : 0U));
+
+    free(slot);
+    free(image);
+
+    return pass ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+
+/* [] END OF FILE */
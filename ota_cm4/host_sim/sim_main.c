@@ -0,0 +1,563 @@
+/******************************************************************************
+* File Name: sim_main.c
+*
+* Description: This file contains the entry point of the host OTA simulation.
+* It runs the OTA agent, built with config_files/aws_ota_agent_config.h, on the
+* FreeRTOS POSIX port against the MQTT broker stand-in of sim_broker.c, over
+* the network model of sim_net.c, into the simulated secondary slot of
+* sim_pal.c. The run ends when the agent reports the end of the job, and the
+* time to complete, the bytes on the wire and the CPU time are printed as
+* key=value lines, one per measure, to compare runs.
+*
+* Related Document: See README.md
+*
+*******************************************************************************
+* (c) 2020, Cypress Semiconductor Corporation. All rights reserved.
+*******************************************************************************
+* This software, including source code, documentation and related materials
+* ("Software"), is owned by Cypress Semiconductor Corporation or one of its
+* subsidiaries ("Cypress") and is protected by and subject to worldwide patent
+* protection (United States and foreign), United States copyright laws and
+* international treaty provisions. Therefore, you may use this Software only
+* as provided in the license agreement accompanying the software package from
+* which you obtained this Software ("EULA").
+*
+* If no EULA applies, Cypress hereby grants you a personal, non-exclusive,
+* non-transferable license to copy, modify, and compile the Software source
+* code solely for use in connection with Cypress's integrated circuit products.
+* Any reproduction, modification, translation, compilation, or representation
+* of this Software except as specified above is prohibited without the express
+* written permission of Cypress.
+*
+* Disclaimer: THIS SOFTWARE IS PROVIDED AS-IS, WITH NO WARRANTY OF ANY KIND,
+* EXPRESS OR IMPLIED, INCLUDING, BUT NOT LIMITED TO, NONINFRINGEMENT, IMPLIED
+* WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE. Cypress
+* reserves the right to make changes to the Software without notice. Cypress
+* does not assume any liability arising out of the application or use of the
+* Software or any product or circuit described in the Software. Cypress does
+* not authorize its products for use in any products where a malfunction or
+* failure of the Cypress product may reasonably be expected to result in
+* significant property damage, injury or death ("High Risk Product"). By
+* including Cypress's product in a High Risk Product, the manufacturer of such
+* system or application assumes all risk of such use and in doing so agrees to
+* indemnify Cypress against all liability.
+*******************************************************************************/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdarg.h>
+#include <getopt.h>
+#include <time.h>
+#include "FreeRTOS.h"
+#include "task.h"
+#include "semphr.h"
+#include "aws_iot_ota_agent.h"
+#include "aws_application_version.h"
+#include "sim_net.h"
+#include "sim_broker.h"
+#include "sim_pal.h"
+
+
+/*******************************************************************************
+ * Macros
+ ******************************************************************************/
+#define SIM_TASK_PRIORITY               (3U)
+#define SIM_TASK_STACK_SIZE             (8192U)
+#define SIM_IDLE_SLEEP_NS               (1000000L)
+
+#define SIM_DEFAULT_THING_NAME          "sim-thing"
+#define SIM_DEFAULT_SIZE                (512U * 1024U)
+#define SIM_DEFAULT_SEED                (1U)
+#define SIM_DEFAULT_LATENCY_MS          (50U)
+#define SIM_DEFAULT_JITTER_MS           (10U)
+#define SIM_DEFAULT_DOWN_KBPS           (2000U)
+#define SIM_DEFAULT_UP_KBPS             (1000U)
+#define SIM_DEFAULT_TIMEOUT_S           (600U)
+
+/* External flash of the kits: 256 KB sectors, 512 B pages */
+#define SIM_DEFAULT_WRITE_US_PER_KB     (700U)
+#define SIM_DEFAULT_ERASE_MS            (520U)
+#define SIM_DEFAULT_SECTOR_KB           (256U)
+
+#define MS_PER_S                        (1000ULL)
+#define NS_PER_MS                       (1000000ULL)
+#define US_PER_MS                       (1000ULL)
+#define BYTES_PER_KB                    (1024U)
+
+#define EXIT_USAGE                      (2)
+
+
+/*******************************************************************************
+ * Global variables
+ ******************************************************************************/
+/* Version of the running image, required by the agent */
+const AppVersion32_t xAppFirmwareVersion =
+{
+    .u.x.ucMajor = APP_VERSION_MAJOR,
+    .u.x.ucMinor = APP_VERSION_MINOR,
+    .u.x.usBuild = APP_VERSION_BUILD,
+};
+
+static const struct option sim_options[] =
+{
+    { "image",                  required_argument, NULL, 'i' },
+    { "size",                   required_argument, NULL, 's' },
+    { "seed",                   required_argument, NULL, 'S' },
+    { "thing",                  required_argument, NULL, 't' },
+    { "latency-ms",             required_argument, NULL, 'l' },
+    { "jitter-ms",              required_argument, NULL, 'j' },
+    { "down-kbps",              required_argument, NULL, 'd' },
+    { "up-kbps",                required_argument, NULL, 'u' },
+    { "loss-pct",               required_argument, NULL, 'p' },
+    { "flash-write-us-per-kb",  required_argument, NULL, 'w' },
+    { "flash-erase-ms",         required_argument, NULL, 'e' },
+    { "flash-sector-kb",        required_argument, NULL, 'k' },
+    { "timeout-s",              required_argument, NULL, 'T' },
+    { "verbose",                no_argument,       NULL, 'v' },
+    { "help",                   no_argument,       NULL, 'h' },
+    { NULL,                     0,                 NULL, 0 }
+};
+
+static const char *image_path;
+static size_t image_size = SIM_DEFAULT_SIZE;
+static uint8_t *image;
+static uint64_t seed = SIM_DEFAULT_SEED;
+static const char *thing_name = SIM_DEFAULT_THING_NAME;
+static uint32_t timeout_s = SIM_DEFAULT_TIMEOUT_S;
+static bool verbose;
+
+static sim_net_config_t net_config =
+{
+    .latency_ms = SIM_DEFAULT_LATENCY_MS,
+    .jitter_ms = SIM_DEFAULT_JITTER_MS,
+    .down_kbps = SIM_DEFAULT_DOWN_KBPS,
+    .up_kbps = SIM_DEFAULT_UP_KBPS,
+    .loss_pct = 0.0
+};
+
+static sim_pal_config_t pal_config =
+{
+    .write_us_per_kb = SIM_DEFAULT_WRITE_US_PER_KB,
+    .erase_ms_per_sector = SIM_DEFAULT_ERASE_MS,
+    .sector_size = SIM_DEFAULT_SECTOR_KB * BYTES_PER_KB
+};
+
+static OTA_ConnectionContext_t connection_ctx;
+static SemaphoreHandle_t done;
+static volatile OTA_JobEvent_t job_event;
+static volatile bool job_ended;
+
+
+/*******************************************************************************
+ * Function Name: vLoggingPrintf
+ *******************************************************************************
+ * Summary:
+ *  Prints the log of the agent and of the simulation with --verbose.
+ *
+ ******************************************************************************/
+void vLoggingPrintf(const char * pcFormat, ...)
+{
+    va_list args;
+
+    if (verbose)
+    {
+        va_start(args, pcFormat);
+        (void)vprintf(pcFormat, args);
+        va_end(args);
+    }
+}
+
+
+/*******************************************************************************
+ * Function Name: vLoggingPrint
+ ******************************************************************************/
+void vLoggingPrint(const char * pcMessage)
+{
+    if (verbose)
+    {
+        (void)fputs(pcMessage, stdout);
+    }
+}
+
+
+/*******************************************************************************
+ * Function Name: vApplicationIdleHook
+ *******************************************************************************
+ * Summary:
+ *  Gives the host CPU back while FreeRTOS is idle.
+ *
+ ******************************************************************************/
+void vApplicationIdleHook(void)
+{
+    struct timespec ts = { 0, SIM_IDLE_SLEEP_NS };
+
+    (void)nanosleep(&ts, NULL);
+}
+
+
+/*******************************************************************************
+ * Function Name: vApplicationGetIdleTaskMemory
+ ******************************************************************************/
+void vApplicationGetIdleTaskMemory(StaticTask_t **ppxIdleTaskTCBBuffer,
+                                   StackType_t **ppxIdleTaskStackBuffer,
+                                   uint32_t *pulIdleTaskStackSize)
+{
+    static StaticTask_t idle_tcb;
+    static StackType_t idle_stack[configMINIMAL_STACK_SIZE];
+
+    *ppxIdleTaskTCBBuffer = &idle_tcb;
+    *ppxIdleTaskStackBuffer = idle_stack;
+    *pulIdleTaskStackSize = configMINIMAL_STACK_SIZE;
+}
+
+
+/*******************************************************************************
+ * Function Name: vApplicationGetTimerTaskMemory
+ ******************************************************************************/
+void vApplicationGetTimerTaskMemory(StaticTask_t **ppxTimerTaskTCBBuffer,
+                                    StackType_t **ppxTimerTaskStackBuffer,
+                                    uint32_t *pulTimerTaskStackSize)
+{
+    static StaticTask_t timer_tcb;
+    static StackType_t timer_stack[configTIMER_TASK_STACK_DEPTH];
+
+    *ppxTimerTaskTCBBuffer = &timer_tcb;
+    *ppxTimerTaskStackBuffer = timer_stack;
+    *pulTimerTaskStackSize = configTIMER_TASK_STACK_DEPTH;
+}
+
+
+/*******************************************************************************
+ * Function Name: ota_complete_callback
+ *******************************************************************************
+ * Summary:
+ *  Ends the run when the agent reports the end of the job. The image is not
+ *  activated: the device would reboot here.
+ *
+ * Parameters:
+ *  eEvent - job event
+ *
+ ******************************************************************************/
+static void ota_complete_callback(OTA_JobEvent_t eEvent)
+{
+    if (!job_ended)
+    {
+        job_event = eEvent;
+        job_ended = true;
+        xSemaphoreGive(done);
+    }
+}
+
+
+/*******************************************************************************
+ * Function Name: cpu_ms
+ *******************************************************************************
+ * Summary:
+ *  Reads a CPU clock.
+ *
+ * Return:
+ *  double - CPU time in milliseconds, 0 if the clock cannot be read
+ *
+ ******************************************************************************/
+static double cpu_ms(clockid_t clock)
+{
+    struct timespec ts;
+
+    if (0 != clock_gettime(clock, &ts))
+    {
+        return 0.0;
+    }
+
+    return ((double)ts.tv_sec * (double)MS_PER_S) + ((double)ts.tv_nsec / (double)NS_PER_MS);
+}
+
+
+/*******************************************************************************
+ * Function Name: report
+ *******************************************************************************
+ * Summary:
+ *  Prints the measures of the run.
+ *
+ * Parameters:
+ *  elapsed - ticks from the start of the agent to the end of the job
+ *
+ * Return:
+ *  int - exit status: 0 if the file was received intact and activated
+ *
+ ******************************************************************************/
+static int report(TickType_t elapsed)
+{
+    sim_net_stats_t down;
+    sim_net_stats_t up;
+    sim_broker_stats_t broker;
+    sim_pal_stats_t pal;
+    const char *result;
+    bool success;
+
+    sim_net_get_stats(SIM_NET_DOWNLINK, &down);
+    sim_net_get_stats(SIM_NET_UPLINK, &up);
+    sim_broker_get_stats(&broker);
+    sim_pal_get_stats(&pal);
+
+    success = job_ended && (eOTA_JobEvent_Activate == job_event) && pal.verified;
+    if (!job_ended)
+    {
+        result = "timeout";
+    }
+    else if (success)
+    {
+        result = "activated";
+    }
+    else if (pal.closed && !pal.verified)
+    {
+        result = "corrupt";
+    }
+    else
+    {
+        result = "failed";
+    }
+
+    printf("result=%s\n", result);
+    printf("seed=%llu\n", (unsigned long long)seed);
+    printf("file_bytes=%lu\n", (unsigned long)image_size);
+    printf("block_size=%lu\n", (unsigned long)(1UL << otaconfigLOG2_FILE_BLOCK_SIZE));
+    printf("time_ms=%lu\n", (unsigned long)(elapsed * (MS_PER_S / configTICK_RATE_HZ)));
+    printf("transfer_ms=%lu\n", pal.closed ?
+           (unsigned long)((pal.close_tick - pal.create_tick) * (MS_PER_S / configTICK_RATE_HZ)) : 0UL);
+    printf("down_bytes=%llu\n", (unsigned long long)down.bytes);
+    printf("down_messages=%lu\n", (unsigned long)down.messages);
+    printf("up_bytes=%llu\n", (unsigned long long)up.bytes);
+    printf("up_messages=%lu\n", (unsigned long)up.messages);
+    printf("stream_requests=%lu\n", (unsigned long)broker.stream_requests);
+    printf("blocks_served=%lu\n", (unsigned long)broker.blocks_served);
+    printf("blocks_dropped=%lu\n", (unsigned long)down.dropped);
+    printf("payload_bytes_served=%llu\n", (unsigned long long)broker.bytes_served);
+    printf("flash_writes=%lu\n", (unsigned long)pal.writes);
+    printf("flash_write_ms=%llu\n", (unsigned long long)(pal.write_us / US_PER_MS));
+    printf("flash_erase_ms=%llu\n", (unsigned long long)(pal.erase_us / US_PER_MS));
+    printf("cpu_agent_ms=%.1f\n", pal.agent_clock_valid ? cpu_ms(pal.agent_clock) : 0.0);
+    printf("cpu_process_ms=%.1f\n", cpu_ms(CLOCK_PROCESS_CPUTIME_ID));
+    printf("job_status=%s\n", broker.last_status);
+
+    return success ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+
+/*******************************************************************************
+ * Function Name: sim_task
+ *******************************************************************************
+ * Summary:
+ *  Starts the network and the agent, waits for the end of the job and exits
+ *  with the result.
+ *
+ * Parameters:
+ *  arg - unused
+ *
+ ******************************************************************************/
+static void sim_task(void *arg)
+{
+    TickType_t start;
+    OTA_State_t state;
+    int status;
+
+    (void)arg;
+
+    if (!sim_net_init(&net_config, sim_broker_deliver, sim_broker_receive))
+    {
+        fprintf(stderr, "sim: cannot start the network model\n");
+        exit(EXIT_FAILURE);
+    }
+
+    connection_ctx.pvControlClient = sim_broker_connection();
+
+    start = xTaskGetTickCount();
+    state = OTA_AgentInit(&connection_ctx, (const uint8_t *)thing_name,
+                          ota_complete_callback, portMAX_DELAY);
+    if (eOTA_AgentState_Stopped == state)
+    {
+        fprintf(stderr, "sim: the OTA agent did not start\n");
+        exit(EXIT_FAILURE);
+    }
+
+    (void)xSemaphoreTake(done, pdMS_TO_TICKS(timeout_s * MS_PER_S));
+
+    status = report(xTaskGetTickCount() - start);
+    (void)fflush(stdout);
+    exit(status);
+}
+
+
+/*******************************************************************************
+ * Function Name: load_image
+ *******************************************************************************
+ * Summary:
+ *  Reads the image to serve, or generates one from the seed.
+ *
+ * Return:
+ *  bool - true if the image is ready
+ *
+ ******************************************************************************/
+static bool load_image(void)
+{
+    FILE *f;
+    long size;
+
+    if (NULL == image_path)
+    {
+        image = malloc(image_size);
+        if (NULL == image)
+        {
+            return false;
+        }
+        for (size_t i = 0U; i < image_size; i++)
+        {
+            image[i] = (uint8_t)(sim_net_random() >> 56);
+        }
+        return true;
+    }
+
+    f = fopen(image_path, "rb");
+    if (NULL == f)
+    {
+        perror(image_path);
+        return false;
+    }
+    if ((0 != fseek(f, 0L, SEEK_END)) || ((size = ftell(f)) <= 0) ||
+        (0 != fseek(f, 0L, SEEK_SET)) || (NULL == (image = malloc((size_t)size))) ||
+        ((size_t)size != fread(image, 1U, (size_t)size, f)))
+    {
+        fprintf(stderr, "%s: cannot read the image\n", image_path);
+        fclose(f);
+        return false;
+    }
+    fclose(f);
+    image_size = (size_t)size;
+
+    return true;
+}
+
+
+/*******************************************************************************
+ * Function Name: usage
+ ******************************************************************************/
+static void usage(const char *name)
+{
+    fprintf(stderr,
+        "usage: %s [options]\n"
+        "  --image FILE               file to serve (default: --size random bytes)\n"
+        "  --size BYTES               size of the random file (default %u)\n"
+        "  --seed N                   seed of the random draws (default %u)\n"
+        "  --thing NAME               thing name (default %s)\n"
+        "  --latency-ms MS            one-way latency (default %u)\n"
+        "  --jitter-ms MS             uniform extra latency (default %u)\n"
+        "  --down-kbps KBPS           downlink bandwidth, 0 unlimited (default %u)\n"
+        "  --up-kbps KBPS             uplink bandwidth, 0 unlimited (default %u)\n"
+        "  --loss-pct PCT             stream blocks dropped (default 0)\n"
+        "  --flash-write-us-per-kb US program time per KB (default %u)\n"
+        "  --flash-erase-ms MS        erase time per sector (default %u)\n"
+        "  --flash-sector-kb KB       erase sector size (default %u)\n"
+        "  --timeout-s S              give up after S seconds (default %u)\n"
+        "  --verbose                  print the log of the agent\n",
+        name, SIM_DEFAULT_SIZE, SIM_DEFAULT_SEED, SIM_DEFAULT_THING_NAME,
+        SIM_DEFAULT_LATENCY_MS, SIM_DEFAULT_JITTER_MS, SIM_DEFAULT_DOWN_KBPS,
+        SIM_DEFAULT_UP_KBPS, SIM_DEFAULT_WRITE_US_PER_KB, SIM_DEFAULT_ERASE_MS,
+        SIM_DEFAULT_SECTOR_KB, SIM_DEFAULT_TIMEOUT_S);
+}
+
+
+/*******************************************************************************
+ * Function Name: main
+ ******************************************************************************/
+int main(int argc, char *argv[])
+{
+    int opt;
+
+    while (-1 != (opt = getopt_long(argc, argv, "", sim_options, NULL)))
+    {
+        switch (opt)
+        {
+            case 'i':
+                image_path = optarg;
+                break;
+            case 's':
+                image_size = (size_t)strtoul(optarg, NULL, 0);
+                break;
+            case 'S':
+                seed = strtoull(optarg, NULL, 0);
+                break;
+            case 't':
+                thing_name = optarg;
+                break;
+            case 'l':
+                net_config.latency_ms = (uint32_t)strtoul(optarg, NULL, 0);
+                break;
+            case 'j':
+                net_config.jitter_ms = (uint32_t)strtoul(optarg, NULL, 0);
+                break;
+            case 'd':
+                net_config.down_kbps = (uint32_t)strtoul(optarg, NULL, 0);
+                break;
+            case 'u':
+                net_config.up_kbps = (uint32_t)strtoul(optarg, NULL, 0);
+                break;
+            case 'p':
+                net_config.loss_pct = strtod(optarg, NULL);
+                break;
+            case 'w':
+                pal_config.write_us_per_kb = (uint32_t)strtoul(optarg, NULL, 0);
+                break;
+            case 'e':
+                pal_config.erase_ms_per_sector = (uint32_t)strtoul(optarg, NULL, 0);
+                break;
+            case 'k':
+                pal_config.sector_size = (uint32_t)strtoul(optarg, NULL, 0) * BYTES_PER_KB;
+                break;
+            case 'T':
+                timeout_s = (uint32_t)strtoul(optarg, NULL, 0);
+                break;
+            case 'v':
+                verbose = true;
+                break;
+            default:
+                usage(argv[0]);
+                return EXIT_USAGE;
+        }
+    }
+    if ((optind != argc) || (0U == image_size))
+    {
+        usage(argv[0]);
+        return EXIT_USAGE;
+    }
+
+    sim_net_seed(seed);
+
+    if (!load_image())
+    {
+        return EXIT_FAILURE;
+    }
+    if (!sim_pal_init(&pal_config, image, image_size))
+    {
+        fprintf(stderr, "sim: the image does not fit the secondary slot (%lu bytes)\n",
+                (unsigned long)SIM_SLOT_SIZE);
+        return EXIT_FAILURE;
+    }
+    if (!sim_broker_init(image, image_size))
+    {
+        return EXIT_FAILURE;
+    }
+
+    done = xSemaphoreCreateBinary();
+    if ((NULL == done) ||
+        (pdPASS != xTaskCreate(sim_task, "sim", SIM_TASK_STACK_SIZE, NULL,
+                               SIM_TASK_PRIORITY, NULL)))
+    {
+        return EXIT_FAILURE;
+    }
+
+    vTaskStartScheduler();
+
+    return EXIT_FAILURE;
+}
+
+
+/* [] END OF FILE */
@@ -0,0 +1,697 @@
+/******************************************************************************
+* File Name: sim_multicast.c
+*
+* Description: Host simulation of the multicast distribution of an OTA image
+* (sources/ota_multicast.c) to several devices on the loopback interface,
+* against the unicast download of the same image by every device.
+*
+* The launcher serves the image as the cloud, over a link of --cloud-kbps
+* shared by all devices, and starts each device as a process of its own.
+* Multicast round: the first device downloads the image from the cloud and
+* sends it on request once it is verified; the other devices then start
+* together, receive it from the multicast group in the receiver task, with
+* --loss-pct of the datagrams dropped, and once the task signals its end,
+* fetch from the cloud the blocks still missing, as the agent would request
+* them over HTTP. Unicast round: every device downloads the
+* whole image from the cloud. The launcher prints the time to update all
+* devices and the bytes sent by the cloud and on the LAN in each round.
+*
+* Related Document: See README.md
+*
+*******************************************************************************
+* (c) 2020, Cypress Semiconductor Corporation. All rights reserved.
+*******************************************************************************
+* This software, including source code, documentation and related materials
+* ("Software"), is owned by Cypress Semiconductor Corporation or one of its
+* subsidiaries ("Cypress") and is protected by and subject to worldwide patent
+* protection (United States and foreign), United States copyright laws and
+* international treaty provisions. Therefore, you may use this Software only
+* as provided in the license agreement accompanying the software package from
+* which you obtained this Software ("EULA").
+*
+* If no EULA applies, Cypress hereby grants you a personal, non-exclusive,
+* non-transferable license to copy, modify, and compile the Software source
+* code solely for use in connection with Cypress's integrated circuit products.
+* Any reproduction, modification, translation, compilation, or representation
+* of this Software except as specified above is prohibited without the express
+* written permission of Cypress.
+*
+* Disclaimer: THIS SOFTWARE IS PROVIDED AS-IS, WITH NO WARRANTY OF ANY KIND,
+* EXPRESS OR IMPLIED, INCLUDING, BUT NOT LIMITED TO, NONINFRINGEMENT, IMPLIED
+* WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE. Cypress
+* reserves the right to make changes to the Software without notice. Cypress
+* does not assume any liability arising out of the application or use of the
+* Software or any product or circuit described in the Software. Cypress does
+* not authorize its products for use in any products where a malfunction or
+* failure of the Cypress product may reasonably be expected to result in
+* significant property damage, injury or death ("High Risk Product"). By
+* including Cypress's product in a High Risk Product, the manufacturer of such
+* system or application assumes all risk of such use and in doing so agrees to
+* indemnify Cypress against all liability.
+*******************************************************************************/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <getopt.h>
+#include <signal.h>
+#include <unistd.h>
+#include <semaphore.h>
+#include <sys/wait.h>
+#include "FreeRTOS.h"
+#include "task.h"
+#include "lwip/sockets.h"
+#include "aws_iot_ota_pal.h"
+#include "aws_iot_ota_agent_internal.h"
+#include "sim_peer_port.h"
+#include "sim_cloud.h"
+#include "ota_multicast.h"
+
+
+/*******************************************************************************
+ * Macros
+ ******************************************************************************/
+#define SIM_DEFAULT_DEVICES             (8U)
+#define SIM_DEFAULT_SIZE                (512U * 1024U)
+#define SIM_DEFAULT_SEED                (1U)
+#define SIM_DEFAULT_CLOUD_KBPS          (4000U)
+#define SIM_DEFAULT_RANGE               (65536U)
+#define SIM_DEFAULT_TIMEOUT_S           (120U)
+
+#define SIM_MAX_DEVICES                 (32U)
+#define SIM_LOSS_SEED                   (2654435761UL)
+#define PERCENT                         (100U)
+
+#define EXIT_USAGE                      (2)
+
+
+/*******************************************************************************
+ * Global variables
+ ******************************************************************************/
+static const struct option sim_options[] =
+{
+    { "devices",                required_argument, NULL, 'n' },
+    { "size",                   required_argument, NULL, 's' },
+    { "seed",                   required_argument, NULL, 'S' },
+    { "cloud-kbps",             required_argument, NULL, 'c' },
+    { "range",                  required_argument, NULL, 'r' },
+    { "loss-pct",               required_argument, NULL, 'l' },
+    { "timeout-s",              required_argument, NULL, 'T' },
+    { "verbose",                no_argument,       NULL, 'v' },
+    { "help",                   no_argument,       NULL, 'h' },
+    /* Set by the launcher for each device */
+    { "device",                 required_argument, NULL, 'D' },
+    { "unicast",                no_argument,       NULL, 'U' },
+    { "cloud-port",             required_argument, NULL, 'P' },
+    { "ready-fd",               required_argument, NULL, 'R' },
+    { NULL,                     0,                 NULL, 0 }
+};
+
+static uint32_t devices = SIM_DEFAULT_DEVICES;
+static uint32_t image_size = SIM_DEFAULT_SIZE;
+static uint64_t seed = SIM_DEFAULT_SEED;
+static uint32_t cloud_kbps = SIM_DEFAULT_CLOUD_KBPS;
+static uint32_t range_size = SIM_DEFAULT_RANGE;
+static uint32_t loss_pct;
+static uint32_t timeout_s = SIM_DEFAULT_TIMEOUT_S;
+static bool verbose;
+static int device = -1;
+static bool unicast;
+static uint16_t cloud_port;
+static int ready_fd = -1;
+
+static uint8_t *image;
+static uint8_t signature[SIM_SIGNATURE_SIZE];
+static uint8_t *slot;
+static sem_t agent_events;              /* Events signalled to the agent */
+
+
+/*******************************************************************************
+ * Function Name: prvPAL_WriteBlock
+ *******************************************************************************
+ * Summary:
+ *  Writes a block received from the multicast group to the slot.
+ *
+ * Return:
+ *  int16_t - bytes written, -1 on error
+ *
+ ******************************************************************************/
+int16_t prvPAL_WriteBlock(OTA_FileContext_t * const C, uint32_t ulOffset, uint8_t * const pcData,
+                          uint32_t ulBlockSize)
+{
+    if ((ulOffset > C->ulFileSize) || (ulBlockSize > (C->ulFileSize - ulOffset)))
+    {
+        return -1;
+    }
+
+    memcpy(&slot[ulOffset], pcData, ulBlockSize);
+
+    return (int16_t)ulBlockSize;
+}
+
+
+/*******************************************************************************
+ * Function Name: OTA_SignalEvent
+ *******************************************************************************
+ * Summary:
+ *  Queues an event for the agent, which is the main thread of the receiver.
+ *
+ * Return:
+ *  bool - true
+ *
+ ******************************************************************************/
+bool OTA_SignalEvent(const OTA_EventMsg_t * const pxEventMsg)
+{
+    (void)pxEventMsg;
+    (void)sem_post(&agent_events);
+
+    return true;
+}
+
+
+/*******************************************************************************
+ * Function Name: cloud_fetch
+ *******************************************************************************
+ * Summary:
+ *  Downloads bytes of the image from the cloud to the slot, in ranged GETs of
+ *  at most --range bytes.
+ *
+ * Return:
+ *  bool - true if all bytes were received
+ *
+ ******************************************************************************/
+static bool cloud_fetch(sim_link_t *cloud, uint32_t off, uint32_t len)
+{
+    while (len > 0U)
+    {
+        uint32_t chunk = (len < range_size) ? len : range_size;
+
+        if (!sim_link_get_range(cloud, image_size, off, chunk, &slot[off]))
+        {
+            configPRINTF(("range at %u failed on the cloud\n", (unsigned int)off));
+            return false;
+        }
+
+        off += chunk;
+        len -= chunk;
+    }
+
+    return true;
+}
+
+
+/*******************************************************************************
+ * Function Name: cloud_fetch_missing
+ *******************************************************************************
+ * Summary:
+ *  Downloads from the cloud the blocks still missing in the bitmap, each run
+ *  of consecutive blocks in ranged GETs, as the agent requests them.
+ *
+ * Parameters:
+ *  cloud - connection to the cloud
+ *  C - file context
+ *  bytes - set to the bytes downloaded
+ *
+ * Return:
+ *  bool - true if all blocks were received
+ *
+ ******************************************************************************/
+static bool cloud_fetch_missing(sim_link_t *cloud, const OTA_FileContext_t *C, uint32_t *bytes)
+{
+    uint32_t units = (C->ulFileSize + OTA_BLOCK_UNIT_SIZE - 1U) / OTA_BLOCK_UNIT_SIZE;
+    uint32_t unit = 0U;
+
+    *bytes = 0U;
+
+    while (unit < units)
+    {
+        uint32_t first = unit;
+        uint32_t off;
+        uint32_t end;
+
+        if (0U == (C->pucRxBlockBitmap[unit / BITS_PER_BYTE] & (1U << (unit % BITS_PER_BYTE))))
+        {
+            unit++;
+            continue;
+        }
+
+        while ((unit < units) && (0U != (C->pucRxBlockBitmap[unit / BITS_PER_BYTE] & (1U << (unit % BITS_PER_BYTE)))))
+        {
+            unit++;
+        }
+
+        off = first * OTA_BLOCK_UNIT_SIZE;
+        end = ((unit * OTA_BLOCK_UNIT_SIZE) < C->ulFileSize) ? (unit * OTA_BLOCK_UNIT_SIZE) : C->ulFileSize;
+
+        if (!cloud_fetch(cloud, off, end - off))
+        {
+            return false;
+        }
+
+        *bytes += end - off;
+    }
+
+    return true;
+}
+
+
+/*******************************************************************************
+ * Function Name: sender_main
+ *******************************************************************************
+ * Summary:
+ *  Runs the first device of the multicast round: downloads the image from the
+ *  cloud, checks it, then sends it until ota_multicast_hold() returns. Writes
+ *  the bytes sent on the LAN to the ready pipe. Prints one line of results.
+ *
+ * Return:
+ *  int - exit status: 0 if the image was received intact
+ *
+ ******************************************************************************/
+static int sender_main(sim_link_t *cloud)
+{
+    TickType_t start = xTaskGetTickCount();
+    TickType_t elapsed;
+    ota_multicast_stats_t sent;
+    uint64_t lan_bytes;
+    bool verified;
+
+    verified = cloud_fetch(cloud, 0U, image_size) && (0 == memcmp(slot, image, image_size));
+    sim_link_close(cloud);
+    elapsed = xTaskGetTickCount() - start;
+
+    if (verified)
+    {
+        ota_multicast_serve(ota_multicast_image_id(signature, SIM_SIGNATURE_SIZE), image_size);
+        (void)write(ready_fd, "r", 1U);
+        ota_multicast_hold();
+    }
+
+    ota_multicast_get(&sent);
+    lan_bytes = sent.bytes;
+    (void)write(ready_fd, &lan_bytes, sizeof(lan_bytes));
+    (void)close(ready_fd);
+
+    printf("device=%d result=%s time_ms=%lu cloud_bytes=%lu sent_transfers=%lu sent_symbols=%lu "
+           "sent_bytes=%lu joins=%lu\n",
+           device, verified ? "verified" : "corrupt", (unsigned long)elapsed,
+           (unsigned long)image_size, (unsigned long)sent.transfers, (unsigned long)sent.packets,
+           (unsigned long)sent.bytes, (unsigned long)sent.joins);
+
+    return verified ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+
+/*******************************************************************************
+ * Function Name: receiver_main
+ *******************************************************************************
+ * Summary:
+ *  Runs another device of the multicast round: starts the receiver task on a
+ *  file context, as the PAL wrapper does once the file is created, and holds
+ *  the requests until the task signals its end, as the HTTP download does.
+ *  Then downloads the blocks still missing from the cloud, once those
+ *  written by the task are marked received, and checks the image. Prints one
+ *  line of results.
+ *
+ * Return:
+ *  int - exit status: 0 if the image was received intact
+ *
+ ******************************************************************************/
+static int receiver_main(sim_link_t *cloud)
+{
+    uint32_t units = (image_size + OTA_BLOCK_UNIT_SIZE - 1U) / OTA_BLOCK_UNIT_SIZE;
+    uint8_t *bitmap = calloc(1U, (units + BITS_PER_BYTE - 1U) / BITS_PER_BYTE);
+    TickType_t start = xTaskGetTickCount();
+    TickType_t elapsed;
+    ota_multicast_rx_stats_t received;
+    OTA_FileContext_t C;
+    Sig256_t sig;
+    uint32_t cloud_bytes = 0U;
+    bool verified;
+
+    if (NULL == bitmap)
+    {
+        return EXIT_FAILURE;
+    }
+
+    for (uint32_t unit = 0U; unit < units; unit++)
+    {
+        bitmap[unit / BITS_PER_BYTE] |= (uint8_t)(1U << (unit % BITS_PER_BYTE));
+    }
+
+    sig.usSize = SIM_SIGNATURE_SIZE;
+    memcpy(sig.ucData, signature, SIM_SIGNATURE_SIZE);
+
+    memset(&C, 0, sizeof(C));
+    C.ulFileSize = image_size;
+    C.pucRxBlockBitmap = bitmap;
+    C.ulBlocksRemaining = units;
+    C.pxSignature = &sig;
+
+    (void)sem_init(&agent_events, 0, 0U);
+    ota_multicast_receive_start(&C);
+
+    while (ota_multicast_receiving())
+    {
+        (void)sem_wait(&agent_events);
+    }
+
+    ota_multicast_collect(&C, 0U, 0U);
+    ota_multicast_rx_get(&received);
+
+    verified = cloud_fetch_missing(cloud, &C, &cloud_bytes) && (0 == memcmp(slot, image, image_size));
+    sim_link_close(cloud);
+    elapsed = xTaskGetTickCount() - start;
+    ota_multicast_receive_stop();
+
+    printf("device=%d result=%s time_ms=%lu multicast_bytes=%lu cloud_bytes=%lu symbols=%lu "
+           "groups=%lu recovered_groups=%lu incomplete_groups=%lu\n",
+           device, verified ? "verified" : "corrupt", (unsigned long)elapsed,
+           (unsigned long)(image_size - cloud_bytes), (unsigned long)cloud_bytes,
+           (unsigned long)received.packets, (unsigned long)received.groups,
+           (unsigned long)received.recovered, (unsigned long)received.incomplete);
+
+    free(bitmap);
+
+    return verified ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+
+/*******************************************************************************
+ * Function Name: device_main
+ *******************************************************************************
+ * Summary:
+ *  Runs one device of a round.
+ *
+ * Return:
+ *  int - exit status: 0 if the image was received intact
+ *
+ ******************************************************************************/
+static int device_main(void)
+{
+    char name[16];
+    sim_link_t cloud = { -1, 0U, 0U, SIM_CLOUD_PATH };
+    int status;
+
+    slot = calloc(1U, image_size);
+    if (NULL == slot)
+    {
+        return EXIT_FAILURE;
+    }
+
+    (void)snprintf(name, sizeof(name), "device %d", device);
+    sim_peer_port_init(slot, image_size, name, verbose);
+    sim_peer_port_loss(loss_pct, (uint32_t)((uint32_t)(device + 1) * SIM_LOSS_SEED));
+
+    cloud.address = htonl(INADDR_LOOPBACK);
+    cloud.port = cloud_port;
+
+    if (unicast)
+    {
+        TickType_t start = xTaskGetTickCount();
+        bool verified = cloud_fetch(&cloud, 0U, image_size) && (0 == memcmp(slot, image, image_size));
+
+        sim_link_close(&cloud);
+        printf("device=%d result=%s time_ms=%lu cloud_bytes=%lu\n", device,
+               verified ? "verified" : "corrupt", (unsigned long)(xTaskGetTickCount() - start),
+               (unsigned long)image_size);
+        status = verified ? EXIT_SUCCESS : EXIT_FAILURE;
+    }
+    else if (0 == device)
+    {
+        status = sender_main(&cloud);
+    }
+    else
+    {
+        status = receiver_main(&cloud);
+    }
+
+    (void)fflush(stdout);
+
+    return status;
+}
+
+
+/*******************************************************************************
+ * Function Name: spawn_device
+ *******************************************************************************
+ * Summary:
+ *  Starts a device process: this program with the arguments of the run and
+ *  the index of the device.
+ *
+ * Return:
+ *  pid_t - process ID, or -1 on error
+ *
+ ******************************************************************************/
+static pid_t spawn_device(const char *program, uint32_t index, int ready, bool round_unicast)
+{
+    char args[7][24];
+    pid_t pid;
+
+    (void)snprintf(args[0], sizeof(args[0]), "--device=%u", (unsigned int)index);
+    (void)snprintf(args[1], sizeof(args[1]), "--cloud-port=%u", (unsigned int)cloud_port);
+    (void)snprintf(args[2], sizeof(args[2]), "--ready-fd=%d", ready);
+    (void)snprintf(args[3], sizeof(args[3]), "--size=%lu", (unsigned long)image_size);
+    (void)snprintf(args[4], sizeof(args[4]), "--seed=%llu", (unsigned long long)seed);
+    (void)snprintf(args[5], sizeof(args[5]), "--range=%lu", (unsigned long)range_size);
+    (void)snprintf(args[6], sizeof(args[6]), "--loss-pct=%lu", (unsigned long)loss_pct);
+
+    (void)fflush(stdout);
+    pid = fork();
+
+    if (0 == pid)
+    {
+        char *argv[11];
+        uint32_t argc = 0U;
+
+        argv[argc++] = (char *)program;
+        for (uint32_t i = 0U; i < 7U; i++)
+        {
+            argv[argc++] = args[i];
+        }
+        if (round_unicast)
+        {
+            argv[argc++] = "--unicast";
+        }
+        if (verbose)
+        {
+            argv[argc++] = "--verbose";
+        }
+        argv[argc] = NULL;
+
+        (void)execv(program, argv);
+        _exit(EXIT_FAILURE);
+    }
+
+    return pid;
+}
+
+
+/*******************************************************************************
+ * Function Name: wait_devices
+ *******************************************************************************
+ * Summary:
+ *  Waits for devices to exit.
+ *
+ * Return:
+ *  bool - true if all of them received the image intact
+ *
+ ******************************************************************************/
+static bool wait_devices(const pid_t *pids, uint32_t first, uint32_t count)
+{
+    bool intact = true;
+
+    for (uint32_t i = first; i < count; i++)
+    {
+        int exit_status;
+
+        if ((pids[i] < 0) || (pids[i] != waitpid(pids[i], &exit_status, 0)) ||
+            !WIFEXITED(exit_status) || (EXIT_SUCCESS != WEXITSTATUS(exit_status)))
+        {
+            intact = false;
+        }
+    }
+
+    return intact;
+}
+
+
+/*******************************************************************************
+ * Function Name: launcher_main
+ *******************************************************************************
+ * Summary:
+ *  Serves the cloud, runs the multicast round then the unicast round, and
+ *  prints the totals of each round.
+ *
+ * Return:
+ *  int - exit status: 0 if every device received the image intact
+ *
+ ******************************************************************************/
+static int launcher_main(const char *program)
+{
+    pid_t pids[SIM_MAX_DEVICES];
+    int ready[2];
+    bool intact;
+    char byte;
+    uint64_t start;
+    uint64_t cloud_start;
+    uint64_t lan_bytes = 0U;
+    uint64_t multicast_ms;
+    uint64_t multicast_cloud;
+    uint64_t unicast_ms;
+    uint64_t unicast_cloud;
+
+    if (!sim_cloud_start(image, image_size, cloud_kbps, &cloud_port) || (0 != pipe(ready)))
+    {
+        perror("sim");
+        return EXIT_FAILURE;
+    }
+
+    (void)alarm(timeout_s);
+
+    /* Multicast round: the time ends when the last receiver has the image,
+     * before the first device stops holding it.
+     */
+    start = sim_now_ns();
+    cloud_start = sim_cloud_bytes();
+
+    pids[0] = spawn_device(program, 0U, ready[1], false);
+    (void)close(ready[1]);
+
+    if ((pids[0] < 0) || (1 != read(ready[0], &byte, 1U)))
+    {
+        fprintf(stderr, "sim: the first device did not receive the image\n");
+        return EXIT_FAILURE;
+    }
+
+    for (uint32_t i = 1U; i < devices; i++)
+    {
+        pids[i] = spawn_device(program, i, -1, false);
+    }
+
+    intact = wait_devices(pids, 1U, devices);
+    multicast_ms = (sim_now_ns() - start) / (NS_PER_S / MS_PER_S);
+    multicast_cloud = sim_cloud_bytes() - cloud_start;
+
+    intact = wait_devices(pids, 0U, 1U) && intact;
+    if (sizeof(lan_bytes) != read(ready[0], &lan_bytes, sizeof(lan_bytes)))
+    {
+        intact = false;
+    }
+    (void)close(ready[0]);
+
+    /* Unicast round: every device downloads the image from the cloud */
+    start = sim_now_ns();
+    cloud_start = sim_cloud_bytes();
+
+    for (uint32_t i = 0U; i < devices; i++)
+    {
+        pids[i] = spawn_device(program, i, -1, true);
+    }
+
+    intact = wait_devices(pids, 0U, devices) && intact;
+    unicast_ms = (sim_now_ns() - start) / (NS_PER_S / MS_PER_S);
+    unicast_cloud = sim_cloud_bytes() - cloud_start;
+
+    printf("result=%s\n", intact ? "verified" : "failed");
+    printf("devices=%lu\n", (unsigned long)devices);
+    printf("file_bytes=%lu\n", (unsigned long)image_size);
+    printf("loss_pct=%lu\n", (unsigned long)loss_pct);
+    printf("multicast_time_ms=%llu\n", (unsigned long long)multicast_ms);
+    printf("multicast_cloud_bytes=%llu\n", (unsigned long long)multicast_cloud);
+    printf("multicast_lan_bytes=%llu\n", (unsigned long long)lan_bytes);
+    printf("unicast_time_ms=%llu\n", (unsigned long long)unicast_ms);
+    printf("unicast_cloud_bytes=%llu\n", (unsigned long long)unicast_cloud);
+
+    return intact ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+
+/*******************************************************************************
+ * Function Name: usage
+ ******************************************************************************/
+static void usage(const char *name)
+{
+    fprintf(stderr,
+        "usage: %s [options]\n"
+        "  --devices N                devices on the LAN, 2 to %u (default %u)\n"
+        "  --size BYTES               size of the image (default %u)\n"
+        "  --seed N                   seed of the image (default %u)\n"
+        "  --cloud-kbps KBPS          cloud link shared by the devices, 0 unlimited (default %u)\n"
+        "  --range BYTES              bytes per ranged GET (default %u)\n"
+        "  --loss-pct PCT             datagrams dropped on the LAN (default 0)\n"
+        "  --timeout-s S              give up after S seconds (default %u)\n"
+        "  --verbose                  print the log of the devices\n",
+        name, SIM_MAX_DEVICES, SIM_DEFAULT_DEVICES, SIM_DEFAULT_SIZE, SIM_DEFAULT_SEED,
+        SIM_DEFAULT_CLOUD_KBPS, SIM_DEFAULT_RANGE, SIM_DEFAULT_TIMEOUT_S);
+}
+
+
+/*******************************************************************************
+ * Function Name: main
+ ******************************************************************************/
+int main(int argc, char *argv[])
+{
+    int opt;
+
+    while (-1 != (opt = getopt_long(argc, argv, "", sim_options, NULL)))
+    {
+        switch (opt)
+        {
+            case 'n':
+                devices = (uint32_t)strtoul(optarg, NULL, 0);
+                break;
+            case 's':
+                image_size = (uint32_t)strtoul(optarg, NULL, 0);
+                break;
+            case 'S':
+                seed = strtoull(optarg, NULL, 0);
+                break;
+            case 'c':
+                cloud_kbps = (uint32_t)strtoul(optarg, NULL, 0);
+                break;
+            case 'r':
+                range_size = (uint32_t)strtoul(optarg, NULL, 0);
+                break;
+            case 'l':
+                loss_pct = (uint32_t)strtoul(optarg, NULL, 0);
+                break;
+            case 'T':
+                timeout_s = (uint32_t)strtoul(optarg, NULL, 0);
+                break;
+            case 'v':
+                verbose = true;
+                break;
+            case 'D':
+                device = (int)strtol(optarg, NULL, 0);
+                break;
+            case 'U':
+                unicast = true;
+                break;
+            case 'P':
+                cloud_port = (uint16_t)strtoul(optarg, NULL, 0);
+                break;
+            case 'R':
+                ready_fd = (int)strtol(optarg, NULL, 0);
+                break;
+            default:
+                usage(argv[0]);
+                return EXIT_USAGE;
+        }
+    }
+    if ((optind != argc) || (0U == image_size) || (0U == range_size) || (loss_pct >= PERCENT) ||
+        (devices < 2U) || (devices > SIM_MAX_DEVICES))
+    {
+        usage(argv[0]);
+        return EXIT_USAGE;
+    }
+
+    image = sim_make_image(seed, image_size, signature);
+    if (NULL == image)
+    {
+        return EXIT_FAILURE;
+    }
+
+    return (device >= 0) ? device_main() : launcher_main(argv[0]);
+}
+
+
+/* [] END OF FILE */
@@ -0,0 +1,445 @@
+/******************************************************************************
+* File Name: sim_net.c
+*
+* Description: This file implements the network model of the host OTA
+* simulation: the MQTT connection between the device and the broker stand-in.
+* Every message is serialized on the link of its direction at the configured
+* bandwidth, then delivered after the latency and a uniform jitter, in the
+* order it was sent as over TCP. Lossy messages (the QoS 0 blocks of the
+* stream) are dropped with the configured probability before they take any
+* bandwidth, as the stream service does when it sheds load.
+*
+* All the random draws come from one generator seeded from the command line,
+* so a run is reproducible up to the scheduling of the host threads.
+*
+* Related Document: See README.md
+*
+*******************************************************************************
+* (c) 2020, Cypress Semiconductor Corporation. All rights reserved.
+*******************************************************************************
+* This software, including source code, documentation and related materials
+* ("Software"), is owned by Cypress Semiconductor Corporation or one of its
+* subsidiaries ("Cypress") and is protected by and subject to worldwide patent
+* protection (United States and foreign), United States copyright laws and
+* international treaty provisions. Therefore, you may use this Software only
+* as provided in the license agreement accompanying the software package from
+* which you obtained this Software ("EULA").
+*
+* If no EULA applies, Cypress hereby grants you a personal, non-exclusive,
+* non-transferable license to copy, modify, and compile the Software source
+* code solely for use in connection with Cypress's integrated circuit products.
+* Any reproduction, modification, translation, compilation, or representation
+* of this Software except as specified above is prohibited without the express
+* written permission of Cypress.
+*
+* Disclaimer: THIS SOFTWARE IS PROVIDED AS-IS, WITH NO WARRANTY OF ANY KIND,
+* EXPRESS OR IMPLIED, INCLUDING, BUT NOT LIMITED TO, NONINFRINGEMENT, IMPLIED
+* WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE. Cypress
+* reserves the right to make changes to the Software without notice. Cypress
+* does not assume any liability arising out of the application or use of the
+* Software or any product or circuit described in the Software. Cypress does
+* not authorize its products for use in any products where a malfunction or
+* failure of the Cypress product may reasonably be expected to result in
+* significant property damage, injury or death ("High Risk Product"). By
+* including Cypress's product in a High Risk Product, the manufacturer of such
+* system or application assumes all risk of such use and in doing so agrees to
+* indemnify Cypress against all liability.
+*******************************************************************************/
+#include <stdlib.h>
+#include <string.h>
+#include "FreeRTOS.h"
+#include "task.h"
+#include "semphr.h"
+#include "sim_net.h"
+
+
+/*******************************************************************************
+ * Macros
+ ******************************************************************************/
+#define US_PER_MS                       (1000ULL)
+#define MQTT_VARINT_DIGIT_MAX           (128U)
+
+
+/*******************************************************************************
+ * Data structure and enumeration
+ ******************************************************************************/
+typedef struct sim_net_msg
+{
+    struct sim_net_msg *next;
+    uint64_t due_us;
+    sim_net_dir_t dir;
+    int qos;
+    size_t topic_len;
+    size_t len;
+    char *topic;
+    uint8_t *payload;
+} sim_net_msg_t;
+
+
+/*******************************************************************************
+ * Global variables
+ ******************************************************************************/
+static uint64_t rng_state = 0x9E3779B97F4A7C15ULL;
+
+static sim_net_config_t net_config;
+static sim_net_deliver_t deliver[SIM_NET_DIRECTIONS];
+static SemaphoreHandle_t net_lock;
+static TaskHandle_t net_task;
+
+/* Messages in flight, by due time then by send order */
+static sim_net_msg_t *in_flight;
+
+/* Time at which each link is free, and the last delivery on it */
+static uint64_t link_free_us[SIM_NET_DIRECTIONS];
+static uint64_t last_due_us[SIM_NET_DIRECTIONS];
+
+static sim_net_stats_t net_stats[SIM_NET_DIRECTIONS];
+
+
+/*******************************************************************************
+ * Function Name: sim_net_seed
+ *******************************************************************************
+ * Summary:
+ *  Seeds the random generator of the simulation.
+ *
+ * Parameters:
+ *  seed - any value; the same seed gives the same draws
+ *
+ ******************************************************************************/
+void sim_net_seed(uint64_t seed)
+{
+    /* xorshift needs a non-zero state */
+    rng_state = seed ^ 0x9E3779B97F4A7C15ULL;
+    if (0U == rng_state)
+    {
+        rng_state = 1U;
+    }
+}
+
+
+/*******************************************************************************
+ * Function Name: sim_net_random
+ *******************************************************************************
+ * Summary:
+ *  Draws the next value of the random generator (xorshift64*).
+ *
+ * Return:
+ *  uint64_t - 64 random bits
+ *
+ ******************************************************************************/
+uint64_t sim_net_random(void)
+{
+    rng_state ^= rng_state >> 12;
+    rng_state ^= rng_state << 25;
+    rng_state ^= rng_state >> 27;
+
+    return rng_state * 0x2545F4914F6CDD1DULL;
+}
+
+
+/*******************************************************************************
+ * Function Name: now_us
+ *******************************************************************************
+ * Summary:
+ *  Returns the simulation time, the tick count of the scheduler.
+ *
+ * Return:
+ *  uint64_t - microseconds since the scheduler started
+ *
+ ******************************************************************************/
+static uint64_t now_us(void)
+{
+    return (uint64_t)xTaskGetTickCount() * (US_PER_MS * 1000ULL / configTICK_RATE_HZ);
+}
+
+
+/*******************************************************************************
+ * Function Name: wire_size
+ *******************************************************************************
+ * Summary:
+ *  Computes the size on the wire of an MQTT PUBLISH: fixed header, topic,
+ *  packet identifier for QoS 1, payload, and the TLS record around it.
+ *
+ * Parameters:
+ *  topic_len - length of the topic
+ *  len - length of the payload
+ *  qos - QoS of the publish
+ *
+ * Return:
+ *  uint32_t - bytes on the wire
+ *
+ ******************************************************************************/
+static uint32_t wire_size(size_t topic_len, size_t len, int qos)
+{
+    uint32_t remaining = (uint32_t)(2U + topic_len + len + ((qos > 0) ? 2U : 0U));
+    uint32_t header = 1U;
+
+    for (uint32_t r = remaining; r > 0U; r /= MQTT_VARINT_DIGIT_MAX)
+    {
+        header++;
+    }
+
+    return header + remaining + SIM_NET_TLS_RECORD_OVERHEAD;
+}
+
+
+/*******************************************************************************
+ * Function Name: link_transmit
+ *******************************************************************************
+ * Summary:
+ *  Serializes bytes on a link, after what is already being sent on it.
+ *  Must be called with net_lock held.
+ *
+ * Parameters:
+ *  dir - link to send on
+ *  bytes - bytes on the wire
+ *
+ * Return:
+ *  uint64_t - time the last byte leaves, in microseconds
+ *
+ ******************************************************************************/
+static uint64_t link_transmit(sim_net_dir_t dir, uint32_t bytes)
+{
+    uint32_t kbps = (SIM_NET_DOWNLINK == dir) ? net_config.down_kbps : net_config.up_kbps;
+    uint64_t now = now_us();
+
+    if (link_free_us[dir] < now)
+    {
+        link_free_us[dir] = now;
+    }
+    if (0U != kbps)
+    {
+        /* bits / (kbit/s) = ms; scaled to us */
+        link_free_us[dir] += ((uint64_t)bytes * 8U * US_PER_MS) / kbps;
+    }
+
+    net_stats[dir].bytes += bytes;
+    net_stats[dir].messages++;
+
+    return link_free_us[dir];
+}
+
+
+/*******************************************************************************
+ * Function Name: sim_net_send
+ *******************************************************************************
+ * Summary:
+ *  Sends a message on a link. The message is copied and delivered by the
+ *  network task when due. A QoS 1 message also sends its PUBACK back on the
+ *  other link.
+ *
+ * Parameters:
+ *  dir - link to send on
+ *  topic, topic_len - topic of the message
+ *  payload, len - payload of the message
+ *  qos - QoS of the message
+ *  lossy - the message may be dropped
+ *  ack_ms - if not NULL, set to the time until the PUBACK of a QoS 1
+ *           message is back at the sender
+ *
+ * Return:
+ *  bool - false if out of memory; a dropped message still returns true
+ *
+ ******************************************************************************/
+bool sim_net_send(sim_net_dir_t dir, const char *topic, size_t topic_len,
+                  const uint8_t *payload, size_t len, int qos, bool lossy,
+                  uint32_t *ack_ms)
+{
+    sim_net_msg_t *msg;
+    sim_net_msg_t **link;
+    uint64_t due;
+
+    if (NULL != ack_ms)
+    {
+        *ack_ms = 0U;
+    }
+
+    /* Host memory, so that the FreeRTOS heap is the one of the agent */
+    msg = calloc(1U, sizeof(*msg));
+    if (NULL == msg)
+    {
+        return false;
+    }
+    msg->topic = malloc(topic_len + 1U);
+    msg->payload = malloc((len > 0U) ? len : 1U);
+    if ((NULL == msg->topic) || (NULL == msg->payload))
+    {
+        free(msg->topic);
+        free(msg->payload);
+        free(msg);
+        return false;
+    }
+    memcpy(msg->topic, topic, topic_len);
+    msg->topic[topic_len] = '\0';
+    memcpy(msg->payload, payload, len);
+    msg->topic_len = topic_len;
+    msg->len = len;
+    msg->qos = qos;
+    msg->dir = dir;
+
+    xSemaphoreTake(net_lock, portMAX_DELAY);
+
+    if (lossy && (net_config.loss_pct > 0.0) &&
+        (((double)(sim_net_random() >> 11) * (100.0 / 9007199254740992.0)) < net_config.loss_pct))
+    {
+        net_stats[dir].dropped++;
+        xSemaphoreGive(net_lock);
+        free(msg->topic);
+        free(msg->payload);
+        free(msg);
+        return true;
+    }
+
+    due = link_transmit(dir, wire_size(topic_len, len, qos)) +
+          (uint64_t)net_config.latency_ms * US_PER_MS;
+    if (0U != net_config.jitter_ms)
+    {
+        due += sim_net_random() % ((uint64_t)net_config.jitter_ms * US_PER_MS + 1U);
+    }
+
+    /* One TCP connection: no message overtakes an earlier one */
+    if (due < last_due_us[dir])
+    {
+        due = last_due_us[dir];
+    }
+    last_due_us[dir] = due;
+
+    if (qos > 0)
+    {
+        uint64_t ack = link_transmit((SIM_NET_DOWNLINK == dir) ? SIM_NET_UPLINK : SIM_NET_DOWNLINK,
+                                     SIM_NET_MQTT_PUBACK_SIZE + SIM_NET_TLS_RECORD_OVERHEAD);
+
+        if (ack < due)
+        {
+            ack = due;
+        }
+        ack += (uint64_t)net_config.latency_ms * US_PER_MS;
+        if (NULL != ack_ms)
+        {
+            *ack_ms = (uint32_t)((ack - now_us() + US_PER_MS - 1U) / US_PER_MS);
+        }
+    }
+
+    msg->due_us = due;
+
+    link = &in_flight;
+    while ((NULL != *link) && ((*link)->due_us <= due))
+    {
+        link = &(*link)->next;
+    }
+    msg->next = *link;
+    *link = msg;
+
+    xSemaphoreGive(net_lock);
+
+    xTaskNotifyGive(net_task);
+
+    return true;
+}
+
+
+/*******************************************************************************
+ * Function Name: net_task_fn
+ *******************************************************************************
+ * Summary:
+ *  Delivers the messages in flight when they are due, like the receive task
+ *  of the MQTT library on the device and the broker on the other end.
+ *
+ * Parameters:
+ *  arg - unused
+ *
+ ******************************************************************************/
+static void net_task_fn(void *arg)
+{
+    (void)arg;
+
+    for (;;)
+    {
+        sim_net_msg_t *msg = NULL;
+        TickType_t wait = portMAX_DELAY;
+        uint64_t now;
+
+        xSemaphoreTake(net_lock, portMAX_DELAY);
+        now = now_us();
+        if (NULL != in_flight)
+        {
+            if (in_flight->due_us <= now)
+            {
+                msg = in_flight;
+                in_flight = msg->next;
+            }
+            else
+            {
+                wait = pdMS_TO_TICKS((in_flight->due_us - now + US_PER_MS - 1U) / US_PER_MS);
+            }
+        }
+        xSemaphoreGive(net_lock);
+
+        if (NULL == msg)
+        {
+            (void)ulTaskNotifyTake(pdTRUE, wait);
+            continue;
+        }
+
+        deliver[msg->dir](msg->topic, msg->topic_len, msg->payload, msg->len, msg->qos);
+
+        free(msg->topic);
+        free(msg->payload);
+        free(msg);
+    }
+}
+
+
+/*******************************************************************************
+ * Function Name: sim_net_init
+ *******************************************************************************
+ * Summary:
+ *  Configures the network model and starts the network task.
+ *
+ * Parameters:
+ *  config - network model
+ *  to_device - called for the messages arriving at the device
+ *  to_broker - called for the messages arriving at the broker
+ *
+ * Return:
+ *  bool - true if the network task was started
+ *
+ ******************************************************************************/
+bool sim_net_init(const sim_net_config_t *config, sim_net_deliver_t to_device,
+                  sim_net_deliver_t to_broker)
+{
+    net_config = *config;
+    deliver[SIM_NET_DOWNLINK] = to_device;
+    deliver[SIM_NET_UPLINK] = to_broker;
+
+    net_lock = xSemaphoreCreateMutex();
+    if (NULL == net_lock)
+    {
+        return false;
+    }
+
+    return (pdPASS == xTaskCreate(net_task_fn, "sim_net", SIM_NET_TASK_STACK_SIZE, NULL,
+                                  SIM_NET_TASK_PRIORITY, &net_task));
+}
+
+
+/*******************************************************************************
+ * Function Name: sim_net_get_stats
+ *******************************************************************************
+ * Summary:
+ *  Returns the traffic sent on a link so far.
+ *
+ * Parameters:
+ *  dir - link
+ *  stats - filled with the traffic of the link
+ *
+ ******************************************************************************/
+void sim_net_get_stats(sim_net_dir_t dir, sim_net_stats_t *stats)
+{
+    xSemaphoreTake(net_lock, portMAX_DELAY);
+    *stats = net_stats[dir];
+    xSemaphoreGive(net_lock);
+}
+
+
+/* [] END OF FILE */
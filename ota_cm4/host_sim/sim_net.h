@@ -0,0 +1,111 @@
+/******************************************************************************
+* File Name: sim_net.h
+*
+* Description: This file contains the macros, structures and function
+* declarations of the network model of the host OTA simulation.
+*
+* Related Document: See README.md
+*
+*******************************************************************************
+* (c) 2020, Cypress Semiconductor Corporation. All rights reserved.
+*******************************************************************************
+* This software, including source code, documentation and related materials
+* ("Software"), is owned by Cypress Semiconductor Corporation or one of its
+* subsidiaries ("Cypress") and is protected by and subject to worldwide patent
+* protection (United States and foreign), United States copyright laws and
+* international treaty provisions. Therefore, you may use this Software only
+* as provided in the license agreement accompanying the software package from
+* which you obtained this Software ("EULA").
+*
+* If no EULA applies, Cypress hereby grants you a personal, non-exclusive,
+* non-transferable license to copy, modify, and compile the Software source
+* code solely for use in connection with Cypress's integrated circuit products.
+* Any reproduction, modification, translation, compilation, or representation
+* of this Software except as specified above is prohibited without the express
+* written permission of Cypress.
+*
+* Disclaimer: THIS SOFTWARE IS PROVIDED AS-IS, WITH NO WARRANTY OF ANY KIND,
+* EXPRESS OR IMPLIED, INCLUDING, BUT NOT LIMITED TO, NONINFRINGEMENT, IMPLIED
+* WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE. Cypress
+* reserves the right to make changes to the Software without notice. Cypress
+* does not assume any liability arising out of the application or use of the
+* Software or any product or circuit described in the Software. Cypress does
+* not authorize its products for use in any products where a malfunction or
+* failure of the Cypress product may reasonably be expected to result in
+* significant property damage, injury or death ("High Risk Product"). By
+* including Cypress's product in a High Risk Product, the manufacturer of such
+* system or application assumes all risk of such use and in doing so agrees to
+* indemnify Cypress against all liability.
+*******************************************************************************/
+#ifndef SIM_NET_H
+#define SIM_NET_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+
+/*******************************************************************************
+ * Macros
+ ******************************************************************************/
+/* TLS 1.2 AES-GCM record overhead added to every MQTT packet: 5 bytes of
+ * header, 8 of explicit nonce and 16 of tag.
+ */
+#define SIM_NET_TLS_RECORD_OVERHEAD     (29U)
+
+/* Size of an MQTT PUBACK */
+#define SIM_NET_MQTT_PUBACK_SIZE        (4U)
+
+#define SIM_NET_TASK_PRIORITY           (4U)
+#define SIM_NET_TASK_STACK_SIZE         (8192U)
+
+
+/*******************************************************************************
+ * Data structure and enumeration
+ ******************************************************************************/
+typedef enum
+{
+    SIM_NET_DOWNLINK,       /* Broker to device */
+    SIM_NET_UPLINK,         /* Device to broker */
+    SIM_NET_DIRECTIONS
+} sim_net_dir_t;
+
+typedef struct
+{
+    uint32_t latency_ms;            /* One-way latency */
+    uint32_t jitter_ms;             /* Uniform extra latency, 0 to jitter_ms */
+    uint32_t down_kbps;             /* Downlink bandwidth, 0 for unlimited */
+    uint32_t up_kbps;               /* Uplink bandwidth, 0 for unlimited */
+    double loss_pct;                /* Lossy messages dropped, in percent */
+} sim_net_config_t;
+
+typedef struct
+{
+    uint64_t bytes;                 /* On the wire, with MQTT and TLS framing */
+    uint32_t messages;
+    uint32_t dropped;
+} sim_net_stats_t;
+
+/* Called in the network task when a message arrives at its end of the link */
+typedef void (*sim_net_deliver_t)(const char *topic, size_t topic_len,
+                                  const uint8_t *payload, size_t len, int qos);
+
+
+/*******************************************************************************
+ * Function prototypes
+ ******************************************************************************/
+void sim_net_seed(uint64_t seed);
+uint64_t sim_net_random(void);
+
+bool sim_net_init(const sim_net_config_t *config, sim_net_deliver_t to_device,
+                  sim_net_deliver_t to_broker);
+bool sim_net_send(sim_net_dir_t dir, const char *topic, size_t topic_len,
+                  const uint8_t *payload, size_t len, int qos, bool lossy,
+                  uint32_t *ack_ms);
+void sim_net_get_stats(sim_net_dir_t dir, sim_net_stats_t *stats);
+
+
+#endif /* SIM_NET_H */
+
+
+/* [] END OF FILE */
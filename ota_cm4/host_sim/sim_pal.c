@@ -0,0 +1,333 @@
+/******************************************************************************
+* File Name: sim_pal.c
+*
+* Description: This file implements the OTA PAL of the host OTA simulation on a
+* secondary slot in RAM. Erasing and programming block the agent task for the
+* time the configured flash model takes: the sectors holding the file are
+* erased when it is created, and every write takes a time proportional to its
+* size. Closing the file compares it with the image served by the broker
+* stand-in, in place of the signature check.
+*
+* With the block stream features built in (SIM_BLOCK_STREAM=1), the PAL starts
+* and stops the block size selection as sources/ota_pal_wrap.c does.
+*
+* Related Document: See README.md
+*
+*******************************************************************************
+* (c) 2020, Cypress Semiconductor Corporation. All rights reserved.
+*******************************************************************************
+* This software, including source code, documentation and related materials
+* ("Software"), is owned by Cypress Semiconductor Corporation or one of its
+* subsidiaries ("Cypress") and is protected by and subject to worldwide patent
+* protection (United States and foreign), United States copyright laws and
+* international treaty provisions. Therefore, you may use this Software only
+* as provided in the license agreement accompanying the software package from
+* which you obtained this Software ("EULA").
+*
+* If no EULA applies, Cypress hereby grants you a personal, non-exclusive,
+* non-transferable license to copy, modify, and compile the Software source
+* code solely for use in connection with Cypress's integrated circuit products.
+* Any reproduction, modification, translation, compilation, or representation
+* of this Software except as specified above is prohibited without the express
+* written permission of Cypress.
+*
+* Disclaimer: THIS SOFTWARE IS PROVIDED AS-IS, WITH NO WARRANTY OF ANY KIND,
+* EXPRESS OR IMPLIED, INCLUDING, BUT NOT LIMITED TO, NONINFRINGEMENT, IMPLIED
+* WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE. Cypress
+* reserves the right to make changes to the Software without notice. Cypress
+* does not assume any liability arising out of the application or use of the
+* Software or any product or circuit described in the Software. Cypress does
+* not authorize its products for use in any products where a malfunction or
+* failure of the Cypress product may reasonably be expected to result in
+* significant property damage, injury or death ("High Risk Product"). By
+* including Cypress's product in a High Risk Product, the manufacturer of such
+* system or application assumes all risk of such use and in doing so agrees to
+* indemnify Cypress against all liability.
+*******************************************************************************/
+#include <string.h>
+#include <stdlib.h>
+#include <pthread.h>
+#include "FreeRTOS.h"
+#include "task.h"
+#include "aws_iot_ota_pal.h"
+#include "aws_iot_ota_agent_internal.h"
+#include "sim_pal.h"
+
+#if defined(CY_OTA_BLOCK_STREAM)
+#include "ota_block_size.h"
+#endif
+
+
+/*******************************************************************************
+ * Macros
+ ******************************************************************************/
+#define US_PER_MS                       (1000ULL)
+#define BYTES_PER_KB                    (1024ULL)
+#define ERASED_VALUE                    (0xFFU)
+
+
+/*******************************************************************************
+ * Global variables
+ ******************************************************************************/
+const char OTA_JsonFileSignatureKey[OTA_FILE_SIG_KEY_STR_MAX_LENGTH] = "sig-sha256-ecdsa";
+
+static sim_pal_config_t pal_config;
+static const uint8_t *expected_image;
+static size_t expected_size;
+
+static uint8_t *slot;
+static uint64_t delay_us;               /* Modeled time not yet waited */
+static OTA_PAL_ImageState_t image_state = eOTA_PAL_ImageState_Valid;
+
+static sim_pal_stats_t pal_stats;
+
+
+/*******************************************************************************
+ * Function Name: flash_busy
+ *******************************************************************************
+ * Summary:
+ *  Blocks the calling task for the modeled duration of a flash operation, in
+ *  whole ticks; the remainder is carried to the next operation.
+ *
+ * Parameters:
+ *  us - duration of the operation
+ *
+ ******************************************************************************/
+static void flash_busy(uint64_t us)
+{
+    uint64_t us_per_tick = (US_PER_MS * 1000ULL) / configTICK_RATE_HZ;
+
+    delay_us += us;
+    if (delay_us >= us_per_tick)
+    {
+        vTaskDelay((TickType_t)(delay_us / us_per_tick));
+        delay_us %= us_per_tick;
+    }
+}
+
+
+/*******************************************************************************
+ * Function Name: sim_pal_init
+ *******************************************************************************
+ * Summary:
+ *  Configures the flash model and the image the received file is compared
+ *  with.
+ *
+ * Parameters:
+ *  config - flash model
+ *  image, size - image served by the broker stand-in
+ *
+ * Return:
+ *  bool - false if the image does not fit the slot or out of memory
+ *
+ ******************************************************************************/
+bool sim_pal_init(const sim_pal_config_t *config, const uint8_t *image, size_t size)
+{
+    if ((size > SIM_SLOT_SIZE) || (0U == config->sector_size))
+    {
+        return false;
+    }
+
+    slot = malloc(SIM_SLOT_SIZE);
+    if (NULL == slot)
+    {
+        return false;
+    }
+    memset(slot, ERASED_VALUE, SIM_SLOT_SIZE);
+
+    pal_config = *config;
+    expected_image = image;
+    expected_size = size;
+    memset(&pal_stats, 0, sizeof(pal_stats));
+
+    return true;
+}
+
+
+/*******************************************************************************
+ * Function Name: sim_pal_get_stats
+ *******************************************************************************
+ * Summary:
+ *  Returns the counters of the simulated PAL.
+ *
+ ******************************************************************************/
+void sim_pal_get_stats(sim_pal_stats_t *stats)
+{
+    taskENTER_CRITICAL();
+    *stats = pal_stats;
+    taskEXIT_CRITICAL();
+}
+
+
+/*******************************************************************************
+ * Function Name: prvPAL_CreateFileForRx
+ *******************************************************************************
+ * Summary:
+ *  Erases the sectors of the slot the file will occupy.
+ *
+ ******************************************************************************/
+OTA_Err_t prvPAL_CreateFileForRx(OTA_FileContext_t * const C)
+{
+    uint32_t sectors;
+
+    if ((NULL == C) || (C->ulFileSize > SIM_SLOT_SIZE))
+    {
+        return kOTA_Err_RxFileCreateFailed;
+    }
+
+    /* The agent calls the PAL in its own task: its CPU time is the one of
+     * this thread of the POSIX port.
+     */
+    pal_stats.agent_clock_valid = (0 == pthread_getcpuclockid(pthread_self(), &pal_stats.agent_clock));
+
+    sectors = (C->ulFileSize + pal_config.sector_size - 1U) / pal_config.sector_size;
+    memset(slot, ERASED_VALUE, (size_t)sectors * pal_config.sector_size);
+    pal_stats.erase_us += (uint64_t)sectors * pal_config.erase_ms_per_sector * US_PER_MS;
+    flash_busy((uint64_t)sectors * pal_config.erase_ms_per_sector * US_PER_MS);
+
+    pal_stats.files++;
+    pal_stats.closed = false;
+    pal_stats.verified = false;
+    pal_stats.create_tick = (uint32_t)xTaskGetTickCount();
+    C->pucFile = slot;
+
+#if defined(CY_OTA_BLOCK_STREAM)
+    ota_block_size_start(C);
+#endif
+
+    return kOTA_Err_None;
+}
+
+
+/*******************************************************************************
+ * Function Name: prvPAL_WriteBlock
+ *******************************************************************************
+ * Summary:
+ *  Programs a block into the slot.
+ *
+ ******************************************************************************/
+int16_t prvPAL_WriteBlock(OTA_FileContext_t * const C, uint32_t ulOffset,
+                          uint8_t * const pcData, uint32_t ulBlockSize)
+{
+    uint64_t us = ((uint64_t)ulBlockSize * pal_config.write_us_per_kb) / BYTES_PER_KB;
+
+    if ((NULL == C) || (NULL == C->pucFile) || (ulOffset > SIM_SLOT_SIZE) ||
+        (ulBlockSize > (SIM_SLOT_SIZE - ulOffset)))
+    {
+        return -1;
+    }
+
+    memcpy(slot + ulOffset, pcData, ulBlockSize);
+    pal_stats.writes++;
+    pal_stats.bytes_written += ulBlockSize;
+    pal_stats.write_us += us;
+    flash_busy(us);
+
+    return (int16_t)ulBlockSize;
+}
+
+
+/*******************************************************************************
+ * Function Name: prvPAL_CloseFile
+ *******************************************************************************
+ * Summary:
+ *  Closes the file and compares it with the image served.
+ *
+ ******************************************************************************/
+OTA_Err_t prvPAL_CloseFile(OTA_FileContext_t * const C)
+{
+#if defined(CY_OTA_BLOCK_STREAM)
+    ota_block_size_stop(C);
+#endif
+
+    pal_stats.closed = true;
+    pal_stats.close_tick = (uint32_t)xTaskGetTickCount();
+    pal_stats.verified = (NULL != C) && (C->ulFileSize == expected_size) &&
+                         (0 == memcmp(slot, expected_image, expected_size));
+
+    if (NULL != C)
+    {
+        C->pucFile = NULL;
+    }
+
+    return pal_stats.verified ? kOTA_Err_None : kOTA_Err_SignatureCheckFailed;
+}
+
+
+/*******************************************************************************
+ * Function Name: prvPAL_Abort
+ *******************************************************************************
+ * Summary:
+ *  Aborts the transfer of the file.
+ *
+ ******************************************************************************/
+OTA_Err_t prvPAL_Abort(OTA_FileContext_t * const C)
+{
+#if defined(CY_OTA_BLOCK_STREAM)
+    ota_block_size_stop(C);
+#endif
+
+    if (NULL != C)
+    {
+        C->pucFile = NULL;
+    }
+    pal_stats.aborts++;
+
+    return kOTA_Err_None;
+}
+
+
+/*******************************************************************************
+ * Function Name: prvPAL_ActivateNewImage
+ *******************************************************************************
+ * Summary:
+ *  Nothing to activate: the simulation ends when the agent gets there.
+ *
+ ******************************************************************************/
+OTA_Err_t prvPAL_ActivateNewImage(void)
+{
+    return kOTA_Err_None;
+}
+
+
+/*******************************************************************************
+ * Function Name: prvPAL_ResetDevice
+ ******************************************************************************/
+OTA_Err_t prvPAL_ResetDevice(void)
+{
+    return kOTA_Err_None;
+}
+
+
+/*******************************************************************************
+ * Function Name: prvPAL_SetPlatformImageState
+ ******************************************************************************/
+OTA_Err_t prvPAL_SetPlatformImageState(OTA_ImageState_t eState)
+{
+    switch (eState)
+    {
+        case eOTA_ImageState_Testing:
+            image_state = eOTA_PAL_ImageState_PendingCommit;
+            break;
+        case eOTA_ImageState_Accepted:
+            image_state = eOTA_PAL_ImageState_Valid;
+            break;
+        default:
+            image_state = eOTA_PAL_ImageState_Invalid;
+            break;
+    }
+
+    return kOTA_Err_None;
+}
+
+
+/*******************************************************************************
+ * Function Name: prvPAL_GetPlatformImageState
+ ******************************************************************************/
+OTA_PAL_ImageState_t prvPAL_GetPlatformImageState(void)
+{
+    return image_state;
+}
+
+
+/* [] END OF FILE */
@@ -0,0 +1,95 @@
+/******************************************************************************
+* File Name: sim_pal.h
+*
+* Description: This file contains the structures and function declarations of
+* the simulated OTA PAL and secondary slot of the host OTA simulation.
+*
+* Related Document: See README.md
+*
+*******************************************************************************
+* (c) 2020, Cypress Semiconductor Corporation. All rights reserved.
+*******************************************************************************
+* This software, including source code, documentation and related materials
+* ("Software"), is owned by Cypress Semiconductor Corporation or one of its
+* subsidiaries ("Cypress") and is protected by and subject to worldwide patent
+* protection (United States and foreign), United States copyright laws and
+* international treaty provisions. Therefore, you may use this Software only
+* as provided in the license agreement accompanying the software package from
+* which you obtained this Software ("EULA").
+*
+* If no EULA applies, Cypress hereby grants you a personal, non-exclusive,
+* non-transferable license to copy, modify, and compile the Software source
+* code solely for use in connection with Cypress's integrated circuit products.
+* Any reproduction, modification, translation, compilation, or representation
+* of this Software except as specified above is prohibited without the express
+* written permission of Cypress.
+*
+* Disclaimer: THIS SOFTWARE IS PROVIDED AS-IS, WITH NO WARRANTY OF ANY KIND,
+* EXPRESS OR IMPLIED, INCLUDING, BUT NOT LIMITED TO, NONINFRINGEMENT, IMPLIED
+* WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE. Cypress
+* reserves the right to make changes to the Software without notice. Cypress
+* does not assume any liability arising out of the application or use of the
+* Software or any product or circuit described in the Software. Cypress does
+* not authorize its products for use in any products where a malfunction or
+* failure of the Cypress product may reasonably be expected to result in
+* significant property damage, injury or death ("High Risk Product"). By
+* including Cypress's product in a High Risk Product, the manufacturer of such
+* system or application assumes all risk of such use and in doing so agrees to
+* indemnify Cypress against all liability.
+*******************************************************************************/
+#ifndef SIM_PAL_H
+#define SIM_PAL_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <time.h>
+
+
+/*******************************************************************************
+ * Macros
+ ******************************************************************************/
+/* Size of the secondary slot, as MCUBOOT_SLOT_SIZE */
+#ifndef SIM_SLOT_SIZE
+#define SIM_SLOT_SIZE                   (0x1C0000UL)
+#endif
+
+
+/*******************************************************************************
+ * Data structure and enumeration
+ ******************************************************************************/
+typedef struct
+{
+    uint32_t write_us_per_kb;       /* Program time per KB written */
+    uint32_t erase_ms_per_sector;   /* Erase time of one sector */
+    uint32_t sector_size;           /* Erase sector, in bytes */
+} sim_pal_config_t;
+
+typedef struct
+{
+    uint32_t writes;                /* WriteBlock calls */
+    uint64_t bytes_written;
+    uint64_t write_us;              /* Modeled program time */
+    uint64_t erase_us;              /* Modeled erase time */
+    uint32_t files;                 /* Files created */
+    uint32_t aborts;
+    bool closed;                    /* CloseFile was called */
+    bool verified;                  /* The file matched the image */
+    uint32_t create_tick;           /* Tick of the last CreateFileForRx */
+    uint32_t close_tick;            /* Tick of the last CloseFile */
+    bool agent_clock_valid;
+    clockid_t agent_clock;          /* CPU clock of the agent thread */
+} sim_pal_stats_t;
+
+
+/*******************************************************************************
+ * Function prototypes
+ ******************************************************************************/
+bool sim_pal_init(const sim_pal_config_t *config, const uint8_t *image, size_t size);
+void sim_pal_get_stats(sim_pal_stats_t *stats);
+
+
+#endif /* SIM_PAL_H */
+
+
+/* [] END OF FILE */
@@ -0,0 +1,463 @@
+/******************************************************************************
+* File Name: sim_peer.c
+*
+* Description: Host simulation of the LAN redistribution of an OTA image
+* (sources/ota_peer.c) between several devices on the loopback interface.
+*
+* The launcher serves the image as the cloud, over a link of --cloud-kbps
+* shared by all devices, and starts each device as a process of its own.
+* The first device downloads the image from the cloud; once it is verified,
+* the other devices start together, discover the devices that serve the
+* image, fetch their ranges from them and fall back to the cloud when a peer
+* fails. Each device serves the image in turn once it is verified.
+*
+* A device fetches ranges one at a time on one persistent connection, as one
+* connection of sources/ota_http_stream.c does, and checks the image against
+* the one served by the cloud where the device checks the signature. The
+* discovery, the range server and the image withdrawal are the ones of the
+* app.
+*
+* Related Document: See README.md
+*
+*******************************************************************************
+* (c) 2020, Cypress Semiconductor Corporation. All rights reserved.
+*******************************************************************************
+* This software, including source code, documentation and related materials
+* ("Software"), is owned by Cypress Semiconductor Corporation or one of its
+* subsidiaries ("Cypress") and is protected by and subject to worldwide patent
+* protection (United States and foreign), United States copyright laws and
+* international treaty provisions. Therefore, you may use this Software only
+* as provided in the license agreement accompanying the software package from
+* which you obtained this Software ("EULA").
+*
+* If no EULA applies, Cypress hereby grants you a personal, non-exclusive,
+* non-transferable license to copy, modify, and compile the Software source
+* code solely for use in connection with Cypress's integrated circuit products.
+* Any reproduction, modification, translation, compilation, or representation
+* of this Software except as specified above is prohibited without the express
+* written permission of Cypress.
+*
+* Disclaimer: THIS SOFTWARE IS PROVIDED AS-IS, WITH NO WARRANTY OF ANY KIND,
+* EXPRESS OR IMPLIED, INCLUDING, BUT NOT LIMITED TO, NONINFRINGEMENT, IMPLIED
+* WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE. Cypress
+* reserves the right to make changes to the Software without notice. Cypress
+* does not assume any liability arising out of the application or use of the
+* Software or any product or circuit described in the Software. Cypress does
+* not authorize its products for use in any products where a malfunction or
+* failure of the Cypress product may reasonably be expected to result in
+* significant property damage, injury or death ("High Risk Product"). By
+* including Cypress's product in a High Risk Product, the manufacturer of such
+* system or application assumes all risk of such use and in doing so agrees to
+* indemnify Cypress against all liability.
+*******************************************************************************/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <getopt.h>
+#include <signal.h>
+#include <unistd.h>
+#include <sys/wait.h>
+#include "FreeRTOS.h"
+#include "task.h"
+#include "lwip/sockets.h"
+#include "sim_peer_port.h"
+#include "sim_cloud.h"
+#include "ota_peer.h"
+
+
+/*******************************************************************************
+ * Macros
+ ******************************************************************************/
+#define SIM_DEFAULT_DEVICES             (4U)
+#define SIM_DEFAULT_SIZE                (512U * 1024U)
+#define SIM_DEFAULT_SEED                (1U)
+#define SIM_DEFAULT_CLOUD_KBPS          (4000U)
+#define SIM_DEFAULT_RANGE               (65536U)
+#define SIM_DEFAULT_TIMEOUT_S           (120U)
+
+#define SIM_MAX_DEVICES                 (32U)
+#define SIM_WATCH_MS                    (10U)
+
+#define EXIT_USAGE                      (2)
+
+
+/*******************************************************************************
+ * Global variables
+ ******************************************************************************/
+static const struct option sim_options[] =
+{
+    { "devices",                required_argument, NULL, 'n' },
+    { "size",                   required_argument, NULL, 's' },
+    { "seed",                   required_argument, NULL, 'S' },
+    { "cloud-kbps",             required_argument, NULL, 'c' },
+    { "range",                  required_argument, NULL, 'r' },
+    { "fail-after",             required_argument, NULL, 'f' },
+    { "timeout-s",              required_argument, NULL, 'T' },
+    { "verbose",                no_argument,       NULL, 'v' },
+    { "help",                   no_argument,       NULL, 'h' },
+    /* Set by the launcher for each device */
+    { "device",                 required_argument, NULL, 'D' },
+    { "cloud-port",             required_argument, NULL, 'P' },
+    { "ready-fd",               required_argument, NULL, 'R' },
+    { NULL,                     0,                 NULL, 0 }
+};
+
+static uint32_t devices = SIM_DEFAULT_DEVICES;
+static uint32_t image_size = SIM_DEFAULT_SIZE;
+static uint64_t seed = SIM_DEFAULT_SEED;
+static uint32_t cloud_kbps = SIM_DEFAULT_CLOUD_KBPS;
+static uint32_t range_size = SIM_DEFAULT_RANGE;
+static uint32_t fail_after;
+static uint32_t timeout_s = SIM_DEFAULT_TIMEOUT_S;
+static bool verbose;
+static int device = -1;
+static uint16_t cloud_port;
+static int ready_fd = -1;
+
+static uint8_t *image;
+static uint8_t signature[SIM_SIGNATURE_SIZE];
+
+
+/*******************************************************************************
+ * Function Name: watch_task
+ *******************************************************************************
+ * Summary:
+ *  Withdraws the image of the device once it has served --fail-after bytes,
+ *  as if it was reset in the middle of the transfers of its peers.
+ *
+ ******************************************************************************/
+static void watch_task(void *arg)
+{
+    ota_peer_stats_t stats;
+
+    (void)arg;
+
+    do
+    {
+        vTaskDelay(pdMS_TO_TICKS(SIM_WATCH_MS));
+        ota_peer_get(&stats);
+    } while (stats.serving && (stats.bytes < fail_after));
+
+    configPRINTF(("withdrawing the image after %u bytes served\n", (unsigned int)stats.bytes));
+    ota_peer_withdraw();
+    vTaskDelete(NULL);
+}
+
+
+/*******************************************************************************
+ * Function Name: device_main
+ *******************************************************************************
+ * Summary:
+ *  Runs one device: finds a peer, downloads the image from it or from the
+ *  cloud, checks it, then serves it until ota_peer_hold() returns. Prints one
+ *  line of results.
+ *
+ * Return:
+ *  int - exit status: 0 if the image was received intact
+ *
+ ******************************************************************************/
+static int device_main(void)
+{
+    char name[16];
+    char path[sizeof(OTA_PEER_PATH "ffffffff")];
+    uint8_t *slot = calloc(1U, image_size);
+    uint32_t image_id = ota_peer_image_id(signature, SIM_SIGNATURE_SIZE);
+    sim_link_t cloud = { -1, 0U, 0U, SIM_CLOUD_PATH };
+    sim_link_t peer = { -1, 0U, 0U, path };
+    ota_peer_addr_t peer_addr;
+    ota_peer_stats_t served;
+    TickType_t start = xTaskGetTickCount();
+    TickType_t elapsed;
+    TickType_t find_tick;
+    uint32_t peer_bytes = 0U;
+    uint32_t peer_failures = 0U;
+    bool use_peer;
+    bool verified;
+
+    if (NULL == slot)
+    {
+        return EXIT_FAILURE;
+    }
+
+    (void)snprintf(name, sizeof(name), "device %d", device);
+    (void)snprintf(path, sizeof(path), OTA_PEER_PATH "%08lx", (unsigned long)image_id);
+    sim_peer_port_init(slot, image_size, name, verbose);
+
+    cloud.address = htonl(INADDR_LOOPBACK);
+    cloud.port = cloud_port;
+
+    use_peer = false;
+    find_tick = start - pdMS_TO_TICKS(OTA_PEER_RETRY_MS);
+
+    for (uint32_t off = 0U; off < image_size; off += range_size)
+    {
+        uint32_t len = ((image_size - off) < range_size) ? (image_size - off) : range_size;
+        bool received = false;
+
+        /* As ota_http_stream.c: look for a peer again while none is used */
+        if (!use_peer && ((xTaskGetTickCount() - find_tick) >= pdMS_TO_TICKS(OTA_PEER_RETRY_MS)))
+        {
+            find_tick = xTaskGetTickCount();
+            use_peer = ota_peer_find(image_id, image_size, &peer_addr);
+            if (use_peer)
+            {
+                sim_link_close(&peer);
+                peer.address = peer_addr.address;
+                peer.port = peer_addr.port;
+                configPRINTF(("image served by the peer on port %u\n", (unsigned int)peer.port));
+            }
+        }
+
+        if (use_peer)
+        {
+            received = sim_link_get_range(&peer, image_size, off, len, &slot[off]);
+            if (received)
+            {
+                peer_bytes += len;
+            }
+            else
+            {
+                configPRINTF(("range at %u failed on the peer, using the cloud\n", (unsigned int)off));
+                peer_failures++;
+                use_peer = false;
+            }
+        }
+
+        if (!received && !sim_link_get_range(&cloud, image_size, off, len, &slot[off]))
+        {
+            configPRINTF(("range at %u failed on the cloud\n", (unsigned int)off));
+            break;
+        }
+    }
+
+    sim_link_close(&peer);
+    sim_link_close(&cloud);
+
+    elapsed = xTaskGetTickCount() - start;
+    verified = (0 == memcmp(slot, image, image_size));
+
+    if (verified)
+    {
+        ota_peer_serve(image_id, image_size);
+
+        if (ready_fd >= 0)
+        {
+            (void)write(ready_fd, "r", 1U);
+            (void)close(ready_fd);
+        }
+
+        if ((0U != fail_after) &&
+            (pdPASS != xTaskCreate(watch_task, "watch", configMINIMAL_STACK_SIZE, NULL, 1U, NULL)))
+        {
+            return EXIT_FAILURE;
+        }
+
+        ota_peer_hold();
+    }
+
+    ota_peer_get(&served);
+
+    printf("device=%d result=%s time_ms=%lu peer_bytes=%lu cloud_bytes=%lu peer_failures=%lu "
+           "served_bytes=%lu served_ranges=%lu served_connections=%lu\n",
+           device, verified ? "verified" : "corrupt", (unsigned long)elapsed,
+           (unsigned long)peer_bytes, (unsigned long)(image_size - peer_bytes),
+           (unsigned long)peer_failures, (unsigned long)served.bytes,
+           (unsigned long)served.ranges, (unsigned long)served.clients);
+    (void)fflush(stdout);
+
+    return verified ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+
+/*******************************************************************************
+ * Function Name: spawn_device
+ *******************************************************************************
+ * Summary:
+ *  Starts a device process: this program with the arguments of the run and
+ *  the index of the device.
+ *
+ * Return:
+ *  pid_t - process ID, or -1 on error
+ *
+ ******************************************************************************/
+static pid_t spawn_device(const char *program, uint32_t index, int ready)
+{
+    char args[7][24];
+    pid_t pid;
+
+    (void)snprintf(args[0], sizeof(args[0]), "--device=%u", (unsigned int)index);
+    (void)snprintf(args[1], sizeof(args[1]), "--cloud-port=%u", (unsigned int)cloud_port);
+    (void)snprintf(args[2], sizeof(args[2]), "--ready-fd=%d", ready);
+    (void)snprintf(args[3], sizeof(args[3]), "--size=%lu", (unsigned long)image_size);
+    (void)snprintf(args[4], sizeof(args[4]), "--seed=%llu", (unsigned long long)seed);
+    (void)snprintf(args[5], sizeof(args[5]), "--range=%lu", (unsigned long)range_size);
+    (void)snprintf(args[6], sizeof(args[6]), "--fail-after=%lu",
+                   (unsigned long)((0U == index) ? fail_after : 0U));
+
+    (void)fflush(stdout);
+    pid = fork();
+
+    if (0 == pid)
+    {
+        char *argv[] = { (char *)program, args[0], args[1], args[2], args[3], args[4],
+                         args[5], args[6], verbose ? "--verbose" : NULL, NULL };
+
+        (void)execv(program, argv);
+        _exit(EXIT_FAILURE);
+    }
+
+    return pid;
+}
+
+
+/*******************************************************************************
+ * Function Name: launcher_main
+ *******************************************************************************
+ * Summary:
+ *  Serves the cloud, starts the first device, then the others once it
+ *  serves the image, and prints the totals of the run.
+ *
+ * Return:
+ *  int - exit status: 0 if every device received the image intact
+ *
+ ******************************************************************************/
+static int launcher_main(const char *program)
+{
+    pid_t pids[SIM_MAX_DEVICES];
+    int ready[2];
+    int status = EXIT_SUCCESS;
+    uint64_t start = sim_now_ns();
+    char byte;
+
+    if (!sim_cloud_start(image, image_size, cloud_kbps, &cloud_port) || (0 != pipe(ready)))
+    {
+        perror("sim");
+        return EXIT_FAILURE;
+    }
+
+    pids[0] = spawn_device(program, 0U, ready[1]);
+    (void)close(ready[1]);
+
+    if ((pids[0] < 0) || (1 != read(ready[0], &byte, 1U)))
+    {
+        fprintf(stderr, "sim: the first device did not receive the image\n");
+        return EXIT_FAILURE;
+    }
+
+    for (uint32_t i = 1U; i < devices; i++)
+    {
+        pids[i] = spawn_device(program, i, -1);
+    }
+
+    (void)alarm(timeout_s);
+
+    for (uint32_t i = 0U; i < devices; i++)
+    {
+        int exit_status;
+
+        if ((pids[i] < 0) || (pids[i] != waitpid(pids[i], &exit_status, 0)) ||
+            !WIFEXITED(exit_status) || (EXIT_SUCCESS != WEXITSTATUS(exit_status)))
+        {
+            status = EXIT_FAILURE;
+        }
+    }
+
+    printf("result=%s\n", (EXIT_SUCCESS == status) ? "verified" : "failed");
+    printf("devices=%lu\n", (unsigned long)devices);
+    printf("file_bytes=%lu\n", (unsigned long)image_size);
+    printf("cloud_bytes=%llu\n", (unsigned long long)sim_cloud_bytes());
+    printf("cloud_bytes_without_peers=%llu\n", (unsigned long long)devices * image_size);
+    printf("time_ms=%llu\n", (unsigned long long)((sim_now_ns() - start) / (NS_PER_S / MS_PER_S)));
+
+    return status;
+}
+
+
+/*******************************************************************************
+ * Function Name: usage
+ ******************************************************************************/
+static void usage(const char *name)
+{
+    fprintf(stderr,
+        "usage: %s [options]\n"
+        "  --devices N                devices on the LAN, at most %u (default %u)\n"
+        "  --size BYTES               size of the image (default %u)\n"
+        "  --seed N                   seed of the image (default %u)\n"
+        "  --cloud-kbps KBPS          cloud link shared by the devices, 0 unlimited (default %u)\n"
+        "  --range BYTES              bytes per ranged GET (default %u)\n"
+        "  --fail-after BYTES         the first device withdraws the image after serving\n"
+        "                             BYTES, 0 never (default 0)\n"
+        "  --timeout-s S              give up after S seconds (default %u)\n"
+        "  --verbose                  print the log of the devices\n",
+        name, SIM_MAX_DEVICES, SIM_DEFAULT_DEVICES, SIM_DEFAULT_SIZE, SIM_DEFAULT_SEED,
+        SIM_DEFAULT_CLOUD_KBPS, SIM_DEFAULT_RANGE, SIM_DEFAULT_TIMEOUT_S);
+}
+
+
+/*******************************************************************************
+ * Function Name: main
+ ******************************************************************************/
+int main(int argc, char *argv[])
+{
+    int opt;
+
+    while (-1 != (opt = getopt_long(argc, argv, "", sim_options, NULL)))
+    {
+        switch (opt)
+        {
+            case 'n':
+                devices = (uint32_t)strtoul(optarg, NULL, 0);
+                break;
+            case 's':
+                image_size = (uint32_t)strtoul(optarg, NULL, 0);
+                break;
+            case 'S':
+                seed = strtoull(optarg, NULL, 0);
+                break;
+            case 'c':
+                cloud_kbps = (uint32_t)strtoul(optarg, NULL, 0);
+                break;
+            case 'r':
+                range_size = (uint32_t)strtoul(optarg, NULL, 0);
+                break;
+            case 'f':
+                fail_after = (uint32_t)strtoul(optarg, NULL, 0);
+                break;
+            case 'T':
+                timeout_s = (uint32_t)strtoul(optarg, NULL, 0);
+                break;
+            case 'v':
+                verbose = true;
+                break;
+            case 'D':
+                device = (int)strtol(optarg, NULL, 0);
+                break;
+            case 'P':
+                cloud_port = (uint16_t)strtoul(optarg, NULL, 0);
+                break;
+            case 'R':
+                ready_fd = (int)strtol(optarg, NULL, 0);
+                break;
+            default:
+                usage(argv[0]);
+                return EXIT_USAGE;
+        }
+    }
+    if ((optind != argc) || (0U == image_size) || (0U == range_size) ||
+        (0U == devices) || (devices > SIM_MAX_DEVICES))
+    {
+        usage(argv[0]);
+        return EXIT_USAGE;
+    }
+
+    image = sim_make_image(seed, image_size, signature);
+    if (NULL == image)
+    {
+        return EXIT_FAILURE;
+    }
+
+    return (device >= 0) ? device_main() : launcher_main(argv[0]);
+}
+
+
+/* [] END OF FILE */
@@ -0,0 +1,612 @@
+/******************************************************************************
+* File Name: sim_read_cache.c
+*
+* Description: Host simulation of the read cache of the bootloader
+* (bootloader_cm0p/flash_read_cache.c). It replays the reads of the secondary
+* slot that bootutil of MCUboot issues in one boot_go() call in the
+* overwrite-only mode of the bootloader, for three boot paths:
+*
+*  - none: the secondary slot is erased. The image header and the trailer
+*    fields (magic, swap info, copy done, image ok) are read.
+*  - upgrade: the secondary slot holds a pending image. The header and the
+*    trailer are read, the image is hashed in reads of BOOT_TMPBUF_SZ bytes,
+*    its TLVs are read one by one, the slot is copied to the primary slot in
+*    reads of 1 KB, the first and the last sector of the slot are erased, and
+*    the header is read again.
+*  - invalid: as upgrade up to the TLVs, then the hash does not match and the
+*    whole slot is erased before the header is read again.
+*
+* Each path runs once straight on the flash stand-in and once through the
+* cache. Every uncached read of the external flash is one SMIF transaction;
+* the simulation prints, for each path, the reads, the hits, the transactions
+* and bytes read with and without the cache, and a read time modeled from
+* --transaction-us per transaction and --read-kbps. It fails if a read through
+* the cache returns other data than the flash, in particular after the erases.
+* The reads of the primary slot, in the internal flash, do not go through the
+* cache and are left out.
+*
+* Related Document: See README.md
+*
+*******************************************************************************
+* (c) 2020, Cypress Semiconductor Corporation. All rights reserved.
+*******************************************************************************
+* This software, including source code, documentation and related materials
+* ("Software"), is owned by Cypress Semiconductor Corporation or one of its
+* subsidiaries ("Cypress") and is protected by and subject to worldwide patent
+* protection (United States and foreign), United States copyright laws and
+* international treaty provisions. Therefore, you may use this Software only
+* as provided in the license agreement accompanying the software package from
+* which you obtained this Software ("EULA").
+*
+* If no EULA applies, Cypress hereby grants you a personal, non-exclusive,
+* non-transferable license to copy, modify, and compile the Software source
+* code solely for use in connection with Cypress's integrated circuit products.
+* Any reproduction, modification, translation, compilation, or representation
+* of this Software except as specified above is prohibited without the express
+* written permission of Cypress.
+*
+* Disclaimer: THIS SOFTWARE IS PROVIDED AS-IS, WITH NO WARRANTY OF ANY KIND,
+* EXPRESS OR IMPLIED, INCLUDING, BUT NOT LIMITED TO, NONINFRINGEMENT, IMPLIED
+* WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE. Cypress
+* reserves the right to make changes to the Software without notice. Cypress
+* does not assume any liability arising out of the application or use of the
+* Software or any product or circuit described in the Software. Cypress does
+* not authorize its products for use in any products where a malfunction or
+* failure of the Cypress product may reasonably be expected to result in
+* significant property damage, injury or death ("High Risk Product"). By
+* including Cypress's product in a High Risk Product, the manufacturer of such
+* system or application assumes all risk of such use and in doing so agrees to
+* indemnify Cypress against all liability.
+*******************************************************************************/
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <string.h>
+#include <getopt.h>
+#include "flash_read_cache.h"
+
+
+/*******************************************************************************
+ * Macros
+ ******************************************************************************/
+#define SIM_DEFAULT_SIZE                (1024U * 1024U)
+#define SIM_DEFAULT_SEED                (1U)
+#define SIM_DEFAULT_TRANSACTION_US      (10U)
+#define SIM_DEFAULT_READ_KBPS           (100000U)
+
+/* Layout of the bootloader with USE_EXT_FLASH=1 (shared_config.mk) */
+#define SIM_SLOT_SIZE                   (0x001C0000U)
+#define SIM_HEADER_SIZE                 (0x400U)
+#define SIM_SECTOR_SIZE                 (512U)
+#define SIM_ERASED_VAL                  (0xFFU)
+#define SIM_EXTERNAL_DEVICE_INDEX       (1U)
+
+/* Reads of bootutil */
+#define BOOT_TMPBUF_SZ                  (256U)
+#define BOOT_COPY_BUF_SZ                (1024U)
+#define BOOT_MAGIC_SZ                   (16U)
+#define BOOT_MAX_ALIGN                  (8U)
+#define IMAGE_HEADER_SZ                 (32U)
+#define IMAGE_MAGIC                     (0x96f3b83dUL)
+#define IMAGE_TLV_INFO_MAGIC            (0x6907U)
+#define IMAGE_TLV_INFO_SZ               (4U)
+#define IMAGE_TLV_SZ                    (4U)
+#define IMAGE_TLV_KEYHASH               (0x01U)
+#define IMAGE_TLV_SHA256                (0x10U)
+#define IMAGE_TLV_ECDSA256              (0x22U)
+#define SIM_HASH_SZ                     (32U)
+#define SIM_SIGNATURE_SZ                (72U)
+
+#define BYTES_PER_S_PER_KBPS            (1000U / 8U)
+#define US_PER_S                        (1000000ULL)
+#define PERCENT                         (100U)
+
+#define EXIT_USAGE                      (2)
+
+
+/*******************************************************************************
+ * Data structure and enumeration
+ ******************************************************************************/
+typedef enum
+{
+    SIM_PATH_NONE,
+    SIM_PATH_UPGRADE,
+    SIM_PATH_INVALID,
+    SIM_PATH_COUNT
+} sim_path_t;
+
+/* SMIF traffic of one run of a boot path */
+typedef struct
+{
+    uint32_t reads;
+    uint32_t transactions;
+    uint64_t bytes;
+} sim_traffic_t;
+
+
+/*******************************************************************************
+ * Global variables
+ ******************************************************************************/
+static const struct option sim_options[] =
+{
+    { "size",                   required_argument, NULL, 's' },
+    { "seed",                   required_argument, NULL, 'S' },
+    { "transaction-us",         required_argument, NULL, 't' },
+    { "read-kbps",              required_argument, NULL, 'k' },
+    { "help",                   no_argument,       NULL, 'h' },
+    { NULL,                     0,                 NULL, 0 }
+};
+
+static const char * const path_names[SIM_PATH_COUNT] = { "none", "upgrade", "invalid" };
+
+static uint32_t image_size = SIM_DEFAULT_SIZE;
+static uint64_t seed = SIM_DEFAULT_SEED;
+static uint32_t transaction_us = SIM_DEFAULT_TRANSACTION_US;
+static uint32_t read_kbps = SIM_DEFAULT_READ_KBPS;
+
+static const struct flash_area secondary =
+{
+    .fa_id = 2U,
+    .fa_device_id = FLASH_DEVICE_EXTERNAL_FLASH(SIM_EXTERNAL_DEVICE_INDEX),
+    .fa_off = 0U,
+    .fa_size = SIM_SLOT_SIZE
+};
+
+static uint8_t *slot;
+static uint8_t *image;          /* Content of the slot at the start of a path */
+static uint64_t rng_state;
+static bool cached;
+static bool mismatch;
+static sim_traffic_t traffic;
+
+
+/*******************************************************************************
+ * Function Name: sim_random
+ *******************************************************************************
+ * Summary:
+ *  xorshift64 generator of the image.
+ *
+ ******************************************************************************/
+static uint32_t sim_random(void)
+{
+    rng_state ^= rng_state << 13;
+    rng_state ^= rng_state >> 7;
+    rng_state ^= rng_state << 17;
+
+    return (uint32_t)(rng_state >> 32);
+}
+
+
+/*******************************************************************************
+ * Function Name: put_le
+ ******************************************************************************/
+static void put_le(uint8_t *dst, uint32_t value, uint32_t len)
+{
+    for (uint32_t i = 0U; i < len; i++)
+    {
+        dst[i] = (uint8_t)(value >> (8U * i));
+    }
+}
+
+
+/*******************************************************************************
+ * Function Name: get_le
+ ******************************************************************************/
+static uint32_t get_le(const uint8_t *src, uint32_t len)
+{
+    uint32_t value = 0U;
+
+    for (uint32_t i = 0U; i < len; i++)
+    {
+        value |= (uint32_t)src[i] << (8U * i);
+    }
+
+    return value;
+}
+
+
+/*******************************************************************************
+ * Function Name: smif_read
+ *******************************************************************************
+ * Summary:
+ *  Uncached read of the slot: one SMIF transaction.
+ *
+ ******************************************************************************/
+static int smif_read(const struct flash_area *fa, uint32_t off, void *dst, uint32_t len)
+{
+    if ((off + len) > fa->fa_size)
+    {
+        return -1;
+    }
+
+    traffic.transactions++;
+    traffic.bytes += len;
+    memcpy(dst, &slot[off], len);
+
+    return 0;
+}
+
+
+/*******************************************************************************
+ * Function Name: boot_read
+ *******************************************************************************
+ * Summary:
+ *  flash_area_read() of bootutil, through the cache or not, as
+ *  bootloader_cm0p/flash_area_wrap.c does. Checks the data read against the
+ *  slot.
+ *
+ ******************************************************************************/
+static void boot_read(uint32_t off, void *dst, uint32_t len)
+{
+    int rc;
+
+    traffic.reads++;
+    if (cached)
+    {
+        rc = flash_read_cache_read(&secondary, off, dst, len, smif_read);
+    }
+    else
+    {
+        rc = smif_read(&secondary, off, dst, len);
+    }
+
+    if ((0 != rc) || (0 != memcmp(dst, &slot[off], len)))
+    {
+        mismatch = true;
+    }
+}
+
+
+/*******************************************************************************
+ * Function Name: boot_erase
+ *******************************************************************************
+ * Summary:
+ *  flash_area_erase() of bootutil: invalidates the cache, as
+ *  bootloader_cm0p/flash_area_wrap.c does, and erases the range.
+ *
+ ******************************************************************************/
+static void boot_erase(uint32_t off, uint32_t len)
+{
+    if (cached)
+    {
+        flash_read_cache_invalidate(&secondary, off, len);
+    }
+
+    memset(&slot[off], SIM_ERASED_VAL, len);
+}
+
+
+/*******************************************************************************
+ * Function Name: boot_read_image_header
+ ******************************************************************************/
+static uint32_t boot_read_image_header(void)
+{
+    uint8_t hdr[IMAGE_HEADER_SZ];
+
+    boot_read(0U, hdr, sizeof(hdr));
+
+    return get_le(hdr, 4U);
+}
+
+
+/*******************************************************************************
+ * Function Name: boot_read_swap_state
+ *******************************************************************************
+ * Summary:
+ *  Reads the magic, the swap info, the copy done and the image ok fields of
+ *  the trailer.
+ *
+ * Return:
+ *  bool - the magic is set
+ *
+ ******************************************************************************/
+static bool boot_read_swap_state(void)
+{
+    uint32_t magic_off = SIM_SLOT_SIZE - BOOT_MAGIC_SZ;
+    uint32_t image_ok_off = magic_off - BOOT_MAX_ALIGN;
+    uint32_t copy_done_off = image_ok_off - BOOT_MAX_ALIGN;
+    uint32_t swap_info_off = copy_done_off - BOOT_MAX_ALIGN;
+    uint8_t magic[BOOT_MAGIC_SZ];
+    uint8_t field;
+
+    boot_read(magic_off, magic, sizeof(magic));
+    boot_read(swap_info_off, &field, sizeof(field));
+    boot_read(copy_done_off, &field, sizeof(field));
+    boot_read(image_ok_off, &field, sizeof(field));
+
+    return (SIM_ERASED_VAL != magic[0]);
+}
+
+
+/*******************************************************************************
+ * Function Name: boot_img_validate
+ *******************************************************************************
+ * Summary:
+ *  Hashes the header and the image in reads of BOOT_TMPBUF_SZ bytes, then
+ *  reads the TLV info, and the header and the value of each TLV.
+ *
+ ******************************************************************************/
+static void boot_img_validate(uint32_t size)
+{
+    uint8_t buf[BOOT_TMPBUF_SZ];
+    uint32_t off;
+    uint32_t end;
+
+    for (off = 0U; off < size; off += BOOT_TMPBUF_SZ)
+    {
+        boot_read(off, buf, ((size - off) < BOOT_TMPBUF_SZ) ? (size - off) : BOOT_TMPBUF_SZ);
+    }
+
+    boot_read(size, buf, IMAGE_TLV_INFO_SZ);
+    if (IMAGE_TLV_INFO_MAGIC != get_le(buf, 2U))
+    {
+        return;
+    }
+
+    end = size + get_le(&buf[2], 2U);
+    for (off = size + IMAGE_TLV_INFO_SZ; off < end; )
+    {
+        uint32_t len;
+
+        boot_read(off, buf, IMAGE_TLV_SZ);
+        len = get_le(&buf[2], 2U);
+        off += IMAGE_TLV_SZ;
+        if ((len > sizeof(buf)) || ((off + len) > end))
+        {
+            return;
+        }
+
+        boot_read(off, buf, len);
+        off += len;
+    }
+}
+
+
+/*******************************************************************************
+ * Function Name: boot_copy_image
+ *******************************************************************************
+ * Summary:
+ *  Copies the slot to the primary slot in reads of BOOT_COPY_BUF_SZ bytes,
+ *  then erases the first and the last sector of the secondary slot.
+ *
+ ******************************************************************************/
+static void boot_copy_image(void)
+{
+    uint8_t buf[BOOT_COPY_BUF_SZ];
+
+    for (uint32_t off = 0U; off < SIM_SLOT_SIZE; off += BOOT_COPY_BUF_SZ)
+    {
+        boot_read(off, buf, BOOT_COPY_BUF_SZ);
+    }
+
+    boot_erase(0U, SIM_SECTOR_SIZE);
+    boot_erase(SIM_SLOT_SIZE - SIM_SECTOR_SIZE, SIM_SECTOR_SIZE);
+}
+
+
+/*******************************************************************************
+ * Function Name: boot_go
+ *******************************************************************************
+ * Summary:
+ *  Reads of the secondary slot of one boot_go() call in a boot path.
+ *
+ ******************************************************************************/
+static void boot_go(sim_path_t path)
+{
+    uint32_t size = SIM_HEADER_SIZE + image_size;
+    uint32_t magic = boot_read_image_header();
+    bool pending = boot_read_swap_state();
+
+    if ((IMAGE_MAGIC != magic) || !pending)
+    {
+        return;
+    }
+
+    boot_img_validate(size);
+    if (SIM_PATH_UPGRADE == path)
+    {
+        boot_copy_image();
+    }
+    else
+    {
+        boot_erase(0U, SIM_SLOT_SIZE);
+    }
+
+    (void)boot_read_image_header();
+}
+
+
+/*******************************************************************************
+ * Function Name: make_slot
+ *******************************************************************************
+ * Summary:
+ *  Builds the content of the secondary slot of a boot path: an erased slot,
+ *  or a signed image pending for test, with the TLVs of imgtool (SHA-256,
+ *  key hash, ECDSA P-256 signature).
+ *
+ ******************************************************************************/
+static void make_slot(sim_path_t path)
+{
+    uint32_t tlv_off = SIM_HEADER_SIZE + image_size;
+    uint32_t tlv_size = IMAGE_TLV_INFO_SZ + (3U * IMAGE_TLV_SZ) + (2U * SIM_HASH_SZ) + SIM_SIGNATURE_SZ;
+    const uint8_t tlvs[][2] =
+    {
+        { IMAGE_TLV_SHA256, SIM_HASH_SZ },
+        { IMAGE_TLV_KEYHASH, SIM_HASH_SZ },
+        { IMAGE_TLV_ECDSA256, SIM_SIGNATURE_SZ }
+    };
+    uint32_t off;
+
+    memset(image, SIM_ERASED_VAL, SIM_SLOT_SIZE);
+    if (SIM_PATH_NONE == path)
+    {
+        return;
+    }
+
+    memset(image, 0, SIM_HEADER_SIZE);
+    put_le(&image[0], IMAGE_MAGIC, 4U);
+    put_le(&image[8], SIM_HEADER_SIZE, 2U);
+    put_le(&image[12], image_size, 4U);
+    for (off = SIM_HEADER_SIZE; off < tlv_off; off++)
+    {
+        image[off] = (uint8_t)sim_random();
+    }
+
+    put_le(&image[tlv_off], IMAGE_TLV_INFO_MAGIC, 2U);
+    put_le(&image[tlv_off + 2U], tlv_size, 2U);
+    off = tlv_off + IMAGE_TLV_INFO_SZ;
+    for (uint32_t i = 0U; i < (sizeof(tlvs) / sizeof(tlvs[0])); i++)
+    {
+        image[off] = tlvs[i][0];
+        image[off + 1U] = 0U;
+        put_le(&image[off + 2U], tlvs[i][1], 2U);
+        off += IMAGE_TLV_SZ;
+        for (uint32_t j = 0U; j < tlvs[i][1]; j++)
+        {
+            image[off++] = (uint8_t)sim_random();
+        }
+    }
+
+    /* Pending for test: the magic only */
+    for (off = SIM_SLOT_SIZE - BOOT_MAGIC_SZ; off < SIM_SLOT_SIZE; off++)
+    {
+        image[off] = (uint8_t)sim_random();
+    }
+}
+
+
+/*******************************************************************************
+ * Function Name: run
+ *******************************************************************************
+ * Summary:
+ *  Runs a boot path from a new copy of its slot, through the cache or not.
+ *  The cache starts empty, as after a reset.
+ *
+ ******************************************************************************/
+static sim_traffic_t run(sim_path_t path, bool use_cache)
+{
+    memcpy(slot, image, SIM_SLOT_SIZE);
+    flash_read_cache_invalidate(&secondary, 0U, SIM_SLOT_SIZE);
+    memset(&traffic, 0, sizeof(traffic));
+    cached = use_cache;
+
+    boot_go(path);
+
+    return traffic;
+}
+
+
+/*******************************************************************************
+ * Function Name: read_time_us
+ ******************************************************************************/
+static uint64_t read_time_us(const sim_traffic_t *t)
+{
+    return ((uint64_t)t->transactions * transaction_us) +
+           ((t->bytes * US_PER_S) / ((uint64_t)read_kbps * BYTES_PER_S_PER_KBPS));
+}
+
+
+/*******************************************************************************
+ * Function Name: usage
+ ******************************************************************************/
+static void usage(const char *name)
+{
+    fprintf(stderr,
+        "usage: %s [options]\n"
+        "  --size BYTES               size of the image, without header and TLVs (default %u)\n"
+        "  --seed N                   seed of the image (default %u)\n"
+        "  --transaction-us US        time of a SMIF read besides its data (default %u)\n"
+        "  --read-kbps KBPS           data rate of a SMIF read (default %u)\n",
+        name, SIM_DEFAULT_SIZE, SIM_DEFAULT_SEED, SIM_DEFAULT_TRANSACTION_US,
+        SIM_DEFAULT_READ_KBPS);
+}
+
+
+/*******************************************************************************
+ * Function Name: main
+ ******************************************************************************/
+int main(int argc, char *argv[])
+{
+    int opt;
+
+    while (-1 != (opt = getopt_long(argc, argv, "", sim_options, NULL)))
+    {
+        switch (opt)
+        {
+            case 's':
+                image_size = (uint32_t)strtoul(optarg, NULL, 0);
+                break;
+            case 'S':
+                seed = strtoull(optarg, NULL, 0);
+                break;
+            case 't':
+                transaction_us = (uint32_t)strtoul(optarg, NULL, 0);
+                break;
+            case 'k':
+                read_kbps = (uint32_t)strtoul(optarg, NULL, 0);
+                break;
+            default:
+                usage(argv[0]);
+                return EXIT_USAGE;
+        }
+    }
+    if ((optind != argc) || (0U == image_size) || (0U == read_kbps) ||
+        ((SIM_HEADER_SIZE + image_size + BOOT_TMPBUF_SZ + SIM_SECTOR_SIZE) > SIM_SLOT_SIZE))
+    {
+        usage(argv[0]);
+        return EXIT_USAGE;
+    }
+
+    rng_state = (seed * 2654435761ULL) | 1U;
+    slot = malloc(SIM_SLOT_SIZE);
+    image = malloc(SIM_SLOT_SIZE);
+    if ((NULL == slot) || (NULL == image))
+    {
+        return EXIT_FAILURE;
+    }
+
+    printf("line_size=%u\n", (unsigned int)CY_READ_CACHE_LINE_SIZE);
+    printf("lines=%u\n", (unsigned int)CY_READ_CACHE_LINES);
+
+    for (sim_path_t path = SIM_PATH_NONE; path < SIM_PATH_COUNT; path++)
+    {
+        const char *name = path_names[path];
+        flash_read_cache_stats_t before;
+        flash_read_cache_stats_t after;
+        sim_traffic_t uncached;
+        sim_traffic_t with_cache;
+        uint32_t hits;
+
+        make_slot(path);
+        uncached = run(path, false);
+        flash_read_cache_get_stats(&before);
+        with_cache = run(path, true);
+        flash_read_cache_get_stats(&after);
+        hits = after.hits - before.hits;
+
+        printf("%s_reads=%u\n", name, (unsigned int)uncached.reads);
+        printf("%s_hits=%u\n", name, (unsigned int)hits);
+        printf("%s_hit_pct=%u\n", name, (unsigned int)((uncached.reads > 0U) ?
+               ((hits * PERCENT) / uncached.reads) : 0U));
+        printf("%s_fills=%u\n", name, (unsigned int)(after.fills - before.fills));
+        printf("%s_bypassed=%u\n", name, (unsigned int)(after.bypassed - before.bypassed));
+        printf("%s_transactions_uncached=%u\n", name, (unsigned int)uncached.transactions);
+        printf("%s_transactions_cached=%u\n", name, (unsigned int)with_cache.transactions);
+        printf("%s_transactions_saved=%d\n", name,
+               (int)uncached.transactions - (int)with_cache.transactions);
+        printf("%s_bytes_uncached=%llu\n", name, (unsigned long long)uncached.bytes);
+        printf("%s_bytes_cached=%llu\n", name, (unsigned long long)with_cache.bytes);
+        printf("%s_read_us_uncached=%llu\n", name, (unsigned long long)read_time_us(&uncached));
+        printf("%s_read_us_cached=%llu\n", name, (unsigned long long)read_time_us(&with_cache));
+    }
+
+    printf("result=%s\n", mismatch ? "fail" : "pass");
+
+    free(image);
+    free(slot);
+
+    return mismatch ? EXIT_FAILURE : EXIT_SUCCESS;
+}
+
+
+/* [] END OF FILE */
@@ -0,0 +1,442 @@
+/******************************************************************************
+* File Name: sim_resume.c
+*
+* Description: Host simulation of the resume of a download after a reset
+* (sources/ota_resume.c). A file is downloaded into the secondary slot, in the
+* timed model of the external flash (sim_flash.c), as the agent does: the
+* slot is prepared through the bounded erase when the file is opened, then
+* the missing blocks are written in order. The device is reset once a share
+* of the blocks is written, and the file is downloaded again:
+*
+*  - restart: without the resume, every block is downloaded again.
+*  - resume: the blocks of the last checkpoint are kept, and their sectors
+*    are not erased.
+*
+* The blocks downloaded and the time of both downloads, at the data rate of
+* the link plus the flash time, are printed for each reset point, with the
+* cost of the checkpoints in a download without a reset. The simulation fails
+* if the slot does not hold the file at the end, or if a byte is programmed
+* without an erase. The times are counted, not slept.
+*
+* Related Document: See README.md
+*
+*******************************************************************************
+* (c) 2020, Cypress Semiconductor Corporation. All rights reserved.
+*******************************************************************************
+* This software, including source code, documentation and related materials
+* ("Software"), is owned by Cypress Semiconductor Corporation or one of its
+* subsidiaries ("Cypress") and is protected by and subject to worldwide patent
+* protection (United States and foreign), United States copyright laws and
+* international treaty provisions. Therefore, you may use this Software only
+* as provided in the license agreement accompanying the software package from
+* which you obtained this Software ("EULA").
+*
+* If no EULA applies, Cypress hereby grants you a personal, non-exclusive,
+* non-transferable license to copy, modify, and compile the Software source
+* code solely for use in connection with Cypress's integrated circuit products.
+* Any reproduction, modification, translation, compilation, or representation
+* of this Software except as specified above is prohibited without the express
+* written permission of Cypress.
+*
+* Disclaimer: THIS SOFTWARE IS PROVIDED AS-IS, WITH NO WARRANTY OF ANY KIND,
+* EXPRESS OR IMPLIED, INCLUDING, BUT NOT LIMITED TO, NONINFRINGEMENT, IMPLIED
+* WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE. Cypress
+* reserves the right to make changes to the Software without notice. Cypress
+* does not assume any liability arising out of the application or use of the
+* Software or any product or circuit described in the Software. Cypress does
+* not authorize its products for use in any products where a malfunction or
+* failure of the Cypress product may reasonably be expected to result in
+* significant property damage, injury or death ("High Risk Product"). By
+* including Cypress's product in a High Risk Product, the manufacturer of such
+* system or application assumes all risk of such use and in doing so agrees to
+* indemnify Cypress against all liability.
+*******************************************************************************/
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <string.h>
+#include <getopt.h>
+#include "FreeRTOS.h"
+#include "ota_block_size.h"
+#include "ota_slot_erase.h"
+#include "ota_resume.h"
+#include "sim_peer_port.h"
+#include "sim_flash.h"
+
+
+/*******************************************************************************
+ * Macros
+ ******************************************************************************/
+#define SIM_DEFAULT_SIZE                (1536U * 1024U)
+#define SIM_DEFAULT_DOWN_KBPS           (4000U)
+#define SIM_SLOT_SIZE                   (CY_BOOT_SECONDARY_1_SIZE)
+#define SIM_MAX_RESETS                  (8U)
+#define SIM_NO_RESET_PCT                (100U)
+
+#define US_PER_MS                       (1000U)
+#define US_PER_S                        (1000000ULL)
+#define BITS_PER_BYTE                   (8U)
+#define BYTES_PER_KB                    (1024U)
+#define PCT                             (100U)
+
+#define EXIT_USAGE                      (2)
+
+
+/*******************************************************************************
+ * Data structure and enumeration
+ ******************************************************************************/
+/* One download of the file, up to the end or to a reset */
+typedef struct
+{
+    uint32_t kept;                  /* Blocks kept from before the reset */
+    uint32_t received;              /* Blocks downloaded */
+    uint64_t bytes;
+    uint64_t prepare_us;            /* Flash time of the slot preparation */
+    uint64_t flash_us;
+    uint32_t erases;
+    uint32_t pages;
+    bool clean;                     /* Nothing programmed without an erase */
+} sim_attempt_t;
+
+/* A download reset part way, then done again */
+typedef struct
+{
+    sim_attempt_t before;
+    sim_attempt_t after;
+    uint64_t total_us;              /* Link and flash time of both */
+    bool pass;
+} sim_run_t;
+
+
+/*******************************************************************************
+ * Global variables
+ ******************************************************************************/
+static const struct option sim_options[] =
+{
+    { "size",                   required_argument, NULL, 's' },
+    { "reset-pct",              required_argument, NULL, 'p' },
+    { "down-kbps",              required_argument, NULL, 'd' },
+    { "erase-ms",               required_argument, NULL, 'e' },
+    { "verbose",                no_argument,       NULL, 'v' },
+    { "help",                   no_argument,       NULL, 'h' },
+    { NULL,                     0,                 NULL, 0 }
+};
+
+static const uint32_t default_resets[] = { 20U, 50U, 80U, 95U };
+
+static uint32_t file_size = SIM_DEFAULT_SIZE;
+static uint32_t down_kbps = SIM_DEFAULT_DOWN_KBPS;
+static sim_flash_config_t flash_config =
+{
+    .size = SIM_SLOT_SIZE,
+    .sector_size = SIM_FLASH_SECTOR_SIZE,
+    .page_size = SIM_FLASH_PAGE_SIZE,
+    .erase_ms = SIM_FLASH_ERASE_MS,
+    .page_us = SIM_FLASH_PAGE_US,
+    .read_kbps = SIM_FLASH_READ_KBPS,
+    .untimed = true
+};
+static bool verbose;
+static uint8_t *file;
+static uint32_t file_units;
+
+static uint8_t job_name[] = "sim-job";
+static uint8_t stream_name[] = "sim-stream";
+static Sig256_t signature;
+static uint8_t *rx_bitmap;
+static OTA_FileContext_t file_context =
+{
+    .pucJobName = job_name,
+    .pucStreamName = stream_name,
+    .ulServerFileID = 0U,
+    .pxSignature = &signature
+};
+
+
+/*******************************************************************************
+ * Function Name: link_us
+ *******************************************************************************
+ * Summary:
+ *  Time to download a number of bytes at the data rate of the link.
+ *
+ ******************************************************************************/
+static uint64_t link_us(uint64_t bytes)
+{
+    return (bytes * BITS_PER_BYTE * US_PER_S) / ((uint64_t)down_kbps * 1000U);
+}
+
+
+/*******************************************************************************
+ * Function Name: attempt
+ *******************************************************************************
+ * Summary:
+ *  Downloads the file into the slot, as the agent and the PAL do, until
+ *  stop_blocks are written or the file is complete. The flash keeps its
+ *  content from the previous attempt, as through a reset.
+ *
+ * Parameters:
+ *  resume - record the blocks and resume from the log
+ *  stop_blocks - blocks written before the reset, file_units for none
+ *
+ ******************************************************************************/
+static sim_attempt_t attempt(bool resume, uint32_t stop_blocks)
+{
+    const struct flash_area *fa = sim_flash_area();
+    sim_flash_stats_t stats;
+    sim_attempt_t result;
+    bool handled = false;
+    int rc;
+
+    memset(&result, 0, sizeof(result));
+    memset(rx_bitmap, 0, (file_units + 7U) / 8U);
+    for (uint32_t unit = 0U; unit < file_units; unit++)
+    {
+        rx_bitmap[unit / 8U] |= (uint8_t)(1U << (unit % 8U));
+    }
+    file_context.ulFileSize = file_size;
+    file_context.pucRxBlockBitmap = rx_bitmap;
+    file_context.ulBlocksRemaining = file_units;
+
+    sim_flash_reset_stats();
+
+    /* Opening the file: the PAL erases the whole slot */
+    ota_slot_erase_begin(file_size);
+    if (resume)
+    {
+        ota_resume_begin(&file_context);
+    }
+    rc = ota_slot_erase_intercept(fa, 0U, flash_config.size, &handled);
+    if (resume && (0 == rc))
+    {
+        ota_resume_restore(&file_context);
+    }
+    ota_slot_erase_end();
+
+    sim_flash_get_stats(&stats);
+    result.prepare_us = stats.busy_us;
+    result.kept = file_units - file_context.ulBlocksRemaining;
+
+    for (uint32_t unit = 0U; (0 == rc) && (unit < file_units) && (result.received < stop_blocks);
+         unit++)
+    {
+        uint8_t mask = (uint8_t)(1U << (unit % 8U));
+        uint32_t off = unit * OTA_BLOCK_UNIT_SIZE;
+        uint32_t len = ((file_size - off) < OTA_BLOCK_UNIT_SIZE) ? (file_size - off) :
+                       OTA_BLOCK_UNIT_SIZE;
+
+        if ((rx_bitmap[unit / 8U] & mask) == 0U)
+        {
+            continue;
+        }
+
+        rc = flash_area_write(fa, off, &file[off], len);
+        if (resume)
+        {
+            ota_resume_written(off, len);
+        }
+        rx_bitmap[unit / 8U] &= (uint8_t)~mask;
+        file_context.ulBlocksRemaining--;
+        result.received++;
+        result.bytes += len;
+    }
+
+    if (resume && (0U == file_context.ulBlocksRemaining))
+    {
+        ota_resume_end();
+    }
+
+    sim_flash_get_stats(&stats);
+    result.flash_us = stats.busy_us;
+    result.erases = stats.erases;
+    result.pages = stats.pages;
+    result.clean = (0 == rc) && handled && (0U == stats.dirty);
+
+    return result;
+}
+
+
+/*******************************************************************************
+ * Function Name: run
+ *******************************************************************************
+ * Summary:
+ *  Downloads the file from a slot holding an earlier image and an empty log,
+ *  reset once reset_pct of the blocks are written, then downloads it again.
+ *
+ ******************************************************************************/
+static sim_run_t run(bool resume, uint32_t reset_pct)
+{
+    uint32_t stop = (uint32_t)(((uint64_t)file_units * reset_pct) / PCT);
+    sim_run_t result;
+
+    (void)sim_flash_init(&flash_config);
+    (void)sim_flash_add_area(CY_OTA_RESUME_AREA_ID, 2UL * CY_OTA_RESUME_SECTOR_SIZE);
+
+    result.before = attempt(resume, stop);
+    result.total_us = link_us(result.before.bytes) + result.before.flash_us;
+    result.pass = result.before.clean;
+
+    if (stop < file_units)
+    {
+        result.after = attempt(resume, file_units);
+        result.total_us += link_us(result.after.bytes) + result.after.flash_us;
+        result.pass = result.pass && result.after.clean &&
+                      (0U == file_context.ulBlocksRemaining);
+    }
+    else
+    {
+        memset(&result.after, 0, sizeof(result.after));
+    }
+
+    result.pass = result.pass && (0 == memcmp(sim_flash_data(), file, file_size));
+
+    return result;
+}
+
+
+/*******************************************************************************
+ * Function Name: usage
+ ******************************************************************************/
+static void usage(const char *name)
+{
+    fprintf(stderr,
+        "usage: %s [options]\n"
+        "  --size BYTES               size of the file (default %u)\n"
+        "  --reset-pct PCT            share of the blocks written when the device is\n"
+        "                             reset, repeatable (default 20, 50, 80 and 95)\n"
+        "  --down-kbps KBPS           data rate of the link (default %u)\n"
+        "  --erase-ms MS              erase time of a sector (default %u)\n"
+        "  --verbose                  print the messages of the resume and of the\n"
+        "                             bounded erase\n",
+        name, SIM_DEFAULT_SIZE, SIM_DEFAULT_DOWN_KBPS, SIM_FLASH_ERASE_MS);
+}
+
+
+/*******************************************************************************
+ * Function Name: main
+ ******************************************************************************/
+int main(int argc, char *argv[])
+{
+    uint32_t resets[SIM_MAX_RESETS];
+    uint32_t reset_count = 0U;
+    sim_run_t plain;
+    sim_run_t tracked;
+    bool pass = true;
+    int opt;
+
+    while (-1 != (opt = getopt_long(argc, argv, "", sim_options, NULL)))
+    {
+        switch (opt)
+        {
+            case 's':
+                file_size = (uint32_t)strtoul(optarg, NULL, 0);
+                break;
+            case 'p':
+                if (reset_count >= SIM_MAX_RESETS)
+                {
+                    usage(argv[0]);
+                    return EXIT_USAGE;
+                }
+                resets[reset_count] = (uint32_t)strtoul(optarg, NULL, 0);
+                if ((0U == resets[reset_count]) || (resets[reset_count] >= PCT))
+                {
+                    usage(argv[0]);
+                    return EXIT_USAGE;
+                }
+                reset_count++;
+                break;
+            case 'd':
+                down_kbps = (uint32_t)strtoul(optarg, NULL, 0);
+                break;
+            case 'e':
+                flash_config.erase_ms = (uint32_t)strtoul(optarg, NULL, 0);
+                break;
+            case 'v':
+                verbose = true;
+                break;
+            default:
+                usage(argv[0]);
+                return EXIT_USAGE;
+        }
+    }
+    if ((optind != argc) || (0U == file_size) || (0U == down_kbps) ||
+        (file_size > (flash_config.size - CY_OTA_SLOT_ERASE_TRAILER_SIZE)))
+    {
+        usage(argv[0]);
+        return EXIT_USAGE;
+    }
+    if (0U == reset_count)
+    {
+        memcpy(resets, default_resets, sizeof(default_resets));
+        reset_count = sizeof(default_resets) / sizeof(default_resets[0]);
+    }
+
+    file_units = (file_size + OTA_BLOCK_UNIT_SIZE - 1U) / OTA_BLOCK_UNIT_SIZE;
+    file = malloc(file_size);
+    rx_bitmap = malloc((file_units + 7U) / 8U);
+    if ((NULL == file) || (NULL == rx_bitmap))
+    {
+        return EXIT_FAILURE;
+    }
+
+    for (uint32_t i = 0U; i < file_size; i++)
+    {
+        file[i] = (uint8_t)((i * 2654435761UL) >> 24);
+    }
+    signature.usSize = 64U;
+    memset(signature.ucData, 0x5A, signature.usSize);
+
+    sim_peer_port_init(NULL, 0U, "resume", verbose);
+
+    printf("size=%u\n", (unsigned int)file_size);
+    printf("blocks=%u\n", (unsigned int)file_units);
+    printf("down_kbps=%u\n", (unsigned int)down_kbps);
+    printf("checkpoint_kb=%u\n", (unsigned int)(CY_OTA_RESUME_CHECKPOINT_SIZE / BYTES_PER_KB));
+
+    /* Cost of the checkpoints in a download without a reset */
+    plain = run(false, SIM_NO_RESET_PCT);
+    tracked = run(true, SIM_NO_RESET_PCT);
+    printf("noreset_flash_ms=%llu\n", (unsigned long long)(plain.before.flash_us / US_PER_MS));
+    printf("noreset_resume_flash_ms=%llu\n",
+           (unsigned long long)(tracked.before.flash_us / US_PER_MS));
+    printf("noreset_log_pages=%u\n", (unsigned int)(tracked.before.pages - plain.before.pages));
+    printf("noreset_log_erases=%u\n", (unsigned int)(tracked.before.erases - plain.before.erases));
+    pass = plain.pass && tracked.pass;
+
+    for (uint32_t i = 0U; i < reset_count; i++)
+    {
+        uint32_t pct = resets[i];
+
+        plain = run(false, pct);
+        tracked = run(true, pct);
+
+        printf("reset%u_received=%u\n", (unsigned int)pct, (unsigned int)tracked.before.received);
+        printf("reset%u_kept=%u\n", (unsigned int)pct, (unsigned int)tracked.after.kept);
+        printf("reset%u_restart_kb=%llu\n", (unsigned int)pct,
+               (unsigned long long)((plain.before.bytes + plain.after.bytes) / BYTES_PER_KB));
+        printf("reset%u_resume_kb=%llu\n", (unsigned int)pct,
+               (unsigned long long)((tracked.before.bytes + tracked.after.bytes) / BYTES_PER_KB));
+        printf("reset%u_restart_prepare_ms=%llu\n", (unsigned int)pct,
+               (unsigned long long)(plain.after.prepare_us / US_PER_MS));
+        printf("reset%u_resume_prepare_ms=%llu\n", (unsigned int)pct,
+               (unsigned long long)(tracked.after.prepare_us / US_PER_MS));
+        printf("reset%u_restart_ms=%llu\n", (unsigned int)pct,
+               (unsigned long long)(plain.total_us / US_PER_MS));
+        printf("reset%u_resume_ms=%llu\n", (unsigned int)pct,
+               (unsigned long long)(tracked.total_us / US_PER_MS));
+        printf("reset%u_saved_ms=%lld\n", (unsigned int)pct,
+               ((long long)plain.total_us - (long long)tracked.total_us) / US_PER_MS);
+        printf("reset%u_clean=%s\n", (unsigned int)pct,
+               (plain.pass && tracked.pass) ? "yes" : "no");
+        pass = pass && plain.pass && tracked.pass && (tracked.after.kept > 0U);
+    }
+
+    printf("result=%s\n", pass ? "pass" : "fail");
+
+    free(rx_bitmap);
+    free(file);
+
+    return pass ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+
+/* [] END OF FILE */
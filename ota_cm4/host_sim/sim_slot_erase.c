@@ -0,0 +1,302 @@
+/******************************************************************************
+* File Name: sim_slot_erase.c
+*
+* Description: Host simulation of the bounded erase of the OTA app
+* (sources/ota_slot_erase.c). The secondary slot, in the timed model of the
+* external flash (sim_flash.c), is prepared for a new file as the PAL does
+* when the OTA job is accepted, in three states left by earlier downloads:
+*
+*  - erased: the slot is blank, as after provisioning.
+*  - previous: the slot holds an earlier file of the same size and its
+*    MCUboot trailer, and is blank in between.
+*  - full: every byte of the slot is programmed.
+*
+* Each state is prepared by an erase of the whole slot, then through the
+* bounded erase. The flash time of each, which is the time from the job to
+* the first block, and the sectors erased, already blank and past the file
+* are printed. The file and the trailer are then written, and the simulation
+* fails if a byte is programmed without an erase. The times are counted, not
+* slept, unless --real-time is given: the estimate of the time saved that the
+* bounded erase prints with --verbose needs them.
+*
+* Related Document: See README.md
+*
+*******************************************************************************
+* (c) 2020, Cypress Semiconductor Corporation. All rights reserved.
+*******************************************************************************
+* This software, including source code, documentation and related materials
+* ("Software"), is owned by Cypress Semiconductor Corporation or one of its
+* subsidiaries ("Cypress") and is protected by and subject to worldwide patent
+* protection (United States and foreign), United States copyright laws and
+* international treaty provisions. Therefore, you may use this Software only
+* as provided in the license agreement accompanying the software package from
+* which you obtained this Software ("EULA").
+*
+* If no EULA applies, Cypress hereby grants you a personal, non-exclusive,
+* non-transferable license to copy, modify, and compile the Software source
+* code solely for use in connection with Cypress's integrated circuit products.
+* Any reproduction, modification, translation, compilation, or representation
+* of this Software except as specified above is prohibited without the express
+* written permission of Cypress.
+*
+* Disclaimer: THIS SOFTWARE IS PROVIDED AS-IS, WITH NO WARRANTY OF ANY KIND,
+* EXPRESS OR IMPLIED, INCLUDING, BUT NOT LIMITED TO, NONINFRINGEMENT, IMPLIED
+* WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE. Cypress
+* reserves the right to make changes to the Software without notice. Cypress
+* does not assume any liability arising out of the application or use of the
+* Software or any product or circuit described in the Software. Cypress does
+* not authorize its products for use in any products where a malfunction or
+* failure of the Cypress product may reasonably be expected to result in
+* significant property damage, injury or death ("High Risk Product"). By
+* including Cypress's product in a High Risk Product, the manufacturer of such
+* system or application assumes all risk of such use and in doing so agrees to
+* indemnify Cypress against all liability.
+*******************************************************************************/
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <string.h>
+#include <getopt.h>
+#include "FreeRTOS.h"
+#include "ota_slot_erase.h"
+#include "sim_peer_port.h"
+#include "sim_flash.h"
+
+
+/*******************************************************************************
+ * Macros
+ ******************************************************************************/
+#define SIM_DEFAULT_SIZE                (1024U * 1024U)
+#define SIM_SLOT_SIZE                   (0x1C0000UL)
+#define SIM_TRAILER_WRITE_SIZE          (16U)   /* Magic of a pending image */
+#define SIM_PROGRAMMED_VAL              (0x00U)
+
+#define US_PER_MS                       (1000U)
+
+#define EXIT_USAGE                      (2)
+
+
+/*******************************************************************************
+ * Data structure and enumeration
+ ******************************************************************************/
+typedef enum
+{
+    SIM_STATE_ERASED,
+    SIM_STATE_PREVIOUS,
+    SIM_STATE_FULL,
+    SIM_STATE_COUNT
+} sim_state_t;
+
+/* Preparation of the slot for one state */
+typedef struct
+{
+    uint64_t flash_us;              /* Erases and blank checks */
+    uint32_t erases;
+    uint32_t reads;
+    bool clean;                     /* Nothing programmed without an erase */
+} sim_prepare_t;
+
+
+/*******************************************************************************
+ * Global variables
+ ******************************************************************************/
+static const struct option sim_options[] =
+{
+    { "size",                   required_argument, NULL, 's' },
+    { "erase-ms",               required_argument, NULL, 'e' },
+    { "read-kbps",              required_argument, NULL, 'k' },
+    { "real-time",              no_argument,       NULL, 'r' },
+    { "verbose",                no_argument,       NULL, 'v' },
+    { "help",                   no_argument,       NULL, 'h' },
+    { NULL,                     0,                 NULL, 0 }
+};
+
+static const char * const state_names[SIM_STATE_COUNT] = { "erased", "previous", "full" };
+
+static uint32_t file_size = SIM_DEFAULT_SIZE;
+static sim_flash_config_t flash_config =
+{
+    .size = SIM_SLOT_SIZE,
+    .sector_size = SIM_FLASH_SECTOR_SIZE,
+    .page_size = SIM_FLASH_PAGE_SIZE,
+    .erase_ms = SIM_FLASH_ERASE_MS,
+    .page_us = SIM_FLASH_PAGE_US,
+    .read_kbps = SIM_FLASH_READ_KBPS,
+    .untimed = true
+};
+static bool verbose;
+static uint8_t *file;
+
+
+/*******************************************************************************
+ * Function Name: set_state
+ ******************************************************************************/
+static void set_state(sim_state_t state)
+{
+    (void)sim_flash_init(&flash_config);
+
+    if (SIM_STATE_ERASED == state)
+    {
+        sim_flash_fill(0U, flash_config.size, SIM_FLASH_ERASED_VAL);
+    }
+    else if (SIM_STATE_PREVIOUS == state)
+    {
+        sim_flash_fill(file_size, flash_config.size - file_size - CY_OTA_SLOT_ERASE_TRAILER_SIZE,
+                       SIM_FLASH_ERASED_VAL);
+    }
+    else
+    {
+        /* Programmed to 0x00 by sim_flash_init() */
+    }
+}
+
+
+/*******************************************************************************
+ * Function Name: prepare
+ *******************************************************************************
+ * Summary:
+ *  Prepares the slot in a state, by an erase of the whole slot or through the
+ *  bounded erase, then writes the file and the trailer to it.
+ *
+ ******************************************************************************/
+static sim_prepare_t prepare(sim_state_t state, bool bounded)
+{
+    const struct flash_area *fa = sim_flash_area();
+    uint8_t trailer[SIM_TRAILER_WRITE_SIZE];
+    sim_flash_stats_t stats;
+    sim_prepare_t result;
+    bool handled = false;
+    int rc;
+
+    set_state(state);
+
+    if (bounded)
+    {
+        ota_slot_erase_begin(file_size);
+        rc = ota_slot_erase_intercept(fa, 0U, flash_config.size, &handled);
+        ota_slot_erase_end();
+    }
+    else
+    {
+        rc = flash_area_erase(fa, 0U, flash_config.size);
+    }
+
+    sim_flash_get_stats(&stats);
+    result.flash_us = stats.busy_us;
+    result.erases = stats.erases;
+    result.reads = stats.reads;
+
+    memset(trailer, SIM_PROGRAMMED_VAL, sizeof(trailer));
+    rc |= flash_area_write(fa, 0U, file, file_size);
+    rc |= flash_area_write(fa, flash_config.size - sizeof(trailer), trailer, sizeof(trailer));
+    if (bounded)
+    {
+        ota_slot_erase_report();
+    }
+
+    sim_flash_get_stats(&stats);
+    result.clean = (0 == rc) && (bounded == handled) && (0U == stats.dirty) &&
+                   (0 == memcmp(sim_flash_data(), file, file_size));
+
+    return result;
+}
+
+
+/*******************************************************************************
+ * Function Name: usage
+ ******************************************************************************/
+static void usage(const char *name)
+{
+    fprintf(stderr,
+        "usage: %s [options]\n"
+        "  --size BYTES               size of the file (default %u)\n"
+        "  --erase-ms MS              erase time of a sector (default %u)\n"
+        "  --read-kbps KBPS           data rate of the reads (default %u)\n"
+        "  --real-time                sleep for the flash times, as the statistics of the\n"
+        "                             bounded erase assume\n"
+        "  --verbose                  print the statistics of the bounded erase\n",
+        name, SIM_DEFAULT_SIZE, SIM_FLASH_ERASE_MS, SIM_FLASH_READ_KBPS);
+}
+
+
+/*******************************************************************************
+ * Function Name: main
+ ******************************************************************************/
+int main(int argc, char *argv[])
+{
+    bool pass = true;
+    int opt;
+
+    while (-1 != (opt = getopt_long(argc, argv, "", sim_options, NULL)))
+    {
+        switch (opt)
+        {
+            case 's':
+                file_size = (uint32_t)strtoul(optarg, NULL, 0);
+                break;
+            case 'e':
+                flash_config.erase_ms = (uint32_t)strtoul(optarg, NULL, 0);
+                break;
+            case 'k':
+                flash_config.read_kbps = (uint32_t)strtoul(optarg, NULL, 0);
+                break;
+            case 'r':
+                flash_config.untimed = false;
+                break;
+            case 'v':
+                verbose = true;
+                break;
+            default:
+                usage(argv[0]);
+                return EXIT_USAGE;
+        }
+    }
+    if ((optind != argc) || (0U == file_size) ||
+        (file_size > (flash_config.size - CY_OTA_SLOT_ERASE_TRAILER_SIZE)))
+    {
+        usage(argv[0]);
+        return EXIT_USAGE;
+    }
+
+    file = malloc(file_size);
+    if (NULL == file)
+    {
+        return EXIT_FAILURE;
+    }
+
+    for (uint32_t i = 0U; i < file_size; i++)
+    {
+        file[i] = (uint8_t)((i * 2654435761UL) >> 24);
+    }
+
+    sim_peer_port_init(NULL, 0U, "erase", verbose);
+
+    printf("size=%u\n", (unsigned int)file_size);
+    printf("slot_sectors=%u\n", (unsigned int)(flash_config.size / flash_config.sector_size));
+
+    for (sim_state_t state = SIM_STATE_ERASED; state < SIM_STATE_COUNT; state++)
+    {
+        const char *name = state_names[state];
+        sim_prepare_t whole = prepare(state, false);
+        sim_prepare_t bounded = prepare(state, true);
+
+        printf("%s_whole_ms=%llu\n", name, (unsigned long long)(whole.flash_us / US_PER_MS));
+        printf("%s_whole_erases=%u\n", name, (unsigned int)whole.erases);
+        printf("%s_bounded_ms=%llu\n", name, (unsigned long long)(bounded.flash_us / US_PER_MS));
+        printf("%s_bounded_erases=%u\n", name, (unsigned int)bounded.erases);
+        printf("%s_bounded_reads=%u\n", name, (unsigned int)bounded.reads);
+        printf("%s_saved_ms=%lld\n", name,
+               ((long long)whole.flash_us - (long long)bounded.flash_us) / US_PER_MS);
+        printf("%s_clean=%s\n", name, (whole.clean && bounded.clean) ? "yes" : "no");
+        pass = pass && whole.clean && bounded.clean;
+    }
+
+    printf("result=%s\n", pass ? "pass" : "fail");
+
+    free(file);
+
+    return pass ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+
+/* [] END OF FILE */
@@ -0,0 +1,556 @@
+/******************************************************************************
+* File Name: sim_stream_hash.c
+*
+* Description: Host simulation of the stream hash of the OTA app
+* (sources/ota_stream_hash.c). A file is received in blocks of the agent
+* configuration, in requests of otaconfigMAX_NUM_BLOCKS_REQUEST blocks from
+* the first one missing, with a share of the blocks lost and received in a
+* later request. Each block is written to the secondary slot in the flash
+* model of sim_flash.c, then the file is closed and its signature checked as
+* the PAL does: the slot is read back in the check, and each read is hashed.
+*
+* Each loss rate is run without the stream hash (pal), then with it
+* (stream). The flash reads and the hashing are counted at the rates of the
+* kit, while receiving and while closing the file, and the simulation fails
+* if a signature check does not pass, or if a wrong signature passes.
+*
+* Related Document: See README.md
+*
+*******************************************************************************
+* (c) 2020, Cypress Semiconductor Corporation. All rights reserved.
+*******************************************************************************
+* This software, including source code, documentation and related materials
+* ("Software"), is owned by Cypress Semiconductor Corporation or one of its
+* subsidiaries ("Cypress") and is protected by and subject to worldwide patent
+* protection (United States and foreign), United States copyright laws and
+* international treaty provisions. Therefore, you may use this Software only
+* as provided in the license agreement accompanying the software package from
+* which you obtained this Software ("EULA").
+*
+* If no EULA applies, Cypress hereby grants you a personal, non-exclusive,
+* non-transferable license to copy, modify, and compile the Software source
+* code solely for use in connection with Cypress's integrated circuit products.
+* Any reproduction, modification, translation, compilation, or representation
+* of this Software except as specified above is prohibited without the express
+* written permission of Cypress.
+*
+* Disclaimer: THIS SOFTWARE IS PROVIDED AS-IS, WITH NO WARRANTY OF ANY KIND,
+* EXPRESS OR IMPLIED, INCLUDING, BUT NOT LIMITED TO, NONINFRINGEMENT, IMPLIED
+* WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE. Cypress
+* reserves the right to make changes to the Software without notice. Cypress
+* does not assume any liability arising out of the application or use of the
+* Software or any product or circuit described in the Software. Cypress does
+* not authorize its products for use in any products where a malfunction or
+* failure of the Cypress product may reasonably be expected to result in
+* significant property damage, injury or death ("High Risk Product"). By
+* including Cypress's product in a High Risk Product, the manufacturer of such
+* system or application assumes all risk of such use and in doing so agrees to
+* indemnify Cypress against all liability.
+*******************************************************************************/
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <string.h>
+#include <getopt.h>
+#include "FreeRTOS.h"
+#include "iot_crypto.h"
+#include "mbedtls/sha256.h"
+#include "mbedtls/x509_crt.h"
+#include "aws_ota_agent_config.h"
+#include "ota_stream_hash.h"
+#include "sim_peer_port.h"
+#include "sim_flash.h"
+
+
+/*******************************************************************************
+ * Macros
+ ******************************************************************************/
+#define SIM_DEFAULT_SIZE                (1536U * 1024U)
+#define SIM_DEFAULT_SEED                (1U)
+#define SIM_DEFAULT_HASH_KBPS           (24000U)    /* Software SHA-256, CM4 at 150 MHz */
+#define SIM_SLOT_SIZE                   (0x1C0000UL)
+#define SIM_BLOCK_SIZE                  (1UL << otaconfigLOG2_FILE_BLOCK_SIZE)
+#define SIM_PAL_READ_SIZE               (4096U)     /* Reads of the signature check */
+#define SIM_DIGEST_SIZE                 (32U)
+#define SIM_MAX_LOSS_RATES              (8U)
+
+#define BYTES_PER_S_PER_KBPS            (1000U / 8U)
+#define US_PER_S                        (1000000ULL)
+#define US_PER_MS                       (1000U)
+#define PERCENT                         (100U)
+#define BITS_PER_BYTE                   (8U)
+
+#define EXIT_USAGE                      (2)
+
+
+/*******************************************************************************
+ * Data structure and enumeration
+ ******************************************************************************/
+/* Flash reads and hashing of one phase, counted */
+typedef struct
+{
+    uint64_t bytes_read;
+    uint64_t hash_us;
+} sim_cost_t;
+
+typedef struct
+{
+    sim_cost_t receive;             /* While the blocks are written */
+    sim_cost_t close;               /* Close of the file and signature check */
+    uint32_t requests;
+    bool verified;                  /* The signature check passed */
+} sim_run_t;
+
+/* Verification context of the PAL */
+typedef struct
+{
+    mbedtls_sha256_context sha;
+} sim_check_t;
+
+
+/*******************************************************************************
+ * Function prototypes
+ ******************************************************************************/
+BaseType_t __real_CRYPTO_SignatureVerificationStart(void **ppvContext,
+                                                    BaseType_t xAsymmetricAlgorithm,
+                                                    BaseType_t xHashAlgorithm);
+void __real_CRYPTO_SignatureVerificationUpdate(void *pvContext, const uint8_t *pucData,
+                                               size_t xDataLength);
+BaseType_t __real_CRYPTO_SignatureVerificationFinal(void *pvContext, char *pcSignerCertificate,
+                                                    size_t xSignerCertificateLength,
+                                                    uint8_t *pucSignature,
+                                                    size_t xSignatureLength);
+
+BaseType_t __wrap_CRYPTO_SignatureVerificationStart(void **ppvContext,
+                                                    BaseType_t xAsymmetricAlgorithm,
+                                                    BaseType_t xHashAlgorithm);
+void __wrap_CRYPTO_SignatureVerificationUpdate(void *pvContext, const uint8_t *pucData,
+                                               size_t xDataLength);
+BaseType_t __wrap_CRYPTO_SignatureVerificationFinal(void *pvContext, char *pcSignerCertificate,
+                                                    size_t xSignerCertificateLength,
+                                                    uint8_t *pucSignature,
+                                                    size_t xSignatureLength);
+
+
+/*******************************************************************************
+ * Global variables
+ ******************************************************************************/
+static const struct option sim_options[] =
+{
+    { "size",                   required_argument, NULL, 's' },
+    { "seed",                   required_argument, NULL, 'S' },
+    { "loss-pct",               required_argument, NULL, 'l' },
+    { "hash-kbps",              required_argument, NULL, 'H' },
+    { "read-kbps",              required_argument, NULL, 'k' },
+    { "verbose",                no_argument,       NULL, 'v' },
+    { "help",                   no_argument,       NULL, 'h' },
+    { NULL,                     0,                 NULL, 0 }
+};
+
+static uint32_t image_size = SIM_DEFAULT_SIZE;
+static uint64_t seed = SIM_DEFAULT_SEED;
+static uint32_t hash_kbps = SIM_DEFAULT_HASH_KBPS;
+static uint32_t loss_rates[SIM_MAX_LOSS_RATES] = { 0U, 1U, 5U, 10U };
+static uint32_t loss_rate_count = 4U;
+static bool loss_rates_set;
+static sim_flash_config_t flash_config =
+{
+    .size = SIM_SLOT_SIZE,
+    .sector_size = SIM_FLASH_SECTOR_SIZE,
+    .page_size = SIM_FLASH_PAGE_SIZE,
+    .erase_ms = SIM_FLASH_ERASE_MS,
+    .page_us = SIM_FLASH_PAGE_US,
+    .read_kbps = SIM_FLASH_READ_KBPS,
+    .untimed = true
+};
+static bool verbose;
+static uint8_t *image;
+static uint8_t *missing;                /* Bitmap of the blocks not received */
+static uint8_t digest[SIM_DIGEST_SIZE];
+static char certificate[] = "signer";
+static uint64_t rng_state;
+static sim_check_t check;
+static uint8_t read_buffer[SIM_PAL_READ_SIZE];
+
+
+/*******************************************************************************
+ * Function Name: sim_random
+ ******************************************************************************/
+static uint32_t sim_random(void)
+{
+    rng_state ^= rng_state << 13;
+    rng_state ^= rng_state >> 7;
+    rng_state ^= rng_state << 17;
+
+    return (uint32_t)(rng_state >> 32);
+}
+
+
+/*******************************************************************************
+ * Function Name: __real_CRYPTO_SignatureVerificationStart
+ *******************************************************************************
+ * Summary:
+ *  Stand-in of the verification of the PAL: one context, the SHA-256 of the
+ *  data, checked with the certificate and signature stand-ins.
+ *
+ ******************************************************************************/
+BaseType_t __real_CRYPTO_SignatureVerificationStart(void **ppvContext,
+                                                    BaseType_t xAsymmetricAlgorithm,
+                                                    BaseType_t xHashAlgorithm)
+{
+    (void)xAsymmetricAlgorithm;
+    (void)xHashAlgorithm;
+
+    mbedtls_sha256_init(&check.sha);
+    (void)mbedtls_sha256_starts_ret(&check.sha, 0);
+    *ppvContext = &check;
+
+    return pdTRUE;
+}
+
+
+/*******************************************************************************
+ * Function Name: __real_CRYPTO_SignatureVerificationUpdate
+ ******************************************************************************/
+void __real_CRYPTO_SignatureVerificationUpdate(void *pvContext, const uint8_t *pucData,
+                                               size_t xDataLength)
+{
+    (void)mbedtls_sha256_update_ret(&((sim_check_t *)pvContext)->sha, pucData, xDataLength);
+}
+
+
+/*******************************************************************************
+ * Function Name: __real_CRYPTO_SignatureVerificationFinal
+ ******************************************************************************/
+BaseType_t __real_CRYPTO_SignatureVerificationFinal(void *pvContext, char *pcSignerCertificate,
+                                                    size_t xSignerCertificateLength,
+                                                    uint8_t *pucSignature,
+                                                    size_t xSignatureLength)
+{
+    sim_check_t *ctx = pvContext;
+    uint8_t hash[SIM_DIGEST_SIZE];
+    mbedtls_x509_crt crt;
+    BaseType_t result = pdFALSE;
+
+    (void)mbedtls_sha256_finish_ret(&ctx->sha, hash);
+    mbedtls_sha256_free(&ctx->sha);
+
+    mbedtls_x509_crt_init(&crt);
+    if ((NULL != pcSignerCertificate) && (NULL != pucSignature) &&
+        (0 == mbedtls_x509_crt_parse(&crt, (const unsigned char *)pcSignerCertificate,
+                                     xSignerCertificateLength)) &&
+        (0 == mbedtls_pk_verify(&crt.pk, MBEDTLS_MD_SHA256, hash, sizeof(hash),
+                                pucSignature, xSignatureLength)))
+    {
+        result = pdTRUE;
+    }
+    mbedtls_x509_crt_free(&crt);
+
+    return result;
+}
+
+
+/*******************************************************************************
+ * Function Name: cost_now
+ ******************************************************************************/
+static sim_cost_t cost_now(void)
+{
+    sim_flash_stats_t stats;
+    sim_cost_t cost;
+
+    sim_flash_get_stats(&stats);
+    cost.bytes_read = stats.bytes_read;
+    cost.hash_us = sim_crypto_hash_us();
+
+    return cost;
+}
+
+
+/*******************************************************************************
+ * Function Name: cost_since
+ ******************************************************************************/
+static sim_cost_t cost_since(const sim_cost_t *start)
+{
+    sim_cost_t cost = cost_now();
+
+    cost.bytes_read -= start->bytes_read;
+    cost.hash_us -= start->hash_us;
+
+    return cost;
+}
+
+
+/*******************************************************************************
+ * Function Name: cost_ms
+ *******************************************************************************
+ * Summary:
+ *  Returns the time of the reads and of the hashing of a phase.
+ *
+ ******************************************************************************/
+static uint64_t cost_ms(const sim_cost_t *cost)
+{
+    uint64_t read_us = (cost->bytes_read * US_PER_S) /
+                       ((uint64_t)flash_config.read_kbps * BYTES_PER_S_PER_KBPS);
+
+    return (read_us + cost->hash_us) / US_PER_MS;
+}
+
+
+/*******************************************************************************
+ * Function Name: check_signature
+ *******************************************************************************
+ * Summary:
+ *  Checks the signature of the file as the PAL does when it is closed: the
+ *  slot is read back and hashed, unless the read is skipped as in
+ *  ota_flash_wrap.c.
+ *
+ ******************************************************************************/
+static bool check_signature(uint8_t *signature)
+{
+    const struct flash_area *fa = sim_flash_area();
+    void *ctx = NULL;
+
+    if (pdTRUE != __wrap_CRYPTO_SignatureVerificationStart(&ctx, cryptoASYMMETRIC_ALGORITHM_ECDSA,
+                                                           cryptoHASH_ALGORITHM_SHA256))
+    {
+        return false;
+    }
+
+    for (uint32_t off = 0U; off < image_size; off += SIM_PAL_READ_SIZE)
+    {
+        uint32_t len = ((image_size - off) > SIM_PAL_READ_SIZE) ? SIM_PAL_READ_SIZE :
+                                                                 (image_size - off);
+
+        if (!ota_stream_hash_skips_read(fa))
+        {
+            (void)flash_area_read(fa, off, read_buffer, len);
+        }
+        __wrap_CRYPTO_SignatureVerificationUpdate(ctx, read_buffer, len);
+    }
+
+    return pdTRUE == __wrap_CRYPTO_SignatureVerificationFinal(ctx, certificate,
+                                                              sizeof(certificate), signature,
+                                                              SIM_DIGEST_SIZE);
+}
+
+
+/*******************************************************************************
+ * Function Name: run
+ *******************************************************************************
+ * Summary:
+ *  Receives the file with a loss rate, writing each block to the slot, then
+ *  closes it and checks its signature, with the stream hash or not. Every
+ *  run draws the same losses.
+ *
+ ******************************************************************************/
+static sim_run_t run(uint32_t loss_pct, bool stream, uint8_t *signature)
+{
+    const struct flash_area *fa = sim_flash_area();
+    uint32_t blocks = (image_size + SIM_BLOCK_SIZE - 1U) / SIM_BLOCK_SIZE;
+    uint32_t remaining = blocks;
+    sim_run_t result = { 0 };
+    sim_cost_t start;
+
+    (void)sim_flash_init(&flash_config);
+    (void)flash_area_erase(fa, 0U, flash_config.size);
+    sim_flash_reset_stats();
+    sim_crypto_hash_rate(hash_kbps);
+    rng_state = ((seed + loss_pct) * 2654435761ULL) | 1U;
+    memset(missing, 0xFF, (blocks + BITS_PER_BYTE - 1U) / BITS_PER_BYTE);
+
+    start = cost_now();
+    if (stream)
+    {
+        ota_stream_hash_begin();
+    }
+
+    while (remaining > 0U)
+    {
+        uint32_t block = 0U;
+
+        while ((missing[block / BITS_PER_BYTE] & (1U << (block % BITS_PER_BYTE))) == 0U)
+        {
+            block++;
+        }
+
+        result.requests++;
+        for (uint32_t n = 0U; (n < otaconfigMAX_NUM_BLOCKS_REQUEST) && (block < blocks); block++)
+        {
+            uint32_t off = block * SIM_BLOCK_SIZE;
+            uint32_t len = ((image_size - off) > SIM_BLOCK_SIZE) ? SIM_BLOCK_SIZE :
+                                                                  (image_size - off);
+
+            if ((missing[block / BITS_PER_BYTE] & (1U << (block % BITS_PER_BYTE))) == 0U)
+            {
+                continue;
+            }
+
+            n++;
+            if ((sim_random() % PERCENT) < loss_pct)
+            {
+                continue;
+            }
+
+            missing[block / BITS_PER_BYTE] &= (uint8_t)~(1U << (block % BITS_PER_BYTE));
+            remaining--;
+            (void)flash_area_write(fa, off, &image[off], len);
+            if (stream)
+            {
+                ota_stream_hash_update(off, &image[off], len);
+            }
+        }
+    }
+    result.receive = cost_since(&start);
+
+    start = cost_now();
+    if (stream)
+    {
+        ota_stream_hash_arm(image_size);
+    }
+    result.verified = check_signature(signature);
+    if (stream)
+    {
+        ota_stream_hash_disarm();
+    }
+    result.close = cost_since(&start);
+
+    return result;
+}
+
+
+/*******************************************************************************
+ * Function Name: usage
+ ******************************************************************************/
+static void usage(const char *name)
+{
+    fprintf(stderr,
+        "usage: %s [options]\n"
+        "  --size BYTES               size of the file (default %u)\n"
+        "  --seed N                   seed of the file and of the losses (default %u)\n"
+        "  --loss-pct PCT             share of the blocks lost, repeated for several runs\n"
+        "                             (default 0, 1, 5 and 10)\n"
+        "  --hash-kbps KBPS           SHA-256 rate of the kit (default %u)\n"
+        "  --read-kbps KBPS           data rate of the flash reads (default %u)\n"
+        "  --verbose                  print the statistics of the stream hash\n",
+        name, SIM_DEFAULT_SIZE, SIM_DEFAULT_SEED, SIM_DEFAULT_HASH_KBPS, SIM_FLASH_READ_KBPS);
+}
+
+
+/*******************************************************************************
+ * Function Name: main
+ ******************************************************************************/
+int main(int argc, char *argv[])
+{
+    uint8_t wrong[SIM_DIGEST_SIZE];
+    bool pass = true;
+    int opt;
+
+    while (-1 != (opt = getopt_long(argc, argv, "", sim_options, NULL)))
+    {
+        switch (opt)
+        {
+            case 's':
+                image_size = (uint32_t)strtoul(optarg, NULL, 0);
+                break;
+            case 'S':
+                seed = strtoull(optarg, NULL, 0);
+                break;
+            case 'l':
+                if (!loss_rates_set)
+                {
+                    loss_rates_set = true;
+                    loss_rate_count = 0U;
+                }
+                if (SIM_MAX_LOSS_RATES == loss_rate_count)
+                {
+                    usage(argv[0]);
+                    return EXIT_USAGE;
+                }
+                loss_rates[loss_rate_count++] = (uint32_t)strtoul(optarg, NULL, 0);
+                break;
+            case 'H':
+                hash_kbps = (uint32_t)strtoul(optarg, NULL, 0);
+                break;
+            case 'k':
+                flash_config.read_kbps = (uint32_t)strtoul(optarg, NULL, 0);
+                break;
+            case 'v':
+                verbose = true;
+                break;
+            default:
+                usage(argv[0]);
+                return EXIT_USAGE;
+        }
+    }
+    if ((optind != argc) || (0U == image_size) || (image_size > flash_config.size) ||
+        (0U == flash_config.read_kbps))
+    {
+        usage(argv[0]);
+        return EXIT_USAGE;
+    }
+    for (uint32_t i = 0U; i < loss_rate_count; i++)
+    {
+        if (loss_rates[i] >= PERCENT)
+        {
+            usage(argv[0]);
+            return EXIT_USAGE;
+        }
+    }
+
+    image = malloc(image_size);
+    missing = malloc((image_size / SIM_BLOCK_SIZE / BITS_PER_BYTE) + 1U);
+    if ((NULL == image) || (NULL == missing))
+    {
+        return EXIT_FAILURE;
+    }
+
+    rng_state = (seed * 2654435761ULL) | 1U;
+    for (uint32_t i = 0U; i < image_size; i++)
+    {
+        image[i] = (uint8_t)sim_random();
+    }
+
+    /* The signature of the stand-ins is the hash */
+    (void)mbedtls_sha256_ret(image, image_size, digest, 0);
+    memcpy(wrong, digest, sizeof(wrong));
+    wrong[0] ^= 1U;
+
+    sim_peer_port_init(NULL, 0U, "hash", verbose);
+
+    printf("size=%u\n", (unsigned int)image_size);
+    printf("block_size=%u\n", (unsigned int)SIM_BLOCK_SIZE);
+    printf("hash_kbps=%u\n", (unsigned int)hash_kbps);
+
+    for (uint32_t i = 0U; i < loss_rate_count; i++)
+    {
+        uint32_t loss = loss_rates[i];
+        sim_run_t pal = run(loss, false, digest);
+        sim_run_t stream = run(loss, true, digest);
+        sim_run_t forged = run(loss, true, wrong);
+
+        printf("loss%u_requests=%u\n", (unsigned int)loss, (unsigned int)pal.requests);
+        printf("loss%u_pal_close_ms=%llu\n", (unsigned int)loss,
+               (unsigned long long)cost_ms(&pal.close));
+        printf("loss%u_stream_close_ms=%llu\n", (unsigned int)loss,
+               (unsigned long long)cost_ms(&stream.close));
+        printf("loss%u_stream_receive_ms=%llu\n", (unsigned int)loss,
+               (unsigned long long)cost_ms(&stream.receive));
+        printf("loss%u_stream_read_back=%llu\n", (unsigned int)loss,
+               (unsigned long long)stream.receive.bytes_read);
+        printf("loss%u_stream_used=%s\n", (unsigned int)loss,
+               (0U == stream.close.bytes_read) ? "yes" : "no");
+        printf("loss%u_verified=%s\n", (unsigned int)loss,
+               (pal.verified && stream.verified && !forged.verified) ? "yes" : "no");
+        pass = pass && pal.verified && stream.verified && !forged.verified;
+    }
+
+    printf("result=%s\n", pass ? "pass" : "fail");
+
+    free(missing);
+    free(image);
+
+    return pass ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+
+/* [] END OF FILE */
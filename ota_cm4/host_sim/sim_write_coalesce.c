@@ -0,0 +1,451 @@
+/******************************************************************************
+* File Name: sim_write_coalesce.c
+*
+* Description: Host simulation of the coalescing of the block writes of the
+* OTA app (sources/ota_write_coalesce.c). A file is written to the secondary
+* slot, in the timed model of the external flash (sim_flash.c), in the
+* pieces two downloads produce:
+*
+*  - blocks: the blocks of the MQTT stream, in file order.
+*  - http: the bodies of the ranged GETs of the HTTP download, received by
+*    several connections in turn. Each body starts after the response header
+*    in the buffer of its connection, and each receive ends at the buffer
+*    size or at the end of a TLS record. The last unit of each range is
+*    written as a whole block afterwards, as the agent does.
+*
+* Each is written as it comes and through the coalescing. The pages
+* programmed and the flash time of each are printed. The simulation fails if
+* the slot does not hold the file at the end, or if a byte is programmed
+* without an erase. The times are counted, not slept.
+*
+* Related Document: See README.md
+*
+*******************************************************************************
+* (c) 2020, Cypress Semiconductor Corporation. All rights reserved.
+*******************************************************************************
+* This software, including source code, documentation and related materials
+* ("Software"), is owned by Cypress Semiconductor Corporation or one of its
+* subsidiaries ("Cypress") and is protected by and subject to worldwide patent
+* protection (United States and foreign), United States copyright laws and
+* international treaty provisions. Therefore, you may use this Software only
+* as provided in the license agreement accompanying the software package from
+* which you obtained this Software ("EULA").
+*
+* If no EULA applies, Cypress hereby grants you a personal, non-exclusive,
+* non-transferable license to copy, modify, and compile the Software source
+* code solely for use in connection with Cypress's integrated circuit products.
+* Any reproduction, modification, translation, compilation, or representation
+* of this Software except as specified above is prohibited without the express
+* written permission of Cypress.
+*
+* Disclaimer: THIS SOFTWARE IS PROVIDED AS-IS, WITH NO WARRANTY OF ANY KIND,
+* EXPRESS OR IMPLIED, INCLUDING, BUT NOT LIMITED TO, NONINFRINGEMENT, IMPLIED
+* WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE. Cypress
+* reserves the right to make changes to the Software without notice. Cypress
+* does not assume any liability arising out of the application or use of the
+* Software or any product or circuit described in the Software. Cypress does
+* not authorize its products for use in any products where a malfunction or
+* failure of the Cypress product may reasonably be expected to result in
+* significant property damage, injury or death ("High Risk Product"). By
+* including Cypress's product in a High Risk Product, the manufacturer of such
+* system or application assumes all risk of such use and in doing so agrees to
+* indemnify Cypress against all liability.
+*******************************************************************************/
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <string.h>
+#include <getopt.h>
+#include "FreeRTOS.h"
+#include "ota_block_size.h"
+#include "ota_http_stream.h"
+#include "ota_write_coalesce.h"
+#include "sim_peer_port.h"
+#include "sim_flash.h"
+
+
+/*******************************************************************************
+ * Macros
+ ******************************************************************************/
+#define SIM_DEFAULT_SIZE                (1536U * 1024U)
+#define SIM_DEFAULT_RECORD_SIZE         (16384U)        /* Largest TLS record */
+#define SIM_DEFAULT_SEED                (1U)
+#define SIM_SLOT_SIZE                   (0x1C0000UL)
+#define SIM_HEADER_MIN                  (280U)          /* Response header of a ranged GET */
+#define SIM_HEADER_SPREAD               (160U)
+
+#define US_PER_MS                       (1000U)
+
+#define EXIT_USAGE                      (2)
+
+
+/*******************************************************************************
+ * Data structure and enumeration
+ ******************************************************************************/
+typedef enum
+{
+    SIM_PIECES_BLOCKS,
+    SIM_PIECES_HTTP,
+    SIM_PIECES_COUNT
+} sim_pieces_t;
+
+/* Connection of the HTTP download */
+typedef struct
+{
+    bool active;
+    uint32_t start;                 /* Range of the file */
+    uint32_t end;
+    uint32_t received;              /* Body bytes received */
+    uint32_t header;                /* Response header ahead of the body */
+} sim_conn_t;
+
+/* One write of the file */
+typedef struct
+{
+    uint32_t writes;
+    uint32_t pages;
+    uint64_t flash_us;
+    bool clean;                     /* File in the slot, nothing programmed without an erase */
+} sim_write_t;
+
+
+/*******************************************************************************
+ * Global variables
+ ******************************************************************************/
+static const struct option sim_options[] =
+{
+    { "size",                   required_argument, NULL, 's' },
+    { "connections",            required_argument, NULL, 'c' },
+    { "recv-size",              required_argument, NULL, 'r' },
+    { "record-size",            required_argument, NULL, 't' },
+    { "page-us",                required_argument, NULL, 'p' },
+    { "seed",                   required_argument, NULL, 'S' },
+    { "verbose",                no_argument,       NULL, 'v' },
+    { "help",                   no_argument,       NULL, 'h' },
+    { NULL,                     0,                 NULL, 0 }
+};
+
+static const char * const pieces_names[SIM_PIECES_COUNT] = { "blocks", "http" };
+
+static uint32_t file_size = SIM_DEFAULT_SIZE;
+static uint32_t connections = CY_OTA_HTTP_CONNECTIONS;
+static uint32_t recv_size = OTA_HTTP_BUFFER_SIZE;
+static uint32_t record_size = SIM_DEFAULT_RECORD_SIZE;
+static uint32_t seed = SIM_DEFAULT_SEED;
+static uint32_t rng_state;
+static sim_flash_config_t flash_config =
+{
+    .size = SIM_SLOT_SIZE,
+    .sector_size = SIM_FLASH_SECTOR_SIZE,
+    .page_size = SIM_FLASH_PAGE_SIZE,
+    .erase_ms = SIM_FLASH_ERASE_MS,
+    .page_us = SIM_FLASH_PAGE_US,
+    .read_kbps = SIM_FLASH_READ_KBPS,
+    .untimed = true
+};
+static bool verbose;
+static uint8_t *file;
+
+
+/*******************************************************************************
+ * Function Name: rng_next
+ ******************************************************************************/
+static uint32_t rng_next(void)
+{
+    rng_state = (rng_state * 1103515245UL) + 12345UL;
+
+    return rng_state >> 8;
+}
+
+
+/*******************************************************************************
+ * Function Name: write_piece
+ *******************************************************************************
+ * Summary:
+ *  Writes a piece of the file to the slot, as it is or through the
+ *  coalescing, as the flash wrapper of the OTA app does.
+ *
+ ******************************************************************************/
+static int write_piece(uint32_t off, uint32_t len, bool coalesce, sim_write_t *result)
+{
+    const struct flash_area *fa = sim_flash_area();
+    bool handled = false;
+    int rc = 0;
+
+    result->writes++;
+
+    if (coalesce)
+    {
+        rc = ota_write_coalesce_intercept(fa, off, &file[off], len, &handled);
+    }
+
+    return handled ? rc : flash_area_write(fa, off, &file[off], len);
+}
+
+
+/*******************************************************************************
+ * Function Name: next_range
+ ******************************************************************************/
+static void next_range(sim_conn_t *conn, uint32_t *next_off)
+{
+    conn->active = (*next_off < file_size);
+    if (!conn->active)
+    {
+        return;
+    }
+
+    conn->start = *next_off;
+    conn->end = ((file_size - conn->start) < CY_OTA_HTTP_RANGE_SIZE) ? file_size :
+                (conn->start + CY_OTA_HTTP_RANGE_SIZE);
+    conn->received = 0U;
+    conn->header = SIM_HEADER_MIN + (rng_next() % SIM_HEADER_SPREAD);
+    *next_off = conn->end;
+}
+
+
+/*******************************************************************************
+ * Function Name: write_http
+ *******************************************************************************
+ * Summary:
+ *  Writes the file in the pieces of the HTTP download. The connections
+ *  receive in turn, one buffer each, and write the body up to the last unit
+ *  of their range, which is written once the range is complete.
+ *
+ ******************************************************************************/
+static int write_http(bool coalesce, sim_write_t *result)
+{
+    sim_conn_t conns[CY_OTA_HTTP_CONNECTIONS];
+    uint32_t next_off = 0U;
+    bool active = true;
+    int rc = 0;
+
+    rng_state = seed;
+    for (uint32_t i = 0U; i < connections; i++)
+    {
+        next_range(&conns[i], &next_off);
+    }
+
+    while ((0 == rc) && active)
+    {
+        active = false;
+
+        for (uint32_t i = 0U; (0 == rc) && (i < connections); i++)
+        {
+            sim_conn_t *conn = &conns[i];
+            uint32_t body_len;
+            uint32_t held_off;
+            uint32_t pos;
+            uint32_t len;
+
+            if (!conn->active)
+            {
+                continue;
+            }
+
+            active = true;
+            body_len = conn->end - conn->start;
+            held_off = ((body_len - 1U) / OTA_BLOCK_UNIT_SIZE) * OTA_BLOCK_UNIT_SIZE;
+
+            /* One receive: the buffer, up to the end of the TLS record */
+            pos = conn->header + conn->received;
+            len = (0U == conn->received) ? (recv_size - conn->header) : recv_size;
+            if (len > (record_size - (pos % record_size)))
+            {
+                len = record_size - (pos % record_size);
+            }
+            if (len > (body_len - conn->received))
+            {
+                len = body_len - conn->received;
+            }
+
+            if (conn->received < held_off)
+            {
+                uint32_t write_len = ((conn->received + len) > held_off) ?
+                                     (held_off - conn->received) : len;
+
+                rc = write_piece(conn->start + conn->received, write_len, coalesce, result);
+            }
+            conn->received += len;
+
+            if (conn->received == body_len)
+            {
+                if (0 == rc)
+                {
+                    rc = write_piece(conn->start + held_off, body_len - held_off, coalesce, result);
+                }
+                next_range(conn, &next_off);
+            }
+        }
+    }
+
+    return rc;
+}
+
+
+/*******************************************************************************
+ * Function Name: write_file
+ *******************************************************************************
+ * Summary:
+ *  Erases the sectors of the file, then writes it in the pieces of a
+ *  download, as they come or through the coalescing. Only the writes are
+ *  counted.
+ *
+ ******************************************************************************/
+static sim_write_t write_file(sim_pieces_t pieces, bool coalesce)
+{
+    const struct flash_area *fa = sim_flash_area();
+    uint32_t erase_len = ((file_size + flash_config.sector_size - 1U) / flash_config.sector_size) *
+                         flash_config.sector_size;
+    sim_flash_stats_t stats;
+    sim_write_t result;
+    int rc;
+
+    memset(&result, 0, sizeof(result));
+    (void)sim_flash_init(&flash_config);
+    rc = flash_area_erase(fa, 0U, erase_len);
+    sim_flash_reset_stats();
+
+    if (coalesce)
+    {
+        ota_write_coalesce_begin();
+    }
+
+    if (SIM_PIECES_BLOCKS == pieces)
+    {
+        for (uint32_t off = 0U; (0 == rc) && (off < file_size); off += OTA_BLOCK_UNIT_SIZE)
+        {
+            uint32_t len = ((file_size - off) < OTA_BLOCK_UNIT_SIZE) ? (file_size - off) :
+                           OTA_BLOCK_UNIT_SIZE;
+
+            rc = write_piece(off, len, coalesce, &result);
+        }
+    }
+    else if (0 == rc)
+    {
+        rc = write_http(coalesce, &result);
+    }
+
+    if (coalesce && (0 != ota_write_coalesce_end()))
+    {
+        rc = -1;
+    }
+
+    sim_flash_get_stats(&stats);
+    result.pages = stats.pages;
+    result.flash_us = stats.busy_us;
+    result.clean = (0 == rc) && (0U == stats.dirty) &&
+                   (0 == memcmp(sim_flash_data(), file, file_size));
+
+    return result;
+}
+
+
+/*******************************************************************************
+ * Function Name: usage
+ ******************************************************************************/
+static void usage(const char *name)
+{
+    fprintf(stderr,
+        "usage: %s [options]\n"
+        "  --size BYTES               size of the file (default %u)\n"
+        "  --connections N            HTTP connections, 1 to %u (default %u)\n"
+        "  --recv-size BYTES          largest receive of a connection (default %u)\n"
+        "  --record-size BYTES        payload of a TLS record (default %u)\n"
+        "  --page-us US               program time of a page (default %u)\n"
+        "  --seed N                   seed of the response header sizes (default %u)\n"
+        "  --verbose                  print the statistics of the coalescing\n",
+        name, SIM_DEFAULT_SIZE, CY_OTA_HTTP_CONNECTIONS, CY_OTA_HTTP_CONNECTIONS,
+        OTA_HTTP_BUFFER_SIZE, SIM_DEFAULT_RECORD_SIZE, SIM_FLASH_PAGE_US, SIM_DEFAULT_SEED);
+}
+
+
+/*******************************************************************************
+ * Function Name: main
+ ******************************************************************************/
+int main(int argc, char *argv[])
+{
+    bool pass = true;
+    int opt;
+
+    while (-1 != (opt = getopt_long(argc, argv, "", sim_options, NULL)))
+    {
+        switch (opt)
+        {
+            case 's':
+                file_size = (uint32_t)strtoul(optarg, NULL, 0);
+                break;
+            case 'c':
+                connections = (uint32_t)strtoul(optarg, NULL, 0);
+                break;
+            case 'r':
+                recv_size = (uint32_t)strtoul(optarg, NULL, 0);
+                break;
+            case 't':
+                record_size = (uint32_t)strtoul(optarg, NULL, 0);
+                break;
+            case 'p':
+                flash_config.page_us = (uint32_t)strtoul(optarg, NULL, 0);
+                break;
+            case 'S':
+                seed = (uint32_t)strtoul(optarg, NULL, 0);
+                break;
+            case 'v':
+                verbose = true;
+                break;
+            default:
+                usage(argv[0]);
+                return EXIT_USAGE;
+        }
+    }
+    if ((optind != argc) || (0U == file_size) || (file_size > flash_config.size) ||
+        (0U == connections) || (connections > CY_OTA_HTTP_CONNECTIONS) ||
+        (recv_size <= (SIM_HEADER_MIN + SIM_HEADER_SPREAD)) ||
+        (record_size <= (SIM_HEADER_MIN + SIM_HEADER_SPREAD)))
+    {
+        usage(argv[0]);
+        return EXIT_USAGE;
+    }
+
+    file = malloc(file_size);
+    if (NULL == file)
+    {
+        return EXIT_FAILURE;
+    }
+
+    for (uint32_t i = 0U; i < file_size; i++)
+    {
+        file[i] = (uint8_t)((i * 2654435761UL) >> 24);
+    }
+
+    sim_peer_port_init(NULL, 0U, "coalesce", verbose);
+
+    printf("size=%u\n", (unsigned int)file_size);
+    printf("page_size=%u\n", (unsigned int)flash_config.page_size);
+
+    for (sim_pieces_t pieces = SIM_PIECES_BLOCKS; pieces < SIM_PIECES_COUNT; pieces++)
+    {
+        const char *name = pieces_names[pieces];
+        sim_write_t direct = write_file(pieces, false);
+        sim_write_t coalesced = write_file(pieces, true);
+
+        printf("%s_writes=%u\n", name, (unsigned int)direct.writes);
+        printf("%s_direct_pages=%u\n", name, (unsigned int)direct.pages);
+        printf("%s_coalesced_pages=%u\n", name, (unsigned int)coalesced.pages);
+        printf("%s_direct_ms=%llu\n", name, (unsigned long long)(direct.flash_us / US_PER_MS));
+        printf("%s_coalesced_ms=%llu\n", name,
+               (unsigned long long)(coalesced.flash_us / US_PER_MS));
+        printf("%s_saved_ms=%lld\n", name,
+               ((long long)direct.flash_us - (long long)coalesced.flash_us) / US_PER_MS);
+        printf("%s_clean=%s\n", name, (direct.clean && coalesced.clean) ? "yes" : "no");
+        pass = pass && direct.clean && coalesced.clean;
+    }
+
+    printf("result=%s\n", pass ? "pass" : "fail");
+
+    free(file);
+
+    return pass ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+
+/* [] END OF FILE */
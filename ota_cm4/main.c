@@ -59,6 +59,10 @@
 
 #include "led_task.h"
 
+#ifdef CY_BOOT_USE_SLOT_RING
+#include "slot_ring.h"
+#endif
+
 
 /*******************************************************************************
 * Macros
@@ -204,6 +208,15 @@ void vApplicationDaemonTaskStartupHook( void )
     }
 #endif /* CY_BOOT_USE_EXTERNAL_FLASH */
 
+#ifdef CY_BOOT_USE_SLOT_RING
+    /* Point the secondary slot at the ring slot for the next download. */
+    slot_ring_load();
+    if (slot_ring_select_rx() != 0)
+    {
+        configPRINTF(("slot_ring_select_rx() FAILED!!\r\n"));
+    }
+#endif /* CY_BOOT_USE_SLOT_RING */
+
     if( SYSTEM_Init() == pdPASS )
     {
 #ifdef CY_USE_LWIP
@@ -184,9 +184,115 @@ SOURCES+=\
 SOURCES+=\
 	../bootloader_cm0p/ext_flash_map.c
 
+# Flash map backend interposition shared with the bootloader. The wrapped
+# functions are defined by sources/ota_flash_wrap.c on top of it.
+SOURCES+=\
+	../bootloader_cm0p/flash_area_wrap.c\
+	../bootloader_cm0p/trailer_log.c\
+	../bootloader_cm0p/slot_ring.c
+
+DEFINES+=CY_OTA_FLASH_WRAP
+LDFLAGS+=$(FLASH_AREA_WRAP_LDFLAGS)
+
+# OTA PAL functions interposed by sources/ota_pal_wrap.c
+OTA_PAL_WRAP=
+ifneq ($(filter CY_BOOT_USE_SLOT_RING,$(DEFINES)),)
+OTA_PAL_WRAP+=CloseFile SetPlatformImageState
+endif
+
+# Block stream features of sources/ota_block_size.c
+ifneq ($(filter CY_OTA_ADAPTIVE_BLOCK_SIZE CY_OTA_BLOCK_WINDOW CY_OTA_ZERO_COPY,$(DEFINES)),)
+OTA_PAL_WRAP+=CreateFileForRx Abort CloseFile
+LDFLAGS+=-Wl,--wrap=OTA_CBOR_Encode_GetStreamRequestMessage,--wrap=OTA_CBOR_Decode_GetStreamResponseMessage
+
+# Block payloads freed by the agent
+ifneq ($(filter CY_OTA_ZERO_COPY CY_OTA_BLOCK_BENCHMARK,$(DEFINES)),)
+LDFLAGS+=-Wl,--wrap=vPortFree
+endif
+endif
+
+# Block writes of the parallel HTTP connections
+ifneq ($(filter CY_OTA_HTTP_STREAM,$(DEFINES)),)
+OTA_PAL_WRAP+=CreateFileForRx WriteBlock
+endif
+
+# Block writes and slot erase of sources/ota_flash_writer.c
+ifneq ($(filter CY_OTA_FLASH_WRITER,$(DEFINES)),)
+OTA_PAL_WRAP+=CreateFileForRx WriteBlock Abort CloseFile
+endif
+
+# Secondary slot erase of sources/ota_slot_erase.c
+ifneq ($(filter CY_OTA_BOUNDED_ERASE,$(DEFINES)),)
+OTA_PAL_WRAP+=CreateFileForRx WriteBlock CloseFile
+endif
+
+# Image hash of sources/ota_stream_hash.c
+ifneq ($(filter CY_OTA_STREAM_HASH,$(DEFINES)),)
+OTA_PAL_WRAP+=CreateFileForRx WriteBlock CloseFile
+LDFLAGS+=-Wl,--wrap=CRYPTO_SignatureVerificationStart,--wrap=CRYPTO_SignatureVerificationUpdate,--wrap=CRYPTO_SignatureVerificationFinal
+endif
+
+# Received block checkpoints of sources/ota_resume.c
+ifneq ($(filter CY_OTA_RESUME,$(DEFINES)),)
+OTA_PAL_WRAP+=CreateFileForRx WriteBlock Abort CloseFile
+endif
+
+# Program unit coalescing of sources/ota_write_coalesce.c
+ifneq ($(filter CY_OTA_WRITE_COALESCE,$(DEFINES)),)
+OTA_PAL_WRAP+=CreateFileForRx Abort CloseFile
+endif
+
+# Transfer metrics of sources/ota_metrics.c, published before a job status update
+ifneq ($(filter CY_OTA_METRICS,$(DEFINES)),)
+OTA_PAL_WRAP+=CreateFileForRx WriteBlock Abort CloseFile
+LDFLAGS+=-Wl,--wrap=_AwsIotOTA_UpdateJobStatus_Mqtt
+endif
+
+# Application publishes timed by sources/ota_mqtt_coexist.c
+ifneq ($(filter CY_OTA_MQTT_COEXIST,$(DEFINES)),)
+LDFLAGS+=-Wl,--wrap=IotMqtt_PublishSync,--wrap=IotMqtt_PublishAsync
+endif
+
+# Member routing of sources/ota_tar_stream.c
+ifneq ($(filter CY_OTA_TAR_STREAM,$(DEFINES)),)
+OTA_PAL_WRAP+=CreateFileForRx WriteBlock Abort CloseFile
+endif
+
+# Image served to the peers on the LAN by sources/ota_peer.c
+ifneq ($(filter CY_OTA_PEER,$(DEFINES)),)
+OTA_PAL_WRAP+=CreateFileForRx CloseFile ActivateNewImage
+endif
+
+# Multicast transfers of sources/ota_multicast.c
+ifneq ($(filter CY_OTA_MULTICAST,$(DEFINES)),)
+OTA_PAL_WRAP+=CreateFileForRx WriteBlock Abort CloseFile ActivateNewImage
+endif
+
+# Files staged in SRAM by sources/ota_ram_stage.c
+ifneq ($(filter CY_OTA_RAM_STAGE,$(DEFINES)),)
+OTA_PAL_WRAP+=CreateFileForRx Abort CloseFile
+endif
+
+LDFLAGS+=$(foreach f,$(sort $(OTA_PAL_WRAP)),-Wl,--wrap=prvPAL_$(f))
+
+# HTTP data interface of the agent interposed by sources/ota_http_stream.c
+ifneq ($(filter CY_OTA_HTTP_STREAM,$(DEFINES)),)
+LDFLAGS+=-Wl,--wrap=_AwsIotOTA_InitFileTransfer_HTTP,--wrap=_AwsIotOTA_RequestDataBlock_HTTP,--wrap=_AwsIotOTA_DecodeFileBlock_HTTP,--wrap=_AwsIotOTA_Cleanup_HTTP
+endif
+
 SOURCES+=\
 	$(CY_AFR_BOARD_PATH)/ports/ota/aws_ota_pal.c
 
+# OTA signature check with comb tables generated for the code signer key
+ifeq ($(USE_ECDSA_COMB),1)
+DEFINES+=CY_ECDSA_COMB
+SOURCES+=\
+	../bootloader_cm0p/ecdsa_comb.c
+INCLUDES+=$(ECDSA_COMB_GEN_DIR)
+LDFLAGS+=$(ECDSA_COMB_LDFLAGS)
+PREBUILD+=$(ECDSA_COMB_GEN) ./include/aws_ota_codesigner_certificate.h $(ECDSA_COMB_GEN_DIR)/ecdsa_comb_tables.h;
+endif
+
 ifeq ($(OTA_USE_EXTERNAL_FLASH),1)
 SOURCES+=\
 	$(CY_AFR_MCUBOOT_CYFLASH_PAL_DIR)/cy_smif_psoc6.c\
@@ -194,6 +300,7 @@ SOURCES+=\
 endif
 
 INCLUDES+=\
+    ../bootloader_cm0p\
     $(CY_AFR_MCUBOOT_DIR)\
     $(CY_AFR_MCUBOOT_DIR)/config\
     $(CY_AFR_MCUBOOT_DIR)/mcuboot_header\
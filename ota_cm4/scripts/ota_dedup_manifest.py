@@ -0,0 +1,116 @@
+# (c) 2020, Cypress Semiconductor Corporation. All rights reserved.
+# Licensed under the Apache License, Version 2.0 (the "License").
+# You may not use this file except in compliance with the License.
+# A copy of the License is located at
+#     http://www.apache.org/licenses/LICENSE-2.0
+# or in the "license" file accompanying this file. This file is distributed
+# on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+# express or implied. See the License for the specific language governing
+# permissions and limitations under the License.
+#
+# Appends the chunk manifest used by OTA_DEDUP to a signed MCUboot image.
+# The chunking must match sources/ota_dedup.c: change both together.
+# Important Note: Requires Python 3
+
+import argparse
+import hashlib
+import struct
+import sys
+
+MCUBOOT_IMAGE_MAGIC = 0x96f3b83d
+
+FOOTER_MAGIC = b"OTAD"
+FOOTER_VERSION = 1
+HASH_SIZE = 8
+GEAR_SEED = 0x4F544144
+
+# Defaults: chunks of about 2.5 KB, from 512 bytes to 8 KB. The device
+# accepts 6 to 20 mask bits and chunks of 64 bytes to 64 KB.
+MASK_BITS = 11
+MIN_CHUNK = 512
+MAX_CHUNK = 8192
+
+
+def gear_table():
+    table = []
+    x = GEAR_SEED
+    for i in range(256):
+        x ^= (x << 13) & 0xFFFFFFFF
+        x ^= x >> 17
+        x ^= (x << 5) & 0xFFFFFFFF
+        table.append(x)
+    return table
+
+
+# Cuts data into chunks: a boundary follows a byte once the chunk holds at
+# least min_len bytes and the top mask_bits bits of the gear hash are clear,
+# or once it holds max_len bytes.
+def chunk_lengths(data, mask_bits=MASK_BITS, min_len=MIN_CHUNK, max_len=MAX_CHUNK):
+    gear = gear_table()
+    mask = (0xFFFFFFFF << (32 - mask_bits)) & 0xFFFFFFFF
+    lengths = []
+    start = 0
+    h = 0
+    for i, b in enumerate(data):
+        h = ((h << 1) + gear[b]) & 0xFFFFFFFF
+        size = i + 1 - start
+        if (size >= min_len and (h & mask) == 0) or size >= max_len:
+            lengths.append(size)
+            start = i + 1
+            h = 0
+    if start < len(data):
+        lengths.append(len(data) - start)
+    return lengths
+
+
+def has_manifest(data):
+    return len(data) >= 24 and data[-24:-20] == FOOTER_MAGIC
+
+
+# Returns the file to upload: the image, its manifest and the footer
+def append_manifest(image, mask_bits=MASK_BITS, min_len=MIN_CHUNK, max_len=MAX_CHUNK):
+    manifest = bytearray()
+    off = 0
+    lengths = chunk_lengths(image, mask_bits, min_len, max_len)
+    for length in lengths:
+        manifest += struct.pack("<I", length)
+        manifest += hashlib.sha256(image[off:off + length]).digest()[:HASH_SIZE]
+        off += length
+    footer = FOOTER_MAGIC + struct.pack("<BBHIIII", FOOTER_VERSION, mask_bits, 0,
+                                        min_len, max_len, len(lengths), len(image))
+    return bytes(image) + bytes(manifest) + footer
+
+
+def append_to_file(path, output=None, mask_bits=MASK_BITS, min_len=MIN_CHUNK, max_len=MAX_CHUNK):
+    with open(path, "rb") as file:
+        image = file.read()
+    if len(image) < 4 or struct.unpack("<I", image[:4])[0] != MCUBOOT_IMAGE_MAGIC:
+        raise ValueError("%s is not an MCUboot image" % path)
+    if has_manifest(image):
+        raise ValueError("%s already carries a manifest" % path)
+    if not (6 <= mask_bits <= 20 and 64 <= min_len <= max_len <= 65536):
+        raise ValueError("chunking parameters out of the range of the device")
+    data = append_manifest(image, mask_bits, min_len, max_len)
+    with open(output or path, "wb") as file:
+        file.write(data)
+    count = struct.unpack("<I", data[-8:-4])[0]
+    print("Chunk manifest: %d chunks, %d bytes appended to %s" % (count, len(data) - len(image), output or path))
+
+
+def main(argv):
+    parser = argparse.ArgumentParser(description='Append the OTA_DEDUP chunk manifest to a signed image')
+    parser.add_argument("image", help="signed MCUboot image (.bin)")
+    parser.add_argument("output", nargs="?", help="file to upload, default: the image, in place")
+    parser.add_argument("--mask-bits", type=int, default=MASK_BITS, help="average chunk of about 2^bits bytes past the minimum")
+    parser.add_argument("--min", type=int, default=MIN_CHUNK, help="smallest chunk")
+    parser.add_argument("--max", type=int, default=MAX_CHUNK, help="largest chunk")
+    args = parser.parse_args(argv)
+    try:
+        append_to_file(args.image, args.output, args.mask_bits, args.min, args.max)
+    except (OSError, ValueError) as e:
+        print("Error: %s" % e)
+        sys.exit(1)
+
+
+if __name__ == "__main__":
+    main(sys.argv[1:])
@@ -28,12 +28,14 @@ import user
 from user import User
 import json
 import logging
+import ota_dedup_manifest
 
 parser = argparse.ArgumentParser(description='Script to start OTA update')
 parser.add_argument("--profile", help="Profile name created using aws configure", required=True)
 parser.add_argument("--region", help="Region",default="", required=False)
 parser.add_argument("--account", help="Account ID",default="",required=False)
 parser.add_argument("--devicetype", help="thing|group",default="thing", required=False)
+parser.add_argument("--protocols", help="MQTT|HTTP|MQTT,HTTP",default="MQTT", required=False)
 parser.add_argument("--name", help="Name of thing/group",required=True)
 parser.add_argument("--role", help="Role for OTA updates", required=True)
 parser.add_argument("--s3bucket", help="S3 bucket to store firmware updates", required=True)
@@ -41,6 +43,7 @@ parser.add_argument("--otasigningprofile", help="Signing profile to be created o
 parser.add_argument("--signingcertificateid", help="certificate id (not arn) to be used", required=False)
 parser.add_argument("--buildlocation", help="build folder location (can be relative)",default="../build/ota_cm4/CY8CPROTO-062-4343W/Debug", required=False)
 parser.add_argument("--appversion", help="version of the image being uploade. The appversion value should follow the format APP_VERSION_MAJOR-APP_VERSION_MINOR-APP_VERSION_BUILD that is appended to the filename of the file being uploaded",default="0-0-0",required=True)
+parser.add_argument("--dedup", help="append the chunk manifest for devices built with OTA_DEDUP=1", action="store_true", required=False)
 args=parser.parse_args()
 
 class AWS_IoT_OTA:
@@ -64,6 +67,14 @@ class AWS_IoT_OTA:
             logging.error(e)
             sys.exit
 
+        # The manifest is appended before the file is signed by the job
+        if args.dedup:
+            try:
+                ota_dedup_manifest.append_to_file(str(self.APP_FULL_NAME))
+            except Exception as e:
+                print("Error appending the chunk manifest: %s" % e)
+                sys.exit(1)
+
 
 
 
@@ -171,6 +182,7 @@ class AWS_IoT_OTA:
                 targetSelection='SNAPSHOT',
                 files=files,
                 targets=[target],
+                protocols=args.protocols.split(","),
                 roleArn="arn:aws:iam::"+args.account+":role/"+args.role
             )
 
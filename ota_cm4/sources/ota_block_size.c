@@ -0,0 +1,1285 @@
+/******************************************************************************
+* File Name: ota_block_size.c
+*
+* Description: This file contains the functions that pick the size of the OTA
+* data blocks streamed over MQTT for each request, from measured goodput, loss
+* and free heap.
+*
+* The OTA agent tracks the file in units of OTA_BLOCK_UNIT_SIZE bytes.
+* The block stream requests built by the agent are rewritten so that each
+* streamed block carries 1 to otaconfigMAX_FILE_BLOCK_UNITS units, and each
+* received block is split back into units. The agent ingests one of them and
+* the others are written and marked as received here. The block size is
+* decided again before every request (at most once per round trip with the
+* window), so it may change during a transfer: the block IDs requested in each
+* size are remembered, and tell which size a received block was requested in.
+* When a request asks for fewer blocks than the agent counts on, the next
+* request is signalled once they are received.
+*
+* When CY_OTA_BLOCK_WINDOW is defined, the units requested and the moment of
+* the requests follow the window of ota_block_window.c instead of the fixed
+* batches of the agent.
+*
+* When CY_OTA_ZERO_COPY is defined, the payload of a block is decoded in place
+* and written to flash straight from the message buffer, instead of being
+* copied to a heap buffer by the decoder of the agent.
+*
+* The encoder and decoder of the stream messages are interposed with the
+* -Wl,--wrap linker option.
+*
+* Related Document: See README.md
+*
+*******************************************************************************
+* (c) 2020, Cypress Semiconductor Corporation. All rights reserved.
+*******************************************************************************
+* This software, including source code, documentation and related materials
+* ("Software"), is owned by Cypress Semiconductor Corporation or one of its
+* subsidiaries ("Cypress") and is protected by and subject to worldwide patent
+* protection (United States and foreign), United States copyright laws and
+* international treaty provisions. Therefore, you may use this Software only
+* as provided in the license agreement accompanying the software package from
+* which you obtained this Software ("EULA").
+*
+* If no EULA applies, Cypress hereby grants you a personal, non-exclusive,
+* non-transferable license to copy, modify, and compile the Software source
+* code solely for use in connection with Cypress's integrated circuit products.
+* Any reproduction, modification, translation, compilation, or representation
+* of this Software except as specified above is prohibited without the express
+* written permission of Cypress.
+*
+* Disclaimer: THIS SOFTWARE IS PROVIDED AS-IS, WITH NO WARRANTY OF ANY KIND,
+* EXPRESS OR IMPLIED, INCLUDING, BUT NOT LIMITED TO, NONINFRINGEMENT, IMPLIED
+* WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE. Cypress
+* reserves the right to make changes to the Software without notice. Cypress
+* does not assume any liability arising out of the application or use of the
+* Software or any product or circuit described in the Software. Cypress does
+* not authorize its products for use in any products where a malfunction or
+* failure of the Cypress product may reasonably be expected to result in
+* significant property damage, injury or death ("High Risk Product"). By
+* including Cypress's product in a High Risk Product, the manufacturer of such
+* system or application assumes all risk of such use and in doing so agrees to
+* indemnify Cypress against all liability.
+*******************************************************************************/
+#include <string.h>
+#include "FreeRTOS.h"
+#include "task.h"
+#include "aws_iot_ota_pal.h"
+#include "aws_iot_ota_agent_internal.h"
+#include "ota_block_size.h"
+#include "ota_block_window.h"
+#if defined(CY_OTA_ZERO_COPY)
+#include "ota_cbor_block.h"
+#endif
+#if defined(CY_OTA_BLOCK_BENCHMARK)
+#include "cy_pdl.h"
+#endif
+#if defined(CY_OTA_METRICS)
+#include "ota_metrics.h"
+#endif
+#if defined(CY_OTA_MQTT_COEXIST)
+#include "ota_mqtt_coexist.h"
+#endif
+#if defined(CY_OTA_MULTICAST)
+#include "ota_multicast.h"
+#endif
+
+#if defined(CY_OTA_BLOCK_STREAM)
+
+/*******************************************************************************
+ * Macros
+ ******************************************************************************/
+#define BITS_PER_BYTE                   (8U)
+
+
+/*******************************************************************************
+ * Function prototypes
+ ******************************************************************************/
+bool __real_OTA_CBOR_Encode_GetStreamRequestMessage(uint8_t *pucMessageBuffer,
+        size_t xMessageBufferSize, size_t *pxEncodedMessageSize,
+        const char *pcClientToken, int32_t lFileId, int32_t lBlockSize,
+        int32_t lBlockOffset, uint8_t *pucBlockBitmap, size_t xBlockBitmapSize,
+        int32_t lNumOfBlocksRequested);
+bool __real_OTA_CBOR_Decode_GetStreamResponseMessage(const uint8_t *pucMessageBuffer,
+        size_t xMessageSize, int32_t *plFileId, int32_t *plBlockId,
+        int32_t *plBlockSize, uint8_t **ppucPayload, size_t *pxPayloadSize);
+
+bool __wrap_OTA_CBOR_Encode_GetStreamRequestMessage(uint8_t *pucMessageBuffer,
+        size_t xMessageBufferSize, size_t *pxEncodedMessageSize,
+        const char *pcClientToken, int32_t lFileId, int32_t lBlockSize,
+        int32_t lBlockOffset, uint8_t *pucBlockBitmap, size_t xBlockBitmapSize,
+        int32_t lNumOfBlocksRequested);
+bool __wrap_OTA_CBOR_Decode_GetStreamResponseMessage(const uint8_t *pucMessageBuffer,
+        size_t xMessageSize, int32_t *plFileId, int32_t *plBlockId,
+        int32_t *plBlockSize, uint8_t **ppucPayload, size_t *pxPayloadSize);
+
+#if defined(CY_OTA_ZERO_COPY) || defined(CY_OTA_BLOCK_BENCHMARK)
+void __real_vPortFree(void *pv);
+void __wrap_vPortFree(void *pv);
+#endif
+
+
+/*******************************************************************************
+ * Global variables
+ ******************************************************************************/
+/* All the functions run in the OTA agent task. */
+static OTA_FileContext_t *file_ctx = NULL;
+static uint32_t file_units;             /* Units in the file */
+static uint32_t block_units = 1U;       /* Units per streamed block */
+static uint32_t prev_block_units = 1U;  /* Before the last increase */
+static bool use_window;                 /* Requests follow ota_block_window.c */
+
+/* Block IDs requested and not received yet, one bitmap per block size in
+ * units (index 0 unused). A response does not carry the block size of its
+ * request, and a short last block can match more than one size: the block ID
+ * tells which size it was requested with.
+ */
+static uint8_t *requested_bitmap[otaconfigMAX_FILE_BLOCK_UNITS + 1U];
+static bool requested_tracked;          /* The bitmaps are allocated */
+
+/* The agent asks for the next blocks once it has ingested as many blocks as
+ * its configuration requests. A request of larger blocks or at the end of the
+ * file asks for fewer: the next request is then signalled here, when the
+ * blocks of the last one have been received, instead of after the agent
+ * request timer.
+ */
+static uint32_t request_left;           /* Blocks of the last request to receive */
+static bool request_signal;             /* Signal the next request */
+
+/* Measurement epoch: from one block size decision to the next */
+static TickType_t epoch_start;
+static uint32_t epoch_requested;        /* Units requested */
+static uint32_t epoch_received;         /* New units received */
+static uint32_t epoch_bytes;            /* New bytes received */
+static uint32_t last_goodput;           /* Bytes per second of the last epoch */
+
+/* Transfer statistics */
+static TickType_t transfer_start;
+static uint32_t transfer_bytes;
+static uint32_t transfer_blocks[otaconfigMAX_FILE_BLOCK_UNITS + 1U];
+
+static uint8_t request_bitmap[OTA_BLOCK_REQUEST_BITMAP_SIZE];
+
+/* Payload handed to the agent for the block being ingested. The agent frees
+ * it after writing it, see __wrap_vPortFree().
+ */
+static void *agent_payload = NULL;
+static bool agent_payload_view;         /* Points into the message buffer */
+
+#if defined(CY_OTA_BLOCK_BENCHMARK)
+static uint32_t bench_start;            /* DWT cycle count at the block start */
+static uint32_t bench_blocks;
+static uint64_t bench_cycles;           /* From decoding to the end of the write */
+static size_t bench_min_free_heap;      /* Lowest free heap after a decode */
+#endif
+
+#if defined(CY_OTA_METRICS)
+static bool metrics_requested;          /* A request was sent for the file */
+static uint32_t metrics_request_bytes;  /* transfer_bytes at the last request */
+#endif
+
+
+/*******************************************************************************
+ * Function definitions
+ ******************************************************************************/
+
+/*******************************************************************************
+ * Function Name: unit_missing
+ *******************************************************************************
+ * Summary:
+ *  Checks the OTA agent bitmap for a unit that has not been received.
+ *
+ * Parameters:
+ *  unit - unit index
+ *
+ * Return:
+ *  bool - true if the unit has not been received yet
+ *
+ ******************************************************************************/
+static bool unit_missing(uint32_t unit)
+{
+    return (unit < file_units) &&
+           ((file_ctx->pucRxBlockBitmap[unit / BITS_PER_BYTE] &
+             (1U << (unit % BITS_PER_BYTE))) != 0U);
+}
+
+
+/*******************************************************************************
+ * Function Name: unit_wanted
+ *******************************************************************************
+ * Summary:
+ *  Checks whether a unit must be requested: not received and, with the
+ *  window, not already requested.
+ *
+ * Parameters:
+ *  unit - unit index
+ *
+ * Return:
+ *  bool - true if the unit must be requested
+ *
+ ******************************************************************************/
+static bool unit_wanted(uint32_t unit)
+{
+#if defined(CY_OTA_BLOCK_WINDOW)
+    return unit_missing(unit) && !(use_window && ota_block_window_outstanding(unit));
+#else
+    return unit_missing(unit);
+#endif
+}
+
+
+/*******************************************************************************
+ * Function Name: heap_max_units
+ *******************************************************************************
+ * Summary:
+ *  Returns the largest block size, in units, that the free heap allows.
+ *
+ * Return:
+ *  uint32_t - number of units, at least 1
+ *
+ ******************************************************************************/
+static uint32_t heap_max_units(void)
+{
+    size_t free_heap = xPortGetFreeHeapSize();
+    uint32_t units = otaconfigMAX_FILE_BLOCK_UNITS;
+
+    while ((units > 1U) &&
+           ((free_heap < OTA_BLOCK_HEAP_RESERVE) ||
+            ((units * OTA_BLOCK_UNIT_SIZE * OTA_BLOCK_HEAP_FACTOR) >
+             (free_heap - OTA_BLOCK_HEAP_RESERVE))))
+    {
+        units--;
+    }
+
+    return units;
+}
+
+
+/*******************************************************************************
+ * Function Name: epoch_loss
+ *******************************************************************************
+ * Summary:
+ *  Returns the loss of the current epoch. With the window, it is measured
+ *  from the units declared lost; otherwise from the units requested and not
+ *  received.
+ *
+ * Return:
+ *  uint32_t - loss in percent, or UINT32_MAX if there is nothing to measure
+ *
+ ******************************************************************************/
+static uint32_t epoch_loss(void)
+{
+#if defined(CY_OTA_BLOCK_WINDOW)
+    if (use_window)
+    {
+        uint32_t lost = ota_block_window_take_lost();
+        uint32_t total = epoch_received + lost;
+
+        return (total > 0U) ? ((lost * 100U) / total) : UINT32_MAX;
+    }
+#endif
+
+    if (0U == epoch_requested)
+    {
+        return UINT32_MAX;
+    }
+
+    return ((epoch_requested - ((epoch_received < epoch_requested) ? epoch_received : epoch_requested))
+            * 100U) / epoch_requested;
+}
+
+
+/*******************************************************************************
+ * Function Name: block_size_decide
+ *******************************************************************************
+ * Summary:
+ *  Picks the block size of the next request from the last epoch: halve it on
+ *  loss, revert an increase that lowered the goodput, grow it by one unit on
+ *  a clean link, and never exceed what the free heap allows. With the window,
+ *  an epoch lasts at least one round trip.
+ *
+ ******************************************************************************/
+static void block_size_decide(void)
+{
+    TickType_t elapsed = xTaskGetTickCount() - epoch_start;
+    uint32_t units = block_units;
+    uint32_t loss;
+
+#if defined(CY_OTA_BLOCK_WINDOW)
+    if (use_window && ((elapsed == 0U) || (elapsed < ota_block_window_srtt())))
+    {
+        return;
+    }
+#endif
+
+    loss = epoch_loss();
+
+    if ((UINT32_MAX != loss) && (elapsed > 0U))
+    {
+        uint32_t goodput = (uint32_t)(((uint64_t)epoch_bytes * configTICK_RATE_HZ) / elapsed);
+
+        if (loss > OTA_BLOCK_LOSS_HIGH_PCT)
+        {
+            units = (units > 1U) ? (units / 2U) : 1U;
+        }
+        else if ((prev_block_units < units) &&
+                 (goodput < ((last_goodput * OTA_BLOCK_GOODPUT_REVERT_8THS) / 8U)))
+        {
+            units = prev_block_units;
+        }
+        else if (loss <= OTA_BLOCK_LOSS_LOW_PCT)
+        {
+            units++;
+        }
+
+        last_goodput = goodput;
+    }
+
+    if (units > heap_max_units())
+    {
+        units = heap_max_units();
+    }
+
+    if (!requested_tracked)
+    {
+        units = 1U;
+    }
+
+    if (units != block_units)
+    {
+        configPRINTF(("OTA block size %u -> %u bytes (goodput %u B/s)\r\n",
+                      (unsigned int)(block_units * OTA_BLOCK_UNIT_SIZE),
+                      (unsigned int)(units * OTA_BLOCK_UNIT_SIZE),
+                      (unsigned int)last_goodput));
+    }
+
+    prev_block_units = block_units;
+    block_units = units;
+
+    epoch_start = xTaskGetTickCount();
+    epoch_requested = 0U;
+    epoch_received = 0U;
+    epoch_bytes = 0U;
+}
+
+
+/*******************************************************************************
+ * Function Name: requested_start
+ *******************************************************************************
+ * Summary:
+ *  Allocates the bitmaps of the requested block IDs of a new file. Without
+ *  them, only blocks of one unit are requested.
+ *
+ ******************************************************************************/
+static void requested_start(void)
+{
+    requested_tracked = true;
+
+    for (uint32_t units = 1U; units <= otaconfigMAX_FILE_BLOCK_UNITS; units++)
+    {
+        uint32_t size = (((file_units + units - 1U) / units) + BITS_PER_BYTE - 1U) / BITS_PER_BYTE;
+
+        /* One size only: the block ID is always in units. */
+        if (otaconfigMAX_FILE_BLOCK_UNITS == 1U)
+        {
+            requested_bitmap[units] = NULL;
+            continue;
+        }
+
+        requested_bitmap[units] = pvPortMalloc(size);
+        if (NULL == requested_bitmap[units])
+        {
+            configPRINTF(("OTA block size: no heap for the request bitmaps, %u byte blocks\r\n",
+                          (unsigned int)OTA_BLOCK_UNIT_SIZE));
+            requested_tracked = false;
+            continue;
+        }
+        memset(requested_bitmap[units], 0, size);
+    }
+}
+
+
+/*******************************************************************************
+ * Function Name: requested_stop
+ ******************************************************************************/
+static void requested_stop(void)
+{
+    for (uint32_t units = 1U; units <= otaconfigMAX_FILE_BLOCK_UNITS; units++)
+    {
+        if (NULL != requested_bitmap[units])
+        {
+            vPortFree(requested_bitmap[units]);
+            requested_bitmap[units] = NULL;
+        }
+    }
+
+    requested_tracked = false;
+}
+
+
+/*******************************************************************************
+ * Function Name: requested_test
+ *******************************************************************************
+ * Summary:
+ *  Checks whether a block ID was requested with a block size and not
+ *  received since.
+ *
+ * Parameters:
+ *  units - block size of the request, in units
+ *  block_id - index of the streamed block
+ *
+ * Return:
+ *  bool - true if the block is outstanding with that size
+ *
+ ******************************************************************************/
+static bool requested_test(uint32_t units, uint32_t block_id)
+{
+    return (NULL != requested_bitmap[units]) &&
+           ((requested_bitmap[units][block_id / BITS_PER_BYTE] &
+             (1U << (block_id % BITS_PER_BYTE))) != 0U);
+}
+
+
+/*******************************************************************************
+ * Function Name: requested_set
+ *******************************************************************************
+ * Summary:
+ *  Marks a block ID as outstanding with a block size, or clears it.
+ *
+ * Parameters:
+ *  units - block size of the request, in units
+ *  block_id - index of the streamed block
+ *  outstanding - new state
+ *
+ ******************************************************************************/
+static void requested_set(uint32_t units, uint32_t block_id, bool outstanding)
+{
+    if (NULL == requested_bitmap[units])
+    {
+        return;
+    }
+
+    if (outstanding)
+    {
+        requested_bitmap[units][block_id / BITS_PER_BYTE] |= (uint8_t)(1U << (block_id % BITS_PER_BYTE));
+    }
+    else
+    {
+        requested_bitmap[units][block_id / BITS_PER_BYTE] &= (uint8_t)~(1U << (block_id % BITS_PER_BYTE));
+    }
+}
+
+
+/*******************************************************************************
+ * Function Name: block_fits
+ *******************************************************************************
+ * Summary:
+ *  Checks whether a block ID and payload size can be a block of a block
+ *  size: a full block, or the last block of the file.
+ *
+ * Parameters:
+ *  units - block size, in units
+ *  block_id - index of the streamed block
+ *  size - payload size
+ *
+ * Return:
+ *  bool - true if the block fits that block size
+ *
+ ******************************************************************************/
+static bool block_fits(uint32_t units, uint32_t block_id, uint32_t size)
+{
+    uint32_t block_size = units * OTA_BLOCK_UNIT_SIZE;
+    uint32_t blocks = (file_units + units - 1U) / units;
+
+    if ((0U == size) || (block_id >= blocks) || (size > block_size))
+    {
+        return false;
+    }
+
+    return ((block_id * block_size) + size) ==
+           (((block_id + 1U) == blocks) ? file_ctx->ulFileSize : ((block_id + 1U) * block_size));
+}
+
+
+/*******************************************************************************
+ * Function Name: block_units_of
+ *******************************************************************************
+ * Summary:
+ *  Finds the block size of the request a received block answers, from the
+ *  block sizes its block ID is outstanding with. A block that fits a single
+ *  block size, such as a duplicate of a block already received, needs no
+ *  record. A block that fits two outstanding requests, such as the short last
+ *  block of a two-unit request and the one-unit block of the same ID, cannot
+ *  be placed: both records are dropped so that the units are requested again.
+ *
+ * Parameters:
+ *  block_id - index of the streamed block
+ *  size - payload size
+ *
+ * Return:
+ *  uint32_t - units per block of the request, 0 if unknown
+ *
+ ******************************************************************************/
+static uint32_t block_units_of(uint32_t block_id, uint32_t size)
+{
+    uint32_t fitting = 0U;
+    uint32_t fitting_count = 0U;
+    uint32_t outstanding = 0U;
+    uint32_t outstanding_count = 0U;
+
+    for (uint32_t units = 1U; units <= otaconfigMAX_FILE_BLOCK_UNITS; units++)
+    {
+        if (!block_fits(units, block_id, size))
+        {
+            continue;
+        }
+
+        fitting = units;
+        fitting_count++;
+
+        if (requested_test(units, block_id))
+        {
+            outstanding = units;
+            outstanding_count++;
+        }
+    }
+
+    if (1U == outstanding_count)
+    {
+        requested_set(outstanding, block_id, false);
+        return outstanding;
+    }
+
+    if (outstanding_count > 1U)
+    {
+        for (uint32_t units = 1U; units <= otaconfigMAX_FILE_BLOCK_UNITS; units++)
+        {
+            if (block_fits(units, block_id, size))
+            {
+                requested_set(units, block_id, false);
+            }
+        }
+
+        return 0U;
+    }
+
+    return (1U == fitting_count) ? fitting : 0U;
+}
+
+
+/*******************************************************************************
+ * Function Name: block_drop
+ *******************************************************************************
+ * Summary:
+ *  Turns a block that cannot be placed into a duplicate for the agent: the
+ *  block ID and size of a unit already received, which the agent ignores.
+ *
+ * Parameters:
+ *  block_id - block ID handed to the agent
+ *  block_size - block size handed to the agent
+ *  payload_size - payload size, replaced by the block size
+ *
+ * Return:
+ *  bool - false if no unit was received yet
+ *
+ ******************************************************************************/
+static bool block_drop(int32_t *block_id, int32_t *block_size, size_t *payload_size)
+{
+    for (uint32_t unit = 0U; unit < file_units; unit++)
+    {
+        uint32_t unit_size = file_ctx->ulFileSize - (unit * OTA_BLOCK_UNIT_SIZE);
+
+        if (unit_size > OTA_BLOCK_UNIT_SIZE)
+        {
+            unit_size = OTA_BLOCK_UNIT_SIZE;
+        }
+
+        if (!unit_missing(unit) && (unit_size <= *payload_size))
+        {
+            *block_id = (int32_t)unit;
+            *block_size = (int32_t)unit_size;
+            *payload_size = unit_size;
+            return true;
+        }
+    }
+
+    return false;
+}
+
+
+#if defined(CY_OTA_ZERO_COPY)
+/*******************************************************************************
+ * Function Name: block_decode_view
+ *******************************************************************************
+ * Summary:
+ *  Decodes a block stream response in place with ota_cbor_block.c. Unlike the
+ *  decoder of the agent, which allocates a buffer for the payload and copies
+ *  it there, the payload returned is a view into the message buffer.
+ *
+ * Parameters:
+ *  msg - message buffer
+ *  size - message size
+ *  file_id - file ID of the block
+ *  block_id - index of the block
+ *  block_size - size of the block
+ *  payload - view of the payload in the message buffer
+ *  payload_size - size of the payload
+ *
+ * Return:
+ *  bool - true if the message was decoded
+ *
+ ******************************************************************************/
+static bool block_decode_view(const uint8_t *msg, size_t size, int32_t *file_id,
+                              int32_t *block_id, int32_t *block_size,
+                              uint8_t **payload, size_t *payload_size)
+{
+    ota_cbor_block_t block;
+
+    if (!ota_cbor_block_decode(msg, size, &block))
+    {
+        return false;
+    }
+
+    *file_id = block.file_id;
+    *block_id = block.block_id;
+    *block_size = block.block_size;
+    *payload = (uint8_t *)block.payload;
+    *payload_size = block.payload_size;
+
+    return true;
+}
+#endif /* CY_OTA_ZERO_COPY */
+
+
+#if defined(CY_OTA_METRICS)
+/*******************************************************************************
+ * Function Name: metrics_request
+ *******************************************************************************
+ * Summary:
+ *  Adds a request sent to the metrics, with the missing units it asks for.
+ *  A request sent while blocks of the previous one are still to be received
+ *  was triggered by the agent timer, and one sent while no new unit was
+ *  received since the previous one by a timer of the window: both count as
+ *  a timeout.
+ *
+ * Parameters:
+ *  first - first block of the request bitmap
+ *  count - blocks in the request bitmap
+ *
+ ******************************************************************************/
+static void metrics_request(uint32_t first, uint32_t count)
+{
+    uint32_t end_unit = first * block_units;
+
+    if ((!use_window && (request_left > 0U)) ||
+        (metrics_requested && (transfer_bytes == metrics_request_bytes)))
+    {
+        ota_metrics_timeout();
+    }
+
+    metrics_requested = true;
+    metrics_request_bytes = transfer_bytes;
+
+    for (uint32_t b = 0U; b < count; b++)
+    {
+        if ((request_bitmap[b / BITS_PER_BYTE] & (1U << (b % BITS_PER_BYTE))) == 0U)
+        {
+            continue;
+        }
+
+        for (uint32_t u = 0U; u < block_units; u++)
+        {
+            uint32_t unit = ((first + b) * block_units) + u;
+
+            if (unit_missing(unit))
+            {
+                ota_metrics_request_unit(unit);
+                end_unit = unit + 1U;
+            }
+        }
+    }
+
+    ota_metrics_request(first * block_units, end_unit);
+}
+#endif /* CY_OTA_METRICS */
+
+
+#if defined(CY_OTA_BLOCK_BENCHMARK)
+/*******************************************************************************
+ * Function Name: bench_cycles_now
+ *******************************************************************************
+ * Summary:
+ *  Returns the DWT cycle counter, enabling it on first use.
+ *
+ * Return:
+ *  uint32_t - cycle count
+ *
+ ******************************************************************************/
+static uint32_t bench_cycles_now(void)
+{
+    if ((DWT->CTRL & DWT_CTRL_CYCCNTENA_Msk) == 0U)
+    {
+        CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk;
+        DWT->CYCCNT = 0U;
+        DWT->CTRL |= DWT_CTRL_CYCCNTENA_Msk;
+    }
+
+    return DWT->CYCCNT;
+}
+#endif /* CY_OTA_BLOCK_BENCHMARK */
+
+
+/*******************************************************************************
+ * Function Name: ota_block_size_start
+ *******************************************************************************
+ * Summary:
+ *  Starts the block size selection for a new file transfer.
+ *
+ * Parameters:
+ *  C - OTA file context of the transfer
+ *
+ ******************************************************************************/
+void ota_block_size_start(OTA_FileContext_t *C)
+{
+    file_ctx = C;
+    file_units = (C->ulFileSize + OTA_BLOCK_UNIT_SIZE - 1U) / OTA_BLOCK_UNIT_SIZE;
+    block_units = 1U;
+    prev_block_units = 1U;
+    last_goodput = 0U;
+    epoch_start = xTaskGetTickCount();
+    epoch_requested = 0U;
+    epoch_received = 0U;
+    epoch_bytes = 0U;
+    transfer_start = epoch_start;
+    transfer_bytes = 0U;
+    memset(transfer_blocks, 0, sizeof(transfer_blocks));
+
+#if defined(CY_OTA_BLOCK_BENCHMARK)
+    bench_blocks = 0U;
+    bench_cycles = 0U;
+    bench_min_free_heap = xPortGetFreeHeapSize();
+#endif
+
+#if defined(CY_OTA_METRICS)
+    metrics_requested = false;
+    metrics_request_bytes = 0U;
+#endif
+
+    requested_start();
+    request_left = 0U;
+    request_signal = false;
+
+#if defined(CY_OTA_BLOCK_WINDOW)
+    use_window = ota_block_window_start(file_units, C->ulBlocksRemaining);
+#else
+    use_window = false;
+#endif
+
+#if defined(CY_OTA_MQTT_COEXIST)
+    ota_mqtt_coexist_begin(C);
+#endif
+}
+
+
+/*******************************************************************************
+ * Function Name: ota_block_size_stop
+ *******************************************************************************
+ * Summary:
+ *  Ends the block size selection and prints the throughput of the transfer
+ *  and how many blocks of each size were received.
+ *
+ * Parameters:
+ *  C - OTA file context of the transfer
+ *
+ ******************************************************************************/
+void ota_block_size_stop(OTA_FileContext_t *C)
+{
+    TickType_t elapsed = xTaskGetTickCount() - transfer_start;
+
+    if ((NULL == file_ctx) || (C != file_ctx))
+    {
+        return;
+    }
+
+#if defined(CY_OTA_BLOCK_WINDOW)
+    ota_block_window_stop();
+#endif
+
+#if defined(CY_OTA_MQTT_COEXIST)
+    ota_mqtt_coexist_end();
+#endif
+
+    configPRINTF(("OTA transfer: %u bytes in %u ms (%u B/s)\r\n",
+                  (unsigned int)transfer_bytes,
+                  (unsigned int)(elapsed * portTICK_PERIOD_MS),
+                  (unsigned int)((elapsed > 0U) ?
+                      (((uint64_t)transfer_bytes * configTICK_RATE_HZ) / elapsed) : 0U)));
+
+    for (uint32_t units = 1U; units <= otaconfigMAX_FILE_BLOCK_UNITS; units++)
+    {
+        if (transfer_blocks[units] > 0U)
+        {
+            configPRINTF(("  %u byte blocks: %u\r\n",
+                          (unsigned int)(units * OTA_BLOCK_UNIT_SIZE),
+                          (unsigned int)transfer_blocks[units]));
+        }
+    }
+
+#if defined(CY_OTA_BLOCK_BENCHMARK)
+    configPRINTF(("  %s path: %u cycles per block, free heap down to %u bytes\r\n",
+#if defined(CY_OTA_ZERO_COPY)
+                  "zero-copy",
+#else
+                  "copy",
+#endif
+                  (unsigned int)((bench_blocks > 0U) ? (bench_cycles / bench_blocks) : 0U),
+                  (unsigned int)bench_min_free_heap));
+#endif
+
+    requested_stop();
+
+    file_ctx = NULL;
+    use_window = false;
+}
+
+
+/*******************************************************************************
+ * Function Name: __wrap_OTA_CBOR_Encode_GetStreamRequestMessage
+ *******************************************************************************
+ * Summary:
+ *  Encodes a block stream request. The unit bitmap of the agent is converted
+ *  to a bitmap of streamed blocks of the size picked for this request,
+ *  starting at the first block to request. Without the window, the request
+ *  asks for as many bytes as the agent configuration; with it, for the free
+ *  space of the window, and only for the units not already outstanding.
+ *  With the MQTT coexistence, the request is also limited to the bytes the
+ *  application traffic leaves to OTA. The blocks written by a multicast
+ *  transfer are marked received first, so that they are not requested.
+ *
+ * Parameters:
+ *  See OTA_CBOR_Encode_GetStreamRequestMessage()
+ *
+ * Return:
+ *  bool - true if the message was encoded
+ *
+ ******************************************************************************/
+bool __wrap_OTA_CBOR_Encode_GetStreamRequestMessage(uint8_t *pucMessageBuffer,
+        size_t xMessageBufferSize, size_t *pxEncodedMessageSize,
+        const char *pcClientToken, int32_t lFileId, int32_t lBlockSize,
+        int32_t lBlockOffset, uint8_t *pucBlockBitmap, size_t xBlockBitmapSize,
+        int32_t lNumOfBlocksRequested)
+{
+    uint32_t blocks;
+    uint32_t first = 0U;
+    uint32_t count;
+    uint32_t wanted = 0U;
+    uint32_t limit;
+    bool limited = false;
+    bool result;
+#if defined(CY_OTA_BLOCK_WINDOW)
+    uint32_t end_unit = 0U;
+#endif
+
+    if ((NULL == file_ctx) || (pucBlockBitmap != file_ctx->pucRxBlockBitmap) ||
+        ((uint32_t)lBlockSize != OTA_BLOCK_UNIT_SIZE) || (0 != lBlockOffset))
+    {
+        return __real_OTA_CBOR_Encode_GetStreamRequestMessage(pucMessageBuffer,
+                xMessageBufferSize, pxEncodedMessageSize, pcClientToken, lFileId,
+                lBlockSize, lBlockOffset, pucBlockBitmap, xBlockBitmapSize,
+                lNumOfBlocksRequested);
+    }
+
+#if defined(CY_OTA_MULTICAST)
+    ota_multicast_collect(file_ctx, 0U, 0U);
+#endif
+
+#if defined(CY_OTA_BLOCK_WINDOW)
+    ota_block_window_expire();
+#endif
+
+    block_size_decide();
+
+    blocks = (file_units + block_units - 1U) / block_units;
+
+    /* Blocks per request: the bytes of the agent configuration, or the free
+     * space of the window.
+     */
+    limit = ((uint32_t)lNumOfBlocksRequested + block_units - 1U) / block_units;
+#if defined(CY_OTA_BLOCK_WINDOW)
+    if (use_window)
+    {
+        uint32_t quota = ota_block_window_quota();
+
+        limit = (quota + block_units - 1U) / block_units;
+    }
+#endif
+#if defined(CY_OTA_MQTT_COEXIST)
+    {
+        uint32_t quota = ota_mqtt_coexist_quota(limit, block_units * OTA_BLOCK_UNIT_SIZE);
+
+        /* The coexistence asks for the rest when its bucket refills. */
+        limited = (quota < limit);
+        limit = quota;
+    }
+#endif
+
+    for (int pass = 0; pass < 2; pass++)
+    {
+        /* Start the window at the first block to request, on a byte boundary. */
+        for (first = 0U; first < blocks; first++)
+        {
+            bool found = false;
+
+            for (uint32_t u = 0U; (u < block_units) && !found; u++)
+            {
+                uint32_t unit = (first * block_units) + u;
+
+                found = (0 == pass) ? unit_wanted(unit) : unit_missing(unit);
+            }
+
+            if (found)
+            {
+                break;
+            }
+        }
+
+        first &= ~(BITS_PER_BYTE - 1U);
+        count = blocks - first;
+        if (count > (OTA_BLOCK_REQUEST_BITMAP_SIZE * BITS_PER_BYTE))
+        {
+            count = OTA_BLOCK_REQUEST_BITMAP_SIZE * BITS_PER_BYTE;
+        }
+
+        memset(request_bitmap, 0, sizeof(request_bitmap));
+
+        for (uint32_t b = 0U; (b < count) && (wanted < limit); b++)
+        {
+            for (uint32_t u = 0U; u < block_units; u++)
+            {
+                uint32_t unit = ((first + b) * block_units) + u;
+
+                if ((0 == pass) ? unit_wanted(unit) : unit_missing(unit))
+                {
+                    request_bitmap[b / BITS_PER_BYTE] |= (uint8_t)(1U << (b % BITS_PER_BYTE));
+#if defined(CY_OTA_BLOCK_WINDOW)
+                    end_unit = (first + b + 1U) * block_units;
+#endif
+                    wanted++;
+                    break;
+                }
+            }
+        }
+
+        /* Everything missing is outstanding and the window is full: the
+         * agent timer asks again, so re-request the first missing block.
+         */
+        if (wanted > 0U)
+        {
+            break;
+        }
+
+        limit = 1U;
+    }
+
+    if (wanted == 0U)
+    {
+        /* Nothing is missing. */
+        wanted = 1U;
+    }
+
+    epoch_requested += wanted * block_units;
+
+    result = __real_OTA_CBOR_Encode_GetStreamRequestMessage(pucMessageBuffer,
+             xMessageBufferSize, pxEncodedMessageSize, pcClientToken, lFileId,
+             (int32_t)(block_units * OTA_BLOCK_UNIT_SIZE), (int32_t)first,
+             request_bitmap, (count + BITS_PER_BYTE - 1U) / BITS_PER_BYTE,
+             (int32_t)wanted);
+
+#if defined(CY_OTA_METRICS)
+    if (result)
+    {
+        /* Before request_left is set again: it tells a timed out request. */
+        metrics_request(first, count);
+    }
+#endif
+
+    if (result)
+    {
+        for (uint32_t b = 0U; b < count; b++)
+        {
+            if ((request_bitmap[b / BITS_PER_BYTE] & (1U << (b % BITS_PER_BYTE))) != 0U)
+            {
+                requested_set(block_units, first + b, true);
+            }
+        }
+
+        request_left = wanted;
+        request_signal = !use_window && !limited &&
+                         (wanted < (uint32_t)lNumOfBlocksRequested);
+    }
+
+#if defined(CY_OTA_MQTT_COEXIST)
+    if (result)
+    {
+        ota_mqtt_coexist_requested(wanted * block_units * OTA_BLOCK_UNIT_SIZE);
+    }
+#endif
+
+#if defined(CY_OTA_BLOCK_WINDOW)
+    if (result && use_window)
+    {
+        for (uint32_t b = 0U; b < count; b++)
+        {
+            if ((request_bitmap[b / BITS_PER_BYTE] & (1U << (b % BITS_PER_BYTE))) == 0U)
+            {
+                continue;
+            }
+
+            for (uint32_t u = 0U; u < block_units; u++)
+            {
+                uint32_t unit = ((first + b) * block_units) + u;
+
+                if (unit_missing(unit))
+                {
+                    ota_block_window_mark(unit);
+                }
+            }
+        }
+
+        ota_block_window_sent(first * block_units, end_unit);
+    }
+#endif
+
+    return result;
+}
+
+
+/*******************************************************************************
+ * Function Name: __wrap_OTA_CBOR_Decode_GetStreamResponseMessage
+ *******************************************************************************
+ * Summary:
+ *  Decodes a streamed block and splits it into units. The first missing unit
+ *  is returned to the agent, which ingests it as usual. The other missing
+ *  units are written through the PAL and marked as received in the agent
+ *  bitmap here.
+ *
+ *  With CY_OTA_ZERO_COPY, the payload is not copied out of the message buffer:
+ *  the units are written to flash from the message buffer, and the agent gets
+ *  a view of its unit in it. The agent releases the message buffer only after
+ *  it has written its unit.
+ *
+ * Parameters:
+ *  See OTA_CBOR_Decode_GetStreamResponseMessage()
+ *
+ * Return:
+ *  bool - true if the message was decoded
+ *
+ ******************************************************************************/
+bool __wrap_OTA_CBOR_Decode_GetStreamResponseMessage(const uint8_t *pucMessageBuffer,
+        size_t xMessageSize, int32_t *plFileId, int32_t *plBlockId,
+        int32_t *plBlockSize, uint8_t **ppucPayload, size_t *pxPayloadSize)
+{
+    uint32_t size;
+    uint32_t units;
+    uint32_t first_unit;
+    uint32_t unit_count;
+    uint32_t chosen = UINT32_MAX;
+    uint32_t chosen_size;
+    uint8_t *payload;
+    bool view = false;
+    bool received = false;
+#if defined(CY_OTA_METRICS)
+    uint32_t duplicate_units = 0U;
+#endif
+
+#if defined(CY_OTA_BLOCK_BENCHMARK)
+    bench_start = bench_cycles_now();
+#endif
+
+#if defined(CY_OTA_ZERO_COPY)
+    view = block_decode_view(pucMessageBuffer, xMessageSize, plFileId, plBlockId,
+                             plBlockSize, ppucPayload, pxPayloadSize);
+#endif
+
+    if (!view && !__real_OTA_CBOR_Decode_GetStreamResponseMessage(pucMessageBuffer,
+            xMessageSize, plFileId, plBlockId, plBlockSize, ppucPayload, pxPayloadSize))
+    {
+        /* A block too large for the agent buffers: go back to one unit. */
+        block_units = 1U;
+        return false;
+    }
+
+    agent_payload = *ppucPayload;
+    agent_payload_view = view;
+
+#if defined(CY_OTA_BLOCK_BENCHMARK)
+    if (xPortGetFreeHeapSize() < bench_min_free_heap)
+    {
+        bench_min_free_heap = xPortGetFreeHeapSize();
+    }
+#endif
+
+    if (NULL == file_ctx)
+    {
+        return true;
+    }
+
+    size = (uint32_t)*plBlockSize;
+
+    if (*pxPayloadSize != size)
+    {
+        /* Not a well-formed block: let the agent reject it. */
+        return true;
+    }
+
+    units = block_units_of((uint32_t)*plBlockId, size);
+
+    if (0U == units)
+    {
+        /* Not placed: written nowhere, and requested again later. There is
+         * always a unit received by then, as the block size only grows
+         * after units are received.
+         */
+        (void)block_drop(plBlockId, plBlockSize, pxPayloadSize);
+        return true;
+    }
+
+    payload = *ppucPayload;
+    first_unit = (uint32_t)*plBlockId * units;
+    unit_count = (size + OTA_BLOCK_UNIT_SIZE - 1U) / OTA_BLOCK_UNIT_SIZE;
+
+    transfer_blocks[units]++;
+
+    for (uint32_t u = 0U; u < unit_count; u++)
+    {
+        uint32_t unit = first_unit + u;
+        uint32_t unit_size = size - (u * OTA_BLOCK_UNIT_SIZE);
+
+        if (unit_size > OTA_BLOCK_UNIT_SIZE)
+        {
+            unit_size = OTA_BLOCK_UNIT_SIZE;
+        }
+
+        if (!unit_missing(unit))
+        {
+#if defined(CY_OTA_METRICS)
+            duplicate_units++;
+#endif
+            continue;
+        }
+
+        received = true;
+        epoch_received++;
+        epoch_bytes += unit_size;
+        transfer_bytes += unit_size;
+
+#if defined(CY_OTA_BLOCK_WINDOW)
+        ota_block_window_received(unit);
+#endif
+
+        if (UINT32_MAX == chosen)
+        {
+            /* Left to the agent, which completes the file. */
+            chosen = u;
+            continue;
+        }
+
+        if (prvPAL_WriteBlock(file_ctx, unit * OTA_BLOCK_UNIT_SIZE,
+                              &payload[u * OTA_BLOCK_UNIT_SIZE], unit_size) == (int16_t)unit_size)
+        {
+            file_ctx->pucRxBlockBitmap[unit / BITS_PER_BYTE] &= (uint8_t)~(1U << (unit % BITS_PER_BYTE));
+            file_ctx->ulBlocksRemaining--;
+        }
+    }
+
+#if defined(CY_OTA_BLOCK_WINDOW)
+    ota_block_window_update();
+#endif
+
+    if (received && (request_left > 0U) && (0U == --request_left) && request_signal)
+    {
+        OTA_EventMsg_t event = { 0 };
+
+        request_signal = false;
+        event.xEventId = eOTA_AgentEvent_RequestFileBlock;
+        (void)OTA_SignalEvent(&event);
+    }
+
+#if defined(CY_OTA_METRICS)
+    if (duplicate_units > 0U)
+    {
+        ota_metrics_duplicate(duplicate_units);
+    }
+#endif
+
+    if (UINT32_MAX == chosen)
+    {
+        /* Every unit is a duplicate: the agent sees a duplicate too. */
+        chosen = 0U;
+    }
+
+    chosen_size = size - (chosen * OTA_BLOCK_UNIT_SIZE);
+    if (chosen_size > OTA_BLOCK_UNIT_SIZE)
+    {
+        chosen_size = OTA_BLOCK_UNIT_SIZE;
+    }
+
+    if (view)
+    {
+        *ppucPayload = &payload[chosen * OTA_BLOCK_UNIT_SIZE];
+        agent_payload = *ppucPayload;
+    }
+    else if (chosen > 0U)
+    {
+        /* The agent frees the buffer it got from the decoder. */
+        memmove(payload, &payload[chosen * OTA_BLOCK_UNIT_SIZE], chosen_size);
+    }
+
+    *plBlockId = (int32_t)(first_unit + chosen);
+    *plBlockSize = (int32_t)chosen_size;
+    *pxPayloadSize = chosen_size;
+
+    return true;
+}
+
+
+#if defined(CY_OTA_ZERO_COPY) || defined(CY_OTA_BLOCK_BENCHMARK)
+/*******************************************************************************
+ * Function Name: __wrap_vPortFree
+ *******************************************************************************
+ * Summary:
+ *  Frees a heap block. The agent frees the block payload once it has written
+ *  it, which ends the processing of the block. A payload that is a view into
+ *  the message buffer is not freed: the message buffer is released by the
+ *  agent after this.
+ *
+ * Parameters:
+ *  pv - block to free
+ *
+ ******************************************************************************/
+void __wrap_vPortFree(void *pv)
+{
+    if ((NULL != pv) && (pv == agent_payload))
+    {
+        bool view = agent_payload_view;
+
+        agent_payload = NULL;
+
+#if defined(CY_OTA_BLOCK_BENCHMARK)
+        bench_cycles += bench_cycles_now() - bench_start;
+        bench_blocks++;
+#endif
+
+        if (view)
+        {
+            return;
+        }
+    }
+
+    __real_vPortFree(pv);
+}
+#endif /* CY_OTA_ZERO_COPY || CY_OTA_BLOCK_BENCHMARK */
+
+#endif /* CY_OTA_BLOCK_STREAM */
+
+
+/* [] END OF FILE */
@@ -0,0 +1,98 @@
+/******************************************************************************
+* File Name: ota_block_size.h
+*
+* Description: This file contains the macros and function declarations of the
+* runtime selection of the OTA data block size.
+*
+* Related Document: See README.md
+*
+*******************************************************************************
+* (c) 2020, Cypress Semiconductor Corporation. All rights reserved.
+*******************************************************************************
+* This software, including source code, documentation and related materials
+* ("Software"), is owned by Cypress Semiconductor Corporation or one of its
+* subsidiaries ("Cypress") and is protected by and subject to worldwide patent
+* protection (United States and foreign), United States copyright laws and
+* international treaty provisions. Therefore, you may use this Software only
+* as provided in the license agreement accompanying the software package from
+* which you obtained this Software ("EULA").
+*
+* If no EULA applies, Cypress hereby grants you a personal, non-exclusive,
+* non-transferable license to copy, modify, and compile the Software source
+* code solely for use in connection with Cypress's integrated circuit products.
+* Any reproduction, modification, translation, compilation, or representation
+* of this Software except as specified above is prohibited without the express
+* written permission of Cypress.
+*
+* Disclaimer: THIS SOFTWARE IS PROVIDED AS-IS, WITH NO WARRANTY OF ANY KIND,
+* EXPRESS OR IMPLIED, INCLUDING, BUT NOT LIMITED TO, NONINFRINGEMENT, IMPLIED
+* WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE. Cypress
+* reserves the right to make changes to the Software without notice. Cypress
+* does not assume any liability arising out of the application or use of the
+* Software or any product or circuit described in the Software. Cypress does
+* not authorize its products for use in any products where a malfunction or
+* failure of the Cypress product may reasonably be expected to result in
+* significant property damage, injury or death ("High Risk Product"). By
+* including Cypress's product in a High Risk Product, the manufacturer of such
+* system or application assumes all risk of such use and in doing so agrees to
+* indemnify Cypress against all liability.
+*******************************************************************************/
+#ifndef OTA_BLOCK_SIZE_H
+#define OTA_BLOCK_SIZE_H
+
+#include "aws_iot_ota_agent.h"
+#include "aws_ota_agent_config.h"
+
+
+/*******************************************************************************
+ * Macros
+ ******************************************************************************/
+/* The block stream messages are interposed when any of the OTA block stream
+ * features is enabled.
+ */
+#if defined(CY_OTA_ADAPTIVE_BLOCK_SIZE) || defined(CY_OTA_BLOCK_WINDOW) || \
+    defined(CY_OTA_ZERO_COPY)
+#define CY_OTA_BLOCK_STREAM
+#endif
+
+/* Size of the blocks tracked by the OTA agent (one bit of the block bitmap) */
+#define OTA_BLOCK_UNIT_SIZE             (1UL << otaconfigLOG2_FILE_BLOCK_SIZE)
+
+/* Largest streamed block, in units. See otaconfigMAX_FILE_BLOCK_UNITS. */
+#ifndef otaconfigMAX_FILE_BLOCK_UNITS
+#define otaconfigMAX_FILE_BLOCK_UNITS   (1U)
+#endif
+
+/* Loss (percent of the requested blocks not received) above which the block
+ * size is halved, and below which it may grow by one unit.
+ */
+#define OTA_BLOCK_LOSS_HIGH_PCT         (10U)
+#define OTA_BLOCK_LOSS_LOW_PCT          (2U)
+
+/* A block size increase is reverted when the goodput drops below this
+ * fraction (in 1/8) of the goodput before the increase.
+ */
+#define OTA_BLOCK_GOODPUT_REVERT_8THS   (7U)
+
+/* Heap kept free for the rest of the application. Every streamed block needs
+ * about OTA_BLOCK_HEAP_FACTOR times its size in transient heap (MQTT receive
+ * and CBOR decode).
+ */
+#define OTA_BLOCK_HEAP_RESERVE          (16384UL)
+#define OTA_BLOCK_HEAP_FACTOR           (3UL)
+
+/* Largest block bitmap sent in one request, in bytes */
+#define OTA_BLOCK_REQUEST_BITMAP_SIZE   (128U)
+
+
+/*******************************************************************************
+ * Function prototypes
+ ******************************************************************************/
+void ota_block_size_start(OTA_FileContext_t *C);
+void ota_block_size_stop(OTA_FileContext_t *C);
+
+
+#endif /* OTA_BLOCK_SIZE_H */
+
+
+/* [] END OF FILE */
@@ -0,0 +1,794 @@
+/******************************************************************************
+* File Name: ota_block_window.c
+*
+* Description: This file contains the functions that keep a sliding window of
+* outstanding OTA block requests, in the way TCP keeps its congestion window.
+*
+* The blocks of the file are tracked in units of OTA_BLOCK_UNIT_SIZE bytes.
+* A unit is outstanding from the request that asks for it until it is
+* received or declared lost. Only units that are neither received nor
+* outstanding are requested, so a request re-asks for gaps only.
+*
+* - The window follows the delivery rate: every round trip, the units
+*   received give a rate sample, and the window is set to twice the best
+*   recent rate times the shortest round-trip time. At the start of a
+*   transfer, it doubles every round trip until the rate stops growing.
+* - The streaming service answers the requests in order, so a unit received
+*   after a gap marks the gap as lost, and the next request asks for it
+*   again. Losses alone do not shrink the window: blocks are lost on the
+*   MQTT path without the link being congested, and the block size already
+*   reacts to them (ota_block_size.c).
+* - A request that is not answered within the retransmit timeout, computed
+*   from the measured round-trip time, marks its units as lost, collapses
+*   the window and doubles the timeout. The window grows back to the
+*   delivery rate measured before the stall within a few round trips.
+*
+* A new request is signalled to the OTA agent as soon as half of the window
+* is free, and when the retransmit timeout expires.
+*
+* Related Document: See README.md
+*
+*******************************************************************************
+* (c) 2020, Cypress Semiconductor Corporation. All rights reserved.
+*******************************************************************************
+* This software, including source code, documentation and related materials
+* ("Software"), is owned by Cypress Semiconductor Corporation or one of its
+* subsidiaries ("Cypress") and is protected by and subject to worldwide patent
+* protection (United States and foreign), United States copyright laws and
+* international treaty provisions. Therefore, you may use this Software only
+* as provided in the license agreement accompanying the software package from
+* which you obtained this Software ("EULA").
+*
+* If no EULA applies, Cypress hereby grants you a personal, non-exclusive,
+* non-transferable license to copy, modify, and compile the Software source
+* code solely for use in connection with Cypress's integrated circuit products.
+* Any reproduction, modification, translation, compilation, or representation
+* of this Software except as specified above is prohibited without the express
+* written permission of Cypress.
+*
+* Disclaimer: THIS SOFTWARE IS PROVIDED AS-IS, WITH NO WARRANTY OF ANY KIND,
+* EXPRESS OR IMPLIED, INCLUDING, BUT NOT LIMITED TO, NONINFRINGEMENT, IMPLIED
+* WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE. Cypress
+* reserves the right to make changes to the Software without notice. Cypress
+* does not assume any liability arising out of the application or use of the
+* Software or any product or circuit described in the Software. Cypress does
+* not authorize its products for use in any products where a malfunction or
+* failure of the Cypress product may reasonably be expected to result in
+* significant property damage, injury or death ("High Risk Product"). By
+* including Cypress's product in a High Risk Product, the manufacturer of such
+* system or application assumes all risk of such use and in doing so agrees to
+* indemnify Cypress against all liability.
+*******************************************************************************/
+#include <string.h>
+#include "FreeRTOS.h"
+#include "task.h"
+#include "timers.h"
+#include "aws_iot_ota_agent.h"
+#include "aws_iot_ota_agent_internal.h"
+#include "ota_block_size.h"
+#include "ota_block_window.h"
+
+#if defined(CY_OTA_BLOCK_WINDOW)
+
+/*******************************************************************************
+ * Macros
+ ******************************************************************************/
+#define BITS_PER_BYTE                   (8U)
+
+/* Window limits, in units. The service sends at most 128 KB per request. */
+#define WINDOW_MIN_UNITS                (2U * otaconfigMAX_FILE_BLOCK_UNITS)
+#define WINDOW_MAX_UNITS                (otaconfigMAX_NUM_BLOCKS_REQUEST)
+
+
+/*******************************************************************************
+ * Data structure and enumeration
+ ******************************************************************************/
+typedef struct
+{
+    TickType_t sent;            /* Tick count when the request was sent */
+    uint32_t first;             /* First unit requested */
+    uint32_t end;               /* One past the last unit requested */
+    uint32_t scan;              /* Units below this are checked for loss */
+    bool retransmit;            /* Re-asks for units: no RTT sample (Karn) */
+    bool answered;              /* A unit of the request was received */
+} window_request_t;
+
+
+/*******************************************************************************
+ * Global variables
+ ******************************************************************************/
+/* All the state is used by the OTA agent task only. */
+static uint8_t *outstanding_bitmap = NULL;
+static uint32_t file_units;
+static uint32_t inflight;               /* Outstanding units */
+static uint32_t unsent;                 /* Units neither received nor outstanding */
+static uint32_t next_new;               /* Units below were requested at least once */
+static uint32_t cwnd;                   /* Window, in units */
+static uint32_t cwnd_target;            /* Window for the measured delivery rate */
+static bool startup;                    /* Doubling until the rate stops growing */
+static uint32_t lost;                   /* Units declared lost, see take_lost() */
+static TickType_t srtt;                 /* Smoothed round-trip time, 0 if no sample */
+static TickType_t rttvar;               /* Round-trip time variation */
+static TickType_t rto;                  /* Retransmit timeout */
+static TickType_t min_rtt;              /* Shortest round-trip time, 0 if no sample */
+static TickType_t min_rtt_stamp;        /* When min_rtt was measured */
+
+/* Delivery rate, in units per second */
+static TickType_t round_start;
+static uint32_t round_delivered;        /* Units received in the current round */
+static uint32_t rate_samples[OTA_BLOCK_WINDOW_RATE_ROUNDS];
+static uint32_t rate_index;
+static uint32_t full_rate;              /* Rate at the last startup growth */
+static uint32_t full_rate_rounds;       /* Rounds without startup growth */
+static bool request_pending;            /* A request was signalled to the agent */
+
+static window_request_t requests[OTA_BLOCK_WINDOW_REQUESTS];
+static uint32_t requests_head;          /* Oldest request */
+static uint32_t requests_count;
+
+static TimerHandle_t rto_timer = NULL;
+static StaticTimer_t rto_timer_buffer;
+
+
+/*******************************************************************************
+ * Function definitions
+ ******************************************************************************/
+
+/*******************************************************************************
+ * Function Name: request_at
+ *******************************************************************************
+ * Summary:
+ *  Returns a remembered request, from the oldest one.
+ *
+ * Parameters:
+ *  index - 0 for the oldest request
+ *
+ * Return:
+ *  window_request_t* - the request
+ *
+ ******************************************************************************/
+static window_request_t *request_at(uint32_t index)
+{
+    return &requests[(requests_head + index) % OTA_BLOCK_WINDOW_REQUESTS];
+}
+
+
+/*******************************************************************************
+ * Function Name: signal_request
+ *******************************************************************************
+ * Summary:
+ *  Asks the OTA agent to send a block request now.
+ *
+ ******************************************************************************/
+static void signal_request(void)
+{
+    OTA_EventMsg_t event = { 0 };
+
+    event.xEventId = eOTA_AgentEvent_RequestFileBlock;
+    (void)OTA_SignalEvent(&event);
+}
+
+
+/*******************************************************************************
+ * Function Name: rto_timer_callback
+ *******************************************************************************
+ * Summary:
+ *  Runs when nothing was sent or received for one retransmit timeout. The
+ *  expired units are handled by the request it triggers.
+ *
+ * Parameters:
+ *  timer - unused
+ *
+ ******************************************************************************/
+static void rto_timer_callback(TimerHandle_t timer)
+{
+    (void)timer;
+
+    signal_request();
+}
+
+
+/*******************************************************************************
+ * Function Name: rto_timer_restart
+ *******************************************************************************
+ * Summary:
+ *  Restarts the retransmit timer with the current timeout.
+ *
+ ******************************************************************************/
+static void rto_timer_restart(void)
+{
+    if ((NULL != rto_timer) && (inflight > 0U))
+    {
+        (void)xTimerChangePeriod(rto_timer, rto, 0U);
+    }
+}
+
+
+/*******************************************************************************
+ * Function Name: covered_by_newer
+ *******************************************************************************
+ * Summary:
+ *  Checks whether a request newer than the given one also covers a unit. Such
+ *  a unit may be outstanding because of the newer request.
+ *
+ * Parameters:
+ *  index - request index, 0 for the oldest request
+ *  unit - unit index
+ *
+ * Return:
+ *  bool - true if a newer request covers the unit
+ *
+ ******************************************************************************/
+static bool covered_by_newer(uint32_t index, uint32_t unit)
+{
+    for (uint32_t i = index + 1U; i < requests_count; i++)
+    {
+        window_request_t *request = request_at(i);
+
+        if ((unit >= request->first) && (unit < request->end))
+        {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+
+/*******************************************************************************
+ * Function Name: lose_units
+ *******************************************************************************
+ * Summary:
+ *  Declares the outstanding units of a request in a range as lost, so that
+ *  the next request asks for them again.
+ *
+ * Parameters:
+ *  index - request index, 0 for the oldest request
+ *  from - first unit of the range
+ *  to - one past the last unit of the range
+ *
+ * Return:
+ *  uint32_t - number of units declared lost
+ *
+ ******************************************************************************/
+static uint32_t lose_units(uint32_t index, uint32_t from, uint32_t to)
+{
+    uint32_t count = 0U;
+
+    for (uint32_t unit = from; unit < to; unit++)
+    {
+        if (ota_block_window_outstanding(unit) && !covered_by_newer(index, unit))
+        {
+            outstanding_bitmap[unit / BITS_PER_BYTE] &= (uint8_t)~(1U << (unit % BITS_PER_BYTE));
+            inflight--;
+            unsent++;
+            count++;
+        }
+    }
+
+    lost += count;
+
+    return count;
+}
+
+
+/*******************************************************************************
+ * Function Name: drop_oldest
+ *******************************************************************************
+ * Summary:
+ *  Forgets the oldest request. Its units still outstanding are lost.
+ *
+ * Return:
+ *  uint32_t - number of units declared lost
+ *
+ ******************************************************************************/
+static uint32_t drop_oldest(void)
+{
+    window_request_t *request = request_at(0U);
+    uint32_t count = lose_units(0U, (request->scan > request->first) ? request->scan : request->first,
+                                request->end);
+
+    requests_head = (requests_head + 1U) % OTA_BLOCK_WINDOW_REQUESTS;
+    requests_count--;
+
+    return count;
+}
+
+
+/*******************************************************************************
+ * Function Name: rtt_sample
+ *******************************************************************************
+ * Summary:
+ *  Updates the smoothed round-trip time and the retransmit timeout from one
+ *  sample (RFC 6298).
+ *
+ * Parameters:
+ *  rtt - measured round-trip time in ticks
+ *
+ ******************************************************************************/
+static void rtt_sample(TickType_t rtt)
+{
+    if (0U == srtt)
+    {
+        srtt = (rtt > 0U) ? rtt : 1U;
+        rttvar = srtt / 2U;
+    }
+    else
+    {
+        TickType_t delta = (srtt > rtt) ? (srtt - rtt) : (rtt - srtt);
+
+        rttvar = ((3U * rttvar) + delta) / 4U;
+        srtt = ((7U * srtt) + rtt) / 8U;
+    }
+
+    if ((0U == min_rtt) || (rtt <= min_rtt) ||
+        ((xTaskGetTickCount() - min_rtt_stamp) > pdMS_TO_TICKS(OTA_BLOCK_WINDOW_MIN_RTT_MS)))
+    {
+        min_rtt = (rtt > 0U) ? rtt : 1U;
+        min_rtt_stamp = xTaskGetTickCount();
+    }
+
+    rto = srtt + ((rttvar > 0U) ? (4U * rttvar) : 1U);
+
+    if (rto < pdMS_TO_TICKS(OTA_BLOCK_WINDOW_RTO_MIN_MS))
+    {
+        rto = pdMS_TO_TICKS(OTA_BLOCK_WINDOW_RTO_MIN_MS);
+    }
+    else if (rto > pdMS_TO_TICKS(OTA_BLOCK_WINDOW_RTO_MAX_MS))
+    {
+        rto = pdMS_TO_TICKS(OTA_BLOCK_WINDOW_RTO_MAX_MS);
+    }
+}
+
+
+/*******************************************************************************
+ * Function Name: rate_round
+ *******************************************************************************
+ * Summary:
+ *  Ends a round of one round-trip time: takes a delivery rate sample, leaves
+ *  the startup once the rate stopped growing for three rounds, and sets the
+ *  window to the delivery rate times the shortest round-trip time.
+ *
+ * Parameters:
+ *  now - current tick count
+ *
+ ******************************************************************************/
+static void rate_round(TickType_t now)
+{
+    TickType_t elapsed = now - round_start;
+    uint32_t rate = 0U;
+    uint32_t target;
+
+    if ((0U == min_rtt) || (elapsed < srtt) || (0U == elapsed))
+    {
+        return;
+    }
+
+    rate_samples[rate_index] = (uint32_t)(((uint64_t)round_delivered * configTICK_RATE_HZ) / elapsed);
+    rate_index = (rate_index + 1U) % OTA_BLOCK_WINDOW_RATE_ROUNDS;
+    round_start = now;
+    round_delivered = 0U;
+
+    for (uint32_t i = 0U; i < OTA_BLOCK_WINDOW_RATE_ROUNDS; i++)
+    {
+        if (rate_samples[i] > rate)
+        {
+            rate = rate_samples[i];
+        }
+    }
+
+    if (startup)
+    {
+        if (rate >= ((full_rate * 5U) / 4U))
+        {
+            full_rate = rate;
+            full_rate_rounds = 0U;
+        }
+        else if (++full_rate_rounds >= 3U)
+        {
+            startup = false;
+        }
+    }
+
+    target = (uint32_t)((2ULL * rate * min_rtt) / configTICK_RATE_HZ) + WINDOW_MIN_UNITS;
+    if (target > WINDOW_MAX_UNITS)
+    {
+        target = WINDOW_MAX_UNITS;
+    }
+
+    cwnd_target = target;
+    if (!startup && (cwnd > cwnd_target))
+    {
+        cwnd = cwnd_target;
+    }
+}
+
+
+/*******************************************************************************
+ * Function Name: ota_block_window_start
+ *******************************************************************************
+ * Summary:
+ *  Starts the window for a new file transfer.
+ *
+ * Parameters:
+ *  units - number of units in the file
+ *  missing_units - number of units not received yet
+ *
+ * Return:
+ *  bool - true if the window is used for the transfer
+ *
+ ******************************************************************************/
+bool ota_block_window_start(uint32_t units, uint32_t missing_units)
+{
+    size_t size = (units + BITS_PER_BYTE - 1U) / BITS_PER_BYTE;
+
+    ota_block_window_stop();
+
+    outstanding_bitmap = pvPortMalloc(size);
+    if (NULL == outstanding_bitmap)
+    {
+        configPRINTF(("OTA block window: no memory, using fixed requests\r\n"));
+        return false;
+    }
+
+    if (NULL == rto_timer)
+    {
+        rto_timer = xTimerCreateStatic("OTA_RTO", pdMS_TO_TICKS(OTA_BLOCK_WINDOW_RTO_INITIAL_MS),
+                                       pdFALSE, NULL, rto_timer_callback, &rto_timer_buffer);
+    }
+
+    memset(outstanding_bitmap, 0, size);
+    file_units = units;
+    inflight = 0U;
+    unsent = missing_units;
+    next_new = 0U;
+    cwnd = OTA_BLOCK_WINDOW_INITIAL / OTA_BLOCK_UNIT_SIZE;
+    if (cwnd < WINDOW_MIN_UNITS)
+    {
+        cwnd = WINDOW_MIN_UNITS;
+    }
+    cwnd_target = cwnd;
+    startup = true;
+    lost = 0U;
+    srtt = 0U;
+    rttvar = 0U;
+    rto = pdMS_TO_TICKS(OTA_BLOCK_WINDOW_RTO_INITIAL_MS);
+    min_rtt = 0U;
+    min_rtt_stamp = xTaskGetTickCount();
+    round_start = min_rtt_stamp;
+    round_delivered = 0U;
+    memset(rate_samples, 0, sizeof(rate_samples));
+    rate_index = 0U;
+    full_rate = 0U;
+    full_rate_rounds = 0U;
+    request_pending = false;
+    requests_head = 0U;
+    requests_count = 0U;
+
+    return true;
+}
+
+
+/*******************************************************************************
+ * Function Name: ota_block_window_stop
+ *******************************************************************************
+ * Summary:
+ *  Stops the window at the end of a file transfer.
+ *
+ ******************************************************************************/
+void ota_block_window_stop(void)
+{
+    if (NULL != rto_timer)
+    {
+        (void)xTimerStop(rto_timer, 0U);
+    }
+
+    if (NULL != outstanding_bitmap)
+    {
+        vPortFree(outstanding_bitmap);
+        outstanding_bitmap = NULL;
+    }
+}
+
+
+/*******************************************************************************
+ * Function Name: ota_block_window_expire
+ *******************************************************************************
+ * Summary:
+ *  Declares the units of the requests older than the retransmit timeout as
+ *  lost. On a timeout the window collapses to its minimum and the timeout is
+ *  doubled. Called before every request.
+ *
+ ******************************************************************************/
+void ota_block_window_expire(void)
+{
+    TickType_t now = xTaskGetTickCount();
+    bool expired = false;
+
+    if (NULL == outstanding_bitmap)
+    {
+        return;
+    }
+
+    while ((requests_count > 0U) && ((now - request_at(0U)->sent) >= rto))
+    {
+        if (drop_oldest() > 0U)
+        {
+            expired = true;
+        }
+    }
+
+    if (expired)
+    {
+        cwnd = WINDOW_MIN_UNITS;
+        startup = false;
+
+        rto *= 2U;
+        if (rto > pdMS_TO_TICKS(OTA_BLOCK_WINDOW_RTO_MAX_MS))
+        {
+            rto = pdMS_TO_TICKS(OTA_BLOCK_WINDOW_RTO_MAX_MS);
+        }
+    }
+}
+
+
+/*******************************************************************************
+ * Function Name: ota_block_window_outstanding
+ *******************************************************************************
+ * Summary:
+ *  Checks whether a unit was requested and is still expected.
+ *
+ * Parameters:
+ *  unit - unit index
+ *
+ * Return:
+ *  bool - true if the unit is outstanding
+ *
+ ******************************************************************************/
+bool ota_block_window_outstanding(uint32_t unit)
+{
+    return (NULL != outstanding_bitmap) && (unit < file_units) &&
+           ((outstanding_bitmap[unit / BITS_PER_BYTE] & (1U << (unit % BITS_PER_BYTE))) != 0U);
+}
+
+
+/*******************************************************************************
+ * Function Name: ota_block_window_quota
+ *******************************************************************************
+ * Summary:
+ *  Returns how many units may be requested now.
+ *
+ * Return:
+ *  uint32_t - free space in the window, in units. UINT32_MAX if the window
+ *             is not used.
+ *
+ ******************************************************************************/
+uint32_t ota_block_window_quota(void)
+{
+    if (NULL == outstanding_bitmap)
+    {
+        return UINT32_MAX;
+    }
+
+    return (cwnd > inflight) ? (cwnd - inflight) : 0U;
+}
+
+
+/*******************************************************************************
+ * Function Name: ota_block_window_mark
+ *******************************************************************************
+ * Summary:
+ *  Marks a unit as outstanding. Called for every missing unit of the request
+ *  being encoded.
+ *
+ * Parameters:
+ *  unit - unit index
+ *
+ ******************************************************************************/
+void ota_block_window_mark(uint32_t unit)
+{
+    if ((NULL == outstanding_bitmap) || (unit >= file_units) ||
+        ota_block_window_outstanding(unit))
+    {
+        return;
+    }
+
+    outstanding_bitmap[unit / BITS_PER_BYTE] |= (uint8_t)(1U << (unit % BITS_PER_BYTE));
+    inflight++;
+    if (unsent > 0U)
+    {
+        unsent--;
+    }
+}
+
+
+/*******************************************************************************
+ * Function Name: ota_block_window_sent
+ *******************************************************************************
+ * Summary:
+ *  Remembers a request after its units were marked outstanding.
+ *
+ * Parameters:
+ *  first_unit - first unit covered by the request
+ *  end_unit - one past the last unit covered by the request
+ *
+ ******************************************************************************/
+void ota_block_window_sent(uint32_t first_unit, uint32_t end_unit)
+{
+    window_request_t *request;
+
+    if (NULL == outstanding_bitmap)
+    {
+        return;
+    }
+
+    if (OTA_BLOCK_WINDOW_REQUESTS == requests_count)
+    {
+        (void)drop_oldest();
+    }
+
+    request = request_at(requests_count);
+    request->sent = xTaskGetTickCount();
+    request->first = first_unit;
+    request->end = end_unit;
+    request->scan = first_unit;
+    request->retransmit = (first_unit < next_new);
+    request->answered = false;
+    requests_count++;
+
+    if (end_unit > next_new)
+    {
+        next_new = end_unit;
+    }
+
+    request_pending = false;
+    rto_timer_restart();
+}
+
+
+/*******************************************************************************
+ * Function Name: ota_block_window_received
+ *******************************************************************************
+ * Summary:
+ *  Records a unit received for the first time. The gaps it reveals are
+ *  declared lost, and the window follows the delivery rate.
+ *
+ * Parameters:
+ *  unit - unit index
+ *
+ ******************************************************************************/
+void ota_block_window_received(uint32_t unit)
+{
+    TickType_t now = xTaskGetTickCount();
+
+    if (NULL == outstanding_bitmap)
+    {
+        return;
+    }
+
+    if (!ota_block_window_outstanding(unit))
+    {
+        /* Late answer to a unit already declared lost */
+        if (unsent > 0U)
+        {
+            unsent--;
+        }
+        return;
+    }
+
+    outstanding_bitmap[unit / BITS_PER_BYTE] &= (uint8_t)~(1U << (unit % BITS_PER_BYTE));
+    inflight--;
+
+    for (uint32_t i = 0U; i < requests_count; i++)
+    {
+        window_request_t *request = request_at(i);
+
+        if ((unit < request->first) || (unit >= request->end))
+        {
+            continue;
+        }
+
+        /* The older requests were answered completely. */
+        while (i > 0U)
+        {
+            (void)drop_oldest();
+            i--;
+        }
+
+        request = request_at(0U);
+        if (unit > request->scan)
+        {
+            (void)lose_units(0U, request->scan, unit);
+        }
+        request->scan = unit + 1U;
+
+        if (!request->answered && !request->retransmit)
+        {
+            rtt_sample(now - request->sent);
+        }
+        request->answered = true;
+        break;
+    }
+
+    round_delivered++;
+
+    /* Grow by one unit per unit received: doubling per round trip */
+    if (startup || (cwnd < cwnd_target))
+    {
+        cwnd++;
+    }
+
+    rate_round(now);
+
+    if (cwnd > WINDOW_MAX_UNITS)
+    {
+        cwnd = WINDOW_MAX_UNITS;
+    }
+}
+
+
+/*******************************************************************************
+ * Function Name: ota_block_window_update
+ *******************************************************************************
+ * Summary:
+ *  Called after each received block. Signals a request to the agent as soon
+ *  as half of the window is free, so that a fast link stays busy, and
+ *  restarts the retransmit timer.
+ *
+ ******************************************************************************/
+void ota_block_window_update(void)
+{
+    if (NULL == outstanding_bitmap)
+    {
+        return;
+    }
+
+    if (!request_pending && (unsent > 0U) && (ota_block_window_quota() >= (cwnd / 2U)))
+    {
+        request_pending = true;
+        signal_request();
+    }
+
+    rto_timer_restart();
+}
+
+
+/*******************************************************************************
+ * Function Name: ota_block_window_srtt
+ *******************************************************************************
+ * Summary:
+ *  Returns the smoothed round-trip time of the block requests.
+ *
+ * Return:
+ *  TickType_t - round-trip time in ticks, 0 before the first sample
+ *
+ ******************************************************************************/
+TickType_t ota_block_window_srtt(void)
+{
+    return srtt;
+}
+
+
+/*******************************************************************************
+ * Function Name: ota_block_window_take_lost
+ *******************************************************************************
+ * Summary:
+ *  Returns the number of units declared lost since the last call.
+ *
+ * Return:
+ *  uint32_t - number of units
+ *
+ ******************************************************************************/
+uint32_t ota_block_window_take_lost(void)
+{
+    uint32_t count = lost;
+
+    lost = 0U;
+
+    return count;
+}
+
+#endif /* CY_OTA_BLOCK_WINDOW */
+
+
+/* [] END OF FILE */
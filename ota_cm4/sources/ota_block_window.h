@@ -0,0 +1,94 @@
+/******************************************************************************
+* File Name: ota_block_window.h
+*
+* Description: This file contains the macros and function declarations of the
+* congestion-controlled window of outstanding OTA block requests.
+*
+* Related Document: See README.md
+*
+*******************************************************************************
+* (c) 2020, Cypress Semiconductor Corporation. All rights reserved.
+*******************************************************************************
+* This software, including source code, documentation and related materials
+* ("Software"), is owned by Cypress Semiconductor Corporation or one of its
+* subsidiaries ("Cypress") and is protected by and subject to worldwide patent
+* protection (United States and foreign), United States copyright laws and
+* international treaty provisions. Therefore, you may use this Software only
+* as provided in the license agreement accompanying the software package from
+* which you obtained this Software ("EULA").
+*
+* If no EULA applies, Cypress hereby grants you a personal, non-exclusive,
+* non-transferable license to copy, modify, and compile the Software source
+* code solely for use in connection with Cypress's integrated circuit products.
+* Any reproduction, modification, translation, compilation, or representation
+* of this Software except as specified above is prohibited without the express
+* written permission of Cypress.
+*
+* Disclaimer: THIS SOFTWARE IS PROVIDED AS-IS, WITH NO WARRANTY OF ANY KIND,
+* EXPRESS OR IMPLIED, INCLUDING, BUT NOT LIMITED TO, NONINFRINGEMENT, IMPLIED
+* WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE. Cypress
+* reserves the right to make changes to the Software without notice. Cypress
+* does not assume any liability arising out of the application or use of the
+* Software or any product or circuit described in the Software. Cypress does
+* not authorize its products for use in any products where a malfunction or
+* failure of the Cypress product may reasonably be expected to result in
+* significant property damage, injury or death ("High Risk Product"). By
+* including Cypress's product in a High Risk Product, the manufacturer of such
+* system or application assumes all risk of such use and in doing so agrees to
+* indemnify Cypress against all liability.
+*******************************************************************************/
+#ifndef OTA_BLOCK_WINDOW_H
+#define OTA_BLOCK_WINDOW_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "FreeRTOS.h"
+#include "aws_ota_agent_config.h"
+
+
+/*******************************************************************************
+ * Macros
+ ******************************************************************************/
+/* Window at the start of a transfer, in bytes */
+#define OTA_BLOCK_WINDOW_INITIAL        (8192UL)
+
+/* Retransmit timeout: initial value and limits, in milliseconds. The agent
+ * still requests blocks every otaconfigFILE_REQUEST_WAIT_MS without traffic,
+ * so it is the upper limit.
+ */
+#define OTA_BLOCK_WINDOW_RTO_INITIAL_MS (1000U)
+#define OTA_BLOCK_WINDOW_RTO_MIN_MS     (200U)
+#define OTA_BLOCK_WINDOW_RTO_MAX_MS     (otaconfigFILE_REQUEST_WAIT_MS)
+
+/* Rounds over which the best delivery rate is kept */
+#define OTA_BLOCK_WINDOW_RATE_ROUNDS    (10U)
+
+/* Age after which the shortest round-trip time is measured again */
+#define OTA_BLOCK_WINDOW_MIN_RTT_MS     (10000U)
+
+/* Requests remembered for RTT sampling and loss detection */
+#define OTA_BLOCK_WINDOW_REQUESTS       (16U)
+
+
+/*******************************************************************************
+ * Function prototypes
+ ******************************************************************************/
+bool ota_block_window_start(uint32_t units, uint32_t missing_units);
+void ota_block_window_stop(void);
+
+void ota_block_window_expire(void);
+bool ota_block_window_outstanding(uint32_t unit);
+uint32_t ota_block_window_quota(void);
+void ota_block_window_mark(uint32_t unit);
+void ota_block_window_sent(uint32_t first_unit, uint32_t end_unit);
+void ota_block_window_received(uint32_t unit);
+void ota_block_window_update(void);
+
+TickType_t ota_block_window_srtt(void);
+uint32_t ota_block_window_take_lost(void);
+
+
+#endif /* OTA_BLOCK_WINDOW_H */
+
+
+/* [] END OF FILE */
@@ -0,0 +1,347 @@
+/******************************************************************************
+* File Name: ota_cbor_block.c
+*
+* Description: This file implements an in-place decoder for the block stream
+* responses of the OTA agent. The stream service sends every block as a CBOR
+* map of four entries with one-letter keys:
+*   "f": file ID, "i": block ID, "l": block size, "p": payload (byte string)
+* Instead of walking the map once per key with the generic CBOR parser, the
+* decoder reads the map once, checks every item against the buffer, and
+* returns the payload as a pointer into the message buffer. It allocates
+* nothing and keeps no state.
+*
+* Messages of another shape (nested items, indefinite lengths, tags, trailing
+* bytes) are not decoded; the caller falls back to the decoder of the agent.
+*
+* Related Document: See README.md
+*
+*******************************************************************************
+* (c) 2020, Cypress Semiconductor Corporation. All rights reserved.
+*******************************************************************************
+* This software, including source code, documentation and related materials
+* ("Software"), is owned by Cypress Semiconductor Corporation or one of its
+* subsidiaries ("Cypress") and is protected by and subject to worldwide patent
+* protection (United States and foreign), United States copyright laws and
+* international treaty provisions. Therefore, you may use this Software only
+* as provided in the license agreement accompanying the software package from
+* which you obtained this Software ("EULA").
+*
+* If no EULA applies, Cypress hereby grants you a personal, non-exclusive,
+* non-transferable license to copy, modify, and compile the Software source
+* code solely for use in connection with Cypress's integrated circuit products.
+* Any reproduction, modification, translation, compilation, or representation
+* of this Software except as specified above is prohibited without the express
+* written permission of Cypress.
+*
+* Disclaimer: THIS SOFTWARE IS PROVIDED AS-IS, WITH NO WARRANTY OF ANY KIND,
+* EXPRESS OR IMPLIED, INCLUDING, BUT NOT LIMITED TO, NONINFRINGEMENT, IMPLIED
+* WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE. Cypress
+* reserves the right to make changes to the Software without notice. Cypress
+* does not assume any liability arising out of the application or use of the
+* Software or any product or circuit described in the Software. Cypress does
+* not authorize its products for use in any products where a malfunction or
+* failure of the Cypress product may reasonably be expected to result in
+* significant property damage, injury or death ("High Risk Product"). By
+* including Cypress's product in a High Risk Product, the manufacturer of such
+* system or application assumes all risk of such use and in doing so agrees to
+* indemnify Cypress against all liability.
+*******************************************************************************/
+#include <string.h>
+#include "ota_cbor_block.h"
+
+#if defined(CY_OTA_ZERO_COPY)
+
+/*******************************************************************************
+ * Macros
+ ******************************************************************************/
+/* Major types of the initial byte */
+#define CBOR_MAJOR_SHIFT                (5U)
+#define CBOR_INFO_MASK                  (0x1FU)
+#define CBOR_MAJOR_UINT                 (0U)
+#define CBOR_MAJOR_NINT                 (1U)
+#define CBOR_MAJOR_BYTES                (2U)
+#define CBOR_MAJOR_TEXT                 (3U)
+#define CBOR_MAJOR_MAP                  (5U)
+#define CBOR_MAJOR_SIMPLE               (7U)
+
+/* Additional information: argument in the next 1, 2, 4 or 8 bytes */
+#define CBOR_INFO_UINT8                 (24U)
+#define CBOR_INFO_UINT64                (27U)
+
+/* Entries of a block response */
+#define BLOCK_KEY_FILE_ID               'f'
+#define BLOCK_KEY_BLOCK_ID              'i'
+#define BLOCK_KEY_BLOCK_SIZE            'l'
+#define BLOCK_KEY_PAYLOAD               'p'
+#define BLOCK_SEEN_ALL                  (0x0FU)
+
+/* Largest map read: the four entries and as many unknown ones */
+#define BLOCK_MAP_ENTRIES_MAX           (8U)
+
+
+/*******************************************************************************
+ * Data structure and enumeration
+ ******************************************************************************/
+typedef struct
+{
+    const uint8_t *pos;
+    const uint8_t *end;
+} reader_t;
+
+
+/*******************************************************************************
+ * Function Name: read_head
+ *******************************************************************************
+ * Summary:
+ *  Reads the initial byte of an item and its argument.
+ *
+ * Parameters:
+ *  r - reader, advanced past the head
+ *  major - major type of the item
+ *  arg - argument: value, length or entry count
+ *
+ * Return:
+ *  bool - false if the head is truncated, reserved or of indefinite length
+ *
+ ******************************************************************************/
+static bool read_head(reader_t *r, uint8_t *major, uint64_t *arg)
+{
+    uint8_t info;
+    uint32_t bytes;
+
+    if (r->pos >= r->end)
+    {
+        return false;
+    }
+
+    *major = (uint8_t)(*r->pos >> CBOR_MAJOR_SHIFT);
+    info = (uint8_t)(*r->pos & CBOR_INFO_MASK);
+    r->pos++;
+
+    if (info < CBOR_INFO_UINT8)
+    {
+        *arg = info;
+        return true;
+    }
+    if (info > CBOR_INFO_UINT64)
+    {
+        return false;
+    }
+
+    bytes = 1U << (info - CBOR_INFO_UINT8);
+    if ((size_t)(r->end - r->pos) < bytes)
+    {
+        return false;
+    }
+
+    *arg = 0U;
+    for (uint32_t i = 0U; i < bytes; i++)
+    {
+        *arg = (*arg << 8) | r->pos[i];
+    }
+    r->pos += bytes;
+
+    return true;
+}
+
+
+/*******************************************************************************
+ * Function Name: read_string
+ *******************************************************************************
+ * Summary:
+ *  Returns the bytes of a byte or text string and skips them.
+ *
+ * Parameters:
+ *  r - reader, advanced past the string
+ *  len - length of the string, from its head
+ *
+ * Return:
+ *  const uint8_t * - start of the string, NULL if it overruns the buffer
+ *
+ ******************************************************************************/
+static const uint8_t *read_string(reader_t *r, uint64_t len)
+{
+    const uint8_t *start = r->pos;
+
+    if ((uint64_t)(r->end - r->pos) < len)
+    {
+        return NULL;
+    }
+    r->pos += (size_t)len;
+
+    return start;
+}
+
+
+/*******************************************************************************
+ * Function Name: read_int32
+ *******************************************************************************
+ * Summary:
+ *  Reads an integer item that fits an int32_t.
+ *
+ * Parameters:
+ *  r - reader, advanced past the item
+ *  value - integer read
+ *
+ * Return:
+ *  bool - false if the item is not an integer or does not fit
+ *
+ ******************************************************************************/
+static bool read_int32(reader_t *r, int32_t *value)
+{
+    uint8_t major;
+    uint64_t arg;
+
+    if (!read_head(r, &major, &arg) || (arg > (uint64_t)INT32_MAX))
+    {
+        return false;
+    }
+
+    if (CBOR_MAJOR_UINT == major)
+    {
+        *value = (int32_t)arg;
+    }
+    else if (CBOR_MAJOR_NINT == major)
+    {
+        *value = -1 - (int32_t)arg;
+    }
+    else
+    {
+        return false;
+    }
+
+    return true;
+}
+
+
+/*******************************************************************************
+ * Function Name: skip_item
+ *******************************************************************************
+ * Summary:
+ *  Skips the value of an unknown entry: an integer, a string or a simple
+ *  value. Arrays, maps and tags are not skipped.
+ *
+ * Parameters:
+ *  r - reader, advanced past the item
+ *
+ * Return:
+ *  bool - false if the item cannot be skipped
+ *
+ ******************************************************************************/
+static bool skip_item(reader_t *r)
+{
+    uint8_t major;
+    uint64_t arg;
+
+    if (!read_head(r, &major, &arg))
+    {
+        return false;
+    }
+
+    switch (major)
+    {
+        case CBOR_MAJOR_UINT:
+        case CBOR_MAJOR_NINT:
+        case CBOR_MAJOR_SIMPLE:
+            return true;
+        case CBOR_MAJOR_BYTES:
+        case CBOR_MAJOR_TEXT:
+            return (NULL != read_string(r, arg));
+        default:
+            return false;
+    }
+}
+
+
+/*******************************************************************************
+ * Function Name: ota_cbor_block_decode
+ *******************************************************************************
+ * Summary:
+ *  Decodes a block stream response in place. Every entry must appear once;
+ *  entries with other keys are skipped. The message must end with the map.
+ *
+ * Parameters:
+ *  msg - message buffer
+ *  size - message size
+ *  block - decoded block; its payload points into msg
+ *
+ * Return:
+ *  bool - true if the message was decoded
+ *
+ ******************************************************************************/
+bool ota_cbor_block_decode(const uint8_t *msg, size_t size, ota_cbor_block_t *block)
+{
+    reader_t r = { msg, msg + size };
+    uint8_t major;
+    uint64_t entries;
+    uint32_t seen = 0U;
+
+    if ((NULL == msg) || (NULL == block) ||
+        !read_head(&r, &major, &entries) || (CBOR_MAJOR_MAP != major) ||
+        (entries > BLOCK_MAP_ENTRIES_MAX))
+    {
+        return false;
+    }
+
+    for (uint32_t e = 0U; e < (uint32_t)entries; e++)
+    {
+        const uint8_t *key;
+        uint64_t len;
+        uint32_t bit;
+        bool ok;
+
+        if (!read_head(&r, &major, &len) || (CBOR_MAJOR_TEXT != major) ||
+            (NULL == (key = read_string(&r, len))))
+        {
+            return false;
+        }
+
+        if (1U != len)
+        {
+            if (!skip_item(&r))
+            {
+                return false;
+            }
+            continue;
+        }
+
+        switch (key[0])
+        {
+            case BLOCK_KEY_FILE_ID:
+                bit = 1U << 0;
+                ok = read_int32(&r, &block->file_id);
+                break;
+            case BLOCK_KEY_BLOCK_ID:
+                bit = 1U << 1;
+                ok = read_int32(&r, &block->block_id);
+                break;
+            case BLOCK_KEY_BLOCK_SIZE:
+                bit = 1U << 2;
+                ok = read_int32(&r, &block->block_size);
+                break;
+            case BLOCK_KEY_PAYLOAD:
+                bit = 1U << 3;
+                ok = read_head(&r, &major, &len) && (CBOR_MAJOR_BYTES == major) &&
+                     (NULL != (block->payload = read_string(&r, len)));
+                block->payload_size = (size_t)len;
+                break;
+            default:
+                bit = 0U;
+                ok = skip_item(&r);
+                break;
+        }
+
+        if (!ok || (0U != (seen & bit)))
+        {
+            return false;
+        }
+        seen |= bit;
+    }
+
+    return (BLOCK_SEEN_ALL == seen) && (r.pos == r.end);
+}
+
+#endif /* CY_OTA_ZERO_COPY */
+
+
+/* [] END OF FILE */
@@ -0,0 +1,633 @@
+/******************************************************************************
+* File Name: ota_dedup.c
+*
+* Description: This file reuses the chunks of the primary image that an OTA
+* image has in common with it. A file that carries a manifest of the chunks
+* of its image is prepared by copying the blocks made of known chunks from
+* the primary slot; the agent then requests only the other blocks. The chunk
+* boundaries depend on the content (gear hash), so that a change in the
+* image only changes the chunks around it.
+*
+* The file is the MCUboot image, followed by the manifest and by a footer
+* (little endian):
+*
+*   image       the MCUboot image, image_len bytes
+*   manifest    count entries: chunk length (4 bytes), truncated SHA-256 of
+*               the chunk (OTA_DEDUP_HASH_SIZE bytes)
+*   footer      "OTAD", version, mask bits, 2 reserved bytes, min and max
+*               chunk length, count, image_len (4 bytes each)
+*
+* MCUboot ignores the bytes past the TLVs of the image, and the signature of
+* the job covers the whole file, so the check of the file is unchanged.
+*
+* Related Document: See README.md
+*
+*******************************************************************************
+* (c) 2020, Cypress Semiconductor Corporation. All rights reserved.
+*******************************************************************************
+* This software, including source code, documentation and related materials
+* ("Software"), is owned by Cypress Semiconductor Corporation or one of its
+* subsidiaries ("Cypress") and is protected by and subject to worldwide patent
+* protection (United States and foreign), United States copyright laws and
+* international treaty provisions. Therefore, you may use this Software only
+* as provided in the license agreement accompanying the software package from
+* which you obtained this Software ("EULA").
+*
+* If no EULA applies, Cypress hereby grants you a personal, non-exclusive,
+* non-transferable license to copy, modify, and compile the Software source
+* code solely for use in connection with Cypress's integrated circuit products.
+* Any reproduction, modification, translation, compilation, or representation
+* of this Software except as specified above is prohibited without the express
+* written permission of Cypress.
+*
+* Disclaimer: THIS SOFTWARE IS PROVIDED AS-IS, WITH NO WARRANTY OF ANY KIND,
+* EXPRESS OR IMPLIED, INCLUDING, BUT NOT LIMITED TO, NONINFRINGEMENT, IMPLIED
+* WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE. Cypress
+* reserves the right to make changes to the Software without notice. Cypress
+* does not assume any liability arising out of the application or use of the
+* Software or any product or circuit described in the Software. Cypress does
+* not authorize its products for use in any products where a malfunction or
+* failure of the Cypress product may reasonably be expected to result in
+* significant property damage, injury or death ("High Risk Product"). By
+* including Cypress's product in a High Risk Product, the manufacturer of such
+* system or application assumes all risk of such use and in doing so agrees to
+* indemnify Cypress against all liability.
+*******************************************************************************/
+#include <string.h>
+#include <stdlib.h>
+#include "FreeRTOS.h"
+#include "task.h"
+#include "mbedtls/sha256.h"
+#include "bootutil/image.h"
+#include "sysflash/sysflash.h"
+#include "flash_map_backend/flash_map_backend.h"
+#include "aws_iot_ota_pal.h"
+#include "ota_block_size.h"
+#include "ota_dedup.h"
+
+#if defined(CY_OTA_DEDUP)
+
+/*******************************************************************************
+ * Macros
+ ******************************************************************************/
+#define DEDUP_GEAR_ENTRIES              (256U)
+#define DEDUP_NOT_FOUND                 (0xFFFFFFFFUL)
+#define DEDUP_SHA256_SIZE               (32U)
+#define BITS_PER_BYTE                   (8U)
+#define BITS_PER_WORD                   (32U)
+
+
+/*******************************************************************************
+ * Data structure and enumeration
+ ******************************************************************************/
+typedef struct
+{
+    uint8_t hash[OTA_DEDUP_HASH_SIZE];
+    uint32_t off;               /* Offset in the new image */
+    uint32_t len;
+    uint32_t src;               /* Offset in the primary image, or DEDUP_NOT_FOUND */
+} dedup_chunk_t;
+
+typedef struct
+{
+    uint32_t mask_bits;
+    uint32_t min_len;
+    uint32_t max_len;
+    uint32_t count;
+    uint32_t image_len;
+} dedup_footer_t;
+
+/* Work area of a file, allocated on the heap while it is prepared */
+typedef struct
+{
+    uint32_t gear[DEDUP_GEAR_ENTRIES];
+    uint8_t buffer[OTA_DEDUP_READ_SIZE];
+    mbedtls_sha256_context sha;
+} dedup_work_t;
+
+
+/*******************************************************************************
+ * Global variables
+ ******************************************************************************/
+static const uint8_t dedup_magic[4] = { 'O', 'T', 'A', 'D' };
+
+
+/*******************************************************************************
+ * Function Name: dedup_get32
+ *******************************************************************************
+ * Summary:
+ *  Reads a little-endian 32-bit field of the manifest.
+ *
+ ******************************************************************************/
+static uint32_t dedup_get32(const uint8_t *p)
+{
+    return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+
+/*******************************************************************************
+ * Function Name: dedup_gear_init
+ *******************************************************************************
+ * Summary:
+ *  Fills the gear table of the chunking with an xorshift sequence seeded
+ *  with OTA_DEDUP_GEAR_SEED, as the script does.
+ *
+ * Parameters:
+ *  gear - table to fill
+ *
+ ******************************************************************************/
+static void dedup_gear_init(uint32_t *gear)
+{
+    uint32_t x = OTA_DEDUP_GEAR_SEED;
+
+    for (uint32_t i = 0U; i < DEDUP_GEAR_ENTRIES; i++)
+    {
+        x ^= x << 13;
+        x ^= x >> 17;
+        x ^= x << 5;
+        gear[i] = x;
+    }
+}
+
+
+/*******************************************************************************
+ * Function Name: dedup_read_footer
+ *******************************************************************************
+ * Summary:
+ *  Fetches the footer of the file and checks that it describes a manifest
+ *  that this device can use.
+ *
+ * Parameters:
+ *  C - OTA file context
+ *  fetch - reads bytes of the file from the server
+ *  footer - set to the footer
+ *  stats - statistics, updated with the bytes fetched
+ *
+ * Return:
+ *  bool - true if the file carries a usable manifest
+ *
+ ******************************************************************************/
+static bool dedup_read_footer(const OTA_FileContext_t *C, ota_dedup_fetch_t fetch,
+                              dedup_footer_t *footer, ota_dedup_stats_t *stats)
+{
+    uint8_t raw[OTA_DEDUP_FOOTER_SIZE];
+
+    if (!fetch(C->ulFileSize - OTA_DEDUP_FOOTER_SIZE, raw, sizeof(raw)))
+    {
+        return false;
+    }
+
+    stats->fetched += sizeof(raw);
+
+    if ((0 != memcmp(raw, dedup_magic, sizeof(dedup_magic))) || (OTA_DEDUP_VERSION != raw[4]))
+    {
+        return false;
+    }
+
+    footer->mask_bits = raw[5];
+    footer->min_len = dedup_get32(&raw[8]);
+    footer->max_len = dedup_get32(&raw[12]);
+    footer->count = dedup_get32(&raw[16]);
+    footer->image_len = dedup_get32(&raw[20]);
+
+    if ((footer->mask_bits < OTA_DEDUP_MIN_MASK_BITS) || (footer->mask_bits > OTA_DEDUP_MAX_MASK_BITS) ||
+        (footer->min_len < OTA_DEDUP_MIN_CHUNK) || (footer->max_len > OTA_DEDUP_MAX_CHUNK) ||
+        (footer->min_len > footer->max_len) || (0U == footer->count))
+    {
+        return false;
+    }
+
+    if (footer->count > CY_OTA_DEDUP_MAX_CHUNKS)
+    {
+        configPRINTF(("OTA dedup: %lu chunks, over CY_OTA_DEDUP_MAX_CHUNKS\r\n",
+                      (unsigned long)footer->count));
+        return false;
+    }
+
+    /* The image, the manifest and the footer make up the whole file */
+    return ((uint64_t)footer->image_len + ((uint64_t)footer->count * OTA_DEDUP_ENTRY_SIZE) +
+            OTA_DEDUP_FOOTER_SIZE) == C->ulFileSize;
+}
+
+
+/*******************************************************************************
+ * Function Name: dedup_read_manifest
+ *******************************************************************************
+ * Summary:
+ *  Fetches the manifest of the file into the chunk table, and checks that
+ *  its chunks cover the image as the chunking would.
+ *
+ * Parameters:
+ *  fetch - reads bytes of the file from the server
+ *  footer - footer of the file
+ *  chunks - chunk table, footer->count entries
+ *  work - work area
+ *  stats - statistics, updated with the bytes fetched
+ *
+ * Return:
+ *  bool - true if the manifest is valid
+ *
+ ******************************************************************************/
+static bool dedup_read_manifest(ota_dedup_fetch_t fetch, const dedup_footer_t *footer,
+                                dedup_chunk_t *chunks, dedup_work_t *work, ota_dedup_stats_t *stats)
+{
+    uint32_t manifest_off = footer->image_len;
+    uint32_t manifest_len = footer->count * OTA_DEDUP_ENTRY_SIZE;
+    uint32_t image_off = 0U;
+    uint32_t index = 0U;
+
+    for (uint32_t done = 0U; done < manifest_len; )
+    {
+        uint32_t len = manifest_len - done;
+
+        if (len > OTA_DEDUP_READ_SIZE)
+        {
+            len = OTA_DEDUP_READ_SIZE;
+        }
+
+        if (!fetch(manifest_off + done, work->buffer, len))
+        {
+            return false;
+        }
+
+        stats->fetched += len;
+
+        for (uint32_t i = 0U; i < len; i += OTA_DEDUP_ENTRY_SIZE, index++)
+        {
+            dedup_chunk_t *chunk = &chunks[index];
+
+            chunk->len = dedup_get32(&work->buffer[i]);
+            memcpy(chunk->hash, &work->buffer[i + 4U], OTA_DEDUP_HASH_SIZE);
+            chunk->off = image_off;
+            chunk->src = DEDUP_NOT_FOUND;
+
+            /* Only the last chunk may be shorter than the minimum */
+            if ((0U == chunk->len) || (chunk->len > footer->max_len) ||
+                (chunk->len > (footer->image_len - image_off)) ||
+                ((chunk->len < footer->min_len) && ((index + 1U) < footer->count)))
+            {
+                return false;
+            }
+
+            image_off += chunk->len;
+        }
+
+        done += len;
+    }
+
+    return image_off == footer->image_len;
+}
+
+
+/*******************************************************************************
+ * Function Name: dedup_compare_hash
+ *******************************************************************************
+ * Summary:
+ *  Orders the chunk table by hash, for bsearch().
+ *
+ ******************************************************************************/
+static int dedup_compare_hash(const void *a, const void *b)
+{
+    return memcmp(((const dedup_chunk_t *)a)->hash, ((const dedup_chunk_t *)b)->hash, OTA_DEDUP_HASH_SIZE);
+}
+
+
+/*******************************************************************************
+ * Function Name: dedup_compare_off
+ *******************************************************************************
+ * Summary:
+ *  Orders the chunk table by offset in the new image.
+ *
+ ******************************************************************************/
+static int dedup_compare_off(const void *a, const void *b)
+{
+    uint32_t off_a = ((const dedup_chunk_t *)a)->off;
+    uint32_t off_b = ((const dedup_chunk_t *)b)->off;
+
+    return (off_a > off_b) - (off_a < off_b);
+}
+
+
+/*******************************************************************************
+ * Function Name: dedup_primary_len
+ *******************************************************************************
+ * Summary:
+ *  Returns the length of the image in the primary slot: header, image and
+ *  TLV areas.
+ *
+ * Parameters:
+ *  fa - primary slot
+ *
+ * Return:
+ *  uint32_t - length in bytes, 0 if the slot holds no valid image
+ *
+ ******************************************************************************/
+static uint32_t dedup_primary_len(const struct flash_area *fa)
+{
+    struct image_header hdr;
+    struct image_tlv_info info;
+    uint32_t off;
+
+    if ((0 != flash_area_read(fa, 0U, &hdr, sizeof(hdr))) || (IMAGE_MAGIC != hdr.ih_magic))
+    {
+        return 0U;
+    }
+
+    off = (uint32_t)hdr.ih_hdr_size + hdr.ih_img_size + hdr.ih_protect_tlv_size;
+
+    if ((off >= fa->fa_size) || ((fa->fa_size - off) < sizeof(info)) ||
+        (0 != flash_area_read(fa, off, &info, sizeof(info))) ||
+        (IMAGE_TLV_INFO_MAGIC != info.it_magic) || (info.it_tlv_tot > (fa->fa_size - off)))
+    {
+        return 0U;
+    }
+
+    return off + info.it_tlv_tot;
+}
+
+
+/*******************************************************************************
+ * Function Name: dedup_match
+ *******************************************************************************
+ * Summary:
+ *  Records a chunk of the primary image as the source of the chunks of the
+ *  new image with the same hash and length.
+ *
+ * Parameters:
+ *  chunks - chunk table, ordered by hash
+ *  count - number of chunks
+ *  digest - SHA-256 of the chunk of the primary image
+ *  off - offset of the chunk in the primary image
+ *  len - length of the chunk
+ *
+ ******************************************************************************/
+static void dedup_match(dedup_chunk_t *chunks, uint32_t count, const uint8_t *digest,
+                        uint32_t off, uint32_t len)
+{
+    dedup_chunk_t key;
+    dedup_chunk_t *found;
+
+    memcpy(key.hash, digest, OTA_DEDUP_HASH_SIZE);
+    found = bsearch(&key, chunks, count, sizeof(*chunks), dedup_compare_hash);
+
+    if (NULL == found)
+    {
+        return;
+    }
+
+    /* The same chunk may appear several times in the new image */
+    while ((found > chunks) && (0 == dedup_compare_hash(&found[-1], &key)))
+    {
+        found--;
+    }
+
+    for (; (found < &chunks[count]) && (0 == dedup_compare_hash(found, &key)); found++)
+    {
+        if ((found->len == len) && (DEDUP_NOT_FOUND == found->src))
+        {
+            found->src = off;
+        }
+    }
+}
+
+
+/*******************************************************************************
+ * Function Name: dedup_scan_primary
+ *******************************************************************************
+ * Summary:
+ *  Cuts the primary image into chunks as the script cut the new image, and
+ *  finds the chunks of the new image among them. A boundary follows a byte
+ *  once the chunk holds at least min_len bytes and the top mask_bits bits
+ *  of the gear hash are clear, or once it holds max_len bytes.
+ *
+ * Parameters:
+ *  fa - primary slot
+ *  len - length of the primary image
+ *  footer - footer of the file
+ *  chunks - chunk table, ordered by hash
+ *  work - work area
+ *
+ * Return:
+ *  bool - true if the whole image was read
+ *
+ ******************************************************************************/
+static bool dedup_scan_primary(const struct flash_area *fa, uint32_t len, const dedup_footer_t *footer,
+                               dedup_chunk_t *chunks, dedup_work_t *work)
+{
+    uint32_t mask = (uint32_t)(0xFFFFFFFFUL << (BITS_PER_WORD - footer->mask_bits));
+    uint32_t chunk_start = 0U;
+    uint32_t hash = 0U;
+    uint8_t digest[DEDUP_SHA256_SIZE];
+    bool ok;
+
+    mbedtls_sha256_init(&work->sha);
+    ok = (0 == mbedtls_sha256_starts_ret(&work->sha, 0));
+
+    for (uint32_t off = 0U; ok && (off < len); off += OTA_DEDUP_READ_SIZE)
+    {
+        uint32_t n = ((len - off) < OTA_DEDUP_READ_SIZE) ? (len - off) : OTA_DEDUP_READ_SIZE;
+        uint32_t piece = 0U;
+
+        if (0 != flash_area_read(fa, off, work->buffer, n))
+        {
+            ok = false;
+            break;
+        }
+
+        for (uint32_t i = 0U; ok && (i < n); i++)
+        {
+            uint32_t end = off + i + 1U;
+            uint32_t size = end - chunk_start;
+
+            hash = (hash << 1) + work->gear[work->buffer[i]];
+
+            if (((size >= footer->min_len) && (0U == (hash & mask))) ||
+                (size >= footer->max_len) || (end == len))
+            {
+                ok = (0 == mbedtls_sha256_update_ret(&work->sha, &work->buffer[piece], (i + 1U) - piece)) &&
+                     (0 == mbedtls_sha256_finish_ret(&work->sha, digest)) &&
+                     (0 == mbedtls_sha256_starts_ret(&work->sha, 0));
+
+                if (ok)
+                {
+                    dedup_match(chunks, footer->count, digest, chunk_start, size);
+                }
+
+                chunk_start = end;
+                hash = 0U;
+                piece = i + 1U;
+            }
+        }
+
+        if (ok && (piece < n))
+        {
+            ok = (0 == mbedtls_sha256_update_ret(&work->sha, &work->buffer[piece], n - piece));
+        }
+    }
+
+    mbedtls_sha256_free(&work->sha);
+
+    return ok;
+}
+
+
+/*******************************************************************************
+ * Function Name: dedup_copy_units
+ *******************************************************************************
+ * Summary:
+ *  Copies from the primary slot the blocks of the file made only of chunks
+ *  found there, and marks them received in the bitmap of the agent. The
+ *  last block of the file is left to the agent, so that it closes the file.
+ *
+ * Parameters:
+ *  C - OTA file context
+ *  fa - primary slot
+ *  footer - footer of the file
+ *  chunks - chunk table, ordered by offset
+ *  work - work area
+ *  stats - statistics, updated with the blocks copied
+ *
+ ******************************************************************************/
+static void dedup_copy_units(OTA_FileContext_t *C, const struct flash_area *fa,
+                             const dedup_footer_t *footer, const dedup_chunk_t *chunks,
+                             dedup_work_t *work, ota_dedup_stats_t *stats)
+{
+    uint32_t last_unit = (C->ulFileSize - 1U) / OTA_BLOCK_UNIT_SIZE;
+    uint32_t first = 0U;
+
+    for (uint32_t unit = 0U; unit < last_unit; unit++)
+    {
+        uint32_t unit_off = unit * OTA_BLOCK_UNIT_SIZE;
+        uint32_t unit_end = unit_off + OTA_BLOCK_UNIT_SIZE;
+        uint8_t mask = (uint8_t)(1U << (unit % BITS_PER_BYTE));
+        uint32_t pos = unit_off;
+
+        if (unit_end > footer->image_len)
+        {
+            break;
+        }
+
+        if (0U == (C->pucRxBlockBitmap[unit / BITS_PER_BYTE] & mask))
+        {
+            continue;
+        }
+
+        while ((chunks[first].off + chunks[first].len) <= unit_off)
+        {
+            first++;
+        }
+
+        /* The block is read piece by piece from the chunks that cover it */
+        for (uint32_t i = first; pos < unit_end; i++)
+        {
+            const dedup_chunk_t *chunk = &chunks[i];
+            uint32_t end = ((chunk->off + chunk->len) < unit_end) ? (chunk->off + chunk->len) : unit_end;
+
+            if ((DEDUP_NOT_FOUND == chunk->src) ||
+                (0 != flash_area_read(fa, chunk->src + (pos - chunk->off),
+                                      &work->buffer[pos - unit_off], end - pos)))
+            {
+                break;
+            }
+
+            pos = end;
+        }
+
+        if ((pos == unit_end) &&
+            (prvPAL_WriteBlock(C, unit_off, work->buffer, OTA_BLOCK_UNIT_SIZE) == (int16_t)OTA_BLOCK_UNIT_SIZE))
+        {
+            C->pucRxBlockBitmap[unit / BITS_PER_BYTE] &= (uint8_t)~mask;
+            C->ulBlocksRemaining--;
+            stats->units++;
+        }
+    }
+}
+
+
+/*******************************************************************************
+ * Function Name: ota_dedup_apply
+ *******************************************************************************
+ * Summary:
+ *  Prepares a file that carries a manifest: copies the blocks made of
+ *  chunks of the primary image and marks them received in the bitmap of the
+ *  agent, which requests the others. A file without a manifest is left as
+ *  it is. Must be called once the PAL has opened the file, before the first
+ *  block is requested.
+ *
+ * Parameters:
+ *  C - OTA file context
+ *  fetch - reads bytes of the file from the server
+ *  stats - set to the statistics of the preparation
+ *
+ ******************************************************************************/
+void ota_dedup_apply(OTA_FileContext_t *C, ota_dedup_fetch_t fetch, ota_dedup_stats_t *stats)
+{
+    const struct flash_area *fa = NULL;
+    dedup_footer_t footer;
+    dedup_chunk_t *chunks = NULL;
+    dedup_work_t *work = NULL;
+    uint32_t primary_len;
+    TickType_t start = xTaskGetTickCount();
+
+    memset(stats, 0, sizeof(*stats));
+
+    if ((C->ulFileSize <= (OTA_DEDUP_FOOTER_SIZE + OTA_BLOCK_UNIT_SIZE)) ||
+        !dedup_read_footer(C, fetch, &footer, stats))
+    {
+        return;
+    }
+
+    if (0 != flash_area_open(FLASH_AREA_IMAGE_PRIMARY(0), &fa))
+    {
+        return;
+    }
+
+    primary_len = dedup_primary_len(fa);
+    chunks = pvPortMalloc(footer.count * sizeof(*chunks));
+    work = pvPortMalloc(sizeof(*work));
+
+    if ((0U == primary_len) || (NULL == chunks) || (NULL == work))
+    {
+        configPRINTF(("OTA dedup: no primary image or no memory, downloading the whole file\r\n"));
+    }
+    else if (!dedup_read_manifest(fetch, &footer, chunks, work, stats))
+    {
+        configPRINTF(("OTA dedup: invalid manifest, downloading the whole file\r\n"));
+    }
+    else
+    {
+        stats->chunks = footer.count;
+
+        dedup_gear_init(work->gear);
+        qsort(chunks, footer.count, sizeof(*chunks), dedup_compare_hash);
+
+        if (dedup_scan_primary(fa, primary_len, &footer, chunks, work))
+        {
+            qsort(chunks, footer.count, sizeof(*chunks), dedup_compare_off);
+
+            for (uint32_t i = 0U; i < footer.count; i++)
+            {
+                stats->matched += (DEDUP_NOT_FOUND != chunks[i].src) ? 1U : 0U;
+            }
+
+            dedup_copy_units(C, fa, &footer, chunks, work, stats);
+        }
+
+        configPRINTF(("OTA dedup: %lu of %lu chunks in the primary image, %lu of %lu blocks copied "
+                      "in %lu ms, %lu bytes of manifest\r\n",
+                      (unsigned long)stats->matched, (unsigned long)stats->chunks,
+                      (unsigned long)stats->units,
+                      (unsigned long)((C->ulFileSize + OTA_BLOCK_UNIT_SIZE - 1U) / OTA_BLOCK_UNIT_SIZE),
+                      (unsigned long)((xTaskGetTickCount() - start) * portTICK_PERIOD_MS),
+                      (unsigned long)stats->fetched));
+    }
+
+    vPortFree(work);
+    vPortFree(chunks);
+    flash_area_close(fa);
+}
+
+#endif /* CY_OTA_DEDUP */
+
+
+/* [] END OF FILE */
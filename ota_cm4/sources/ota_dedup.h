@@ -0,0 +1,117 @@
+/******************************************************************************
+* File Name: ota_dedup.h
+*
+* Description: This file contains the macros, structures and function
+* declarations of the reuse of the chunks of the primary image that an OTA
+* image has in common with it.
+*
+* Related Document: See README.md
+*
+*******************************************************************************
+* (c) 2020, Cypress Semiconductor Corporation. All rights reserved.
+*******************************************************************************
+* This software, including source code, documentation and related materials
+* ("Software"), is owned by Cypress Semiconductor Corporation or one of its
+* subsidiaries ("Cypress") and is protected by and subject to worldwide patent
+* protection (United States and foreign), United States copyright laws and
+* international treaty provisions. Therefore, you may use this Software only
+* as provided in the license agreement accompanying the software package from
+* which you obtained this Software ("EULA").
+*
+* If no EULA applies, Cypress hereby grants you a personal, non-exclusive,
+* non-transferable license to copy, modify, and compile the Software source
+* code solely for use in connection with Cypress's integrated circuit products.
+* Any reproduction, modification, translation, compilation, or representation
+* of this Software except as specified above is prohibited without the express
+* written permission of Cypress.
+*
+* Disclaimer: THIS SOFTWARE IS PROVIDED AS-IS, WITH NO WARRANTY OF ANY KIND,
+* EXPRESS OR IMPLIED, INCLUDING, BUT NOT LIMITED TO, NONINFRINGEMENT, IMPLIED
+* WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE. Cypress
+* reserves the right to make changes to the Software without notice. Cypress
+* does not assume any liability arising out of the application or use of the
+* Software or any product or circuit described in the Software. Cypress does
+* not authorize its products for use in any products where a malfunction or
+* failure of the Cypress product may reasonably be expected to result in
+* significant property damage, injury or death ("High Risk Product"). By
+* including Cypress's product in a High Risk Product, the manufacturer of such
+* system or application assumes all risk of such use and in doing so agrees to
+* indemnify Cypress against all liability.
+*******************************************************************************/
+#ifndef OTA_DEDUP_H
+#define OTA_DEDUP_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "aws_iot_ota_agent.h"
+
+#if defined(CY_OTA_DEDUP) && !defined(CY_OTA_HTTP_STREAM)
+#error "CY_OTA_DEDUP fetches the manifest with the connections of ota_http_stream.c"
+#endif
+
+/*******************************************************************************
+ * Macros
+ ******************************************************************************/
+/* Most chunks of a manifest. Each one takes OTA_DEDUP_CHUNK_HEAP bytes of
+ * heap while the file is prepared.
+ */
+#ifndef CY_OTA_DEDUP_MAX_CHUNKS
+#define CY_OTA_DEDUP_MAX_CHUNKS             (1024U)
+#endif
+
+/* Footer at the end of a file that carries a manifest, and manifest entry:
+ * chunk length and the first OTA_DEDUP_HASH_SIZE bytes of its SHA-256.
+ * See scripts/ota_dedup_manifest.py, which appends them.
+ */
+#define OTA_DEDUP_FOOTER_SIZE               (24U)
+#define OTA_DEDUP_ENTRY_SIZE                (12U)
+#define OTA_DEDUP_HASH_SIZE                 (8U)
+#define OTA_DEDUP_VERSION                   (1U)
+
+/* Seed of the gear table of the chunking. It must match the script. */
+#define OTA_DEDUP_GEAR_SEED                 (0x4F544144UL)
+
+/* Bounds of the chunking parameters accepted from a footer */
+#define OTA_DEDUP_MIN_MASK_BITS             (6U)
+#define OTA_DEDUP_MAX_MASK_BITS             (20U)
+#define OTA_DEDUP_MIN_CHUNK                 (64U)
+#define OTA_DEDUP_MAX_CHUNK                 (65536U)
+
+/* Bytes of the slot read, and of the manifest fetched, at once */
+#define OTA_DEDUP_READ_SIZE                 (1536U)
+
+/* Heap of a chunk of the manifest */
+#define OTA_DEDUP_CHUNK_HEAP                (20U)
+
+#if (OTA_DEDUP_READ_SIZE % OTA_DEDUP_ENTRY_SIZE) != 0
+#error "OTA_DEDUP_READ_SIZE must be a multiple of OTA_DEDUP_ENTRY_SIZE"
+#endif
+
+
+/*******************************************************************************
+ * Data structure and enumeration
+ ******************************************************************************/
+/* Reads len bytes of the file at off from the server. Returns true if all
+ * of them were received.
+ */
+typedef bool (*ota_dedup_fetch_t)(uint32_t off, uint8_t *buffer, uint32_t len);
+
+typedef struct
+{
+    uint32_t chunks;            /* Chunks of the new image */
+    uint32_t matched;           /* ... found in the primary image */
+    uint32_t units;             /* Blocks of the agent copied from it */
+    uint32_t fetched;           /* Bytes of footer and manifest fetched */
+} ota_dedup_stats_t;
+
+
+/*******************************************************************************
+ * Function prototypes
+ ******************************************************************************/
+void ota_dedup_apply(OTA_FileContext_t *C, ota_dedup_fetch_t fetch, ota_dedup_stats_t *stats);
+
+
+#endif /* OTA_DEDUP_H */
+
+
+/* [] END OF FILE */
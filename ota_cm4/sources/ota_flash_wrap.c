@@ -0,0 +1,280 @@
+/******************************************************************************
+* File Name: ota_flash_wrap.c
+*
+* Description: This file contains the functions that interpose the flash map
+* backend in the OTA app with the -Wl,--wrap linker option (see
+* FLASH_AREA_WRAP_LDFLAGS in bootloader_cm0p/shared_config.mk). The writes
+* and erases of the secondary slot during a download go through the features
+* of the OTA app first: RAM staging (ota_ram_stage.c), write coalescing
+* (ota_write_coalesce.c), deferred erase (ota_flash_writer.c), and bounded
+* erase (ota_slot_erase.c). The rest goes through the trailer log and the slot
+* ring shared with the bootloader (bootloader_cm0p/flash_area_wrap.c).
+*
+* Related Document: See README.md
+*
+*******************************************************************************
+* (c) 2020, Cypress Semiconductor Corporation. All rights reserved.
+*******************************************************************************
+* This software, including source code, documentation and related materials
+* ("Software"), is owned by Cypress Semiconductor Corporation or one of its
+* subsidiaries ("Cypress") and is protected by and subject to worldwide patent
+* protection (United States and foreign), United States copyright laws and
+* international treaty provisions. Therefore, you may use this Software only
+* as provided in the license agreement accompanying the software package from
+* which you obtained this Software ("EULA").
+*
+* If no EULA applies, Cypress hereby grants you a personal, non-exclusive,
+* non-transferable license to copy, modify, and compile the Software source
+* code solely for use in connection with Cypress's integrated circuit products.
+* Any reproduction, modification, translation, compilation, or representation
+* of this Software except as specified above is prohibited without the express
+* written permission of Cypress.
+*
+* Disclaimer: THIS SOFTWARE IS PROVIDED AS-IS, WITH NO WARRANTY OF ANY KIND,
+* EXPRESS OR IMPLIED, INCLUDING, BUT NOT LIMITED TO, NONINFRINGEMENT, IMPLIED
+* WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE. Cypress
+* reserves the right to make changes to the Software without notice. Cypress
+* does not assume any liability arising out of the application or use of the
+* Software or any product or circuit described in the Software. Cypress does
+* not authorize its products for use in any products where a malfunction or
+* failure of the Cypress product may reasonably be expected to result in
+* significant property damage, injury or death ("High Risk Product"). By
+* including Cypress's product in a High Risk Product, the manufacturer of such
+* system or application assumes all risk of such use and in doing so agrees to
+* indemnify Cypress against all liability.
+*******************************************************************************/
+#include <stdbool.h>
+#include "flash_map_backend/flash_map_backend.h"
+#include "flash_area_wrap.h"
+#include "ota_flash_writer.h"
+#include "ota_slot_erase.h"
+#include "ota_stream_hash.h"
+#include "ota_write_coalesce.h"
+#include "ota_metrics.h"
+#include "ota_ram_stage.h"
+
+
+/*******************************************************************************
+ * Function prototypes
+ ******************************************************************************/
+int __wrap_flash_area_read(const struct flash_area *fa, uint32_t off,
+                           void *dst, uint32_t len);
+int __wrap_flash_area_write(const struct flash_area *fa, uint32_t off,
+                            const void *src, uint32_t len);
+int __wrap_flash_area_erase(const struct flash_area *fa, uint32_t off,
+                            uint32_t len);
+
+
+/*******************************************************************************
+ * Function Name: __wrap_flash_area_read
+ *******************************************************************************
+ * Summary:
+ *  Reads from a flash area. The reads of the secondary slot made by the
+ *  signature check of the PAL are skipped when the hash of the image is
+ *  already known (ota_stream_hash.c), and the writes of the secondary slot
+ *  still held for coalescing are programmed first (ota_write_coalesce.c).
+ *
+ * Parameters:
+ *  fa - flash area
+ *  off - offset within the flash area
+ *  dst - destination buffer
+ *  len - number of bytes to read
+ *
+ * Return:
+ *  int - 0 on success, non-zero otherwise
+ *
+ ******************************************************************************/
+int __wrap_flash_area_read(const struct flash_area *fa, uint32_t off,
+                           void *dst, uint32_t len)
+{
+#if defined(CY_OTA_STREAM_HASH)
+    if (ota_stream_hash_skips_read(fa))
+    {
+        return 0;
+    }
+#endif /* CY_OTA_STREAM_HASH */
+
+#if defined(CY_OTA_RAM_STAGE)
+    int stage_rc;
+
+    if (ota_ram_stage_read(fa, off, dst, len, &stage_rc))
+    {
+        return stage_rc;
+    }
+#endif /* CY_OTA_RAM_STAGE */
+
+#if defined(CY_OTA_WRITE_COALESCE)
+    if (0 != ota_write_coalesce_sync(fa, off, len))
+    {
+        return -1;
+    }
+#endif /* CY_OTA_WRITE_COALESCE */
+
+    return flash_area_wrap_read(fa, off, dst, len);
+}
+
+
+/*******************************************************************************
+ * Function Name: ota_flash_wrap_write
+ *******************************************************************************
+ * Summary:
+ *  Writes to a flash area. The writes of the secondary slot during a download
+ *  are staged in RAM (ota_ram_stage.c) or coalesced into whole program units
+ *  (ota_write_coalesce.c).
+ *
+ * Parameters:
+ *  fa - flash area
+ *  off - offset within the flash area
+ *  src - source buffer
+ *  len - number of bytes to write
+ *
+ * Return:
+ *  int - 0 on success, non-zero otherwise
+ *
+ ******************************************************************************/
+static int ota_flash_wrap_write(const struct flash_area *fa, uint32_t off,
+                                const void *src, uint32_t len)
+{
+#if defined(CY_OTA_RAM_STAGE)
+    bool staged = false;
+    int stage_rc = ota_ram_stage_intercept(fa, off, src, len, &staged);
+
+    if (staged)
+    {
+        return stage_rc;
+    }
+#endif /* CY_OTA_RAM_STAGE */
+
+#if defined(CY_OTA_WRITE_COALESCE)
+    bool coalesced = false;
+    int coalesce_rc = ota_write_coalesce_intercept(fa, off, src, len, &coalesced);
+
+    if (coalesced)
+    {
+        return coalesce_rc;
+    }
+#endif /* CY_OTA_WRITE_COALESCE */
+
+    return flash_area_wrap_write(fa, off, src, len);
+}
+
+
+/*******************************************************************************
+ * Function Name: __wrap_flash_area_write
+ *******************************************************************************
+ * Summary:
+ *  Writes to a flash area, see ota_flash_wrap_write(). The time taken is
+ *  added to the metrics of the download (ota_metrics.c).
+ *
+ * Parameters:
+ *  fa - flash area
+ *  off - offset within the flash area
+ *  src - source buffer
+ *  len - number of bytes to write
+ *
+ * Return:
+ *  int - 0 on success, non-zero otherwise
+ *
+ ******************************************************************************/
+int __wrap_flash_area_write(const struct flash_area *fa, uint32_t off,
+                            const void *src, uint32_t len)
+{
+#if defined(CY_OTA_METRICS)
+    int rc;
+
+    ota_metrics_flash_start(OTA_METRICS_FLASH_WRITE);
+    rc = ota_flash_wrap_write(fa, off, src, len);
+    ota_metrics_flash_end();
+
+    return rc;
+#else
+    return ota_flash_wrap_write(fa, off, src, len);
+#endif /* CY_OTA_METRICS */
+}
+
+
+/*******************************************************************************
+ * Function Name: ota_flash_wrap_erase
+ *******************************************************************************
+ * Summary:
+ *  Erases a range of a flash area. The writes held for coalescing in the
+ *  range are programmed first. The erase of the secondary slot at the start
+ *  of a download is left to the flash writer (ota_flash_writer.c), or bounded
+ *  to the file and skips blank sectors (ota_slot_erase.c).
+ *
+ * Parameters:
+ *  fa - flash area
+ *  off - offset within the flash area
+ *  len - length of the range
+ *
+ * Return:
+ *  int - 0 on success, non-zero otherwise
+ *
+ ******************************************************************************/
+static int ota_flash_wrap_erase(const struct flash_area *fa, uint32_t off,
+                                uint32_t len)
+{
+#if defined(CY_OTA_WRITE_COALESCE)
+    int sync_rc = ota_write_coalesce_sync(fa, off, len);
+
+    if (0 != sync_rc)
+    {
+        return sync_rc;
+    }
+#endif /* CY_OTA_WRITE_COALESCE */
+
+#if defined(CY_OTA_FLASH_WRITER)
+    if (ota_flash_writer_defer_erase(fa, off, len))
+    {
+        return 0;
+    }
+#endif /* CY_OTA_FLASH_WRITER */
+
+#if defined(CY_OTA_BOUNDED_ERASE)
+    bool prepared = false;
+    int prepare_rc = ota_slot_erase_intercept(fa, off, len, &prepared);
+
+    if (prepared)
+    {
+        return prepare_rc;
+    }
+#endif /* CY_OTA_BOUNDED_ERASE */
+
+    return flash_area_wrap_erase(fa, off, len);
+}
+
+
+/*******************************************************************************
+ * Function Name: __wrap_flash_area_erase
+ *******************************************************************************
+ * Summary:
+ *  Erases a range of a flash area, see ota_flash_wrap_erase(). The time taken
+ *  is added to the metrics of the download (ota_metrics.c).
+ *
+ * Parameters:
+ *  fa - flash area
+ *  off - offset within the flash area
+ *  len - length of the range
+ *
+ * Return:
+ *  int - 0 on success, non-zero otherwise
+ *
+ ******************************************************************************/
+int __wrap_flash_area_erase(const struct flash_area *fa, uint32_t off,
+                            uint32_t len)
+{
+#if defined(CY_OTA_METRICS)
+    int rc;
+
+    ota_metrics_flash_start(OTA_METRICS_FLASH_ERASE);
+    rc = ota_flash_wrap_erase(fa, off, len);
+    ota_metrics_flash_end();
+
+    return rc;
+#else
+    return ota_flash_wrap_erase(fa, off, len);
+#endif /* CY_OTA_METRICS */
+}
+
+
+/* [] END OF FILE */
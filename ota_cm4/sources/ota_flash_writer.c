@@ -0,0 +1,578 @@
+/******************************************************************************
+* File Name: ota_flash_writer.c
+*
+* Description: This file contains the task that writes the OTA blocks to flash
+* behind the network.
+*
+* The OTA PAL programs every block on the task that received it, and erases
+* the whole secondary slot when the file is opened: on the external flash,
+* several 256 KB sectors, each of which blocks the OTA agent for a long time.
+* Here, a block write only copies the block to one of
+* CY_OTA_FLASH_WRITER_BUFFERS buffers and queues it for the writer task. When
+* no buffer is free, the write waits until the writer catches up.
+*
+* The erase of the secondary slot in the external flash is not done when the
+* file is opened. The writer erases each sector before the first write into
+* it, and, whenever its queue is empty, the next sector from the write cursor
+* on. The sectors left when the file is closed are erased then, so the whole
+* slot is erased as before. With the bounded erase (ota_slot_erase.c), the
+* sectors past the file and the sectors already blank are skipped.
+*
+* Related Document: See README.md
+*
+*******************************************************************************
+* (c) 2020, Cypress Semiconductor Corporation. All rights reserved.
+*******************************************************************************
+* This software, including source code, documentation and related materials
+* ("Software"), is owned by Cypress Semiconductor Corporation or one of its
+* subsidiaries ("Cypress") and is protected by and subject to worldwide patent
+* protection (United States and foreign), United States copyright laws and
+* international treaty provisions. Therefore, you may use this Software only
+* as provided in the license agreement accompanying the software package from
+* which you obtained this Software ("EULA").
+*
+* If no EULA applies, Cypress hereby grants you a personal, non-exclusive,
+* non-transferable license to copy, modify, and compile the Software source
+* code solely for use in connection with Cypress's integrated circuit products.
+* Any reproduction, modification, translation, compilation, or representation
+* of this Software except as specified above is prohibited without the express
+* written permission of Cypress.
+*
+* Disclaimer: THIS SOFTWARE IS PROVIDED AS-IS, WITH NO WARRANTY OF ANY KIND,
+* EXPRESS OR IMPLIED, INCLUDING, BUT NOT LIMITED TO, NONINFRINGEMENT, IMPLIED
+* WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE. Cypress
+* reserves the right to make changes to the Software without notice. Cypress
+* does not assume any liability arising out of the application or use of the
+* Software or any product or circuit described in the Software. Cypress does
+* not authorize its products for use in any products where a malfunction or
+* failure of the Cypress product may reasonably be expected to result in
+* significant property damage, injury or death ("High Risk Product"). By
+* including Cypress's product in a High Risk Product, the manufacturer of such
+* system or application assumes all risk of such use and in doing so agrees to
+* indemnify Cypress against all liability.
+*******************************************************************************/
+#include <string.h>
+#include "FreeRTOS.h"
+#include "task.h"
+#include "queue.h"
+#include "semphr.h"
+#include "platform/iot_threads.h"
+
+#ifdef CY_BOOT_USE_EXTERNAL_FLASH
+#include "flash_qspi.h"
+#endif
+
+#include "sysflash/sysflash.h"
+#include "aws_iot_ota_pal.h"
+#include "aws_ota_agent_config.h"
+#include "ota_flash_writer.h"
+#include "ota_slot_erase.h"
+#include "ota_stream_hash.h"
+#include "ota_resume.h"
+#include "ota_metrics.h"
+
+#if defined(CY_OTA_FLASH_WRITER)
+
+/*******************************************************************************
+ * Macros
+ ******************************************************************************/
+#define BITS_PER_BYTE                   (8U)
+
+/* Commands queued in place of a buffer index */
+#define WRITER_CMD_KICK                 (0xfdU)   /* Start erasing ahead */
+#define WRITER_CMD_FLUSH                (0xfeU)   /* Drop the erases left */
+#define WRITER_CMD_FLUSH_ERASE          (0xffU)   /* Complete the erases left */
+
+/* Work queue: all the buffers and one command */
+#define WRITER_QUEUE_LENGTH             (CY_OTA_FLASH_WRITER_BUFFERS + 1U)
+
+
+/*******************************************************************************
+ * Data structure and enumeration
+ ******************************************************************************/
+typedef struct
+{
+    OTA_FileContext_t *C;
+    uint32_t off;                   /* File offset */
+    uint16_t len;
+    uint8_t buffer;                 /* Buffer index or WRITER_CMD_ */
+} writer_item_t;
+
+
+/*******************************************************************************
+ * Function prototypes
+ ******************************************************************************/
+int16_t __real_prvPAL_WriteBlock(OTA_FileContext_t * const C, uint32_t ulOffset,
+                                 uint8_t * const pacData, uint32_t ulBlockSize);
+
+static void writer_task(void *arg);
+
+
+/*******************************************************************************
+ * Global variables
+ ******************************************************************************/
+static bool writer_started = false;
+static uint8_t writer_buffers[CY_OTA_FLASH_WRITER_BUFFERS][OTA_FLASH_WRITER_BUFFER_SIZE];
+
+static QueueHandle_t work_queue;
+static StaticQueue_t work_queue_buffer;
+static uint8_t work_queue_storage[WRITER_QUEUE_LENGTH * sizeof(writer_item_t)];
+
+static QueueHandle_t free_queue;
+static StaticQueue_t free_queue_buffer;
+static uint8_t free_queue_storage[CY_OTA_FLASH_WRITER_BUFFERS];
+
+static SemaphoreHandle_t flush_done;
+static StaticSemaphore_t flush_done_buffer;
+
+/* Set by the first write that fails, until the next file */
+static volatile bool writer_failed;
+
+/* Deferred erase. Set in the agent task while the file is opened, then only
+ * used by the writer task.
+ */
+static bool erase_armed;
+static const struct flash_area *erase_fa;
+static uint32_t erase_off;              /* Offset of the first sector */
+static uint32_t erase_size;             /* Sector size of the device */
+static uint32_t erase_sectors;          /* Sectors in the deferred range */
+static uint32_t erase_left;             /* Sectors not erased yet */
+static uint8_t *erase_done;             /* Bitmap of the erased sectors */
+static uint32_t write_cursor;           /* End of the last write */
+
+/* Statistics of the transfer. The writes may come from several tasks: the
+ * counters they update are changed in a critical section.
+ */
+static uint32_t stat_writes;
+static uint32_t stat_erases_ahead;      /* Erased with an empty queue */
+static uint32_t stat_erases_inline;     /* Erased for a queued write */
+static uint32_t stat_max_queued;
+static TickType_t stat_stall_ticks;     /* Writes waiting for a buffer */
+
+
+/*******************************************************************************
+ * Function definitions
+ ******************************************************************************/
+
+/*******************************************************************************
+ * Function Name: erase_sector
+ *******************************************************************************
+ * Summary:
+ *  Erases one sector of the deferred range, if not erased yet. With the
+ *  bounded erase, a sector past the file or already blank is not erased.
+ *
+ * Parameters:
+ *  sector - sector index in the deferred range
+ *
+ * Return:
+ *  bool - true on success
+ *
+ ******************************************************************************/
+static bool erase_sector(uint32_t sector)
+{
+    if ((sector >= erase_sectors) ||
+        ((erase_done[sector / BITS_PER_BYTE] & (1U << (sector % BITS_PER_BYTE))) != 0U))
+    {
+        return true;
+    }
+
+    erase_done[sector / BITS_PER_BYTE] |= (uint8_t)(1U << (sector % BITS_PER_BYTE));
+    erase_left--;
+
+#if defined(CY_OTA_BOUNDED_ERASE)
+    return (0 == ota_slot_erase_range(erase_fa, erase_off + (sector * erase_size), erase_size));
+#else
+    return (0 == flash_area_erase(erase_fa, erase_off + (sector * erase_size), erase_size));
+#endif
+}
+
+
+/*******************************************************************************
+ * Function Name: erase_for_write
+ *******************************************************************************
+ * Summary:
+ *  Erases the sectors of the deferred range that a write lands in.
+ *
+ * Parameters:
+ *  off - file offset of the write
+ *  len - length of the write
+ *
+ * Return:
+ *  bool - true on success
+ *
+ ******************************************************************************/
+static bool erase_for_write(uint32_t off, uint32_t len)
+{
+    uint32_t left = erase_left;
+    uint32_t first;
+    uint32_t last;
+    bool ok = true;
+
+    if ((0U == erase_left) || ((off + len) <= erase_off))
+    {
+        return true;
+    }
+
+    first = (off > erase_off) ? ((off - erase_off) / erase_size) : 0U;
+    last = (off + len - 1U - erase_off) / erase_size;
+
+    for (uint32_t sector = first; ok && (sector <= last); sector++)
+    {
+        ok = erase_sector(sector);
+    }
+
+    stat_erases_inline += left - erase_left;
+
+    return ok;
+}
+
+
+/*******************************************************************************
+ * Function Name: erase_ahead
+ *******************************************************************************
+ * Summary:
+ *  Erases the next sector of the deferred range from the write cursor on,
+ *  or the first one left before it.
+ *
+ * Return:
+ *  bool - true on success
+ *
+ ******************************************************************************/
+static bool erase_ahead(void)
+{
+    uint32_t first = (write_cursor > erase_off) ?
+                     ((write_cursor - erase_off) / erase_size) : 0U;
+
+    for (uint32_t i = 0U; i < erase_sectors; i++)
+    {
+        uint32_t sector = (first + i) % erase_sectors;
+
+        if ((erase_done[sector / BITS_PER_BYTE] & (1U << (sector % BITS_PER_BYTE))) == 0U)
+        {
+            stat_erases_ahead++;
+            return erase_sector(sector);
+        }
+    }
+
+    return true;
+}
+
+
+/*******************************************************************************
+ * Function Name: writer_task
+ *******************************************************************************
+ * Summary:
+ *  Writes the queued blocks in order, and erases ahead while the queue is
+ *  empty. Each block written is added to the hash of the file, to the
+ *  resume checkpoints and to the metrics.
+ *
+ * Parameters:
+ *  arg - unused
+ *
+ ******************************************************************************/
+static void writer_task(void *arg)
+{
+    writer_item_t item;
+
+    (void)arg;
+
+    while (true)
+    {
+        TickType_t wait = (erase_left > 0U) ? 0U : portMAX_DELAY;
+
+        if (pdTRUE != xQueueReceive(work_queue, &item, wait))
+        {
+            if (!erase_ahead())
+            {
+                writer_failed = true;
+            }
+
+            continue;
+        }
+
+        if (WRITER_CMD_KICK == item.buffer)
+        {
+            continue;
+        }
+
+        if ((WRITER_CMD_FLUSH == item.buffer) || (WRITER_CMD_FLUSH_ERASE == item.buffer))
+        {
+            while ((WRITER_CMD_FLUSH_ERASE == item.buffer) && (erase_left > 0U))
+            {
+                if (!erase_ahead())
+                {
+                    writer_failed = true;
+                }
+            }
+
+            erase_left = 0U;
+            (void)xSemaphoreGive(flush_done);
+            continue;
+        }
+
+        if (!writer_failed)
+        {
+            if (!erase_for_write(item.off, item.len) ||
+                (__real_prvPAL_WriteBlock(item.C, item.off, writer_buffers[item.buffer],
+                                          item.len) != (int16_t)item.len))
+            {
+                writer_failed = true;
+            }
+            else
+            {
+#if defined(CY_OTA_STREAM_HASH)
+                ota_stream_hash_update(item.off, writer_buffers[item.buffer], item.len);
+#endif
+#if defined(CY_OTA_RESUME)
+                ota_resume_written(item.off, item.len);
+#endif
+#if defined(CY_OTA_METRICS)
+                ota_metrics_written(item.off, item.len);
+#endif
+            }
+        }
+
+        write_cursor = item.off + item.len;
+        (void)xQueueSend(free_queue, &item.buffer, 0);
+    }
+}
+
+
+/*******************************************************************************
+ * Function Name: ota_flash_writer_begin
+ *******************************************************************************
+ * Summary:
+ *  Prepares the writer for a new file and starts its task on the first call.
+ *  Must be called before the PAL opens the file: its erase of the secondary
+ *  slot is deferred until ota_flash_writer_end_open().
+ *
+ ******************************************************************************/
+void ota_flash_writer_begin(void)
+{
+    if (!writer_started)
+    {
+        work_queue = xQueueCreateStatic(WRITER_QUEUE_LENGTH, sizeof(writer_item_t),
+                                        work_queue_storage, &work_queue_buffer);
+        free_queue = xQueueCreateStatic(CY_OTA_FLASH_WRITER_BUFFERS, sizeof(uint8_t),
+                                        free_queue_storage, &free_queue_buffer);
+        flush_done = xSemaphoreCreateBinaryStatic(&flush_done_buffer);
+
+        for (uint8_t i = 0U; i < CY_OTA_FLASH_WRITER_BUFFERS; i++)
+        {
+            (void)xQueueSend(free_queue, &i, 0);
+        }
+
+        writer_started = Iot_CreateDetachedThread(writer_task, NULL, OTA_FLASH_WRITER_PRIORITY,
+                                                  OTA_FLASH_WRITER_STACK_SIZE);
+    }
+
+    vPortFree(erase_done);
+    erase_done = NULL;
+    erase_sectors = 0U;
+    erase_left = 0U;
+    write_cursor = 0U;
+    writer_failed = false;
+
+    stat_writes = 0U;
+    stat_erases_ahead = 0U;
+    stat_erases_inline = 0U;
+    stat_max_queued = 0U;
+    stat_stall_ticks = 0U;
+
+    erase_armed = writer_started;
+}
+
+
+/*******************************************************************************
+ * Function Name: ota_flash_writer_end_open
+ *******************************************************************************
+ * Summary:
+ *  Ends the deferral of erases and lets the writer erase ahead.
+ *
+ ******************************************************************************/
+void ota_flash_writer_end_open(void)
+{
+    writer_item_t item = { 0 };
+
+    erase_armed = false;
+
+    if (erase_left > 0U)
+    {
+        item.buffer = WRITER_CMD_KICK;
+        (void)xQueueSend(work_queue, &item, portMAX_DELAY);
+    }
+}
+
+
+/*******************************************************************************
+ * Function Name: ota_flash_writer_defer_erase
+ *******************************************************************************
+ * Summary:
+ *  Called for every erase. While the PAL opens the file, the erase of the
+ *  secondary slot in the external flash is recorded for the writer instead
+ *  of being done.
+ *
+ * Parameters:
+ *  fa - flash area
+ *  off - offset within the flash area
+ *  len - length of the range
+ *
+ * Return:
+ *  bool - true if the erase is deferred
+ *
+ ******************************************************************************/
+bool ota_flash_writer_defer_erase(const struct flash_area *fa, uint32_t off, uint32_t len)
+{
+#ifdef CY_BOOT_USE_EXTERNAL_FLASH
+    uint32_t size = qspi_get_erase_size();
+    uint32_t sectors;
+
+    if (!erase_armed || (0U != erase_sectors) ||
+        ((fa->fa_device_id & FLASH_DEVICE_EXTERNAL_FLAG) == 0U) ||
+        (FLASH_AREA_IMAGE_SECONDARY(0) != fa->fa_id) ||
+        ((off % size) != 0U) || ((len % size) != 0U))
+    {
+        return false;
+    }
+
+    sectors = len / size;
+    erase_done = pvPortMalloc((sectors + BITS_PER_BYTE - 1U) / BITS_PER_BYTE);
+
+    if (NULL == erase_done)
+    {
+        return false;
+    }
+
+    memset(erase_done, 0, (sectors + BITS_PER_BYTE - 1U) / BITS_PER_BYTE);
+    erase_fa = fa;
+    erase_off = off;
+    erase_size = size;
+    erase_sectors = sectors;
+    erase_left = sectors;
+
+    return true;
+#else
+    (void)fa;
+    (void)off;
+    (void)len;
+
+    return false;
+#endif /* CY_BOOT_USE_EXTERNAL_FLASH */
+}
+
+
+/*******************************************************************************
+ * Function Name: ota_flash_writer_write
+ *******************************************************************************
+ * Summary:
+ *  Queues a block for the writer task. Waits for a free buffer when the
+ *  writer is behind. May be called from any task.
+ *
+ * Parameters:
+ *  C - OTA file context
+ *  off - file offset of the block
+ *  data - block data
+ *  len - block size
+ *
+ * Return:
+ *  int16_t - len, or -1 when the block cannot be queued or an earlier write
+ *  failed
+ *
+ ******************************************************************************/
+int16_t ota_flash_writer_write(OTA_FileContext_t *C, uint32_t off, const uint8_t *data, uint32_t len)
+{
+    uint32_t done = 0U;
+
+    if (!writer_started)
+    {
+        return __real_prvPAL_WriteBlock(C, off, (uint8_t *)data, len);
+    }
+
+    while (done < len)
+    {
+        writer_item_t item;
+        TickType_t start = xTaskGetTickCount();
+        TickType_t stall;
+        uint32_t queued;
+
+        if (writer_failed ||
+            (pdTRUE != xQueueReceive(free_queue, &item.buffer,
+                                     pdMS_TO_TICKS(OTA_FLASH_WRITER_TIMEOUT_MS))))
+        {
+            return -1;
+        }
+
+        stall = xTaskGetTickCount() - start;
+
+        item.C = C;
+        item.off = off + done;
+        item.len = (uint16_t)(((len - done) > OTA_FLASH_WRITER_BUFFER_SIZE) ?
+                              OTA_FLASH_WRITER_BUFFER_SIZE : (len - done));
+        memcpy(writer_buffers[item.buffer], &data[done], item.len);
+
+        (void)xQueueSend(work_queue, &item, portMAX_DELAY);
+
+        queued = (uint32_t)uxQueueMessagesWaiting(work_queue);
+
+        taskENTER_CRITICAL();
+        if (queued > stat_max_queued)
+        {
+            stat_max_queued = queued;
+        }
+        stat_stall_ticks += stall;
+        stat_writes++;
+        taskEXIT_CRITICAL();
+
+        done += item.len;
+    }
+
+    return (int16_t)len;
+}
+
+
+/*******************************************************************************
+ * Function Name: ota_flash_writer_flush
+ *******************************************************************************
+ * Summary:
+ *  Waits until every queued block is written and prints the statistics of
+ *  the transfer. Must be called before the PAL closes or aborts the file.
+ *
+ * Parameters:
+ *  complete_erase - true to erase the sectors of the slot left, false to
+ *  drop them
+ *
+ * Return:
+ *  bool - true if every block was written
+ *
+ ******************************************************************************/
+bool ota_flash_writer_flush(bool complete_erase)
+{
+    writer_item_t item = { 0 };
+
+    if (!writer_started)
+    {
+        return true;
+    }
+
+    item.buffer = complete_erase ? WRITER_CMD_FLUSH_ERASE : WRITER_CMD_FLUSH;
+    (void)xQueueSend(work_queue, &item, portMAX_DELAY);
+    (void)xSemaphoreTake(flush_done, portMAX_DELAY);
+
+    configPRINTF(("OTA flash writer: %u writes, %u sectors erased ahead, %u on demand, "
+                  "queue up to %u, writes waited %u ms%s\r\n",
+                  (unsigned int)stat_writes, (unsigned int)stat_erases_ahead,
+                  (unsigned int)stat_erases_inline, (unsigned int)stat_max_queued,
+                  (unsigned int)(stat_stall_ticks * portTICK_PERIOD_MS),
+                  writer_failed ? ", FAILED" : ""));
+
+    vPortFree(erase_done);
+    erase_done = NULL;
+    erase_sectors = 0U;
+
+    return !writer_failed;
+}
+
+#endif /* CY_OTA_FLASH_WRITER */
+
+
+/* [] END OF FILE */
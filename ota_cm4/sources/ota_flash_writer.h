@@ -0,0 +1,92 @@
+/******************************************************************************
+* File Name: ota_flash_writer.h
+*
+* Description: This file contains the macros and function declarations of the
+* task that writes the OTA blocks to flash behind the network.
+*
+* Related Document: See README.md
+*
+*******************************************************************************
+* (c) 2020, Cypress Semiconductor Corporation. All rights reserved.
+*******************************************************************************
+* This software, including source code, documentation and related materials
+* ("Software"), is owned by Cypress Semiconductor Corporation or one of its
+* subsidiaries ("Cypress") and is protected by and subject to worldwide patent
+* protection (United States and foreign), United States copyright laws and
+* international treaty provisions. Therefore, you may use this Software only
+* as provided in the license agreement accompanying the software package from
+* which you obtained this Software ("EULA").
+*
+* If no EULA applies, Cypress hereby grants you a personal, non-exclusive,
+* non-transferable license to copy, modify, and compile the Software source
+* code solely for use in connection with Cypress's integrated circuit products.
+* Any reproduction, modification, translation, compilation, or representation
+* of this Software except as specified above is prohibited without the express
+* written permission of Cypress.
+*
+* Disclaimer: THIS SOFTWARE IS PROVIDED AS-IS, WITH NO WARRANTY OF ANY KIND,
+* EXPRESS OR IMPLIED, INCLUDING, BUT NOT LIMITED TO, NONINFRINGEMENT, IMPLIED
+* WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE. Cypress
+* reserves the right to make changes to the Software without notice. Cypress
+* does not assume any liability arising out of the application or use of the
+* Software or any product or circuit described in the Software. Cypress does
+* not authorize its products for use in any products where a malfunction or
+* failure of the Cypress product may reasonably be expected to result in
+* significant property damage, injury or death ("High Risk Product"). By
+* including Cypress's product in a High Risk Product, the manufacturer of such
+* system or application assumes all risk of such use and in doing so agrees to
+* indemnify Cypress against all liability.
+*******************************************************************************/
+#ifndef OTA_FLASH_WRITER_H
+#define OTA_FLASH_WRITER_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "flash_map_backend/flash_map_backend.h"
+#include "aws_iot_ota_agent.h"
+
+
+/*******************************************************************************
+ * Macros
+ ******************************************************************************/
+/* Number of write buffers, and the size of each. A write larger than one
+ * buffer takes several.
+ */
+#ifndef CY_OTA_FLASH_WRITER_BUFFERS
+#define CY_OTA_FLASH_WRITER_BUFFERS         (8U)
+#endif
+#define OTA_FLASH_WRITER_BUFFER_SIZE        (1536U)
+
+/* Longest wait for a free buffer before a write fails. It covers the erase
+ * of one sector of the external flash.
+ */
+#define OTA_FLASH_WRITER_TIMEOUT_MS         (10000U)
+
+/* Task of the writer */
+#define OTA_FLASH_WRITER_STACK_SIZE         (configMINIMAL_STACK_SIZE * 4)
+#define OTA_FLASH_WRITER_PRIORITY           (otaconfigAGENT_PRIORITY)
+
+/* A write returns once the block is copied to a buffer, before it is
+ * programmed. With the zero copy of the block stream, the agent would then
+ * release its message buffer before the write completes, and the block would
+ * be copied anyway.
+ */
+#if defined(CY_OTA_FLASH_WRITER) && defined(CY_OTA_ZERO_COPY)
+#error "CY_OTA_FLASH_WRITER and CY_OTA_ZERO_COPY cannot be used together"
+#endif
+
+
+/*******************************************************************************
+ * Function prototypes
+ ******************************************************************************/
+void ota_flash_writer_begin(void);
+void ota_flash_writer_end_open(void);
+bool ota_flash_writer_defer_erase(const struct flash_area *fa, uint32_t off, uint32_t len);
+int16_t ota_flash_writer_write(OTA_FileContext_t *C, uint32_t off, const uint8_t *data, uint32_t len);
+bool ota_flash_writer_flush(bool complete_erase);
+
+
+#endif /* OTA_FLASH_WRITER_H */
+
+
+/* [] END OF FILE */
@@ -0,0 +1,1458 @@
+/******************************************************************************
+* File Name: ota_http_stream.c
+*
+* Description: This file contains the functions that download OTA images over
+* HTTP in large byte ranges on up to CY_OTA_HTTP_CONNECTIONS persistent HTTPS
+* connections in parallel.
+*
+* The HTTP data interface of the OTA agent opens a connection for the file
+* and then requests one block of (1 << otaconfigLOG2_FILE_BLOCK_SIZE) bytes
+* per round trip. One TCP connection with the small TCP_WND of lwipopts.h
+* cannot fill a link with a long round trip either. Here, each connection to
+* the server of the pre-signed URL has its own task and stays open (HTTP/1.1
+* keep-alive) for the whole transfer. The requests of the agent hand ranges
+* of up to CY_OTA_HTTP_RANGE_SIZE bytes of missing units to the idle
+* connections. Each connection writes its response body to its own offset in
+* flash as it arrives, through a buffer of OTA_HTTP_BUFFER_SIZE bytes.
+*
+* Only the agent task changes the block bitmap of the agent: when a range
+* ends, the units written are marked as received at the next request, and
+* the last unit of the range is handed to the agent as a received block, so
+* that the agent keeps its own accounting and closes the file on the last
+* one. The units of a failed range are requested again, on any connection; a
+* connection is opened again when the server closes it or a range fails.
+* When no connection can be opened, the HTTP interface of the agent is used.
+*
+* The HTTP data interface of the agent is interposed with the -Wl,--wrap
+* linker option.
+*
+* Related Document: See README.md
+*
+*******************************************************************************
+* (c) 2020, Cypress Semiconductor Corporation. All rights reserved.
+*******************************************************************************
+* This software, including source code, documentation and related materials
+* ("Software"), is owned by Cypress Semiconductor Corporation or one of its
+* subsidiaries ("Cypress") and is protected by and subject to worldwide patent
+* protection (United States and foreign), United States copyright laws and
+* international treaty provisions. Therefore, you may use this Software only
+* as provided in the license agreement accompanying the software package from
+* which you obtained this Software ("EULA").
+*
+* If no EULA applies, Cypress hereby grants you a personal, non-exclusive,
+* non-transferable license to copy, modify, and compile the Software source
+* code solely for use in connection with Cypress's integrated circuit products.
+* Any reproduction, modification, translation, compilation, or representation
+* of this Software except as specified above is prohibited without the express
+* written permission of Cypress.
+*
+* Disclaimer: THIS SOFTWARE IS PROVIDED AS-IS, WITH NO WARRANTY OF ANY KIND,
+* EXPRESS OR IMPLIED, INCLUDING, BUT NOT LIMITED TO, NONINFRINGEMENT, IMPLIED
+* WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE. Cypress
+* reserves the right to make changes to the Software without notice. Cypress
+* does not assume any liability arising out of the application or use of the
+* Software or any product or circuit described in the Software. Cypress does
+* not authorize its products for use in any products where a malfunction or
+* failure of the Cypress product may reasonably be expected to result in
+* significant property damage, injury or death ("High Risk Product"). By
+* including Cypress's product in a High Risk Product, the manufacturer of such
+* system or application assumes all risk of such use and in doing so agrees to
+* indemnify Cypress against all liability.
+*******************************************************************************/
+#include <string.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include "FreeRTOS.h"
+#include "task.h"
+#include "semphr.h"
+#include "platform/iot_threads.h"
+#include "iot_secure_sockets.h"
+#include "aws_secure_sockets_config.h"
+#include "aws_iot_ota_pal.h"
+#include "aws_iot_ota_agent_internal.h"
+#include "ota_block_size.h"
+#include "ota_http_stream.h"
+#include "ota_metrics.h"
+#include "ota_peer.h"
+#include "ota_dedup.h"
+#include "ota_multicast.h"
+
+#if defined(CY_OTA_HTTP_STREAM)
+
+/*******************************************************************************
+ * Macros
+ ******************************************************************************/
+#define BITS_PER_BYTE                   (8U)
+
+#define HTTP_STATUS_PARTIAL_CONTENT     (206)
+#define HTTP_URL_SCHEME                 "https://"
+#define HTTP_HEADER_END                 "\r\n\r\n"
+
+/* Polling period while waiting for the connection tasks to stop */
+#define HTTP_STOP_POLL_MS               (50U)
+
+
+/*******************************************************************************
+ * Data structure and enumeration
+ ******************************************************************************/
+typedef enum
+{
+    HTTP_CONN_STOPPED = 0,      /* No task */
+    HTTP_CONN_IDLE,             /* Waiting for a range */
+    HTTP_CONN_BUSY,             /* Downloading a range */
+    HTTP_CONN_DONE,             /* Range received, not collected yet */
+    HTTP_CONN_FAILED            /* Range failed, not collected yet */
+} http_conn_state_t;
+
+typedef struct
+{
+    volatile http_conn_state_t state;
+    Socket_t socket;
+    bool keep_alive;                    /* Server keeps the connection open */
+    bool peer;                          /* Connected to a peer, not to the URL */
+    uint8_t failures;                   /* Consecutive failed ranges */
+
+    uint32_t first;                     /* Units of the range: [first, end) */
+    uint32_t end;
+    volatile uint32_t written_end;      /* Units [first, written_end) in flash */
+
+    SemaphoreHandle_t wake;             /* Given when a range is assigned */
+    StaticSemaphore_t wake_buffer;
+
+    /* Last unit of the range, handed to the agent. It is released by the
+     * agent once ingested.
+     */
+    OTA_EventData_t block;
+
+    /* Statistics of the transfer */
+    uint32_t bytes;
+    uint32_t peer_bytes;                /* ... of them from a peer */
+    uint32_t ranges;
+    uint32_t connections;
+
+    uint8_t buffer[OTA_HTTP_BUFFER_SIZE];
+} http_conn_t;
+
+
+/*******************************************************************************
+ * Function prototypes
+ ******************************************************************************/
+OTA_Err_t __real__AwsIotOTA_InitFileTransfer_HTTP(OTA_AgentContext_t *pAgentCtx);
+OTA_Err_t __real__AwsIotOTA_RequestDataBlock_HTTP(OTA_AgentContext_t *pAgentCtx);
+OTA_Err_t __real__AwsIotOTA_DecodeFileBlock_HTTP(uint8_t *pMessageBuffer,
+        size_t messageSize, int32_t *pFileId, int32_t *pBlockId,
+        int32_t *pBlockSize, uint8_t **pPayload, size_t *pPayloadSize);
+OTA_Err_t __real__AwsIotOTA_Cleanup_HTTP(OTA_AgentContext_t *pAgentCtx);
+
+OTA_Err_t __wrap__AwsIotOTA_InitFileTransfer_HTTP(OTA_AgentContext_t *pAgentCtx);
+OTA_Err_t __wrap__AwsIotOTA_RequestDataBlock_HTTP(OTA_AgentContext_t *pAgentCtx);
+OTA_Err_t __wrap__AwsIotOTA_DecodeFileBlock_HTTP(uint8_t *pMessageBuffer,
+        size_t messageSize, int32_t *pFileId, int32_t *pBlockId,
+        int32_t *pBlockSize, uint8_t **pPayload, size_t *pPayloadSize);
+OTA_Err_t __wrap__AwsIotOTA_Cleanup_HTTP(OTA_AgentContext_t *pAgentCtx);
+
+static void http_conn_task(void *arg);
+
+
+/*******************************************************************************
+ * Global variables
+ ******************************************************************************/
+/* Set and read by the agent task. The connection tasks only read them while
+ * they download a range.
+ */
+static OTA_FileContext_t *file_ctx = NULL;
+static uint32_t file_units;
+static uint32_t conn_count;             /* Connections used for the transfer */
+static volatile bool conn_stop;         /* Asks the connection tasks to end */
+
+static char http_host[OTA_HTTP_MAX_HOST_LEN];
+static const char *http_path;           /* Path and query of the URL */
+
+static http_conn_t http_conns[CY_OTA_HTTP_CONNECTIONS];
+
+#if defined(CY_OTA_PEER)
+/* Peer that serves the file. It is used until one of its ranges fails. */
+static ota_peer_addr_t peer_addr;
+static volatile bool peer_active;
+static TickType_t peer_find_tick;       /* Last discovery */
+static char peer_host[sizeof("255.255.255.255")];
+static char peer_path[sizeof(OTA_PEER_PATH "ffffffff")];
+#endif
+
+static TickType_t transfer_start;
+
+
+/*******************************************************************************
+ * Function definitions
+ ******************************************************************************/
+
+/*******************************************************************************
+ * Function Name: unit_missing
+ *******************************************************************************
+ * Summary:
+ *  Checks the OTA agent bitmap for a unit that has not been received.
+ *
+ * Parameters:
+ *  unit - unit index
+ *
+ * Return:
+ *  bool - true if the unit has not been received yet
+ *
+ ******************************************************************************/
+static bool unit_missing(uint32_t unit)
+{
+    return (unit < file_units) &&
+           ((file_ctx->pucRxBlockBitmap[unit / BITS_PER_BYTE] &
+             (1U << (unit % BITS_PER_BYTE))) != 0U);
+}
+
+
+/*******************************************************************************
+ * Function Name: unit_size_of
+ *******************************************************************************
+ * Summary:
+ *  Returns the size of a unit; the last unit of the file may be short.
+ *
+ * Parameters:
+ *  unit - unit index
+ *
+ * Return:
+ *  uint32_t - size in bytes
+ *
+ ******************************************************************************/
+static uint32_t unit_size_of(uint32_t unit)
+{
+    uint32_t left = file_ctx->ulFileSize - (unit * OTA_BLOCK_UNIT_SIZE);
+
+    return (left > OTA_BLOCK_UNIT_SIZE) ? OTA_BLOCK_UNIT_SIZE : left;
+}
+
+
+/*******************************************************************************
+ * Function Name: unit_claimed
+ *******************************************************************************
+ * Summary:
+ *  Checks whether a unit is being downloaded, or waits in a block handed to
+ *  the agent.
+ *
+ * Parameters:
+ *  unit - unit index
+ *
+ * Return:
+ *  bool - true if the unit must not be assigned to a connection
+ *
+ ******************************************************************************/
+static bool unit_claimed(uint32_t unit)
+{
+    for (uint32_t i = 0U; i < conn_count; i++)
+    {
+        http_conn_t *conn = &http_conns[i];
+
+        if ((HTTP_CONN_BUSY == conn->state) && (unit >= conn->first) && (unit < conn->end))
+        {
+            return true;
+        }
+
+        if (conn->block.bBufferUsed && (unit == (conn->end - 1U)))
+        {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+
+/*******************************************************************************
+ * Function Name: unit_set_received
+ *******************************************************************************
+ * Summary:
+ *  Marks a unit written to flash as received in the OTA agent bitmap. Must
+ *  be called from the agent task.
+ *
+ * Parameters:
+ *  unit - unit index
+ *
+ ******************************************************************************/
+static void unit_set_received(uint32_t unit)
+{
+    if (unit_missing(unit))
+    {
+        file_ctx->pucRxBlockBitmap[unit / BITS_PER_BYTE] &=
+            (uint8_t)~(1U << (unit % BITS_PER_BYTE));
+        file_ctx->ulBlocksRemaining--;
+    }
+}
+
+
+/*******************************************************************************
+ * Function Name: http_conn_max
+ *******************************************************************************
+ * Summary:
+ *  Returns the number of connections to use: at most CY_OTA_HTTP_CONNECTIONS,
+ *  leaving one secure socket for MQTT, and as many as the free heap allows.
+ *
+ * Return:
+ *  uint32_t - number of connections, at least 1
+ *
+ ******************************************************************************/
+static uint32_t http_conn_max(void)
+{
+    size_t free_heap = xPortGetFreeHeapSize();
+    uint32_t count = CY_OTA_HTTP_CONNECTIONS;
+
+    if (count > (socketsconfigDEFAULT_MAX_NUM_SECURE_SOCKETS - 1U))
+    {
+        count = socketsconfigDEFAULT_MAX_NUM_SECURE_SOCKETS - 1U;
+    }
+
+    while ((count > 1U) &&
+           (free_heap < (OTA_BLOCK_HEAP_RESERVE + (count * OTA_HTTP_CONN_HEAP))))
+    {
+        count--;
+    }
+
+    return (count > 0U) ? count : 1U;
+}
+
+
+/*******************************************************************************
+ * Function Name: http_parse_url
+ *******************************************************************************
+ * Summary:
+ *  Splits the pre-signed URL of the file into the host name and the path with
+ *  the query.
+ *
+ * Parameters:
+ *  url - URL from the job document
+ *
+ * Return:
+ *  bool - true if the URL is an HTTPS URL that fits the buffers
+ *
+ ******************************************************************************/
+static bool http_parse_url(const char *url)
+{
+    const char *host;
+    size_t host_len;
+
+    if ((NULL == url) || (0 != strncmp(url, HTTP_URL_SCHEME, strlen(HTTP_URL_SCHEME))))
+    {
+        return false;
+    }
+
+    host = &url[strlen(HTTP_URL_SCHEME)];
+    http_path = strchr(host, '/');
+
+    if (NULL == http_path)
+    {
+        return false;
+    }
+
+    host_len = (size_t)(http_path - host);
+
+    if ((0U == host_len) || (host_len >= sizeof(http_host)) || (NULL != memchr(host, ':', host_len)))
+    {
+        return false;
+    }
+
+    memcpy(http_host, host, host_len);
+    http_host[host_len] = '\0';
+
+    return true;
+}
+
+
+/*******************************************************************************
+ * Function Name: http_close
+ *******************************************************************************
+ * Summary:
+ *  Closes a connection, if open.
+ *
+ * Parameters:
+ *  conn - connection
+ *
+ ******************************************************************************/
+static void http_close(http_conn_t *conn)
+{
+    if (SOCKETS_INVALID_SOCKET != conn->socket)
+    {
+        (void)SOCKETS_Shutdown(conn->socket, SOCKETS_SHUT_RDWR);
+        (void)SOCKETS_Close(conn->socket);
+        conn->socket = SOCKETS_INVALID_SOCKET;
+    }
+}
+
+
+#if defined(CY_OTA_PEER)
+/*******************************************************************************
+ * Function Name: http_find_peer
+ *******************************************************************************
+ * Summary:
+ *  Looks for a peer on the LAN that serves the file of the agent.
+ *
+ * Parameters:
+ *  C - OTA file context
+ *
+ * Return:
+ *  bool - true if a peer serves the file
+ *
+ ******************************************************************************/
+static bool http_find_peer(const OTA_FileContext_t *C)
+{
+    const uint8_t *ip = (const uint8_t *)&peer_addr.address;
+    uint32_t image_id;
+
+    if (NULL == C->pxSignature)
+    {
+        return false;
+    }
+
+    image_id = ota_peer_image_id(C->pxSignature->ucData, C->pxSignature->usSize);
+    peer_find_tick = xTaskGetTickCount();
+
+    if (!ota_peer_find(image_id, C->ulFileSize, &peer_addr))
+    {
+        return false;
+    }
+
+    (void)snprintf(peer_host, sizeof(peer_host), "%u.%u.%u.%u",
+                   (unsigned int)ip[0], (unsigned int)ip[1], (unsigned int)ip[2], (unsigned int)ip[3]);
+    (void)snprintf(peer_path, sizeof(peer_path), OTA_PEER_PATH "%08lx", (unsigned long)image_id);
+
+    configPRINTF(("OTA HTTP: file served by the peer %s:%u\r\n",
+                  peer_host, (unsigned int)peer_addr.port));
+
+    return true;
+}
+
+
+/*******************************************************************************
+ * Function Name: http_connect_peer
+ *******************************************************************************
+ * Summary:
+ *  Opens a plain TCP connection to the range server of the peer. The peer is
+ *  not used any more if the connection fails.
+ *
+ * Parameters:
+ *  conn - connection
+ *
+ * Return:
+ *  bool - true on success
+ *
+ ******************************************************************************/
+static bool http_connect_peer(http_conn_t *conn)
+{
+    SocketsSockaddr_t address = { 0 };
+    TickType_t timeout = pdMS_TO_TICKS(OTA_HTTP_RECV_TIMEOUT_MS);
+
+    address.ulAddress = peer_addr.address;
+    address.usPort = SOCKETS_htons(peer_addr.port);
+    address.ucLength = sizeof(SocketsSockaddr_t);
+    address.ucSocketDomain = SOCKETS_AF_INET;
+
+    conn->socket = SOCKETS_Socket(SOCKETS_AF_INET, SOCKETS_SOCK_STREAM, SOCKETS_IPPROTO_TCP);
+
+    if (SOCKETS_INVALID_SOCKET == conn->socket)
+    {
+        return false;
+    }
+
+    if ((SOCKETS_ERROR_NONE != SOCKETS_SetSockOpt(conn->socket, 0, SOCKETS_SO_RCVTIMEO,
+                                                  &timeout, sizeof(timeout))) ||
+        (SOCKETS_ERROR_NONE != SOCKETS_Connect(conn->socket, &address, sizeof(address))))
+    {
+        configPRINTF(("OTA HTTP: cannot connect to the peer %s, using the URL\r\n", peer_host));
+        (void)SOCKETS_Close(conn->socket);
+        conn->socket = SOCKETS_INVALID_SOCKET;
+        peer_active = false;
+        return false;
+    }
+
+    conn->keep_alive = true;
+    conn->connections++;
+
+    return true;
+}
+#endif /* CY_OTA_PEER */
+
+
+/*******************************************************************************
+ * Function Name: http_connect
+ *******************************************************************************
+ * Summary:
+ *  Opens a TLS connection to the server of the URL, or a connection to the
+ *  peer that serves the file while it is used.
+ *
+ * Parameters:
+ *  conn - connection
+ *
+ * Return:
+ *  bool - true on success
+ *
+ ******************************************************************************/
+static bool http_connect(http_conn_t *conn)
+{
+    SocketsSockaddr_t address = { 0 };
+    TickType_t timeout = pdMS_TO_TICKS(OTA_HTTP_RECV_TIMEOUT_MS);
+
+    http_close(conn);
+
+#if defined(CY_OTA_PEER)
+    conn->peer = peer_active && http_connect_peer(conn);
+
+    if (conn->peer)
+    {
+        return true;
+    }
+#endif
+
+    address.ulAddress = SOCKETS_GetHostByName(http_host);
+    address.usPort = SOCKETS_htons(OTA_HTTP_PORT);
+    address.ucLength = sizeof(SocketsSockaddr_t);
+    address.ucSocketDomain = SOCKETS_AF_INET;
+
+    if (0U == address.ulAddress)
+    {
+        configPRINTF(("OTA HTTP: cannot resolve %s\r\n", http_host));
+        return false;
+    }
+
+    conn->socket = SOCKETS_Socket(SOCKETS_AF_INET, SOCKETS_SOCK_STREAM, SOCKETS_IPPROTO_TCP);
+
+    if (SOCKETS_INVALID_SOCKET == conn->socket)
+    {
+        return false;
+    }
+
+    if ((SOCKETS_ERROR_NONE != SOCKETS_SetSockOpt(conn->socket, 0, SOCKETS_SO_REQUIRE_TLS, NULL, 0)) ||
+        (SOCKETS_ERROR_NONE != SOCKETS_SetSockOpt(conn->socket, 0, SOCKETS_SO_SERVER_NAME_INDICATION,
+                                                  http_host, strlen(http_host) + 1U)) ||
+        (SOCKETS_ERROR_NONE != SOCKETS_SetSockOpt(conn->socket, 0, SOCKETS_SO_RCVTIMEO,
+                                                  &timeout, sizeof(timeout))) ||
+        (SOCKETS_ERROR_NONE != SOCKETS_Connect(conn->socket, &address, sizeof(address))))
+    {
+        configPRINTF(("OTA HTTP: cannot connect to %s\r\n", http_host));
+        (void)SOCKETS_Close(conn->socket);
+        conn->socket = SOCKETS_INVALID_SOCKET;
+        return false;
+    }
+
+    conn->keep_alive = true;
+    conn->connections++;
+
+    return true;
+}
+
+
+/*******************************************************************************
+ * Function Name: http_send_all
+ *******************************************************************************
+ * Summary:
+ *  Sends a buffer on a connection.
+ *
+ * Parameters:
+ *  conn - connection
+ *  data - bytes to send
+ *  len - number of bytes
+ *
+ * Return:
+ *  bool - true if every byte was sent
+ *
+ ******************************************************************************/
+static bool http_send_all(http_conn_t *conn, const char *data, size_t len)
+{
+    while (len > 0U)
+    {
+        int32_t sent = SOCKETS_Send(conn->socket, data, len, 0);
+
+        if (sent <= 0)
+        {
+            return false;
+        }
+
+        data += sent;
+        len -= (size_t)sent;
+    }
+
+    return true;
+}
+
+
+/*******************************************************************************
+ * Function Name: http_header_value
+ *******************************************************************************
+ * Summary:
+ *  Finds a header of the response, ignoring the case of its name.
+ *
+ * Parameters:
+ *  headers - response header, NUL terminated
+ *  name - header name followed by ':'
+ *
+ * Return:
+ *  const char* - first character of the value, or NULL if not present
+ *
+ ******************************************************************************/
+static const char *http_header_value(const char *headers, const char *name)
+{
+    size_t name_len = strlen(name);
+    const char *line = strstr(headers, "\r\n");
+
+    while (NULL != line)
+    {
+        size_t i;
+
+        line += 2;
+
+        for (i = 0U; i < name_len; i++)
+        {
+            char c = line[i];
+
+            if ((c >= 'A') && (c <= 'Z'))
+            {
+                c = (char)(c - 'A' + 'a');
+            }
+
+            if (c != name[i])
+            {
+                break;
+            }
+        }
+
+        if (i == name_len)
+        {
+            line += name_len;
+
+            while (' ' == *line)
+            {
+                line++;
+            }
+
+            return line;
+        }
+
+        line = strstr(line, "\r\n");
+    }
+
+    return NULL;
+}
+
+
+/*******************************************************************************
+ * Function Name: http_write_body
+ *******************************************************************************
+ * Summary:
+ *  Writes body bytes of a range to flash. The bytes of the last unit of the
+ *  range are kept in the block of the connection instead.
+ *
+ * Parameters:
+ *  conn - connection
+ *  off - file offset of the first byte
+ *  data - body bytes
+ *  len - number of bytes
+ *
+ * Return:
+ *  bool - true on success
+ *
+ ******************************************************************************/
+static bool http_write_body(http_conn_t *conn, uint32_t off, const uint8_t *data, uint32_t len)
+{
+    uint32_t held_off = (conn->end - 1U) * OTA_BLOCK_UNIT_SIZE;
+
+    if ((off + len) > held_off)
+    {
+        uint32_t held = (off + len) - ((off > held_off) ? off : held_off);
+
+        memcpy(&conn->block.data[(off + len - held) - held_off], &data[len - held], held);
+        len -= held;
+    }
+
+    return (0U == len) ||
+           (prvPAL_WriteBlock(file_ctx, off, (uint8_t *)data, len) == (int16_t)len);
+}
+
+
+/*******************************************************************************
+ * Function Name: http_request
+ *******************************************************************************
+ * Summary:
+ *  Sends a ranged GET on a connection and receives the response header.
+ *  The start of the body received with it is moved to the start of the
+ *  buffer of the connection.
+ *
+ * Parameters:
+ *  conn - connection
+ *  range_start - first byte of the range
+ *  range_end - end of the range, excluded
+ *  buffer_len - set to the number of body bytes in the buffer
+ *
+ * Return:
+ *  bool - true if the server answered with the range
+ *
+ ******************************************************************************/
+static bool http_request(http_conn_t *conn, uint32_t range_start, uint32_t range_end, uint32_t *buffer_len)
+{
+    uint8_t *buffer = conn->buffer;
+    uint32_t received = 0U;
+    uint32_t body_len;
+    const char *host = http_host;
+    const char *path = http_path;
+    const char *value;
+    char *body;
+    int len;
+
+#if defined(CY_OTA_PEER)
+    if (conn->peer)
+    {
+        host = peer_host;
+        path = peer_path;
+    }
+#endif
+
+    len = snprintf((char *)buffer, sizeof(conn->buffer),
+                   "GET %s HTTP/1.1\r\n"
+                   "Host: %s\r\n"
+                   "Range: bytes=%u-%u\r\n"
+                   "Connection: keep-alive\r\n\r\n",
+                   path, host,
+                   (unsigned int)range_start, (unsigned int)(range_end - 1U));
+
+    if ((len <= 0) || ((size_t)len >= sizeof(conn->buffer)) ||
+        !http_send_all(conn, (const char *)buffer, (size_t)len))
+    {
+        return false;
+    }
+
+    /* Response header, possibly followed by the start of the body */
+    while (true)
+    {
+        int32_t got;
+
+        if (received >= (sizeof(conn->buffer) - 1U))
+        {
+            return false;
+        }
+
+        got = SOCKETS_Recv(conn->socket, &buffer[received],
+                           sizeof(conn->buffer) - 1U - received, 0);
+
+        if (got <= 0)
+        {
+            return false;
+        }
+
+        received += (uint32_t)got;
+        buffer[received] = '\0';
+
+        body = strstr((char *)buffer, HTTP_HEADER_END);
+
+        if (NULL != body)
+        {
+            body += strlen(HTTP_HEADER_END);
+            break;
+        }
+    }
+
+    body[-2] = '\0';
+
+    if ((0 != strncmp((char *)buffer, "HTTP/1.1 ", 9U)) ||
+        (HTTP_STATUS_PARTIAL_CONTENT != atoi((char *)&buffer[9])))
+    {
+        configPRINTF(("OTA HTTP: unexpected response %.12s\r\n", (char *)buffer));
+        conn->keep_alive = false;
+        return false;
+    }
+
+    value = http_header_value((char *)buffer, "connection:");
+    conn->keep_alive = (NULL == value) || (0 != strncmp(value, "close", 5U));
+
+    value = http_header_value((char *)buffer, "content-range:");
+    if ((NULL == value) || (0 != strncmp(value, "bytes ", 6U)) ||
+        (strtoul(&value[6], NULL, 10) != range_start))
+    {
+        conn->keep_alive = false;
+        return false;
+    }
+
+#if defined(CY_OTA_PEER)
+    /* A peer must serve a file of the size of the job, not only of its ID */
+    value = strchr(value, '/');
+    if (conn->peer && ((NULL == value) || (strtoul(&value[1], NULL, 10) != file_ctx->ulFileSize)))
+    {
+        conn->keep_alive = false;
+        return false;
+    }
+#endif
+
+    value = http_header_value((char *)buffer, "content-length:");
+    body_len = (NULL != value) ? (uint32_t)strtoul(value, NULL, 10) : 0U;
+
+    if (body_len != (range_end - range_start))
+    {
+        conn->keep_alive = false;
+        return false;
+    }
+
+    *buffer_len = received - (uint32_t)(body - (char *)buffer);
+    memmove(buffer, body, *buffer_len);
+
+    return true;
+}
+
+
+/*******************************************************************************
+ * Function Name: http_get_range
+ *******************************************************************************
+ * Summary:
+ *  Downloads the range of a connection with one ranged GET and writes it to
+ *  flash as the body arrives, except the last unit, which is kept for the
+ *  agent. Runs in the task of the connection.
+ *
+ * Parameters:
+ *  conn - connection
+ *
+ * Return:
+ *  bool - true if the whole range was received
+ *
+ ******************************************************************************/
+static bool http_get_range(http_conn_t *conn)
+{
+    uint32_t range_start = conn->first * OTA_BLOCK_UNIT_SIZE;
+    uint32_t range_end = ((conn->end - 1U) * OTA_BLOCK_UNIT_SIZE) + unit_size_of(conn->end - 1U);
+    uint32_t body_len = range_end - range_start;
+    uint8_t *buffer = conn->buffer;
+    uint32_t received = 0U;
+    uint32_t buffer_len = 0U;
+
+    conn->written_end = conn->first;
+
+    if (!http_request(conn, range_start, range_end, &buffer_len))
+    {
+        return false;
+    }
+
+    /* Body: the bytes already received, then the rest of it */
+    while (true)
+    {
+        uint32_t chunk = buffer_len;
+        uint32_t written_end = conn->written_end;
+        int32_t got;
+
+        if (chunk > (body_len - received))
+        {
+            chunk = body_len - received;
+        }
+
+        if (!http_write_body(conn, range_start + received, buffer, chunk))
+        {
+            return false;
+        }
+
+        received += chunk;
+        conn->bytes += chunk;
+#if defined(CY_OTA_PEER)
+        conn->peer_bytes += conn->peer ? chunk : 0U;
+#endif
+
+        /* Units completed by this chunk, except the last one */
+        while (((written_end + 1U) < conn->end) &&
+               (((written_end + 1U) * OTA_BLOCK_UNIT_SIZE) <= (range_start + received)))
+        {
+            written_end++;
+        }
+
+        conn->written_end = written_end;
+
+        if (received >= body_len)
+        {
+            return true;
+        }
+
+        if (conn_stop)
+        {
+            conn->keep_alive = false;
+            return false;
+        }
+
+        got = SOCKETS_Recv(conn->socket, buffer, sizeof(conn->buffer), 0);
+
+        if (got <= 0)
+        {
+            conn->keep_alive = false;
+            return false;
+        }
+
+        buffer_len = (uint32_t)got;
+    }
+}
+
+
+#if defined(CY_OTA_DEDUP)
+/*******************************************************************************
+ * Function Name: http_fetch
+ *******************************************************************************
+ * Summary:
+ *  Reads bytes of the file into memory with a ranged GET on the first
+ *  connection, for the manifest of the file. Runs in the agent task, before
+ *  the connection tasks start.
+ *
+ * Parameters:
+ *  off - file offset of the first byte
+ *  data - destination
+ *  len - number of bytes
+ *
+ * Return:
+ *  bool - true if all bytes were received
+ *
+ ******************************************************************************/
+static bool http_fetch(uint32_t off, uint8_t *data, uint32_t len)
+{
+    http_conn_t *conn = &http_conns[0];
+    uint32_t received = 0U;
+    bool ok;
+
+    ok = ((SOCKETS_INVALID_SOCKET != conn->socket) || http_connect(conn)) &&
+         http_request(conn, off, off + len, &received);
+
+    if (ok)
+    {
+        if (received > len)
+        {
+            received = len;
+        }
+
+        memcpy(data, conn->buffer, received);
+        conn->bytes += received;
+    }
+
+    while (ok && (received < len))
+    {
+        int32_t got = SOCKETS_Recv(conn->socket, &data[received], len - received, 0);
+
+        ok = (got > 0);
+        received += ok ? (uint32_t)got : 0U;
+        conn->bytes += ok ? (uint32_t)got : 0U;
+    }
+
+    if (!ok || !conn->keep_alive)
+    {
+        http_close(conn);
+    }
+
+    return ok;
+}
+#endif /* CY_OTA_DEDUP */
+
+
+/*******************************************************************************
+ * Function Name: http_conn_task
+ *******************************************************************************
+ * Summary:
+ *  Task of a connection: downloads the ranges assigned by the agent task and
+ *  signals the agent when each one ends.
+ *
+ * Parameters:
+ *  arg - connection
+ *
+ ******************************************************************************/
+static void http_conn_task(void *arg)
+{
+    http_conn_t *conn = (http_conn_t *)arg;
+    OTA_EventMsg_t event = { 0 };
+
+    event.xEventId = eOTA_AgentEvent_RequestFileBlock;
+
+    while (true)
+    {
+        bool ok;
+
+        (void)xSemaphoreTake(conn->wake, portMAX_DELAY);
+
+        if (conn_stop)
+        {
+            break;
+        }
+
+#if defined(CY_OTA_PEER)
+        if (conn->peer != peer_active)
+        {
+            /* Another range failed on the peer: go on with the URL. Or a
+             * peer was found: leave the URL for it.
+             */
+            http_close(conn);
+        }
+#endif
+
+        ok = ((SOCKETS_INVALID_SOCKET != conn->socket) || http_connect(conn)) &&
+             http_get_range(conn);
+
+        if (!ok || !conn->keep_alive)
+        {
+            http_close(conn);
+        }
+
+        conn->state = ok ? HTTP_CONN_DONE : HTTP_CONN_FAILED;
+        (void)OTA_SignalEvent(&event);
+    }
+
+    http_close(conn);
+    conn->state = HTTP_CONN_STOPPED;
+}
+
+
+/*******************************************************************************
+ * Function Name: http_conn_collect
+ *******************************************************************************
+ * Summary:
+ *  Takes the result of a range that ended: marks the units written as
+ *  received and hands the last unit to the agent. Runs in the agent task.
+ *
+ * Parameters:
+ *  conn - connection in the HTTP_CONN_DONE or HTTP_CONN_FAILED state
+ *
+ * Return:
+ *  bool - true if a block was handed to the agent
+ *
+ ******************************************************************************/
+static bool http_conn_collect(http_conn_t *conn)
+{
+    OTA_EventMsg_t event = { 0 };
+    bool done = (HTTP_CONN_DONE == conn->state);
+
+    for (uint32_t unit = conn->first; unit < conn->written_end; unit++)
+    {
+        unit_set_received(unit);
+    }
+
+    conn->state = HTTP_CONN_IDLE;
+
+    if (!done)
+    {
+#if defined(CY_OTA_METRICS)
+        ota_metrics_timeout();
+#endif
+#if defined(CY_OTA_PEER)
+        if (conn->peer)
+        {
+            /* The range is requested again from the URL */
+            if (peer_active)
+            {
+                configPRINTF(("OTA HTTP: range %u-%u failed on the peer %s, using the URL\r\n",
+                              (unsigned int)conn->first, (unsigned int)(conn->end - 1U), peer_host));
+            }
+            peer_active = false;
+            return false;
+        }
+#endif
+        conn->failures++;
+        configPRINTF(("OTA HTTP: range %u-%u failed on connection %u\r\n",
+                      (unsigned int)conn->first, (unsigned int)(conn->end - 1U),
+                      (unsigned int)(conn - http_conns)));
+        return false;
+    }
+
+    conn->failures = 0U;
+    conn->ranges++;
+    conn->block.ulDataLength = unit_size_of(conn->end - 1U);
+    conn->block.bBufferUsed = true;
+
+    event.xEventId = eOTA_AgentEvent_ReceivedFileBlock;
+    event.pxEventData = &conn->block;
+    (void)OTA_SignalEvent(&event);
+
+    return true;
+}
+
+
+/*******************************************************************************
+ * Function Name: http_conn_assign
+ *******************************************************************************
+ * Summary:
+ *  Hands the next run of missing units, at most one range, to an idle
+ *  connection. Runs in the agent task.
+ *
+ * Parameters:
+ *  conn - idle connection
+ *
+ * Return:
+ *  bool - true if a range was assigned
+ *
+ ******************************************************************************/
+static bool http_conn_assign(http_conn_t *conn)
+{
+    uint32_t max_units = CY_OTA_HTTP_RANGE_SIZE / OTA_BLOCK_UNIT_SIZE;
+    uint32_t first = 0U;
+    uint32_t end;
+
+    while ((first < file_units) && (!unit_missing(first) || unit_claimed(first)))
+    {
+        first++;
+    }
+
+    if (first >= file_units)
+    {
+        return false;
+    }
+
+    end = first + 1U;
+    while ((end < file_units) && ((end - first) < max_units) &&
+           unit_missing(end) && !unit_claimed(end))
+    {
+        end++;
+    }
+
+    conn->first = first;
+    conn->end = end;
+    conn->written_end = first;
+
+#if defined(CY_OTA_METRICS)
+    ota_metrics_request(first, end);
+    for (uint32_t unit = first; unit < end; unit++)
+    {
+        ota_metrics_request_unit(unit);
+    }
+#endif
+
+    conn->state = HTTP_CONN_BUSY;
+    (void)xSemaphoreGive(conn->wake);
+
+    return true;
+}
+
+
+/*******************************************************************************
+ * Function Name: http_conn_stop_all
+ *******************************************************************************
+ * Summary:
+ *  Ends the tasks of all connections and waits until they have closed their
+ *  socket. A task in the middle of a range ends at its next receive.
+ *
+ ******************************************************************************/
+static void http_conn_stop_all(void)
+{
+    bool running = true;
+
+    conn_stop = true;
+
+    for (uint32_t i = 0U; i < CY_OTA_HTTP_CONNECTIONS; i++)
+    {
+        if ((HTTP_CONN_STOPPED != http_conns[i].state) && (NULL != http_conns[i].wake))
+        {
+            (void)xSemaphoreGive(http_conns[i].wake);
+        }
+    }
+
+    while (running)
+    {
+        running = false;
+
+        for (uint32_t i = 0U; i < CY_OTA_HTTP_CONNECTIONS; i++)
+        {
+            running = running || (HTTP_CONN_STOPPED != http_conns[i].state);
+        }
+
+        if (running)
+        {
+            vTaskDelay(pdMS_TO_TICKS(HTTP_STOP_POLL_MS));
+        }
+    }
+
+    conn_stop = false;
+    conn_count = 0U;
+}
+
+
+/*******************************************************************************
+ * Function Name: __wrap__AwsIotOTA_InitFileTransfer_HTTP
+ *******************************************************************************
+ * Summary:
+ *  Opens the first connection and starts the connection tasks for the file
+ *  of the agent. The other connections are opened by their task. Falls back
+ *  to the HTTP interface of the agent if no connection can be opened.
+ *  With CY_OTA_PEER, the ranges are fetched from a peer on the LAN that
+ *  serves the file, if one answers, until one of them fails on it. With
+ *  CY_OTA_DEDUP, the blocks of a file with a manifest that the primary
+ *  image already holds are copied from it first.
+ *
+ * Parameters:
+ *  pAgentCtx - OTA agent context
+ *
+ * Return:
+ *  OTA_Err_t - kOTA_Err_None on success
+ *
+ ******************************************************************************/
+OTA_Err_t __wrap__AwsIotOTA_InitFileTransfer_HTTP(OTA_AgentContext_t *pAgentCtx)
+{
+    OTA_FileContext_t *C = &pAgentCtx->pxOTA_Files[pAgentCtx->ulFileIndex];
+    uint32_t count = http_conn_max();
+#if defined(CY_OTA_DEDUP)
+    ota_dedup_stats_t dedup_stats;
+#endif
+
+    http_conn_stop_all();
+    file_ctx = NULL;
+
+    for (uint32_t i = 0U; i < CY_OTA_HTTP_CONNECTIONS; i++)
+    {
+        http_conn_t *conn = &http_conns[i];
+
+        if (NULL == conn->wake)
+        {
+            conn->wake = xSemaphoreCreateBinaryStatic(&conn->wake_buffer);
+        }
+
+        conn->socket = SOCKETS_INVALID_SOCKET;
+        conn->peer = false;
+        conn->failures = 0U;
+        conn->block.bBufferUsed = false;
+        conn->bytes = 0U;
+        conn->peer_bytes = 0U;
+        conn->ranges = 0U;
+        conn->connections = 0U;
+    }
+
+#if defined(CY_OTA_PEER)
+    peer_active = http_find_peer(C);
+#endif
+
+    if (http_parse_url((const char *)C->pucUpdateUrlPath) && http_connect(&http_conns[0]))
+    {
+        file_ctx = C;
+        file_units = (C->ulFileSize + OTA_BLOCK_UNIT_SIZE - 1U) / OTA_BLOCK_UNIT_SIZE;
+        transfer_start = xTaskGetTickCount();
+
+#if defined(CY_OTA_DEDUP)
+        ota_dedup_apply(C, http_fetch, &dedup_stats);
+#endif
+
+        for (uint32_t i = 0U; i < count; i++)
+        {
+            http_conns[i].state = HTTP_CONN_IDLE;
+
+            if (!Iot_CreateDetachedThread(http_conn_task, &http_conns[i],
+                                          OTA_HTTP_TASK_PRIORITY, OTA_HTTP_TASK_STACK_SIZE))
+            {
+                http_conns[i].state = HTTP_CONN_STOPPED;
+                break;
+            }
+
+            conn_count = i + 1U;
+        }
+
+        if (conn_count > 0U)
+        {
+            configPRINTF(("OTA HTTP: %u connections, %u byte ranges\r\n",
+                          (unsigned int)conn_count, (unsigned int)CY_OTA_HTTP_RANGE_SIZE));
+            return kOTA_Err_None;
+        }
+
+        http_close(&http_conns[0]);
+        file_ctx = NULL;
+    }
+
+    configPRINTF(("OTA HTTP: using single block requests\r\n"));
+
+    return __real__AwsIotOTA_InitFileTransfer_HTTP(pAgentCtx);
+}
+
+
+/*******************************************************************************
+ * Function Name: __wrap__AwsIotOTA_RequestDataBlock_HTTP
+ *******************************************************************************
+ * Summary:
+ *  Collects the ranges that ended and hands new ranges to the idle
+ *  connections. The connection tasks signal a request when a range ends, and
+ *  the agent asks again on its own when nothing arrives. A connection that
+ *  failed OTA_HTTP_MAX_FAILURES ranges in a row is left unused, unless all
+ *  of them are. While no peer is used, one is looked for again every
+ *  OTA_PEER_RETRY_MS. No range is requested while a multicast transfer is
+ *  received; its task signals a request when it ends, and the blocks it
+ *  wrote are then marked received.
+ *
+ * Parameters:
+ *  pAgentCtx - OTA agent context
+ *
+ * Return:
+ *  OTA_Err_t - kOTA_Err_None on success
+ *
+ ******************************************************************************/
+OTA_Err_t __wrap__AwsIotOTA_RequestDataBlock_HTTP(OTA_AgentContext_t *pAgentCtx)
+{
+    OTA_EventMsg_t event = { 0 };
+    bool handed = false;
+    bool usable = false;
+
+    if (NULL == file_ctx)
+    {
+        return __real__AwsIotOTA_RequestDataBlock_HTTP(pAgentCtx);
+    }
+
+#if defined(CY_OTA_MULTICAST)
+    if (ota_multicast_receiving())
+    {
+        return kOTA_Err_None;
+    }
+
+    ota_multicast_collect(file_ctx, 0U, 0U);
+#endif
+
+#if defined(CY_OTA_PEER)
+    if (!peer_active && ((xTaskGetTickCount() - peer_find_tick) >= pdMS_TO_TICKS(OTA_PEER_RETRY_MS)))
+    {
+        peer_active = http_find_peer(file_ctx);
+    }
+#endif
+
+    for (uint32_t i = 0U; i < conn_count; i++)
+    {
+        http_conn_t *conn = &http_conns[i];
+
+        if ((HTTP_CONN_DONE == conn->state) || (HTTP_CONN_FAILED == conn->state))
+        {
+            handed = http_conn_collect(conn) || handed;
+        }
+
+        usable = usable || (conn->failures < OTA_HTTP_MAX_FAILURES);
+    }
+
+    for (uint32_t i = 0U; i < conn_count; i++)
+    {
+        http_conn_t *conn = &http_conns[i];
+
+        if (!usable)
+        {
+            /* Every connection failed: retry them all at this request. */
+            conn->failures = 0U;
+        }
+
+        if ((HTTP_CONN_IDLE == conn->state) && !conn->block.bBufferUsed &&
+            (conn->failures < OTA_HTTP_MAX_FAILURES) && !http_conn_assign(conn))
+        {
+            break;
+        }
+    }
+
+    if (handed)
+    {
+        /* Idle connections get a range once the agent has ingested the
+         * blocks handed to it.
+         */
+        event.xEventId = eOTA_AgentEvent_RequestFileBlock;
+        (void)OTA_SignalEvent(&event);
+    }
+
+    return kOTA_Err_None;
+}
+
+
+/*******************************************************************************
+ * Function Name: __wrap__AwsIotOTA_DecodeFileBlock_HTTP
+ *******************************************************************************
+ * Summary:
+ *  Decodes a block for the agent. A block handed over at the end of a range
+ *  is returned as is; others go to the HTTP interface of the agent.
+ *
+ * Parameters:
+ *  pMessageBuffer - received block
+ *  messageSize - size of the block
+ *  pFileId - file ID of the block
+ *  pBlockId - block ID (unit index)
+ *  pBlockSize - size of the block
+ *  pPayload - payload of the block
+ *  pPayloadSize - size of the payload
+ *
+ * Return:
+ *  OTA_Err_t - kOTA_Err_None on success
+ *
+ ******************************************************************************/
+OTA_Err_t __wrap__AwsIotOTA_DecodeFileBlock_HTTP(uint8_t *pMessageBuffer,
+        size_t messageSize, int32_t *pFileId, int32_t *pBlockId,
+        int32_t *pBlockSize, uint8_t **pPayload, size_t *pPayloadSize)
+{
+    for (uint32_t i = 0U; (NULL != file_ctx) && (i < conn_count); i++)
+    {
+        http_conn_t *conn = &http_conns[i];
+
+        if (pMessageBuffer == conn->block.data)
+        {
+            *pFileId = (int32_t)file_ctx->ulServerFileID;
+            *pBlockId = (int32_t)(conn->end - 1U);
+            *pBlockSize = (int32_t)messageSize;
+            *pPayload = pMessageBuffer;
+            *pPayloadSize = messageSize;
+
+            return kOTA_Err_None;
+        }
+    }
+
+    return __real__AwsIotOTA_DecodeFileBlock_HTTP(pMessageBuffer, messageSize,
+            pFileId, pBlockId, pBlockSize, pPayload, pPayloadSize);
+}
+
+
+/*******************************************************************************
+ * Function Name: __wrap__AwsIotOTA_Cleanup_HTTP
+ *******************************************************************************
+ * Summary:
+ *  Ends the connection tasks and prints the throughput of the transfer, the
+ *  number of ranges and the number of connections opened.
+ *
+ * Parameters:
+ *  pAgentCtx - OTA agent context
+ *
+ * Return:
+ *  OTA_Err_t - kOTA_Err_None on success
+ *
+ ******************************************************************************/
+OTA_Err_t __wrap__AwsIotOTA_Cleanup_HTTP(OTA_AgentContext_t *pAgentCtx)
+{
+    TickType_t elapsed = xTaskGetTickCount() - transfer_start;
+    uint32_t count = conn_count;
+    uint32_t bytes = 0U;
+    uint32_t ranges = 0U;
+    uint32_t connections = 0U;
+
+    if (NULL == file_ctx)
+    {
+        return __real__AwsIotOTA_Cleanup_HTTP(pAgentCtx);
+    }
+
+    http_conn_stop_all();
+    file_ctx = NULL;
+
+    for (uint32_t i = 0U; i < count; i++)
+    {
+        bytes += http_conns[i].bytes;
+        ranges += http_conns[i].ranges;
+        connections += http_conns[i].connections;
+    }
+
+    configPRINTF(("OTA HTTP: %u bytes in %u ms (%u B/s), %u ranges, %u connections opened\r\n",
+                  (unsigned int)bytes,
+                  (unsigned int)(elapsed * portTICK_PERIOD_MS),
+                  (unsigned int)((elapsed > 0U) ?
+                      (((uint64_t)bytes * configTICK_RATE_HZ) / elapsed) : 0U),
+                  (unsigned int)ranges, (unsigned int)connections));
+
+#if defined(CY_OTA_PEER)
+    bytes = 0U;
+    for (uint32_t i = 0U; i < count; i++)
+    {
+        bytes += http_conns[i].peer_bytes;
+    }
+
+    configPRINTF(("  %u bytes from a peer on the LAN\r\n", (unsigned int)bytes));
+#endif
+
+    for (uint32_t i = 0U; i < count; i++)
+    {
+        configPRINTF(("  connection %u: %u bytes, %u ranges\r\n", (unsigned int)i,
+                      (unsigned int)http_conns[i].bytes, (unsigned int)http_conns[i].ranges));
+    }
+
+    return kOTA_Err_None;
+}
+
+#endif /* CY_OTA_HTTP_STREAM */
+
+
+/* [] END OF FILE */
@@ -0,0 +1,93 @@
+/******************************************************************************
+* File Name: ota_http_stream.h
+*
+* Description: This file contains the macros and function declarations of the
+* ranged download of OTA images over one persistent HTTPS connection.
+*
+* Related Document: See README.md
+*
+*******************************************************************************
+* (c) 2020, Cypress Semiconductor Corporation. All rights reserved.
+*******************************************************************************
+* This software, including source code, documentation and related materials
+* ("Software"), is owned by Cypress Semiconductor Corporation or one of its
+* subsidiaries ("Cypress") and is protected by and subject to worldwide patent
+* protection (United States and foreign), United States copyright laws and
+* international treaty provisions. Therefore, you may use this Software only
+* as provided in the license agreement accompanying the software package from
+* which you obtained this Software ("EULA").
+*
+* If no EULA applies, Cypress hereby grants you a personal, non-exclusive,
+* non-transferable license to copy, modify, and compile the Software source
+* code solely for use in connection with Cypress's integrated circuit products.
+* Any reproduction, modification, translation, compilation, or representation
+* of this Software except as specified above is prohibited without the express
+* written permission of Cypress.
+*
+* Disclaimer: THIS SOFTWARE IS PROVIDED AS-IS, WITH NO WARRANTY OF ANY KIND,
+* EXPRESS OR IMPLIED, INCLUDING, BUT NOT LIMITED TO, NONINFRINGEMENT, IMPLIED
+* WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE. Cypress
+* reserves the right to make changes to the Software without notice. Cypress
+* does not assume any liability arising out of the application or use of the
+* Software or any product or circuit described in the Software. Cypress does
+* not authorize its products for use in any products where a malfunction or
+* failure of the Cypress product may reasonably be expected to result in
+* significant property damage, injury or death ("High Risk Product"). By
+* including Cypress's product in a High Risk Product, the manufacturer of such
+* system or application assumes all risk of such use and in doing so agrees to
+* indemnify Cypress against all liability.
+*******************************************************************************/
+#ifndef OTA_HTTP_STREAM_H
+#define OTA_HTTP_STREAM_H
+
+#include <stdint.h>
+
+
+/*******************************************************************************
+ * Macros
+ ******************************************************************************/
+/* Bytes requested per HTTP range. Set with OTA_HTTP_RANGE_SIZE in the Makefile. */
+#ifndef CY_OTA_HTTP_RANGE_SIZE
+#define CY_OTA_HTTP_RANGE_SIZE          (65536U)
+#endif
+
+/* HTTPS port of the server */
+#define OTA_HTTP_PORT                   (443U)
+
+/* Receive timeout of the connection */
+#define OTA_HTTP_RECV_TIMEOUT_MS        (5000U)
+
+/* Largest host name */
+#define OTA_HTTP_MAX_HOST_LEN           (128U)
+
+/* Buffer of each connection, used for the request, then for the response
+ * header and then for the body. The request holds the path and query of the
+ * pre-signed URL.
+ */
+#define OTA_HTTP_BUFFER_SIZE            (1536U)
+
+/* Largest number of parallel connections. Set with OTA_HTTP_CONNECTIONS in
+ * the Makefile. Fewer are opened when the secure sockets (one is kept for
+ * MQTT) or the free heap do not allow them.
+ */
+#ifndef CY_OTA_HTTP_CONNECTIONS
+#define CY_OTA_HTTP_CONNECTIONS         (3U)
+#endif
+
+/* Heap used by one connection: TLS context and records, and task stack */
+#define OTA_HTTP_CONN_HEAP              (40960UL)
+
+/* A connection is left unused for the rest of the transfer after this many
+ * consecutive failed ranges. The others go on.
+ */
+#define OTA_HTTP_MAX_FAILURES           (3U)
+
+/* Task of each connection */
+#define OTA_HTTP_TASK_STACK_SIZE        (configMINIMAL_STACK_SIZE * 12)
+#define OTA_HTTP_TASK_PRIORITY          (otaconfigAGENT_PRIORITY)
+
+
+#endif /* OTA_HTTP_STREAM_H */
+
+
+/* [] END OF FILE */
@@ -0,0 +1,775 @@
+/******************************************************************************
+* File Name: ota_metrics.c
+*
+* Description: This file implements the metrics of the OTA transfers, to tell
+* why some devices take much longer to update than others. For each file it
+* records:
+* - the goodput over time, in bytes written to the secondary slot per
+*   interval;
+* - a histogram of the time from the request of each unit to its write;
+* - the duplicate units received, the units requested more than once and the
+*   request timeouts;
+* - the time spent writing and erasing the flash, and verifying the image.
+* When the file is closed or aborted, a summary is printed. It is published
+* as JSON to CY_OTA_METRICS_TOPIC_FORMAT with the next job status update of
+* the agent, which follows the end of the transfer on the same connection.
+*
+* Related Document: See README.md
+*
+*******************************************************************************
+* (c) 2020, Cypress Semiconductor Corporation. All rights reserved.
+*******************************************************************************
+* This software, including source code, documentation and related materials
+* ("Software"), is owned by Cypress Semiconductor Corporation or one of its
+* subsidiaries ("Cypress") and is protected by and subject to worldwide patent
+* protection (United States and foreign), United States copyright laws and
+* international treaty provisions. Therefore, you may use this Software only
+* as provided in the license agreement accompanying the software package from
+* which you obtained this Software ("EULA").
+*
+* If no EULA applies, Cypress hereby grants you a personal, non-exclusive,
+* non-transferable license to copy, modify, and compile the Software source
+* code solely for use in connection with Cypress's integrated circuit products.
+* Any reproduction, modification, translation, compilation, or representation
+* of this Software except as specified above is prohibited without the express
+* written permission of Cypress.
+*
+* Disclaimer: THIS SOFTWARE IS PROVIDED AS-IS, WITH NO WARRANTY OF ANY KIND,
+* EXPRESS OR IMPLIED, INCLUDING, BUT NOT LIMITED TO, NONINFRINGEMENT, IMPLIED
+* WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE. Cypress
+* reserves the right to make changes to the Software without notice. Cypress
+* does not assume any liability arising out of the application or use of the
+* Software or any product or circuit described in the Software. Cypress does
+* not authorize its products for use in any products where a malfunction or
+* failure of the Cypress product may reasonably be expected to result in
+* significant property damage, injury or death ("High Risk Product"). By
+* including Cypress's product in a High Risk Product, the manufacturer of such
+* system or application assumes all risk of such use and in doing so agrees to
+* indemnify Cypress against all liability.
+*******************************************************************************/
+#include <string.h>
+#include <stdio.h>
+#include <stdarg.h>
+#include "cy_pdl.h"
+#include "FreeRTOS.h"
+#include "task.h"
+#include "iot_mqtt.h"
+#include "aws_iot_ota_agent_internal.h"
+#include "ota_block_size.h"
+#include "ota_metrics.h"
+
+#if defined(CY_OTA_METRICS)
+
+/*******************************************************************************
+ * Macros
+ ******************************************************************************/
+#define BITS_PER_BYTE                   (8U)
+
+/* Largest file: one that fills the secondary slot */
+#define METRICS_UNITS_MAX               ((CY_BOOT_SECONDARY_1_SIZE + OTA_BLOCK_UNIT_SIZE - 1UL) /\
+                                         OTA_BLOCK_UNIT_SIZE)
+
+#define METRICS_JOB_NAME_SIZE           (64U)
+#define METRICS_TOPIC_SIZE              (128U)
+#define METRICS_PAYLOAD_SIZE            (768U)
+
+
+/*******************************************************************************
+ * Data structure and enumeration
+ ******************************************************************************/
+/* Units [first_unit, end_unit) requested at the same time */
+typedef struct
+{
+    uint32_t first_unit;
+    uint32_t end_unit;
+    TickType_t sent;
+} metrics_request_t;
+
+typedef struct
+{
+    uint32_t ops;
+    uint64_t cycles;
+} metrics_flash_stats_t;
+
+
+/*******************************************************************************
+ * Function prototypes
+ ******************************************************************************/
+OTA_Err_t __real__AwsIotOTA_UpdateJobStatus_Mqtt(OTA_AgentContext_t *pxAgentCtx,
+        OTA_JobStatus_t eStatus, int32_t lReason, int32_t lSubReason);
+OTA_Err_t __wrap__AwsIotOTA_UpdateJobStatus_Mqtt(OTA_AgentContext_t *pxAgentCtx,
+        OTA_JobStatus_t eStatus, int32_t lReason, int32_t lSubReason);
+
+
+/*******************************************************************************
+ * Global variables
+ ******************************************************************************/
+/* Updated from the agent task, the flash writer task and the HTTP connection
+ * tasks, in critical sections. The summary is published by the agent task.
+ */
+static bool metrics_active;
+static bool summary_pending;
+static ota_metrics_result_t metrics_result;
+static char job_name[METRICS_JOB_NAME_SIZE];
+static uint32_t file_size;
+static TickType_t transfer_start;
+static TickType_t transfer_ticks;
+static uint32_t bytes_written;
+
+/* Goodput over time */
+static uint32_t rate_interval_ms;
+static uint32_t rate_bytes[OTA_METRICS_RATE_SAMPLES];
+
+/* Request-to-write latency */
+static metrics_request_t requests[OTA_METRICS_REQUESTS];
+static uint32_t requests_sent;
+static uint32_t latency[OTA_METRICS_LATENCY_BUCKETS];
+static uint32_t latency_unmatched;      /* Written units of no known request */
+
+/* Requests and losses */
+static uint8_t requested_bitmap[(METRICS_UNITS_MAX + BITS_PER_BYTE - 1U) / BITS_PER_BYTE];
+static uint32_t duplicates;
+static uint32_t retransmitted;
+static uint32_t timeouts;
+
+/* Flash operations. Nested operations, such as the writes of the coalescing
+ * buffers before an erase, are part of the outermost one.
+ */
+static metrics_flash_stats_t flash_stats[OTA_METRICS_FLASH_ERASE + 1U];
+static uint32_t flash_depth;
+static ota_metrics_flash_t flash_op;
+static uint32_t flash_start;
+
+static bool verifying;
+static TickType_t verify_start;
+static TickType_t verify_ticks;
+
+static char metrics_payload[METRICS_PAYLOAD_SIZE];
+
+
+/*******************************************************************************
+ * Function definitions
+ ******************************************************************************/
+
+/*******************************************************************************
+ * Function Name: cycles_now
+ *******************************************************************************
+ * Summary:
+ *  Returns the DWT cycle counter, enabling it on first use.
+ *
+ * Return:
+ *  uint32_t - cycle count
+ *
+ ******************************************************************************/
+static uint32_t cycles_now(void)
+{
+    if ((DWT->CTRL & DWT_CTRL_CYCCNTENA_Msk) == 0U)
+    {
+        CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk;
+        DWT->CYCCNT = 0U;
+        DWT->CTRL |= DWT_CTRL_CYCCNTENA_Msk;
+    }
+
+    return DWT->CYCCNT;
+}
+
+
+/*******************************************************************************
+ * Function Name: cycles_to_ms
+ *******************************************************************************
+ * Summary:
+ *  Converts CPU cycles to milliseconds.
+ *
+ * Parameters:
+ *  cycles - number of cycles
+ *
+ * Return:
+ *  uint32_t - milliseconds
+ *
+ ******************************************************************************/
+static uint32_t cycles_to_ms(uint64_t cycles)
+{
+    uint32_t per_ms = SystemCoreClock / 1000U;
+
+    return (per_ms > 0U) ? (uint32_t)(cycles / per_ms) : 0U;
+}
+
+
+/*******************************************************************************
+ * Function Name: rate_add
+ *******************************************************************************
+ * Summary:
+ *  Adds bytes written to the goodput sample of the current interval. When the
+ *  transfer outlasts the samples, neighbouring samples are merged and the
+ *  interval doubles. Called in a critical section.
+ *
+ * Parameters:
+ *  elapsed_ms - time since the start of the transfer
+ *  bytes - bytes written
+ *
+ ******************************************************************************/
+static void rate_add(uint32_t elapsed_ms, uint32_t bytes)
+{
+    uint32_t index = elapsed_ms / rate_interval_ms;
+
+    while (index >= OTA_METRICS_RATE_SAMPLES)
+    {
+        for (uint32_t i = 0U; i < (OTA_METRICS_RATE_SAMPLES / 2U); i++)
+        {
+            rate_bytes[i] = rate_bytes[2U * i] + rate_bytes[(2U * i) + 1U];
+        }
+
+        memset(&rate_bytes[OTA_METRICS_RATE_SAMPLES / 2U], 0,
+               (OTA_METRICS_RATE_SAMPLES / 2U) * sizeof(rate_bytes[0]));
+
+        rate_interval_ms *= 2U;
+        index = elapsed_ms / rate_interval_ms;
+    }
+
+    rate_bytes[index] += bytes;
+}
+
+
+/*******************************************************************************
+ * Function Name: latency_add
+ *******************************************************************************
+ * Summary:
+ *  Adds the latency of a unit written to the histogram, from the newest
+ *  request that asked for it. Called in a critical section.
+ *
+ * Parameters:
+ *  unit - unit index
+ *  now - tick count of the write
+ *
+ ******************************************************************************/
+static void latency_add(uint32_t unit, TickType_t now)
+{
+    uint32_t count = (requests_sent < OTA_METRICS_REQUESTS) ? requests_sent : OTA_METRICS_REQUESTS;
+
+    for (uint32_t i = 1U; i <= count; i++)
+    {
+        const metrics_request_t *request = &requests[(requests_sent - i) % OTA_METRICS_REQUESTS];
+
+        if ((unit >= request->first_unit) && (unit < request->end_unit))
+        {
+            uint32_t ms = (uint32_t)(now - request->sent) * portTICK_PERIOD_MS;
+            uint32_t bound = OTA_METRICS_LATENCY_BASE_MS;
+            uint32_t bucket = 0U;
+
+            while ((ms >= bound) && (bucket < (OTA_METRICS_LATENCY_BUCKETS - 1U)))
+            {
+                bound *= 2U;
+                bucket++;
+            }
+
+            latency[bucket]++;
+            return;
+        }
+    }
+
+    latency_unmatched++;
+}
+
+
+/*******************************************************************************
+ * Function Name: metrics_append
+ *******************************************************************************
+ * Summary:
+ *  Appends formatted text to the summary payload.
+ *
+ * Parameters:
+ *  len - length of the payload, updated; set above the buffer size when the
+ *        text does not fit
+ *  format - printf format, followed by its arguments
+ *
+ ******************************************************************************/
+static void metrics_append(size_t *len, const char *format, ...)
+{
+    va_list args;
+    int added;
+
+    if (*len >= sizeof(metrics_payload))
+    {
+        return;
+    }
+
+    va_start(args, format);
+    added = vsnprintf(&metrics_payload[*len], sizeof(metrics_payload) - *len, format, args);
+    va_end(args);
+
+    *len = (added < 0) ? sizeof(metrics_payload) : (*len + (size_t)added);
+}
+
+
+/*******************************************************************************
+ * Function Name: metrics_format
+ *******************************************************************************
+ * Summary:
+ *  Formats the summary of the last transfer as JSON.
+ *
+ * Return:
+ *  size_t - length of the summary, 0 if it does not fit
+ *
+ ******************************************************************************/
+static size_t metrics_format(void)
+{
+    static const char * const result_names[] = { "verified", "rejected", "aborted" };
+    uint32_t elapsed_ms = transfer_ticks * portTICK_PERIOD_MS;
+    uint32_t samples = (elapsed_ms / rate_interval_ms) + 1U;
+    size_t len = 0U;
+
+    if (samples > OTA_METRICS_RATE_SAMPLES)
+    {
+        samples = OTA_METRICS_RATE_SAMPLES;
+    }
+
+    metrics_append(&len, "{\"job\":\"%s\",\"result\":\"%s\",\"size\":%u,\"bytes\":%u,\"ms\":%u,",
+                   job_name, result_names[metrics_result], (unsigned int)file_size,
+                   (unsigned int)bytes_written, (unsigned int)elapsed_ms);
+
+    /* Goodput in bytes per second; the last interval is cut at the end */
+    metrics_append(&len, "\"rate_ms\":%u,\"rate\":[", (unsigned int)rate_interval_ms);
+    for (uint32_t i = 0U; i < samples; i++)
+    {
+        uint32_t span = rate_interval_ms;
+
+        if ((i + 1U) == samples)
+        {
+            span = elapsed_ms - (i * rate_interval_ms);
+        }
+
+        metrics_append(&len, "%s%u", (i > 0U) ? "," : "",
+                       (unsigned int)((span > 0U) ? (((uint64_t)rate_bytes[i] * 1000U) / span) : 0U));
+    }
+
+    metrics_append(&len, "],\"latency_base_ms\":%u,\"latency\":[",
+                   (unsigned int)OTA_METRICS_LATENCY_BASE_MS);
+    for (uint32_t i = 0U; i < OTA_METRICS_LATENCY_BUCKETS; i++)
+    {
+        metrics_append(&len, "%s%u", (i > 0U) ? "," : "", (unsigned int)latency[i]);
+    }
+
+    metrics_append(&len, "],\"latency_unmatched\":%u,\"duplicates\":%u,\"retransmitted\":%u,"
+                   "\"timeouts\":%u,\"write\":{\"ops\":%u,\"ms\":%u},\"erase\":{\"ops\":%u,\"ms\":%u},"
+                   "\"verify_ms\":%u}",
+                   (unsigned int)latency_unmatched, (unsigned int)duplicates,
+                   (unsigned int)retransmitted, (unsigned int)timeouts,
+                   (unsigned int)flash_stats[OTA_METRICS_FLASH_WRITE].ops,
+                   (unsigned int)cycles_to_ms(flash_stats[OTA_METRICS_FLASH_WRITE].cycles),
+                   (unsigned int)flash_stats[OTA_METRICS_FLASH_ERASE].ops,
+                   (unsigned int)cycles_to_ms(flash_stats[OTA_METRICS_FLASH_ERASE].cycles),
+                   (unsigned int)(verify_ticks * portTICK_PERIOD_MS));
+
+    return (len < sizeof(metrics_payload)) ? len : 0U;
+}
+
+
+/*******************************************************************************
+ * Function Name: metrics_publish
+ *******************************************************************************
+ * Summary:
+ *  Publishes the summary of the last transfer on the MQTT connection of the
+ *  agent. Runs in the agent task.
+ *
+ * Parameters:
+ *  pxAgentCtx - OTA agent context
+ *
+ ******************************************************************************/
+static void metrics_publish(const OTA_AgentContext_t *pxAgentCtx)
+{
+    const OTA_ConnectionContext_t *connection = (const OTA_ConnectionContext_t *)pxAgentCtx->pvConnectionContext;
+    IotMqttPublishInfo_t publish = IOT_MQTT_PUBLISH_INFO_INITIALIZER;
+    char topic[METRICS_TOPIC_SIZE];
+    size_t payload_len = metrics_format();
+    int topic_len;
+    IotMqttError_t rc;
+
+    if ((NULL == connection) || (NULL == connection->pvControlClient))
+    {
+        return;
+    }
+
+    topic_len = snprintf(topic, sizeof(topic), CY_OTA_METRICS_TOPIC_FORMAT,
+                         (const char *)pxAgentCtx->pcThingName);
+
+    if ((topic_len <= 0) || ((size_t)topic_len >= sizeof(topic)) || (0U == payload_len))
+    {
+        configPRINTF(("OTA metrics: summary does not fit\r\n"));
+        return;
+    }
+
+    publish.qos = IOT_MQTT_QOS_1;
+    publish.pTopicName = topic;
+    publish.topicNameLength = (uint16_t)topic_len;
+    publish.pPayload = metrics_payload;
+    publish.payloadLength = payload_len;
+
+    rc = IotMqtt_TimedPublish((IotMqttConnection_t)connection->pvControlClient, &publish,
+                              0U, OTA_METRICS_PUBLISH_TIMEOUT_MS);
+
+    if (IOT_MQTT_SUCCESS == rc)
+    {
+        configPRINTF(("OTA metrics: %u byte summary published to %s\r\n",
+                      (unsigned int)payload_len, topic));
+    }
+    else
+    {
+        configPRINTF(("OTA metrics: publish to %s failed (%d)\r\n", topic, (int)rc));
+    }
+}
+
+
+/*******************************************************************************
+ * Function Name: ota_metrics_begin
+ *******************************************************************************
+ * Summary:
+ *  Starts the metrics of a new file transfer. Must be called before the PAL
+ *  opens the file, so that the erase of the slot is measured.
+ *
+ * Parameters:
+ *  C - OTA file context of the transfer
+ *
+ ******************************************************************************/
+void ota_metrics_begin(const OTA_FileContext_t *C)
+{
+    size_t name_len = 0U;
+
+    taskENTER_CRITICAL();
+
+    metrics_active = true;
+    summary_pending = false;
+    file_size = C->ulFileSize;
+    transfer_start = xTaskGetTickCount();
+    transfer_ticks = 0U;
+    bytes_written = 0U;
+
+    rate_interval_ms = OTA_METRICS_RATE_INTERVAL_MS;
+    memset(rate_bytes, 0, sizeof(rate_bytes));
+
+    requests_sent = 0U;
+    memset(latency, 0, sizeof(latency));
+    latency_unmatched = 0U;
+
+    memset(requested_bitmap, 0, sizeof(requested_bitmap));
+    duplicates = 0U;
+    retransmitted = 0U;
+    timeouts = 0U;
+
+    memset(flash_stats, 0, sizeof(flash_stats));
+    verifying = false;
+    verify_ticks = 0U;
+
+    taskEXIT_CRITICAL();
+
+    /* The job name goes into the JSON summary: keep it to safe characters. */
+    if (NULL != C->pucJobName)
+    {
+        for (const uint8_t *c = C->pucJobName; ('\0' != *c) && (name_len < (sizeof(job_name) - 1U)); c++)
+        {
+            if ((*c >= 0x20U) && (*c < 0x7FU) && ('"' != *c) && ('\\' != *c))
+            {
+                job_name[name_len++] = (char)*c;
+            }
+        }
+    }
+
+    job_name[name_len] = '\0';
+}
+
+
+/*******************************************************************************
+ * Function Name: ota_metrics_end
+ *******************************************************************************
+ * Summary:
+ *  Ends the metrics of the transfer, prints them and keeps the summary for
+ *  the next job status update of the agent.
+ *
+ * Parameters:
+ *  result - outcome of the transfer
+ *
+ ******************************************************************************/
+void ota_metrics_end(ota_metrics_result_t result)
+{
+    if (!metrics_active)
+    {
+        return;
+    }
+
+    taskENTER_CRITICAL();
+    metrics_active = false;
+    transfer_ticks = xTaskGetTickCount() - transfer_start;
+
+    /* Goodput samples up to the end, with no bytes written since the last */
+    rate_add((uint32_t)transfer_ticks * portTICK_PERIOD_MS, 0U);
+    taskEXIT_CRITICAL();
+
+    metrics_result = result;
+    summary_pending = true;
+
+    if (verifying)
+    {
+        verify_ticks = xTaskGetTickCount() - verify_start;
+        verifying = false;
+    }
+
+    configPRINTF(("OTA metrics: %u bytes in %u ms, %u duplicate, %u retransmitted, %u timeouts\r\n",
+                  (unsigned int)bytes_written, (unsigned int)(transfer_ticks * portTICK_PERIOD_MS),
+                  (unsigned int)duplicates, (unsigned int)retransmitted, (unsigned int)timeouts));
+    configPRINTF(("  flash write %u ms (%u), erase %u ms (%u), verify %u ms\r\n",
+                  (unsigned int)cycles_to_ms(flash_stats[OTA_METRICS_FLASH_WRITE].cycles),
+                  (unsigned int)flash_stats[OTA_METRICS_FLASH_WRITE].ops,
+                  (unsigned int)cycles_to_ms(flash_stats[OTA_METRICS_FLASH_ERASE].cycles),
+                  (unsigned int)flash_stats[OTA_METRICS_FLASH_ERASE].ops,
+                  (unsigned int)(verify_ticks * portTICK_PERIOD_MS)));
+}
+
+
+/*******************************************************************************
+ * Function Name: ota_metrics_request
+ *******************************************************************************
+ * Summary:
+ *  Records a request for units of the file, the start of the latency of the
+ *  units it asks for.
+ *
+ * Parameters:
+ *  first_unit - first unit requested
+ *  end_unit - unit after the last unit requested
+ *
+ ******************************************************************************/
+void ota_metrics_request(uint32_t first_unit, uint32_t end_unit)
+{
+    taskENTER_CRITICAL();
+
+    if (metrics_active)
+    {
+        metrics_request_t *request = &requests[requests_sent % OTA_METRICS_REQUESTS];
+
+        request->first_unit = first_unit;
+        request->end_unit = end_unit;
+        request->sent = xTaskGetTickCount();
+        requests_sent++;
+    }
+
+    taskEXIT_CRITICAL();
+}
+
+
+/*******************************************************************************
+ * Function Name: ota_metrics_request_unit
+ *******************************************************************************
+ * Summary:
+ *  Records a unit asked for by a request. A unit asked for again is counted
+ *  as retransmitted.
+ *
+ * Parameters:
+ *  unit - unit index
+ *
+ ******************************************************************************/
+void ota_metrics_request_unit(uint32_t unit)
+{
+    uint8_t mask = (uint8_t)(1U << (unit % BITS_PER_BYTE));
+
+    if (unit >= METRICS_UNITS_MAX)
+    {
+        return;
+    }
+
+    taskENTER_CRITICAL();
+
+    if (metrics_active)
+    {
+        if ((requested_bitmap[unit / BITS_PER_BYTE] & mask) != 0U)
+        {
+            retransmitted++;
+        }
+
+        requested_bitmap[unit / BITS_PER_BYTE] |= mask;
+    }
+
+    taskEXIT_CRITICAL();
+}
+
+
+/*******************************************************************************
+ * Function Name: ota_metrics_timeout
+ *******************************************************************************
+ * Summary:
+ *  Counts a request that timed out.
+ *
+ ******************************************************************************/
+void ota_metrics_timeout(void)
+{
+    taskENTER_CRITICAL();
+
+    if (metrics_active)
+    {
+        timeouts++;
+    }
+
+    taskEXIT_CRITICAL();
+}
+
+
+/*******************************************************************************
+ * Function Name: ota_metrics_duplicate
+ *******************************************************************************
+ * Summary:
+ *  Counts units received again after they were written.
+ *
+ * Parameters:
+ *  units - number of units
+ *
+ ******************************************************************************/
+void ota_metrics_duplicate(uint32_t units)
+{
+    taskENTER_CRITICAL();
+
+    if (metrics_active)
+    {
+        duplicates += units;
+    }
+
+    taskEXIT_CRITICAL();
+}
+
+
+/*******************************************************************************
+ * Function Name: ota_metrics_written
+ *******************************************************************************
+ * Summary:
+ *  Records bytes of the file written to flash. The units that the write
+ *  completes end their latency.
+ *
+ * Parameters:
+ *  off - offset in the file
+ *  len - number of bytes
+ *
+ ******************************************************************************/
+void ota_metrics_written(uint32_t off, uint32_t len)
+{
+    TickType_t now = xTaskGetTickCount();
+
+    taskENTER_CRITICAL();
+
+    if (metrics_active)
+    {
+        bytes_written += len;
+        rate_add((uint32_t)(now - transfer_start) * portTICK_PERIOD_MS, len);
+
+        for (uint32_t unit = off / OTA_BLOCK_UNIT_SIZE; (unit * OTA_BLOCK_UNIT_SIZE) < (off + len); unit++)
+        {
+            uint32_t unit_end = (unit + 1U) * OTA_BLOCK_UNIT_SIZE;
+
+            if (unit_end > file_size)
+            {
+                unit_end = file_size;
+            }
+
+            if ((unit_end > off) && (unit_end <= (off + len)))
+            {
+                latency_add(unit, now);
+            }
+        }
+    }
+
+    taskEXIT_CRITICAL();
+}
+
+
+/*******************************************************************************
+ * Function Name: ota_metrics_flash_start
+ *******************************************************************************
+ * Summary:
+ *  Starts timing a flash operation, unless another one is in progress.
+ *
+ * Parameters:
+ *  op - operation
+ *
+ ******************************************************************************/
+void ota_metrics_flash_start(ota_metrics_flash_t op)
+{
+    taskENTER_CRITICAL();
+
+    if (0U == flash_depth)
+    {
+        flash_op = op;
+        flash_start = cycles_now();
+    }
+
+    flash_depth++;
+
+    taskEXIT_CRITICAL();
+}
+
+
+/*******************************************************************************
+ * Function Name: ota_metrics_flash_end
+ *******************************************************************************
+ * Summary:
+ *  Ends a flash operation. The outermost one is added to the statistics of
+ *  the transfer.
+ *
+ ******************************************************************************/
+void ota_metrics_flash_end(void)
+{
+    taskENTER_CRITICAL();
+
+    if ((flash_depth > 0U) && (0U == --flash_depth) && metrics_active)
+    {
+        flash_stats[flash_op].ops++;
+        flash_stats[flash_op].cycles += (uint32_t)(cycles_now() - flash_start);
+    }
+
+    taskEXIT_CRITICAL();
+}
+
+
+/*******************************************************************************
+ * Function Name: ota_metrics_verify_start
+ *******************************************************************************
+ * Summary:
+ *  Starts timing the verification of the image, which lasts until
+ *  ota_metrics_end().
+ *
+ ******************************************************************************/
+void ota_metrics_verify_start(void)
+{
+    verify_start = xTaskGetTickCount();
+    verifying = true;
+}
+
+
+/*******************************************************************************
+ * Function Name: __wrap__AwsIotOTA_UpdateJobStatus_Mqtt
+ *******************************************************************************
+ * Summary:
+ *  Updates the status of the job. The summary of a transfer that ended is
+ *  published first: the status update after the end of a transfer comes
+ *  before the agent activates the image or waits for the next job.
+ *
+ * Parameters:
+ *  pxAgentCtx - OTA agent context
+ *  eStatus - job status
+ *  lReason - reason code
+ *  lSubReason - sub-reason code
+ *
+ * Return:
+ *  OTA_Err_t - result of the status update
+ *
+ ******************************************************************************/
+OTA_Err_t __wrap__AwsIotOTA_UpdateJobStatus_Mqtt(OTA_AgentContext_t *pxAgentCtx,
+        OTA_JobStatus_t eStatus, int32_t lReason, int32_t lSubReason)
+{
+    if (summary_pending)
+    {
+        summary_pending = false;
+        metrics_publish(pxAgentCtx);
+    }
+
+    return __real__AwsIotOTA_UpdateJobStatus_Mqtt(pxAgentCtx, eStatus, lReason, lSubReason);
+}
+
+#endif /* CY_OTA_METRICS */
+
+
+/* [] END OF FILE */
@@ -0,0 +1,113 @@
+/******************************************************************************
+* File Name: ota_metrics.h
+*
+* Description: This file contains the macros and function declarations of the
+* OTA transfer metrics and of the summary published when a job completes.
+*
+* Related Document: See README.md
+*
+*******************************************************************************
+* (c) 2020, Cypress Semiconductor Corporation. All rights reserved.
+*******************************************************************************
+* This software, including source code, documentation and related materials
+* ("Software"), is owned by Cypress Semiconductor Corporation or one of its
+* subsidiaries ("Cypress") and is protected by and subject to worldwide patent
+* protection (United States and foreign), United States copyright laws and
+* international treaty provisions. Therefore, you may use this Software only
+* as provided in the license agreement accompanying the software package from
+* which you obtained this Software ("EULA").
+*
+* If no EULA applies, Cypress hereby grants you a personal, non-exclusive,
+* non-transferable license to copy, modify, and compile the Software source
+* code solely for use in connection with Cypress's integrated circuit products.
+* Any reproduction, modification, translation, compilation, or representation
+* of this Software except as specified above is prohibited without the express
+* written permission of Cypress.
+*
+* Disclaimer: THIS SOFTWARE IS PROVIDED AS-IS, WITH NO WARRANTY OF ANY KIND,
+* EXPRESS OR IMPLIED, INCLUDING, BUT NOT LIMITED TO, NONINFRINGEMENT, IMPLIED
+* WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE. Cypress
+* reserves the right to make changes to the Software without notice. Cypress
+* does not assume any liability arising out of the application or use of the
+* Software or any product or circuit described in the Software. Cypress does
+* not authorize its products for use in any products where a malfunction or
+* failure of the Cypress product may reasonably be expected to result in
+* significant property damage, injury or death ("High Risk Product"). By
+* including Cypress's product in a High Risk Product, the manufacturer of such
+* system or application assumes all risk of such use and in doing so agrees to
+* indemnify Cypress against all liability.
+*******************************************************************************/
+#ifndef OTA_METRICS_H
+#define OTA_METRICS_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "aws_iot_ota_agent.h"
+
+
+/*******************************************************************************
+ * Macros
+ ******************************************************************************/
+/* Topic of the summary, formatted with the thing name */
+#ifndef CY_OTA_METRICS_TOPIC_FORMAT
+#define CY_OTA_METRICS_TOPIC_FORMAT     "ota/%s/metrics"
+#endif
+
+/* Time allowed for the broker to acknowledge the summary */
+#define OTA_METRICS_PUBLISH_TIMEOUT_MS  (5000U)
+
+/* Goodput over time: bytes written per interval. When the samples are all
+ * in use, neighbouring samples are merged and the interval doubles.
+ */
+#define OTA_METRICS_RATE_SAMPLES        (24U)
+#define OTA_METRICS_RATE_INTERVAL_MS    (2000U)
+
+/* Request-to-write latency histogram: bucket 0 counts the latencies below
+ * OTA_METRICS_LATENCY_BASE_MS, each next bucket up to twice the bound of
+ * the previous one, and the last one everything above.
+ */
+#define OTA_METRICS_LATENCY_BUCKETS     (12U)
+#define OTA_METRICS_LATENCY_BASE_MS     (8U)
+
+/* Requests remembered to match the units written with */
+#define OTA_METRICS_REQUESTS            (16U)
+
+
+/*******************************************************************************
+ * Data structure and enumeration
+ ******************************************************************************/
+typedef enum
+{
+    OTA_METRICS_VERIFIED,       /* File closed, signature valid */
+    OTA_METRICS_REJECTED,       /* File closed, write or signature failed */
+    OTA_METRICS_ABORTED         /* Transfer aborted */
+} ota_metrics_result_t;
+
+typedef enum
+{
+    OTA_METRICS_FLASH_WRITE,
+    OTA_METRICS_FLASH_ERASE
+} ota_metrics_flash_t;
+
+
+/*******************************************************************************
+ * Function prototypes
+ ******************************************************************************/
+void ota_metrics_begin(const OTA_FileContext_t *C);
+void ota_metrics_end(ota_metrics_result_t result);
+
+void ota_metrics_request(uint32_t first_unit, uint32_t end_unit);
+void ota_metrics_request_unit(uint32_t unit);
+void ota_metrics_timeout(void);
+void ota_metrics_duplicate(uint32_t units);
+void ota_metrics_written(uint32_t off, uint32_t len);
+
+void ota_metrics_flash_start(ota_metrics_flash_t op);
+void ota_metrics_flash_end(void);
+void ota_metrics_verify_start(void);
+
+
+#endif /* OTA_METRICS_H */
+
+
+/* [] END OF FILE */
@@ -0,0 +1,722 @@
+/******************************************************************************
+* File Name: ota_mqtt_coexist.c
+*
+* Description: This file paces the OTA block requests so that the MQTT
+* publishes of the application keep a bounded latency during a transfer.
+*
+* The blocks streamed to the device share the MQTT connection, its receive
+* task and the network with the application traffic. While a transfer is in
+* progress, every publish of the application, that is of a task other than
+* the OTA agent task, is timed with the -Wl,--wrap linker option: from the
+* publish call to its PUBACK for QoS 1, to its send for QoS 0.
+*
+* The OTA requests are paced by a token bucket in bytes per second, applied
+* to the blocks of each request encoded by ota_block_size.c. The rate starts
+* unlimited and is set once per OTA_COEXIST_INTERVAL_MS:
+* - after an interval in which a publish took longer than
+*   CY_OTA_COEXIST_BUDGET_MS, to half the rate of that interval,
+* - after any other interval, OTA_COEXIST_RATE_STEP higher.
+* A request always asks for at least one block, so the transfer goes on at
+* one block per round trip when the bucket is empty.
+*
+* The progress of the transfer and the latency of the application publishes
+* are printed every OTA_COEXIST_REPORT_MS and can be read by the application
+* with ota_mqtt_coexist_get().
+*
+* Related Document: See README.md
+*
+*******************************************************************************
+* (c) 2020, Cypress Semiconductor Corporation. All rights reserved.
+*******************************************************************************
+* This software, including source code, documentation and related materials
+* ("Software"), is owned by Cypress Semiconductor Corporation or one of its
+* subsidiaries ("Cypress") and is protected by and subject to worldwide patent
+* protection (United States and foreign), United States copyright laws and
+* international treaty provisions. Therefore, you may use this Software only
+* as provided in the license agreement accompanying the software package from
+* which you obtained this Software ("EULA").
+*
+* If no EULA applies, Cypress hereby grants you a personal, non-exclusive,
+* non-transferable license to copy, modify, and compile the Software source
+* code solely for use in connection with Cypress's integrated circuit products.
+* Any reproduction, modification, translation, compilation, or representation
+* of this Software except as specified above is prohibited without the express
+* written permission of Cypress.
+*
+* Disclaimer: THIS SOFTWARE IS PROVIDED AS-IS, WITH NO WARRANTY OF ANY KIND,
+* EXPRESS OR IMPLIED, INCLUDING, BUT NOT LIMITED TO, NONINFRINGEMENT, IMPLIED
+* WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE. Cypress
+* reserves the right to make changes to the Software without notice. Cypress
+* does not assume any liability arising out of the application or use of the
+* Software or any product or circuit described in the Software. Cypress does
+* not authorize its products for use in any products where a malfunction or
+* failure of the Cypress product may reasonably be expected to result in
+* significant property damage, injury or death ("High Risk Product"). By
+* including Cypress's product in a High Risk Product, the manufacturer of such
+* system or application assumes all risk of such use and in doing so agrees to
+* indemnify Cypress against all liability.
+*******************************************************************************/
+#include <string.h>
+#include "FreeRTOS.h"
+#include "task.h"
+#include "timers.h"
+#include "iot_mqtt.h"
+#include "aws_iot_ota_agent.h"
+#include "aws_iot_ota_agent_internal.h"
+#include "ota_mqtt_coexist.h"
+
+#if defined(CY_OTA_MQTT_COEXIST)
+
+/*******************************************************************************
+ * Macros
+ ******************************************************************************/
+#define MS_PER_S                        (1000U)
+#define PERCENT                         (100U)
+
+
+/*******************************************************************************
+ * Data structure and enumeration
+ ******************************************************************************/
+/* Application publish waiting for its acknowledgement */
+typedef struct
+{
+    bool used;
+    TickType_t start;
+    IotMqttCallbackInfo_t callback;     /* Callback of the application */
+} coexist_pending_t;
+
+
+/*******************************************************************************
+ * Function prototypes
+ ******************************************************************************/
+IotMqttError_t __real_IotMqtt_PublishSync(IotMqttConnection_t mqttConnection,
+                                          const IotMqttPublishInfo_t *pPublishInfo,
+                                          uint32_t flags, uint32_t timeoutMs);
+IotMqttError_t __real_IotMqtt_PublishAsync(IotMqttConnection_t mqttConnection,
+                                           const IotMqttPublishInfo_t *pPublishInfo,
+                                           uint32_t flags,
+                                           const IotMqttCallbackInfo_t *pCallbackInfo,
+                                           IotMqttOperation_t *const pPublishOperation);
+
+IotMqttError_t __wrap_IotMqtt_PublishSync(IotMqttConnection_t mqttConnection,
+                                          const IotMqttPublishInfo_t *pPublishInfo,
+                                          uint32_t flags, uint32_t timeoutMs);
+IotMqttError_t __wrap_IotMqtt_PublishAsync(IotMqttConnection_t mqttConnection,
+                                           const IotMqttPublishInfo_t *pPublishInfo,
+                                           uint32_t flags,
+                                           const IotMqttCallbackInfo_t *pCallbackInfo,
+                                           IotMqttOperation_t *const pPublishOperation);
+
+
+/*******************************************************************************
+ * Global variables
+ ******************************************************************************/
+/* Transfer, set by the agent task */
+static const OTA_FileContext_t *file_ctx;
+static TaskHandle_t ota_task;
+static volatile bool coexist_active;
+
+/* Token bucket of the OTA requests, used by the agent task only */
+static uint32_t ota_rate;               /* Bytes per second */
+static int32_t tokens;                  /* Bytes, negative when in debt */
+static TickType_t tokens_tick;
+static TimerHandle_t refill_timer;
+static StaticTimer_t refill_timer_buffer;
+
+/* Current control interval */
+static TickType_t interval_start;
+static uint32_t interval_requested;     /* OTA bytes requested */
+static uint32_t interval_worst_ms;      /* Slowest application publish */
+static uint32_t interval_publishes;
+static TickType_t report_tick;
+
+/* Application publish latency of the transfer. Updated by the application
+ * tasks and the MQTT task, in critical sections.
+ */
+static uint32_t latency[OTA_COEXIST_LATENCY_BUCKETS];
+static uint32_t publishes;
+static uint32_t over_budget;
+static uint32_t max_ms;
+static uint32_t backoffs;
+
+static coexist_pending_t pending[OTA_COEXIST_PENDING];
+
+
+/*******************************************************************************
+ * Function definitions
+ ******************************************************************************/
+
+/*******************************************************************************
+ * Function Name: is_application
+ *******************************************************************************
+ * Summary:
+ *  Checks whether a publish is application traffic to time: a publish of a
+ *  task other than the OTA agent task during a transfer.
+ *
+ ******************************************************************************/
+static bool is_application(void)
+{
+    return coexist_active && (xTaskGetCurrentTaskHandle() != ota_task);
+}
+
+
+/*******************************************************************************
+ * Function Name: latency_record
+ *******************************************************************************
+ * Summary:
+ *  Adds the latency of an application publish to the statistics.
+ *
+ * Parameters:
+ *  start - tick count of the publish call
+ *
+ ******************************************************************************/
+static void latency_record(TickType_t start)
+{
+    uint32_t ms = (uint32_t)(xTaskGetTickCount() - start) * portTICK_PERIOD_MS;
+    uint32_t bound = OTA_COEXIST_LATENCY_BASE_MS;
+    uint32_t bucket = 0U;
+
+    while ((ms >= bound) && (bucket < (OTA_COEXIST_LATENCY_BUCKETS - 1U)))
+    {
+        bound *= 2U;
+        bucket++;
+    }
+
+    taskENTER_CRITICAL();
+    latency[bucket]++;
+    publishes++;
+    interval_publishes++;
+    if (ms > CY_OTA_COEXIST_BUDGET_MS)
+    {
+        over_budget++;
+    }
+    if (ms > max_ms)
+    {
+        max_ms = ms;
+    }
+    if (ms > interval_worst_ms)
+    {
+        interval_worst_ms = ms;
+    }
+    taskEXIT_CRITICAL();
+}
+
+
+/*******************************************************************************
+ * Function Name: latency_percentile
+ *******************************************************************************
+ * Summary:
+ *  Returns the upper bound of the histogram bucket that holds a percentile
+ *  of the application publish latency.
+ *
+ * Parameters:
+ *  pct - percentile
+ *
+ * Return:
+ *  uint32_t - latency in ms, 0 without publishes
+ *
+ ******************************************************************************/
+static uint32_t latency_percentile(uint32_t pct)
+{
+    uint32_t rank = ((publishes * pct) + PERCENT - 1U) / PERCENT;
+    uint32_t count = 0U;
+    uint32_t bound = OTA_COEXIST_LATENCY_BASE_MS;
+
+    if (0U == publishes)
+    {
+        return 0U;
+    }
+
+    for (uint32_t i = 0U; i < (OTA_COEXIST_LATENCY_BUCKETS - 1U); i++)
+    {
+        count += latency[i];
+        if (count >= rank)
+        {
+            return (bound < max_ms) ? bound : max_ms;
+        }
+        bound *= 2U;
+    }
+
+    return max_ms;
+}
+
+
+/*******************************************************************************
+ * Function Name: publish_complete
+ *******************************************************************************
+ * Summary:
+ *  Completion callback of an application publish: records its latency and
+ *  calls the callback of the application. Runs in the MQTT task.
+ *
+ * Parameters:
+ *  context - tracked publish
+ *  param - completion parameters
+ *
+ ******************************************************************************/
+static void publish_complete(void *context, IotMqttCallbackParam_t *param)
+{
+    coexist_pending_t *entry = (coexist_pending_t *)context;
+    IotMqttCallbackInfo_t callback = entry->callback;
+
+    latency_record(entry->start);
+
+    taskENTER_CRITICAL();
+    entry->used = false;
+    taskEXIT_CRITICAL();
+
+    callback.function(callback.pCallbackContext, param);
+}
+
+
+/*******************************************************************************
+ * Function Name: refill_timer_callback
+ *******************************************************************************
+ * Summary:
+ *  Asks the OTA agent for a block request once the bucket holds the blocks
+ *  that the last request could not ask for.
+ *
+ * Parameters:
+ *  timer - unused
+ *
+ ******************************************************************************/
+static void refill_timer_callback(TimerHandle_t timer)
+{
+    OTA_EventMsg_t event = { 0 };
+
+    (void)timer;
+
+    if (coexist_active)
+    {
+        event.xEventId = eOTA_AgentEvent_RequestFileBlock;
+        (void)OTA_SignalEvent(&event);
+    }
+}
+
+
+/*******************************************************************************
+ * Function Name: tokens_burst
+ *******************************************************************************
+ * Summary:
+ *  Returns the size of the bucket at the current rate.
+ *
+ ******************************************************************************/
+static int32_t tokens_burst(void)
+{
+    return (int32_t)(((uint64_t)ota_rate * OTA_COEXIST_BURST_MS) / MS_PER_S);
+}
+
+
+/*******************************************************************************
+ * Function Name: tokens_refill
+ *******************************************************************************
+ * Summary:
+ *  Adds the bytes earned at the current rate since the last refill.
+ *
+ * Parameters:
+ *  now - current tick count
+ *
+ ******************************************************************************/
+static void tokens_refill(TickType_t now)
+{
+    uint32_t ms = (uint32_t)(now - tokens_tick) * portTICK_PERIOD_MS;
+    uint64_t earned = ((uint64_t)ota_rate * ms) / MS_PER_S;
+
+    if (0U == earned)
+    {
+        return;
+    }
+
+    tokens_tick = now;
+    tokens = ((uint64_t)(tokens_burst() - tokens) < earned) ?
+             tokens_burst() : (tokens + (int32_t)earned);
+}
+
+
+/*******************************************************************************
+ * Function Name: rate_control
+ *******************************************************************************
+ * Summary:
+ *  Sets the OTA rate at the end of each control interval from the slowest
+ *  application publish of the interval.
+ *
+ * Parameters:
+ *  now - current tick count
+ *
+ ******************************************************************************/
+static void rate_control(TickType_t now)
+{
+    uint32_t ms = (uint32_t)(now - interval_start) * portTICK_PERIOD_MS;
+    uint32_t worst;
+    uint32_t count;
+
+    if (ms < OTA_COEXIST_INTERVAL_MS)
+    {
+        return;
+    }
+
+    taskENTER_CRITICAL();
+    worst = interval_worst_ms;
+    count = interval_publishes;
+    interval_worst_ms = 0U;
+    interval_publishes = 0U;
+    taskEXIT_CRITICAL();
+
+    if ((count > 0U) && (worst > CY_OTA_COEXIST_BUDGET_MS))
+    {
+        uint32_t measured = (uint32_t)(((uint64_t)interval_requested * MS_PER_S) / ms);
+        uint32_t base = (measured < ota_rate) ? measured : ota_rate;
+
+        if (OTA_COEXIST_RATE_UNLIMITED == ota_rate)
+        {
+            tokens = 0;
+            tokens_tick = now;
+        }
+        ota_rate = (base / 2U > OTA_COEXIST_RATE_MIN) ? (base / 2U) : OTA_COEXIST_RATE_MIN;
+        backoffs++;
+    }
+    else if (OTA_COEXIST_RATE_UNLIMITED != ota_rate)
+    {
+        ota_rate += OTA_COEXIST_RATE_STEP;
+    }
+
+    interval_start = now;
+    interval_requested = 0U;
+}
+
+
+/*******************************************************************************
+ * Function Name: coexist_report
+ *******************************************************************************
+ * Summary:
+ *  Prints the progress of the transfer and the latency of the application
+ *  publishes.
+ *
+ ******************************************************************************/
+static void coexist_report(void)
+{
+    ota_mqtt_coexist_stats_t stats;
+
+    ota_mqtt_coexist_get(&stats);
+
+    configPRINTF(("OTA coexist: %u of %u bytes, OTA rate %u B/s (%u backoffs), "
+                  "%u app publishes, p50 %u ms, p99 %u ms, max %u ms, %u over %u ms\r\n",
+                  (unsigned int)stats.received, (unsigned int)stats.file_size,
+                  (OTA_COEXIST_RATE_UNLIMITED == stats.ota_rate) ? 0U : (unsigned int)stats.ota_rate,
+                  (unsigned int)stats.backoffs, (unsigned int)stats.publishes,
+                  (unsigned int)stats.p50_ms, (unsigned int)stats.p99_ms,
+                  (unsigned int)stats.max_ms, (unsigned int)stats.over_budget,
+                  (unsigned int)CY_OTA_COEXIST_BUDGET_MS));
+}
+
+
+/*******************************************************************************
+ * Function Name: ota_mqtt_coexist_begin
+ *******************************************************************************
+ * Summary:
+ *  Starts the pacing of a new transfer, with an unlimited rate. Called by the
+ *  agent task when the file is opened.
+ *
+ * Parameters:
+ *  C - OTA file context
+ *
+ ******************************************************************************/
+void ota_mqtt_coexist_begin(const OTA_FileContext_t *C)
+{
+    TickType_t now = xTaskGetTickCount();
+
+    if (NULL == refill_timer)
+    {
+        refill_timer = xTimerCreateStatic("OTA coexist", 1U, pdFALSE, NULL,
+                                          refill_timer_callback, &refill_timer_buffer);
+    }
+
+    file_ctx = C;
+    ota_task = xTaskGetCurrentTaskHandle();
+    ota_rate = OTA_COEXIST_RATE_UNLIMITED;
+    tokens = 0;
+    tokens_tick = now;
+    interval_start = now;
+    interval_requested = 0U;
+    report_tick = now;
+    backoffs = 0U;
+
+    taskENTER_CRITICAL();
+    memset(latency, 0, sizeof(latency));
+    publishes = 0U;
+    over_budget = 0U;
+    max_ms = 0U;
+    interval_worst_ms = 0U;
+    interval_publishes = 0U;
+    coexist_active = true;
+    taskEXIT_CRITICAL();
+}
+
+
+/*******************************************************************************
+ * Function Name: ota_mqtt_coexist_end
+ *******************************************************************************
+ * Summary:
+ *  Ends the pacing when the file is closed or aborted, and prints the
+ *  statistics of the transfer.
+ *
+ ******************************************************************************/
+void ota_mqtt_coexist_end(void)
+{
+    if (!coexist_active)
+    {
+        return;
+    }
+
+    if (NULL != refill_timer)
+    {
+        (void)xTimerStop(refill_timer, 0U);
+    }
+
+    coexist_report();
+    coexist_active = false;
+}
+
+
+/*******************************************************************************
+ * Function Name: ota_mqtt_coexist_quota
+ *******************************************************************************
+ * Summary:
+ *  Returns how many blocks the request being encoded may ask for. When the
+ *  bucket holds fewer, the agent is asked for another request once it is
+ *  refilled. Called by the agent task.
+ *
+ * Parameters:
+ *  blocks - blocks the request would ask for
+ *  block_size - size of a block
+ *
+ * Return:
+ *  uint32_t - blocks allowed, at least 1
+ *
+ ******************************************************************************/
+uint32_t ota_mqtt_coexist_quota(uint32_t blocks, uint32_t block_size)
+{
+    TickType_t now = xTaskGetTickCount();
+    uint32_t allowed;
+    uint32_t wanted;
+
+    if (!coexist_active || (0U == block_size))
+    {
+        return blocks;
+    }
+
+    rate_control(now);
+
+    if ((uint32_t)(now - report_tick) >= pdMS_TO_TICKS(OTA_COEXIST_REPORT_MS))
+    {
+        report_tick = now;
+        coexist_report();
+    }
+
+    if (OTA_COEXIST_RATE_UNLIMITED == ota_rate)
+    {
+        return blocks;
+    }
+
+    tokens_refill(now);
+    allowed = (tokens > 0) ? ((uint32_t)tokens / block_size) : 0U;
+    if (allowed >= blocks)
+    {
+        return blocks;
+    }
+
+    /* Request again when the bucket holds what was asked for */
+    wanted = (blocks * block_size < (uint32_t)tokens_burst()) ?
+             (blocks * block_size) : (uint32_t)tokens_burst();
+    if ((NULL != refill_timer) && ((int32_t)wanted > tokens))
+    {
+        uint32_t ms = (uint32_t)((((uint64_t)((int32_t)wanted - tokens)) * MS_PER_S) / ota_rate);
+        TickType_t ticks = pdMS_TO_TICKS(ms);
+
+        (void)xTimerChangePeriod(refill_timer, (ticks > 0U) ? ticks : 1U, 0U);
+    }
+
+    return (allowed > 0U) ? allowed : 1U;
+}
+
+
+/*******************************************************************************
+ * Function Name: ota_mqtt_coexist_requested
+ *******************************************************************************
+ * Summary:
+ *  Takes the bytes of an encoded request from the bucket. The debt of the
+ *  requests of one block asked for with an empty bucket is limited to one
+ *  bucket.
+ *
+ * Parameters:
+ *  bytes - bytes requested
+ *
+ ******************************************************************************/
+void ota_mqtt_coexist_requested(uint32_t bytes)
+{
+    if (!coexist_active)
+    {
+        return;
+    }
+
+    interval_requested += bytes;
+
+    if (OTA_COEXIST_RATE_UNLIMITED != ota_rate)
+    {
+        tokens -= (int32_t)bytes;
+        if (tokens < -tokens_burst())
+        {
+            tokens = -tokens_burst();
+        }
+    }
+}
+
+
+/*******************************************************************************
+ * Function Name: ota_mqtt_coexist_get
+ *******************************************************************************
+ * Summary:
+ *  Returns the progress of the current or last transfer and the latency of
+ *  the application publishes during it.
+ *
+ * Parameters:
+ *  stats - statistics
+ *
+ ******************************************************************************/
+void ota_mqtt_coexist_get(ota_mqtt_coexist_stats_t *stats)
+{
+    uint32_t missing = 0U;
+
+    memset(stats, 0, sizeof(*stats));
+
+    taskENTER_CRITICAL();
+    stats->active = coexist_active;
+    stats->ota_rate = ota_rate;
+    stats->backoffs = backoffs;
+    stats->publishes = publishes;
+    stats->over_budget = over_budget;
+    stats->p50_ms = latency_percentile(50U);
+    stats->p99_ms = latency_percentile(99U);
+    stats->max_ms = max_ms;
+    taskEXIT_CRITICAL();
+
+    if (NULL != file_ctx)
+    {
+        stats->file_size = file_ctx->ulFileSize;
+        missing = file_ctx->ulBlocksRemaining * OTA_BLOCK_UNIT_SIZE;
+        stats->received = (missing < stats->file_size) ? (stats->file_size - missing) : 0U;
+    }
+}
+
+
+/*******************************************************************************
+ * Function Name: __wrap_IotMqtt_PublishSync
+ *******************************************************************************
+ * Summary:
+ *  Publishes a message and waits for its completion. An application publish
+ *  during a transfer is timed.
+ *
+ * Parameters:
+ *  See IotMqtt_PublishSync()
+ *
+ * Return:
+ *  IotMqttError_t - result of the publish
+ *
+ ******************************************************************************/
+IotMqttError_t __wrap_IotMqtt_PublishSync(IotMqttConnection_t mqttConnection,
+                                          const IotMqttPublishInfo_t *pPublishInfo,
+                                          uint32_t flags, uint32_t timeoutMs)
+{
+    TickType_t start = xTaskGetTickCount();
+    bool timed = is_application();
+    IotMqttError_t result = __real_IotMqtt_PublishSync(mqttConnection, pPublishInfo,
+                                                       flags, timeoutMs);
+
+    if (timed)
+    {
+        latency_record(start);
+    }
+
+    return result;
+}
+
+
+/*******************************************************************************
+ * Function Name: __wrap_IotMqtt_PublishAsync
+ *******************************************************************************
+ * Summary:
+ *  Starts a publish. An application publish of QoS 1 with a completion
+ *  callback is timed up to its completion, one of QoS 0 up to its send.
+ *
+ * Parameters:
+ *  See IotMqtt_PublishAsync()
+ *
+ * Return:
+ *  IotMqttError_t - result of the publish
+ *
+ ******************************************************************************/
+IotMqttError_t __wrap_IotMqtt_PublishAsync(IotMqttConnection_t mqttConnection,
+                                           const IotMqttPublishInfo_t *pPublishInfo,
+                                           uint32_t flags,
+                                           const IotMqttCallbackInfo_t *pCallbackInfo,
+                                           IotMqttOperation_t *const pPublishOperation)
+{
+    TickType_t start = xTaskGetTickCount();
+    coexist_pending_t *entry = NULL;
+    IotMqttCallbackInfo_t callback;
+    IotMqttError_t result;
+
+    if (!is_application())
+    {
+        return __real_IotMqtt_PublishAsync(mqttConnection, pPublishInfo, flags,
+                                           pCallbackInfo, pPublishOperation);
+    }
+
+    if ((NULL != pPublishInfo) && (IOT_MQTT_QOS_1 == pPublishInfo->qos) &&
+        (NULL != pCallbackInfo) && (NULL != pCallbackInfo->function))
+    {
+        taskENTER_CRITICAL();
+        for (uint32_t i = 0U; (i < OTA_COEXIST_PENDING) && (NULL == entry); i++)
+        {
+            if (!pending[i].used)
+            {
+                entry = &pending[i];
+                entry->used = true;
+            }
+        }
+        taskEXIT_CRITICAL();
+    }
+
+    if (NULL == entry)
+    {
+        result = __real_IotMqtt_PublishAsync(mqttConnection, pPublishInfo, flags,
+                                             pCallbackInfo, pPublishOperation);
+        if ((NULL != pPublishInfo) && (IOT_MQTT_QOS_0 == pPublishInfo->qos))
+        {
+            latency_record(start);
+        }
+        return result;
+    }
+
+    entry->start = start;
+    entry->callback = *pCallbackInfo;
+    callback.pCallbackContext = entry;
+    callback.function = publish_complete;
+
+    result = __real_IotMqtt_PublishAsync(mqttConnection, pPublishInfo, flags,
+                                         &callback, pPublishOperation);
+
+    /* Without a pending operation, the callback is not called */
+    if (IOT_MQTT_STATUS_PENDING != result)
+    {
+        taskENTER_CRITICAL();
+        entry->used = false;
+        taskEXIT_CRITICAL();
+    }
+
+    return result;
+}
+
+#endif /* CY_OTA_MQTT_COEXIST */
+
+
+/* [] END OF FILE */
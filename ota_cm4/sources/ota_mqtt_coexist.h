@@ -0,0 +1,124 @@
+/******************************************************************************
+* File Name: ota_mqtt_coexist.h
+*
+* Description: This file contains the macros, structures and function
+* declarations of the pacing of OTA block requests against the latency of the
+* application MQTT publishes.
+*
+* Related Document: See README.md
+*
+*******************************************************************************
+* (c) 2020, Cypress Semiconductor Corporation. All rights reserved.
+*******************************************************************************
+* This software, including source code, documentation and related materials
+* ("Software"), is owned by Cypress Semiconductor Corporation or one of its
+* subsidiaries ("Cypress") and is protected by and subject to worldwide patent
+* protection (United States and foreign), United States copyright laws and
+* international treaty provisions. Therefore, you may use this Software only
+* as provided in the license agreement accompanying the software package from
+* which you obtained this Software ("EULA").
+*
+* If no EULA applies, Cypress hereby grants you a personal, non-exclusive,
+* non-transferable license to copy, modify, and compile the Software source
+* code solely for use in connection with Cypress's integrated circuit products.
+* Any reproduction, modification, translation, compilation, or representation
+* of this Software except as specified above is prohibited without the express
+* written permission of Cypress.
+*
+* Disclaimer: THIS SOFTWARE IS PROVIDED AS-IS, WITH NO WARRANTY OF ANY KIND,
+* EXPRESS OR IMPLIED, INCLUDING, BUT NOT LIMITED TO, NONINFRINGEMENT, IMPLIED
+* WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE. Cypress
+* reserves the right to make changes to the Software without notice. Cypress
+* does not assume any liability arising out of the application or use of the
+* Software or any product or circuit described in the Software. Cypress does
+* not authorize its products for use in any products where a malfunction or
+* failure of the Cypress product may reasonably be expected to result in
+* significant property damage, injury or death ("High Risk Product"). By
+* including Cypress's product in a High Risk Product, the manufacturer of such
+* system or application assumes all risk of such use and in doing so agrees to
+* indemnify Cypress against all liability.
+*******************************************************************************/
+#ifndef OTA_MQTT_COEXIST_H
+#define OTA_MQTT_COEXIST_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "aws_iot_ota_agent.h"
+#include "ota_block_size.h"
+
+#if defined(CY_OTA_MQTT_COEXIST) && !defined(CY_OTA_BLOCK_STREAM)
+#error "CY_OTA_MQTT_COEXIST paces the requests encoded by ota_block_size.c"
+#endif
+
+
+/*******************************************************************************
+ * Macros
+ ******************************************************************************/
+/* Latency allowed to the application publishes during an OTA transfer: from
+ * the publish call to its PUBACK for QoS 1, to its send for QoS 0.
+ */
+#ifndef CY_OTA_COEXIST_BUDGET_MS
+#define CY_OTA_COEXIST_BUDGET_MS        (250U)
+#endif
+
+/* Interval of the rate control: the OTA rate is halved after an interval
+ * with a publish over budget, and grows by OTA_COEXIST_RATE_STEP after an
+ * interval without.
+ */
+#define OTA_COEXIST_INTERVAL_MS         (1000U)
+
+/* OTA rate limits and additive increase, in bytes per second */
+#define OTA_COEXIST_RATE_MIN            (1024UL)
+#define OTA_COEXIST_RATE_STEP           (2048UL)
+
+/* Bytes that may be requested at once, in milliseconds at the current rate */
+#define OTA_COEXIST_BURST_MS            (500U)
+
+/* Application publishes with an acknowledgement callback tracked at once */
+#define OTA_COEXIST_PENDING             (8U)
+
+/* Application publish latency histogram: bucket i counts the latencies below
+ * OTA_COEXIST_LATENCY_BASE_MS << i, the last one the rest.
+ */
+#define OTA_COEXIST_LATENCY_BUCKETS     (12U)
+#define OTA_COEXIST_LATENCY_BASE_MS     (4U)
+
+/* Interval of the progress line printed during a transfer */
+#define OTA_COEXIST_REPORT_MS           (10000U)
+
+/* No rate limit */
+#define OTA_COEXIST_RATE_UNLIMITED      (UINT32_MAX)
+
+
+/*******************************************************************************
+ * Data structure and enumeration
+ ******************************************************************************/
+typedef struct
+{
+    bool active;                /* An OTA transfer is in progress */
+    uint32_t file_size;         /* Bytes of the file */
+    uint32_t received;          /* Bytes of the file received */
+    uint32_t ota_rate;          /* OTA rate limit, bytes/s, or UNLIMITED */
+    uint32_t backoffs;          /* Intervals that halved the OTA rate */
+    uint32_t publishes;         /* Application publishes measured */
+    uint32_t over_budget;       /* ... that took longer than the budget */
+    uint32_t p50_ms;            /* Histogram bucket bounds of the latency */
+    uint32_t p99_ms;
+    uint32_t max_ms;
+} ota_mqtt_coexist_stats_t;
+
+
+/*******************************************************************************
+ * Function prototypes
+ ******************************************************************************/
+void ota_mqtt_coexist_begin(const OTA_FileContext_t *C);
+void ota_mqtt_coexist_end(void);
+uint32_t ota_mqtt_coexist_quota(uint32_t blocks, uint32_t block_size);
+void ota_mqtt_coexist_requested(uint32_t bytes);
+void ota_mqtt_coexist_get(ota_mqtt_coexist_stats_t *stats);
+
+
+#endif /* OTA_MQTT_COEXIST_H */
+
+
+/* [] END OF FILE */
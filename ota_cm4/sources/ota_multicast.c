@@ -0,0 +1,1856 @@
+/******************************************************************************
+* File Name: ota_multicast.c
+*
+* Description: This file implements the multicast distribution of a verified
+* OTA image to the devices of the LAN, with Reed-Solomon repair symbols.
+*
+* A device that verified an image keeps it in its secondary slot until the
+* image is activated, and sends it to a multicast group when devices that
+* start the same job ask for it. The image is sent once, in groups of
+* OTA_MULTICAST_GROUP_SYMBOLS source symbols followed by
+* CY_OTA_MULTICAST_REPAIR repair symbols of a systematic Cauchy Reed-Solomon
+* code over GF(2^8): a device rebuilds a group from any
+* OTA_MULTICAST_GROUP_SYMBOLS of its symbols. The blocks of the groups it
+* could not rebuild are left missing in the bitmap of the agent, which
+* requests them as usual, over MQTT or HTTP. The image is identified by a
+* hash of the signature of the job and by its size; the signature is checked
+* by the PAL as for any other download.
+*
+* Messages (UDP, CY_OTA_MULTICAST_GROUP:CY_OTA_MULTICAST_PORT), big endian:
+*   "OTAM", type (1 join, 2 offer, 3 symbol, 4 end), version, source symbols
+*   per group, repair symbols per group, group, symbol index, 0, image ID,
+*   image size, delay of the transfer in ms (offer)
+* A symbol message is followed by OTA_MULTICAST_SYMBOL_SIZE bytes: source
+* symbol i of a group has index i, repair symbol j has index
+* OTA_MULTICAST_GROUP_SYMBOLS + j. The last symbol of the image is padded
+* with zeros.
+*
+* A join is answered after a random delay, unless another device answers it
+* first, so that a single device sends the image. The transfer starts
+* OTA_MULTICAST_GATHER_MS after the offer; a device that joins during a
+* transfer receives the rest of it.
+*
+* A device receives a transfer in a task of its own, started once the PAL has
+* created the file, while the agent goes on. Each block is written once: the
+* receiver task and the agent claim the blocks they write, and a block
+* claimed by the other one is skipped. The blocks written by the transfer are
+* marked received in the bitmap of the agent from the agent task only, when
+* it writes a block or requests more, see ota_multicast_collect(). The task
+* signals a request to the agent when the transfer ends.
+*
+* Related Document: See README.md
+*
+*******************************************************************************
+* (c) 2020, Cypress Semiconductor Corporation. All rights reserved.
+*******************************************************************************
+* This software, including source code, documentation and related materials
+* ("Software"), is owned by Cypress Semiconductor Corporation or one of its
+* subsidiaries ("Cypress") and is protected by and subject to worldwide patent
+* protection (United States and foreign), United States copyright laws and
+* international treaty provisions. Therefore, you may use this Software only
+* as provided in the license agreement accompanying the software package from
+* which you obtained this Software ("EULA").
+*
+* If no EULA applies, Cypress hereby grants you a personal, non-exclusive,
+* non-transferable license to copy, modify, and compile the Software source
+* code solely for use in connection with Cypress's integrated circuit products.
+* Any reproduction, modification, translation, compilation, or representation
+* of this Software except as specified above is prohibited without the express
+* written permission of Cypress.
+*
+* Disclaimer: THIS SOFTWARE IS PROVIDED AS-IS, WITH NO WARRANTY OF ANY KIND,
+* EXPRESS OR IMPLIED, INCLUDING, BUT NOT LIMITED TO, NONINFRINGEMENT, IMPLIED
+* WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE. Cypress
+* reserves the right to make changes to the Software without notice. Cypress
+* does not assume any liability arising out of the application or use of the
+* Software or any product or circuit described in the Software. Cypress does
+* not authorize its products for use in any products where a malfunction or
+* failure of the Cypress product may reasonably be expected to result in
+* significant property damage, injury or death ("High Risk Product"). By
+* including Cypress's product in a High Risk Product, the manufacturer of such
+* system or application assumes all risk of such use and in doing so agrees to
+* indemnify Cypress against all liability.
+*******************************************************************************/
+#include <string.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include "FreeRTOS.h"
+#include "task.h"
+#include "semphr.h"
+#include "lwip/sockets.h"
+#include "sysflash/sysflash.h"
+#include "flash_map_backend/flash_map_backend.h"
+#include "aws_iot_ota_pal.h"
+#include "aws_iot_ota_agent_internal.h"
+#include "ota_multicast.h"
+
+#if defined(CY_OTA_MULTICAST)
+
+/*******************************************************************************
+ * Macros
+ ******************************************************************************/
+#define MCAST_HEADER_SIZE               (24U)
+#define MCAST_PACKET_SIZE               (MCAST_HEADER_SIZE + OTA_MULTICAST_SYMBOL_SIZE)
+#define MCAST_MSG_JOIN                  (1U)
+#define MCAST_MSG_OFFER                 (2U)
+#define MCAST_MSG_SYMBOL                (3U)
+#define MCAST_MSG_END                   (4U)
+#define MCAST_MSG_VERSION               (1U)
+
+#define MCAST_FNV_OFFSET                (2166136261UL)
+#define MCAST_FNV_PRIME                 (16777619UL)
+
+/* GF(2^8) of the code: x^8 + x^4 + x^3 + x^2 + 1, generator 2 */
+#define MCAST_GF_POLY                   (0x11DU)
+#define MCAST_GF_ORDER                  (255U)
+
+#define MCAST_SELECT_MS                 (1000U)
+#define MCAST_HOLD_POLL_MS              (1000U)
+#define MCAST_STOP_POLL_MS              (50U)
+
+/* Range of the random delay before a join is answered */
+#define MCAST_BACKOFF_MS                (250U)
+
+/* Packets a late transfer may send at once to catch up with its rate */
+#define MCAST_BURST_PACKETS             (4U)
+
+#define MCAST_US_PER_MS                 (1000ULL)
+#define MCAST_US_PER_S                  (1000000ULL)
+#define MCAST_NO_SOCKET                 (-1)
+#define MCAST_NO_REPAIR                 (0xFFU)
+#define BITS_PER_BYTE                   (8U)
+
+/* Time in microseconds to send one symbol at CY_OTA_MULTICAST_KBPS */
+#define MCAST_PACKET_US                 (((uint64_t)MCAST_PACKET_SIZE * BITS_PER_BYTE * MCAST_US_PER_MS) / \
+                                         CY_OTA_MULTICAST_KBPS)
+
+
+/*******************************************************************************
+ * Data structure and enumeration
+ ******************************************************************************/
+typedef enum
+{
+    MCAST_IDLE,                 /* Waiting for a join */
+    MCAST_BACKOFF,              /* Join received, offer sent at mcast_due */
+    MCAST_GATHER,               /* Offer sent, transfer starts at mcast_due */
+    MCAST_SENDING,              /* Transfer in progress */
+    MCAST_QUIET                 /* Another device answered the join */
+} mcast_state_t;
+
+/* Group being received */
+typedef struct
+{
+    OTA_FileContext_t *C;
+    ota_multicast_rx_stats_t *stats;
+    uint8_t *rows;              /* OTA_MULTICAST_GROUP_SYMBOLS symbols */
+    uint32_t group;
+    uint32_t sources;           /* Source symbols of the group */
+    uint32_t have;              /* Rows filled */
+    bool started;
+    bool done;
+    bool present[OTA_MULTICAST_GROUP_SYMBOLS];
+    uint8_t repair[OTA_MULTICAST_GROUP_SYMBOLS]; /* Repair symbol in a row */
+} mcast_rx_t;
+
+
+/*******************************************************************************
+ * Function prototypes
+ ******************************************************************************/
+static void mcast_task(void *arg);
+static void mcast_rx_task(void *arg);
+
+
+/*******************************************************************************
+ * Global variables
+ ******************************************************************************/
+static const uint8_t mcast_magic[4] = { 'O', 'T', 'A', 'M' };
+
+/* GF(2^8) tables, filled on first use */
+static uint8_t gf_exp[2U * MCAST_GF_ORDER];
+static uint8_t gf_log[MCAST_GF_ORDER + 1U];
+static bool gf_ready;
+
+/* Image sent. The slot is only read with the lock held, so that it is not
+ * read any more once ota_multicast_withdraw() returns.
+ */
+static SemaphoreHandle_t mcast_lock = NULL;
+static StaticSemaphore_t mcast_lock_buffer;
+static const struct flash_area *mcast_fa = NULL;
+static volatile bool mcast_serving;
+static uint32_t mcast_image_id;
+static uint32_t mcast_image_size;
+static volatile TickType_t mcast_last_join;
+static ota_multicast_stats_t mcast_stats;
+
+/* Sender task and its transfer */
+static bool mcast_task_started;
+static int mcast_socket = MCAST_NO_SOCKET;
+static volatile mcast_state_t mcast_state = MCAST_IDLE;
+static TickType_t mcast_due;
+static TickType_t mcast_quiet_tick;
+static TickType_t mcast_transfer_tick;
+static uint64_t mcast_next_us;          /* Next symbol, from the start */
+static uint32_t mcast_group;
+static uint32_t mcast_index;
+static uint32_t mcast_random;
+static uint8_t *mcast_buffer = NULL;    /* Group, then one packet */
+
+/* Receiver task and the file it writes. The claims of the units are made
+ * with mcast_rx_lock held. The bitmaps are kept until the file is closed or
+ * aborted.
+ */
+static SemaphoreHandle_t mcast_rx_lock = NULL;
+static StaticSemaphore_t mcast_rx_lock_buffer;
+static OTA_FileContext_t *mcast_rx_ctx = NULL;
+static TaskHandle_t mcast_rx_agent;     /* Task that created the file */
+static TaskHandle_t mcast_rx_self;      /* Receiver task */
+static volatile bool mcast_rx_running;
+static volatile bool mcast_rx_stop;
+static uint8_t *mcast_rx_written = NULL; /* Units written by the transfer */
+static uint8_t *mcast_rx_taken = NULL;  /* ... by the agent while it runs */
+static uint32_t mcast_rx_units;
+static ota_multicast_rx_stats_t mcast_rx_stats;
+
+
+/*******************************************************************************
+ * Function Name: mcast_put32
+ *******************************************************************************
+ * Summary:
+ *  Stores a big-endian 32-bit field of a message.
+ *
+ ******************************************************************************/
+static void mcast_put32(uint8_t *p, uint32_t value)
+{
+    p[0] = (uint8_t)(value >> 24);
+    p[1] = (uint8_t)(value >> 16);
+    p[2] = (uint8_t)(value >> 8);
+    p[3] = (uint8_t)value;
+}
+
+
+/*******************************************************************************
+ * Function Name: mcast_get32
+ *******************************************************************************
+ * Summary:
+ *  Loads a big-endian 32-bit field of a message.
+ *
+ ******************************************************************************/
+static uint32_t mcast_get32(const uint8_t *p)
+{
+    return ((uint32_t)p[0] << 24) | ((uint32_t)p[1] << 16) | ((uint32_t)p[2] << 8) | p[3];
+}
+
+
+/*******************************************************************************
+ * Function Name: mcast_reached
+ *******************************************************************************
+ * Summary:
+ *  Tells whether a tick is reached, across the wrap of the tick count.
+ *
+ ******************************************************************************/
+static bool mcast_reached(TickType_t now, TickType_t tick)
+{
+    return (TickType_t)(now - tick) < (TickType_t)(portMAX_DELAY / 2U);
+}
+
+
+/*******************************************************************************
+ * Function Name: mcast_msg_make
+ *******************************************************************************
+ * Summary:
+ *  Builds the header of a message.
+ *
+ * Parameters:
+ *  msg - MCAST_HEADER_SIZE bytes
+ *  type - MCAST_MSG_*
+ *  image_id - image ID
+ *  image_size - image size
+ *  group - group of the symbol, or next group sent in an offer
+ *  index - index of the symbol in its group
+ *  delay_ms - time until the transfer starts, in an offer
+ *
+ ******************************************************************************/
+static void mcast_msg_make(uint8_t *msg, uint8_t type, uint32_t image_id, uint32_t image_size,
+                           uint32_t group, uint32_t index, uint32_t delay_ms)
+{
+    memcpy(msg, mcast_magic, sizeof(mcast_magic));
+    msg[4] = type;
+    msg[5] = MCAST_MSG_VERSION;
+    msg[6] = (uint8_t)OTA_MULTICAST_GROUP_SYMBOLS;
+    msg[7] = (uint8_t)CY_OTA_MULTICAST_REPAIR;
+    msg[8] = (uint8_t)(group >> 8);
+    msg[9] = (uint8_t)group;
+    msg[10] = (uint8_t)index;
+    msg[11] = 0U;
+    mcast_put32(&msg[12], image_id);
+    mcast_put32(&msg[16], image_size);
+    mcast_put32(&msg[20], delay_ms);
+}
+
+
+/*******************************************************************************
+ * Function Name: mcast_msg_check
+ *******************************************************************************
+ * Summary:
+ *  Checks the header of a received message: a symbol must carry a whole
+ *  symbol, and the groups must be those of this version of the app.
+ *
+ * Parameters:
+ *  msg - message
+ *  len - number of bytes received
+ *
+ * Return:
+ *  uint8_t - type of the message, 0 if it is not valid
+ *
+ ******************************************************************************/
+static uint8_t mcast_msg_check(const uint8_t *msg, int len)
+{
+    if ((len < (int)MCAST_HEADER_SIZE) || (0 != memcmp(msg, mcast_magic, sizeof(mcast_magic))) ||
+        (MCAST_MSG_VERSION != msg[5]) || (OTA_MULTICAST_GROUP_SYMBOLS != msg[6]) ||
+        (msg[7] > OTA_MULTICAST_MAX_REPAIR))
+    {
+        return 0U;
+    }
+
+    if ((MCAST_MSG_SYMBOL == msg[4]) && (MCAST_PACKET_SIZE != len))
+    {
+        return 0U;
+    }
+
+    return msg[4];
+}
+
+
+/*******************************************************************************
+ * Function Name: mcast_group_sources
+ *******************************************************************************
+ * Summary:
+ *  Counts the source symbols of a group: the last group may be short.
+ *
+ * Parameters:
+ *  group - group
+ *  image_size - image size
+ *
+ * Return:
+ *  uint32_t - source symbols of the group, 0 past the end of the image
+ *
+ ******************************************************************************/
+static uint32_t mcast_group_sources(uint32_t group, uint32_t image_size)
+{
+    uint32_t symbols = (image_size + OTA_MULTICAST_SYMBOL_SIZE - 1U) / OTA_MULTICAST_SYMBOL_SIZE;
+    uint32_t first = group * OTA_MULTICAST_GROUP_SYMBOLS;
+
+    if (first >= symbols)
+    {
+        return 0U;
+    }
+
+    return ((symbols - first) < OTA_MULTICAST_GROUP_SYMBOLS) ? (symbols - first) :
+           OTA_MULTICAST_GROUP_SYMBOLS;
+}
+
+
+/*******************************************************************************
+ * Function Name: gf_init
+ *******************************************************************************
+ * Summary:
+ *  Fills the exponent and logarithm tables of GF(2^8). The exponent table is
+ *  doubled so that a product needs no modulo.
+ *
+ ******************************************************************************/
+static void gf_init(void)
+{
+    uint32_t x = 1U;
+
+    if (gf_ready)
+    {
+        return;
+    }
+
+    for (uint32_t i = 0U; i < MCAST_GF_ORDER; i++)
+    {
+        gf_exp[i] = (uint8_t)x;
+        gf_exp[i + MCAST_GF_ORDER] = (uint8_t)x;
+        gf_log[x] = (uint8_t)i;
+
+        x <<= 1;
+        if (0U != (x & 0x100U))
+        {
+            x ^= MCAST_GF_POLY;
+        }
+    }
+
+    gf_ready = true;
+}
+
+
+/*******************************************************************************
+ * Function Name: gf_mul
+ ******************************************************************************/
+static uint8_t gf_mul(uint8_t a, uint8_t b)
+{
+    if ((0U == a) || (0U == b))
+    {
+        return 0U;
+    }
+
+    return gf_exp[gf_log[a] + gf_log[b]];
+}
+
+
+/*******************************************************************************
+ * Function Name: gf_inv
+ ******************************************************************************/
+static uint8_t gf_inv(uint8_t a)
+{
+    return gf_exp[MCAST_GF_ORDER - gf_log[a]];
+}
+
+
+/*******************************************************************************
+ * Function Name: gf_mul_add
+ *******************************************************************************
+ * Summary:
+ *  Adds a multiple of a symbol to another: dst += coef * src.
+ *
+ * Parameters:
+ *  dst - symbol updated
+ *  src - symbol added
+ *  coef - coefficient
+ *
+ ******************************************************************************/
+static void gf_mul_add(uint8_t *dst, const uint8_t *src, uint8_t coef)
+{
+    const uint8_t *exp;
+
+    if (0U == coef)
+    {
+        return;
+    }
+
+    exp = &gf_exp[gf_log[coef]];
+
+    for (uint32_t i = 0U; i < OTA_MULTICAST_SYMBOL_SIZE; i++)
+    {
+        if (0U != src[i])
+        {
+            dst[i] ^= exp[gf_log[src[i]]];
+        }
+    }
+}
+
+
+/*******************************************************************************
+ * Function Name: gf_scale
+ *******************************************************************************
+ * Summary:
+ *  Multiplies a symbol by a coefficient, not 0.
+ *
+ ******************************************************************************/
+static void gf_scale(uint8_t *row, uint8_t coef)
+{
+    const uint8_t *exp = &gf_exp[gf_log[coef]];
+
+    for (uint32_t i = 0U; i < OTA_MULTICAST_SYMBOL_SIZE; i++)
+    {
+        if (0U != row[i])
+        {
+            row[i] = exp[gf_log[row[i]]];
+        }
+    }
+}
+
+
+/*******************************************************************************
+ * Function Name: mcast_coef
+ *******************************************************************************
+ * Summary:
+ *  Coefficient of source symbol i in repair symbol j: the Cauchy matrix
+ *  1 / (x_j + y_i) with x_j = OTA_MULTICAST_GROUP_SYMBOLS + j and y_i = i, of
+ *  which every square submatrix is invertible.
+ *
+ ******************************************************************************/
+static uint8_t mcast_coef(uint32_t j, uint32_t i)
+{
+    return gf_inv((uint8_t)((OTA_MULTICAST_GROUP_SYMBOLS + j) ^ i));
+}
+
+
+/*******************************************************************************
+ * Function Name: mcast_socket_open
+ *******************************************************************************
+ * Summary:
+ *  Opens a UDP socket on the port of the transfers, joined to the multicast
+ *  group and sending on CY_OTA_MULTICAST_INTERFACE.
+ *
+ * Return:
+ *  int - socket, or MCAST_NO_SOCKET on error
+ *
+ ******************************************************************************/
+static int mcast_socket_open(void)
+{
+    struct sockaddr_in addr;
+    struct ip_mreq mreq;
+    struct in_addr interface;
+    int one = 1;
+    int sock = socket(AF_INET, SOCK_DGRAM, 0);
+
+    if (sock < 0)
+    {
+        return MCAST_NO_SOCKET;
+    }
+
+    /* Fails without SO_REUSE in lwIP, where it is not needed */
+    (void)setsockopt(sock, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_ANY);
+    addr.sin_port = htons(CY_OTA_MULTICAST_PORT);
+
+    mreq.imr_multiaddr.s_addr = inet_addr(CY_OTA_MULTICAST_GROUP);
+    mreq.imr_interface.s_addr = inet_addr(CY_OTA_MULTICAST_INTERFACE);
+    interface.s_addr = inet_addr(CY_OTA_MULTICAST_INTERFACE);
+
+    if ((0 != bind(sock, (struct sockaddr *)&addr, sizeof(addr))) ||
+        (0 != setsockopt(sock, IPPROTO_IP, IP_ADD_MEMBERSHIP, &mreq, sizeof(mreq))) ||
+        (0 != setsockopt(sock, IPPROTO_IP, IP_MULTICAST_IF, &interface, sizeof(interface))))
+    {
+        (void)closesocket(sock);
+        return MCAST_NO_SOCKET;
+    }
+
+    return sock;
+}
+
+
+/*******************************************************************************
+ * Function Name: mcast_send
+ *******************************************************************************
+ * Summary:
+ *  Sends a message to the multicast group.
+ *
+ ******************************************************************************/
+static bool mcast_send(int sock, const uint8_t *msg, uint32_t len)
+{
+    struct sockaddr_in group;
+
+    memset(&group, 0, sizeof(group));
+    group.sin_family = AF_INET;
+    group.sin_addr.s_addr = inet_addr(CY_OTA_MULTICAST_GROUP);
+    group.sin_port = htons(CY_OTA_MULTICAST_PORT);
+
+    return (int)len == sendto(sock, msg, len, 0, (struct sockaddr *)&group, sizeof(group));
+}
+
+
+/*******************************************************************************
+ * Function Name: mcast_backoff
+ *******************************************************************************
+ * Summary:
+ *  Draws the delay before a join is answered (xorshift, seeded with the tick
+ *  of ota_multicast_serve(), which differs between devices).
+ *
+ * Return:
+ *  TickType_t - delay in ticks
+ *
+ ******************************************************************************/
+static TickType_t mcast_backoff(void)
+{
+    mcast_random ^= mcast_random << 13;
+    mcast_random ^= mcast_random >> 17;
+    mcast_random ^= mcast_random << 5;
+
+    return pdMS_TO_TICKS(mcast_random % MCAST_BACKOFF_MS);
+}
+
+
+/*******************************************************************************
+ * Function Name: mcast_send_offer
+ *******************************************************************************
+ * Summary:
+ *  Offers the transfer to the group: where it is and when it starts.
+ *
+ ******************************************************************************/
+static void mcast_send_offer(void)
+{
+    uint8_t msg[MCAST_HEADER_SIZE];
+    TickType_t now = xTaskGetTickCount();
+    uint32_t delay_ms = 0U;
+
+    if ((MCAST_GATHER == mcast_state) && !mcast_reached(now, mcast_due))
+    {
+        delay_ms = (uint32_t)(mcast_due - now) * portTICK_PERIOD_MS;
+    }
+
+    mcast_msg_make(msg, MCAST_MSG_OFFER, mcast_image_id, mcast_image_size,
+                   (MCAST_SENDING == mcast_state) ? mcast_group : 0U, 0U, delay_ms);
+    (void)mcast_send(mcast_socket, msg, MCAST_HEADER_SIZE);
+}
+
+
+/*******************************************************************************
+ * Function Name: mcast_sender_read
+ *******************************************************************************
+ * Summary:
+ *  Reads a message of the group. A join of the image sent is answered after a
+ *  random delay, or at once during a transfer. An offer or a symbol of
+ *  another device during that delay means that this device stays quiet.
+ *
+ ******************************************************************************/
+static void mcast_sender_read(void)
+{
+    uint8_t msg[MCAST_HEADER_SIZE + 1U];
+    struct sockaddr_in from;
+    socklen_t from_len = sizeof(from);
+    TickType_t now = xTaskGetTickCount();
+    uint8_t type;
+    bool match;
+    int len;
+
+    /* A symbol is cut after its header */
+    len = recvfrom(mcast_socket, msg, sizeof(msg), 0, (struct sockaddr *)&from, &from_len);
+    type = mcast_msg_check(msg, (len > (int)MCAST_HEADER_SIZE) ? (int)MCAST_PACKET_SIZE : len);
+
+    if (0U == type)
+    {
+        return;
+    }
+
+    (void)xSemaphoreTake(mcast_lock, portMAX_DELAY);
+    match = mcast_serving && (mcast_get32(&msg[12]) == mcast_image_id) &&
+            (mcast_get32(&msg[16]) == mcast_image_size);
+    if (match && (MCAST_MSG_JOIN == type))
+    {
+        mcast_last_join = now;
+        mcast_stats.joins++;
+    }
+    (void)xSemaphoreGive(mcast_lock);
+
+    if (!match)
+    {
+        return;
+    }
+
+    switch (type)
+    {
+        case MCAST_MSG_JOIN:
+            if (MCAST_IDLE == mcast_state)
+            {
+                mcast_due = now + mcast_backoff();
+                mcast_state = MCAST_BACKOFF;
+            }
+            else if ((MCAST_GATHER == mcast_state) || (MCAST_SENDING == mcast_state))
+            {
+                mcast_send_offer();
+            }
+            break;
+
+        case MCAST_MSG_OFFER:
+        case MCAST_MSG_SYMBOL:
+            if ((MCAST_BACKOFF == mcast_state) || (MCAST_QUIET == mcast_state))
+            {
+                mcast_quiet_tick = now;
+                mcast_state = MCAST_QUIET;
+            }
+            break;
+
+        case MCAST_MSG_END:
+            if (MCAST_QUIET == mcast_state)
+            {
+                mcast_state = MCAST_IDLE;
+            }
+            break;
+
+        default:
+            break;
+    }
+}
+
+
+/*******************************************************************************
+ * Function Name: mcast_read_group
+ *******************************************************************************
+ * Summary:
+ *  Reads the source symbols of a group from the slot, the last one padded
+ *  with zeros.
+ *
+ * Return:
+ *  bool - false if the image is not served any more
+ *
+ ******************************************************************************/
+static bool mcast_read_group(uint32_t group, uint32_t sources)
+{
+    uint32_t off = group * OTA_MULTICAST_GROUP_SYMBOLS * OTA_MULTICAST_SYMBOL_SIZE;
+    uint32_t len = sources * OTA_MULTICAST_SYMBOL_SIZE;
+    bool read;
+
+    if (len > (mcast_image_size - off))
+    {
+        len = mcast_image_size - off;
+    }
+
+    memset(&mcast_buffer[len], 0, (sources * OTA_MULTICAST_SYMBOL_SIZE) - len);
+
+    (void)xSemaphoreTake(mcast_lock, portMAX_DELAY);
+    read = mcast_serving && (0 == flash_area_read(mcast_fa, off, mcast_buffer, len));
+    (void)xSemaphoreGive(mcast_lock);
+
+    return read;
+}
+
+
+/*******************************************************************************
+ * Function Name: mcast_send_next
+ *******************************************************************************
+ * Summary:
+ *  Sends the next symbol of the transfer: the source symbols of a group, read
+ *  from the slot, then its repair symbols.
+ *
+ * Return:
+ *  bool - false once the transfer is over or the image is withdrawn
+ *
+ ******************************************************************************/
+static bool mcast_send_next(void)
+{
+    uint32_t sources = mcast_group_sources(mcast_group, mcast_image_size);
+    uint8_t *packet = &mcast_buffer[OTA_MULTICAST_GROUP_SYMBOLS * OTA_MULTICAST_SYMBOL_SIZE];
+    uint8_t *payload = &packet[MCAST_HEADER_SIZE];
+    uint32_t index;
+
+    if ((0U == mcast_index) && !mcast_read_group(mcast_group, sources))
+    {
+        return false;
+    }
+
+    if (mcast_index < sources)
+    {
+        index = mcast_index;
+        memcpy(payload, &mcast_buffer[index * OTA_MULTICAST_SYMBOL_SIZE], OTA_MULTICAST_SYMBOL_SIZE);
+    }
+    else
+    {
+        uint32_t j = mcast_index - sources;
+
+        index = OTA_MULTICAST_GROUP_SYMBOLS + j;
+        memset(payload, 0, OTA_MULTICAST_SYMBOL_SIZE);
+
+        for (uint32_t i = 0U; i < sources; i++)
+        {
+            gf_mul_add(payload, &mcast_buffer[i * OTA_MULTICAST_SYMBOL_SIZE], mcast_coef(j, i));
+        }
+    }
+
+    mcast_msg_make(packet, MCAST_MSG_SYMBOL, mcast_image_id, mcast_image_size,
+                   mcast_group, index, 0U);
+
+    if (mcast_send(mcast_socket, packet, MCAST_PACKET_SIZE))
+    {
+        (void)xSemaphoreTake(mcast_lock, portMAX_DELAY);
+        mcast_stats.packets++;
+        mcast_stats.bytes += MCAST_PACKET_SIZE;
+        (void)xSemaphoreGive(mcast_lock);
+    }
+
+    mcast_index++;
+    if (mcast_index == (sources + CY_OTA_MULTICAST_REPAIR))
+    {
+        mcast_index = 0U;
+        mcast_group++;
+    }
+
+    return 0U != mcast_group_sources(mcast_group, mcast_image_size);
+}
+
+
+/*******************************************************************************
+ * Function Name: mcast_transfer_start
+ *******************************************************************************
+ * Summary:
+ *  Starts a transfer from the first group.
+ *
+ ******************************************************************************/
+static void mcast_transfer_start(void)
+{
+    mcast_buffer = pvPortMalloc((OTA_MULTICAST_GROUP_SYMBOLS * OTA_MULTICAST_SYMBOL_SIZE) +
+                                MCAST_PACKET_SIZE);
+    if (NULL == mcast_buffer)
+    {
+        configPRINTF(("OTA multicast: no memory for a transfer\r\n"));
+        mcast_state = MCAST_IDLE;
+        return;
+    }
+
+    configPRINTF(("OTA multicast: sending image %08lx\r\n", (unsigned long)mcast_image_id));
+
+    mcast_group = 0U;
+    mcast_index = 0U;
+    mcast_next_us = 0U;
+    mcast_transfer_tick = xTaskGetTickCount();
+    mcast_state = MCAST_SENDING;
+}
+
+
+/*******************************************************************************
+ * Function Name: mcast_transfer_end
+ *******************************************************************************
+ * Summary:
+ *  Ends the transfer: the devices stop listening at the end messages.
+ *
+ ******************************************************************************/
+static void mcast_transfer_end(void)
+{
+    uint8_t msg[MCAST_HEADER_SIZE];
+
+    mcast_msg_make(msg, MCAST_MSG_END, mcast_image_id, mcast_image_size, mcast_group, 0U, 0U);
+
+    for (uint32_t i = 0U; i < OTA_MULTICAST_END_COUNT; i++)
+    {
+        (void)mcast_send(mcast_socket, msg, MCAST_HEADER_SIZE);
+    }
+
+    vPortFree(mcast_buffer);
+    mcast_buffer = NULL;
+
+    (void)xSemaphoreTake(mcast_lock, portMAX_DELAY);
+    mcast_stats.transfers++;
+    (void)xSemaphoreGive(mcast_lock);
+
+    configPRINTF(("OTA multicast: image %08lx sent, %lu symbols in all\r\n",
+                  (unsigned long)mcast_image_id, (unsigned long)mcast_stats.packets));
+
+    mcast_state = MCAST_IDLE;
+}
+
+
+/*******************************************************************************
+ * Function Name: mcast_task
+ *******************************************************************************
+ * Summary:
+ *  Task of the sender: answers the joins and sends the transfers at
+ *  CY_OTA_MULTICAST_KBPS.
+ *
+ * Parameters:
+ *  arg - unused
+ *
+ ******************************************************************************/
+static void mcast_task(void *arg)
+{
+    (void)arg;
+
+    mcast_socket = mcast_socket_open();
+    if (MCAST_NO_SOCKET == mcast_socket)
+    {
+        configPRINTF(("OTA multicast: cannot open the sender socket\r\n"));
+        mcast_task_started = false;
+        vTaskDelete(NULL);
+        return;
+    }
+
+    while (true)
+    {
+        TickType_t now = xTaskGetTickCount();
+        uint64_t wait_us = (uint64_t)MCAST_SELECT_MS * MCAST_US_PER_MS;
+        struct timeval timeout = { 0 };
+        fd_set readable;
+
+        if ((MCAST_BACKOFF == mcast_state) && mcast_reached(now, mcast_due))
+        {
+            mcast_due = now + pdMS_TO_TICKS(OTA_MULTICAST_GATHER_MS);
+            mcast_state = MCAST_GATHER;
+            mcast_send_offer();
+        }
+        else if ((MCAST_GATHER == mcast_state) && mcast_reached(now, mcast_due))
+        {
+            mcast_transfer_start();
+        }
+        else if ((MCAST_QUIET == mcast_state) &&
+                 ((now - mcast_quiet_tick) >= pdMS_TO_TICKS(OTA_MULTICAST_QUIET_MS)))
+        {
+            mcast_state = MCAST_IDLE;
+        }
+
+        if ((MCAST_BACKOFF == mcast_state) || (MCAST_GATHER == mcast_state))
+        {
+            wait_us = (uint64_t)(mcast_due - now) * portTICK_PERIOD_MS * MCAST_US_PER_MS;
+        }
+        else if (MCAST_SENDING == mcast_state)
+        {
+            uint64_t now_us = (uint64_t)(now - mcast_transfer_tick) * portTICK_PERIOD_MS * MCAST_US_PER_MS;
+
+            if ((now_us > mcast_next_us) && ((now_us - mcast_next_us) > (MCAST_BURST_PACKETS * MCAST_PACKET_US)))
+            {
+                mcast_next_us = now_us - (MCAST_BURST_PACKETS * MCAST_PACKET_US);
+            }
+
+            while ((MCAST_SENDING == mcast_state) && (mcast_next_us <= now_us))
+            {
+                mcast_next_us += MCAST_PACKET_US;
+
+                if (!mcast_send_next())
+                {
+                    mcast_transfer_end();
+                }
+            }
+
+            wait_us = (MCAST_SENDING == mcast_state) ? (mcast_next_us - now_us) : 0U;
+        }
+
+        timeout.tv_sec = (long)(wait_us / MCAST_US_PER_S);
+        timeout.tv_usec = (long)(wait_us % MCAST_US_PER_S);
+
+        FD_ZERO(&readable);
+        FD_SET(mcast_socket, &readable);
+
+        if (select(mcast_socket + 1, &readable, NULL, NULL, &timeout) > 0)
+        {
+            mcast_sender_read();
+        }
+    }
+}
+
+
+/*******************************************************************************
+ * Function Name: mcast_rx_claim
+ *******************************************************************************
+ * Summary:
+ *  Claims a unit for the receiver task, unless the agent wrote it. A unit
+ *  whose write failed is given back.
+ *
+ * Parameters:
+ *  unit - unit of the file
+ *  claim - true to claim the unit, false to give it back
+ *
+ * Return:
+ *  bool - true if the unit is claimed
+ *
+ ******************************************************************************/
+static bool mcast_rx_claim(uint32_t unit, bool claim)
+{
+    uint8_t mask = (uint8_t)(1U << (unit % BITS_PER_BYTE));
+    bool claimed = false;
+
+    (void)xSemaphoreTake(mcast_rx_lock, portMAX_DELAY);
+
+    if (!claim)
+    {
+        mcast_rx_written[unit / BITS_PER_BYTE] &= (uint8_t)~mask;
+    }
+    else if (0U == ((mcast_rx_written[unit / BITS_PER_BYTE] | mcast_rx_taken[unit / BITS_PER_BYTE]) & mask))
+    {
+        mcast_rx_written[unit / BITS_PER_BYTE] |= mask;
+        claimed = true;
+    }
+
+    (void)xSemaphoreGive(mcast_rx_lock);
+
+    return claimed;
+}
+
+
+/*******************************************************************************
+ * Function Name: mcast_rx_write
+ *******************************************************************************
+ * Summary:
+ *  Writes the symbols of the group held as source symbols through the PAL,
+ *  for the blocks the agent has neither received nor claimed. The blocks are
+ *  marked received in the bitmap of the agent by ota_multicast_collect().
+ *  The last block of the file is left to the agent, which closes the file
+ *  once it has received it.
+ *
+ * Parameters:
+ *  rx - group received
+ *
+ ******************************************************************************/
+static void mcast_rx_write(mcast_rx_t *rx)
+{
+    OTA_FileContext_t *C = rx->C;
+    uint32_t last_unit = (C->ulFileSize - 1U) / OTA_BLOCK_UNIT_SIZE;
+
+    for (uint32_t i = 0U; i < rx->sources; i++)
+    {
+        uint32_t off = ((rx->group * OTA_MULTICAST_GROUP_SYMBOLS) + i) * OTA_MULTICAST_SYMBOL_SIZE;
+        uint32_t end = ((C->ulFileSize - off) < OTA_MULTICAST_SYMBOL_SIZE) ? C->ulFileSize :
+                       (off + OTA_MULTICAST_SYMBOL_SIZE);
+
+        if (!rx->present[i] || (MCAST_NO_REPAIR != rx->repair[i]))
+        {
+            continue;
+        }
+
+        for (uint32_t unit = off / OTA_BLOCK_UNIT_SIZE; (unit * OTA_BLOCK_UNIT_SIZE) < end; unit++)
+        {
+            uint32_t unit_off = unit * OTA_BLOCK_UNIT_SIZE;
+            uint32_t len = ((end - unit_off) < OTA_BLOCK_UNIT_SIZE) ? (end - unit_off) : OTA_BLOCK_UNIT_SIZE;
+            uint8_t mask = (uint8_t)(1U << (unit % BITS_PER_BYTE));
+
+            if ((unit == last_unit) || (0U == (C->pucRxBlockBitmap[unit / BITS_PER_BYTE] & mask)) ||
+                !mcast_rx_claim(unit, true))
+            {
+                continue;
+            }
+
+            if (prvPAL_WriteBlock(C, unit_off, &rx->rows[(i * OTA_MULTICAST_SYMBOL_SIZE) + (unit_off - off)],
+                                  len) == (int16_t)len)
+            {
+                rx->stats->units++;
+            }
+            else
+            {
+                (void)mcast_rx_claim(unit, false);
+            }
+        }
+    }
+}
+
+
+/*******************************************************************************
+ * Function Name: mcast_rx_decode
+ *******************************************************************************
+ * Summary:
+ *  Rebuilds the missing source symbols of a complete group. The row of each
+ *  missing source symbol holds a repair symbol: the known source symbols are
+ *  taken out of it, and the Cauchy system left is solved by Gauss-Jordan
+ *  elimination on the rows, which then hold the missing source symbols.
+ *
+ * Parameters:
+ *  rx - complete group
+ *
+ * Return:
+ *  bool - true if the group was rebuilt
+ *
+ ******************************************************************************/
+static bool mcast_rx_decode(mcast_rx_t *rx)
+{
+    uint8_t matrix[OTA_MULTICAST_MAX_REPAIR][OTA_MULTICAST_MAX_REPAIR];
+    uint8_t missing[OTA_MULTICAST_MAX_REPAIR];
+    uint32_t count = 0U;
+
+    for (uint32_t i = 0U; i < rx->sources; i++)
+    {
+        if (MCAST_NO_REPAIR != rx->repair[i])
+        {
+            missing[count++] = (uint8_t)i;
+        }
+    }
+
+    if (0U == count)
+    {
+        return true;
+    }
+
+    for (uint32_t a = 0U; a < count; a++)
+    {
+        uint8_t *row = &rx->rows[missing[a] * OTA_MULTICAST_SYMBOL_SIZE];
+        uint32_t j = rx->repair[missing[a]];
+
+        for (uint32_t i = 0U; i < rx->sources; i++)
+        {
+            if (MCAST_NO_REPAIR == rx->repair[i])
+            {
+                gf_mul_add(row, &rx->rows[i * OTA_MULTICAST_SYMBOL_SIZE], mcast_coef(j, i));
+            }
+        }
+
+        for (uint32_t b = 0U; b < count; b++)
+        {
+            matrix[a][b] = mcast_coef(j, missing[b]);
+        }
+    }
+
+    for (uint32_t b = 0U; b < count; b++)
+    {
+        uint8_t *pivot_row;
+        uint32_t pivot = b;
+        uint8_t inv;
+
+        while ((pivot < count) && (0U == matrix[pivot][b]))
+        {
+            pivot++;
+        }
+
+        if (pivot == count)
+        {
+            return false;
+        }
+
+        if (pivot != b)
+        {
+            uint8_t *x = &rx->rows[missing[pivot] * OTA_MULTICAST_SYMBOL_SIZE];
+            uint8_t *y = &rx->rows[missing[b] * OTA_MULTICAST_SYMBOL_SIZE];
+
+            for (uint32_t k = 0U; k < count; k++)
+            {
+                uint8_t t = matrix[pivot][k];
+
+                matrix[pivot][k] = matrix[b][k];
+                matrix[b][k] = t;
+            }
+
+            for (uint32_t k = 0U; k < OTA_MULTICAST_SYMBOL_SIZE; k++)
+            {
+                uint8_t t = x[k];
+
+                x[k] = y[k];
+                y[k] = t;
+            }
+        }
+
+        pivot_row = &rx->rows[missing[b] * OTA_MULTICAST_SYMBOL_SIZE];
+        inv = gf_inv(matrix[b][b]);
+
+        for (uint32_t k = 0U; k < count; k++)
+        {
+            matrix[b][k] = gf_mul(matrix[b][k], inv);
+        }
+        gf_scale(pivot_row, inv);
+
+        for (uint32_t a = 0U; a < count; a++)
+        {
+            uint8_t f = matrix[a][b];
+
+            if ((a == b) || (0U == f))
+            {
+                continue;
+            }
+
+            for (uint32_t k = 0U; k < count; k++)
+            {
+                matrix[a][k] ^= gf_mul(f, matrix[b][k]);
+            }
+            gf_mul_add(&rx->rows[missing[a] * OTA_MULTICAST_SYMBOL_SIZE], pivot_row, f);
+        }
+    }
+
+    for (uint32_t a = 0U; a < count; a++)
+    {
+        rx->repair[missing[a]] = MCAST_NO_REPAIR;
+    }
+
+    rx->stats->recovered++;
+
+    return true;
+}
+
+
+/*******************************************************************************
+ * Function Name: mcast_rx_finish
+ *******************************************************************************
+ * Summary:
+ *  Ends the group received: an incomplete group has its source symbols
+ *  written, the rest of it is left to the agent.
+ *
+ ******************************************************************************/
+static void mcast_rx_finish(mcast_rx_t *rx)
+{
+    if (rx->started && !rx->done)
+    {
+        rx->stats->incomplete++;
+        mcast_rx_write(rx);
+        rx->done = true;
+    }
+}
+
+
+/*******************************************************************************
+ * Function Name: mcast_rx_symbol
+ *******************************************************************************
+ * Summary:
+ *  Adds a symbol to the group received. A repair symbol takes the row of a
+ *  missing source symbol; a source symbol received late takes its row back.
+ *  The group is rebuilt and written once it has as many symbols as source
+ *  symbols.
+ *
+ * Parameters:
+ *  rx - group received
+ *  group - group of the symbol
+ *  index - index of the symbol in its group
+ *  payload - symbol
+ *
+ ******************************************************************************/
+static void mcast_rx_symbol(mcast_rx_t *rx, uint32_t group, uint32_t index, const uint8_t *payload)
+{
+    uint32_t sources = mcast_group_sources(group, rx->C->ulFileSize);
+    uint32_t row;
+
+    if ((0U == sources) || (rx->started && (group < rx->group)))
+    {
+        return;
+    }
+
+    if (!rx->started || (group > rx->group))
+    {
+        mcast_rx_finish(rx);
+        rx->group = group;
+        rx->sources = sources;
+        rx->have = 0U;
+        rx->started = true;
+        rx->done = false;
+        memset(rx->present, 0, sizeof(rx->present));
+        memset(rx->repair, MCAST_NO_REPAIR, sizeof(rx->repair));
+        rx->stats->groups++;
+    }
+
+    if (rx->done)
+    {
+        return;
+    }
+
+    if (index < OTA_MULTICAST_GROUP_SYMBOLS)
+    {
+        row = index;
+
+        if ((row >= sources) || (rx->present[row] && (MCAST_NO_REPAIR == rx->repair[row])))
+        {
+            return;
+        }
+
+        rx->have += rx->present[row] ? 0U : 1U;
+        rx->repair[row] = MCAST_NO_REPAIR;
+    }
+    else
+    {
+        uint32_t j = index - OTA_MULTICAST_GROUP_SYMBOLS;
+
+        for (row = 0U; (row < sources) && rx->present[row]; row++)
+        {
+        }
+
+        if ((j >= OTA_MULTICAST_MAX_REPAIR) || (row == sources))
+        {
+            return;
+        }
+
+        rx->have++;
+        rx->repair[row] = (uint8_t)j;
+    }
+
+    rx->present[row] = true;
+    memcpy(&rx->rows[row * OTA_MULTICAST_SYMBOL_SIZE], payload, OTA_MULTICAST_SYMBOL_SIZE);
+    rx->stats->packets++;
+
+    if ((rx->have == rx->sources) && mcast_rx_decode(rx))
+    {
+        mcast_rx_write(rx);
+        rx->done = true;
+    }
+}
+
+
+/*******************************************************************************
+ * Function Name: mcast_rx_join
+ *******************************************************************************
+ * Summary:
+ *  Asks the group for a transfer of the image, and waits for an offer.
+ *
+ * Parameters:
+ *  sock - socket of the group
+ *  image_id - image ID
+ *  image_size - image size
+ *  sender - set to the address of the device that offered the transfer
+ *  delay_ms - set to the time until the transfer starts
+ *
+ * Return:
+ *  bool - true if a transfer was offered
+ *
+ ******************************************************************************/
+static bool mcast_rx_join(int sock, uint32_t image_id, uint32_t image_size,
+                          struct sockaddr_in *sender, uint32_t *delay_ms)
+{
+    uint8_t msg[MCAST_HEADER_SIZE];
+
+    for (uint32_t tries = 0U; tries < OTA_MULTICAST_JOIN_TRIES; tries++)
+    {
+        TickType_t start = xTaskGetTickCount();
+        TickType_t wait = pdMS_TO_TICKS(OTA_MULTICAST_JOIN_WAIT_MS);
+
+        mcast_msg_make(msg, MCAST_MSG_JOIN, image_id, image_size, 0U, 0U, 0U);
+        if (!mcast_send(sock, msg, MCAST_HEADER_SIZE))
+        {
+            return false;
+        }
+
+        while ((xTaskGetTickCount() - start) < wait)
+        {
+            TickType_t left = wait - (xTaskGetTickCount() - start);
+            struct timeval timeout = { 0 };
+            socklen_t from_len = sizeof(*sender);
+            fd_set readable;
+            int len;
+
+            timeout.tv_sec = (long)((left * portTICK_PERIOD_MS) / 1000U);
+            timeout.tv_usec = (long)(((left * portTICK_PERIOD_MS) % 1000U) * 1000U);
+
+            FD_ZERO(&readable);
+            FD_SET(sock, &readable);
+
+            if (select(sock + 1, &readable, NULL, NULL, &timeout) <= 0)
+            {
+                break;
+            }
+
+            len = recvfrom(sock, msg, sizeof(msg), 0, (struct sockaddr *)sender, &from_len);
+
+            if ((MCAST_MSG_OFFER == mcast_msg_check(msg, len)) &&
+                (mcast_get32(&msg[12]) == image_id) && (mcast_get32(&msg[16]) == image_size))
+            {
+                *delay_ms = mcast_get32(&msg[20]);
+                return true;
+            }
+        }
+    }
+
+    return false;
+}
+
+
+/*******************************************************************************
+ * Function Name: mcast_rx_task
+ *******************************************************************************
+ * Summary:
+ *  Task of the receiver: asks the group for the file of mcast_rx_ctx and
+ *  receives the transfer offered, if any. Ends at the end of the transfer,
+ *  after OTA_MULTICAST_QUIET_MS without a symbol, or when
+ *  ota_multicast_receive_stop() is called. Unless stopped, it then signals
+ *  a request to the agent, for the blocks still missing.
+ *
+ * Parameters:
+ *  arg - unused
+ *
+ ******************************************************************************/
+static void mcast_rx_task(void *arg)
+{
+    OTA_FileContext_t *C = mcast_rx_ctx;
+    OTA_EventMsg_t event = { 0 };
+    mcast_rx_t rx;
+    struct sockaddr_in sender;
+    uint32_t image_id;
+    uint32_t delay_ms = 0U;
+    uint32_t last_group;
+    uint8_t *packet = NULL;
+    TickType_t deadline;
+    bool stopped;
+    int sock;
+
+    (void)arg;
+
+    mcast_rx_self = xTaskGetCurrentTaskHandle();
+
+    gf_init();
+    image_id = ota_multicast_image_id(C->pxSignature->ucData, C->pxSignature->usSize);
+    last_group = ((C->ulFileSize + OTA_MULTICAST_SYMBOL_SIZE - 1U) / OTA_MULTICAST_SYMBOL_SIZE - 1U) /
+                 OTA_MULTICAST_GROUP_SYMBOLS;
+
+    sock = mcast_socket_open();
+    if ((MCAST_NO_SOCKET != sock) && mcast_rx_join(sock, image_id, C->ulFileSize, &sender, &delay_ms))
+    {
+        packet = pvPortMalloc((OTA_MULTICAST_GROUP_SYMBOLS * OTA_MULTICAST_SYMBOL_SIZE) + MCAST_PACKET_SIZE);
+    }
+
+    if (NULL != packet)
+    {
+        configPRINTF(("OTA multicast: transfer offered, starting in %lu ms\r\n", (unsigned long)delay_ms));
+
+        memset(&rx, 0, sizeof(rx));
+        rx.C = C;
+        rx.stats = &mcast_rx_stats;
+        rx.rows = &packet[MCAST_PACKET_SIZE];
+
+        deadline = xTaskGetTickCount() + pdMS_TO_TICKS(delay_ms + OTA_MULTICAST_QUIET_MS);
+
+        while (!mcast_rx_stop && !(rx.done && (rx.group == last_group)))
+        {
+            TickType_t left = deadline - xTaskGetTickCount();
+            struct sockaddr_in from;
+            socklen_t from_len = sizeof(from);
+            struct timeval timeout = { 0 };
+            fd_set readable;
+            uint8_t type;
+            int ready;
+            int len;
+
+            if (left > (TickType_t)(portMAX_DELAY / 2U))
+            {
+                break;
+            }
+
+            /* Wake up at least every MCAST_SELECT_MS to see a stop */
+            if (left > pdMS_TO_TICKS(MCAST_SELECT_MS))
+            {
+                left = pdMS_TO_TICKS(MCAST_SELECT_MS);
+            }
+
+            timeout.tv_sec = (long)((left * portTICK_PERIOD_MS) / 1000U);
+            timeout.tv_usec = (long)(((left * portTICK_PERIOD_MS) % 1000U) * 1000U);
+
+            FD_ZERO(&readable);
+            FD_SET(sock, &readable);
+
+            ready = select(sock + 1, &readable, NULL, NULL, &timeout);
+            if (ready < 0)
+            {
+                break;
+            }
+
+            if (0 == ready)
+            {
+                continue;
+            }
+
+            len = recvfrom(sock, packet, MCAST_PACKET_SIZE, 0, (struct sockaddr *)&from, &from_len);
+            type = mcast_msg_check(packet, len);
+
+            if ((0U == type) || (from.sin_addr.s_addr != sender.sin_addr.s_addr) ||
+                (from.sin_port != sender.sin_port) || (mcast_get32(&packet[12]) != image_id) ||
+                (mcast_get32(&packet[16]) != C->ulFileSize))
+            {
+                continue;
+            }
+
+            if (MCAST_MSG_END == type)
+            {
+                break;
+            }
+
+            if (MCAST_MSG_SYMBOL == type)
+            {
+                deadline = xTaskGetTickCount() + pdMS_TO_TICKS(OTA_MULTICAST_QUIET_MS);
+                mcast_rx_symbol(&rx, ((uint32_t)packet[8] << 8) | packet[9], packet[10],
+                                &packet[MCAST_HEADER_SIZE]);
+            }
+        }
+
+        if (!mcast_rx_stop)
+        {
+            mcast_rx_finish(&rx);
+        }
+
+        vPortFree(packet);
+
+        configPRINTF(("OTA multicast: %lu of %lu blocks received, %lu groups rebuilt with repair symbols, "
+                      "%lu incomplete\r\n", (unsigned long)mcast_rx_stats.units,
+                      (unsigned long)mcast_rx_units, (unsigned long)mcast_rx_stats.recovered,
+                      (unsigned long)mcast_rx_stats.incomplete));
+    }
+
+    if (MCAST_NO_SOCKET != sock)
+    {
+        (void)closesocket(sock);
+    }
+
+    /* The stop is read before the end is seen: the file may be opened again
+     * as soon as ota_multicast_receive_stop() returns.
+     */
+    stopped = mcast_rx_stop;
+    mcast_rx_self = NULL;
+    mcast_rx_running = false;
+
+    if (!stopped)
+    {
+        event.xEventId = eOTA_AgentEvent_RequestFileBlock;
+        (void)OTA_SignalEvent(&event);
+    }
+
+    vTaskDelete(NULL);
+}
+
+
+/*******************************************************************************
+ * Function Name: ota_multicast_image_id
+ *******************************************************************************
+ * Summary:
+ *  Derives the ID of an image from the signature of its job (FNV-1a), as
+ *  ota_peer.c does.
+ *
+ * Parameters:
+ *  signature - signature of the job
+ *  len - size of the signature
+ *
+ * Return:
+ *  uint32_t - image ID
+ *
+ ******************************************************************************/
+uint32_t ota_multicast_image_id(const uint8_t *signature, uint32_t len)
+{
+    uint32_t hash = MCAST_FNV_OFFSET;
+
+    for (uint32_t i = 0U; (NULL != signature) && (i < len); i++)
+    {
+        hash = (hash ^ signature[i]) * MCAST_FNV_PRIME;
+    }
+
+    return hash;
+}
+
+
+/*******************************************************************************
+ * Function Name: ota_multicast_receive_start
+ *******************************************************************************
+ * Summary:
+ *  Starts the receiver task for the file, which asks the group for a
+ *  transfer and writes the blocks it receives through the PAL. Must be
+ *  called by the agent task once the PAL has opened the file, before the
+ *  first block is requested. Returns at once: the agent goes on while the
+ *  task runs.
+ *
+ * Parameters:
+ *  C - OTA file context
+ *
+ ******************************************************************************/
+void ota_multicast_receive_start(OTA_FileContext_t *C)
+{
+    uint32_t bytes;
+
+    ota_multicast_receive_stop();
+    memset(&mcast_rx_stats, 0, sizeof(mcast_rx_stats));
+
+    if ((NULL == C->pxSignature) || (C->ulFileSize <= OTA_BLOCK_UNIT_SIZE))
+    {
+        return;
+    }
+
+    if (NULL == mcast_rx_lock)
+    {
+        mcast_rx_lock = xSemaphoreCreateMutexStatic(&mcast_rx_lock_buffer);
+    }
+
+    mcast_rx_units = (C->ulFileSize + OTA_BLOCK_UNIT_SIZE - 1U) / OTA_BLOCK_UNIT_SIZE;
+    bytes = (mcast_rx_units + BITS_PER_BYTE - 1U) / BITS_PER_BYTE;
+
+    mcast_rx_written = pvPortMalloc(2U * bytes);
+    if (NULL == mcast_rx_written)
+    {
+        return;
+    }
+
+    memset(mcast_rx_written, 0, 2U * bytes);
+    mcast_rx_taken = &mcast_rx_written[bytes];
+    mcast_rx_ctx = C;
+    mcast_rx_agent = xTaskGetCurrentTaskHandle();
+    mcast_rx_stop = false;
+    mcast_rx_running = true;
+
+    if (pdPASS != xTaskCreate(mcast_rx_task, "OTA multicast rx", OTA_MULTICAST_TASK_STACK_SIZE, NULL,
+                              OTA_MULTICAST_TASK_PRIORITY, NULL))
+    {
+        configPRINTF(("OTA multicast: cannot start the receiver task\r\n"));
+        mcast_rx_running = false;
+        ota_multicast_receive_stop();
+    }
+}
+
+
+/*******************************************************************************
+ * Function Name: ota_multicast_receive_stop
+ *******************************************************************************
+ * Summary:
+ *  Stops the receiver task, waiting for it to end, and forgets the file.
+ *  Called when the file is closed or aborted.
+ *
+ ******************************************************************************/
+void ota_multicast_receive_stop(void)
+{
+    mcast_rx_stop = true;
+
+    while (mcast_rx_running)
+    {
+        vTaskDelay(pdMS_TO_TICKS(MCAST_STOP_POLL_MS));
+    }
+
+    if (NULL != mcast_rx_written)
+    {
+        (void)xSemaphoreTake(mcast_rx_lock, portMAX_DELAY);
+        vPortFree(mcast_rx_written);
+        mcast_rx_written = NULL;
+        mcast_rx_taken = NULL;
+        mcast_rx_ctx = NULL;
+        (void)xSemaphoreGive(mcast_rx_lock);
+    }
+}
+
+
+/*******************************************************************************
+ * Function Name: ota_multicast_receiving
+ *******************************************************************************
+ * Summary:
+ *  Tells whether the receiver task runs. The HTTP ranges are only requested
+ *  once it has ended.
+ *
+ * Return:
+ *  bool - true while the task runs
+ *
+ ******************************************************************************/
+bool ota_multicast_receiving(void)
+{
+    return mcast_rx_running;
+}
+
+
+/*******************************************************************************
+ * Function Name: ota_multicast_collect
+ *******************************************************************************
+ * Summary:
+ *  Marks received in the bitmap of the agent the blocks written by the
+ *  transfer, except those of the range being written. One block is always
+ *  left to the agent, which closes the file once it has received it. Does
+ *  nothing outside of the agent task, which alone updates its bitmap.
+ *
+ * Parameters:
+ *  C - OTA file context
+ *  off - offset of the range being written
+ *  len - size of the range, 0 if none
+ *
+ ******************************************************************************/
+void ota_multicast_collect(OTA_FileContext_t *C, uint32_t off, uint32_t len)
+{
+    uint32_t first = off / OTA_BLOCK_UNIT_SIZE;
+    uint32_t end = (0U == len) ? first : (((off + len - 1U) / OTA_BLOCK_UNIT_SIZE) + 1U);
+    uint32_t bytes = (mcast_rx_units + BITS_PER_BYTE - 1U) / BITS_PER_BYTE;
+
+    if ((NULL == mcast_rx_ctx) || (C != mcast_rx_ctx) || (xTaskGetCurrentTaskHandle() != mcast_rx_agent))
+    {
+        return;
+    }
+
+    (void)xSemaphoreTake(mcast_rx_lock, portMAX_DELAY);
+
+    for (uint32_t i = 0U; (NULL != mcast_rx_written) && (i < bytes) && (C->ulBlocksRemaining > 1U); i++)
+    {
+        uint8_t merge = mcast_rx_written[i] & C->pucRxBlockBitmap[i];
+
+        for (uint32_t bit = 0U; (0U != merge) && (bit < BITS_PER_BYTE) && (C->ulBlocksRemaining > 1U); bit++)
+        {
+            uint32_t unit = (i * BITS_PER_BYTE) + bit;
+            uint8_t mask = (uint8_t)(1U << bit);
+
+            if ((0U != (merge & mask)) && ((unit < first) || (unit >= end)))
+            {
+                C->pucRxBlockBitmap[i] &= (uint8_t)~mask;
+                C->ulBlocksRemaining--;
+            }
+        }
+    }
+
+    (void)xSemaphoreGive(mcast_rx_lock);
+}
+
+
+/*******************************************************************************
+ * Function Name: ota_multicast_written
+ *******************************************************************************
+ * Summary:
+ *  Called by the PAL before a range of the file is written by a task other
+ *  than the receiver task. In the agent task, the blocks written by the
+ *  transfer are collected first. A range whose blocks were all written by
+ *  the transfer is not written again; otherwise, while the transfer runs,
+ *  its blocks are claimed so that the transfer skips them.
+ *
+ * Parameters:
+ *  C - OTA file context
+ *  off - offset of the range
+ *  len - size of the range
+ *
+ * Return:
+ *  bool - true if the transfer already wrote the range
+ *
+ ******************************************************************************/
+bool ota_multicast_written(OTA_FileContext_t *C, uint32_t off, uint32_t len)
+{
+    uint32_t first = off / OTA_BLOCK_UNIT_SIZE;
+    uint32_t end = ((off + len - 1U) / OTA_BLOCK_UNIT_SIZE) + 1U;
+    bool written = false;
+
+    if ((NULL == mcast_rx_ctx) || (C != mcast_rx_ctx) || (0U == len) ||
+        (xTaskGetCurrentTaskHandle() == mcast_rx_self))
+    {
+        return false;
+    }
+
+    ota_multicast_collect(C, off, len);
+
+    (void)xSemaphoreTake(mcast_rx_lock, portMAX_DELAY);
+
+    if (NULL != mcast_rx_written)
+    {
+        written = true;
+
+        for (uint32_t unit = first; written && (unit < end) && (unit < mcast_rx_units); unit++)
+        {
+            written = (0U != (mcast_rx_written[unit / BITS_PER_BYTE] & (1U << (unit % BITS_PER_BYTE))));
+        }
+
+        for (uint32_t unit = first; !written && mcast_rx_running && (unit < end) && (unit < mcast_rx_units); unit++)
+        {
+            mcast_rx_taken[unit / BITS_PER_BYTE] |= (uint8_t)(1U << (unit % BITS_PER_BYTE));
+        }
+    }
+
+    (void)xSemaphoreGive(mcast_rx_lock);
+
+    return written;
+}
+
+
+/*******************************************************************************
+ * Function Name: ota_multicast_rx_get
+ *******************************************************************************
+ * Summary:
+ *  Returns the statistics of the last transfer received.
+ *
+ * Parameters:
+ *  stats - set to the statistics
+ *
+ ******************************************************************************/
+void ota_multicast_rx_get(ota_multicast_rx_stats_t *stats)
+{
+    *stats = mcast_rx_stats;
+}
+
+
+/*******************************************************************************
+ * Function Name: ota_multicast_serve
+ *******************************************************************************
+ * Summary:
+ *  Sends the image verified in the secondary slot to the devices that join,
+ *  starting the sender task the first time.
+ *
+ * Parameters:
+ *  image_id - image ID
+ *  image_size - image size
+ *
+ ******************************************************************************/
+void ota_multicast_serve(uint32_t image_id, uint32_t image_size)
+{
+    const struct flash_area *fa;
+
+    if (NULL == mcast_lock)
+    {
+        mcast_lock = xSemaphoreCreateMutexStatic(&mcast_lock_buffer);
+    }
+
+    if ((0U == image_size) || (0 != flash_area_open(FLASH_AREA_IMAGE_SECONDARY(0), &fa)))
+    {
+        return;
+    }
+
+    gf_init();
+
+    (void)xSemaphoreTake(mcast_lock, portMAX_DELAY);
+    if (NULL != mcast_fa)
+    {
+        flash_area_close(mcast_fa);
+    }
+    mcast_fa = fa;
+    mcast_image_id = image_id;
+    mcast_image_size = image_size;
+    mcast_serving = true;
+    mcast_last_join = xTaskGetTickCount();
+    mcast_random = (uint32_t)mcast_last_join ^ image_id;
+    mcast_random = (0U == mcast_random) ? 1U : mcast_random;
+    memset(&mcast_stats, 0, sizeof(mcast_stats));
+    (void)xSemaphoreGive(mcast_lock);
+
+    if (!mcast_task_started)
+    {
+        mcast_task_started = (pdPASS == xTaskCreate(mcast_task, "OTA multicast",
+                                                    OTA_MULTICAST_TASK_STACK_SIZE, NULL,
+                                                    OTA_MULTICAST_TASK_PRIORITY, NULL));
+    }
+
+    configPRINTF(("OTA multicast: serving image %08lx, %lu bytes\r\n",
+                  (unsigned long)image_id, (unsigned long)image_size));
+}
+
+
+/*******************************************************************************
+ * Function Name: ota_multicast_withdraw
+ *******************************************************************************
+ * Summary:
+ *  Stops sending the image, before the secondary slot is written again. A
+ *  transfer in progress ends at its next group.
+ *
+ ******************************************************************************/
+void ota_multicast_withdraw(void)
+{
+    if (NULL == mcast_lock)
+    {
+        return;
+    }
+
+    (void)xSemaphoreTake(mcast_lock, portMAX_DELAY);
+    mcast_serving = false;
+    if (NULL != mcast_fa)
+    {
+        flash_area_close(mcast_fa);
+        mcast_fa = NULL;
+    }
+    (void)xSemaphoreGive(mcast_lock);
+}
+
+
+/*******************************************************************************
+ * Function Name: ota_multicast_hold
+ *******************************************************************************
+ * Summary:
+ *  Holds the activation of the image while it may be sent: until no device
+ *  joined for CY_OTA_MULTICAST_IDLE_MS and no transfer is in progress, at
+ *  most CY_OTA_MULTICAST_HOLD_MS. Prints what was sent.
+ *
+ ******************************************************************************/
+void ota_multicast_hold(void)
+{
+    TickType_t start = xTaskGetTickCount();
+    ota_multicast_stats_t stats;
+
+    if (!mcast_serving || !mcast_task_started || (0U == CY_OTA_MULTICAST_HOLD_MS))
+    {
+        return;
+    }
+
+    while (mcast_serving &&
+           ((xTaskGetTickCount() - start) < pdMS_TO_TICKS(CY_OTA_MULTICAST_HOLD_MS)) &&
+           ((MCAST_GATHER == mcast_state) || (MCAST_SENDING == mcast_state) ||
+            ((xTaskGetTickCount() - mcast_last_join) < pdMS_TO_TICKS(CY_OTA_MULTICAST_IDLE_MS))))
+    {
+        vTaskDelay(pdMS_TO_TICKS(MCAST_HOLD_POLL_MS));
+    }
+
+    ota_multicast_get(&stats);
+
+    configPRINTF(("OTA multicast: sent %lu transfers, %lu symbols, %lu bytes\r\n",
+                  (unsigned long)stats.transfers, (unsigned long)stats.packets,
+                  (unsigned long)stats.bytes));
+}
+
+
+/*******************************************************************************
+ * Function Name: ota_multicast_get
+ *******************************************************************************
+ * Summary:
+ *  Reads the statistics of the image sent.
+ *
+ * Parameters:
+ *  stats - set to the statistics
+ *
+ ******************************************************************************/
+void ota_multicast_get(ota_multicast_stats_t *stats)
+{
+    memset(stats, 0, sizeof(*stats));
+
+    if (NULL == mcast_lock)
+    {
+        return;
+    }
+
+    (void)xSemaphoreTake(mcast_lock, portMAX_DELAY);
+    *stats = mcast_stats;
+    stats->serving = mcast_serving;
+    stats->image_id = mcast_image_id;
+    stats->image_size = mcast_image_size;
+    (void)xSemaphoreGive(mcast_lock);
+}
+
+#endif /* CY_OTA_MULTICAST */
+
+
+/* [] END OF FILE */
@@ -0,0 +1,174 @@
+/******************************************************************************
+* File Name: ota_multicast.h
+*
+* Description: This file contains the macros, structures and function
+* declarations of the multicast distribution of a verified OTA image to the
+* devices of the LAN, with Reed-Solomon repair symbols.
+*
+* Related Document: See README.md
+*
+*******************************************************************************
+* (c) 2020, Cypress Semiconductor Corporation. All rights reserved.
+*******************************************************************************
+* This software, including source code, documentation and related materials
+* ("Software"), is owned by Cypress Semiconductor Corporation or one of its
+* subsidiaries ("Cypress") and is protected by and subject to worldwide patent
+* protection (United States and foreign), United States copyright laws and
+* international treaty provisions. Therefore, you may use this Software only
+* as provided in the license agreement accompanying the software package from
+* which you obtained this Software ("EULA").
+*
+* If no EULA applies, Cypress hereby grants you a personal, non-exclusive,
+* non-transferable license to copy, modify, and compile the Software source
+* code solely for use in connection with Cypress's integrated circuit products.
+* Any reproduction, modification, translation, compilation, or representation
+* of this Software except as specified above is prohibited without the express
+* written permission of Cypress.
+*
+* Disclaimer: THIS SOFTWARE IS PROVIDED AS-IS, WITH NO WARRANTY OF ANY KIND,
+* EXPRESS OR IMPLIED, INCLUDING, BUT NOT LIMITED TO, NONINFRINGEMENT, IMPLIED
+* WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE. Cypress
+* reserves the right to make changes to the Software without notice. Cypress
+* does not assume any liability arising out of the application or use of the
+* Software or any product or circuit described in the Software. Cypress does
+* not authorize its products for use in any products where a malfunction or
+* failure of the Cypress product may reasonably be expected to result in
+* significant property damage, injury or death ("High Risk Product"). By
+* including Cypress's product in a High Risk Product, the manufacturer of such
+* system or application assumes all risk of such use and in doing so agrees to
+* indemnify Cypress against all liability.
+*******************************************************************************/
+#ifndef OTA_MULTICAST_H
+#define OTA_MULTICAST_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "aws_iot_ota_agent.h"
+#include "ota_block_size.h"
+
+
+/*******************************************************************************
+ * Macros
+ ******************************************************************************/
+/* Multicast group and UDP port of the transfers */
+#ifndef CY_OTA_MULTICAST_GROUP
+#define CY_OTA_MULTICAST_GROUP              "239.255.79.81"
+#endif
+
+#ifndef CY_OTA_MULTICAST_PORT
+#define CY_OTA_MULTICAST_PORT               (45681U)
+#endif
+
+/* Local address of the interface used for the transfers. The default lets
+ * the stack choose; the host simulation uses the loopback interface.
+ */
+#ifndef CY_OTA_MULTICAST_INTERFACE
+#define CY_OTA_MULTICAST_INTERFACE          "0.0.0.0"
+#endif
+
+/* Rate of a transfer, headers included. Multicast frames are sent at a basic
+ * rate of the access point: keep it well below the unicast goodput.
+ */
+#ifndef CY_OTA_MULTICAST_KBPS
+#define CY_OTA_MULTICAST_KBPS               (2000U)
+#endif
+
+/* Repair symbols sent after the OTA_MULTICAST_GROUP_SYMBOLS source symbols of
+ * each group. A device rebuilds a group from any OTA_MULTICAST_GROUP_SYMBOLS
+ * of its symbols, so it may lose up to this many of them.
+ */
+#ifndef CY_OTA_MULTICAST_REPAIR
+#define CY_OTA_MULTICAST_REPAIR             (4U)
+#endif
+
+/* Longest time the activation of a verified image is held back to send it,
+ * and time without any join after which it is not held any more. Set
+ * CY_OTA_MULTICAST_HOLD_MS to 0 to activate the image at once.
+ */
+#ifndef CY_OTA_MULTICAST_HOLD_MS
+#define CY_OTA_MULTICAST_HOLD_MS            (300000UL)
+#endif
+
+#ifndef CY_OTA_MULTICAST_IDLE_MS
+#define CY_OTA_MULTICAST_IDLE_MS            (30000UL)
+#endif
+
+/* Bytes of image in a symbol, and source symbols of a group */
+#define OTA_MULTICAST_SYMBOL_SIZE           (1024U)
+#define OTA_MULTICAST_GROUP_SYMBOLS         (16U)
+
+/* Most repair symbols per group a device accepts */
+#define OTA_MULTICAST_MAX_REPAIR            (16U)
+
+/* Join: requests sent, and time waited for an offer after each one */
+#define OTA_MULTICAST_JOIN_TRIES            (2U)
+#define OTA_MULTICAST_JOIN_WAIT_MS          (300U)
+
+/* A transfer starts this long after the first join, so that the devices that
+ * start the same job at about the same time share it.
+ */
+#define OTA_MULTICAST_GATHER_MS             (1000U)
+
+/* A device stops listening after this long without a symbol */
+#define OTA_MULTICAST_QUIET_MS              (2000U)
+
+/* End messages sent after the last symbol */
+#define OTA_MULTICAST_END_COUNT             (3U)
+
+/* Tasks of the sender and of the receiver */
+#define OTA_MULTICAST_TASK_STACK_SIZE       (configMINIMAL_STACK_SIZE * 8)
+#define OTA_MULTICAST_TASK_PRIORITY         (tskIDLE_PRIORITY + 1U)
+
+#if (OTA_MULTICAST_SYMBOL_SIZE % OTA_BLOCK_UNIT_SIZE) != 0
+#error "OTA_MULTICAST_SYMBOL_SIZE must be a multiple of the block size of the agent"
+#endif
+
+#if (CY_OTA_MULTICAST_REPAIR > OTA_MULTICAST_MAX_REPAIR)
+#error "CY_OTA_MULTICAST_REPAIR is above OTA_MULTICAST_MAX_REPAIR"
+#endif
+
+
+/*******************************************************************************
+ * Data structure and enumeration
+ ******************************************************************************/
+typedef struct
+{
+    bool serving;               /* A verified image is sent on request */
+    uint32_t image_id;
+    uint32_t image_size;
+    uint32_t joins;             /* Joins answered */
+    uint32_t transfers;         /* Transfers sent */
+    uint32_t packets;           /* Symbols sent */
+    uint32_t bytes;             /* Bytes sent, headers included */
+} ota_multicast_stats_t;
+
+typedef struct
+{
+    uint32_t packets;           /* Symbols received */
+    uint32_t groups;            /* Groups of the transfer seen */
+    uint32_t recovered;         /* ... rebuilt with repair symbols */
+    uint32_t incomplete;        /* ... with too few symbols */
+    uint32_t units;             /* Blocks of the agent written */
+} ota_multicast_rx_stats_t;
+
+
+/*******************************************************************************
+ * Function prototypes
+ ******************************************************************************/
+uint32_t ota_multicast_image_id(const uint8_t *signature, uint32_t len);
+void ota_multicast_receive_start(OTA_FileContext_t *C);
+void ota_multicast_receive_stop(void);
+bool ota_multicast_receiving(void);
+void ota_multicast_collect(OTA_FileContext_t *C, uint32_t off, uint32_t len);
+bool ota_multicast_written(OTA_FileContext_t *C, uint32_t off, uint32_t len);
+void ota_multicast_rx_get(ota_multicast_rx_stats_t *stats);
+void ota_multicast_serve(uint32_t image_id, uint32_t image_size);
+void ota_multicast_withdraw(void);
+void ota_multicast_hold(void);
+void ota_multicast_get(ota_multicast_stats_t *stats);
+
+
+#endif /* OTA_MULTICAST_H */
+
+
+/* [] END OF FILE */
@@ -0,0 +1,643 @@
+/******************************************************************************
+* File Name: ota_pal_wrap.c
+*
+* Description: This file contains the functions that interpose the OTA PAL of
+* the board port (aws_ota_pal.c) with the -Wl,--wrap linker option. They keep
+* the index of the slot ring in the external flash in step with the OTA agent:
+* a completed download is recorded as received, and the result of the
+* self-test of a newly installed image marks its slot as good or bad. A
+* rejected image is replaced by the last known-good image on the next boot.
+* They also start and stop the selection of the OTA block size for every file
+* transfer (ota_block_size.c), and serialize the block writes of the parallel
+* HTTP connections (ota_http_stream.c) with those of the agent, or hand all
+* block writes to the flash writer task (ota_flash_writer.c).
+*
+* Related Document: See README.md
+*
+*******************************************************************************
+* (c) 2020, Cypress Semiconductor Corporation. All rights reserved.
+*******************************************************************************
+* This software, including source code, documentation and related materials
+* ("Software"), is owned by Cypress Semiconductor Corporation or one of its
+* subsidiaries ("Cypress") and is protected by and subject to worldwide patent
+* protection (United States and foreign), United States copyright laws and
+* international treaty provisions. Therefore, you may use this Software only
+* as provided in the license agreement accompanying the software package from
+* which you obtained this Software ("EULA").
+*
+* If no EULA applies, Cypress hereby grants you a personal, non-exclusive,
+* non-transferable license to copy, modify, and compile the Software source
+* code solely for use in connection with Cypress's integrated circuit products.
+* Any reproduction, modification, translation, compilation, or representation
+* of this Software except as specified above is prohibited without the express
+* written permission of Cypress.
+*
+* Disclaimer: THIS SOFTWARE IS PROVIDED AS-IS, WITH NO WARRANTY OF ANY KIND,
+* EXPRESS OR IMPLIED, INCLUDING, BUT NOT LIMITED TO, NONINFRINGEMENT, IMPLIED
+* WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE. Cypress
+* reserves the right to make changes to the Software without notice. Cypress
+* does not assume any liability arising out of the application or use of the
+* Software or any product or circuit described in the Software. Cypress does
+* not authorize its products for use in any products where a malfunction or
+* failure of the Cypress product may reasonably be expected to result in
+* significant property damage, injury or death ("High Risk Product"). By
+* including Cypress's product in a High Risk Product, the manufacturer of such
+* system or application assumes all risk of such use and in doing so agrees to
+* indemnify Cypress against all liability.
+*******************************************************************************/
+#include "FreeRTOS.h"
+#include "semphr.h"
+#include "aws_iot_ota_pal.h"
+#include "aws_iot_ota_agent.h"
+#include "slot_ring.h"
+#include "ota_block_size.h"
+#include "ota_flash_writer.h"
+#include "ota_slot_erase.h"
+#include "ota_stream_hash.h"
+#include "ota_resume.h"
+#include "ota_write_coalesce.h"
+#include "ota_metrics.h"
+#include "ota_tar_stream.h"
+#include "ota_peer.h"
+#include "ota_multicast.h"
+#include "ota_ram_stage.h"
+
+#if defined(CY_OTA_PEER) && !defined(CY_OTA_HTTP_STREAM)
+#error "CY_OTA_PEER fetches the ranges with the connections of ota_http_stream.c"
+#endif
+
+
+/*******************************************************************************
+ * Macros
+ ******************************************************************************/
+/* PAL functions interposed by the enabled features. Keep in sync with
+ * OTA_PAL_WRAP in make_support/mtb_feature_ota.mk and CMakeLists.txt.
+ */
+#if defined(CY_OTA_BLOCK_STREAM) || defined(CY_OTA_HTTP_STREAM) || defined(CY_OTA_FLASH_WRITER) || \
+    defined(CY_OTA_BOUNDED_ERASE) || defined(CY_OTA_STREAM_HASH) || defined(CY_OTA_RESUME) || \
+    defined(CY_OTA_WRITE_COALESCE) || defined(CY_OTA_METRICS) || defined(CY_OTA_TAR_STREAM) || \
+    defined(CY_OTA_PEER) || defined(CY_OTA_MULTICAST) || defined(CY_OTA_RAM_STAGE)
+#define PAL_WRAP_CREATE_FILE
+#endif
+
+#if defined(CY_OTA_HTTP_STREAM) || defined(CY_OTA_FLASH_WRITER) || defined(CY_OTA_BOUNDED_ERASE) || \
+    defined(CY_OTA_STREAM_HASH) || defined(CY_OTA_RESUME) || defined(CY_OTA_METRICS) || \
+    defined(CY_OTA_TAR_STREAM) || defined(CY_OTA_MULTICAST)
+#define PAL_WRAP_WRITE_BLOCK
+#endif
+
+#if defined(CY_OTA_BLOCK_STREAM) || defined(CY_OTA_FLASH_WRITER) || defined(CY_OTA_RESUME) || \
+    defined(CY_OTA_WRITE_COALESCE) || defined(CY_OTA_METRICS) || defined(CY_OTA_TAR_STREAM) || \
+    defined(CY_OTA_RAM_STAGE) || defined(CY_OTA_MULTICAST)
+#define PAL_WRAP_ABORT
+#endif
+
+#if defined(CY_BOOT_USE_SLOT_RING) || defined(CY_OTA_BLOCK_STREAM) || defined(CY_OTA_FLASH_WRITER) || \
+    defined(CY_OTA_BOUNDED_ERASE) || defined(CY_OTA_STREAM_HASH) || defined(CY_OTA_RESUME) || \
+    defined(CY_OTA_WRITE_COALESCE) || defined(CY_OTA_METRICS) || defined(CY_OTA_TAR_STREAM) || \
+    defined(CY_OTA_PEER) || defined(CY_OTA_MULTICAST) || defined(CY_OTA_RAM_STAGE)
+#define PAL_WRAP_CLOSE_FILE
+#endif
+
+#if defined(CY_OTA_PEER) || defined(CY_OTA_MULTICAST)
+#define PAL_WRAP_ACTIVATE
+#endif
+
+/*******************************************************************************
+ * Function prototypes
+ ******************************************************************************/
+OTA_Err_t __real_prvPAL_CreateFileForRx(OTA_FileContext_t * const C);
+OTA_Err_t __real_prvPAL_Abort(OTA_FileContext_t * const C);
+OTA_Err_t __real_prvPAL_CloseFile(OTA_FileContext_t * const C);
+OTA_Err_t __real_prvPAL_SetPlatformImageState(OTA_ImageState_t eState);
+OTA_Err_t __real_prvPAL_ActivateNewImage(void);
+int16_t __real_prvPAL_WriteBlock(OTA_FileContext_t * const C, uint32_t ulOffset,
+                                 uint8_t * const pacData, uint32_t ulBlockSize);
+
+OTA_Err_t __wrap_prvPAL_CreateFileForRx(OTA_FileContext_t * const C);
+OTA_Err_t __wrap_prvPAL_Abort(OTA_FileContext_t * const C);
+OTA_Err_t __wrap_prvPAL_CloseFile(OTA_FileContext_t * const C);
+OTA_Err_t __wrap_prvPAL_SetPlatformImageState(OTA_ImageState_t eState);
+OTA_Err_t __wrap_prvPAL_ActivateNewImage(void);
+int16_t __wrap_prvPAL_WriteBlock(OTA_FileContext_t * const C, uint32_t ulOffset,
+                                 uint8_t * const pacData, uint32_t ulBlockSize);
+
+
+#if (defined(CY_OTA_HTTP_STREAM) || defined(CY_OTA_MULTICAST)) && !defined(CY_OTA_FLASH_WRITER)
+/*******************************************************************************
+ * Global variables
+ ******************************************************************************/
+/* Held for every block write: the HTTP connections and the multicast
+ * transfer write from their tasks.
+ */
+static SemaphoreHandle_t write_lock = NULL;
+static StaticSemaphore_t write_lock_buffer;
+#endif
+
+
+/*******************************************************************************
+ * Function definitions
+ ******************************************************************************/
+
+#if defined(PAL_WRAP_CREATE_FILE)
+/*******************************************************************************
+ * Function Name: __wrap_prvPAL_CreateFileForRx
+ *******************************************************************************
+ * Summary:
+ *  Opens the file to receive and starts the block size selection and the
+ *  request window for it. Creates the block write lock on the first call.
+ *  With the flash writer, the erase of the slot is left to the writer. With
+ *  the bounded erase, only the part of the slot used by the file is erased.
+ *  With the resume, the blocks of the same file received before a reset are
+ *  kept and are not requested again. The metrics of the transfer start before
+ *  the slot is erased. A TAR archive is extracted as it is received. An image
+ *  served to the peers or to the multicast group is withdrawn before its slot
+ *  is written again. With the multicast, a task receives the file from a
+ *  transfer offered on the LAN, if any, while the agent goes on. A file
+ *  that fits the RAM budget is staged in SRAM once the slot is erased.
+ *
+ * Parameters:
+ *  C - OTA file context
+ *
+ * Return:
+ *  OTA_Err_t - result of the PAL
+ *
+ ******************************************************************************/
+OTA_Err_t __wrap_prvPAL_CreateFileForRx(OTA_FileContext_t * const C)
+{
+    OTA_Err_t result;
+
+#if defined(CY_OTA_PEER)
+    ota_peer_withdraw();
+#endif
+
+#if defined(CY_OTA_MULTICAST)
+    ota_multicast_withdraw();
+#endif
+
+#if defined(CY_OTA_METRICS)
+    ota_metrics_begin(C);
+#endif
+
+#if defined(CY_OTA_BOUNDED_ERASE)
+    ota_slot_erase_begin(C->ulFileSize);
+#endif
+
+#if defined(CY_OTA_STREAM_HASH)
+    ota_stream_hash_begin();
+#endif
+
+#if defined(CY_OTA_RESUME)
+    ota_resume_begin(C);
+#endif
+
+#if defined(CY_OTA_WRITE_COALESCE)
+    ota_write_coalesce_begin();
+#endif
+
+#if defined(CY_OTA_TAR_STREAM)
+    ota_tar_stream_begin(C);
+#endif
+
+#if defined(CY_OTA_FLASH_WRITER)
+    ota_flash_writer_begin();
+#endif
+
+    result = __real_prvPAL_CreateFileForRx(C);
+
+#if defined(CY_OTA_RESUME)
+    if (kOTA_Err_None == result)
+    {
+        ota_resume_restore(C);
+    }
+#endif
+
+#if defined(CY_OTA_FLASH_WRITER)
+    ota_flash_writer_end_open();
+#endif
+
+#if defined(CY_OTA_BOUNDED_ERASE)
+    ota_slot_erase_end();
+#endif
+
+#if defined(CY_OTA_RAM_STAGE)
+    if (kOTA_Err_None == result)
+    {
+        (void)ota_ram_stage_begin(C);
+    }
+#endif
+
+#if (defined(CY_OTA_HTTP_STREAM) || defined(CY_OTA_MULTICAST)) && !defined(CY_OTA_FLASH_WRITER)
+    if (NULL == write_lock)
+    {
+        write_lock = xSemaphoreCreateMutexStatic(&write_lock_buffer);
+    }
+#endif
+
+#if defined(CY_OTA_MULTICAST)
+    if (kOTA_Err_None == result)
+    {
+        ota_multicast_receive_start(C);
+    }
+#endif
+
+#if defined(CY_OTA_BLOCK_STREAM)
+    if (kOTA_Err_None == result)
+    {
+        ota_block_size_start(C);
+    }
+#endif
+
+    return result;
+}
+#endif /* PAL_WRAP_CREATE_FILE */
+
+
+#if defined(PAL_WRAP_WRITE_BLOCK)
+/*******************************************************************************
+ * Function Name: __wrap_prvPAL_WriteBlock
+ *******************************************************************************
+ * Summary:
+ *  Writes a block of the file, one writer at a time. With the flash writer,
+ *  the block is queued for the writer task. Each block written is added to
+ *  the hash of the file, to the resume checkpoints and to the metrics. The
+ *  first block of the file ends the "accept job to first block" time.
+ *  With the TAR extraction, the block is parsed and its members are written
+ *  to their partitions; a block left for later is neither hashed nor counted.
+ *  A block the multicast transfer already wrote is not written again.
+ *
+ * Parameters:
+ *  C - OTA file context
+ *  ulOffset - offset of the block in the file
+ *  pacData - block data
+ *  ulBlockSize - size of the block
+ *
+ * Return:
+ *  int16_t - number of bytes written, negative on error
+ *
+ ******************************************************************************/
+int16_t __wrap_prvPAL_WriteBlock(OTA_FileContext_t * const C, uint32_t ulOffset,
+                                 uint8_t * const pacData, uint32_t ulBlockSize)
+{
+#if defined(CY_OTA_MULTICAST)
+    if (ota_multicast_written(C, ulOffset, ulBlockSize))
+    {
+        return (int16_t)ulBlockSize;
+    }
+#endif
+
+#if defined(CY_OTA_BOUNDED_ERASE)
+    ota_slot_erase_first_block();
+#endif
+
+#if defined(CY_OTA_FLASH_WRITER)
+    return ota_flash_writer_write(C, ulOffset, pacData, ulBlockSize);
+#else
+    int16_t result;
+
+#if defined(CY_OTA_HTTP_STREAM) || defined(CY_OTA_MULTICAST)
+    (void)xSemaphoreTake(write_lock, portMAX_DELAY);
+#endif
+
+#if defined(CY_OTA_TAR_STREAM)
+    result = ota_tar_stream_write(C, ulOffset, pacData, ulBlockSize);
+    if (OTA_TAR_STREAM_DEFERRED == result)
+    {
+        return (int16_t)ulBlockSize;
+    }
+#else
+    result = __real_prvPAL_WriteBlock(C, ulOffset, pacData, ulBlockSize);
+#endif
+
+    if (result == (int16_t)ulBlockSize)
+    {
+#if defined(CY_OTA_STREAM_HASH)
+#if defined(CY_OTA_RAM_STAGE)
+        /* A staged block is read back from the buffer */
+        ota_ram_stage_serve_reads(true);
+#endif
+        ota_stream_hash_update(ulOffset, pacData, ulBlockSize);
+#if defined(CY_OTA_RAM_STAGE)
+        ota_ram_stage_serve_reads(false);
+#endif
+#endif
+#if defined(CY_OTA_RESUME)
+        ota_resume_written(ulOffset, ulBlockSize);
+#endif
+#if defined(CY_OTA_METRICS)
+        ota_metrics_written(ulOffset, ulBlockSize);
+#endif
+    }
+
+#if defined(CY_OTA_HTTP_STREAM) || defined(CY_OTA_MULTICAST)
+    (void)xSemaphoreGive(write_lock);
+#endif
+
+    return result;
+#endif
+}
+#endif /* PAL_WRAP_WRITE_BLOCK */
+
+
+#if defined(PAL_WRAP_ABORT)
+/*******************************************************************************
+ * Function Name: __wrap_prvPAL_Abort
+ *******************************************************************************
+ * Summary:
+ *  Aborts the file transfer and stops the multicast transfer, the block
+ *  size selection and the request window. The blocks queued for the flash
+ *  writer or held for coalescing are written first, and a file staged in
+ *  SRAM is dropped. An aborted transfer is not resumed after a reset. Its
+ *  metrics are published with the next job status update.
+ *
+ * Parameters:
+ *  C - OTA file context
+ *
+ * Return:
+ *  OTA_Err_t - result of the PAL
+ *
+ ******************************************************************************/
+OTA_Err_t __wrap_prvPAL_Abort(OTA_FileContext_t * const C)
+{
+#if defined(CY_OTA_MULTICAST)
+    ota_multicast_receive_stop();
+#endif
+
+#if defined(CY_OTA_BLOCK_STREAM)
+    ota_block_size_stop(C);
+#endif
+
+#if defined(CY_OTA_FLASH_WRITER)
+    (void)ota_flash_writer_flush(false);
+#endif
+
+#if defined(CY_OTA_WRITE_COALESCE)
+    (void)ota_write_coalesce_end();
+#endif
+
+#if defined(CY_OTA_RAM_STAGE)
+    ota_ram_stage_end();
+#endif
+
+#if defined(CY_OTA_RESUME)
+    ota_resume_end();
+#endif
+
+#if defined(CY_OTA_METRICS)
+    ota_metrics_end(OTA_METRICS_ABORTED);
+#endif
+
+#if defined(CY_OTA_TAR_STREAM)
+    ota_tar_stream_end(false);
+#endif
+
+    return __real_prvPAL_Abort(C);
+}
+#endif /* PAL_WRAP_ABORT */
+
+
+#if defined(PAL_WRAP_CLOSE_FILE)
+/*******************************************************************************
+ * Function Name: pal_close_file
+ *******************************************************************************
+ * Summary:
+ *  Closes the file in the PAL. With the stream hash, the signature check of
+ *  the PAL uses the hash computed while the file was received. A file staged
+ *  in SRAM is verified there, and programmed to the slot only once it is
+ *  verified.
+ *
+ * Parameters:
+ *  C - OTA file context
+ *
+ * Return:
+ *  OTA_Err_t - result of the PAL
+ *
+ ******************************************************************************/
+static OTA_Err_t pal_close_file(OTA_FileContext_t * const C)
+{
+    OTA_Err_t result;
+
+#if defined(CY_OTA_RAM_STAGE)
+    ota_ram_stage_serve_reads(true);
+#endif
+#if defined(CY_OTA_STREAM_HASH)
+    ota_stream_hash_arm(C->ulFileSize);
+#endif
+
+    result = __real_prvPAL_CloseFile(C);
+
+#if defined(CY_OTA_RAM_STAGE)
+    ota_ram_stage_serve_reads(false);
+#endif
+#if defined(CY_OTA_STREAM_HASH)
+    ota_stream_hash_disarm();
+#endif
+
+#if defined(CY_OTA_RAM_STAGE)
+    if ((kOTA_Err_None == result) && !ota_ram_stage_commit())
+    {
+        result = kOTA_Err_FileClose;
+    }
+#endif
+
+    return result;
+}
+
+
+/*******************************************************************************
+ * Function Name: __wrap_prvPAL_CloseFile
+ *******************************************************************************
+ * Summary:
+ *  Closes the received file once the multicast transfer has ended, the
+ *  flash writer has written every block and the writes held for coalescing
+ *  are programmed, and prints the statistics of the slot erase. A closed
+ *  file is not resumed after a reset, whether its signature is valid or not.
+ *  The metrics of the transfer, with the time taken by the signature check,
+ *  are published with the next job status update.
+ *  When the signature of the image is valid, the slot that received it is
+ *  recorded as received, and the image is served to the peers on the LAN and
+ *  to the multicast group.
+ *  A TAR archive that was not extracted completely is rejected. A file
+ *  staged in SRAM is freed once it is programmed, see pal_close_file().
+ *
+ * Parameters:
+ *  C - OTA file context
+ *
+ * Return:
+ *  OTA_Err_t - result of the PAL
+ *
+ ******************************************************************************/
+OTA_Err_t __wrap_prvPAL_CloseFile(OTA_FileContext_t * const C)
+{
+    OTA_Err_t result;
+    bool written = true;
+
+#if defined(CY_OTA_MULTICAST)
+    ota_multicast_receive_stop();
+#endif
+
+#if defined(CY_OTA_BLOCK_STREAM)
+    ota_block_size_stop(C);
+#endif
+
+#if defined(CY_OTA_FLASH_WRITER)
+    written = ota_flash_writer_flush(true);
+#endif
+
+#if defined(CY_OTA_WRITE_COALESCE)
+    written = (0 == ota_write_coalesce_end()) && written;
+#endif
+
+#if defined(CY_OTA_TAR_STREAM)
+    written = ota_tar_stream_finish() && written;
+#endif
+
+    if (!written)
+    {
+        (void)__real_prvPAL_Abort(C);
+        result = kOTA_Err_FileClose;
+    }
+    else
+    {
+#if defined(CY_OTA_METRICS)
+        ota_metrics_verify_start();
+#endif
+        result = pal_close_file(C);
+    }
+
+#if defined(CY_OTA_METRICS)
+    ota_metrics_end((kOTA_Err_None == result) ? OTA_METRICS_VERIFIED : OTA_METRICS_REJECTED);
+#endif
+
+#if defined(CY_OTA_TAR_STREAM)
+    ota_tar_stream_end(kOTA_Err_None == result);
+#endif
+
+#if defined(CY_OTA_BOUNDED_ERASE)
+    ota_slot_erase_report();
+#endif
+
+#if defined(CY_OTA_RAM_STAGE)
+    ota_ram_stage_end();
+#endif
+
+#if defined(CY_OTA_RESUME)
+    ota_resume_end();
+#endif
+
+#if defined(CY_BOOT_USE_SLOT_RING)
+    if (kOTA_Err_None == result)
+    {
+        (void)slot_ring_set_state(slot_ring_rx(), SLOT_RING_RECEIVED, NULL, 0U);
+    }
+    else
+    {
+        (void)slot_ring_set_state(slot_ring_rx(), SLOT_RING_EMPTY, NULL, 0U);
+    }
+#endif
+
+#if defined(CY_OTA_PEER)
+    if ((kOTA_Err_None == result) && (NULL != C->pxSignature))
+    {
+        ota_peer_serve(ota_peer_image_id(C->pxSignature->ucData, C->pxSignature->usSize),
+                       C->ulFileSize);
+    }
+#endif
+
+#if defined(CY_OTA_MULTICAST)
+    if ((kOTA_Err_None == result) && (NULL != C->pxSignature))
+    {
+        ota_multicast_serve(ota_multicast_image_id(C->pxSignature->ucData, C->pxSignature->usSize),
+                            C->ulFileSize);
+    }
+#endif
+
+    return result;
+}
+#endif /* PAL_WRAP_CLOSE_FILE */
+
+
+#if defined(PAL_WRAP_ACTIVATE)
+/*******************************************************************************
+ * Function Name: __wrap_prvPAL_ActivateNewImage
+ *******************************************************************************
+ * Summary:
+ *  Activates the new image once the peers on the LAN that fetch it from this
+ *  device are done, or after CY_OTA_PEER_HOLD_MS, and once no device asks for
+ *  it on the multicast group, or after CY_OTA_MULTICAST_HOLD_MS.
+ *
+ * Return:
+ *  OTA_Err_t - result of the PAL
+ *
+ ******************************************************************************/
+OTA_Err_t __wrap_prvPAL_ActivateNewImage(void)
+{
+#if defined(CY_OTA_PEER)
+    ota_peer_hold();
+    ota_peer_withdraw();
+#endif
+
+#if defined(CY_OTA_MULTICAST)
+    ota_multicast_hold();
+    ota_multicast_withdraw();
+#endif
+
+    return __real_prvPAL_ActivateNewImage();
+}
+#endif /* PAL_WRAP_ACTIVATE */
+
+
+#if defined(CY_BOOT_USE_SLOT_RING)
+/*******************************************************************************
+ * Function Name: __wrap_prvPAL_SetPlatformImageState
+ *******************************************************************************
+ * Summary:
+ *  Sets the state of the running image. While the image installed from the
+ *  ring is on trial, accepting it marks its slot good. Rejecting it marks the
+ *  slot bad and requests the bootloader to install the last known-good slot
+ *  on the next reset, without downloading it again.
+ *
+ * Parameters:
+ *  eState - new image state
+ *
+ * Return:
+ *  OTA_Err_t - result of the PAL
+ *
+ ******************************************************************************/
+OTA_Err_t __wrap_prvPAL_SetPlatformImageState(OTA_ImageState_t eState)
+{
+    OTA_Err_t result = __real_prvPAL_SetPlatformImageState(eState);
+    uint8_t active = slot_ring_active();
+    const slot_ring_slot_t *entry = slot_ring_get(active);
+
+    if ((NULL == entry) || (SLOT_RING_TRIAL != entry->state))
+    {
+        return result;
+    }
+
+    if (eOTA_ImageState_Accepted == eState)
+    {
+        configPRINTF(("Slot ring: image in slot %u accepted\r\n", (unsigned int)active));
+        (void)slot_ring_set_state(active, SLOT_RING_GOOD, NULL, 0U);
+    }
+    else if ((eOTA_ImageState_Rejected == eState) || (eOTA_ImageState_Aborted == eState))
+    {
+        uint8_t target = slot_ring_last_good();
+
+        (void)slot_ring_set_state(active, SLOT_RING_BAD, NULL, 0U);
+
+        if (SLOT_RING_NONE != target)
+        {
+            configPRINTF(("Slot ring: image in slot %u rejected, slot %u is installed on reset\r\n",
+                          (unsigned int)active, (unsigned int)target));
+            (void)slot_ring_request_install(target);
+        }
+    }
+
+    return result;
+}
+
+#endif /* CY_BOOT_USE_SLOT_RING */
+
+
+/* [] END OF FILE */
@@ -0,0 +1,1068 @@
+/******************************************************************************
+* File Name: ota_peer.c
+*
+* Description: This file implements the redistribution of a verified OTA
+* image to the other devices of the LAN.
+*
+* A device that verified an image serves it from its secondary slot with a
+* small HTTP/1.1 server on the lwIP sockets, until the image is activated.
+* Devices that start the same download ask for the image on a multicast
+* group: a server answers with the TCP port of its range server, and the HTTP
+* download (see ota_http_stream.c) fetches its ranges from that peer instead
+* of the pre-signed URL. The image is identified by a hash of the signature
+* of the job and by its size; the signature is checked by the PAL as for any
+* other download, so a peer can delay an update but cannot alter it.
+*
+* Discovery (UDP, CY_OTA_PEER_GROUP:CY_OTA_PEER_DISCOVERY_PORT): 16-byte
+* messages, big endian:
+*   "OTAP", type (1 query, 2 offer), version, TCP port, image ID, image size
+* Server: GET OTA_PEER_PATH<image ID in hex> with a Range header.
+*
+* Related Document: See README.md
+*
+*******************************************************************************
+* (c) 2020, Cypress Semiconductor Corporation. All rights reserved.
+*******************************************************************************
+* This software, including source code, documentation and related materials
+* ("Software"), is owned by Cypress Semiconductor Corporation or one of its
+* subsidiaries ("Cypress") and is protected by and subject to worldwide patent
+* protection (United States and foreign), United States copyright laws and
+* international treaty provisions. Therefore, you may use this Software only
+* as provided in the license agreement accompanying the software package from
+* which you obtained this Software ("EULA").
+*
+* If no EULA applies, Cypress hereby grants you a personal, non-exclusive,
+* non-transferable license to copy, modify, and compile the Software source
+* code solely for use in connection with Cypress's integrated circuit products.
+* Any reproduction, modification, translation, compilation, or representation
+* of this Software except as specified above is prohibited without the express
+* written permission of Cypress.
+*
+* Disclaimer: THIS SOFTWARE IS PROVIDED AS-IS, WITH NO WARRANTY OF ANY KIND,
+* EXPRESS OR IMPLIED, INCLUDING, BUT NOT LIMITED TO, NONINFRINGEMENT, IMPLIED
+* WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE. Cypress
+* reserves the right to make changes to the Software without notice. Cypress
+* does not assume any liability arising out of the application or use of the
+* Software or any product or circuit described in the Software. Cypress does
+* not authorize its products for use in any products where a malfunction or
+* failure of the Cypress product may reasonably be expected to result in
+* significant property damage, injury or death ("High Risk Product"). By
+* including Cypress's product in a High Risk Product, the manufacturer of such
+* system or application assumes all risk of such use and in doing so agrees to
+* indemnify Cypress against all liability.
+*******************************************************************************/
+#include <string.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include "FreeRTOS.h"
+#include "task.h"
+#include "semphr.h"
+#include "lwip/sockets.h"
+#include "sysflash/sysflash.h"
+#include "flash_map_backend/flash_map_backend.h"
+#include "ota_peer.h"
+
+#if defined(CY_OTA_PEER)
+
+/*******************************************************************************
+ * Macros
+ ******************************************************************************/
+#define PEER_MSG_SIZE                   (16U)
+#define PEER_MSG_QUERY                  (1U)
+#define PEER_MSG_OFFER                  (2U)
+#define PEER_MSG_VERSION                (1U)
+
+#define PEER_FNV_OFFSET                 (2166136261UL)
+#define PEER_FNV_PRIME                  (16777619UL)
+
+#define PEER_SELECT_MS                  (1000U)
+#define PEER_HOLD_POLL_MS               (1000U)
+#define PEER_HEADER_END                 "\r\n\r\n"
+#define PEER_RESPONSE_SIZE              (160U)
+
+#define PEER_NO_SOCKET                  (-1)
+
+#ifndef MSG_NOSIGNAL
+#define MSG_NOSIGNAL                    (0)
+#endif
+
+
+/*******************************************************************************
+ * Data structure and enumeration
+ ******************************************************************************/
+typedef struct
+{
+    int socket;
+    uint32_t len;                       /* Bytes of the request received */
+    TickType_t last;                    /* Tick of the last request */
+    char request[OTA_PEER_REQUEST_SIZE + 1U];
+} peer_client_t;
+
+
+/*******************************************************************************
+ * Function prototypes
+ ******************************************************************************/
+static void peer_task(void *arg);
+
+
+/*******************************************************************************
+ * Global variables
+ ******************************************************************************/
+static const uint8_t peer_magic[4] = { 'O', 'T', 'A', 'P' };
+
+/* Image served. The slot is only read with the lock held, so that it is not
+ * read any more once ota_peer_withdraw() returns.
+ */
+static SemaphoreHandle_t peer_lock = NULL;
+static StaticSemaphore_t peer_lock_buffer;
+static const struct flash_area *peer_fa = NULL;
+static volatile bool peer_serving;
+static uint32_t peer_image_id;
+static uint32_t peer_image_size;
+static volatile TickType_t peer_last_request;
+static ota_peer_stats_t peer_stats;
+
+/* Server task and its sockets */
+static bool peer_task_started;
+static int peer_udp = PEER_NO_SOCKET;
+static int peer_listen = PEER_NO_SOCKET;
+static uint16_t peer_http_port;
+static peer_client_t peer_clients[OTA_PEER_MAX_CLIENTS];
+static uint8_t peer_chunk[OTA_PEER_CHUNK_SIZE];
+
+
+/*******************************************************************************
+ * Function Name: peer_put32
+ *******************************************************************************
+ * Summary:
+ *  Stores a big-endian 32-bit field of a discovery message.
+ *
+ ******************************************************************************/
+static void peer_put32(uint8_t *p, uint32_t value)
+{
+    p[0] = (uint8_t)(value >> 24);
+    p[1] = (uint8_t)(value >> 16);
+    p[2] = (uint8_t)(value >> 8);
+    p[3] = (uint8_t)value;
+}
+
+
+/*******************************************************************************
+ * Function Name: peer_get32
+ *******************************************************************************
+ * Summary:
+ *  Loads a big-endian 32-bit field of a discovery message.
+ *
+ ******************************************************************************/
+static uint32_t peer_get32(const uint8_t *p)
+{
+    return ((uint32_t)p[0] << 24) | ((uint32_t)p[1] << 16) | ((uint32_t)p[2] << 8) | p[3];
+}
+
+
+/*******************************************************************************
+ * Function Name: peer_msg_make
+ *******************************************************************************
+ * Summary:
+ *  Builds a discovery message.
+ *
+ * Parameters:
+ *  msg - PEER_MSG_SIZE bytes
+ *  type - PEER_MSG_QUERY or PEER_MSG_OFFER
+ *  port - TCP port of the range server, 0 in a query
+ *  image_id - image ID
+ *  image_size - image size
+ *
+ ******************************************************************************/
+static void peer_msg_make(uint8_t *msg, uint8_t type, uint16_t port,
+                          uint32_t image_id, uint32_t image_size)
+{
+    memcpy(msg, peer_magic, sizeof(peer_magic));
+    msg[4] = type;
+    msg[5] = PEER_MSG_VERSION;
+    msg[6] = (uint8_t)(port >> 8);
+    msg[7] = (uint8_t)port;
+    peer_put32(&msg[8], image_id);
+    peer_put32(&msg[12], image_size);
+}
+
+
+/*******************************************************************************
+ * Function Name: peer_msg_check
+ *******************************************************************************
+ * Summary:
+ *  Checks a received discovery message.
+ *
+ * Parameters:
+ *  msg - message
+ *  len - number of bytes received
+ *  type - expected type
+ *
+ * Return:
+ *  bool - true if the message is a discovery message of this type
+ *
+ ******************************************************************************/
+static bool peer_msg_check(const uint8_t *msg, int len, uint8_t type)
+{
+    return (PEER_MSG_SIZE == len) && (0 == memcmp(msg, peer_magic, sizeof(peer_magic))) &&
+           (type == msg[4]) && (PEER_MSG_VERSION == msg[5]);
+}
+
+
+/*******************************************************************************
+ * Function Name: peer_close
+ *******************************************************************************
+ * Summary:
+ *  Closes a socket, if open.
+ *
+ * Parameters:
+ *  sock - socket, set to PEER_NO_SOCKET
+ *
+ ******************************************************************************/
+static void peer_close(int *sock)
+{
+    if (PEER_NO_SOCKET != *sock)
+    {
+        (void)closesocket(*sock);
+        *sock = PEER_NO_SOCKET;
+    }
+}
+
+
+/*******************************************************************************
+ * Function Name: peer_send_all
+ *******************************************************************************
+ * Summary:
+ *  Sends a buffer on a connection.
+ *
+ * Parameters:
+ *  sock - socket
+ *  data - bytes to send
+ *  len - number of bytes
+ *
+ * Return:
+ *  bool - true if every byte was sent
+ *
+ ******************************************************************************/
+static bool peer_send_all(int sock, const void *data, size_t len)
+{
+    const uint8_t *p = (const uint8_t *)data;
+
+    while (len > 0U)
+    {
+        int sent = send(sock, p, len, MSG_NOSIGNAL);
+
+        if (sent <= 0)
+        {
+            return false;
+        }
+
+        p += sent;
+        len -= (size_t)sent;
+    }
+
+    return true;
+}
+
+
+/*******************************************************************************
+ * Function Name: peer_header_value
+ *******************************************************************************
+ * Summary:
+ *  Finds a header of a request, ignoring the case of its name.
+ *
+ * Parameters:
+ *  headers - request header, NUL terminated
+ *  name - lower case header name followed by ':'
+ *
+ * Return:
+ *  const char* - first character of the value, or NULL if not present
+ *
+ ******************************************************************************/
+static const char *peer_header_value(const char *headers, const char *name)
+{
+    size_t name_len = strlen(name);
+    const char *line = strstr(headers, "\r\n");
+
+    while (NULL != line)
+    {
+        size_t i;
+
+        line += 2;
+
+        for (i = 0U; i < name_len; i++)
+        {
+            char c = line[i];
+
+            if ((c >= 'A') && (c <= 'Z'))
+            {
+                c = (char)(c - 'A' + 'a');
+            }
+
+            if (c != name[i])
+            {
+                break;
+            }
+        }
+
+        if (i == name_len)
+        {
+            line += name_len;
+
+            while (' ' == *line)
+            {
+                line++;
+            }
+
+            return line;
+        }
+
+        line = strstr(line, "\r\n");
+    }
+
+    return NULL;
+}
+
+
+/*******************************************************************************
+ * Function Name: peer_server_open
+ *******************************************************************************
+ * Summary:
+ *  Opens the discovery socket, joined to the multicast group, and the
+ *  listening socket of the range server.
+ *
+ * Return:
+ *  bool - true on success
+ *
+ ******************************************************************************/
+static bool peer_server_open(void)
+{
+    struct sockaddr_in addr;
+    struct ip_mreq mreq;
+    socklen_t addr_len = sizeof(addr);
+    int one = 1;
+
+    peer_udp = socket(AF_INET, SOCK_DGRAM, 0);
+    peer_listen = socket(AF_INET, SOCK_STREAM, 0);
+
+    if ((peer_udp < 0) || (peer_listen < 0))
+    {
+        peer_udp = (peer_udp < 0) ? PEER_NO_SOCKET : peer_udp;
+        peer_listen = (peer_listen < 0) ? PEER_NO_SOCKET : peer_listen;
+        return false;
+    }
+
+    /* Fails without SO_REUSE in lwIP, where it is not needed */
+    (void)setsockopt(peer_udp, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+    (void)setsockopt(peer_listen, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_ANY);
+    addr.sin_port = htons(CY_OTA_PEER_DISCOVERY_PORT);
+
+    mreq.imr_multiaddr.s_addr = inet_addr(CY_OTA_PEER_GROUP);
+    mreq.imr_interface.s_addr = inet_addr(CY_OTA_PEER_INTERFACE);
+
+    if ((0 != bind(peer_udp, (struct sockaddr *)&addr, sizeof(addr))) ||
+        (0 != setsockopt(peer_udp, IPPROTO_IP, IP_ADD_MEMBERSHIP, &mreq, sizeof(mreq))))
+    {
+        return false;
+    }
+
+    addr.sin_port = htons(CY_OTA_PEER_HTTP_PORT);
+
+    if ((0 != bind(peer_listen, (struct sockaddr *)&addr, sizeof(addr))) ||
+        (0 != listen(peer_listen, OTA_PEER_MAX_CLIENTS)) ||
+        (0 != getsockname(peer_listen, (struct sockaddr *)&addr, &addr_len)))
+    {
+        return false;
+    }
+
+    peer_http_port = ntohs(addr.sin_port);
+
+    return true;
+}
+
+
+/*******************************************************************************
+ * Function Name: peer_client_count
+ *******************************************************************************
+ * Summary:
+ *  Counts the connections of peers.
+ *
+ * Return:
+ *  uint32_t - number of open connections of peers
+ *
+ ******************************************************************************/
+static uint32_t peer_client_count(void)
+{
+    uint32_t count = 0U;
+
+    for (uint32_t i = 0U; i < OTA_PEER_MAX_CLIENTS; i++)
+    {
+        count += (PEER_NO_SOCKET != peer_clients[i].socket) ? 1U : 0U;
+    }
+
+    return count;
+}
+
+
+/*******************************************************************************
+ * Function Name: peer_answer_query
+ *******************************************************************************
+ * Summary:
+ *  Reads a discovery query and answers it when the image asked for is served
+ *  and a connection is free.
+ *
+ ******************************************************************************/
+static void peer_answer_query(void)
+{
+    uint8_t msg[PEER_MSG_SIZE + 1U];
+    struct sockaddr_in from;
+    socklen_t from_len = sizeof(from);
+    bool offer;
+    int len;
+
+    len = recvfrom(peer_udp, msg, sizeof(msg), 0, (struct sockaddr *)&from, &from_len);
+
+    if (!peer_msg_check(msg, len, PEER_MSG_QUERY))
+    {
+        return;
+    }
+
+    (void)xSemaphoreTake(peer_lock, portMAX_DELAY);
+    offer = peer_serving && (peer_get32(&msg[8]) == peer_image_id) &&
+            (peer_get32(&msg[12]) == peer_image_size) &&
+            (peer_client_count() < OTA_PEER_MAX_CLIENTS);
+    if (offer)
+    {
+        peer_stats.queries++;
+    }
+    (void)xSemaphoreGive(peer_lock);
+
+    if (offer)
+    {
+        peer_msg_make(msg, PEER_MSG_OFFER, peer_http_port, peer_image_id, peer_image_size);
+        (void)sendto(peer_udp, msg, PEER_MSG_SIZE, 0, (struct sockaddr *)&from, from_len);
+    }
+}
+
+
+/*******************************************************************************
+ * Function Name: peer_accept
+ *******************************************************************************
+ * Summary:
+ *  Accepts the connection of a peer, or closes it when all are in use.
+ *
+ ******************************************************************************/
+static void peer_accept(void)
+{
+    int sock = accept(peer_listen, NULL, NULL);
+
+    if (sock < 0)
+    {
+        return;
+    }
+
+    for (uint32_t i = 0U; i < OTA_PEER_MAX_CLIENTS; i++)
+    {
+        peer_client_t *client = &peer_clients[i];
+
+        if (PEER_NO_SOCKET == client->socket)
+        {
+            client->socket = sock;
+            client->len = 0U;
+            client->last = xTaskGetTickCount();
+
+            (void)xSemaphoreTake(peer_lock, portMAX_DELAY);
+            peer_stats.clients++;
+            (void)xSemaphoreGive(peer_lock);
+            return;
+        }
+    }
+
+    (void)closesocket(sock);
+}
+
+
+/*******************************************************************************
+ * Function Name: peer_send_status
+ *******************************************************************************
+ * Summary:
+ *  Sends a response without a body, after which the connection is closed.
+ *
+ * Parameters:
+ *  client - connection
+ *  status - status line, without the protocol
+ *
+ ******************************************************************************/
+static void peer_send_status(peer_client_t *client, const char *status)
+{
+    char response[PEER_RESPONSE_SIZE];
+    int len = snprintf(response, sizeof(response),
+                       "HTTP/1.1 %s\r\n"
+                       "Content-Length: 0\r\n"
+                       "Connection: close\r\n\r\n", status);
+
+    if ((len > 0) && ((size_t)len < sizeof(response)))
+    {
+        (void)peer_send_all(client->socket, response, (size_t)len);
+    }
+}
+
+
+/*******************************************************************************
+ * Function Name: peer_send_range
+ *******************************************************************************
+ * Summary:
+ *  Sends a range of the image, read from the slot chunk by chunk.
+ *
+ * Parameters:
+ *  client - connection
+ *  first - offset of the first byte
+ *  last - offset of the last byte
+ *  partial - true to answer with 206 Partial Content, else 200 OK
+ *  keep_alive - true to keep the connection open after the body
+ *
+ * Return:
+ *  bool - true if the whole range was sent
+ *
+ ******************************************************************************/
+static bool peer_send_range(peer_client_t *client, uint32_t first, uint32_t last,
+                            bool partial, bool keep_alive)
+{
+    char response[PEER_RESPONSE_SIZE];
+    uint32_t off = first;
+    int len;
+
+    if (partial)
+    {
+        len = snprintf(response, sizeof(response),
+                       "HTTP/1.1 206 Partial Content\r\n"
+                       "Content-Range: bytes %lu-%lu/%lu\r\n"
+                       "Content-Length: %lu\r\n"
+                       "Connection: %s\r\n\r\n",
+                       (unsigned long)first, (unsigned long)last, (unsigned long)peer_image_size,
+                       (unsigned long)(last - first + 1U), keep_alive ? "keep-alive" : "close");
+    }
+    else
+    {
+        len = snprintf(response, sizeof(response),
+                       "HTTP/1.1 200 OK\r\n"
+                       "Content-Length: %lu\r\n"
+                       "Connection: %s\r\n\r\n",
+                       (unsigned long)(last - first + 1U), keep_alive ? "keep-alive" : "close");
+    }
+
+    if ((len <= 0) || ((size_t)len >= sizeof(response)) ||
+        !peer_send_all(client->socket, response, (size_t)len))
+    {
+        return false;
+    }
+
+    while (off <= last)
+    {
+        uint32_t chunk = last - off + 1U;
+        bool read;
+
+        if (chunk > sizeof(peer_chunk))
+        {
+            chunk = sizeof(peer_chunk);
+        }
+
+        (void)xSemaphoreTake(peer_lock, portMAX_DELAY);
+        read = peer_serving && (0 == flash_area_read(peer_fa, off, peer_chunk, chunk));
+        (void)xSemaphoreGive(peer_lock);
+
+        if (!read || !peer_send_all(client->socket, peer_chunk, chunk))
+        {
+            return false;
+        }
+
+        off += chunk;
+    }
+
+    (void)xSemaphoreTake(peer_lock, portMAX_DELAY);
+    peer_stats.ranges++;
+    peer_stats.bytes += last - first + 1U;
+    (void)xSemaphoreGive(peer_lock);
+
+    return true;
+}
+
+
+/*******************************************************************************
+ * Function Name: peer_handle_request
+ *******************************************************************************
+ * Summary:
+ *  Answers a request of a peer: a GET of the image served, with one range
+ *  or none.
+ *
+ * Parameters:
+ *  client - connection
+ *  request - request header, NUL terminated after the end of the header
+ *
+ * Return:
+ *  bool - true to keep the connection open
+ *
+ ******************************************************************************/
+static bool peer_handle_request(peer_client_t *client, const char *request)
+{
+    const char *path = request + 4;
+    const char *range = peer_header_value(request, "range:");
+    const char *connection = peer_header_value(request, "connection:");
+    bool keep_alive = (NULL == connection) || (0 != strncmp(connection, "close", 5U));
+    uint32_t first = 0U;
+    uint32_t last;
+    char *end;
+
+    if ((0 != strncmp(request, "GET ", 4U)) ||
+        (0 != strncmp(path, OTA_PEER_PATH, strlen(OTA_PEER_PATH))))
+    {
+        peer_send_status(client, "400 Bad Request");
+        return false;
+    }
+
+    path += strlen(OTA_PEER_PATH);
+
+    if (!peer_serving || (strtoul(path, &end, 16) != peer_image_id) || (' ' != *end))
+    {
+        peer_send_status(client, "404 Not Found");
+        return false;
+    }
+
+    last = peer_image_size - 1U;
+    peer_last_request = xTaskGetTickCount();
+
+    if (NULL == range)
+    {
+        return peer_send_range(client, first, last, false, keep_alive) && keep_alive;
+    }
+
+    if (0 == strncmp(range, "bytes=", 6U))
+    {
+        first = (uint32_t)strtoul(&range[6], &end, 10);
+
+        if (('-' == *end) && (end[1] >= '0') && (end[1] <= '9'))
+        {
+            uint32_t range_last = (uint32_t)strtoul(&end[1], &end, 10);
+
+            last = (range_last < last) ? range_last : last;
+        }
+        else if ('-' != *end)
+        {
+            first = peer_image_size;
+        }
+    }
+
+    if ((first >= peer_image_size) || (first > last))
+    {
+        peer_send_status(client, "416 Range Not Satisfiable");
+        return false;
+    }
+
+    return peer_send_range(client, first, last, true, keep_alive) && keep_alive;
+}
+
+
+/*******************************************************************************
+ * Function Name: peer_client_read
+ *******************************************************************************
+ * Summary:
+ *  Receives the request of a peer and answers it once its header is complete.
+ *  Closes the connection when the peer closes it, when the request does not
+ *  fit the buffer, or after the answer to a request that ends it.
+ *
+ * Parameters:
+ *  client - connection
+ *
+ ******************************************************************************/
+static void peer_client_read(peer_client_t *client)
+{
+    int got = recv(client->socket, &client->request[client->len],
+                   OTA_PEER_REQUEST_SIZE - client->len, 0);
+    char *end;
+
+    if (got <= 0)
+    {
+        peer_close(&client->socket);
+        return;
+    }
+
+    client->len += (uint32_t)got;
+    client->request[client->len] = '\0';
+    client->last = xTaskGetTickCount();
+
+    end = strstr(client->request, PEER_HEADER_END);
+
+    if (NULL == end)
+    {
+        if (client->len >= OTA_PEER_REQUEST_SIZE)
+        {
+            peer_close(&client->socket);
+        }
+        return;
+    }
+
+    /* Keep the "\r\n" of the last header line for peer_header_value() */
+    end[2] = '\0';
+
+    if (!peer_handle_request(client, client->request))
+    {
+        peer_close(&client->socket);
+        return;
+    }
+
+    /* Bytes received after the header are kept for the next request */
+    end += strlen(PEER_HEADER_END);
+    client->len -= (uint32_t)(end - client->request);
+    memmove(client->request, end, client->len);
+    client->request[client->len] = '\0';
+}
+
+
+/*******************************************************************************
+ * Function Name: peer_task
+ *******************************************************************************
+ * Summary:
+ *  Task of the server: answers the discovery queries and the requests of the
+ *  peers. Peers are served one request at a time.
+ *
+ * Parameters:
+ *  arg - unused
+ *
+ ******************************************************************************/
+static void peer_task(void *arg)
+{
+    (void)arg;
+
+    for (uint32_t i = 0U; i < OTA_PEER_MAX_CLIENTS; i++)
+    {
+        peer_clients[i].socket = PEER_NO_SOCKET;
+    }
+
+    if (!peer_server_open())
+    {
+        configPRINTF(("OTA peer: cannot open the server sockets\r\n"));
+        peer_close(&peer_udp);
+        peer_close(&peer_listen);
+        peer_task_started = false;
+        vTaskDelete(NULL);
+        return;
+    }
+
+    configPRINTF(("OTA peer: range server on port %u\r\n", (unsigned int)peer_http_port));
+
+    while (true)
+    {
+        struct timeval timeout = { 0 };
+        TickType_t now = xTaskGetTickCount();
+        fd_set readable;
+        int max_fd = (peer_udp > peer_listen) ? peer_udp : peer_listen;
+
+        FD_ZERO(&readable);
+        FD_SET(peer_udp, &readable);
+        FD_SET(peer_listen, &readable);
+
+        for (uint32_t i = 0U; i < OTA_PEER_MAX_CLIENTS; i++)
+        {
+            peer_client_t *client = &peer_clients[i];
+
+            if ((PEER_NO_SOCKET != client->socket) &&
+                ((now - client->last) >= pdMS_TO_TICKS(OTA_PEER_CLIENT_IDLE_MS)))
+            {
+                peer_close(&client->socket);
+            }
+
+            if (PEER_NO_SOCKET != client->socket)
+            {
+                FD_SET(client->socket, &readable);
+                max_fd = (client->socket > max_fd) ? client->socket : max_fd;
+            }
+        }
+
+        timeout.tv_sec = PEER_SELECT_MS / 1000U;
+        timeout.tv_usec = (PEER_SELECT_MS % 1000U) * 1000U;
+
+        if (select(max_fd + 1, &readable, NULL, NULL, &timeout) <= 0)
+        {
+            continue;
+        }
+
+        if (FD_ISSET(peer_udp, &readable))
+        {
+            peer_answer_query();
+        }
+
+        for (uint32_t i = 0U; i < OTA_PEER_MAX_CLIENTS; i++)
+        {
+            if ((PEER_NO_SOCKET != peer_clients[i].socket) &&
+                FD_ISSET(peer_clients[i].socket, &readable))
+            {
+                peer_client_read(&peer_clients[i]);
+            }
+        }
+
+        if (FD_ISSET(peer_listen, &readable))
+        {
+            peer_accept();
+        }
+    }
+}
+
+
+/*******************************************************************************
+ * Function Name: ota_peer_image_id
+ *******************************************************************************
+ * Summary:
+ *  Derives the ID of an image from the signature of its job (FNV-1a).
+ *
+ * Parameters:
+ *  signature - signature of the job
+ *  len - size of the signature
+ *
+ * Return:
+ *  uint32_t - image ID
+ *
+ ******************************************************************************/
+uint32_t ota_peer_image_id(const uint8_t *signature, uint32_t len)
+{
+    uint32_t hash = PEER_FNV_OFFSET;
+
+    for (uint32_t i = 0U; (NULL != signature) && (i < len); i++)
+    {
+        hash = (hash ^ signature[i]) * PEER_FNV_PRIME;
+    }
+
+    return hash;
+}
+
+
+/*******************************************************************************
+ * Function Name: ota_peer_find
+ *******************************************************************************
+ * Summary:
+ *  Asks the LAN for a peer that serves an image. The first answer is taken:
+ *  servers with no free connection do not answer.
+ *
+ * Parameters:
+ *  image_id - image ID
+ *  image_size - image size
+ *  peer - set to the address of the range server of the peer
+ *
+ * Return:
+ *  bool - true if a peer answered
+ *
+ ******************************************************************************/
+bool ota_peer_find(uint32_t image_id, uint32_t image_size, ota_peer_addr_t *peer)
+{
+    struct sockaddr_in group;
+    struct in_addr interface;
+    uint8_t msg[PEER_MSG_SIZE + 1U];
+    bool found = false;
+    int sock = socket(AF_INET, SOCK_DGRAM, 0);
+
+    if (sock < 0)
+    {
+        return false;
+    }
+
+    memset(&group, 0, sizeof(group));
+    group.sin_family = AF_INET;
+    group.sin_addr.s_addr = inet_addr(CY_OTA_PEER_GROUP);
+    group.sin_port = htons(CY_OTA_PEER_DISCOVERY_PORT);
+    interface.s_addr = inet_addr(CY_OTA_PEER_INTERFACE);
+
+    (void)setsockopt(sock, IPPROTO_IP, IP_MULTICAST_IF, &interface, sizeof(interface));
+
+    for (uint32_t tries = 0U; !found && (tries < OTA_PEER_DISCOVERY_TRIES); tries++)
+    {
+        TickType_t start = xTaskGetTickCount();
+        TickType_t wait = pdMS_TO_TICKS(OTA_PEER_DISCOVERY_WAIT_MS);
+
+        peer_msg_make(msg, PEER_MSG_QUERY, 0U, image_id, image_size);
+        if (sendto(sock, msg, PEER_MSG_SIZE, 0, (struct sockaddr *)&group, sizeof(group)) < 0)
+        {
+            break;
+        }
+
+        while (!found && ((xTaskGetTickCount() - start) < wait))
+        {
+            TickType_t left = wait - (xTaskGetTickCount() - start);
+            struct timeval timeout = { 0 };
+            struct sockaddr_in from;
+            socklen_t from_len = sizeof(from);
+            fd_set readable;
+            int len;
+
+            timeout.tv_sec = (long)((left * portTICK_PERIOD_MS) / 1000U);
+            timeout.tv_usec = (long)(((left * portTICK_PERIOD_MS) % 1000U) * 1000U);
+
+            FD_ZERO(&readable);
+            FD_SET(sock, &readable);
+
+            if (select(sock + 1, &readable, NULL, NULL, &timeout) <= 0)
+            {
+                break;
+            }
+
+            len = recvfrom(sock, msg, sizeof(msg), 0, (struct sockaddr *)&from, &from_len);
+
+            if (peer_msg_check(msg, len, PEER_MSG_OFFER) &&
+                (peer_get32(&msg[8]) == image_id) && (peer_get32(&msg[12]) == image_size))
+            {
+                peer->address = from.sin_addr.s_addr;
+                peer->port = (uint16_t)(((uint16_t)msg[6] << 8) | msg[7]);
+                found = (0U != peer->port);
+            }
+        }
+    }
+
+    (void)closesocket(sock);
+
+    return found;
+}
+
+
+/*******************************************************************************
+ * Function Name: ota_peer_serve
+ *******************************************************************************
+ * Summary:
+ *  Serves the image verified in the secondary slot to the peers, starting
+ *  the server task the first time.
+ *
+ * Parameters:
+ *  image_id - image ID
+ *  image_size - image size
+ *
+ ******************************************************************************/
+void ota_peer_serve(uint32_t image_id, uint32_t image_size)
+{
+    const struct flash_area *fa;
+
+    if (NULL == peer_lock)
+    {
+        peer_lock = xSemaphoreCreateMutexStatic(&peer_lock_buffer);
+    }
+
+    if ((0U == image_size) || (0 != flash_area_open(FLASH_AREA_IMAGE_SECONDARY(0), &fa)))
+    {
+        return;
+    }
+
+    (void)xSemaphoreTake(peer_lock, portMAX_DELAY);
+    if (NULL != peer_fa)
+    {
+        flash_area_close(peer_fa);
+    }
+    peer_fa = fa;
+    peer_image_id = image_id;
+    peer_image_size = image_size;
+    peer_serving = true;
+    peer_last_request = xTaskGetTickCount();
+    memset(&peer_stats, 0, sizeof(peer_stats));
+    (void)xSemaphoreGive(peer_lock);
+
+    if (!peer_task_started)
+    {
+        peer_task_started = (pdPASS == xTaskCreate(peer_task, "OTA peer", OTA_PEER_TASK_STACK_SIZE,
+                                                   NULL, OTA_PEER_TASK_PRIORITY, NULL));
+    }
+
+    configPRINTF(("OTA peer: serving image %08lx, %lu bytes\r\n",
+                  (unsigned long)image_id, (unsigned long)image_size));
+}
+
+
+/*******************************************************************************
+ * Function Name: ota_peer_withdraw
+ *******************************************************************************
+ * Summary:
+ *  Stops serving the image, before the secondary slot is written again. A
+ *  range being sent is cut at its next chunk.
+ *
+ ******************************************************************************/
+void ota_peer_withdraw(void)
+{
+    if (NULL == peer_lock)
+    {
+        return;
+    }
+
+    (void)xSemaphoreTake(peer_lock, portMAX_DELAY);
+    peer_serving = false;
+    if (NULL != peer_fa)
+    {
+        flash_area_close(peer_fa);
+        peer_fa = NULL;
+    }
+    (void)xSemaphoreGive(peer_lock);
+}
+
+
+/*******************************************************************************
+ * Function Name: ota_peer_hold
+ *******************************************************************************
+ * Summary:
+ *  Holds the activation of the image served while the peers fetch it: until
+ *  no request came for CY_OTA_PEER_IDLE_MS, at most CY_OTA_PEER_HOLD_MS.
+ *  Prints what was served.
+ *
+ ******************************************************************************/
+void ota_peer_hold(void)
+{
+    TickType_t start = xTaskGetTickCount();
+    ota_peer_stats_t stats;
+
+    if (!peer_serving || !peer_task_started || (0U == CY_OTA_PEER_HOLD_MS))
+    {
+        return;
+    }
+
+    while (peer_serving &&
+           ((xTaskGetTickCount() - start) < pdMS_TO_TICKS(CY_OTA_PEER_HOLD_MS)) &&
+           ((xTaskGetTickCount() - peer_last_request) < pdMS_TO_TICKS(CY_OTA_PEER_IDLE_MS)))
+    {
+        vTaskDelay(pdMS_TO_TICKS(PEER_HOLD_POLL_MS));
+    }
+
+    ota_peer_get(&stats);
+
+    configPRINTF(("OTA peer: served %lu bytes in %lu ranges to %lu connections\r\n",
+                  (unsigned long)stats.bytes, (unsigned long)stats.ranges,
+                  (unsigned long)stats.clients));
+}
+
+
+/*******************************************************************************
+ * Function Name: ota_peer_get
+ *******************************************************************************
+ * Summary:
+ *  Reads the statistics of the image served.
+ *
+ * Parameters:
+ *  stats - set to the statistics
+ *
+ ******************************************************************************/
+void ota_peer_get(ota_peer_stats_t *stats)
+{
+    memset(stats, 0, sizeof(*stats));
+
+    if (NULL == peer_lock)
+    {
+        return;
+    }
+
+    (void)xSemaphoreTake(peer_lock, portMAX_DELAY);
+    *stats = peer_stats;
+    stats->serving = peer_serving;
+    stats->image_id = peer_image_id;
+    stats->image_size = peer_image_size;
+    (void)xSemaphoreGive(peer_lock);
+}
+
+#endif /* CY_OTA_PEER */
+
+
+/* [] END OF FILE */
@@ -0,0 +1,152 @@
+/******************************************************************************
+* File Name: ota_peer.h
+*
+* Description: This file contains the macros, structures and function
+* declarations of the redistribution of a verified OTA image to the other
+* devices of the LAN.
+*
+* Related Document: See README.md
+*
+*******************************************************************************
+* (c) 2020, Cypress Semiconductor Corporation. All rights reserved.
+*******************************************************************************
+* This software, including source code, documentation and related materials
+* ("Software"), is owned by Cypress Semiconductor Corporation or one of its
+* subsidiaries ("Cypress") and is protected by and subject to worldwide patent
+* protection (United States and foreign), United States copyright laws and
+* international treaty provisions. Therefore, you may use this Software only
+* as provided in the license agreement accompanying the software package from
+* which you obtained this Software ("EULA").
+*
+* If no EULA applies, Cypress hereby grants you a personal, non-exclusive,
+* non-transferable license to copy, modify, and compile the Software source
+* code solely for use in connection with Cypress's integrated circuit products.
+* Any reproduction, modification, translation, compilation, or representation
+* of this Software except as specified above is prohibited without the express
+* written permission of Cypress.
+*
+* Disclaimer: THIS SOFTWARE IS PROVIDED AS-IS, WITH NO WARRANTY OF ANY KIND,
+* EXPRESS OR IMPLIED, INCLUDING, BUT NOT LIMITED TO, NONINFRINGEMENT, IMPLIED
+* WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE. Cypress
+* reserves the right to make changes to the Software without notice. Cypress
+* does not assume any liability arising out of the application or use of the
+* Software or any product or circuit described in the Software. Cypress does
+* not authorize its products for use in any products where a malfunction or
+* failure of the Cypress product may reasonably be expected to result in
+* significant property damage, injury or death ("High Risk Product"). By
+* including Cypress's product in a High Risk Product, the manufacturer of such
+* system or application assumes all risk of such use and in doing so agrees to
+* indemnify Cypress against all liability.
+*******************************************************************************/
+#ifndef OTA_PEER_H
+#define OTA_PEER_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+
+/*******************************************************************************
+ * Macros
+ ******************************************************************************/
+/* Multicast group and UDP port of the discovery */
+#ifndef CY_OTA_PEER_GROUP
+#define CY_OTA_PEER_GROUP                   "239.255.79.80"
+#endif
+
+#ifndef CY_OTA_PEER_DISCOVERY_PORT
+#define CY_OTA_PEER_DISCOVERY_PORT          (45680U)
+#endif
+
+/* Local address of the interface used for the discovery. The default lets
+ * the stack choose; the host simulation uses the loopback interface.
+ */
+#ifndef CY_OTA_PEER_INTERFACE
+#define CY_OTA_PEER_INTERFACE               "0.0.0.0"
+#endif
+
+/* TCP port of the range server. 0 takes any free port: the port is given in
+ * the answers to the discovery.
+ */
+#ifndef CY_OTA_PEER_HTTP_PORT
+#define CY_OTA_PEER_HTTP_PORT               (0U)
+#endif
+
+/* Longest time the activation of a verified image is held back to serve the
+ * peers, and time without any request after which it is not held any more.
+ * Set CY_OTA_PEER_HOLD_MS to 0 to activate the image at once. Keep
+ * CY_OTA_PEER_IDLE_MS over OTA_PEER_RETRY_MS, so that the peers turned away
+ * by busy servers find one when they ask again.
+ */
+#ifndef CY_OTA_PEER_HOLD_MS
+#define CY_OTA_PEER_HOLD_MS                 (300000UL)
+#endif
+
+#ifndef CY_OTA_PEER_IDLE_MS
+#define CY_OTA_PEER_IDLE_MS                 (30000UL)
+#endif
+
+/* Discovery: queries sent, and time waited for an answer after each one */
+#define OTA_PEER_DISCOVERY_TRIES            (2U)
+#define OTA_PEER_DISCOVERY_WAIT_MS          (300U)
+
+/* A download that does not use a peer asks again after this long: peers that
+ * were busy or that received the image since may answer.
+ */
+#define OTA_PEER_RETRY_MS                   (10000U)
+
+/* Peers served at once. A server with this many connections does not answer
+ * the discovery, so that the next peer goes to another server.
+ */
+#define OTA_PEER_MAX_CLIENTS                (3U)
+
+/* Connection of a peer closed after this long without a request */
+#define OTA_PEER_CLIENT_IDLE_MS             (10000U)
+
+/* Request header of a peer, and bytes of the slot read and sent at once */
+#define OTA_PEER_REQUEST_SIZE               (512U)
+#define OTA_PEER_CHUNK_SIZE                 (1024U)
+
+/* Path of the image served, followed by its ID in hexadecimal */
+#define OTA_PEER_PATH                       "/ota/"
+
+/* Task of the server */
+#define OTA_PEER_TASK_STACK_SIZE            (configMINIMAL_STACK_SIZE * 8)
+#define OTA_PEER_TASK_PRIORITY              (tskIDLE_PRIORITY + 1U)
+
+
+/*******************************************************************************
+ * Data structure and enumeration
+ ******************************************************************************/
+typedef struct
+{
+    uint32_t address;           /* IPv4 address, network byte order */
+    uint16_t port;              /* TCP port of the range server */
+} ota_peer_addr_t;
+
+typedef struct
+{
+    bool serving;               /* A verified image is served */
+    uint32_t image_id;
+    uint32_t image_size;
+    uint32_t queries;           /* Discovery queries answered */
+    uint32_t clients;           /* Connections accepted */
+    uint32_t ranges;            /* Ranges served */
+    uint32_t bytes;             /* Bytes of the image served */
+} ota_peer_stats_t;
+
+
+/*******************************************************************************
+ * Function prototypes
+ ******************************************************************************/
+uint32_t ota_peer_image_id(const uint8_t *signature, uint32_t len);
+bool ota_peer_find(uint32_t image_id, uint32_t image_size, ota_peer_addr_t *peer);
+void ota_peer_serve(uint32_t image_id, uint32_t image_size);
+void ota_peer_withdraw(void);
+void ota_peer_hold(void);
+void ota_peer_get(ota_peer_stats_t *stats);
+
+
+#endif /* OTA_PEER_H */
+
+
+/* [] END OF FILE */
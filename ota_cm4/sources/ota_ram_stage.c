@@ -0,0 +1,360 @@
+/******************************************************************************
+* File Name: ota_ram_stage.c
+*
+* Description: This file implements the staging in SRAM of the OTA files of
+* up to CY_OTA_RAM_STAGE_SIZE bytes. For small data or resource updates, the
+* erases and programs interleaved with the transfer take most of its time.
+* When the file fits the budget and the heap, the writes of the blocks to the
+* secondary slot are copied to a buffer of the size of the file instead of
+* being programmed, so that the tasks that receive the blocks never wait for
+* the flash. When the file is closed, the signature check of the PAL reads
+* the image from the buffer; only a verified image is then programmed to the
+* slot, in one sequential pass, and read back. The erase of the slot is not
+* staged: it is done when the file is opened, as before.
+* The blocks staged are not checkpointed for the resume (ota_resume.c): a
+* staged download interrupted by a reset starts again.
+*
+* Related Document: See README.md
+*
+*******************************************************************************
+* (c) 2020, Cypress Semiconductor Corporation. All rights reserved.
+*******************************************************************************
+* This software, including source code, documentation and related materials
+* ("Software"), is owned by Cypress Semiconductor Corporation or one of its
+* subsidiaries ("Cypress") and is protected by and subject to worldwide patent
+* protection (United States and foreign), United States copyright laws and
+* international treaty provisions. Therefore, you may use this Software only
+* as provided in the license agreement accompanying the software package from
+* which you obtained this Software ("EULA").
+*
+* If no EULA applies, Cypress hereby grants you a personal, non-exclusive,
+* non-transferable license to copy, modify, and compile the Software source
+* code solely for use in connection with Cypress's integrated circuit products.
+* Any reproduction, modification, translation, compilation, or representation
+* of this Software except as specified above is prohibited without the express
+* written permission of Cypress.
+*
+* Disclaimer: THIS SOFTWARE IS PROVIDED AS-IS, WITH NO WARRANTY OF ANY KIND,
+* EXPRESS OR IMPLIED, INCLUDING, BUT NOT LIMITED TO, NONINFRINGEMENT, IMPLIED
+* WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE. Cypress
+* reserves the right to make changes to the Software without notice. Cypress
+* does not assume any liability arising out of the application or use of the
+* Software or any product or circuit described in the Software. Cypress does
+* not authorize its products for use in any products where a malfunction or
+* failure of the Cypress product may reasonably be expected to result in
+* significant property damage, injury or death ("High Risk Product"). By
+* including Cypress's product in a High Risk Product, the manufacturer of such
+* system or application assumes all risk of such use and in doing so agrees to
+* indemnify Cypress against all liability.
+*******************************************************************************/
+#include <string.h>
+#include "FreeRTOS.h"
+#include "task.h"
+#include "sysflash/sysflash.h"
+#include "ota_ram_stage.h"
+
+#if defined(CY_OTA_RAM_STAGE)
+
+/*******************************************************************************
+ * Global variables
+ ******************************************************************************/
+/* Set in the agent task when the file is opened and closed. The writes come
+ * from the task that writes the blocks, one at a time.
+ */
+static uint8_t *stage_buffer;
+static const struct flash_area *stage_fa;
+static uint32_t stage_size;             /* Bytes staged: the size of the file */
+static bool stage_serving;              /* Reads of the file served from the buffer */
+static bool stage_committing;           /* Writes of the commit in progress */
+static uint8_t stage_check[OTA_RAM_STAGE_CHECK_SIZE];
+
+/* Statistics of the transfer */
+static uint32_t stat_writes;            /* Writes kept in the buffer */
+
+
+/*******************************************************************************
+ * Function definitions
+ ******************************************************************************/
+
+/*******************************************************************************
+ * Function Name: stage_covers
+ *******************************************************************************
+ * Summary:
+ *  Checks whether a range of a flash area starts in the staged file.
+ *
+ * Parameters:
+ *  fa - flash area
+ *  off - offset within the flash area
+ *  len - length of the range
+ *
+ * Return:
+ *  bool - true if the range starts in the staged file
+ *
+ ******************************************************************************/
+static bool stage_covers(const struct flash_area *fa, uint32_t off, uint32_t len)
+{
+    return (NULL != stage_buffer) && !stage_committing && (0U != len) &&
+           (FLASH_AREA_IMAGE_SECONDARY(0) == fa->fa_id) && (off < stage_size);
+}
+
+
+/*******************************************************************************
+ * Function Name: ota_ram_stage_begin
+ *******************************************************************************
+ * Summary:
+ *  Starts staging a new file when it fits CY_OTA_RAM_STAGE_SIZE and the
+ *  heap. With the resume, the buffer starts with the content of the slot,
+ *  which holds the blocks kept from before a reset. Must be called once the
+ *  PAL has opened the file.
+ *
+ * Parameters:
+ *  C - OTA file context
+ *
+ * Return:
+ *  bool - true if the file is staged
+ *
+ ******************************************************************************/
+bool ota_ram_stage_begin(const OTA_FileContext_t *C)
+{
+    ota_ram_stage_end();
+
+    stat_writes = 0U;
+
+    if ((0U == C->ulFileSize) || (C->ulFileSize > CY_OTA_RAM_STAGE_SIZE))
+    {
+        return false;
+    }
+
+    if ((xPortGetFreeHeapSize() >= (C->ulFileSize + OTA_RAM_STAGE_HEAP_RESERVE)) &&
+        (0 == flash_area_open(FLASH_AREA_IMAGE_SECONDARY(0), &stage_fa)))
+    {
+        stage_buffer = pvPortMalloc(C->ulFileSize);
+
+        if (NULL == stage_buffer)
+        {
+            flash_area_close(stage_fa);
+        }
+    }
+
+    if (NULL == stage_buffer)
+    {
+        configPRINTF(("OTA RAM stage: no room for %u bytes, writing to flash\r\n",
+                      (unsigned int)C->ulFileSize));
+        return false;
+    }
+
+#if defined(CY_OTA_RESUME)
+    if (0 != flash_area_read(stage_fa, 0U, stage_buffer, C->ulFileSize))
+    {
+        ota_ram_stage_end();
+        return false;
+    }
+#else
+    memset(stage_buffer, 0xFF, C->ulFileSize);
+#endif
+
+    stage_size = C->ulFileSize;
+
+    return true;
+}
+
+
+/*******************************************************************************
+ * Function Name: ota_ram_stage_active
+ *******************************************************************************
+ * Summary:
+ *  Checks whether the file being received is staged.
+ *
+ * Return:
+ *  bool - true if the writes of the file are kept in SRAM
+ *
+ ******************************************************************************/
+bool ota_ram_stage_active(void)
+{
+    return (NULL != stage_buffer);
+}
+
+
+/*******************************************************************************
+ * Function Name: ota_ram_stage_intercept
+ *******************************************************************************
+ * Summary:
+ *  Called for every write. The part of a write to the secondary slot that
+ *  falls into the staged file is copied to the buffer; the rest, if any, is
+ *  written to flash.
+ *
+ * Parameters:
+ *  fa - flash area
+ *  off - offset within the flash area
+ *  src - data
+ *  len - number of bytes
+ *  handled - set to true if the write was taken by the stage
+ *
+ * Return:
+ *  int - 0 on success, non-zero otherwise
+ *
+ ******************************************************************************/
+int ota_ram_stage_intercept(const struct flash_area *fa, uint32_t off, const void *src,
+                            uint32_t len, bool *handled)
+{
+    uint32_t head;
+
+    *handled = stage_covers(fa, off, len);
+
+    if (!*handled)
+    {
+        return 0;
+    }
+
+    head = ((stage_size - off) < len) ? (stage_size - off) : len;
+    memcpy(&stage_buffer[off], src, head);
+    stat_writes++;
+
+    if (head < len)
+    {
+        return flash_area_write(fa, stage_size, (const uint8_t *)src + head, len - head);
+    }
+
+    return 0;
+}
+
+
+/*******************************************************************************
+ * Function Name: ota_ram_stage_read
+ *******************************************************************************
+ * Summary:
+ *  Called for every read. While the file is verified, the part of a read of
+ *  the secondary slot that falls into the staged file is served from the
+ *  buffer; the rest, if any, is read from flash.
+ *
+ * Parameters:
+ *  fa - flash area
+ *  off - offset within the flash area
+ *  dst - destination buffer
+ *  len - number of bytes to read
+ *  rc - set to the result of the read, if served
+ *
+ * Return:
+ *  bool - true if the read was served by the stage
+ *
+ ******************************************************************************/
+bool ota_ram_stage_read(const struct flash_area *fa, uint32_t off, void *dst, uint32_t len,
+                        int *rc)
+{
+    uint32_t head;
+
+    if (!stage_serving || !stage_covers(fa, off, len))
+    {
+        return false;
+    }
+
+    head = ((stage_size - off) < len) ? (stage_size - off) : len;
+    memcpy(dst, &stage_buffer[off], head);
+    *rc = 0;
+
+    if (head < len)
+    {
+        *rc = flash_area_read(fa, stage_size, (uint8_t *)dst + head, len - head);
+    }
+
+    return true;
+}
+
+
+/*******************************************************************************
+ * Function Name: ota_ram_stage_serve_reads
+ *******************************************************************************
+ * Summary:
+ *  Starts or stops serving the reads of the staged file from the buffer. The
+ *  reads made during the transfer, such as the blank checks of the erases,
+ *  are about the flash and are not served.
+ *
+ * Parameters:
+ *  serve - true while the PAL verifies the file
+ *
+ ******************************************************************************/
+void ota_ram_stage_serve_reads(bool serve)
+{
+    stage_serving = serve;
+}
+
+
+/*******************************************************************************
+ * Function Name: ota_ram_stage_commit
+ *******************************************************************************
+ * Summary:
+ *  Programs the staged file to the secondary slot in one sequential pass,
+ *  then reads it back. Must be called once the file is verified.
+ *
+ * Return:
+ *  bool - true if the file is in flash, or was not staged
+ *
+ ******************************************************************************/
+bool ota_ram_stage_commit(void)
+{
+    TickType_t start = xTaskGetTickCount();
+    bool committed = true;
+    uint32_t off;
+
+    if (NULL == stage_buffer)
+    {
+        return true;
+    }
+
+    stage_committing = true;
+
+    for (off = 0U; committed && (off < stage_size); off += OTA_RAM_STAGE_COMMIT_SIZE)
+    {
+        uint32_t len = ((stage_size - off) < OTA_RAM_STAGE_COMMIT_SIZE) ?
+                       (stage_size - off) : OTA_RAM_STAGE_COMMIT_SIZE;
+
+        committed = (0 == flash_area_write(stage_fa, off, &stage_buffer[off], len));
+    }
+
+    for (off = 0U; committed && (off < stage_size); off += OTA_RAM_STAGE_CHECK_SIZE)
+    {
+        uint32_t len = ((stage_size - off) < OTA_RAM_STAGE_CHECK_SIZE) ?
+                       (stage_size - off) : OTA_RAM_STAGE_CHECK_SIZE;
+
+        committed = (0 == flash_area_read(stage_fa, off, stage_check, len)) &&
+                    (0 == memcmp(stage_check, &stage_buffer[off], len));
+    }
+
+    stage_committing = false;
+
+    configPRINTF(("OTA RAM stage: %u bytes from %u writes %s in %u ms\r\n",
+                  (unsigned int)stage_size, (unsigned int)stat_writes,
+                  committed ? "committed" : "NOT committed",
+                  (unsigned int)((xTaskGetTickCount() - start) * portTICK_PERIOD_MS)));
+
+    return committed;
+}
+
+
+/*******************************************************************************
+ * Function Name: ota_ram_stage_end
+ *******************************************************************************
+ * Summary:
+ *  Stops staging and frees the buffer. Called when the file is closed or
+ *  aborted; the writes that follow go to flash.
+ *
+ ******************************************************************************/
+void ota_ram_stage_end(void)
+{
+    if (NULL != stage_buffer)
+    {
+        vPortFree(stage_buffer);
+        flash_area_close(stage_fa);
+    }
+
+    stage_buffer = NULL;
+    stage_fa = NULL;
+    stage_size = 0U;
+    stage_serving = false;
+    stage_committing = false;
+}
+
+#endif /* CY_OTA_RAM_STAGE */
+
+
+/* [] END OF FILE */
@@ -0,0 +1,92 @@
+/******************************************************************************
+* File Name: ota_ram_stage.h
+*
+* Description: This file contains the macros and function declarations of the
+* staging in SRAM of the OTA files that fit a RAM budget.
+*
+* Related Document: See README.md
+*
+*******************************************************************************
+* (c) 2020, Cypress Semiconductor Corporation. All rights reserved.
+*******************************************************************************
+* This software, including source code, documentation and related materials
+* ("Software"), is owned by Cypress Semiconductor Corporation or one of its
+* subsidiaries ("Cypress") and is protected by and subject to worldwide patent
+* protection (United States and foreign), United States copyright laws and
+* international treaty provisions. Therefore, you may use this Software only
+* as provided in the license agreement accompanying the software package from
+* which you obtained this Software ("EULA").
+*
+* If no EULA applies, Cypress hereby grants you a personal, non-exclusive,
+* non-transferable license to copy, modify, and compile the Software source
+* code solely for use in connection with Cypress's integrated circuit products.
+* Any reproduction, modification, translation, compilation, or representation
+* of this Software except as specified above is prohibited without the express
+* written permission of Cypress.
+*
+* Disclaimer: THIS SOFTWARE IS PROVIDED AS-IS, WITH NO WARRANTY OF ANY KIND,
+* EXPRESS OR IMPLIED, INCLUDING, BUT NOT LIMITED TO, NONINFRINGEMENT, IMPLIED
+* WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE. Cypress
+* reserves the right to make changes to the Software without notice. Cypress
+* does not assume any liability arising out of the application or use of the
+* Software or any product or circuit described in the Software. Cypress does
+* not authorize its products for use in any products where a malfunction or
+* failure of the Cypress product may reasonably be expected to result in
+* significant property damage, injury or death ("High Risk Product"). By
+* including Cypress's product in a High Risk Product, the manufacturer of such
+* system or application assumes all risk of such use and in doing so agrees to
+* indemnify Cypress against all liability.
+*******************************************************************************/
+#ifndef OTA_RAM_STAGE_H
+#define OTA_RAM_STAGE_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "flash_map_backend/flash_map_backend.h"
+#include "aws_iot_ota_agent.h"
+
+#if defined(CY_OTA_RAM_STAGE) && defined(CY_OTA_TAR_STREAM)
+#error "CY_OTA_RAM_STAGE stages the secondary slot: the members of a TAR archive go to other partitions"
+#endif
+
+
+/*******************************************************************************
+ * Macros
+ ******************************************************************************/
+/* Largest file staged in SRAM. Set with OTA_RAM_STAGE_SIZE in the Makefile.
+ * Larger files are written to flash as they are received.
+ */
+#ifndef CY_OTA_RAM_STAGE_SIZE
+#define CY_OTA_RAM_STAGE_SIZE               (131072UL)
+#endif
+
+/* Heap left free once the file is staged, for the TLS and HTTP connections
+ * of the transfer.
+ */
+#define OTA_RAM_STAGE_HEAP_RESERVE          (65536UL)
+
+/* Size of the writes of the commit, and of the reads that check it. The
+ * writes start at the start of the slot, so each one stays within a sector.
+ */
+#define OTA_RAM_STAGE_COMMIT_SIZE           (4096UL)
+#define OTA_RAM_STAGE_CHECK_SIZE            (512UL)
+
+
+/*******************************************************************************
+ * Function prototypes
+ ******************************************************************************/
+bool ota_ram_stage_begin(const OTA_FileContext_t *C);
+bool ota_ram_stage_active(void);
+int ota_ram_stage_intercept(const struct flash_area *fa, uint32_t off, const void *src,
+                            uint32_t len, bool *handled);
+bool ota_ram_stage_read(const struct flash_area *fa, uint32_t off, void *dst, uint32_t len,
+                        int *rc);
+void ota_ram_stage_serve_reads(bool serve);
+bool ota_ram_stage_commit(void);
+void ota_ram_stage_end(void);
+
+
+#endif /* OTA_RAM_STAGE_H */
+
+
+/* [] END OF FILE */
@@ -0,0 +1,819 @@
+/******************************************************************************
+* File Name: ota_resume.c
+*
+* Description: This file implements the checkpoints of the received blocks of
+* an OTA download, so that a download interrupted by a reset or a power loss
+* resumes where it stopped instead of starting again from the first block.
+* Every CY_OTA_RESUME_CHECKPOINT_SIZE bytes written to the secondary slot, the
+* bitmap of the received blocks is appended to a log in the external flash,
+* with a hash identifying the job, the file and the slot receiving it. The
+* log is append-only over two sectors: a sector is erased only when the
+* other one is full, once every few hundred checkpoints.
+* When the agent opens the same file again after a reset, the sectors holding
+* received blocks are not erased, and the blocks are marked as received in
+* the bitmap of the agent, which then only requests the missing ones.
+*
+* Related Document: See README.md
+*
+*******************************************************************************
+* (c) 2020, Cypress Semiconductor Corporation. All rights reserved.
+*******************************************************************************
+* This software, including source code, documentation and related materials
+* ("Software"), is owned by Cypress Semiconductor Corporation or one of its
+* subsidiaries ("Cypress") and is protected by and subject to worldwide patent
+* protection (United States and foreign), United States copyright laws and
+* international treaty provisions. Therefore, you may use this Software only
+* as provided in the license agreement accompanying the software package from
+* which you obtained this Software ("EULA").
+*
+* If no EULA applies, Cypress hereby grants you a personal, non-exclusive,
+* non-transferable license to copy, modify, and compile the Software source
+* code solely for use in connection with Cypress's integrated circuit products.
+* Any reproduction, modification, translation, compilation, or representation
+* of this Software except as specified above is prohibited without the express
+* written permission of Cypress.
+*
+* Disclaimer: THIS SOFTWARE IS PROVIDED AS-IS, WITH NO WARRANTY OF ANY KIND,
+* EXPRESS OR IMPLIED, INCLUDING, BUT NOT LIMITED TO, NONINFRINGEMENT, IMPLIED
+* WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE. Cypress
+* reserves the right to make changes to the Software without notice. Cypress
+* does not assume any liability arising out of the application or use of the
+* Software or any product or circuit described in the Software. Cypress does
+* not authorize its products for use in any products where a malfunction or
+* failure of the Cypress product may reasonably be expected to result in
+* significant property damage, injury or death ("High Risk Product"). By
+* including Cypress's product in a High Risk Product, the manufacturer of such
+* system or application assumes all risk of such use and in doing so agrees to
+* indemnify Cypress against all liability.
+*******************************************************************************/
+#include <string.h>
+#include "cy_pdl.h"
+#include "FreeRTOS.h"
+#include "sysflash/sysflash.h"
+#include "slot_ring.h"
+#include "ota_block_size.h"
+#include "ota_resume.h"
+
+#if defined(CY_OTA_STREAM_HASH)
+#include "ota_stream_hash.h"
+#endif
+
+#if defined(CY_OTA_WRITE_COALESCE)
+#include "ota_write_coalesce.h"
+#endif
+
+#if defined(CY_OTA_RAM_STAGE)
+#include "ota_ram_stage.h"
+#endif
+
+#if defined(CY_OTA_RESUME)
+
+/*******************************************************************************
+ * Macros
+ ******************************************************************************/
+#define RESUME_MAGIC                    (0x4D555352UL) /* "RSUM" */
+#define RESUME_ERASED_MAGIC             (0xFFFFFFFFUL)
+#define RESUME_RECORDS_PER_SECTOR       (CY_OTA_RESUME_SECTOR_SIZE /\
+                                         CY_OTA_RESUME_RECORD_SIZE)
+
+/* FNV-1a parameters used for the record checksum and the file identity */
+#define RESUME_FNV_OFFSET               (0x811C9DC5UL)
+#define RESUME_FNV_PRIME                (0x01000193UL)
+
+/* Units written in several pieces tracked at once: one per HTTP connection
+ * is enough. A unit dropped from the table is downloaded again after a reset.
+ */
+#define RESUME_PARTIAL_UNITS            (8U)
+
+/* Largest file: one that fills the secondary slot */
+#define RESUME_UNITS_MAX                ((CY_BOOT_SECONDARY_1_SIZE + OTA_BLOCK_UNIT_SIZE - 1UL) /\
+                                         OTA_BLOCK_UNIT_SIZE)
+#define RESUME_BITMAP_SIZE              ((RESUME_UNITS_MAX + 7UL) / 8UL)
+
+/* The log follows the slot ring index */
+#define RESUME_LOG_OFF                  ((CY_SLOT_RING_COUNT * CY_BOOT_SECONDARY_1_SIZE) +\
+                                         (2UL * CY_SLOT_RING_INDEX_SECTOR_SIZE))
+
+CY_STATIC_ASSERT((RESUME_LOG_OFF + (2UL * CY_OTA_RESUME_SECTOR_SIZE)) <=
+                 CY_SLOT_RING_EXT_FLASH_SIZE,
+                 "OTA resume log does not fit in the external flash");
+
+
+/*******************************************************************************
+ * Data structure and enumeration
+ ******************************************************************************/
+typedef struct
+{
+    uint32_t magic;
+    uint32_t seq;
+    uint32_t identity;          /* Hash of the job, the file and the slot */
+    uint32_t file_size;
+    uint32_t received;          /* Units received */
+    uint16_t unit_size;
+    uint16_t bitmap_len;        /* 0 when no download is in progress */
+    uint32_t reserved;
+    uint32_t checksum;
+} resume_header_t;
+
+typedef struct
+{
+    resume_header_t hdr;
+    uint8_t bitmap[RESUME_BITMAP_SIZE]; /* Bit set: unit received */
+} resume_record_t;
+
+/* Unit written in several pieces, from its start */
+typedef struct
+{
+    uint32_t unit;
+    uint32_t written;           /* Bytes written from the start of the unit */
+} resume_partial_t;
+
+CY_STATIC_ASSERT(sizeof(resume_header_t) == 32U,
+                 "Unexpected OTA resume header size");
+CY_STATIC_ASSERT(sizeof(resume_record_t) <= CY_OTA_RESUME_RECORD_SIZE,
+                 "OTA resume bitmap does not fit in a record");
+
+
+/*******************************************************************************
+ * Global variables
+ ******************************************************************************/
+static struct flash_area log_area =
+{
+    .fa_id = CY_OTA_RESUME_AREA_ID,
+    .fa_device_id = FLASH_DEVICE_EXTERNAL_FLASH(CY_BOOT_EXTERNAL_DEVICE_INDEX),
+    .fa_off = CY_SMIF_BASE_MEM_OFFSET + RESUME_LOG_OFF,
+    .fa_size = 2UL * CY_OTA_RESUME_SECTOR_SIZE
+};
+
+/* Received units of the file, written as is at each checkpoint. Only used by
+ * the task that writes the blocks, then by the agent task once every block
+ * is written.
+ */
+static resume_record_t resume_rec;
+
+static uint32_t log_seq;
+static uint32_t log_sector;             /* Log sector being appended to */
+static uint32_t log_next;               /* Next free record in log_sector */
+static bool log_dirty;                  /* Log holds a download in progress */
+
+static uint32_t file_size;
+static uint32_t file_units;
+static bool resume_tracking;            /* Received units are recorded */
+static bool resume_keeping;             /* Units kept from before the reset */
+static uint32_t pending_bytes;          /* Received since the last checkpoint */
+static resume_partial_t resume_partial[RESUME_PARTIAL_UNITS];
+static uint32_t partial_next;           /* Entry replaced when the table is full */
+
+/* Statistics of the transfer */
+static uint32_t stat_restored;
+static uint32_t stat_checkpoints;
+
+
+/*******************************************************************************
+ * Function definitions
+ ******************************************************************************/
+
+/*******************************************************************************
+ * Function Name: resume_fnv
+ *******************************************************************************
+ * Summary:
+ *  Adds bytes to an FNV-1a hash.
+ *
+ * Parameters:
+ *  hash - hash so far
+ *  data - bytes to add
+ *  len - number of bytes
+ *
+ * Return:
+ *  uint32_t - updated hash
+ *
+ ******************************************************************************/
+static uint32_t resume_fnv(uint32_t hash, const void *data, uint32_t len)
+{
+    const uint8_t *p = (const uint8_t *)data;
+
+    while (len-- > 0U)
+    {
+        hash = (hash ^ *p++) * RESUME_FNV_PRIME;
+    }
+
+    return hash;
+}
+
+
+/*******************************************************************************
+ * Function Name: resume_checksum
+ *******************************************************************************
+ * Summary:
+ *  Computes the checksum of a log record.
+ *
+ * Parameters:
+ *  rec - record to compute the checksum of
+ *
+ * Return:
+ *  uint32_t - FNV-1a hash of the header up to the checksum field and of the
+ *  bitmap
+ *
+ ******************************************************************************/
+static uint32_t resume_checksum(const resume_record_t *rec)
+{
+    uint32_t hash = resume_fnv(RESUME_FNV_OFFSET, &rec->hdr,
+                               offsetof(resume_header_t, checksum));
+
+    return resume_fnv(hash, rec->bitmap, rec->hdr.bitmap_len);
+}
+
+
+/*******************************************************************************
+ * Function Name: resume_identity
+ *******************************************************************************
+ * Summary:
+ *  Computes the identity of a download: job, stream, file, signature and
+ *  position of the slot receiving it.
+ *
+ * Parameters:
+ *  C - OTA file context
+ *  fa - secondary slot
+ *
+ * Return:
+ *  uint32_t - FNV-1a hash of the identity
+ *
+ ******************************************************************************/
+static uint32_t resume_identity(const OTA_FileContext_t *C, const struct flash_area *fa)
+{
+    uint32_t hash = RESUME_FNV_OFFSET;
+
+    if (NULL != C->pucJobName)
+    {
+        hash = resume_fnv(hash, C->pucJobName, strlen((const char *)C->pucJobName));
+    }
+
+    if (NULL != C->pucStreamName)
+    {
+        hash = resume_fnv(hash, C->pucStreamName, strlen((const char *)C->pucStreamName));
+    }
+
+    if ((NULL != C->pxSignature) && (C->pxSignature->usSize <= sizeof(C->pxSignature->ucData)))
+    {
+        hash = resume_fnv(hash, C->pxSignature->ucData, C->pxSignature->usSize);
+    }
+
+    hash = resume_fnv(hash, &C->ulServerFileID, sizeof(C->ulServerFileID));
+    hash = resume_fnv(hash, &C->ulFileSize, sizeof(C->ulFileSize));
+
+    return resume_fnv(hash, &fa->fa_off, sizeof(fa->fa_off));
+}
+
+
+/*******************************************************************************
+ * Function Name: resume_unit_received
+ *******************************************************************************
+ * Summary:
+ *  Checks whether a unit of the file is recorded as received.
+ *
+ * Parameters:
+ *  unit - unit index
+ *
+ * Return:
+ *  bool - true if the unit was written to the slot
+ *
+ ******************************************************************************/
+static bool resume_unit_received(uint32_t unit)
+{
+    return (resume_rec.bitmap[unit / 8U] & (1U << (unit % 8U))) != 0U;
+}
+
+
+/*******************************************************************************
+ * Function Name: resume_unit_set
+ *******************************************************************************
+ * Summary:
+ *  Records a unit of the file as received.
+ *
+ * Parameters:
+ *  unit - unit index
+ *
+ ******************************************************************************/
+static void resume_unit_set(uint32_t unit)
+{
+    if (!resume_unit_received(unit))
+    {
+        resume_rec.bitmap[unit / 8U] |= (uint8_t)(1U << (unit % 8U));
+        resume_rec.hdr.received++;
+        pending_bytes += OTA_BLOCK_UNIT_SIZE;
+    }
+}
+
+
+/*******************************************************************************
+ * Function Name: resume_unit_piece
+ *******************************************************************************
+ * Summary:
+ *  Records a piece of a unit. The unit is received once its pieces cover it
+ *  from its start to its end, in order.
+ *
+ * Parameters:
+ *  unit - unit index
+ *  from - offset of the piece in the unit
+ *  to - offset after the piece in the unit
+ *  size - size of the unit
+ *
+ ******************************************************************************/
+static void resume_unit_piece(uint32_t unit, uint32_t from, uint32_t to, uint32_t size)
+{
+    resume_partial_t *entry = NULL;
+
+    for (uint32_t i = 0U; i < RESUME_PARTIAL_UNITS; i++)
+    {
+        if ((resume_partial[i].written > 0U) && (unit == resume_partial[i].unit))
+        {
+            entry = &resume_partial[i];
+            break;
+        }
+    }
+
+    if (NULL == entry)
+    {
+        if (0U != from)
+        {
+            return;
+        }
+
+        entry = &resume_partial[partial_next];
+        partial_next = (partial_next + 1U) % RESUME_PARTIAL_UNITS;
+        entry->unit = unit;
+        entry->written = 0U;
+    }
+
+    if ((from <= entry->written) && (to > entry->written))
+    {
+        entry->written = to;
+    }
+
+    if (entry->written >= size)
+    {
+        entry->written = 0U;
+        resume_unit_set(unit);
+    }
+}
+
+
+/*******************************************************************************
+ * Function Name: resume_scan_sector
+ *******************************************************************************
+ * Summary:
+ *  Counts the records of one log sector.
+ *
+ * Parameters:
+ *  sector - log sector (0 or 1)
+ *  first_seq - sequence number of the first record, if any
+ *  last_seq - sequence number of the last record, if any
+ *  full - set to true when the sector cannot be appended to
+ *
+ * Return:
+ *  uint32_t - number of records in the sector
+ *
+ ******************************************************************************/
+static uint32_t resume_scan_sector(uint32_t sector, uint32_t *first_seq, uint32_t *last_seq,
+                                   bool *full)
+{
+    resume_header_t hdr;
+    uint32_t count = 0U;
+
+    for (; count < RESUME_RECORDS_PER_SECTOR; count++)
+    {
+        uint32_t off = (sector * CY_OTA_RESUME_SECTOR_SIZE) +
+                       (count * CY_OTA_RESUME_RECORD_SIZE);
+
+        if (0 != flash_area_read(&log_area, off, &hdr, sizeof(hdr)))
+        {
+            *full = true;
+            break;
+        }
+
+        if (RESUME_MAGIC != hdr.magic)
+        {
+            /* A record torn before its magic was written: do not append
+             * over it, the next record goes to the other sector.
+             */
+            *full = (RESUME_ERASED_MAGIC != hdr.magic);
+            break;
+        }
+
+        if (0U == count)
+        {
+            *first_seq = hdr.seq;
+        }
+
+        *last_seq = hdr.seq;
+    }
+
+    return count;
+}
+
+
+/*******************************************************************************
+ * Function Name: resume_read_latest
+ *******************************************************************************
+ * Summary:
+ *  Reads the last valid record of a log sector into resume_rec. Torn records
+ *  are skipped.
+ *
+ * Parameters:
+ *  sector - log sector (0 or 1)
+ *  count - number of records in the sector
+ *
+ * Return:
+ *  bool - true if a valid record was found
+ *
+ ******************************************************************************/
+static bool resume_read_latest(uint32_t sector, uint32_t count)
+{
+    while (count-- > 0U)
+    {
+        uint32_t off = (sector * CY_OTA_RESUME_SECTOR_SIZE) +
+                       (count * CY_OTA_RESUME_RECORD_SIZE);
+
+        if ((0 == flash_area_read(&log_area, off, &resume_rec, sizeof(resume_rec))) &&
+            (RESUME_MAGIC == resume_rec.hdr.magic) &&
+            (resume_rec.hdr.bitmap_len <= RESUME_BITMAP_SIZE) &&
+            (resume_checksum(&resume_rec) == resume_rec.hdr.checksum))
+        {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+
+/*******************************************************************************
+ * Function Name: resume_load
+ *******************************************************************************
+ * Summary:
+ *  Finds the end of the log and reads its last valid record into resume_rec.
+ *
+ * Return:
+ *  bool - true if a valid record was found
+ *
+ ******************************************************************************/
+static bool resume_load(void)
+{
+    uint32_t first_seq[2] = { 0U, 0U };
+    uint32_t last_seq[2] = { 0U, 0U };
+    bool full[2] = { false, false };
+    uint32_t count[2];
+    bool found;
+
+    count[0] = resume_scan_sector(0U, &first_seq[0], &last_seq[0], &full[0]);
+    count[1] = resume_scan_sector(1U, &first_seq[1], &last_seq[1], &full[1]);
+
+    /* The sector appended to last starts with the newer records. */
+    log_sector = ((count[1] > 0U) &&
+                  ((0U == count[0]) || ((int32_t)(first_seq[1] - first_seq[0]) > 0))) ? 1U : 0U;
+    log_next = full[log_sector] ? RESUME_RECORDS_PER_SECTOR : count[log_sector];
+    log_seq = (count[log_sector] > 0U) ? last_seq[log_sector] : last_seq[log_sector ^ 1U];
+
+    found = resume_read_latest(log_sector, count[log_sector]) ||
+            resume_read_latest(log_sector ^ 1U, count[log_sector ^ 1U]);
+
+    if (!found)
+    {
+        memset(&resume_rec.hdr, 0, sizeof(resume_rec.hdr));
+    }
+
+    return found;
+}
+
+
+/*******************************************************************************
+ * Function Name: resume_append
+ *******************************************************************************
+ * Summary:
+ *  Appends resume_rec to the log. When the current sector is full, the other
+ *  one is erased and used instead: its records are older than the ones of
+ *  the full sector.
+ *
+ * Return:
+ *  int - 0 on success, -1 otherwise
+ *
+ ******************************************************************************/
+static int resume_append(void)
+{
+    uint32_t off;
+
+    if (log_next >= RESUME_RECORDS_PER_SECTOR)
+    {
+        log_sector ^= 1U;
+        log_next = 0U;
+    }
+
+    off = (log_sector * CY_OTA_RESUME_SECTOR_SIZE) + (log_next * CY_OTA_RESUME_RECORD_SIZE);
+
+    if ((0U == log_next) &&
+        (0 != flash_area_erase(&log_area, log_sector * CY_OTA_RESUME_SECTOR_SIZE,
+                               CY_OTA_RESUME_SECTOR_SIZE)))
+    {
+        return -1;
+    }
+
+    resume_rec.hdr.magic = RESUME_MAGIC;
+    resume_rec.hdr.seq = log_seq + 1U;
+    resume_rec.hdr.reserved = 0U;
+    resume_rec.hdr.checksum = resume_checksum(&resume_rec);
+
+    log_next++;
+
+    if (0 != flash_area_write(&log_area, off, &resume_rec,
+                              sizeof(resume_header_t) + resume_rec.hdr.bitmap_len))
+    {
+        return -1;
+    }
+
+    log_seq = resume_rec.hdr.seq;
+
+    return 0;
+}
+
+
+/*******************************************************************************
+ * Function Name: ota_resume_begin
+ *******************************************************************************
+ * Summary:
+ *  Starts recording the received units of a new file. Must be called before
+ *  the PAL opens the file: when the log holds a checkpoint of the same
+ *  download, the sectors holding its units are kept from then on.
+ *  The last unit is never kept, so that the agent receives at least one
+ *  block and closes the file.
+ *
+ * Parameters:
+ *  C - OTA file context
+ *
+ ******************************************************************************/
+void ota_resume_begin(const OTA_FileContext_t *C)
+{
+    const struct flash_area *fa;
+    uint32_t identity;
+    uint16_t bitmap_len;
+    bool found;
+
+    resume_tracking = false;
+    resume_keeping = false;
+    pending_bytes = 0U;
+    memset(resume_partial, 0, sizeof(resume_partial));
+    partial_next = 0U;
+    stat_restored = 0U;
+    stat_checkpoints = 0U;
+
+    file_size = C->ulFileSize;
+    file_units = (file_size + OTA_BLOCK_UNIT_SIZE - 1U) / OTA_BLOCK_UNIT_SIZE;
+    bitmap_len = (uint16_t)((file_units + 7U) / 8U);
+
+    if ((0U == file_units) || (file_units > RESUME_UNITS_MAX) ||
+        (0 != flash_area_open(FLASH_AREA_IMAGE_SECONDARY(0), &fa)))
+    {
+        return;
+    }
+
+    identity = resume_identity(C, fa);
+    flash_area_close(fa);
+
+    found = resume_load();
+    log_dirty = found && (0U != resume_rec.hdr.bitmap_len);
+
+    if (found && (identity == resume_rec.hdr.identity) && (file_size == resume_rec.hdr.file_size) &&
+        (OTA_BLOCK_UNIT_SIZE == resume_rec.hdr.unit_size) && (bitmap_len == resume_rec.hdr.bitmap_len))
+    {
+        uint32_t last = file_units - 1U;
+
+        if (resume_unit_received(last))
+        {
+            resume_rec.bitmap[last / 8U] &= (uint8_t)~(1U << (last % 8U));
+            resume_rec.hdr.received--;
+        }
+
+        resume_keeping = (0U != resume_rec.hdr.received);
+    }
+    else
+    {
+        memset(resume_rec.bitmap, 0, sizeof(resume_rec.bitmap));
+        resume_rec.hdr.received = 0U;
+    }
+
+    resume_rec.hdr.identity = identity;
+    resume_rec.hdr.file_size = file_size;
+    resume_rec.hdr.unit_size = (uint16_t)OTA_BLOCK_UNIT_SIZE;
+    resume_rec.hdr.bitmap_len = bitmap_len;
+    resume_tracking = true;
+}
+
+
+/*******************************************************************************
+ * Function Name: ota_resume_restore
+ *******************************************************************************
+ * Summary:
+ *  Marks the units kept from before the reset as received in the bitmap of
+ *  the agent, and adds them to the hash of the file. Must be called once the
+ *  PAL has opened the file, before the first block is requested.
+ *
+ * Parameters:
+ *  C - OTA file context
+ *
+ ******************************************************************************/
+void ota_resume_restore(OTA_FileContext_t *C)
+{
+    if (!resume_keeping)
+    {
+        return;
+    }
+
+    for (uint32_t unit = 0U; unit < file_units; unit++)
+    {
+        uint8_t mask = (uint8_t)(1U << (unit % 8U));
+
+        if (resume_unit_received(unit) && ((C->pucRxBlockBitmap[unit / 8U] & mask) != 0U))
+        {
+            C->pucRxBlockBitmap[unit / 8U] &= (uint8_t)~mask;
+            C->ulBlocksRemaining--;
+            stat_restored++;
+        }
+    }
+
+#if defined(CY_OTA_STREAM_HASH)
+    for (uint32_t unit = 0U; unit < file_units; unit++)
+    {
+        uint32_t start = unit;
+
+        while ((unit < file_units) && resume_unit_received(unit))
+        {
+            unit++;
+        }
+
+        if (unit > start)
+        {
+            ota_stream_hash_written(start * OTA_BLOCK_UNIT_SIZE,
+                                    (unit - start) * OTA_BLOCK_UNIT_SIZE);
+        }
+    }
+#endif
+
+    configPRINTF(("OTA resume: %u of %u blocks received before the reset are kept\r\n",
+                  (unsigned int)stat_restored, (unsigned int)file_units));
+}
+
+
+/*******************************************************************************
+ * Function Name: ota_resume_written
+ *******************************************************************************
+ * Summary:
+ *  Called for every block once it is written to the secondary slot, by one
+ *  task at a time. Records the units it covers, and appends a checkpoint to
+ *  the log every CY_OTA_RESUME_CHECKPOINT_SIZE bytes. The blocks written by
+ *  the HTTP connections do not start on a unit. The blocks of a file staged
+ *  in SRAM are not in flash and are not recorded.
+ *
+ * Parameters:
+ *  off - file offset of the block
+ *  len - block size
+ *
+ ******************************************************************************/
+void ota_resume_written(uint32_t off, uint32_t len)
+{
+    uint32_t end = off + len;
+
+    if (!resume_tracking || (0U == len))
+    {
+        return;
+    }
+
+#if defined(CY_OTA_RAM_STAGE)
+    if (ota_ram_stage_active())
+    {
+        return;
+    }
+#endif
+
+    for (uint32_t unit = off / OTA_BLOCK_UNIT_SIZE;
+         (unit < file_units) && ((unit * OTA_BLOCK_UNIT_SIZE) < end); unit++)
+    {
+        uint32_t unit_off = unit * OTA_BLOCK_UNIT_SIZE;
+        uint32_t size = ((file_size - unit_off) < OTA_BLOCK_UNIT_SIZE) ?
+                        (file_size - unit_off) : OTA_BLOCK_UNIT_SIZE;
+        uint32_t from = (off > unit_off) ? (off - unit_off) : 0U;
+        uint32_t to = ((end - unit_off) < size) ? (end - unit_off) : size;
+
+        if ((0U == from) && (size == to))
+        {
+            resume_unit_set(unit);
+        }
+        else if (!resume_unit_received(unit))
+        {
+            resume_unit_piece(unit, from, to, size);
+        }
+    }
+
+    if (pending_bytes >= CY_OTA_RESUME_CHECKPOINT_SIZE)
+    {
+        pending_bytes = 0U;
+        log_dirty = true;
+
+#if defined(CY_OTA_WRITE_COALESCE)
+        /* The units recorded must be in flash, not held for coalescing */
+        if (0 != ota_write_coalesce_flush())
+        {
+            resume_tracking = false;
+            return;
+        }
+#endif
+
+        if (0 != resume_append())
+        {
+            configPRINTF(("OTA resume: checkpoint write failed, no more checkpoints\r\n"));
+            resume_tracking = false;
+        }
+        else
+        {
+            stat_checkpoints++;
+        }
+    }
+}
+
+
+/*******************************************************************************
+ * Function Name: ota_resume_keeps
+ *******************************************************************************
+ * Summary:
+ *  Checks whether a range of the secondary slot holds units received before
+ *  the reset, which must not be erased.
+ *
+ * Parameters:
+ *  fa - flash area
+ *  off - offset within the flash area
+ *  len - length of the range
+ *
+ * Return:
+ *  bool - true if the range must be kept
+ *
+ ******************************************************************************/
+bool ota_resume_keeps(const struct flash_area *fa, uint32_t off, uint32_t len)
+{
+    uint32_t end;
+
+    if (!resume_keeping || (FLASH_AREA_IMAGE_SECONDARY(0) != fa->fa_id) || (off >= file_size))
+    {
+        return false;
+    }
+
+    end = (off + len + OTA_BLOCK_UNIT_SIZE - 1U) / OTA_BLOCK_UNIT_SIZE;
+    if (end > file_units)
+    {
+        end = file_units;
+    }
+
+    for (uint32_t unit = off / OTA_BLOCK_UNIT_SIZE; unit < end; unit++)
+    {
+        if (resume_unit_received(unit))
+        {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+
+/*******************************************************************************
+ * Function Name: ota_resume_end
+ *******************************************************************************
+ * Summary:
+ *  Ends the download: closed or aborted, it is not resumed after a reset.
+ *  Must be called once every block is written.
+ *
+ ******************************************************************************/
+void ota_resume_end(void)
+{
+    if (log_dirty)
+    {
+        resume_rec.hdr.bitmap_len = 0U;
+        resume_rec.hdr.received = 0U;
+
+        if (0 == resume_append())
+        {
+            log_dirty = false;
+        }
+    }
+
+    if ((stat_checkpoints > 0U) || (stat_restored > 0U))
+    {
+        configPRINTF(("OTA resume: %u checkpoints written, %u blocks kept from before the reset\r\n",
+                      (unsigned int)stat_checkpoints, (unsigned int)stat_restored));
+    }
+
+    resume_tracking = false;
+    resume_keeping = false;
+}
+
+#endif /* CY_OTA_RESUME */
+
+
+/* [] END OF FILE */
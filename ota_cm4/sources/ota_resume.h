@@ -0,0 +1,95 @@
+/******************************************************************************
+* File Name: ota_resume.h
+*
+* Description: This file contains the macros and function declarations of the
+* checkpoints of the received blocks, used to resume an interrupted OTA
+* download after a reset.
+*
+* Related Document: See README.md
+*
+*******************************************************************************
+* (c) 2020, Cypress Semiconductor Corporation. All rights reserved.
+*******************************************************************************
+* This software, including source code, documentation and related materials
+* ("Software"), is owned by Cypress Semiconductor Corporation or one of its
+* subsidiaries ("Cypress") and is protected by and subject to worldwide patent
+* protection (United States and foreign), United States copyright laws and
+* international treaty provisions. Therefore, you may use this Software only
+* as provided in the license agreement accompanying the software package from
+* which you obtained this Software ("EULA").
+*
+* If no EULA applies, Cypress hereby grants you a personal, non-exclusive,
+* non-transferable license to copy, modify, and compile the Software source
+* code solely for use in connection with Cypress's integrated circuit products.
+* Any reproduction, modification, translation, compilation, or representation
+* of this Software except as specified above is prohibited without the express
+* written permission of Cypress.
+*
+* Disclaimer: THIS SOFTWARE IS PROVIDED AS-IS, WITH NO WARRANTY OF ANY KIND,
+* EXPRESS OR IMPLIED, INCLUDING, BUT NOT LIMITED TO, NONINFRINGEMENT, IMPLIED
+* WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE. Cypress
+* reserves the right to make changes to the Software without notice. Cypress
+* does not assume any liability arising out of the application or use of the
+* Software or any product or circuit described in the Software. Cypress does
+* not authorize its products for use in any products where a malfunction or
+* failure of the Cypress product may reasonably be expected to result in
+* significant property damage, injury or death ("High Risk Product"). By
+* including Cypress's product in a High Risk Product, the manufacturer of such
+* system or application assumes all risk of such use and in doing so agrees to
+* indemnify Cypress against all liability.
+*******************************************************************************/
+#ifndef OTA_RESUME_H
+#define OTA_RESUME_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "flash_map_backend/flash_map_backend.h"
+#include "aws_iot_ota_agent.h"
+
+#if defined(CY_OTA_RESUME) && !defined(CY_OTA_BOUNDED_ERASE)
+#error "CY_OTA_RESUME needs CY_OTA_BOUNDED_ERASE to keep the received sectors"
+#endif
+
+
+/*******************************************************************************
+ * Macros
+ ******************************************************************************/
+/* Bytes received between two checkpoints. At most this much is downloaded
+ * again after a reset.
+ */
+#ifndef CY_OTA_RESUME_CHECKPOINT_SIZE
+#define CY_OTA_RESUME_CHECKPOINT_SIZE       (0x8000UL)
+#endif
+
+/* Size of one checkpoint log sector. The log uses two of them after the
+ * slot ring index.
+ */
+#ifndef CY_OTA_RESUME_SECTOR_SIZE
+#define CY_OTA_RESUME_SECTOR_SIZE           (0x40000UL)
+#endif
+
+/* Space taken by one checkpoint in the log: header and received-block bitmap
+ * of a file filling the secondary slot.
+ */
+#define CY_OTA_RESUME_RECORD_SIZE           (1024UL)
+
+/* Flash area ID used for the checkpoint log. It is not registered in
+ * boot_area_descs.
+ */
+#define CY_OTA_RESUME_AREA_ID               (0x12U)
+
+
+/*******************************************************************************
+ * Function prototypes
+ ******************************************************************************/
+void ota_resume_begin(const OTA_FileContext_t *C);
+void ota_resume_restore(OTA_FileContext_t *C);
+void ota_resume_written(uint32_t off, uint32_t len);
+bool ota_resume_keeps(const struct flash_area *fa, uint32_t off, uint32_t len);
+void ota_resume_end(void);
+
+
+#endif /* OTA_RESUME_H */
+
+
+/* [] END OF FILE */
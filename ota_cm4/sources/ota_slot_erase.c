@@ -0,0 +1,417 @@
+/******************************************************************************
+* File Name: ota_slot_erase.c
+*
+* Description: This file implements the size-bounded, blank-aware erase of the
+* secondary slot when an OTA job is accepted. The PAL erases the whole slot
+* before the first block is requested, whatever the size of the file. Only the
+* sectors covering the file and the logical sector holding the MCUboot
+* trailer are erased here, and each of them is read back first: a sector
+* that is already blank is not erased again. Reading a sector of the external
+* flash takes a few milliseconds, erasing it about half a second.
+*
+* Related Document: See README.md
+*
+*******************************************************************************
+* (c) 2020, Cypress Semiconductor Corporation. All rights reserved.
+*******************************************************************************
+* This software, including source code, documentation and related materials
+* ("Software"), is owned by Cypress Semiconductor Corporation or one of its
+* subsidiaries ("Cypress") and is protected by and subject to worldwide patent
+* protection (United States and foreign), United States copyright laws and
+* international treaty provisions. Therefore, you may use this Software only
+* as provided in the license agreement accompanying the software package from
+* which you obtained this Software ("EULA").
+*
+* If no EULA applies, Cypress hereby grants you a personal, non-exclusive,
+* non-transferable license to copy, modify, and compile the Software source
+* code solely for use in connection with Cypress's integrated circuit products.
+* Any reproduction, modification, translation, compilation, or representation
+* of this Software except as specified above is prohibited without the express
+* written permission of Cypress.
+*
+* Disclaimer: THIS SOFTWARE IS PROVIDED AS-IS, WITH NO WARRANTY OF ANY KIND,
+* EXPRESS OR IMPLIED, INCLUDING, BUT NOT LIMITED TO, NONINFRINGEMENT, IMPLIED
+* WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE. Cypress
+* reserves the right to make changes to the Software without notice. Cypress
+* does not assume any liability arising out of the application or use of the
+* Software or any product or circuit described in the Software. Cypress does
+* not authorize its products for use in any products where a malfunction or
+* failure of the Cypress product may reasonably be expected to result in
+* significant property damage, injury or death ("High Risk Product"). By
+* including Cypress's product in a High Risk Product, the manufacturer of such
+* system or application assumes all risk of such use and in doing so agrees to
+* indemnify Cypress against all liability.
+*******************************************************************************/
+#include "cy_pdl.h"
+#include "FreeRTOS.h"
+#include "task.h"
+
+#ifdef CY_BOOT_USE_EXTERNAL_FLASH
+#include "flash_qspi.h"
+#endif
+
+#include "sysflash/sysflash.h"
+#include "ota_slot_erase.h"
+#include "ota_resume.h"
+
+#if defined(CY_OTA_BOUNDED_ERASE)
+
+/*******************************************************************************
+ * Global variables
+ ******************************************************************************/
+/* Set while the PAL opens the file */
+static bool slot_armed;
+
+/* Size of the file being received, 0 when unknown */
+static uint32_t slot_file_size;
+
+/* Buffer of the blank check. It is used by one task at a time: the agent
+ * task while the file is opened, then the flash writer task.
+ */
+static uint8_t blank_buffer[OTA_SLOT_ERASE_READ_SIZE];
+
+/* Timing of the transfer */
+static TickType_t accept_tick;          /* Job accepted (file opened) */
+static TickType_t prepare_ticks;        /* Time spent in the PAL opening the file */
+static bool first_block_seen;
+
+/* Statistics of the transfer */
+static bool stat_external;
+static uint32_t stat_erased;
+static uint32_t stat_blank;             /* Already blank, not erased */
+static uint32_t stat_beyond;            /* Past the end of the file, not erased */
+static TickType_t stat_erase_ticks;
+
+
+/*******************************************************************************
+ * Function definitions
+ ******************************************************************************/
+
+/*******************************************************************************
+ * Function Name: slot_erase_unit
+ *******************************************************************************
+ * Summary:
+ *  Returns the erase granularity of a flash area: the uniform sector of the
+ *  external flash or one row of the internal flash.
+ *
+ * Parameters:
+ *  fa - flash area
+ *
+ * Return:
+ *  uint32_t - erase size in bytes
+ *
+ ******************************************************************************/
+static uint32_t slot_erase_unit(const struct flash_area *fa)
+{
+#ifdef CY_BOOT_USE_EXTERNAL_FLASH
+    if ((fa->fa_device_id & FLASH_DEVICE_EXTERNAL_FLAG) != 0U)
+    {
+        return qspi_get_erase_size();
+    }
+#else
+    (void)fa;
+#endif
+
+    return CY_FLASH_SIZEOF_ROW;
+}
+
+
+/*******************************************************************************
+ * Function Name: slot_erase_needed
+ *******************************************************************************
+ * Summary:
+ *  Checks whether a range of the secondary slot is written by the download or
+ *  by MCUboot: it overlaps the file or the trailer sector.
+ *
+ * Parameters:
+ *  fa - flash area
+ *  off - offset within the flash area
+ *  len - length of the range
+ *
+ * Return:
+ *  bool - true if the range must be erased
+ *
+ ******************************************************************************/
+static bool slot_erase_needed(const struct flash_area *fa, uint32_t off, uint32_t len)
+{
+    if ((FLASH_AREA_IMAGE_SECONDARY(0) != fa->fa_id) || (0U == slot_file_size) ||
+        (fa->fa_size <= CY_OTA_SLOT_ERASE_TRAILER_SIZE))
+    {
+        return true;
+    }
+
+    return (off < slot_file_size) ||
+           ((off + len) > (fa->fa_size - CY_OTA_SLOT_ERASE_TRAILER_SIZE));
+}
+
+
+/*******************************************************************************
+ * Function Name: slot_erase_blank
+ *******************************************************************************
+ * Summary:
+ *  Checks whether a range of a flash area is erased. Stops at the first byte
+ *  that is not.
+ *
+ * Parameters:
+ *  fa - flash area
+ *  off - offset within the flash area
+ *  len - length of the range
+ *
+ * Return:
+ *  bool - true if every byte holds the erase value, false if not or on a
+ *  read error
+ *
+ ******************************************************************************/
+static bool slot_erase_blank(const struct flash_area *fa, uint32_t off, uint32_t len)
+{
+    uint8_t erased_val = flash_area_erased_val(fa);
+
+    while (len > 0U)
+    {
+        uint32_t chunk = (len > OTA_SLOT_ERASE_READ_SIZE) ? OTA_SLOT_ERASE_READ_SIZE : len;
+
+        if (0 != flash_area_read(fa, off, blank_buffer, chunk))
+        {
+            return false;
+        }
+
+        for (uint32_t i = 0U; i < chunk; i++)
+        {
+            if (blank_buffer[i] != erased_val)
+            {
+                return false;
+            }
+        }
+
+        off += chunk;
+        len -= chunk;
+    }
+
+    return true;
+}
+
+
+/*******************************************************************************
+ * Function Name: slot_erase_saved_ms
+ *******************************************************************************
+ * Summary:
+ *  Estimates the erase time saved so far, from the measured erase time per
+ *  sector or the typical one when nothing was erased yet.
+ *
+ * Return:
+ *  uint32_t - time saved in milliseconds
+ *
+ ******************************************************************************/
+static uint32_t slot_erase_saved_ms(void)
+{
+    uint32_t unit_ms = stat_external ? CY_OTA_SLOT_ERASE_SECTOR_MS :
+                                       CY_OTA_SLOT_ERASE_ROW_MS;
+
+    if (stat_erased > 0U)
+    {
+        unit_ms = (uint32_t)(stat_erase_ticks * portTICK_PERIOD_MS) / stat_erased;
+    }
+
+    return (stat_blank + stat_beyond) * unit_ms;
+}
+
+
+/*******************************************************************************
+ * Function Name: ota_slot_erase_begin
+ *******************************************************************************
+ * Summary:
+ *  Starts the preparation of the secondary slot for a new file. Must be
+ *  called before the PAL opens the file: its erase of the slot is bounded
+ *  to the file until ota_slot_erase_end().
+ *
+ * Parameters:
+ *  file_size - size of the file announced by the job
+ *
+ ******************************************************************************/
+void ota_slot_erase_begin(uint32_t file_size)
+{
+    slot_file_size = file_size;
+    accept_tick = xTaskGetTickCount();
+    prepare_ticks = 0U;
+    first_block_seen = false;
+
+    stat_external = false;
+    stat_erased = 0U;
+    stat_blank = 0U;
+    stat_beyond = 0U;
+    stat_erase_ticks = 0U;
+
+    slot_armed = true;
+}
+
+
+/*******************************************************************************
+ * Function Name: ota_slot_erase_end
+ *******************************************************************************
+ * Summary:
+ *  Ends the preparation of the slot once the PAL has opened the file.
+ *
+ ******************************************************************************/
+void ota_slot_erase_end(void)
+{
+    slot_armed = false;
+    prepare_ticks = xTaskGetTickCount() - accept_tick;
+}
+
+
+/*******************************************************************************
+ * Function Name: ota_slot_erase_intercept
+ *******************************************************************************
+ * Summary:
+ *  Called for every erase. While the PAL opens the file, the erase of the
+ *  secondary slot is replaced by ota_slot_erase_range().
+ *
+ * Parameters:
+ *  fa - flash area
+ *  off - offset within the flash area
+ *  len - length of the range
+ *  handled - set to true if the erase was replaced
+ *
+ * Return:
+ *  int - 0 on success, non-zero otherwise
+ *
+ ******************************************************************************/
+int ota_slot_erase_intercept(const struct flash_area *fa, uint32_t off, uint32_t len,
+                             bool *handled)
+{
+    int rc;
+
+    *handled = false;
+
+    if (!slot_armed || (FLASH_AREA_IMAGE_SECONDARY(0) != fa->fa_id))
+    {
+        return 0;
+    }
+
+    /* The sectors are erased through flash_area_erase() again */
+    slot_armed = false;
+    rc = ota_slot_erase_range(fa, off, len);
+    slot_armed = true;
+
+    *handled = true;
+
+    return rc;
+}
+
+
+/*******************************************************************************
+ * Function Name: ota_slot_erase_range
+ *******************************************************************************
+ * Summary:
+ *  Erases a range of a flash area one erase unit at a time, skipping the
+ *  units past the end of the file and the units that are already blank.
+ *  With the resume, the units holding blocks received before a reset are
+ *  kept. A range not aligned to the erase unit is handled as a single unit.
+ *
+ * Parameters:
+ *  fa - flash area
+ *  off - offset within the flash area
+ *  len - length of the range
+ *
+ * Return:
+ *  int - 0 on success, non-zero otherwise
+ *
+ ******************************************************************************/
+int ota_slot_erase_range(const struct flash_area *fa, uint32_t off, uint32_t len)
+{
+    uint32_t unit = slot_erase_unit(fa);
+    int rc = 0;
+
+    if (((off % unit) != 0U) || ((len % unit) != 0U))
+    {
+        unit = len;
+    }
+
+    stat_external = ((fa->fa_device_id & FLASH_DEVICE_EXTERNAL_FLAG) != 0U);
+
+    for (uint32_t done = 0U; (0 == rc) && (done < len); done += unit)
+    {
+        TickType_t start;
+
+#if defined(CY_OTA_RESUME)
+        if (ota_resume_keeps(fa, off + done, unit))
+        {
+            continue;
+        }
+#endif
+
+        /* Left with stale data: overwrite-only MCUboot reads the image up to
+         * its size and the trailer only.
+         */
+        if (!slot_erase_needed(fa, off + done, unit))
+        {
+            stat_beyond++;
+            continue;
+        }
+
+        if (slot_erase_blank(fa, off + done, unit))
+        {
+            stat_blank++;
+            continue;
+        }
+
+        start = xTaskGetTickCount();
+        rc = flash_area_erase(fa, off + done, unit);
+        stat_erase_ticks += xTaskGetTickCount() - start;
+        stat_erased++;
+    }
+
+    return rc;
+}
+
+
+/*******************************************************************************
+ * Function Name: ota_slot_erase_first_block
+ *******************************************************************************
+ * Summary:
+ *  Called for every block write. Prints the time from the acceptance of the
+ *  job to the first block, and the erase time saved on that path.
+ *
+ ******************************************************************************/
+void ota_slot_erase_first_block(void)
+{
+    bool first;
+
+    taskENTER_CRITICAL();
+    first = !first_block_seen;
+    first_block_seen = true;
+    taskEXIT_CRITICAL();
+
+    if (first)
+    {
+        configPRINTF(("OTA: first block %u ms after the job was accepted, slot prepared in %u ms, "
+                      "~%u ms of erase saved\r\n",
+                      (unsigned int)((xTaskGetTickCount() - accept_tick) * portTICK_PERIOD_MS),
+                      (unsigned int)(prepare_ticks * portTICK_PERIOD_MS),
+                      (unsigned int)slot_erase_saved_ms()));
+    }
+}
+
+
+/*******************************************************************************
+ * Function Name: ota_slot_erase_report
+ *******************************************************************************
+ * Summary:
+ *  Prints the statistics of the slot erase of the transfer. Must be called
+ *  after the last erase of the file.
+ *
+ ******************************************************************************/
+void ota_slot_erase_report(void)
+{
+    const char *unit = stat_external ? "sectors" : "rows";
+
+    configPRINTF(("OTA slot erase: %u %s erased, %u already blank, %u past the image, "
+                  "~%u ms saved\r\n",
+                  (unsigned int)stat_erased, unit, (unsigned int)stat_blank,
+                  (unsigned int)stat_beyond, (unsigned int)slot_erase_saved_ms()));
+}
+
+#endif /* CY_OTA_BOUNDED_ERASE */
+
+
+/* [] END OF FILE */
@@ -0,0 +1,95 @@
+/******************************************************************************
+* File Name: ota_slot_erase.h
+*
+* Description: This file contains the macros and function declarations of the
+* size-bounded, blank-aware erase of the secondary slot.
+*
+* Related Document: See README.md
+*
+*******************************************************************************
+* (c) 2020, Cypress Semiconductor Corporation. All rights reserved.
+*******************************************************************************
+* This software, including source code, documentation and related materials
+* ("Software"), is owned by Cypress Semiconductor Corporation or one of its
+* subsidiaries ("Cypress") and is protected by and subject to worldwide patent
+* protection (United States and foreign), United States copyright laws and
+* international treaty provisions. Therefore, you may use this Software only
+* as provided in the license agreement accompanying the software package from
+* which you obtained this Software ("EULA").
+*
+* If no EULA applies, Cypress hereby grants you a personal, non-exclusive,
+* non-transferable license to copy, modify, and compile the Software source
+* code solely for use in connection with Cypress's integrated circuit products.
+* Any reproduction, modification, translation, compilation, or representation
+* of this Software except as specified above is prohibited without the express
+* written permission of Cypress.
+*
+* Disclaimer: THIS SOFTWARE IS PROVIDED AS-IS, WITH NO WARRANTY OF ANY KIND,
+* EXPRESS OR IMPLIED, INCLUDING, BUT NOT LIMITED TO, NONINFRINGEMENT, IMPLIED
+* WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE. Cypress
+* reserves the right to make changes to the Software without notice. Cypress
+* does not assume any liability arising out of the application or use of the
+* Software or any product or circuit described in the Software. Cypress does
+* not authorize its products for use in any products where a malfunction or
+* failure of the Cypress product may reasonably be expected to result in
+* significant property damage, injury or death ("High Risk Product"). By
+* including Cypress's product in a High Risk Product, the manufacturer of such
+* system or application assumes all risk of such use and in doing so agrees to
+* indemnify Cypress against all liability.
+*******************************************************************************/
+#ifndef OTA_SLOT_ERASE_H
+#define OTA_SLOT_ERASE_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "flash_map_backend/flash_map_backend.h"
+
+
+/*******************************************************************************
+ * Macros
+ ******************************************************************************/
+/* End of the slot that is always erased: the logical sector holding the
+ * MCUboot trailer.
+ */
+#ifndef CY_OTA_SLOT_ERASE_TRAILER_SIZE
+#if defined(CY_BOOT_SCRATCH_SIZE)
+#define CY_OTA_SLOT_ERASE_TRAILER_SIZE      (CY_BOOT_SCRATCH_SIZE)
+#else
+#define CY_OTA_SLOT_ERASE_TRAILER_SIZE      (0x1000UL)
+#endif
+#endif
+
+/* Typical times to erase one unit, from the datasheets: a 256-KB sector of
+ * the S25FL512S external flash, and a row of the internal flash. They only
+ * serve to estimate the time saved until a unit has been erased and timed.
+ */
+#ifndef CY_OTA_SLOT_ERASE_SECTOR_MS
+#define CY_OTA_SLOT_ERASE_SECTOR_MS         (520UL)
+#endif
+
+#ifndef CY_OTA_SLOT_ERASE_ROW_MS
+#define CY_OTA_SLOT_ERASE_ROW_MS            (16UL)
+#endif
+
+/* Size of each read of the blank check. Reads of this size bypass the
+ * read cache of the flash map backend.
+ */
+#define OTA_SLOT_ERASE_READ_SIZE            (1024U)
+
+
+/*******************************************************************************
+ * Function prototypes
+ ******************************************************************************/
+void ota_slot_erase_begin(uint32_t file_size);
+void ota_slot_erase_end(void);
+int ota_slot_erase_intercept(const struct flash_area *fa, uint32_t off, uint32_t len,
+                             bool *handled);
+int ota_slot_erase_range(const struct flash_area *fa, uint32_t off, uint32_t len);
+void ota_slot_erase_first_block(void);
+void ota_slot_erase_report(void);
+
+
+#endif /* OTA_SLOT_ERASE_H */
+
+
+/* [] END OF FILE */
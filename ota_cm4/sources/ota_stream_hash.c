@@ -0,0 +1,652 @@
+/******************************************************************************
+* File Name: ota_stream_hash.c
+*
+* Description: This file computes the SHA-256 hash of the OTA image while it
+* is written to the secondary slot, so that closing the file only has to
+* verify the signature.
+*
+* The PAL checks the signature of the file when it is closed: it reads the
+* whole secondary slot back and feeds it to CRYPTO_SignatureVerificationUpdate().
+* Here, every block is read back from the slot and hashed once it is written,
+* so that the hash covers what the flash holds, as the PAL's does. Blocks are
+* hashed in file order: the range of a block is recorded, and read back and
+* hashed once the part before it is complete. The reads stop at a multiple of
+* OTA_STREAM_HASH_READ_SIZE until the file is closed, so that they do not
+* program a unit held for coalescing before it is complete.
+*
+* A TAR archive is not written to the slot as it is: its members are. Its
+* blocks are hashed from their buffers, in file order.
+*
+* When the file is closed with a complete hash, the signature verification
+* functions of the PAL are interposed with the -Wl,--wrap linker option:
+* the reads of the slot are skipped, the data is not hashed again, and the
+* signature is verified against the hash computed here, with the same signer
+* certificate. In any other case, for example a block written again after it
+* was hashed, the PAL hashes the image as before.
+*
+* Related Document: See README.md
+*
+*******************************************************************************
+* (c) 2020, Cypress Semiconductor Corporation. All rights reserved.
+*******************************************************************************
+* This software, including source code, documentation and related materials
+* ("Software"), is owned by Cypress Semiconductor Corporation or one of its
+* subsidiaries ("Cypress") and is protected by and subject to worldwide patent
+* protection (United States and foreign), United States copyright laws and
+* international treaty provisions. Therefore, you may use this Software only
+* as provided in the license agreement accompanying the software package from
+* which you obtained this Software ("EULA").
+*
+* If no EULA applies, Cypress hereby grants you a personal, non-exclusive,
+* non-transferable license to copy, modify, and compile the Software source
+* code solely for use in connection with Cypress's integrated circuit products.
+* Any reproduction, modification, translation, compilation, or representation
+* of this Software except as specified above is prohibited without the express
+* written permission of Cypress.
+*
+* Disclaimer: THIS SOFTWARE IS PROVIDED AS-IS, WITH NO WARRANTY OF ANY KIND,
+* EXPRESS OR IMPLIED, INCLUDING, BUT NOT LIMITED TO, NONINFRINGEMENT, IMPLIED
+* WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE. Cypress
+* reserves the right to make changes to the Software without notice. Cypress
+* does not assume any liability arising out of the application or use of the
+* Software or any product or circuit described in the Software. Cypress does
+* not authorize its products for use in any products where a malfunction or
+* failure of the Cypress product may reasonably be expected to result in
+* significant property damage, injury or death ("High Risk Product"). By
+* including Cypress's product in a High Risk Product, the manufacturer of such
+* system or application assumes all risk of such use and in doing so agrees to
+* indemnify Cypress against all liability.
+*******************************************************************************/
+#include <string.h>
+#include "FreeRTOS.h"
+#include "task.h"
+#include "iot_crypto.h"
+#include "mbedtls/sha256.h"
+#include "mbedtls/x509_crt.h"
+#include "mbedtls/pk.h"
+#include "sysflash/sysflash.h"
+#include "ota_stream_hash.h"
+
+#if defined(CY_OTA_STREAM_HASH)
+
+/*******************************************************************************
+ * Macros
+ ******************************************************************************/
+#define STREAM_HASH_DIGEST_SIZE         (32U)
+
+/* Blocks hashed from their buffers instead of the slot */
+#if defined(CY_OTA_TAR_STREAM)
+#define STREAM_HASH_FROM_BUFFER         (true)
+#else
+#define STREAM_HASH_FROM_BUFFER         (false)
+#endif
+
+
+/*******************************************************************************
+ * Data structure and enumeration
+ ******************************************************************************/
+typedef struct
+{
+    uint32_t start;
+    uint32_t end;
+} hash_extent_t;
+
+
+/*******************************************************************************
+ * Function prototypes
+ ******************************************************************************/
+BaseType_t __real_CRYPTO_SignatureVerificationStart(void **ppvContext,
+                                                    BaseType_t xAsymmetricAlgorithm,
+                                                    BaseType_t xHashAlgorithm);
+void __real_CRYPTO_SignatureVerificationUpdate(void *pvContext, const uint8_t *pucData,
+                                               size_t xDataLength);
+BaseType_t __real_CRYPTO_SignatureVerificationFinal(void *pvContext, char *pcSignerCertificate,
+                                                    size_t xSignerCertificateLength,
+                                                    uint8_t *pucSignature,
+                                                    size_t xSignatureLength);
+
+BaseType_t __wrap_CRYPTO_SignatureVerificationStart(void **ppvContext,
+                                                    BaseType_t xAsymmetricAlgorithm,
+                                                    BaseType_t xHashAlgorithm);
+void __wrap_CRYPTO_SignatureVerificationUpdate(void *pvContext, const uint8_t *pucData,
+                                               size_t xDataLength);
+BaseType_t __wrap_CRYPTO_SignatureVerificationFinal(void *pvContext, char *pcSignerCertificate,
+                                                    size_t xSignerCertificateLength,
+                                                    uint8_t *pucSignature,
+                                                    size_t xSignatureLength);
+
+
+/*******************************************************************************
+ * Global variables
+ ******************************************************************************/
+/* Hash of the file up to hash_cursor. Only used by the task that writes the
+ * blocks, then by the agent task once every block is written.
+ */
+static mbedtls_sha256_context hash_ctx;
+static bool hash_valid;
+static uint32_t hash_cursor;
+static const char *hash_lost;           /* Why the hash was dropped */
+
+/* Ranges written from hash_cursor on, in file order */
+static hash_extent_t hash_extents[CY_OTA_STREAM_HASH_EXTENTS];
+static uint32_t hash_extent_count;
+
+static uint8_t hash_buffer[OTA_STREAM_HASH_READ_SIZE];
+static uint8_t hash_digest[STREAM_HASH_DIGEST_SIZE];
+
+/* Set while the PAL closes a file whose hash is complete */
+static bool check_armed;
+static void *check_context;             /* Verification context of the PAL */
+static bool check_skipped;              /* PAL hash replaced */
+static TickType_t check_start;
+
+/* Statistics of the transfer */
+static uint32_t stat_hashed;            /* Hashed from the block buffers */
+static uint32_t stat_read_back;         /* Hashed from flash */
+static uint32_t stat_max_extents;
+
+
+/*******************************************************************************
+ * Function definitions
+ ******************************************************************************/
+
+/*******************************************************************************
+ * Function Name: stream_hash_drop
+ *******************************************************************************
+ * Summary:
+ *  Drops the hash of the file. The PAL hashes the image when it is closed.
+ *
+ * Parameters:
+ *  reason - printed with the statistics
+ *
+ ******************************************************************************/
+static void stream_hash_drop(const char *reason)
+{
+    if (hash_valid)
+    {
+        hash_valid = false;
+        hash_lost = reason;
+        mbedtls_sha256_free(&hash_ctx);
+    }
+}
+
+
+/*******************************************************************************
+ * Function Name: stream_hash_add_extent
+ *******************************************************************************
+ * Summary:
+ *  Records a range written past the hashed part of the file, merging it with
+ *  the ranges it overlaps or touches.
+ *
+ * Parameters:
+ *  start - file offset of the first byte
+ *  end - file offset after the last byte
+ *
+ * Return:
+ *  bool - false when too many separate ranges are recorded
+ *
+ ******************************************************************************/
+static bool stream_hash_add_extent(uint32_t start, uint32_t end)
+{
+    uint32_t i = 0U;
+
+    while ((i < hash_extent_count) && (hash_extents[i].end < start))
+    {
+        i++;
+    }
+
+    if ((i < hash_extent_count) && (hash_extents[i].start <= end))
+    {
+        if (start < hash_extents[i].start)
+        {
+            hash_extents[i].start = start;
+        }
+
+        if (end > hash_extents[i].end)
+        {
+            hash_extents[i].end = end;
+        }
+
+        while (((i + 1U) < hash_extent_count) &&
+               (hash_extents[i + 1U].start <= hash_extents[i].end))
+        {
+            if (hash_extents[i + 1U].end > hash_extents[i].end)
+            {
+                hash_extents[i].end = hash_extents[i + 1U].end;
+            }
+
+            hash_extent_count--;
+            memmove(&hash_extents[i + 1U], &hash_extents[i + 2U],
+                    (hash_extent_count - i - 1U) * sizeof(hash_extent_t));
+        }
+
+        return true;
+    }
+
+    if (CY_OTA_STREAM_HASH_EXTENTS == hash_extent_count)
+    {
+        return false;
+    }
+
+    memmove(&hash_extents[i + 1U], &hash_extents[i],
+            (hash_extent_count - i) * sizeof(hash_extent_t));
+    hash_extents[i].start = start;
+    hash_extents[i].end = end;
+    hash_extent_count++;
+
+    if (hash_extent_count > stat_max_extents)
+    {
+        stat_max_extents = hash_extent_count;
+    }
+
+    return true;
+}
+
+
+/*******************************************************************************
+ * Function Name: stream_hash_read_back
+ *******************************************************************************
+ * Summary:
+ *  Hashes the ranges written that continue the hashed part of the file,
+ *  reading them back from the secondary slot. Unless the file is complete,
+ *  the part of the last range after a multiple of OTA_STREAM_HASH_READ_SIZE
+ *  is left for later.
+ *
+ * Parameters:
+ *  complete - true once every block of the file is written
+ *
+ ******************************************************************************/
+static void stream_hash_read_back(bool complete)
+{
+    const struct flash_area *fa;
+
+    if (!hash_valid || (0U == hash_extent_count) || (hash_extents[0].start > hash_cursor))
+    {
+        return;
+    }
+
+    if (0 != flash_area_open(FLASH_AREA_IMAGE_SECONDARY(0), &fa))
+    {
+        stream_hash_drop("slot not readable");
+        return;
+    }
+
+    while (hash_valid && (hash_extent_count > 0U) && (hash_extents[0].start <= hash_cursor))
+    {
+        uint32_t end = hash_extents[0].end;
+
+        if (!complete)
+        {
+            end -= end % OTA_STREAM_HASH_READ_SIZE;
+        }
+
+        while (hash_cursor < end)
+        {
+            uint32_t chunk = end - hash_cursor;
+
+            if (chunk > OTA_STREAM_HASH_READ_SIZE)
+            {
+                chunk = OTA_STREAM_HASH_READ_SIZE;
+            }
+
+            if ((0 != flash_area_read(fa, hash_cursor, hash_buffer, chunk)) ||
+                (0 != mbedtls_sha256_update_ret(&hash_ctx, hash_buffer, chunk)))
+            {
+                stream_hash_drop("read back failed");
+                break;
+            }
+
+            hash_cursor += chunk;
+            stat_read_back += chunk;
+        }
+
+        if (hash_cursor < hash_extents[0].end)
+        {
+            break;
+        }
+
+        hash_extent_count--;
+        memmove(&hash_extents[0], &hash_extents[1], hash_extent_count * sizeof(hash_extent_t));
+    }
+
+    flash_area_close(fa);
+}
+
+
+/*******************************************************************************
+ * Function Name: stream_hash_verify
+ *******************************************************************************
+ * Summary:
+ *  Verifies a signature of the hash of the file, as
+ *  CRYPTO_SignatureVerificationFinal() does for the hash it computed.
+ *
+ * Parameters:
+ *  cert - signer certificate (PEM)
+ *  cert_len - size of the certificate
+ *  sig - signature (DER)
+ *  sig_len - size of the signature
+ *
+ * Return:
+ *  BaseType_t - pdTRUE if the signature is valid
+ *
+ ******************************************************************************/
+static BaseType_t stream_hash_verify(const char *cert, size_t cert_len,
+                                     const uint8_t *sig, size_t sig_len)
+{
+    mbedtls_x509_crt crt;
+    BaseType_t result = pdFALSE;
+
+    mbedtls_x509_crt_init(&crt);
+
+    if ((0 == mbedtls_x509_crt_parse(&crt, (const unsigned char *)cert, cert_len)) &&
+        (0 == mbedtls_pk_verify(&crt.pk, MBEDTLS_MD_SHA256, hash_digest,
+                                sizeof(hash_digest), sig, sig_len)))
+    {
+        result = pdTRUE;
+    }
+
+    mbedtls_x509_crt_free(&crt);
+
+    return result;
+}
+
+
+/*******************************************************************************
+ * Function Name: ota_stream_hash_begin
+ *******************************************************************************
+ * Summary:
+ *  Starts the hash of a new file. Must be called when the PAL opens it.
+ *
+ ******************************************************************************/
+void ota_stream_hash_begin(void)
+{
+    stream_hash_drop(NULL);
+
+    mbedtls_sha256_init(&hash_ctx);
+    hash_valid = (0 == mbedtls_sha256_starts_ret(&hash_ctx, 0));
+    hash_lost = hash_valid ? NULL : "hash not started";
+    hash_cursor = 0U;
+    hash_extent_count = 0U;
+
+    stat_hashed = 0U;
+    stat_read_back = 0U;
+    stat_max_extents = 0U;
+}
+
+
+/*******************************************************************************
+ * Function Name: ota_stream_hash_update
+ *******************************************************************************
+ * Summary:
+ *  Called for every block once it is written to the secondary slot, by one
+ *  task at a time. The block is hashed from the slot, or from its buffer for
+ *  a TAR archive.
+ *
+ * Parameters:
+ *  off - file offset of the block
+ *  data - block data
+ *  len - block size
+ *
+ ******************************************************************************/
+void ota_stream_hash_update(uint32_t off, const uint8_t *data, uint32_t len)
+{
+    if (!hash_valid || (0U == len))
+    {
+        return;
+    }
+
+    if (off < hash_cursor)
+    {
+        stream_hash_drop("block written again");
+    }
+    else if (!STREAM_HASH_FROM_BUFFER || (off > hash_cursor))
+    {
+        ota_stream_hash_written(off, len);
+    }
+    else if (0 != mbedtls_sha256_update_ret(&hash_ctx, data, len))
+    {
+        stream_hash_drop("hash failed");
+    }
+    else
+    {
+        hash_cursor += len;
+        stat_hashed += len;
+        stream_hash_read_back(false);
+    }
+}
+
+
+/*******************************************************************************
+ * Function Name: ota_stream_hash_written
+ *******************************************************************************
+ * Summary:
+ *  Adds a range already held by the secondary slot to the hash of the file,
+ *  as for a block written ahead: it is hashed from flash once the part before
+ *  it is complete.
+ *
+ * Parameters:
+ *  off - file offset of the range
+ *  len - size of the range
+ *
+ ******************************************************************************/
+void ota_stream_hash_written(uint32_t off, uint32_t len)
+{
+    if (!hash_valid || (0U == len))
+    {
+        return;
+    }
+
+    if (off < hash_cursor)
+    {
+        stream_hash_drop("block written again");
+    }
+    else if (!stream_hash_add_extent(off, off + len))
+    {
+        stream_hash_drop("too many blocks out of order");
+    }
+    else
+    {
+        stream_hash_read_back(false);
+    }
+}
+
+
+/*******************************************************************************
+ * Function Name: ota_stream_hash_arm
+ *******************************************************************************
+ * Summary:
+ *  Finishes the hash of the file when every block is hashed, and lets it
+ *  replace the hash of the signature check of the PAL. Must be called just
+ *  before the PAL closes the file, once every block is written.
+ *
+ * Parameters:
+ *  file_size - size of the file
+ *
+ ******************************************************************************/
+void ota_stream_hash_arm(uint32_t file_size)
+{
+    check_start = xTaskGetTickCount();
+    check_armed = false;
+    check_skipped = false;
+    check_context = NULL;
+
+    stream_hash_read_back(true);
+
+    if (hash_valid && ((hash_cursor != file_size) || (0U != hash_extent_count)))
+    {
+        stream_hash_drop("file not complete");
+    }
+
+    if (hash_valid)
+    {
+        if (0 == mbedtls_sha256_finish_ret(&hash_ctx, hash_digest))
+        {
+            check_armed = true;
+        }
+
+        stream_hash_drop(check_armed ? NULL : "hash failed");
+    }
+}
+
+
+/*******************************************************************************
+ * Function Name: ota_stream_hash_disarm
+ *******************************************************************************
+ * Summary:
+ *  Ends the signature check of the file and prints the statistics of the
+ *  hash.
+ *
+ ******************************************************************************/
+void ota_stream_hash_disarm(void)
+{
+    uint32_t check_ms = (uint32_t)((xTaskGetTickCount() - check_start) * portTICK_PERIOD_MS);
+
+    check_armed = false;
+    check_context = NULL;
+
+    if (check_skipped)
+    {
+        configPRINTF(("OTA stream hash: %u bytes hashed while receiving, %u read back, "
+                      "up to %u ranges ahead, file closed in %u ms\r\n",
+                      (unsigned int)stat_hashed, (unsigned int)stat_read_back,
+                      (unsigned int)stat_max_extents, (unsigned int)check_ms));
+    }
+    else
+    {
+        configPRINTF(("OTA stream hash: not used (%s), file closed in %u ms\r\n",
+                      (NULL != hash_lost) ? hash_lost : "signature check not done",
+                      (unsigned int)check_ms));
+    }
+
+    check_skipped = false;
+}
+
+
+/*******************************************************************************
+ * Function Name: ota_stream_hash_skips_read
+ *******************************************************************************
+ * Summary:
+ *  Called for every read. While the PAL hashes the file for a signature check
+ *  replaced by the hash computed here, the reads of the secondary slot are
+ *  not done: their data is not used.
+ *
+ * Parameters:
+ *  fa - flash area
+ *
+ * Return:
+ *  bool - true if the read is skipped
+ *
+ ******************************************************************************/
+bool ota_stream_hash_skips_read(const struct flash_area *fa)
+{
+    return (NULL != check_context) && (FLASH_AREA_IMAGE_SECONDARY(0) == fa->fa_id);
+}
+
+
+/*******************************************************************************
+ * Function Name: __wrap_CRYPTO_SignatureVerificationStart
+ *******************************************************************************
+ * Summary:
+ *  Starts a signature verification. While a file with a complete hash is
+ *  closed, the context is recorded so that its hash is replaced.
+ *
+ * Parameters:
+ *  ppvContext - receives the verification context
+ *  xAsymmetricAlgorithm - signature algorithm
+ *  xHashAlgorithm - hash algorithm
+ *
+ * Return:
+ *  BaseType_t - pdTRUE on success
+ *
+ ******************************************************************************/
+BaseType_t __wrap_CRYPTO_SignatureVerificationStart(void **ppvContext,
+                                                    BaseType_t xAsymmetricAlgorithm,
+                                                    BaseType_t xHashAlgorithm)
+{
+    BaseType_t result = __real_CRYPTO_SignatureVerificationStart(ppvContext,
+                                                                 xAsymmetricAlgorithm,
+                                                                 xHashAlgorithm);
+
+    if (check_armed && (pdTRUE == result) && (cryptoHASH_ALGORITHM_SHA256 == xHashAlgorithm))
+    {
+        check_context = *ppvContext;
+        check_armed = false;
+    }
+
+    return result;
+}
+
+
+/*******************************************************************************
+ * Function Name: __wrap_CRYPTO_SignatureVerificationUpdate
+ *******************************************************************************
+ * Summary:
+ *  Adds data to the hash of a signature verification, unless the hash of
+ *  the file is already known.
+ *
+ * Parameters:
+ *  pvContext - verification context
+ *  pucData - data
+ *  xDataLength - size of the data
+ *
+ ******************************************************************************/
+void __wrap_CRYPTO_SignatureVerificationUpdate(void *pvContext, const uint8_t *pucData,
+                                               size_t xDataLength)
+{
+    if ((NULL == check_context) || (pvContext != check_context))
+    {
+        __real_CRYPTO_SignatureVerificationUpdate(pvContext, pucData, xDataLength);
+    }
+}
+
+
+/*******************************************************************************
+ * Function Name: __wrap_CRYPTO_SignatureVerificationFinal
+ *******************************************************************************
+ * Summary:
+ *  Verifies the signature and frees the context. When the hash of the file is
+ *  already known, the signature is verified against it, and the context is
+ *  freed by the original function called without a certificate.
+ *
+ * Parameters:
+ *  pvContext - verification context
+ *  pcSignerCertificate - signer certificate
+ *  xSignerCertificateLength - size of the certificate
+ *  pucSignature - signature
+ *  xSignatureLength - size of the signature
+ *
+ * Return:
+ *  BaseType_t - pdTRUE if the signature is valid
+ *
+ ******************************************************************************/
+BaseType_t __wrap_CRYPTO_SignatureVerificationFinal(void *pvContext, char *pcSignerCertificate,
+                                                    size_t xSignerCertificateLength,
+                                                    uint8_t *pucSignature,
+                                                    size_t xSignatureLength)
+{
+    if ((NULL == check_context) || (pvContext != check_context))
+    {
+        return __real_CRYPTO_SignatureVerificationFinal(pvContext, pcSignerCertificate,
+                                                        xSignerCertificateLength,
+                                                        pucSignature, xSignatureLength);
+    }
+
+    check_context = NULL;
+    check_skipped = true;
+
+    (void)__real_CRYPTO_SignatureVerificationFinal(pvContext, NULL, 0U, NULL, 0U);
+
+    if ((NULL == pcSignerCertificate) || (NULL == pucSignature) ||
+        (0U == xSignerCertificateLength) || (0U == xSignatureLength))
+    {
+        return pdFALSE;
+    }
+
+    return stream_hash_verify(pcSignerCertificate, xSignerCertificateLength,
+                              pucSignature, xSignatureLength);
+}
+
+#endif /* CY_OTA_STREAM_HASH */
+
+
+/* [] END OF FILE */
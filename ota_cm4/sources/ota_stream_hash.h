@@ -0,0 +1,81 @@
+/******************************************************************************
+* File Name: ota_stream_hash.h
+*
+* Description: This file contains the macros and function declarations of the
+* hash of the OTA image computed while it is received.
+*
+* Related Document: See README.md
+*
+*******************************************************************************
+* (c) 2020, Cypress Semiconductor Corporation. All rights reserved.
+*******************************************************************************
+* This software, including source code, documentation and related materials
+* ("Software"), is owned by Cypress Semiconductor Corporation or one of its
+* subsidiaries ("Cypress") and is protected by and subject to worldwide patent
+* protection (United States and foreign), United States copyright laws and
+* international treaty provisions. Therefore, you may use this Software only
+* as provided in the license agreement accompanying the software package from
+* which you obtained this Software ("EULA").
+*
+* If no EULA applies, Cypress hereby grants you a personal, non-exclusive,
+* non-transferable license to copy, modify, and compile the Software source
+* code solely for use in connection with Cypress's integrated circuit products.
+* Any reproduction, modification, translation, compilation, or representation
+* of this Software except as specified above is prohibited without the express
+* written permission of Cypress.
+*
+* Disclaimer: THIS SOFTWARE IS PROVIDED AS-IS, WITH NO WARRANTY OF ANY KIND,
+* EXPRESS OR IMPLIED, INCLUDING, BUT NOT LIMITED TO, NONINFRINGEMENT, IMPLIED
+* WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE. Cypress
+* reserves the right to make changes to the Software without notice. Cypress
+* does not assume any liability arising out of the application or use of the
+* Software or any product or circuit described in the Software. Cypress does
+* not authorize its products for use in any products where a malfunction or
+* failure of the Cypress product may reasonably be expected to result in
+* significant property damage, injury or death ("High Risk Product"). By
+* including Cypress's product in a High Risk Product, the manufacturer of such
+* system or application assumes all risk of such use and in doing so agrees to
+* indemnify Cypress against all liability.
+*******************************************************************************/
+#ifndef OTA_STREAM_HASH_H
+#define OTA_STREAM_HASH_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "flash_map_backend/flash_map_backend.h"
+
+
+/*******************************************************************************
+ * Macros
+ ******************************************************************************/
+/* Number of separate ranges written ahead of the hashed part of the file.
+ * Adjacent ranges are merged; when more are needed, the hash is dropped and
+ * the image is hashed again when the file is closed.
+ */
+#ifndef CY_OTA_STREAM_HASH_EXTENTS
+#define CY_OTA_STREAM_HASH_EXTENTS          (16U)
+#endif
+
+/* Size of each read when a range written is hashed from flash. Until the file
+ * is complete, the reads end on a multiple of it, which is a multiple of the
+ * program units of the slot (rows of 512 bytes, pages of the external
+ * flash). Reads of this size bypass the read cache of the flash map backend.
+ */
+#define OTA_STREAM_HASH_READ_SIZE           (1024U)
+
+
+/*******************************************************************************
+ * Function prototypes
+ ******************************************************************************/
+void ota_stream_hash_begin(void);
+void ota_stream_hash_update(uint32_t off, const uint8_t *data, uint32_t len);
+void ota_stream_hash_written(uint32_t off, uint32_t len);
+void ota_stream_hash_arm(uint32_t file_size);
+void ota_stream_hash_disarm(void);
+bool ota_stream_hash_skips_read(const struct flash_area *fa);
+
+
+#endif /* OTA_STREAM_HASH_H */
+
+
+/* [] END OF FILE */
@@ -0,0 +1,816 @@
+/******************************************************************************
+* File Name: ota_tar_stream.c
+*
+* Description: This file extracts the members of a TAR archive received by OTA
+* while its blocks arrive, and writes each member straight to its partition:
+* - CY_OTA_TAR_APP_MEMBER to the secondary slot, through the PAL,
+* - CY_OTA_TAR_APP2_MEMBER to the secondary slot of the second image, when
+*   MCUBOOT_IMAGE_NUMBER is 2,
+* - CY_OTA_TAR_DATA_MEMBER to the data partition in the external flash, when
+*   CY_OTA_TAR_DATA_SIZE is not 0.
+* Other members, such as components.json, are skipped. The archive itself is
+* not stored: only the 512-byte header of the current member is buffered, and
+* the flash of the partitions is erased sector by sector as the writes reach
+* it.
+*
+* A file is taken as an archive when its first header has the "ustar" magic;
+* any other file is written to the secondary slot as it is.
+*
+* The archive is parsed in order. A block received ahead of the next expected
+* byte is not written: it is marked missing again in the block bitmap of the
+* agent on the next write, and is requested again once the gap before it is
+* filled. The archive is hashed by ota_stream_hash.c as it is parsed, and the
+* signature of the job is checked against that hash when the file is closed.
+*
+* Related Document: See README.md
+*
+*******************************************************************************
+* (c) 2020, Cypress Semiconductor Corporation. All rights reserved.
+*******************************************************************************
+* This software, including source code, documentation and related materials
+* ("Software"), is owned by Cypress Semiconductor Corporation or one of its
+* subsidiaries ("Cypress") and is protected by and subject to worldwide patent
+* protection (United States and foreign), United States copyright laws and
+* international treaty provisions. Therefore, you may use this Software only
+* as provided in the license agreement accompanying the software package from
+* which you obtained this Software ("EULA").
+*
+* If no EULA applies, Cypress hereby grants you a personal, non-exclusive,
+* non-transferable license to copy, modify, and compile the Software source
+* code solely for use in connection with Cypress's integrated circuit products.
+* Any reproduction, modification, translation, compilation, or representation
+* of this Software except as specified above is prohibited without the express
+* written permission of Cypress.
+*
+* Disclaimer: THIS SOFTWARE IS PROVIDED AS-IS, WITH NO WARRANTY OF ANY KIND,
+* EXPRESS OR IMPLIED, INCLUDING, BUT NOT LIMITED TO, NONINFRINGEMENT, IMPLIED
+* WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE. Cypress
+* reserves the right to make changes to the Software without notice. Cypress
+* does not assume any liability arising out of the application or use of the
+* Software or any product or circuit described in the Software. Cypress does
+* not authorize its products for use in any products where a malfunction or
+* failure of the Cypress product may reasonably be expected to result in
+* significant property damage, injury or death ("High Risk Product"). By
+* including Cypress's product in a High Risk Product, the manufacturer of such
+* system or application assumes all risk of such use and in doing so agrees to
+* indemnify Cypress against all liability.
+*******************************************************************************/
+#include <string.h>
+#include "cy_pdl.h"
+#include "FreeRTOS.h"
+
+#ifdef CY_BOOT_USE_EXTERNAL_FLASH
+#include "flash_qspi.h"
+#endif
+
+#include "sysflash/sysflash.h"
+#include "flash_map_backend/flash_map_backend.h"
+#include "aws_iot_ota_pal.h"
+#include "ota_block_size.h"
+#include "ota_tar_stream.h"
+
+#if defined(CY_OTA_TAR_STREAM)
+
+#if (MCUBOOT_IMAGE_NUMBER == 2)
+#include "bootutil/bootutil.h"
+#endif
+
+/*******************************************************************************
+ * Macros
+ ******************************************************************************/
+#define BITS_PER_BYTE                   (8U)
+
+/* ustar header fields */
+#define TAR_BLOCK_SIZE                  (512U)
+#define TAR_NAME_OFF                    (0U)
+#define TAR_NAME_LEN                    (100U)
+#define TAR_SIZE_OFF                    (124U)
+#define TAR_SIZE_LEN                    (12U)
+#define TAR_CHKSUM_OFF                  (148U)
+#define TAR_CHKSUM_LEN                  (8U)
+#define TAR_TYPEFLAG_OFF                (156U)
+#define TAR_MAGIC_OFF                   (257U)
+#define TAR_MAGIC                       "ustar"
+#define TAR_MAGIC_LEN                   (5U)
+#define TAR_PREFIX_OFF                  (345U)
+
+/* Regular file, old and POSIX forms */
+#define TAR_TYPE_FILE                   '0'
+#define TAR_TYPE_FILE_OLD               '\0'
+
+/* Bytes of the first header that tell an archive from an image */
+#define TAR_DETECT_SIZE                 (TAR_MAGIC_OFF + TAR_MAGIC_LEN)
+
+#define TAR_WRITE_ERROR                 (-1)
+
+
+/*******************************************************************************
+ * Data structure and enumeration
+ ******************************************************************************/
+typedef enum
+{
+    TAR_DETECT,                 /* First header, archive or image not known */
+    TAR_HEADER,                 /* Header of a member */
+    TAR_DATA,                   /* Data of a member */
+    TAR_PADDING,                /* Padding of a member to a whole block */
+    TAR_END,                    /* End-of-archive blocks */
+    TAR_PASS,                   /* Not an archive: written as it is */
+    TAR_FAILED
+} tar_state_t;
+
+typedef enum
+{
+    TAR_ROUTE_PAL,              /* Secondary slot, through the PAL */
+    TAR_ROUTE_AREA              /* Flash area, erased as it is written */
+} tar_route_t;
+
+typedef struct
+{
+    const char *name;
+    tar_route_t route;
+    uint8_t area_id;            /* TAR_ROUTE_AREA only */
+} tar_member_t;
+
+
+/*******************************************************************************
+ * Function prototypes
+ ******************************************************************************/
+int16_t __real_prvPAL_WriteBlock(OTA_FileContext_t * const C, uint32_t ulOffset,
+                                 uint8_t * const pacData, uint32_t ulBlockSize);
+
+
+/*******************************************************************************
+ * Global variables
+ ******************************************************************************/
+static const tar_member_t tar_members[] =
+{
+    { CY_OTA_TAR_APP_MEMBER, TAR_ROUTE_PAL, 0U },
+#if (MCUBOOT_IMAGE_NUMBER == 2)
+    { CY_OTA_TAR_APP2_MEMBER, TAR_ROUTE_AREA, FLASH_AREA_IMAGE_SECONDARY(1) },
+#endif
+#if defined(CY_BOOT_USE_EXTERNAL_FLASH) && (CY_OTA_TAR_DATA_SIZE > 0UL)
+    { CY_OTA_TAR_DATA_MEMBER, TAR_ROUTE_AREA, CY_OTA_TAR_DATA_AREA_ID },
+#endif
+};
+
+#if defined(CY_BOOT_USE_EXTERNAL_FLASH) && (CY_OTA_TAR_DATA_SIZE > 0UL)
+static struct flash_area data_area =
+{
+    .fa_id = CY_OTA_TAR_DATA_AREA_ID,
+    .fa_device_id = FLASH_DEVICE_EXTERNAL_FLASH(CY_BOOT_EXTERNAL_DEVICE_INDEX),
+    .fa_off = CY_SMIF_BASE_MEM_OFFSET + CY_OTA_TAR_DATA_OFFSET,
+    .fa_size = CY_OTA_TAR_DATA_SIZE
+};
+#endif
+
+/* Used by the agent task only */
+static OTA_FileContext_t *file_ctx;
+static uint32_t file_size;
+static tar_state_t tar_state;
+static uint32_t tar_pos;                /* Next archive byte to parse */
+static bool tar_deferred;               /* Blocks ahead of tar_pos dropped */
+
+static uint8_t tar_header[TAR_BLOCK_SIZE];
+static uint32_t header_len;
+
+/* Current member */
+static const tar_member_t *member;      /* NULL when skipped */
+static const struct flash_area *member_fa;
+static uint32_t member_off;             /* Bytes of the member written */
+static uint32_t member_left;
+static uint32_t padding_left;
+static uint32_t erased_end;             /* member_fa erased up to here */
+
+/* Statistics of the transfer */
+static uint32_t stat_members;
+static uint32_t stat_deferred;
+static uint32_t stat_requeued;
+static bool app2_written;
+
+
+/*******************************************************************************
+ * Function definitions
+ ******************************************************************************/
+
+/*******************************************************************************
+ * Function Name: tar_member_close
+ *******************************************************************************
+ * Summary:
+ *  Closes the flash area of the current member, if one is open.
+ *
+ ******************************************************************************/
+static void tar_member_close(void)
+{
+    if ((NULL != member_fa) && (CY_OTA_TAR_DATA_AREA_ID != member_fa->fa_id))
+    {
+        flash_area_close(member_fa);
+    }
+    member = NULL;
+    member_fa = NULL;
+}
+
+
+/*******************************************************************************
+ * Function Name: tar_fail
+ *******************************************************************************
+ * Summary:
+ *  Stops the extraction. The file is rejected when it is closed.
+ *
+ * Parameters:
+ *  reason - printed reason
+ *
+ ******************************************************************************/
+static void tar_fail(const char *reason)
+{
+    configPRINTF(("OTA TAR: %s at offset %u\r\n", reason, (unsigned int)tar_pos));
+    tar_state = TAR_FAILED;
+    tar_member_close();
+}
+
+
+/*******************************************************************************
+ * Function Name: tar_erase_unit
+ *******************************************************************************
+ * Summary:
+ *  Returns the erase granularity of a flash area: the uniform sector of the
+ *  external flash or one row of the internal flash.
+ *
+ * Parameters:
+ *  fa - flash area
+ *
+ * Return:
+ *  uint32_t - erase size in bytes
+ *
+ ******************************************************************************/
+static uint32_t tar_erase_unit(const struct flash_area *fa)
+{
+#ifdef CY_BOOT_USE_EXTERNAL_FLASH
+    if ((fa->fa_device_id & FLASH_DEVICE_EXTERNAL_FLAG) != 0U)
+    {
+        return qspi_get_erase_size();
+    }
+#else
+    (void)fa;
+#endif
+
+    return CY_FLASH_SIZEOF_ROW;
+}
+
+
+/*******************************************************************************
+ * Function Name: tar_requeue_ahead
+ *******************************************************************************
+ * Summary:
+ *  Marks the blocks received ahead of the archive position as missing again,
+ *  so that the agent requests them once more. Only blocks dropped by
+ *  ota_tar_stream_write() are received past that position.
+ *
+ * Parameters:
+ *  C - OTA file context
+ *
+ ******************************************************************************/
+static void tar_requeue_ahead(OTA_FileContext_t *C)
+{
+    uint32_t units = (file_size + OTA_BLOCK_UNIT_SIZE - 1UL) / OTA_BLOCK_UNIT_SIZE;
+
+    if (!tar_deferred)
+    {
+        return;
+    }
+    tar_deferred = false;
+
+    for (uint32_t unit = tar_pos / OTA_BLOCK_UNIT_SIZE; unit < units; unit++)
+    {
+        uint8_t mask = (uint8_t)(1U << (unit % BITS_PER_BYTE));
+
+        if (0U == (C->pucRxBlockBitmap[unit / BITS_PER_BYTE] & mask))
+        {
+            C->pucRxBlockBitmap[unit / BITS_PER_BYTE] |= mask;
+            C->ulBlocksRemaining++;
+            stat_requeued++;
+        }
+    }
+}
+
+
+/*******************************************************************************
+ * Function Name: tar_octal
+ *******************************************************************************
+ * Summary:
+ *  Reads a numeric header field: octal digits, optionally led by spaces and
+ *  ended by a space or a NUL.
+ *
+ * Parameters:
+ *  field - first byte of the field
+ *  len - size of the field
+ *  value - value read
+ *
+ * Return:
+ *  bool - false if the field has no digit, another character or does not
+ *         fit 32 bits
+ *
+ ******************************************************************************/
+static bool tar_octal(const uint8_t *field, uint32_t len, uint32_t *value)
+{
+    uint32_t i = 0U;
+    uint32_t digits = 0U;
+
+    *value = 0U;
+
+    while ((i < len) && (' ' == field[i]))
+    {
+        i++;
+    }
+
+    for (; (i < len) && ('\0' != field[i]) && (' ' != field[i]); i++)
+    {
+        if ((field[i] < '0') || (field[i] > '7') || (*value > (UINT32_MAX >> 3)))
+        {
+            return false;
+        }
+        *value = (*value << 3) | (uint32_t)(field[i] - '0');
+        digits++;
+    }
+
+    return (digits > 0U);
+}
+
+
+/*******************************************************************************
+ * Function Name: tar_header_valid
+ *******************************************************************************
+ * Summary:
+ *  Checks the magic and the checksum of the buffered header. The checksum is
+ *  the sum of the header bytes, with the checksum field read as spaces.
+ *
+ * Return:
+ *  bool - true if the header is valid
+ *
+ ******************************************************************************/
+static bool tar_header_valid(void)
+{
+    uint32_t sum = 0U;
+    uint32_t chksum;
+
+    if ((0 != memcmp(&tar_header[TAR_MAGIC_OFF], TAR_MAGIC, TAR_MAGIC_LEN)) ||
+        !tar_octal(&tar_header[TAR_CHKSUM_OFF], TAR_CHKSUM_LEN, &chksum))
+    {
+        return false;
+    }
+
+    for (uint32_t i = 0U; i < TAR_BLOCK_SIZE; i++)
+    {
+        bool in_chksum = (i >= TAR_CHKSUM_OFF) && (i < (TAR_CHKSUM_OFF + TAR_CHKSUM_LEN));
+
+        sum += in_chksum ? (uint32_t)' ' : tar_header[i];
+    }
+
+    return (sum == chksum);
+}
+
+
+/*******************************************************************************
+ * Function Name: tar_header_zero
+ *******************************************************************************
+ * Summary:
+ *  Checks for an end-of-archive block: a header of zeros.
+ *
+ ******************************************************************************/
+static bool tar_header_zero(void)
+{
+    for (uint32_t i = 0U; i < TAR_BLOCK_SIZE; i++)
+    {
+        if (0U != tar_header[i])
+        {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+
+/*******************************************************************************
+ * Function Name: tar_member_find
+ *******************************************************************************
+ * Summary:
+ *  Returns the partition of a member from the name in its header. Only
+ *  regular files with a name of up to 100 characters, without prefix, are
+ *  extracted; a leading "./" is ignored.
+ *
+ * Return:
+ *  const tar_member_t * - partition, NULL if the member is skipped
+ *
+ ******************************************************************************/
+static const tar_member_t *tar_member_find(void)
+{
+    char name[TAR_NAME_LEN + 1U];
+    const char *base = name;
+    uint8_t type = tar_header[TAR_TYPEFLAG_OFF];
+
+    if (((TAR_TYPE_FILE != type) && (TAR_TYPE_FILE_OLD != type)) ||
+        ('\0' != tar_header[TAR_PREFIX_OFF]))
+    {
+        return NULL;
+    }
+
+    memcpy(name, &tar_header[TAR_NAME_OFF], TAR_NAME_LEN);
+    name[TAR_NAME_LEN] = '\0';
+    if (0 == strncmp(base, "./", 2U))
+    {
+        base += 2;
+    }
+
+    for (uint32_t i = 0U; i < (sizeof(tar_members) / sizeof(tar_members[0])); i++)
+    {
+        if (0 == strcmp(base, tar_members[i].name))
+        {
+            return &tar_members[i];
+        }
+    }
+
+    return NULL;
+}
+
+
+/*******************************************************************************
+ * Function Name: tar_member_start
+ *******************************************************************************
+ * Summary:
+ *  Parses the buffered header and opens the partition of the member.
+ *
+ ******************************************************************************/
+static void tar_member_start(void)
+{
+    uint32_t size;
+
+    header_len = 0U;
+
+    if (tar_header_zero())
+    {
+        tar_state = TAR_END;
+        return;
+    }
+
+    if (!tar_header_valid() ||
+        !tar_octal(&tar_header[TAR_SIZE_OFF], TAR_SIZE_LEN, &size))
+    {
+        tar_fail("invalid header");
+        return;
+    }
+
+    member = (size > 0U) ? tar_member_find() : NULL;
+    member_fa = NULL;
+    member_off = 0U;
+    member_left = size;
+    padding_left = (TAR_BLOCK_SIZE - (size % TAR_BLOCK_SIZE)) % TAR_BLOCK_SIZE;
+    erased_end = 0U;
+
+    if ((NULL != member) && (TAR_ROUTE_AREA == member->route))
+    {
+#if defined(CY_BOOT_USE_EXTERNAL_FLASH) && (CY_OTA_TAR_DATA_SIZE > 0UL)
+        if (CY_OTA_TAR_DATA_AREA_ID == member->area_id)
+        {
+            member_fa = &data_area;
+        }
+        else
+#endif
+        if (0 != flash_area_open(member->area_id, &member_fa))
+        {
+            member_fa = NULL;
+            tar_fail("partition not found");
+            return;
+        }
+
+        if (size > member_fa->fa_size)
+        {
+            tar_fail("member larger than its partition");
+            return;
+        }
+    }
+
+    if (NULL != member)
+    {
+        stat_members++;
+        configPRINTF(("OTA TAR: %s, %u bytes\r\n", member->name, (unsigned int)size));
+    }
+
+    tar_state = (size > 0U) ? TAR_DATA : TAR_HEADER;
+}
+
+
+/*******************************************************************************
+ * Function Name: tar_member_write
+ *******************************************************************************
+ * Summary:
+ *  Writes data of the current member at the current member offset. The
+ *  sectors of a flash area are erased when the writes reach them.
+ *
+ * Parameters:
+ *  data - member data
+ *  len - size of the data
+ *
+ * Return:
+ *  bool - false if the write failed
+ *
+ ******************************************************************************/
+static bool tar_member_write(uint8_t *data, uint32_t len)
+{
+    if (NULL == member)
+    {
+        return true;
+    }
+
+    if (TAR_ROUTE_PAL == member->route)
+    {
+        return (__real_prvPAL_WriteBlock(file_ctx, member_off, data, len) == (int16_t)len);
+    }
+
+    while (erased_end < (member_off + len))
+    {
+        uint32_t unit = tar_erase_unit(member_fa);
+
+        if (0 != flash_area_erase(member_fa, erased_end, unit))
+        {
+            return false;
+        }
+        erased_end += unit;
+    }
+
+    return (0 == flash_area_write(member_fa, member_off, data, len));
+}
+
+
+/*******************************************************************************
+ * Function Name: tar_member_end
+ *******************************************************************************
+ * Summary:
+ *  Closes the partition of a member written completely. The trailer sector of
+ *  the second image slot is erased for the pending flag set when the archive
+ *  is verified.
+ *
+ * Return:
+ *  bool - false if the trailer could not be erased
+ *
+ ******************************************************************************/
+static bool tar_member_end(void)
+{
+    bool ok = true;
+
+    if ((NULL != member_fa) && (CY_OTA_TAR_DATA_AREA_ID != member_fa->fa_id))
+    {
+        uint32_t unit = tar_erase_unit(member_fa);
+        uint32_t trailer = member_fa->fa_size - unit;
+
+        if (erased_end <= trailer)
+        {
+            ok = (0 == flash_area_erase(member_fa, trailer, unit));
+        }
+        app2_written = ok;
+    }
+
+    tar_member_close();
+    tar_state = (padding_left > 0U) ? TAR_PADDING : TAR_HEADER;
+
+    return ok;
+}
+
+
+/*******************************************************************************
+ * Function Name: tar_detect
+ *******************************************************************************
+ * Summary:
+ *  Tells an archive from an image once enough of the file is buffered. The
+ *  bytes of an image are written to the secondary slot as they are.
+ *
+ ******************************************************************************/
+static void tar_detect(void)
+{
+    if ((header_len >= TAR_DETECT_SIZE) &&
+        (0 == memcmp(&tar_header[TAR_MAGIC_OFF], TAR_MAGIC, TAR_MAGIC_LEN)))
+    {
+        tar_state = TAR_HEADER;
+        return;
+    }
+
+    tar_state = TAR_PASS;
+    if (__real_prvPAL_WriteBlock(file_ctx, 0U, tar_header, header_len) != (int16_t)header_len)
+    {
+        tar_fail("write failed");
+    }
+    header_len = 0U;
+}
+
+
+/*******************************************************************************
+ * Function Name: ota_tar_stream_begin
+ *******************************************************************************
+ * Summary:
+ *  Starts the extraction of the file that is opened.
+ *
+ * Parameters:
+ *  C - OTA file context
+ *
+ ******************************************************************************/
+void ota_tar_stream_begin(OTA_FileContext_t *C)
+{
+    file_ctx = C;
+    file_size = C->ulFileSize;
+    tar_state = TAR_DETECT;
+    tar_pos = 0U;
+    tar_deferred = false;
+    header_len = 0U;
+    member = NULL;
+    member_fa = NULL;
+    stat_members = 0U;
+    stat_deferred = 0U;
+    stat_requeued = 0U;
+    app2_written = false;
+}
+
+
+/*******************************************************************************
+ * Function Name: ota_tar_stream_write
+ *******************************************************************************
+ * Summary:
+ *  Parses a block of the archive and writes the member data it holds. A block
+ *  that is not at the archive position is not written, and the blocks ahead
+ *  of it are requested again.
+ *
+ * Parameters:
+ *  C - OTA file context
+ *  off - offset of the block in the file
+ *  data - block data
+ *  len - size of the block
+ *
+ * Return:
+ *  int16_t - len if the block was parsed, OTA_TAR_STREAM_DEFERRED if it was
+ *            not, negative on error
+ *
+ ******************************************************************************/
+int16_t ota_tar_stream_write(OTA_FileContext_t *C, uint32_t off,
+                             uint8_t *data, uint32_t len)
+{
+    int16_t result = (int16_t)len;
+    uint32_t n;
+
+    tar_requeue_ahead(C);
+
+    if (TAR_PASS == tar_state)
+    {
+        return __real_prvPAL_WriteBlock(C, off, data, len);
+    }
+
+    if (TAR_FAILED == tar_state)
+    {
+        return TAR_WRITE_ERROR;
+    }
+
+    if (off != tar_pos)
+    {
+        if (off > tar_pos)
+        {
+            tar_deferred = true;
+            stat_deferred++;
+        }
+        return OTA_TAR_STREAM_DEFERRED;
+    }
+
+    while ((len > 0U) && (TAR_FAILED != tar_state))
+    {
+        switch (tar_state)
+        {
+            case TAR_DETECT:
+            case TAR_HEADER:
+                n = ((TAR_BLOCK_SIZE - header_len) < len) ? (TAR_BLOCK_SIZE - header_len) : len;
+                memcpy(&tar_header[header_len], data, n);
+                header_len += n;
+
+                if ((TAR_DETECT == tar_state) &&
+                    ((header_len >= TAR_DETECT_SIZE) || ((tar_pos + n) == file_size)))
+                {
+                    tar_detect();
+                }
+                if ((TAR_HEADER == tar_state) && (TAR_BLOCK_SIZE == header_len))
+                {
+                    tar_member_start();
+                }
+                break;
+
+            case TAR_DATA:
+                n = (member_left < len) ? member_left : len;
+                if (!tar_member_write(data, n))
+                {
+                    tar_fail("write failed");
+                    break;
+                }
+                member_off += n;
+                member_left -= n;
+                if ((0U == member_left) && !tar_member_end())
+                {
+                    tar_fail("trailer erase failed");
+                }
+                break;
+
+            case TAR_PADDING:
+                n = (padding_left < len) ? padding_left : len;
+                padding_left -= n;
+                if (0U == padding_left)
+                {
+                    tar_state = TAR_HEADER;
+                }
+                break;
+
+            case TAR_PASS:
+                n = len;
+                if (__real_prvPAL_WriteBlock(C, tar_pos, data, n) != (int16_t)n)
+                {
+                    tar_fail("write failed");
+                }
+                break;
+
+            default:
+                /* End-of-archive blocks and the rest of the last record */
+                n = len;
+                break;
+        }
+
+        data += n;
+        len -= n;
+        tar_pos += n;
+    }
+
+    return (TAR_FAILED == tar_state) ? TAR_WRITE_ERROR : result;
+}
+
+
+/*******************************************************************************
+ * Function Name: ota_tar_stream_finish
+ *******************************************************************************
+ * Summary:
+ *  Ends the extraction when the file is closed and prints its statistics.
+ *
+ * Return:
+ *  bool - false if the archive was not extracted completely: the file must
+ *         be rejected
+ *
+ ******************************************************************************/
+bool ota_tar_stream_finish(void)
+{
+    bool complete;
+
+    if (TAR_PASS == tar_state)
+    {
+        return true;
+    }
+
+    complete = (tar_pos == file_size) &&
+               ((TAR_END == tar_state) || ((TAR_HEADER == tar_state) && (0U == header_len)));
+
+    configPRINTF(("OTA TAR: %s, %u members extracted, %u blocks ahead dropped, "
+                  "%u requested again\r\n",
+                  complete ? "archive complete" : "archive incomplete",
+                  (unsigned int)stat_members, (unsigned int)stat_deferred,
+                  (unsigned int)stat_requeued));
+
+    if (!complete && (TAR_FAILED != tar_state))
+    {
+        tar_fail("archive ends in a member");
+    }
+
+    return complete;
+}
+
+
+/*******************************************************************************
+ * Function Name: ota_tar_stream_end
+ *******************************************************************************
+ * Summary:
+ *  Ends the file, once its signature is checked or when it is aborted. When
+ *  the archive is verified, the second image is marked pending for MCUboot,
+ *  as the PAL marks the first one when the image is activated.
+ *
+ * Parameters:
+ *  verified - the signature of the archive is valid
+ *
+ ******************************************************************************/
+void ota_tar_stream_end(bool verified)
+{
+#if (MCUBOOT_IMAGE_NUMBER == 2)
+    if (verified && app2_written && (0 != boot_set_pending_multi(1, 0)))
+    {
+        configPRINTF(("OTA TAR: second image not marked pending\r\n"));
+    }
+#else
+    (void)verified;
+#endif
+
+    tar_member_close();
+    app2_written = false;
+    tar_state = TAR_FAILED;
+}
+
+#endif /* CY_OTA_TAR_STREAM */
+
+
+/* [] END OF FILE */
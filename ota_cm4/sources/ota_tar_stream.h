@@ -0,0 +1,111 @@
+/******************************************************************************
+* File Name: ota_tar_stream.h
+*
+* Description: This file contains the macros and function declarations of the
+* streaming extraction of multi-component TAR archives received by OTA.
+*
+* Related Document: See README.md
+*
+*******************************************************************************
+* (c) 2020, Cypress Semiconductor Corporation. All rights reserved.
+*******************************************************************************
+* This software, including source code, documentation and related materials
+* ("Software"), is owned by Cypress Semiconductor Corporation or one of its
+* subsidiaries ("Cypress") and is protected by and subject to worldwide patent
+* protection (United States and foreign), United States copyright laws and
+* international treaty provisions. Therefore, you may use this Software only
+* as provided in the license agreement accompanying the software package from
+* which you obtained this Software ("EULA").
+*
+* If no EULA applies, Cypress hereby grants you a personal, non-exclusive,
+* non-transferable license to copy, modify, and compile the Software source
+* code solely for use in connection with Cypress's integrated circuit products.
+* Any reproduction, modification, translation, compilation, or representation
+* of this Software except as specified above is prohibited without the express
+* written permission of Cypress.
+*
+* Disclaimer: THIS SOFTWARE IS PROVIDED AS-IS, WITH NO WARRANTY OF ANY KIND,
+* EXPRESS OR IMPLIED, INCLUDING, BUT NOT LIMITED TO, NONINFRINGEMENT, IMPLIED
+* WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE. Cypress
+* reserves the right to make changes to the Software without notice. Cypress
+* does not assume any liability arising out of the application or use of the
+* Software or any product or circuit described in the Software. Cypress does
+* not authorize its products for use in any products where a malfunction or
+* failure of the Cypress product may reasonably be expected to result in
+* significant property damage, injury or death ("High Risk Product"). By
+* including Cypress's product in a High Risk Product, the manufacturer of such
+* system or application assumes all risk of such use and in doing so agrees to
+* indemnify Cypress against all liability.
+*******************************************************************************/
+#ifndef OTA_TAR_STREAM_H
+#define OTA_TAR_STREAM_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "aws_iot_ota_agent.h"
+
+#if defined(CY_OTA_TAR_STREAM)
+#if !defined(CY_OTA_STREAM_HASH)
+#error "CY_OTA_TAR_STREAM needs CY_OTA_STREAM_HASH: the archive is not kept in the slot"
+#endif
+#if defined(CY_OTA_FLASH_WRITER) || defined(CY_OTA_HTTP_STREAM) || defined(CY_OTA_RESUME) || \
+    defined(CY_OTA_ADAPTIVE_BLOCK_SIZE)
+#error "CY_OTA_TAR_STREAM needs the blocks written one at a time by the agent task"
+#endif
+#endif
+
+
+/*******************************************************************************
+ * Macros
+ ******************************************************************************/
+/* Member written to the secondary slot through the PAL */
+#ifndef CY_OTA_TAR_APP_MEMBER
+#define CY_OTA_TAR_APP_MEMBER               "ota_cm4.bin"
+#endif
+
+/* Member written to the secondary slot of the second image */
+#ifndef CY_OTA_TAR_APP2_MEMBER
+#define CY_OTA_TAR_APP2_MEMBER              "ota_cm0p.bin"
+#endif
+
+/* Member written to the data partition in the external flash. The partition
+ * is used only when its size is not 0; its offset is from the start of the
+ * external flash and must be erase-sector aligned.
+ */
+#ifndef CY_OTA_TAR_DATA_MEMBER
+#define CY_OTA_TAR_DATA_MEMBER              "data.bin"
+#endif
+
+#ifndef CY_OTA_TAR_DATA_OFFSET
+#define CY_OTA_TAR_DATA_OFFSET              (0UL)
+#endif
+
+#ifndef CY_OTA_TAR_DATA_SIZE
+#define CY_OTA_TAR_DATA_SIZE                (0UL)
+#endif
+
+/* Flash area ID used for the data partition. It is not registered in
+ * boot_area_descs.
+ */
+#define CY_OTA_TAR_DATA_AREA_ID             (0x13U)
+
+/* Returned by ota_tar_stream_write() for a block ahead of the archive
+ * position: it is not written and is requested again.
+ */
+#define OTA_TAR_STREAM_DEFERRED             (0)
+
+
+/*******************************************************************************
+ * Function prototypes
+ ******************************************************************************/
+void ota_tar_stream_begin(OTA_FileContext_t *C);
+int16_t ota_tar_stream_write(OTA_FileContext_t *C, uint32_t off,
+                             uint8_t *data, uint32_t len);
+bool ota_tar_stream_finish(void);
+void ota_tar_stream_end(bool verified);
+
+
+#endif /* OTA_TAR_STREAM_H */
+
+
+/* [] END OF FILE */
@@ -0,0 +1,540 @@
+/******************************************************************************
+* File Name: ota_write_coalesce.c
+*
+* Description: This file implements the coalescing of the OTA block writes to
+* the secondary slot into whole program units: rows of 512 bytes in the
+* internal flash, pages in the external flash. A write that covers part of a
+* unit costs as much as a whole one: a read-modify-write of the row in the
+* internal flash, one more page program in the external flash. Blocks of the
+* MQTT stream and pieces of the HTTP bodies do not always start or end on a
+* unit.
+* The whole units of a write are programmed at once. The parts of units at
+* its ends are kept in one of CY_OTA_WRITE_COALESCE_BUFFERS buffers until
+* the unit is complete, and then programmed as a whole. When every buffer is
+* in use, the one written to least recently is programmed as it is. Reads
+* and erases of the secondary slot program the buffers they overlap first,
+* and the buffers left are programmed when the file is closed.
+*
+* Related Document: See README.md
+*
+*******************************************************************************
+* (c) 2020, Cypress Semiconductor Corporation. All rights reserved.
+*******************************************************************************
+* This software, including source code, documentation and related materials
+* ("Software"), is owned by Cypress Semiconductor Corporation or one of its
+* subsidiaries ("Cypress") and is protected by and subject to worldwide patent
+* protection (United States and foreign), United States copyright laws and
+* international treaty provisions. Therefore, you may use this Software only
+* as provided in the license agreement accompanying the software package from
+* which you obtained this Software ("EULA").
+*
+* If no EULA applies, Cypress hereby grants you a personal, non-exclusive,
+* non-transferable license to copy, modify, and compile the Software source
+* code solely for use in connection with Cypress's integrated circuit products.
+* Any reproduction, modification, translation, compilation, or representation
+* of this Software except as specified above is prohibited without the express
+* written permission of Cypress.
+*
+* Disclaimer: THIS SOFTWARE IS PROVIDED AS-IS, WITH NO WARRANTY OF ANY KIND,
+* EXPRESS OR IMPLIED, INCLUDING, BUT NOT LIMITED TO, NONINFRINGEMENT, IMPLIED
+* WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE. Cypress
+* reserves the right to make changes to the Software without notice. Cypress
+* does not assume any liability arising out of the application or use of the
+* Software or any product or circuit described in the Software. Cypress does
+* not authorize its products for use in any products where a malfunction or
+* failure of the Cypress product may reasonably be expected to result in
+* significant property damage, injury or death ("High Risk Product"). By
+* including Cypress's product in a High Risk Product, the manufacturer of such
+* system or application assumes all risk of such use and in doing so agrees to
+* indemnify Cypress against all liability.
+*******************************************************************************/
+#include <string.h>
+#include "cy_pdl.h"
+#include "FreeRTOS.h"
+
+#ifdef CY_BOOT_USE_EXTERNAL_FLASH
+#include "flash_qspi.h"
+#endif
+
+#include "sysflash/sysflash.h"
+#include "ota_write_coalesce.h"
+
+#if defined(CY_OTA_WRITE_COALESCE)
+
+/*******************************************************************************
+ * Data structure and enumeration
+ ******************************************************************************/
+typedef struct
+{
+    bool used;
+    uint32_t unit_off;          /* Offset of the unit in the secondary slot */
+    uint32_t lo;                /* Bytes held: [lo, hi) of the unit */
+    uint32_t hi;
+    uint32_t age;               /* Last write into the buffer */
+    uint8_t data[OTA_WRITE_COALESCE_UNIT_MAX];
+} coalesce_buffer_t;
+
+
+/*******************************************************************************
+ * Global variables
+ ******************************************************************************/
+/* Only used by the task that writes the blocks, then by the agent task once
+ * every block is written.
+ */
+static coalesce_buffer_t coalesce_buffers[CY_OTA_WRITE_COALESCE_BUFFERS];
+static const struct flash_area *coalesce_fa;
+static uint32_t coalesce_unit;          /* Program unit, 0 until the first write */
+static uint32_t coalesce_clock;
+static bool coalesce_armed;
+static bool coalesce_programming;       /* Write of the coalescer in progress */
+static int coalesce_error;              /* First program error, returned from then on */
+
+/* Statistics of the transfer, in program units */
+static uint32_t stat_in_ops;            /* Units of the writes received */
+static uint32_t stat_in_partial;        /* ... written in part */
+static uint32_t stat_ops;               /* Units programmed */
+static uint32_t stat_partial;           /* ... programmed in part */
+
+
+/*******************************************************************************
+ * Function definitions
+ ******************************************************************************/
+
+/*******************************************************************************
+ * Function Name: coalesce_unit_size
+ *******************************************************************************
+ * Summary:
+ *  Returns the program unit of a flash area: the page of the external flash
+ *  or one row of the internal flash.
+ *
+ * Parameters:
+ *  fa - flash area
+ *
+ * Return:
+ *  uint32_t - program unit in bytes
+ *
+ ******************************************************************************/
+static uint32_t coalesce_unit_size(const struct flash_area *fa)
+{
+#ifdef CY_BOOT_USE_EXTERNAL_FLASH
+    if ((fa->fa_device_id & FLASH_DEVICE_EXTERNAL_FLAG) != 0U)
+    {
+        return qspi_get_memory_config(0)->deviceCfg->programSize;
+    }
+#else
+    (void)fa;
+#endif
+
+    return CY_FLASH_SIZEOF_ROW;
+}
+
+
+/*******************************************************************************
+ * Function Name: coalesce_count
+ *******************************************************************************
+ * Summary:
+ *  Counts the program units a write covers, and those it covers in part.
+ *
+ * Parameters:
+ *  off - offset of the write
+ *  len - size of the write, not 0
+ *  ops - incremented by the number of units
+ *  partial - incremented by the number of units covered in part
+ *
+ ******************************************************************************/
+static void coalesce_count(uint32_t off, uint32_t len, uint32_t *ops, uint32_t *partial)
+{
+    uint32_t units = ((off + len - 1U) / coalesce_unit) - (off / coalesce_unit) + 1U;
+    uint32_t part = ((off % coalesce_unit) != 0U) ? 1U : 0U;
+
+    if ((((off + len) % coalesce_unit) != 0U) && ((units > 1U) || (0U == part)))
+    {
+        part++;
+    }
+
+    *ops += units;
+    *partial += part;
+}
+
+
+/*******************************************************************************
+ * Function Name: coalesce_program
+ *******************************************************************************
+ * Summary:
+ *  Programs a range of the secondary slot, bypassing the coalescer.
+ *
+ * Parameters:
+ *  off - offset within the secondary slot
+ *  src - data
+ *  len - number of bytes
+ *
+ * Return:
+ *  int - 0 on success, non-zero otherwise
+ *
+ ******************************************************************************/
+static int coalesce_program(uint32_t off, const uint8_t *src, uint32_t len)
+{
+    int rc;
+
+    coalesce_count(off, len, &stat_ops, &stat_partial);
+
+    coalesce_programming = true;
+    rc = flash_area_write(coalesce_fa, off, src, len);
+    coalesce_programming = false;
+
+    if ((0 != rc) && (0 == coalesce_error))
+    {
+        coalesce_error = rc;
+    }
+
+    return rc;
+}
+
+
+/*******************************************************************************
+ * Function Name: coalesce_write_buffer
+ *******************************************************************************
+ * Summary:
+ *  Programs the bytes held by a buffer and frees it.
+ *
+ * Parameters:
+ *  buf - buffer in use
+ *
+ * Return:
+ *  int - 0 on success, non-zero otherwise
+ *
+ ******************************************************************************/
+static int coalesce_write_buffer(coalesce_buffer_t *buf)
+{
+    buf->used = false;
+
+    return coalesce_program(buf->unit_off + buf->lo, &buf->data[buf->lo], buf->hi - buf->lo);
+}
+
+
+/*******************************************************************************
+ * Function Name: coalesce_get
+ *******************************************************************************
+ * Summary:
+ *  Returns the buffer of a unit. A new buffer is taken when there is none,
+ *  programming the least recently written one when all are in use.
+ *
+ * Parameters:
+ *  unit_off - offset of the unit
+ *  rc - set to the result of the program, if any
+ *
+ * Return:
+ *  coalesce_buffer_t * - buffer of the unit
+ *
+ ******************************************************************************/
+static coalesce_buffer_t *coalesce_get(uint32_t unit_off, int *rc)
+{
+    coalesce_buffer_t *buf = NULL;
+
+    for (uint32_t i = 0U; i < CY_OTA_WRITE_COALESCE_BUFFERS; i++)
+    {
+        coalesce_buffer_t *candidate = &coalesce_buffers[i];
+
+        if (candidate->used && (unit_off == candidate->unit_off))
+        {
+            return candidate;
+        }
+
+        if ((NULL == buf) || (buf->used && (!candidate->used || (candidate->age < buf->age))))
+        {
+            buf = candidate;
+        }
+    }
+
+    if (buf->used)
+    {
+        *rc = coalesce_write_buffer(buf);
+    }
+
+    buf->used = true;
+    buf->unit_off = unit_off;
+    buf->lo = 0U;
+    buf->hi = 0U;
+
+    return buf;
+}
+
+
+/*******************************************************************************
+ * Function Name: coalesce_add
+ *******************************************************************************
+ * Summary:
+ *  Adds part of a unit to its buffer, and programs the unit once it is
+ *  complete. Bytes not contiguous with the ones held are not merged: the
+ *  ones held are programmed first.
+ *
+ * Parameters:
+ *  unit_off - offset of the unit
+ *  from - offset of the bytes in the unit
+ *  src - bytes
+ *  len - number of bytes, up to the end of the unit
+ *
+ * Return:
+ *  int - 0 on success, non-zero otherwise
+ *
+ ******************************************************************************/
+static int coalesce_add(uint32_t unit_off, uint32_t from, const uint8_t *src, uint32_t len)
+{
+    int rc = 0;
+    coalesce_buffer_t *buf = coalesce_get(unit_off, &rc);
+
+    if ((buf->hi > buf->lo) && ((from > buf->hi) || ((from + len) < buf->lo)))
+    {
+        rc = coalesce_write_buffer(buf);
+        buf->used = true;
+        buf->lo = from;
+        buf->hi = from;
+    }
+
+    if (buf->hi == buf->lo)
+    {
+        buf->lo = from;
+        buf->hi = from;
+    }
+
+    memcpy(&buf->data[from], src, len);
+    buf->lo = (from < buf->lo) ? from : buf->lo;
+    buf->hi = ((from + len) > buf->hi) ? (from + len) : buf->hi;
+    buf->age = ++coalesce_clock;
+
+    if ((0 == rc) && (0U == buf->lo) && (coalesce_unit == buf->hi))
+    {
+        rc = coalesce_write_buffer(buf);
+    }
+
+    return rc;
+}
+
+
+/*******************************************************************************
+ * Function Name: coalesce_discard
+ *******************************************************************************
+ * Summary:
+ *  Frees the buffers of units that a write programs as a whole.
+ *
+ * Parameters:
+ *  off - offset of the first unit
+ *  len - size of the units
+ *
+ ******************************************************************************/
+static void coalesce_discard(uint32_t off, uint32_t len)
+{
+    for (uint32_t i = 0U; i < CY_OTA_WRITE_COALESCE_BUFFERS; i++)
+    {
+        if (coalesce_buffers[i].used && (coalesce_buffers[i].unit_off >= off) &&
+            (coalesce_buffers[i].unit_off < (off + len)))
+        {
+            coalesce_buffers[i].used = false;
+        }
+    }
+}
+
+
+/*******************************************************************************
+ * Function Name: ota_write_coalesce_begin
+ *******************************************************************************
+ * Summary:
+ *  Starts coalescing the writes of a new file to the secondary slot. The
+ *  buffers left from an earlier file are dropped.
+ *
+ ******************************************************************************/
+void ota_write_coalesce_begin(void)
+{
+    memset(coalesce_buffers, 0, sizeof(coalesce_buffers));
+    coalesce_fa = NULL;
+    coalesce_unit = 0U;
+    coalesce_clock = 0U;
+    coalesce_error = 0;
+
+    stat_in_ops = 0U;
+    stat_in_partial = 0U;
+    stat_ops = 0U;
+    stat_partial = 0U;
+
+    coalesce_armed = true;
+}
+
+
+/*******************************************************************************
+ * Function Name: ota_write_coalesce_end
+ *******************************************************************************
+ * Summary:
+ *  Programs the buffers left, stops coalescing and prints the program
+ *  operations saved. Must be called once every block is written, before the
+ *  PAL closes the file.
+ *
+ * Return:
+ *  int - 0 if every write of the file was programmed, non-zero otherwise
+ *
+ ******************************************************************************/
+int ota_write_coalesce_end(void)
+{
+    int rc = ota_write_coalesce_flush();
+
+    coalesce_armed = false;
+
+    if (stat_in_ops > 0U)
+    {
+        configPRINTF(("OTA write coalescing: %u program operations (%u partial) instead of %u "
+                      "(%u partial), %u saved\r\n",
+                      (unsigned int)stat_ops, (unsigned int)stat_partial,
+                      (unsigned int)stat_in_ops, (unsigned int)stat_in_partial,
+                      (unsigned int)((stat_in_ops > stat_ops) ? (stat_in_ops - stat_ops) : 0U)));
+    }
+
+    return rc;
+}
+
+
+/*******************************************************************************
+ * Function Name: ota_write_coalesce_intercept
+ *******************************************************************************
+ * Summary:
+ *  Called for every write. While a file is received, the writes to the
+ *  secondary slot are coalesced into whole program units.
+ *
+ * Parameters:
+ *  fa - flash area
+ *  off - offset within the flash area
+ *  src - data
+ *  len - number of bytes
+ *  handled - set to true if the write was taken by the coalescer
+ *
+ * Return:
+ *  int - 0 on success, non-zero otherwise
+ *
+ ******************************************************************************/
+int ota_write_coalesce_intercept(const struct flash_area *fa, uint32_t off, const void *src,
+                                 uint32_t len, bool *handled)
+{
+    const uint8_t *bytes = (const uint8_t *)src;
+    int rc = 0;
+
+    *handled = false;
+
+    if (!coalesce_armed || coalesce_programming || (0U == len) ||
+        (FLASH_AREA_IMAGE_SECONDARY(0) != fa->fa_id))
+    {
+        return 0;
+    }
+
+    if (0U == coalesce_unit)
+    {
+        coalesce_fa = fa;
+        coalesce_unit = coalesce_unit_size(fa);
+
+        if ((0U == coalesce_unit) || (coalesce_unit > OTA_WRITE_COALESCE_UNIT_MAX))
+        {
+            coalesce_armed = false;
+            return 0;
+        }
+    }
+
+    *handled = true;
+
+    if (0 != coalesce_error)
+    {
+        return coalesce_error;
+    }
+
+    coalesce_count(off, len, &stat_in_ops, &stat_in_partial);
+
+    while ((0 == rc) && (len > 0U))
+    {
+        uint32_t from = off % coalesce_unit;
+        uint32_t chunk;
+
+        if ((0U == from) && (len >= coalesce_unit))
+        {
+            chunk = len - (len % coalesce_unit);
+            coalesce_discard(off, chunk);
+            rc = coalesce_program(off, bytes, chunk);
+        }
+        else
+        {
+            chunk = ((coalesce_unit - from) < len) ? (coalesce_unit - from) : len;
+            rc = coalesce_add(off - from, from, bytes, chunk);
+        }
+
+        off += chunk;
+        bytes += chunk;
+        len -= chunk;
+    }
+
+    return rc;
+}
+
+
+/*******************************************************************************
+ * Function Name: ota_write_coalesce_sync
+ *******************************************************************************
+ * Summary:
+ *  Called for every read and erase. Programs the buffers that overlap a range
+ *  of the secondary slot.
+ *
+ * Parameters:
+ *  fa - flash area
+ *  off - offset within the flash area
+ *  len - length of the range
+ *
+ * Return:
+ *  int - 0 on success, non-zero otherwise
+ *
+ ******************************************************************************/
+int ota_write_coalesce_sync(const struct flash_area *fa, uint32_t off, uint32_t len)
+{
+    int rc = 0;
+
+    if (!coalesce_armed || coalesce_programming || (FLASH_AREA_IMAGE_SECONDARY(0) != fa->fa_id))
+    {
+        return 0;
+    }
+
+    for (uint32_t i = 0U; i < CY_OTA_WRITE_COALESCE_BUFFERS; i++)
+    {
+        coalesce_buffer_t *buf = &coalesce_buffers[i];
+
+        if (buf->used && ((buf->unit_off + buf->lo) < (off + len)) &&
+            ((buf->unit_off + buf->hi) > off) && (0 == rc))
+        {
+            rc = coalesce_write_buffer(buf);
+        }
+    }
+
+    return rc;
+}
+
+
+/*******************************************************************************
+ * Function Name: ota_write_coalesce_flush
+ *******************************************************************************
+ * Summary:
+ *  Programs every buffer in use, so that every write made so far is in
+ *  flash.
+ *
+ * Return:
+ *  int - 0 if every write so far was programmed, non-zero otherwise
+ *
+ ******************************************************************************/
+int ota_write_coalesce_flush(void)
+{
+    for (uint32_t i = 0U; i < CY_OTA_WRITE_COALESCE_BUFFERS; i++)
+    {
+        if (coalesce_buffers[i].used)
+        {
+            (void)coalesce_write_buffer(&coalesce_buffers[i]);
+        }
+    }
+
+    return coalesce_error;
+}
+
+#endif /* CY_OTA_WRITE_COALESCE */
+
+
+/* [] END OF FILE */
@@ -0,0 +1,78 @@
+/******************************************************************************
+* File Name: ota_write_coalesce.h
+*
+* Description: This file contains the macros and function declarations of the
+* coalescing of the OTA block writes into whole program units.
+*
+* Related Document: See README.md
+*
+*******************************************************************************
+* (c) 2020, Cypress Semiconductor Corporation. All rights reserved.
+*******************************************************************************
+* This software, including source code, documentation and related materials
+* ("Software"), is owned by Cypress Semiconductor Corporation or one of its
+* subsidiaries ("Cypress") and is protected by and subject to worldwide patent
+* protection (United States and foreign), United States copyright laws and
+* international treaty provisions. Therefore, you may use this Software only
+* as provided in the license agreement accompanying the software package from
+* which you obtained this Software ("EULA").
+*
+* If no EULA applies, Cypress hereby grants you a personal, non-exclusive,
+* non-transferable license to copy, modify, and compile the Software source
+* code solely for use in connection with Cypress's integrated circuit products.
+* Any reproduction, modification, translation, compilation, or representation
+* of this Software except as specified above is prohibited without the express
+* written permission of Cypress.
+*
+* Disclaimer: THIS SOFTWARE IS PROVIDED AS-IS, WITH NO WARRANTY OF ANY KIND,
+* EXPRESS OR IMPLIED, INCLUDING, BUT NOT LIMITED TO, NONINFRINGEMENT, IMPLIED
+* WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE. Cypress
+* reserves the right to make changes to the Software without notice. Cypress
+* does not assume any liability arising out of the application or use of the
+* Software or any product or circuit described in the Software. Cypress does
+* not authorize its products for use in any products where a malfunction or
+* failure of the Cypress product may reasonably be expected to result in
+* significant property damage, injury or death ("High Risk Product"). By
+* including Cypress's product in a High Risk Product, the manufacturer of such
+* system or application assumes all risk of such use and in doing so agrees to
+* indemnify Cypress against all liability.
+*******************************************************************************/
+#ifndef OTA_WRITE_COALESCE_H
+#define OTA_WRITE_COALESCE_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "flash_map_backend/flash_map_backend.h"
+
+
+/*******************************************************************************
+ * Macros
+ ******************************************************************************/
+/* Number of program units assembled at once. When all of them are in use,
+ * the one written to least recently is programmed as it is.
+ */
+#ifndef CY_OTA_WRITE_COALESCE_BUFFERS
+#define CY_OTA_WRITE_COALESCE_BUFFERS       (8U)
+#endif
+
+/* Largest program unit: a row of the internal flash, a page of the external
+ * flash. Writes to a flash with larger units are not coalesced.
+ */
+#define OTA_WRITE_COALESCE_UNIT_MAX         (512U)
+
+
+/*******************************************************************************
+ * Function prototypes
+ ******************************************************************************/
+void ota_write_coalesce_begin(void);
+int ota_write_coalesce_end(void);
+int ota_write_coalesce_intercept(const struct flash_area *fa, uint32_t off, const void *src,
+                                 uint32_t len, bool *handled);
+int ota_write_coalesce_sync(const struct flash_area *fa, uint32_t off, uint32_t len);
+int ota_write_coalesce_flush(void);
+
+
+#endif /* OTA_WRITE_COALESCE_H */
+
+
+/* [] END OF FILE */